@@ -0,0 +1,183 @@
+//==============================================================================
+// Bakes an image file into a block compressed DDS with a full mip chain, so
+// WarpTests loads it as it is instead of filtering and compressing on its
+// loader threads (see TextureLoader.h). An output ending in .wtex is written
+// as a memory mapped container instead (see TextureFile.h).
+//
+//   TextureBaker input output.(dds | wtex) [bc1 | bc3 | bc7 | rgba] [kaiser | box | none]
+//
+// The defaults are BC7 and Kaiser. Block compressed output needs a width and
+// height that are multiples of 4, as D3D11 does.
+//==============================================================================
+#include "../WarpTests/BlockCompress.h"
+#include "../WarpTests/ImageFile.h"
+#include "../WarpTests/MipChain.h"
+#include "../WarpTests/Parallel.h"
+#include "../WarpTests/TextureFile.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static bool ParseFormat(const char* name, CpuFormat* format)
+{
+    static const struct { const char* Name; CpuFormat Format; } Formats[] = {
+        { "bc1", CpuFormat::BC1Unorm },
+        { "bc3", CpuFormat::BC3Unorm },
+        { "bc7", CpuFormat::BC7Unorm },
+        { "rgba", CpuFormat::R8G8B8A8Unorm },
+    };
+    for (const auto& entry : Formats)
+    {
+        if (strcmp(name, entry.Name) == 0)
+        {
+            *format = entry.Format;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseFilter(const char* name, MipFilter* filter)
+{
+    static const struct { const char* Name; MipFilter Filter; } Filters[] = {
+        { "kaiser", MipFilter::Kaiser },
+        { "box", MipFilter::Box },
+        { "none", MipFilter::None },
+    };
+    for (const auto& entry : Filters)
+    {
+        if (strcmp(name, entry.Name) == 0)
+        {
+            *filter = entry.Filter;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool EndsWith(const char* text, const char* suffix)
+{
+    size_t length = strlen(text);
+    size_t suffixLength = strlen(suffix);
+    return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+static double MsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Filters and compresses 'image', already open, and writes it to 'output'
+static bool Bake(ImageFile* image, const char* output, CpuFormat format, MipFilter filter)
+{
+    const ImageFileInfo& info = image->Info;
+    uint32_t numLevels = (filter == MipFilter::None) ? 1 : MipLevelCount(info.Width, info.Height);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    CpuMipChain chain;
+    if (!CpuMipChainCreate(info.Width, info.Height, numLevels, CpuFormat::R8G8B8A8Unorm, &chain))
+    {
+        return false;
+    }
+    if (!ImageFileRead(image, chain.Levels[0].Data, chain.Levels[0].RowPitch))
+    {
+        fprintf(stderr, "Couldn't decode the image\n");
+        CpuMipChainDestroy(&chain);
+        return false;
+    }
+    double decodeMs = MsSince(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    bool result = MipChainGenerate(filter, chain.Levels, numLevels);
+    double mipMs = MsSince(start);
+
+    // The file takes the R8G8B8A8Unorm chain as it is
+    CpuMipChain compressed{};
+    const CpuTexture* levels = chain.Levels;
+    double compressMs = 0;
+    if (result && CpuFormatIsBlockCompressed(format))
+    {
+        start = std::chrono::high_resolution_clock::now();
+        result = CpuMipChainCreate(info.Width, info.Height, numLevels, format, &compressed);
+        for (uint32_t level = 0; level < numLevels && result; ++level)
+        {
+            result = BlockCompress(chain.Levels[level], &compressed.Levels[level]);
+        }
+        compressMs = MsSince(start);
+        levels = compressed.Levels;
+    }
+
+    if (result)
+    {
+        result = EndsWith(output, ".wtex") ? TextureFileWrite(output, levels, numLevels, 1) :
+            ImageFileWriteDds(output, levels, numLevels);
+    }
+    if (result)
+    {
+        uint64_t sourceBytes = 0;
+        uint64_t bytes = 0;
+        for (uint32_t level = 0; level < numLevels; ++level)
+        {
+            uint32_t width = MipLevelSize(info.Width, level);
+            uint32_t height = MipLevelSize(info.Height, level);
+            sourceBytes += CpuFormatImageBytes(CpuFormat::R8G8B8A8Unorm, width, height);
+            bytes += CpuFormatImageBytes(format, width, height);
+        }
+        printf("%ux%u %s, %u levels of %s (%s mips): %.2f MB, %.2f MB as R8G8B8A8\n"
+            "Decode %.1f ms, mips %.1f ms, compress %.1f ms on %u threads\n",
+            info.Width, info.Height, ImageFormatName(info.Format), numLevels, CpuFormatName(format), MipFilterName(filter),
+            bytes / (1024.0 * 1024.0), sourceBytes / (1024.0 * 1024.0), decodeMs, mipMs, compressMs, ParallelThreadCount());
+    }
+    else
+    {
+        fprintf(stderr, "Couldn't write %s\n", output);
+    }
+
+    CpuMipChainDestroy(&compressed);
+    CpuMipChainDestroy(&chain);
+    return result;
+}
+
+//==============================================================================
+int main(int argc, char** argv)
+{
+    CpuFormat format = CpuFormat::BC7Unorm;
+    MipFilter filter = MipFilter::Kaiser;
+    if (argc < 3 || argc > 5 || (argc > 3 && !ParseFormat(argv[3], &format)) || (argc > 4 && !ParseFilter(argv[4], &filter)))
+    {
+        fprintf(stderr, "Usage: TextureBaker input output.(dds | wtex) [bc1 | bc3 | bc7 | rgba] [kaiser | box | none]\n");
+        return 1;
+    }
+
+    ImageFile image;
+    if (!ImageFileOpen(argv[1], &image))
+    {
+        fprintf(stderr, "Couldn't open %s\n", argv[1]);
+        return 1;
+    }
+    if (image.Info.PixelFormat != CpuFormat::R8G8B8A8Unorm)
+    {
+        fprintf(stderr, "%s is already block compressed\n", argv[1]);
+        ImageFileClose(&image);
+        return 1;
+    }
+    if (CpuFormatIsBlockCompressed(format) && (image.Info.Width % 4 != 0 || image.Info.Height % 4 != 0))
+    {
+        fprintf(stderr, "%ux%u isn't a whole number of 4x4 blocks\n", image.Info.Width, image.Info.Height);
+        ImageFileClose(&image);
+        return 1;
+    }
+
+    if (!ParallelInit(0))
+    {
+        ImageFileClose(&image);
+        return 1;
+    }
+    bool result = Bake(&image, argv[2], format, filter);
+    ImageFileClose(&image);
+    ParallelShutdown();
+    return result ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+//==============================================================================
+#include "AdaptiveWarpMesh.h"
+#include <assert.h>
+#include <algorithm>
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline uint32_t LevelOffset(uint32_t level)
+{
+    // Cells in all coarser levels: 1 + 4 + 16 + ...
+    return ((1u << (2 * level)) - 1) / 3;
+}
+
+static inline bool operator<(const AdaptiveWarpCell& a, const AdaptiveWarpCell& b)
+{
+    return a.DepthRange < b.DepthRange;
+}
+
+// Min and max depth of every cell of every level. A cell's range includes the
+// first texel row and column of the next cell, so it covers the depth read at
+// each of its corners.
+static void BuildDepthRanges(const DepthPyramid& depth, uint32_t maxLevel, AdaptiveWarpMesh* mesh)
+{
+    uint32_t cells = 1u << maxLevel;
+    mesh->DepthMin.resize(LevelOffset(maxLevel + 1));
+    mesh->DepthMax.resize(LevelOffset(maxLevel + 1));
+
+    float* finestMin = &mesh->DepthMin[LevelOffset(maxLevel)];
+    float* finestMax = &mesh->DepthMax[LevelOffset(maxLevel)];
+
+    for (uint32_t cy = 0; cy < cells; ++cy)
+    {
+        uint32_t y0 = cy * depth.Height / cells;
+        uint32_t y1 = std::min((cy + 1) * depth.Height / cells + 1, depth.Height);
+
+        for (uint32_t cx = 0; cx < cells; ++cx)
+        {
+            uint32_t x0 = cx * depth.Width / cells;
+            uint32_t x1 = std::min((cx + 1) * depth.Width / cells + 1, depth.Width);
+
+            DepthPyramidQuery(depth, x0, y0, x1, y1, &finestMin[cy * cells + cx], &finestMax[cy * cells + cx]);
+        }
+    }
+
+    for (uint32_t level = maxLevel; level > 0; --level)
+    {
+        uint32_t childCells = 1u << level;
+        const float* childMin = &mesh->DepthMin[LevelOffset(level)];
+        const float* childMax = &mesh->DepthMax[LevelOffset(level)];
+        float* parentMin = &mesh->DepthMin[LevelOffset(level - 1)];
+        float* parentMax = &mesh->DepthMax[LevelOffset(level - 1)];
+
+        for (uint32_t y = 0; y < childCells / 2; ++y)
+        {
+            for (uint32_t x = 0; x < childCells / 2; ++x)
+            {
+                uint32_t c = (y * 2) * childCells + x * 2;
+                parentMin[y * childCells / 2 + x] = std::min(std::min(childMin[c], childMin[c + 1]),
+                    std::min(childMin[c + childCells], childMin[c + childCells + 1]));
+                parentMax[y * childCells / 2 + x] = std::max(std::max(childMax[c], childMax[c + 1]),
+                    std::max(childMax[c + childCells], childMax[c + childCells + 1]));
+            }
+        }
+    }
+}
+
+static inline AdaptiveWarpCell MakeCell(const AdaptiveWarpMesh& mesh, uint32_t level, uint32_t x, uint32_t y)
+{
+    uint32_t i = LevelOffset(level) + (y << level) + x;
+
+    AdaptiveWarpCell cell;
+    cell.DepthRange = mesh.DepthMax[i] - mesh.DepthMin[i];
+    cell.Level = (uint16_t)level;
+    cell.X = (uint16_t)x;
+    cell.Y = (uint16_t)y;
+    return cell;
+}
+
+static inline uint32_t GetVertex(AdaptiveWarpMesh* mesh, uint32_t maxLevel, uint32_t x, uint32_t y)
+{
+    uint32_t points = (1u << maxLevel) + 1;
+    uint32_t& index = mesh->VertexIndex[y * points + x];
+    if (index == UINT32_MAX)
+    {
+        index = (uint32_t)mesh->Vertices.size();
+
+        AdaptiveWarpVertex vertex;
+        vertex.TexCoord[0] = x / (float)(points - 1);
+        vertex.TexCoord[1] = y / (float)(points - 1);
+        mesh->Vertices.push_back(vertex);
+    }
+    return index;
+}
+
+// Triangulates mesh->Leaves, which must tile the whole grid
+static void Triangulate(uint32_t maxLevel, AdaptiveWarpMesh* mesh)
+{
+    uint32_t cells = 1u << maxLevel;
+
+    mesh->LeafLevel.resize(cells * cells);
+    for (const AdaptiveWarpCell& leaf : mesh->Leaves)
+    {
+        uint32_t size = 1u << (maxLevel - leaf.Level);
+        for (uint32_t y = leaf.Y * size; y < (leaf.Y + 1u) * size; ++y)
+        {
+            std::fill(&mesh->LeafLevel[y * cells + leaf.X * size], &mesh->LeafLevel[y * cells + leaf.X * size] + size,
+                (uint8_t)leaf.Level);
+        }
+    }
+
+    mesh->VertexIndex.assign((cells + 1) * (cells + 1), UINT32_MAX);
+    mesh->Vertices.clear();
+    mesh->Indices.clear();
+
+    // Leaves are aligned to their size, so a point on an edge is a vertex of
+    // the neighbor across it if the neighbor's leaf starts there
+    auto startsLeaf = [&](uint32_t x, uint32_t y, uint32_t point) -> bool
+    {
+        uint32_t size = 1u << (maxLevel - mesh->LeafLevel[y * cells + x]);
+        return (point % size) == 0;
+    };
+
+    for (const AdaptiveWarpCell& leaf : mesh->Leaves)
+    {
+        uint32_t size = 1u << (maxLevel - leaf.Level);
+        uint32_t x0 = leaf.X * size;
+        uint32_t y0 = leaf.Y * size;
+        uint32_t x1 = x0 + size;
+        uint32_t y1 = y0 + size;
+
+        // Boundary clockwise on screen from the top left corner
+        std::vector<uint32_t>& ring = mesh->Ring;
+        ring.clear();
+        ring.push_back(GetVertex(mesh, maxLevel, x0, y0));
+        for (uint32_t p = 1; y0 > 0 && p < size; ++p)
+        {
+            if (startsLeaf(x0 + p, y0 - 1, x0 + p))
+            {
+                ring.push_back(GetVertex(mesh, maxLevel, x0 + p, y0));
+            }
+        }
+        ring.push_back(GetVertex(mesh, maxLevel, x1, y0));
+        for (uint32_t p = 1; x1 < cells && p < size; ++p)
+        {
+            if (startsLeaf(x1, y0 + p, y0 + p))
+            {
+                ring.push_back(GetVertex(mesh, maxLevel, x1, y0 + p));
+            }
+        }
+        ring.push_back(GetVertex(mesh, maxLevel, x1, y1));
+        for (uint32_t p = size - 1; y1 < cells && p > 0; --p)
+        {
+            if (startsLeaf(x0 + p, y1, x0 + p))
+            {
+                ring.push_back(GetVertex(mesh, maxLevel, x0 + p, y1));
+            }
+        }
+        ring.push_back(GetVertex(mesh, maxLevel, x0, y1));
+        for (uint32_t p = size - 1; x0 > 0 && p > 0; --p)
+        {
+            if (startsLeaf(x0 - 1, y0 + p, y0 + p))
+            {
+                ring.push_back(GetVertex(mesh, maxLevel, x0, y0 + p));
+            }
+        }
+
+        if (ring.size() == 4)
+        {
+            // Same split as the fixed grid
+            uint32_t quad[] = { ring[0], ring[1], ring[3], ring[3], ring[1], ring[2] };
+            mesh->Indices.insert(mesh->Indices.end(), quad, quad + 6);
+        }
+        else
+        {
+            // Only leaves larger than the finest have finer neighbors, so the
+            // center is always a grid point
+            uint32_t center = GetVertex(mesh, maxLevel, x0 + size / 2, y0 + size / 2);
+            for (size_t i = 0; i < ring.size(); ++i)
+            {
+                mesh->Indices.push_back(center);
+                mesh->Indices.push_back(ring[i]);
+                mesh->Indices.push_back(ring[(i + 1) % ring.size()]);
+            }
+        }
+    }
+
+    mesh->NumCells = (uint32_t)mesh->Leaves.size();
+}
+
+//==============================================================================
+void AdaptiveWarpMeshBuild(const DepthPyramid& depth, const AdaptiveWarpMeshDesc& desc, AdaptiveWarpMesh* mesh)
+{
+    assert(desc.MinLevel <= desc.MaxLevel && desc.MaxLevel <= 12);
+
+    BuildDepthRanges(depth, desc.MaxLevel, mesh);
+
+    // Split the cells with the largest depth range first, so the budget goes
+    // where the fixed grid stretches the most
+    std::vector<AdaptiveWarpCell>& queue = mesh->Queue;
+    queue.clear();
+    mesh->Leaves.clear();
+
+    uint32_t minCells = 1u << desc.MinLevel;
+    for (uint32_t y = 0; y < minCells; ++y)
+    {
+        for (uint32_t x = 0; x < minCells; ++x)
+        {
+            queue.push_back(MakeCell(*mesh, desc.MinLevel, x, y));
+        }
+    }
+    std::make_heap(queue.begin(), queue.end());
+
+    uint32_t numCells = (uint32_t)queue.size();
+    while (!queue.empty())
+    {
+        std::pop_heap(queue.begin(), queue.end());
+        AdaptiveWarpCell cell = queue.back();
+        queue.pop_back();
+
+        bool split = cell.Level < desc.MaxLevel && cell.DepthRange > desc.DepthThreshold &&
+            (desc.MaxCells == 0 || numCells + 3 <= desc.MaxCells);
+        if (!split)
+        {
+            mesh->Leaves.push_back(cell);
+            continue;
+        }
+
+        for (uint32_t child = 0; child < 4; ++child)
+        {
+            queue.push_back(MakeCell(*mesh, cell.Level + 1u, cell.X * 2u + (child & 1), cell.Y * 2u + (child >> 1)));
+            std::push_heap(queue.begin(), queue.end());
+        }
+        numCells += 3;
+    }
+
+    Triangulate(desc.MaxLevel, mesh);
+}
+
+//==============================================================================
+void AdaptiveWarpMeshBuildUniform(uint32_t level, AdaptiveWarpMesh* mesh)
+{
+    assert(level <= 12);
+
+    uint32_t cells = 1u << level;
+    mesh->Leaves.clear();
+    for (uint32_t y = 0; y < cells; ++y)
+    {
+        for (uint32_t x = 0; x < cells; ++x)
+        {
+            AdaptiveWarpCell cell{};
+            cell.Level = (uint16_t)level;
+            cell.X = (uint16_t)x;
+            cell.Y = (uint16_t)y;
+            mesh->Leaves.push_back(cell);
+        }
+    }
+
+    Triangulate(level, mesh);
+}
+
+//==============================================================================
+uint32_t AdaptiveWarpMeshMaxVertices(uint32_t maxLevel)
+{
+    // Every vertex, cell centers included, is a point of the finest grid
+    uint32_t points = (1u << maxLevel) + 1;
+    return points * points;
+}
+
+//==============================================================================
+uint32_t AdaptiveWarpMeshMaxIndices(uint32_t maxLevel)
+{
+    // A planar triangulation of V points has fewer than 2V triangles
+    return AdaptiveWarpMeshMaxVertices(maxLevel) * 6;
+}
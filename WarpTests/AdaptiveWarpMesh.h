@@ -0,0 +1,72 @@
+//==============================================================================
+// Depth adaptive warp grid for the positional warp. The positional warp reads
+// one depth per grid vertex, so a depth edge falling between vertices gets
+// stretched across the whole cell. This rebuilds the grid per frame as a
+// quadtree over the source depth pyramid: cells spanning a large depth range
+// are split towards the edges, and flat regions are left coarse.
+//
+// The output uses the same vertex layout and winding as the fixed grid, so it
+// draws with the positional warp shaders unchanged. Leaves next to finer ones
+// are triangulated as fans through the neighbors' edge vertices, so there are
+// no T-junction cracks.
+//==============================================================================
+#pragma once
+
+#include "DepthPyramid.h"
+#include <stdint.h>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct AdaptiveWarpMeshDesc
+{
+    uint32_t MinLevel;      // Coarsest cells, 2^MinLevel per side
+    uint32_t MaxLevel;      // Finest cells, 2^MaxLevel per side
+    float DepthThreshold;   // Cells with a larger post-projection depth range are split
+    uint32_t MaxCells;      // Leaf budget, 0 for no limit
+};
+
+struct AdaptiveWarpVertex
+{
+    float TexCoord[2];
+};
+
+struct AdaptiveWarpCell
+{
+    float DepthRange;
+    uint16_t Level;
+    uint16_t X;
+    uint16_t Y;
+};
+
+struct AdaptiveWarpMesh
+{
+    std::vector<AdaptiveWarpVertex> Vertices;
+    std::vector<uint32_t> Indices;
+    uint32_t NumCells;
+
+    // Scratch reused between builds
+    std::vector<float> DepthMin;            // Per cell of every level, coarsest level first
+    std::vector<float> DepthMax;
+    std::vector<AdaptiveWarpCell> Queue;
+    std::vector<AdaptiveWarpCell> Leaves;
+    std::vector<uint32_t> Ring;
+    std::vector<uint8_t> LeafLevel;         // Per finest cell, level of the leaf covering it
+    std::vector<uint32_t> VertexIndex;      // Per finest grid point
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Rebuilds 'mesh' from the depth pyramid of the source frame
+void AdaptiveWarpMeshBuild(const DepthPyramid& depth, const AdaptiveWarpMeshDesc& desc, AdaptiveWarpMesh* mesh);
+
+// Regular grid of 2^level cells per side, with the fixed grid's triangulation
+void AdaptiveWarpMeshBuildUniform(uint32_t level, AdaptiveWarpMesh* mesh);
+
+// Upper bounds on the vertices and indices of any mesh with cells no finer
+// than 'maxLevel', for sizing buffers
+uint32_t AdaptiveWarpMeshMaxVertices(uint32_t maxLevel);
+uint32_t AdaptiveWarpMeshMaxIndices(uint32_t maxLevel);
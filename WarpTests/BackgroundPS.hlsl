@@ -0,0 +1,25 @@
+// Cube map environment at infinity, drawn beneath the warped frame with dest
+// over blending, so it shows wherever the warp left the target transparent.
+// Looked up at the display pose, the background has no rotational latency.
+TextureCube Environment;
+SamplerState Sampler;
+
+cbuffer Constants
+{
+    float4x4 InvViewProj;   // NDC to world, of which only rotation matters
+};
+
+struct VertexIn
+{
+    float4 Position : SV_POSITION;
+    float2 Ndc : TEXCOORD0;
+};
+
+float4 main(VertexIn input) : SV_TARGET
+{
+    // Far plane point less near plane point, which cancels any translation
+    float4 nearPoint = mul(InvViewProj, float4(input.Ndc, 0, 1));
+    float4 farPoint = mul(InvViewProj, float4(input.Ndc, 1, 1));
+    float3 direction = farPoint.xyz / farPoint.w - nearPoint.xyz / nearPoint.w;
+    return Environment.Sample(Sampler, direction);
+}
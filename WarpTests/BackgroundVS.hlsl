@@ -0,0 +1,20 @@
+// Full screen triangle for the cube map background and the compositor layers.
+// Their pixel shaders turn its NDC position into a view ray.
+struct VertexIn
+{
+    float2 Position : POSITION;
+};
+
+struct VertexOut
+{
+    float4 Position : SV_POSITION;
+    float2 Ndc : TEXCOORD0;
+};
+
+VertexOut main(VertexIn input)
+{
+    VertexOut output;
+    output.Position = float4(input.Position, 0, 1);
+    output.Ndc = input.Position;
+    return output;
+}
@@ -0,0 +1,490 @@
+//==============================================================================
+#include "BackwardWarp.h"
+#include "Parallel.h"
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Rows per ParallelFor chunk
+static const uint32_t RowGrain = 4;
+
+// Smallest source clip w kept on the ray, so its end points project
+static const float MinSourceW = 0.001f;
+
+// How far past a cell's edge, in pixels, a skip lands so it leaves the cell
+static const float CellEdgeEpsilon = 0.01f;
+
+// Ray parameter for an axis the segment doesn't move along
+static const float Never = 1e30f;
+
+// Times the hybrid classification narrows down where a tile's rays can start
+static const uint32_t ClassifyRounds = 2;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline const float* Row(const CpuTexture& texture, uint32_t y)
+{
+    return (const float*)(texture.Data + (size_t)y * texture.RowPitch);
+}
+
+// 2^e for integer valued 'e' in the float exponent range
+static inline SimdFloat Exp2Int(SimdFloat e)
+{
+    return SimdAsFloat(SimdIntAdd(SimdIntMul(SimdFtoi(e), SimdIntSet(1 << 23)), SimdIntSet(127 << 23)));
+}
+
+// Ray parameters where 'position' + u * 'delta' enters and leaves [0, size)
+static inline void ClipAxis(SimdFloat position, SimdFloat delta, float size, SimdFloat* enter, SimdFloat* exit)
+{
+    SimdFloat moving = SimdCmpGe(SimdAbs(delta), SimdSet(1e-6f));
+    SimdFloat inverse = SimdDiv(SimdSet(1.f), SimdSelect(moving, delta, SimdSet(1.f)));
+    SimdFloat a = SimdMul(SimdSub(SimdZero(), position), inverse);
+    SimdFloat b = SimdMul(SimdSub(SimdSet(size), position), inverse);
+    SimdFloat inside = SimdAnd(SimdCmpGe(position, SimdZero()), SimdCmpLt(position, SimdSet(size)));
+    *enter = SimdSelect(moving, SimdMin(a, b), SimdSelect(inside, SimdSet(-Never), SimdSet(Never)));
+    *exit = SimdSelect(moving, SimdMax(a, b), SimdSelect(inside, SimdSet(Never), SimdSet(-Never)));
+}
+
+// Ray parameter where 'position' + u * 'delta' leaves [cellMin, cellMax)
+static inline SimdFloat CellExit(SimdFloat position, SimdFloat delta, SimdFloat cellMin, SimdFloat cellMax)
+{
+    SimdFloat forward = SimdCmpGe(delta, SimdSet(1e-6f));
+    SimdFloat backward = SimdCmpLe(delta, SimdSet(-1e-6f));
+    SimdFloat edge = SimdSelect(forward, SimdAdd(cellMax, SimdSet(CellEdgeEpsilon)), SimdSub(cellMin, SimdSet(CellEdgeEpsilon)));
+    SimdFloat moving = SimdOr(forward, backward);
+    SimdFloat u = SimdDiv(SimdSub(edge, position), SimdSelect(moving, delta, SimdSet(1.f)));
+    return SimdSelect(moving, u, SimdSet(Never));
+}
+
+// Searches the rays of SimdWidth target pixels starting at (x, y), and samples
+// the color each finds. Without 'search' they take their far ends. A nonzero
+// 'threshold' blends to the far end's color by parallax, for the hybrid mode.
+static void WarpPixels(const CpuTexture& color, const CpuTexture& depth, const DepthPyramid& pyramid, const float* m,
+    const CpuSampler& sampler, bool search, float threshold, uint32_t x, uint32_t y, CpuTexture* target,
+    BackwardWarpStats* stats)
+{
+    uint32_t count = (target->Width - x) < SimdWidth ? (target->Width - x) : SimdWidth;
+    float width = (float)depth.Width;
+    float height = (float)depth.Height;
+    uint32_t topLevel = (uint32_t)pyramid.Levels.size() - 1;
+    float startLevel = (float)(BackwardWarpStartLevel < topLevel ? BackwardWarpStartLevel : topLevel);
+
+    // The whole frame's depth range bounds where a crossing can be
+    float frameMin = Row(pyramid.Levels[topLevel], 0)[0];
+
+    // Target NDC of the pixel centers
+    SimdFloat ndcX = SimdSub(SimdMul(SimdAdd(SimdSet(x + 0.5f), SimdLaneIndex()), SimdSet(2.f / width)), SimdSet(1.f));
+    SimdFloat ndcY = SimdSet(1.f - (y + 0.5f) * 2.f / height);
+
+    // Source clip space along the view ray is a + d * b, for target depth d
+    SimdFloat a[4];
+    SimdFloat b[4];
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        a[j] = SimdMad(ndcX, SimdSet(m[0 * 4 + j]), SimdMad(ndcY, SimdSet(m[1 * 4 + j]), SimdSet(m[3 * 4 + j])));
+        b[j] = SimdSet(m[2 * 4 + j]);
+    }
+
+    // Keep the part of the ray in front of the source view
+    SimdFloat d0 = SimdZero();
+    SimdFloat d1 = SimdSet(1.f);
+    SimdFloat dW = SimdDiv(SimdSub(SimdSet(MinSourceW), a[3]), SimdSelect(SimdCmpEq(b[3], SimdZero()), SimdSet(1.f), b[3]));
+    d0 = SimdSelect(SimdCmpLt(SimdZero(), b[3]), SimdMax(d0, dW), d0);
+    d1 = SimdSelect(SimdCmpLt(b[3], SimdZero()), SimdMin(d1, dW), d1);
+    SimdFloat valid = SimdCmpLt(d0, d1);
+    valid = SimdAnd(valid, SimdOr(SimdCmpNe(b[3], SimdZero()), SimdCmpGe(a[3], SimdSet(MinSourceW))));
+    valid = SimdAnd(valid, SimdFirstLanes(count));
+
+    // End points in source pixels and depth
+    SimdFloat p0[3];
+    SimdFloat p1[3];
+    for (uint32_t e = 0; e < 2; ++e)
+    {
+        SimdFloat d = e ? d1 : d0;
+        SimdFloat* p = e ? p1 : p0;
+        SimdFloat w = SimdSelect(valid, SimdMad(d, b[3], a[3]), SimdSet(1.f));
+        SimdFloat invW = SimdDiv(SimdSet(1.f), w);
+        p[0] = SimdMul(SimdMad(SimdMul(SimdMad(d, b[0], a[0]), invW), SimdSet(0.5f), SimdSet(0.5f)), SimdSet(width));
+        p[1] = SimdMul(SimdSub(SimdSet(0.5f), SimdMul(SimdMul(SimdMad(d, b[1], a[1]), invW), SimdSet(0.5f))), SimdSet(height));
+        p[2] = SimdMul(SimdMad(d, b[2], a[2]), invW);
+    }
+    SimdFloat dx = SimdSub(p1[0], p0[0]);
+    SimdFloat dy = SimdSub(p1[1], p0[1]);
+    SimdFloat dz = SimdSub(p1[2], p0[2]);
+    SimdFloat dzMoving = SimdCmpGe(SimdAbs(dz), SimdSet(1e-9f));
+    SimdFloat invDz = SimdDiv(SimdSet(1.f), SimdSelect(dzMoving, dz, SimdSet(1.f)));
+
+    // Nothing is crossed before the ray reaches the frame's min depth, or
+    // outside the frame
+    SimdFloat enterX, exitX, enterY, exitY;
+    ClipAxis(p0[0], dx, width, &enterX, &exitX);
+    ClipAxis(p0[1], dy, height, &enterY, &exitY);
+    SimdFloat uDepth = SimdSelect(SimdAnd(dzMoving, SimdCmpLt(SimdZero(), dz)), SimdMul(SimdSub(SimdSet(frameMin), p0[2]), invDz), SimdZero());
+    SimdFloat u = SimdMax(SimdMax(SimdZero(), uDepth), SimdMax(enterX, enterY));
+    SimdFloat uEnd = SimdMin(SimdSet(1.f), SimdMin(exitX, exitY));
+    SimdFloat level = SimdSet(startLevel);
+
+    SimdFloat active = search ? SimdAnd(valid, SimdCmpLe(u, uEnd)) : SimdZero();
+    SimdFloat hit = SimdZero();
+
+    alignas(32) float levels[SimdWidth];
+    alignas(32) int32_t cellX[SimdWidth];
+    alignas(32) int32_t cellY[SimdWidth];
+    alignas(32) float cellMin[SimdWidth];
+    alignas(32) float cellMax[SimdWidth];
+
+    uint32_t iteration = 0;
+    uint32_t activeBits = SimdMoveMask(active);
+    while (activeBits && iteration < BackwardWarpMaxIterations)
+    {
+        for (uint32_t i = activeBits; i; i &= i - 1)
+        {
+            ++stats->Iterations;
+        }
+        ++iteration;
+
+        // The cell holding the ray's current point. Level -1 is the depth
+        // buffer, and each level's last row and column reach the frame's edge.
+        SimdFloat px = SimdMad(u, dx, p0[0]);
+        SimdFloat py = SimdMad(u, dy, p0[1]);
+        SimdFloat shift = SimdAdd(level, SimdSet(1.f));
+        SimdFloat cellSize = Exp2Int(shift);
+        SimdFloat invCellSize = Exp2Int(SimdSub(SimdZero(), shift));
+        SimdInt shiftInt = SimdFtoi(shift);
+        SimdFloat lastX = SimdItof(SimdIntMax(SimdIntSub(SimdUintShr(SimdIntSet((int32_t)depth.Width), shiftInt), SimdIntSet(1)), SimdIntSet(0)));
+        SimdFloat lastY = SimdItof(SimdIntMax(SimdIntSub(SimdUintShr(SimdIntSet((int32_t)depth.Height), shiftInt), SimdIntSet(1)), SimdIntSet(0)));
+        SimdFloat cx = SimdMin(SimdMax(SimdFloor(SimdMul(px, invCellSize)), SimdZero()), lastX);
+        SimdFloat cy = SimdMin(SimdMax(SimdFloor(SimdMul(py, invCellSize)), SimdZero()), lastY);
+        SimdFloat x0 = SimdMul(cx, cellSize);
+        SimdFloat y0 = SimdMul(cy, cellSize);
+        SimdFloat x1 = SimdSelect(SimdCmpEq(cx, lastX), SimdSet(width), SimdAdd(x0, cellSize));
+        SimdFloat y1 = SimdSelect(SimdCmpEq(cy, lastY), SimdSet(height), SimdAdd(y0, cellSize));
+
+        // Gathered a lane at a time, since lanes sit at different levels
+        SimdStore(levels, level);
+        SimdIntStore(cellX, SimdFtoi(cx));
+        SimdIntStore(cellY, SimdFtoi(cy));
+        for (uint32_t i = 0; i < SimdWidth; ++i)
+        {
+            cellMin[i] = 0.f;
+            cellMax[i] = 0.f;
+            if (activeBits & (1u << i))
+            {
+                if (levels[i] < 0.f)
+                {
+                    cellMin[i] = cellMax[i] = Row(depth, cellY[i])[cellX[i]];
+                }
+                else
+                {
+                    const float* texel = Row(pyramid.Levels[(uint32_t)levels[i]], cellY[i]) + cellX[i] * 2;
+                    cellMin[i] = texel[0];
+                    cellMax[i] = texel[1];
+                }
+            }
+        }
+        SimdFloat minDepth = SimdLoad(cellMin);
+        SimdFloat maxDepth = SimdLoad(cellMax);
+
+        // The ray's depth over its part in the cell
+        SimdFloat uExit = SimdMin(CellExit(p0[0], dx, x0, x1), CellExit(p0[1], dy, y0, y1));
+        SimdFloat uLast = SimdMin(uExit, uEnd);
+        SimdFloat zFirst = SimdMad(u, dz, p0[2]);
+        SimdFloat zLast = SimdMad(uLast, dz, p0[2]);
+        SimdFloat rayMin = SimdMin(zFirst, zLast);
+        SimdFloat rayMax = SimdMax(zFirst, zLast);
+
+        // All in front of or all behind the cell can't cross it. Otherwise
+        // move up to where the ray's depth reaches the cell's range.
+        SimdFloat skip = SimdAnd(active, SimdOr(SimdCmpLt(rayMax, minDepth), SimdCmpLt(maxDepth, rayMin)));
+        SimdFloat inside = SimdAndNot(skip, active);
+        SimdFloat finest = SimdCmpLt(level, SimdZero());
+        SimdFloat reach = SimdMul(SimdSub(SimdSelect(SimdCmpLt(SimdZero(), dz), minDepth, maxDepth), p0[2]), invDz);
+        SimdFloat uInside = SimdMin(SimdMax(u, SimdSelect(dzMoving, reach, u)), uLast);
+
+        SimdFloat found = SimdAnd(inside, finest);
+        SimdFloat descend = SimdAndNot(finest, inside);
+        u = SimdSelect(skip, uExit, SimdSelect(inside, uInside, u));
+        level = SimdSelect(skip, SimdMin(SimdAdd(level, SimdSet(1.f)), SimdSet((float)topLevel)), level);
+        level = SimdSelect(descend, SimdSub(level, SimdSet(1.f)), level);
+
+        hit = SimdOr(hit, found);
+        active = SimdAndNot(found, active);
+        active = SimdAndNot(SimdAnd(skip, SimdCmpLt(uEnd, u)), active);
+        activeBits = SimdMoveMask(active);
+    }
+
+    // Unresolved rays settle for where they are, and misses take the far end
+    SimdFloat settled = SimdOr(hit, active);
+    u = SimdSelect(settled, u, SimdSet(1.f));
+    SimdFloat sx = SimdMul(SimdMad(u, dx, p0[0]), SimdSet(1.f / width));
+    SimdFloat sy = SimdMul(SimdMad(u, dy, p0[1]), SimdSet(1.f / height));
+    sx = SimdSelect(valid, sx, SimdSet(-1.f));
+    sy = SimdSelect(valid, sy, SimdSet(-1.f));
+
+    SimdFloat value[4];
+    CpuTextureSample(color, sampler, sx, sy, value);
+
+    // Under one threshold of parallax the rotational color is as good, and by
+    // two it has gone
+    if (search && threshold > 0.f)
+    {
+        SimdFloat parallax = SimdMul(SimdSub(SimdSet(1.f), u), SimdSqrt(SimdMad(dx, dx, SimdMul(dy, dy))));
+        SimdFloat weight = SimdMul(SimdSub(parallax, SimdSet(threshold)), SimdSet(1.f / threshold));
+        weight = SimdMin(SimdMax(weight, SimdZero()), SimdSet(1.f));
+
+        SimdFloat rotational[4];
+        SimdFloat rx = SimdSelect(valid, SimdMul(p1[0], SimdSet(1.f / width)), SimdSet(-1.f));
+        SimdFloat ry = SimdSelect(valid, SimdMul(p1[1], SimdSet(1.f / height)), SimdSet(-1.f));
+        CpuTextureSample(color, sampler, rx, ry, rotational);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            value[c] = SimdMad(weight, SimdSub(value[c], rotational[c]), rotational[c]);
+        }
+    }
+    CpuTextureStoreRow(target, x, y, count, SimdFirstLanes(count), value);
+
+    if (!search)
+    {
+        stats->Rotational += count;
+        return;
+    }
+
+    uint32_t hitBits = SimdMoveMask(hit);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t hitBit = (hitBits >> i) & 1;
+        uint32_t activeBit = (activeBits >> i) & 1;
+        stats->Hits += hitBit;
+        stats->Unresolved += activeBit;
+        stats->Misses += 1 - (hitBit | activeBit);
+    }
+}
+
+// End points in source pixels and depth of the ray through target NDC
+// (ndcX, ndcY), as WarpPixels finds them. False if it's all behind the source.
+static bool RaySegment(const float* m, float ndcX, float ndcY, float width, float height, float p0[3], float p1[3])
+{
+    float a[4];
+    float b[4];
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        a[j] = ndcX * m[0 * 4 + j] + ndcY * m[1 * 4 + j] + m[3 * 4 + j];
+        b[j] = m[2 * 4 + j];
+    }
+
+    float d0 = 0.f;
+    float d1 = 1.f;
+    if (b[3] != 0.f)
+    {
+        float dW = (MinSourceW - a[3]) / b[3];
+        d0 = (b[3] > 0.f) ? std::max(d0, dW) : d0;
+        d1 = (b[3] < 0.f) ? std::min(d1, dW) : d1;
+    }
+    else if (a[3] < MinSourceW)
+    {
+        return false;
+    }
+    if (!(d0 < d1))
+    {
+        return false;
+    }
+
+    for (uint32_t e = 0; e < 2; ++e)
+    {
+        float d = e ? d1 : d0;
+        float* p = e ? p1 : p0;
+        float invW = 1.f / (a[3] + d * b[3]);
+        p[0] = ((a[0] + d * b[0]) * invW * 0.5f + 0.5f) * width;
+        p[1] = (0.5f - (a[1] + d * b[1]) * invW * 0.5f) * height;
+        p[2] = (a[2] + d * b[2]) * invW;
+    }
+    return true;
+}
+
+// Where on a segment from RaySegment the source depth reaches 'z', in pixels.
+// Depth only grows along the ray with standard depth.
+static inline void SegmentPoint(const float p0[3], const float p1[3], float z, float point[2])
+{
+    float dz = p1[2] - p0[2];
+    float u = (dz > 1e-9f) ? std::min(std::max((z - p0[2]) / dz, 0.f), 1.f) : 0.f;
+    point[0] = p0[0] + u * (p1[0] - p0[0]);
+    point[1] = p0[1] + u * (p1[1] - p0[1]);
+}
+
+// Parallax bound in pixels of the tile with target pixels [x0, x1) x [y0, y1)
+static float ClassifyTile(const DepthPyramid& pyramid, const float* m, float frameMin, uint32_t x0, uint32_t y0,
+    uint32_t x1, uint32_t y1)
+{
+    float width = (float)pyramid.Width;
+    float height = (float)pyramid.Height;
+
+    // Every ray through the tile lies in the hull of its corners' rays, since
+    // at any one source depth the target maps to the source by a homography
+    float p0[4][3];
+    float p1[4][3];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        float ndcX = (float)((i & 1) ? x1 : x0) * 2.f / width - 1.f;
+        float ndcY = 1.f - (float)((i & 2) ? y1 : y0) * 2.f / height;
+        if (!RaySegment(m, ndcX, ndcY, width, height, p0[i], p1[i]))
+        {
+            return Never;
+        }
+    }
+
+    // No ray crosses a surface before the frame's min depth. The min depth of
+    // what the rays cover from there on bounds it tighter, twice over.
+    float startDepth = frameMin;
+    for (uint32_t round = 0; round < ClassifyRounds; ++round)
+    {
+        float boundsMin[2] = { Never, Never };
+        float boundsMax[2] = { -Never, -Never };
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            float start[2];
+            SegmentPoint(p0[i], p1[i], startDepth, start);
+            for (uint32_t j = 0; j < 2; ++j)
+            {
+                boundsMin[j] = std::min(boundsMin[j], std::min(start[j], p1[i][j]));
+                boundsMax[j] = std::max(boundsMax[j], std::max(start[j], p1[i][j]));
+            }
+        }
+
+        // Rays that stay outside the frame come out black either way
+        if (boundsMax[0] < 0.f || boundsMax[1] < 0.f || boundsMin[0] >= width || boundsMin[1] >= height)
+        {
+            return 0.f;
+        }
+        uint32_t qx0 = (uint32_t)std::max(boundsMin[0] - 1.f, 0.f);
+        uint32_t qy0 = (uint32_t)std::max(boundsMin[1] - 1.f, 0.f);
+        uint32_t qx1 = (uint32_t)std::min(boundsMax[0] + 2.f, width);
+        uint32_t qy1 = (uint32_t)std::min(boundsMax[1] + 2.f, height);
+
+        float minDepth, maxDepth;
+        DepthPyramidQuery(pyramid, qx0, qy0, qx1, qy1, &minDepth, &maxDepth);
+        startDepth = std::max(startDepth, minDepth);
+    }
+
+    // How far the first possible crossing is from the far end
+    float parallax = 0.f;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        float start[2];
+        SegmentPoint(p0[i], p1[i], startDepth, start);
+        float dx = p1[i][0] - start[0];
+        float dy = p1[i][1] - start[1];
+        parallax = std::max(parallax, sqrtf(dx * dx + dy * dy));
+    }
+    return parallax;
+}
+
+//==============================================================================
+bool BackwardWarpTilesCreate(uint32_t width, uint32_t height, BackwardWarpTiles* tiles)
+{
+    if (width == 0 || height == 0)
+    {
+        assert(false);
+        return false;
+    }
+
+    tiles->TilesX = (width + BackwardWarpTileSize - 1) / BackwardWarpTileSize;
+    tiles->TilesY = (height + BackwardWarpTileSize - 1) / BackwardWarpTileSize;
+    tiles->Threshold = 0.f;
+    tiles->Parallax.assign((size_t)tiles->TilesX * tiles->TilesY, 0.f);
+    tiles->NumPositional = 0;
+    return true;
+}
+
+//==============================================================================
+void BackwardWarpTilesDestroy(BackwardWarpTiles* tiles)
+{
+    *tiles = BackwardWarpTiles{};
+}
+
+//==============================================================================
+void BackwardWarpClassify(const DepthPyramid& pyramid, const float inverseMatrix[16], float threshold,
+    BackwardWarpTiles* tiles)
+{
+    assert(tiles->TilesX == (pyramid.Width + BackwardWarpTileSize - 1) / BackwardWarpTileSize);
+    assert(tiles->TilesY == (pyramid.Height + BackwardWarpTileSize - 1) / BackwardWarpTileSize);
+    assert(threshold > 0.f);
+
+    float frameMin = Row(pyramid.Levels.back(), 0)[0];
+    std::atomic<uint32_t> positional(0);
+
+    ParallelFor(tiles->TilesY, 1, [&](uint32_t ty0, uint32_t ty1)
+    {
+        uint32_t rows = 0;
+        for (uint32_t ty = ty0; ty < ty1; ++ty)
+        {
+            uint32_t y0 = ty * BackwardWarpTileSize;
+            uint32_t y1 = std::min(y0 + BackwardWarpTileSize, pyramid.Height);
+            for (uint32_t tx = 0; tx < tiles->TilesX; ++tx)
+            {
+                uint32_t x0 = tx * BackwardWarpTileSize;
+                uint32_t x1 = std::min(x0 + BackwardWarpTileSize, pyramid.Width);
+                float parallax = ClassifyTile(pyramid, inverseMatrix, frameMin, x0, y0, x1, y1);
+                tiles->Parallax[ty * tiles->TilesX + tx] = parallax;
+                rows += (parallax > threshold) ? 1 : 0;
+            }
+        }
+        positional += rows;
+    });
+
+    tiles->Threshold = threshold;
+    tiles->NumPositional = positional;
+}
+
+//==============================================================================
+void BackwardWarp(const CpuTexture& color, const CpuTexture& depth, const DepthPyramid& pyramid,
+    const float inverseMatrix[16], const CpuSampler& sampler, const BackwardWarpTiles* tiles, CpuTexture* target,
+    BackwardWarpStats* stats)
+{
+    assert(depth.Format == CpuFormat::R32Float && target->Format == CpuFormat::R8G8B8A8Unorm);
+    assert(depth.Width == target->Width && depth.Height == target->Height);
+    assert(pyramid.Width == depth.Width && pyramid.Height == depth.Height);
+    assert(!tiles || (tiles->TilesX == (depth.Width + BackwardWarpTileSize - 1) / BackwardWarpTileSize &&
+        tiles->TilesY == (depth.Height + BackwardWarpTileSize - 1) / BackwardWarpTileSize));
+    static_assert(BackwardWarpTileSize % SimdWidth == 0, "SIMD runs must not straddle tiles");
+
+    std::atomic<uint64_t> iterations(0);
+    std::atomic<uint32_t> hits(0);
+    std::atomic<uint32_t> misses(0);
+    std::atomic<uint32_t> unresolved(0);
+    std::atomic<uint32_t> rotational(0);
+    float threshold = tiles ? tiles->Threshold : 0.f;
+
+    ParallelFor(target->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        BackwardWarpStats rows{};
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            const float* parallax = tiles ? &tiles->Parallax[(y / BackwardWarpTileSize) * tiles->TilesX] : nullptr;
+            for (uint32_t x = 0; x < target->Width; x += SimdWidth)
+            {
+                bool search = !tiles || parallax[x / BackwardWarpTileSize] > threshold;
+                WarpPixels(color, depth, pyramid, inverseMatrix, sampler, search, threshold, x, y, target, &rows);
+            }
+        }
+        iterations += rows.Iterations;
+        hits += rows.Hits;
+        misses += rows.Misses;
+        unresolved += rows.Unresolved;
+        rotational += rows.Rotational;
+    });
+
+    if (stats)
+    {
+        stats->Iterations = iterations;
+        stats->Hits = hits;
+        stats->Misses = misses;
+        stats->Unresolved = unresolved;
+        stats->Rotational = rotational;
+    }
+}
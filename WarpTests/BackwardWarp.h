@@ -0,0 +1,94 @@
+//==============================================================================
+// Per-pixel backward positional warp. Rather than moving a grid over the app
+// frame, every target pixel searches the app frame for the surface its view
+// ray hits. The ray projects into the app frame as a segment of the epipolar
+// line, from the target near plane to the target far plane. Along it both the
+// source pixel position and the source post-projection depth are affine, so
+// the search is a 2D line march against the depth buffer as a height field.
+//
+// The march is hierarchical over the min/max depth pyramid (see
+// DepthPyramid.h). Each step tests the part of the segment inside one cell of
+// some level. When the ray stays in front of the cell's min depth, or behind
+// its max depth, it can't cross a surface there, so the step moves on to the
+// cell's exit and up a level. Otherwise it moves down a level, until a
+// crossing is found at a depth texel. Rays that pass behind a foreground
+// surface keep marching, so disocclusions resolve to what lies behind it.
+//
+// Rays that reach the far plane without a crossing take the far plane
+// direction's color, and rays that leave the app frame come out black, as the
+// border sampler does for the grid warp. Expects standard depth.
+//
+// The hybrid mode only searches where it has to. The far end of every ray's
+// segment is where a rotation-only warp samples, which is right wherever depth
+// moves content by little. Target tiles are classified by a bound on how far
+// depth can move their pixels from there (BackwardWarpClassify), and tiles
+// under the threshold take the far end without a search. Searched pixels blend
+// from the rotational sample to the positional one as their own parallax goes
+// from one to two thresholds, so there is no seam where tiles change mode.
+//
+// BackwardWarpCS.hlsl runs the same search and classification on the GPU.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include "DepthPyramid.h"
+#include <stdint.h>
+#include <vector>
+
+//==============================================================================
+// Constants
+//==============================================================================
+// Steps per ray before the search settles for where it is
+static const uint32_t BackwardWarpMaxIterations = 96;
+
+// Pyramid level each search starts at. Skipping a cell moves up a level.
+static const uint32_t BackwardWarpStartLevel = 3;
+
+// Side of a hybrid mode tile, in target pixels. A multiple of SimdWidth, and
+// the thread group size of BackwardWarpCS.hlsl.
+static const uint32_t BackwardWarpTileSize = 16;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct BackwardWarpStats
+{
+    uint64_t Iterations;    // Summed over every pixel
+    uint32_t Hits;          // Crossings found at a depth texel
+    uint32_t Misses;        // Reached the far plane or left the app frame
+    uint32_t Unresolved;    // Still searching at BackwardWarpMaxIterations
+    uint32_t Rotational;    // Took the far end in a tile that wasn't searched
+};
+
+// Hybrid mode classification of the target, in BackwardWarpTileSize tiles
+struct BackwardWarpTiles
+{
+    uint32_t TilesX;
+    uint32_t TilesY;
+    float Threshold;                // Parallax in pixels a tile may have unsearched
+    std::vector<float> Parallax;    // Per tile, bound in pixels on the whole tile
+    uint32_t NumPositional;         // Tiles over the threshold, so searched
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Sizes 'tiles' for a 'width' x 'height' target
+bool BackwardWarpTilesCreate(uint32_t width, uint32_t height, BackwardWarpTiles* tiles);
+void BackwardWarpTilesDestroy(BackwardWarpTiles* tiles);
+
+// Bounds every tile's parallax for the warp 'inverseMatrix', from where the
+// pyramid says its rays can first cross a surface, and counts the tiles over
+// 'threshold' pixels
+void BackwardWarpClassify(const DepthPyramid& pyramid, const float inverseMatrix[16], float threshold,
+    BackwardWarpTiles* tiles);
+
+// Warps 'color' into 'target' (R8G8B8A8Unorm), each the size of 'depth'.
+// 'inverseMatrix' is the inverse of the positional warp, from target NDC and
+// depth to source clip space (row vectors), and 'pyramid' is built from
+// 'depth'. 'tiles' classified for the same warp selects the hybrid mode, and
+// null searches every pixel. 'stats' may be null.
+void BackwardWarp(const CpuTexture& color, const CpuTexture& depth, const DepthPyramid& pyramid,
+    const float inverseMatrix[16], const CpuSampler& sampler, const BackwardWarpTiles* tiles, CpuTexture* target,
+    BackwardWarpStats* stats);
@@ -0,0 +1,269 @@
+// Per-pixel backward positional warp (see BackwardWarp.h). One thread per
+// target pixel searches the app frame along its view ray's epipolar segment,
+// hierarchically over the min/max depth pyramid, and samples the color there.
+// With a parallax threshold each thread group is a hybrid mode tile, which one
+// thread classifies first, and unsearched tiles take their rays' far ends.
+Texture2D<float4> SourceColor;
+Texture2D<float> SourceDepth;
+Texture2D<float2> DepthPyramid;     // Every level, as mips
+RWTexture2D<unorm float4> Target;
+SamplerState Sampler;
+
+cbuffer Constants
+{
+    float4x4 InverseWarp;   // Target NDC and depth to source clip space
+    uint2 Size;             // Of the source and target
+    uint NumLevels;         // In the pyramid
+    uint MaxIterations;
+    uint StartLevel;
+    float Threshold;        // Hybrid mode parallax in pixels, or 0 to search all
+};
+
+static const uint TileSize = 16;        // BackwardWarpTileSize
+static const uint ClassifyRounds = 2;
+static const uint MaxQueryTexels = 4;
+
+static const float MinSourceW = 0.001f;
+static const float CellEdgeEpsilon = 0.01f;
+static const float Never = 1e30f;
+
+// Ray parameters where 'position' + u * 'delta' enters and leaves [0, size)
+float2 ClipAxis(float position, float delta, float size)
+{
+    if (abs(delta) < 1e-6f)
+    {
+        bool inside = position >= 0 && position < size;
+        return inside ? float2(-Never, Never) : float2(Never, -Never);
+    }
+    float a = -position / delta;
+    float b = (size - position) / delta;
+    return float2(min(a, b), max(a, b));
+}
+
+// Ray parameter where 'position' + u * 'delta' leaves [cellMin, cellMax)
+float CellExit(float position, float delta, float cellMin, float cellMax)
+{
+    if (abs(delta) < 1e-6f)
+    {
+        return Never;
+    }
+    float edge = (delta > 0) ? cellMax + CellEdgeEpsilon : cellMin - CellEdgeEpsilon;
+    return (edge - position) / delta;
+}
+
+groupshared float TileParallax;
+
+// End points in source pixels and depth of the ray through target NDC 'ndc'.
+// False if it's all behind the source.
+bool RaySegment(float2 ndc, out float3 p0, out float3 p1)
+{
+    // Source clip space along the view ray is a + d * b, for target depth d
+    float2 size = float2(Size);
+    float4 a = mul(InverseWarp, float4(ndc, 0, 1));
+    float4 b = mul(InverseWarp, float4(ndc, 1, 1)) - a;
+
+    // Keep the part of the ray in front of the source view
+    float d0 = 0;
+    float d1 = 1;
+    bool valid = true;
+    if (b.w != 0)
+    {
+        float dW = (MinSourceW - a.w) / b.w;
+        d0 = (b.w > 0) ? max(d0, dW) : d0;
+        d1 = (b.w < 0) ? min(d1, dW) : d1;
+    }
+    else
+    {
+        valid = a.w >= MinSourceW;
+    }
+    valid = valid && d0 < d1;
+
+    float4 h0 = a + d0 * b;
+    float4 h1 = a + d1 * b;
+    h0 = valid ? h0 : float4(0, 0, 0, 1);
+    h1 = valid ? h1 : float4(0, 0, 0, 1);
+    p0 = float3((h0.x / h0.w * 0.5f + 0.5f) * size.x, (0.5f - h0.y / h0.w * 0.5f) * size.y, h0.z / h0.w);
+    p1 = float3((h1.x / h1.w * 0.5f + 0.5f) * size.x, (0.5f - h1.y / h1.w * 0.5f) * size.y, h1.z / h1.w);
+    return valid;
+}
+
+// Where on a segment from RaySegment the source depth reaches 'z', in pixels
+float2 SegmentPoint(float3 p0, float3 p1, float z)
+{
+    float dz = p1.z - p0.z;
+    float u = (dz > 1e-9f) ? saturate((z - p0.z) / dz) : 0;
+    return lerp(p0.xy, p1.xy, u);
+}
+
+// Min depth over depth texels [p0, p1), as DepthPyramidQuery
+float QueryMinDepth(uint2 p0, uint2 p1)
+{
+    for (uint level = 0; level < NumLevels; ++level)
+    {
+        uint shift = level + 1;
+        uint2 last = max(Size >> shift, 1u) - 1;
+        uint2 t0 = min(p0 >> shift, last);
+        uint2 t1 = min((p1 - 1) >> shift, last);
+        if (all(t1 - t0 < MaxQueryTexels))
+        {
+            float result = DepthPyramid.Load(int3(t0, level)).x;
+            for (uint y = t0.y; y <= t1.y; ++y)
+            {
+                for (uint x = t0.x; x <= t1.x; ++x)
+                {
+                    result = min(result, DepthPyramid.Load(int3(x, y, level)).x);
+                }
+            }
+            return result;
+        }
+    }
+    return 0;
+}
+
+// Parallax bound in pixels of the tile with target pixels [tile0, tile1), as
+// ClassifyTile in BackwardWarp.cpp
+float ClassifyTile(uint2 tile0, uint2 tile1, float frameMin)
+{
+    float2 size = float2(Size);
+    float3 p0[4];
+    float3 p1[4];
+    for (uint i = 0; i < 4; ++i)
+    {
+        float2 corner = float2((i & 1) ? tile1.x : tile0.x, (i & 2) ? tile1.y : tile0.y);
+        if (!RaySegment(float2(corner.x * 2 / size.x - 1, 1 - corner.y * 2 / size.y), p0[i], p1[i]))
+        {
+            return Never;
+        }
+    }
+
+    float startDepth = frameMin;
+    for (uint narrowing = 0; narrowing < ClassifyRounds; ++narrowing)
+    {
+        float2 boundsMin = Never;
+        float2 boundsMax = -Never;
+        for (uint i = 0; i < 4; ++i)
+        {
+            float2 start = SegmentPoint(p0[i], p1[i], startDepth);
+            boundsMin = min(boundsMin, min(start, p1[i].xy));
+            boundsMax = max(boundsMax, max(start, p1[i].xy));
+        }
+
+        // Rays that stay outside the frame come out black either way
+        if (any(boundsMax < 0) || any(boundsMin >= size))
+        {
+            return 0;
+        }
+        uint2 q0 = (uint2)max(boundsMin - 1, 0);
+        uint2 q1 = (uint2)min(boundsMax + 2, size);
+        startDepth = max(startDepth, QueryMinDepth(q0, q1));
+    }
+
+    float parallax = 0;
+    for (uint i = 0; i < 4; ++i)
+    {
+        parallax = max(parallax, length(p1[i].xy - SegmentPoint(p0[i], p1[i], startDepth)));
+    }
+    return parallax;
+}
+
+[numthreads(TileSize, TileSize, 1)]
+void main(uint3 id : SV_DispatchThreadID, uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    float2 size = float2(Size);
+    int topLevel = (int)NumLevels - 1;
+    float frameMin = DepthPyramid.Load(int3(0, 0, topLevel)).x;
+
+    // Every thread reaches the barrier, even past the edge
+    if (groupIndex == 0)
+    {
+        uint2 tile0 = groupId.xy * TileSize;
+        TileParallax = (Threshold > 0) ? ClassifyTile(tile0, min(tile0 + TileSize, Size), frameMin) : Never;
+    }
+    GroupMemoryBarrierWithGroupSync();
+    if (any(id.xy >= Size))
+    {
+        return;
+    }
+    bool search = TileParallax > Threshold;
+
+    float2 ndc = float2((id.x + 0.5f) * 2 / size.x - 1, 1 - (id.y + 0.5f) * 2 / size.y);
+    float3 p0;
+    float3 p1;
+    bool valid = RaySegment(ndc, p0, p1);
+    float3 delta = p1 - p0;
+    bool depthMoving = abs(delta.z) >= 1e-9f;
+    float invDeltaZ = depthMoving ? 1 / delta.z : 1;
+
+    // Nothing is crossed before the ray reaches the frame's min depth, or
+    // outside the frame
+    float2 clipX = ClipAxis(p0.x, delta.x, size.x);
+    float2 clipY = ClipAxis(p0.y, delta.y, size.y);
+    float uDepth = (depthMoving && delta.z > 0) ? (frameMin - p0.z) * invDeltaZ : 0;
+    float u = max(max(0, uDepth), max(clipX.x, clipY.x));
+    float uEnd = min(1, min(clipX.y, clipY.y));
+    int level = min((int)StartLevel, topLevel);
+
+    bool active = search && valid && u <= uEnd;
+    bool hit = false;
+    for (uint i = 0; i < MaxIterations && active; ++i)
+    {
+        // The cell holding the ray's current point. Level -1 is the depth
+        // buffer, and each level's last row and column reach the frame's edge.
+        float2 p = p0.xy + u * delta.xy;
+        uint shift = (uint)(level + 1);
+        float cellSize = (float)(1u << shift);
+        float2 last = float2(max(Size >> shift, 1u) - 1);
+        float2 cell = min(max(floor(p / cellSize), 0), last);
+        float2 cellMin = cell * cellSize;
+        float2 cellMax = float2(cell.x == last.x ? size.x : cellMin.x + cellSize, cell.y == last.y ? size.y : cellMin.y + cellSize);
+
+        float2 depthRange;
+        [branch]
+        if (level < 0)
+        {
+            depthRange = SourceDepth.Load(int3(int2(cell), 0)).xx;
+        }
+        else
+        {
+            depthRange = DepthPyramid.Load(int3(int2(cell), level));
+        }
+
+        // The ray's depth over its part in the cell
+        float uExit = min(CellExit(p0.x, delta.x, cellMin.x, cellMax.x), CellExit(p0.y, delta.y, cellMin.y, cellMax.y));
+        float uLast = min(uExit, uEnd);
+        float zFirst = p0.z + u * delta.z;
+        float zLast = p0.z + uLast * delta.z;
+
+        // All in front of or all behind the cell can't cross it. Otherwise
+        // move up to where the ray's depth reaches the cell's range.
+        if (max(zFirst, zLast) < depthRange.x || depthRange.y < min(zFirst, zLast))
+        {
+            u = uExit;
+            level = min(level + 1, topLevel);
+            active = u <= uEnd;
+        }
+        else
+        {
+            float reach = ((delta.z > 0 ? depthRange.x : depthRange.y) - p0.z) * invDeltaZ;
+            u = min(max(u, depthMoving ? reach : u), uLast);
+            hit = level < 0;
+            active = !hit;
+            level -= 1;
+        }
+    }
+
+    // Unresolved rays settle for where they are, and misses take the far end
+    u = (hit || active) ? u : 1;
+    float2 texCoord = valid ? (p0.xy + u * delta.xy) / size : float2(-1, -1);
+    float4 color = SourceColor.SampleLevel(Sampler, texCoord, 0);
+
+    // Under one threshold of parallax the rotational color is as good, and by
+    // two it has gone
+    if (search && Threshold > 0)
+    {
+        float weight = saturate(((1 - u) * length(delta.xy) - Threshold) / Threshold);
+        float2 rotationalCoord = valid ? p1.xy / size : float2(-1, -1);
+        color = lerp(SourceColor.SampleLevel(Sampler, rotationalCoord, 0), color, weight);
+    }
+    Target[id.xy] = color;
+}
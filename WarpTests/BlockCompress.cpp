@@ -0,0 +1,1250 @@
+//==============================================================================
+#include "BlockCompress.h"
+#include "Parallel.h"
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// Bit fields of one BC7 mode, in the order they're stored
+struct Bc7Mode
+{
+    uint32_t Subsets;
+    uint32_t PartitionBits;
+    uint32_t RotationBits;
+    uint32_t IndexSelectionBits;
+    uint32_t ColorBits;
+    uint32_t AlphaBits;             // 0 for opaque modes
+    uint32_t EndpointPBits;         // One low bit per endpoint
+    uint32_t SharedPBits;           // One low bit per subset
+    uint32_t IndexBits;
+    uint32_t SecondaryIndexBits;    // Modes 4 and 5 index color and alpha apart
+};
+
+// A BC7 block's endpoints, and where its indices start
+struct Bc7Block
+{
+    const Bc7Mode* Mode;            // Null for the reserved mode, which reads as 0
+    uint32_t Partition;
+    uint32_t Rotation;
+    uint32_t IndexSelection;
+    uint8_t Endpoints[3][2][4];     // [subset][endpoint][channel]
+    uint32_t IndexOffset;
+    uint32_t SecondaryIndexOffset;
+};
+
+// One block's texels as floats, a register per channel per row of 4 texels
+struct BlockTexels
+{
+    __m128 Values[4][4];            // [channel][row]
+    __m128 Weights[4];              // 0 for BC1's transparent texels, else 1
+    uint32_t Transparent;           // A bit per BC1 transparent texel
+};
+
+// How a BC1 color block is read
+enum class ColorMode
+{
+    Opaque,                         // BC1, 4 colors
+    Transparent,                    // BC1, 3 colors and transparent black
+    Bc3,                            // Always 4 colors, whatever the endpoint order
+};
+
+struct Bc1Fit
+{
+    float Error;
+    uint16_t Colors[2];
+    bool FourColor;
+    uint8_t Indices[16];
+};
+
+struct Bc7Mode6Fit
+{
+    float Error;
+    uint8_t Endpoints[2][4];        // 7 bits, below the P bit
+    uint8_t PBits[2];
+    uint8_t Indices[16];
+};
+
+struct Bc7Mode5Fit
+{
+    float ColorError;
+    float AlphaError;
+    uint8_t Color[2][3];            // 7 bits
+    uint8_t Alpha[2];
+    uint8_t ColorIndices[16];
+    uint8_t AlphaIndices[16];
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Least-squares refits of the endpoints after the first guess, stopping early
+// once one doesn't help
+static const uint32_t RefitPasses = 2;
+static const uint32_t PowerIterations = 8;
+
+static const Bc7Mode Bc7Modes[8] = {
+    // Subsets, bits of partition, rotation, index selection, color, alpha, P per endpoint, P per subset, indices
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// Interpolation weights out of 64, by index bits
+static const uint8_t Bc7Weights2[4] = { 0, 21, 43, 64 };
+static const uint8_t Bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8_t Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Subset of each texel, in row order, for the partitions of 2 subsets a bit
+// per texel, and of 3 subsets 2 bits per texel
+static const uint16_t Bc7Partitions2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+static const uint32_t Bc7Partitions3[64] = {
+    0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050,
+    0x5555a0a0, 0x5a5a5050, 0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090,
+    0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250, 0xa5945040, 0x0a425054,
+    0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+    0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414,
+    0x50a4a450, 0x6a5a0200, 0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424,
+    0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50, 0x500aa550, 0xaaaa4444,
+    0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+    0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580,
+    0xaa141414, 0x96960000, 0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000,
+    0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+};
+
+// The texel of each subset past the first whose index drops its top bit.
+// Subset 0's is always texel 0.
+static const uint8_t Bc7Anchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+};
+
+static const uint8_t Bc7Anchors3Second[64] = {
+    3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+    3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+    8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+    3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+};
+
+static const uint8_t Bc7Anchors3Third[64] = {
+    15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+    15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+    15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline float HorizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+
+static inline float HorizontalMin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_min_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+
+static inline float HorizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+
+static inline float Clamp255(float value)
+{
+    return value < 0.f ? 0.f : (value > 255.f ? 255.f : value);
+}
+
+// Up to 8 bits of a 16 byte block, from bit 0 of byte 0 up
+static inline uint32_t ReadBits(const uint8_t* block, uint32_t offset, uint32_t count)
+{
+    uint32_t byte = offset >> 3;
+    uint32_t bits = block[byte] | ((byte + 1 < 16) ? (uint32_t)block[byte + 1] << 8 : 0);
+    return (bits >> (offset & 7)) & ((1u << count) - 1);
+}
+
+static inline void WriteBits(uint64_t bits[2], uint32_t* offset, uint32_t value, uint32_t count)
+{
+    uint32_t at = *offset;
+    if (at < 64)
+    {
+        bits[0] |= (uint64_t)value << at;
+        if (at + count > 64)
+        {
+            bits[1] |= (uint64_t)value >> (64 - at);
+        }
+    }
+    else
+    {
+        bits[1] |= (uint64_t)value << (at - 64);
+    }
+    *offset = at + count;
+}
+
+static inline const uint8_t* Bc7Weights(uint32_t indexBits)
+{
+    return (indexBits == 2) ? Bc7Weights2 : ((indexBits == 3) ? Bc7Weights3 : Bc7Weights4);
+}
+
+static inline uint8_t Bc7Interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+{
+    return (uint8_t)(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+//==============================================================================
+// Decoding
+//==============================================================================
+static inline void Unpack565(uint32_t color, uint32_t out[3])
+{
+    uint32_t r = (color >> 11) & 31;
+    uint32_t g = (color >> 5) & 63;
+    uint32_t b = color & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// Four colors, or three and transparent black
+static void Bc1Palette(uint32_t c0, uint32_t c1, bool fourColor, uint8_t palette[4][4])
+{
+    uint32_t e0[3], e1[3];
+    Unpack565(c0, e0);
+    Unpack565(c1, e1);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        palette[0][c] = (uint8_t)e0[c];
+        palette[1][c] = (uint8_t)e1[c];
+        palette[2][c] = (uint8_t)(fourColor ? (2 * e0[c] + e1[c] + 1) / 3 : (e0[c] + e1[c] + 1) / 2);
+        palette[3][c] = (uint8_t)(fourColor ? (e0[c] + 2 * e1[c] + 1) / 3 : 0);
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = fourColor ? 255 : 0;
+}
+
+// Eight values from a0 to a1, or when a0 <= a1, six and then 0 and 255
+static void Bc3AlphaPalette(uint32_t a0, uint32_t a1, uint8_t palette[8])
+{
+    palette[0] = (uint8_t)a0;
+    palette[1] = (uint8_t)a1;
+    if (a0 > a1)
+    {
+        for (uint32_t i = 1; i < 7; ++i)
+        {
+            palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 1; i < 5; ++i)
+        {
+            palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// BC3's color half is always 4 colors
+static void UnpackBc1(const uint8_t* block, bool bc3, uint8_t palette[4][4], uint32_t* indices)
+{
+    uint32_t c0 = block[0] | ((uint32_t)block[1] << 8);
+    uint32_t c1 = block[2] | ((uint32_t)block[3] << 8);
+    Bc1Palette(c0, c1, bc3 || c0 > c1, palette);
+    memcpy(indices, block + 4, 4);
+}
+
+static void UnpackBc3Alpha(const uint8_t* block, uint8_t palette[8], uint64_t* indices)
+{
+    Bc3AlphaPalette(block[0], block[1], palette);
+    *indices = 0;
+    memcpy(indices, block + 2, 6);
+}
+
+static void UnpackBc7(const uint8_t* block, Bc7Block* unpacked)
+{
+    uint32_t mode = 0;
+    while (mode < 8 && !(block[0] & (1u << mode)))
+    {
+        ++mode;
+    }
+    if (mode == 8)
+    {
+        unpacked->Mode = nullptr;
+        return;
+    }
+
+    const Bc7Mode& m = Bc7Modes[mode];
+    uint32_t offset = mode + 1;
+    unpacked->Mode = &m;
+    unpacked->Partition = ReadBits(block, offset, m.PartitionBits);
+    offset += m.PartitionBits;
+    unpacked->Rotation = ReadBits(block, offset, m.RotationBits);
+    offset += m.RotationBits;
+    unpacked->IndexSelection = ReadBits(block, offset, m.IndexSelectionBits);
+    offset += m.IndexSelectionBits;
+
+    uint32_t raw[3][2][4]{};
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        uint32_t bits = (c < 3) ? m.ColorBits : m.AlphaBits;
+        for (uint32_t s = 0; s < m.Subsets; ++s)
+        {
+            for (uint32_t e = 0; e < 2; ++e)
+            {
+                raw[s][e][c] = ReadBits(block, offset, bits);
+                offset += bits;
+            }
+        }
+    }
+
+    uint32_t pbits[3][2]{};
+    for (uint32_t s = 0; s < m.Subsets && m.EndpointPBits; ++s)
+    {
+        pbits[s][0] = ReadBits(block, offset++, 1);
+        pbits[s][1] = ReadBits(block, offset++, 1);
+    }
+    for (uint32_t s = 0; s < m.Subsets && m.SharedPBits; ++s)
+    {
+        pbits[s][0] = pbits[s][1] = ReadBits(block, offset++, 1);
+    }
+
+    // Low bit under the stored ones, then the top bits repeated below to 8
+    bool hasPBits = m.EndpointPBits || m.SharedPBits;
+    for (uint32_t s = 0; s < m.Subsets; ++s)
+    {
+        for (uint32_t e = 0; e < 2; ++e)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                uint32_t bits = (c < 3) ? m.ColorBits : m.AlphaBits;
+                uint32_t value = raw[s][e][c];
+                if (bits == 0)
+                {
+                    unpacked->Endpoints[s][e][c] = 255;
+                    continue;
+                }
+                if (hasPBits)
+                {
+                    value = (value << 1) | pbits[s][e];
+                    ++bits;
+                }
+                value <<= 8 - bits;
+                unpacked->Endpoints[s][e][c] = (uint8_t)(value | (value >> bits));
+            }
+        }
+    }
+
+    unpacked->IndexOffset = offset;
+    unpacked->SecondaryIndexOffset = offset + 16 * m.IndexBits - m.Subsets;
+}
+
+static void Bc7Texel(const uint8_t* block, const Bc7Block& unpacked, uint32_t index, uint8_t out[4])
+{
+    if (!unpacked.Mode)
+    {
+        memset(out, 0, 4);
+        return;
+    }
+    const Bc7Mode& m = *unpacked.Mode;
+
+    // Each anchor texel before this one, and this one if it's an anchor, has
+    // one index bit fewer
+    uint32_t subset = 0;
+    uint32_t anchorsBefore = (index > 0) ? 1 : 0;
+    uint32_t isAnchor = (index == 0) ? 1 : 0;
+    if (m.Subsets == 2)
+    {
+        uint32_t anchor = Bc7Anchors2[unpacked.Partition];
+        subset = (Bc7Partitions2[unpacked.Partition] >> index) & 1;
+        anchorsBefore += (anchor < index) ? 1 : 0;
+        isAnchor |= (anchor == index) ? 1 : 0;
+    }
+    else if (m.Subsets == 3)
+    {
+        uint32_t second = Bc7Anchors3Second[unpacked.Partition];
+        uint32_t third = Bc7Anchors3Third[unpacked.Partition];
+        subset = (Bc7Partitions3[unpacked.Partition] >> (index * 2)) & 3;
+        anchorsBefore += ((second < index) ? 1 : 0) + ((third < index) ? 1 : 0);
+        isAnchor |= (second == index || third == index) ? 1 : 0;
+    }
+
+    const uint8_t* e0 = unpacked.Endpoints[subset][0];
+    const uint8_t* e1 = unpacked.Endpoints[subset][1];
+    uint32_t primary = ReadBits(block, unpacked.IndexOffset + index * m.IndexBits - anchorsBefore, m.IndexBits - isAnchor);
+    uint32_t colorWeight = Bc7Weights(m.IndexBits)[primary];
+    uint32_t alphaWeight = colorWeight;
+
+    if (m.SecondaryIndexBits)
+    {
+        uint32_t secondary = ReadBits(block, unpacked.SecondaryIndexOffset + index * m.SecondaryIndexBits - (index > 0 ? 1 : 0),
+            m.SecondaryIndexBits - (index == 0 ? 1 : 0));
+        uint32_t secondaryWeight = Bc7Weights(m.SecondaryIndexBits)[secondary];
+        if (unpacked.IndexSelection)
+        {
+            alphaWeight = colorWeight;
+            colorWeight = secondaryWeight;
+        }
+        else
+        {
+            alphaWeight = secondaryWeight;
+        }
+    }
+
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        out[c] = Bc7Interpolate(e0[c], e1[c], colorWeight);
+    }
+    out[3] = Bc7Interpolate(e0[3], e1[3], alphaWeight);
+
+    if (unpacked.Rotation)
+    {
+        std::swap(out[3], out[unpacked.Rotation - 1]);
+    }
+}
+
+// Texels [first, first + count) of a block, unpacking its endpoints once
+static void DecodeTexels(CpuFormat format, const uint8_t* block, uint32_t first, uint32_t count, uint8_t (*out)[4])
+{
+    switch (format)
+    {
+    case CpuFormat::BC1Unorm:
+    {
+        uint8_t palette[4][4];
+        uint32_t indices;
+        UnpackBc1(block, false, palette, &indices);
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            memcpy(out[i - first], palette[(indices >> (i * 2)) & 3], 4);
+        }
+        break;
+    }
+
+    case CpuFormat::BC3Unorm:
+    {
+        uint8_t palette[4][4];
+        uint8_t alphaPalette[8];
+        uint32_t indices;
+        uint64_t alphaIndices;
+        UnpackBc3Alpha(block, alphaPalette, &alphaIndices);
+        UnpackBc1(block + 8, true, palette, &indices);
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            memcpy(out[i - first], palette[(indices >> (i * 2)) & 3], 3);
+            out[i - first][3] = alphaPalette[(alphaIndices >> (i * 3)) & 7];
+        }
+        break;
+    }
+
+    case CpuFormat::BC7Unorm:
+    {
+        Bc7Block unpacked;
+        UnpackBc7(block, &unpacked);
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            Bc7Texel(block, unpacked, i, out[i - first]);
+        }
+        break;
+    }
+
+    default:
+        assert(false);
+        break;
+    }
+}
+
+//==============================================================================
+// Encoding
+//==============================================================================
+
+// The block at (bx, by) in blocks, repeating edge texels past the edges
+static void LoadBlock(const CpuTexture& source, uint32_t bx, uint32_t by, uint8_t texels[64])
+{
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        uint32_t y = std::min(by * 4 + row, source.Height - 1);
+        const uint8_t* p = source.Data + (size_t)y * source.RowPitch;
+        if (bx * 4 + 4 <= source.Width)
+        {
+            memcpy(texels + row * 16, p + bx * 16, 16);
+            continue;
+        }
+        for (uint32_t column = 0; column < 4; ++column)
+        {
+            uint32_t x = std::min(bx * 4 + column, source.Width - 1);
+            memcpy(texels + row * 16 + column * 4, p + x * 4, 4);
+        }
+    }
+}
+
+// With 'transparency', texels under half alpha are BC1's transparent black
+// and weigh nothing in the color fit
+static void ConvertBlock(const uint8_t texels[64], bool transparency, BlockTexels* block)
+{
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128 one = _mm_set1_ps(1.f);
+    block->Transparent = 0;
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(texels + row * 16));
+        block->Values[0][row] = _mm_cvtepi32_ps(_mm_and_si128(p, byteMask));
+        block->Values[1][row] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), byteMask));
+        block->Values[2][row] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), byteMask));
+        block->Values[3][row] = _mm_cvtepi32_ps(_mm_srli_epi32(p, 24));
+
+        __m128 transparent = transparency ? _mm_cmplt_ps(block->Values[3][row], _mm_set1_ps(128.f)) : _mm_setzero_ps();
+        block->Weights[row] = _mm_andnot_ps(transparent, one);
+        block->Transparent |= (uint32_t)_mm_movemask_ps(transparent) << (row * 4);
+    }
+}
+
+// The ends of the weighted texels' spread along their principal axis. Needs
+// at least one texel with weight.
+template <uint32_t Channels>
+static void PrincipalEndpoints(const BlockTexels& block, float e0[4], float e1[4])
+{
+    __m128 totalWeight = _mm_setzero_ps();
+    __m128 sums[Channels];
+    for (uint32_t c = 0; c < Channels; ++c)
+    {
+        sums[c] = _mm_setzero_ps();
+    }
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        totalWeight = _mm_add_ps(totalWeight, block.Weights[row]);
+        for (uint32_t c = 0; c < Channels; ++c)
+        {
+            sums[c] = _mm_add_ps(sums[c], _mm_mul_ps(block.Values[c][row], block.Weights[row]));
+        }
+    }
+
+    float mean[4]{};
+    float weight = HorizontalSum(totalWeight);
+    __m128 centered[Channels][4];
+    for (uint32_t c = 0; c < Channels; ++c)
+    {
+        mean[c] = HorizontalSum(sums[c]) / weight;
+        for (uint32_t row = 0; row < 4; ++row)
+        {
+            centered[c][row] = _mm_sub_ps(block.Values[c][row], _mm_set1_ps(mean[c]));
+        }
+    }
+
+    float covariance[4][4]{};
+    for (uint32_t i = 0; i < Channels; ++i)
+    {
+        for (uint32_t j = i; j < Channels; ++j)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t row = 0; row < 4; ++row)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(centered[i][row], centered[j][row]), block.Weights[row]));
+            }
+            covariance[i][j] = covariance[j][i] = HorizontalSum(sum);
+        }
+    }
+
+    // Power iteration, from the row of the channel that varies most. A flat
+    // block keeps a zero axis, and both endpoints land on its mean.
+    uint32_t largest = 0;
+    for (uint32_t c = 1; c < Channels; ++c)
+    {
+        largest = (covariance[c][c] > covariance[largest][largest]) ? c : largest;
+    }
+    float axis[4]{};
+    memcpy(axis, covariance[largest], sizeof(axis));
+    for (uint32_t i = 0; i < PowerIterations; ++i)
+    {
+        float next[4]{};
+        float length = 0.f;
+        for (uint32_t r = 0; r < Channels; ++r)
+        {
+            for (uint32_t c = 0; c < Channels; ++c)
+            {
+                next[r] += covariance[r][c] * axis[c];
+            }
+            length += next[r] * next[r];
+        }
+        if (length <= 0.f)
+        {
+            break;
+        }
+        float scale = 1.f / sqrtf(length);
+        for (uint32_t c = 0; c < Channels; ++c)
+        {
+            axis[c] = next[c] * scale;
+        }
+    }
+
+    __m128 low = _mm_set1_ps(FLT_MAX);
+    __m128 high = _mm_set1_ps(-FLT_MAX);
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        __m128 t = _mm_setzero_ps();
+        for (uint32_t c = 0; c < Channels; ++c)
+        {
+            t = _mm_add_ps(t, _mm_mul_ps(centered[c][row], _mm_set1_ps(axis[c])));
+        }
+        __m128 counts = _mm_cmpgt_ps(block.Weights[row], _mm_setzero_ps());
+        low = _mm_min_ps(low, _mm_blendv_ps(_mm_set1_ps(FLT_MAX), t, counts));
+        high = _mm_max_ps(high, _mm_blendv_ps(_mm_set1_ps(-FLT_MAX), t, counts));
+    }
+
+    float tLow = HorizontalMin(low);
+    float tHigh = HorizontalMax(high);
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        e0[c] = Clamp255(mean[c] + axis[c] * tLow);
+        e1[c] = Clamp255(mean[c] + axis[c] * tHigh);
+    }
+}
+
+// Least-squares endpoints for texels 't' of the way from e0 to e1. False if
+// the texels don't pin down two endpoints, such as all on one index.
+template <uint32_t Channels>
+static bool RefitEndpoints(const BlockTexels& block, const float t[16], float e0[4], float e1[4])
+{
+    const __m128 one = _mm_set1_ps(1.f);
+    __m128 aa = _mm_setzero_ps();
+    __m128 ab = _mm_setzero_ps();
+    __m128 bb = _mm_setzero_ps();
+    __m128 xa[Channels];
+    __m128 xb[Channels];
+    for (uint32_t c = 0; c < Channels; ++c)
+    {
+        xa[c] = xb[c] = _mm_setzero_ps();
+    }
+
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        __m128 b = _mm_loadu_ps(t + row * 4);
+        __m128 a = _mm_sub_ps(one, b);
+        __m128 wa = _mm_mul_ps(a, block.Weights[row]);
+        __m128 wb = _mm_mul_ps(b, block.Weights[row]);
+        aa = _mm_add_ps(aa, _mm_mul_ps(wa, a));
+        ab = _mm_add_ps(ab, _mm_mul_ps(wa, b));
+        bb = _mm_add_ps(bb, _mm_mul_ps(wb, b));
+        for (uint32_t c = 0; c < Channels; ++c)
+        {
+            xa[c] = _mm_add_ps(xa[c], _mm_mul_ps(wa, block.Values[c][row]));
+            xb[c] = _mm_add_ps(xb[c], _mm_mul_ps(wb, block.Values[c][row]));
+        }
+    }
+
+    float sumAA = HorizontalSum(aa);
+    float sumAB = HorizontalSum(ab);
+    float sumBB = HorizontalSum(bb);
+    float determinant = sumAA * sumBB - sumAB * sumAB;
+    if (determinant < 1e-3f)
+    {
+        return false;
+    }
+
+    float inverse = 1.f / determinant;
+    for (uint32_t c = 0; c < Channels; ++c)
+    {
+        float sumA = HorizontalSum(xa[c]);
+        float sumB = HorizontalSum(xb[c]);
+        e0[c] = Clamp255((sumBB * sumA - sumAB * sumB) * inverse);
+        e1[c] = Clamp255((sumAA * sumB - sumAB * sumA) * inverse);
+    }
+    return true;
+}
+
+// The nearest of 'count' palette entries to each texel, and the squared error
+// summed by weight
+template <uint32_t Channels>
+static float ChooseIndices(const BlockTexels& block, const float (*palette)[4], uint32_t count, uint8_t indices[16])
+{
+    __m128 error = _mm_setzero_ps();
+    for (uint32_t row = 0; row < 4; ++row)
+    {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for (uint32_t c = 0; c < Channels; ++c)
+            {
+                __m128 delta = _mm_sub_ps(block.Values[c][row], _mm_set1_ps(palette[k][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+            }
+            __m128 closer = _mm_cmplt_ps(distance, best);
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_blendv_ps(bestIndex, _mm_set1_ps((float)k), closer);
+        }
+        error = _mm_add_ps(error, _mm_mul_ps(best, block.Weights[row]));
+
+        __m128i packed = _mm_cvttps_epi32(bestIndex);
+        packed = _mm_packus_epi16(_mm_packus_epi32(packed, packed), _mm_setzero_si128());
+        uint32_t four = (uint32_t)_mm_cvtsi128_si32(packed);
+        memcpy(indices + row * 4, &four, 4);
+    }
+    return HorizontalSum(error);
+}
+
+static inline uint32_t Pack565(const float color[4])
+{
+    uint32_t r = (uint32_t)(color[0] * (31.f / 255.f) + 0.5f);
+    uint32_t g = (uint32_t)(color[1] * (63.f / 255.f) + 0.5f);
+    uint32_t b = (uint32_t)(color[2] * (31.f / 255.f) + 0.5f);
+    return (r << 11) | (g << 5) | b;
+}
+
+// Quantizes e0 and e1, orders them for 'mode' and picks indices
+static void FitBc1(const BlockTexels& block, const float e0[4], const float e1[4], ColorMode mode, Bc1Fit* fit)
+{
+    // BC1 reads 4 colors when the first endpoint is the greater
+    uint32_t c0 = Pack565(e0);
+    uint32_t c1 = Pack565(e1);
+    if ((mode == ColorMode::Transparent) ? (c0 > c1) : (c0 < c1))
+    {
+        std::swap(c0, c1);
+    }
+    fit->Colors[0] = (uint16_t)c0;
+    fit->Colors[1] = (uint16_t)c1;
+    fit->FourColor = (mode == ColorMode::Bc3) || (mode == ColorMode::Opaque && c0 > c1);
+
+    uint8_t palette[4][4];
+    float values[4][4];
+    Bc1Palette(c0, c1, fit->FourColor, palette);
+    for (uint32_t k = 0; k < 4; ++k)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            values[k][c] = palette[k][c];
+        }
+    }
+
+    fit->Error = ChooseIndices<3>(block, values, fit->FourColor ? 4 : 3, fit->Indices);
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        fit->Indices[i] = (block.Transparent & (1u << i)) ? 3 : fit->Indices[i];
+    }
+}
+
+static void EncodeBc1Color(const BlockTexels& block, ColorMode mode, uint8_t* out)
+{
+    Bc1Fit best{};
+    if (block.Transparent == 0xffff)
+    {
+        // Equal endpoints read as 3 colors, and index 3 is transparent black
+        memset(best.Indices, 3, sizeof(best.Indices));
+    }
+    else
+    {
+        float e0[4], e1[4];
+        PrincipalEndpoints<3>(block, e0, e1);
+        FitBc1(block, e0, e1, mode, &best);
+
+        for (uint32_t pass = 0; pass < RefitPasses; ++pass)
+        {
+            static const float FourColorT[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+            static const float ThreeColorT[4] = { 0.f, 1.f, 0.5f, 0.f };
+            const float* positions = best.FourColor ? FourColorT : ThreeColorT;
+            float t[16];
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                t[i] = positions[best.Indices[i]];
+            }
+
+            Bc1Fit fit;
+            if (!RefitEndpoints<3>(block, t, e0, e1))
+            {
+                break;
+            }
+            FitBc1(block, e0, e1, mode, &fit);
+            if (fit.Error >= best.Error)
+            {
+                break;
+            }
+            best = fit;
+        }
+    }
+
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        indices |= (uint32_t)best.Indices[i] << (i * 2);
+    }
+    memcpy(out, best.Colors, 4);
+    memcpy(out + 4, &indices, 4);
+}
+
+static uint32_t FitBc3Alpha(const uint8_t alpha[16], uint32_t a0, uint32_t a1, uint8_t indices[16])
+{
+    uint8_t palette[8];
+    Bc3AlphaPalette(a0, a1, palette);
+
+    uint32_t error = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        uint32_t best = 0;
+        int32_t bestDelta = 256;
+        for (uint32_t k = 0; k < 8; ++k)
+        {
+            int32_t delta = abs((int32_t)alpha[i] - (int32_t)palette[k]);
+            if (delta < bestDelta)
+            {
+                best = k;
+                bestDelta = delta;
+            }
+        }
+        indices[i] = (uint8_t)best;
+        error += (uint32_t)(bestDelta * bestDelta);
+    }
+    return error;
+}
+
+static void EncodeBc3Alpha(const uint8_t texels[64], uint8_t* out)
+{
+    uint8_t alpha[16];
+    uint32_t low = 255, high = 0;
+    uint32_t innerLow = 255, innerHigh = 0;     // Leaving out 0 and 255
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        alpha[i] = texels[i * 4 + 3];
+        low = std::min<uint32_t>(low, alpha[i]);
+        high = std::max<uint32_t>(high, alpha[i]);
+        if (alpha[i] != 0 && alpha[i] != 255)
+        {
+            innerLow = std::min<uint32_t>(innerLow, alpha[i]);
+            innerHigh = std::max<uint32_t>(innerHigh, alpha[i]);
+        }
+    }
+
+    uint8_t indices[16];
+    uint32_t a0 = high, a1 = low;
+    uint32_t error = FitBc3Alpha(alpha, a0, a1, indices);
+
+    // Cutouts with soft edges keep 0 and 255 exact with the 6 value mode
+    if (error > 0 && (low == 0 || high == 255))
+    {
+        if (innerLow > innerHigh)
+        {
+            innerLow = innerHigh = 0;
+        }
+        uint8_t sixIndices[16];
+        uint32_t sixError = FitBc3Alpha(alpha, innerLow, innerHigh, sixIndices);
+        if (sixError < error)
+        {
+            a0 = innerLow;
+            a1 = innerHigh;
+            memcpy(indices, sixIndices, sizeof(indices));
+        }
+    }
+
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        bits |= (uint64_t)indices[i] << (i * 3);
+    }
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    memcpy(out + 2, &bits, 6);
+}
+
+// The nearest 7 bit endpoint and low bit, which all 4 channels share. Opaque
+// blocks keep the low bit set so alpha stays exactly 255.
+static void QuantizeBc7Endpoint(const float endpoint[4], bool opaque, uint8_t quantized[4], uint8_t* pbit)
+{
+    float bestError = FLT_MAX;
+    for (uint32_t p = opaque ? 1 : 0; p < 2; ++p)
+    {
+        uint8_t candidate[4];
+        float error = 0.f;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            int32_t value = (int32_t)((endpoint[c] - p) * 0.5f + 0.5f);
+            value = std::min(std::max(value, 0), 127);
+            candidate[c] = (uint8_t)value;
+            float delta = (float)(value * 2 + (int32_t)p) - endpoint[c];
+            error += delta * delta;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(quantized, candidate, 4);
+            *pbit = (uint8_t)p;
+        }
+    }
+}
+
+static void FitBc7Mode6(const BlockTexels& block, const float e0[4], const float e1[4], bool opaque, Bc7Mode6Fit* fit)
+{
+    QuantizeBc7Endpoint(e0, opaque, fit->Endpoints[0], &fit->PBits[0]);
+    QuantizeBc7Endpoint(e1, opaque, fit->Endpoints[1], &fit->PBits[1]);
+
+    float palette[16][4];
+    for (uint32_t k = 0; k < 16; ++k)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            uint32_t end0 = fit->Endpoints[0][c] * 2u + fit->PBits[0];
+            uint32_t end1 = fit->Endpoints[1][c] * 2u + fit->PBits[1];
+            palette[k][c] = Bc7Interpolate(end0, end1, Bc7Weights4[k]);
+        }
+    }
+    fit->Error = ChooseIndices<4>(block, palette, 16, fit->Indices);
+}
+
+// Mode 6: one RGBA line, 7 bit endpoints each with a low bit, 4 bit indices
+static void EncodeBc7Mode6(const BlockTexels& block, bool opaque, Bc7Mode6Fit* best)
+{
+    float e0[4], e1[4];
+    PrincipalEndpoints<4>(block, e0, e1);
+    FitBc7Mode6(block, e0, e1, opaque, best);
+
+    for (uint32_t pass = 0; pass < RefitPasses && best->Error > 0.f; ++pass)
+    {
+        float t[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            t[i] = Bc7Weights4[best->Indices[i]] * (1.f / 64.f);
+        }
+
+        Bc7Mode6Fit fit;
+        if (!RefitEndpoints<4>(block, t, e0, e1))
+        {
+            break;
+        }
+        FitBc7Mode6(block, e0, e1, opaque, &fit);
+        if (fit.Error >= best->Error)
+        {
+            break;
+        }
+        *best = fit;
+    }
+
+    // Texel 0's index drops its top bit, so it has to be in the lower half
+    if (best->Indices[0] & 8)
+    {
+        std::swap(best->Endpoints[0], best->Endpoints[1]);
+        std::swap(best->PBits[0], best->PBits[1]);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            best->Indices[i] = (uint8_t)(15 - best->Indices[i]);
+        }
+    }
+}
+
+static void FitBc7Mode5Color(const BlockTexels& block, const float e0[4], const float e1[4], Bc7Mode5Fit* fit)
+{
+    float palette[4][4];
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        fit->Color[0][c] = (uint8_t)(e0[c] * (127.f / 255.f) + 0.5f);
+        fit->Color[1][c] = (uint8_t)(e1[c] * (127.f / 255.f) + 0.5f);
+        uint32_t end0 = (fit->Color[0][c] << 1) | (fit->Color[0][c] >> 6);
+        uint32_t end1 = (fit->Color[1][c] << 1) | (fit->Color[1][c] >> 6);
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            palette[k][c] = Bc7Interpolate(end0, end1, Bc7Weights2[k]);
+        }
+    }
+    fit->ColorError = ChooseIndices<3>(block, palette, 4, fit->ColorIndices);
+}
+
+static void FitBc7Mode5Alpha(const uint8_t alpha[16], float a0, float a1, Bc7Mode5Fit* fit)
+{
+    fit->Alpha[0] = (uint8_t)(a0 + 0.5f);
+    fit->Alpha[1] = (uint8_t)(a1 + 0.5f);
+    uint8_t palette[4];
+    for (uint32_t k = 0; k < 4; ++k)
+    {
+        palette[k] = Bc7Interpolate(fit->Alpha[0], fit->Alpha[1], Bc7Weights2[k]);
+    }
+
+    fit->AlphaError = 0.f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        uint32_t best = 0;
+        int32_t bestDelta = 256;
+        for (uint32_t k = 0; k < 4; ++k)
+        {
+            int32_t delta = abs((int32_t)alpha[i] - (int32_t)palette[k]);
+            if (delta < bestDelta)
+            {
+                best = k;
+                bestDelta = delta;
+            }
+        }
+        fit->AlphaIndices[i] = (uint8_t)best;
+        fit->AlphaError += (float)(bestDelta * bestDelta);
+    }
+}
+
+// Mode 5: an RGB line and a separate alpha line, with 2 bit indices each.
+// Only worth trying where alpha varies on its own.
+static void EncodeBc7Mode5(const BlockTexels& block, const uint8_t texels[64], Bc7Mode5Fit* best)
+{
+    float e0[4], e1[4];
+    PrincipalEndpoints<3>(block, e0, e1);
+    FitBc7Mode5Color(block, e0, e1, best);
+    for (uint32_t pass = 0; pass < RefitPasses && best->ColorError > 0.f; ++pass)
+    {
+        float t[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            t[i] = Bc7Weights2[best->ColorIndices[i]] * (1.f / 64.f);
+        }
+
+        Bc7Mode5Fit fit;
+        if (!RefitEndpoints<3>(block, t, e0, e1))
+        {
+            break;
+        }
+        FitBc7Mode5Color(block, e0, e1, &fit);
+        if (fit.ColorError >= best->ColorError)
+        {
+            break;
+        }
+        memcpy(best->Color, fit.Color, sizeof(fit.Color));
+        memcpy(best->ColorIndices, fit.ColorIndices, sizeof(fit.ColorIndices));
+        best->ColorError = fit.ColorError;
+    }
+
+    // Alpha from its range, then one least-squares refit
+    uint8_t alpha[16];
+    float low = 255.f, high = 0.f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        alpha[i] = texels[i * 4 + 3];
+        low = std::min(low, (float)alpha[i]);
+        high = std::max(high, (float)alpha[i]);
+    }
+    FitBc7Mode5Alpha(alpha, low, high, best);
+
+    float sumAA = 0.f, sumAB = 0.f, sumBB = 0.f, sumA = 0.f, sumB = 0.f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        float b = Bc7Weights2[best->AlphaIndices[i]] * (1.f / 64.f);
+        float a = 1.f - b;
+        sumAA += a * a;
+        sumAB += a * b;
+        sumBB += b * b;
+        sumA += a * alpha[i];
+        sumB += b * alpha[i];
+    }
+    float determinant = sumAA * sumBB - sumAB * sumAB;
+    if (best->AlphaError > 0.f && determinant >= 1e-3f)
+    {
+        Bc7Mode5Fit fit;
+        FitBc7Mode5Alpha(alpha, Clamp255((sumBB * sumA - sumAB * sumB) / determinant),
+            Clamp255((sumAA * sumB - sumAB * sumA) / determinant), &fit);
+        if (fit.AlphaError < best->AlphaError)
+        {
+            memcpy(best->Alpha, fit.Alpha, sizeof(fit.Alpha));
+            memcpy(best->AlphaIndices, fit.AlphaIndices, sizeof(fit.AlphaIndices));
+            best->AlphaError = fit.AlphaError;
+        }
+    }
+
+    // Texel 0's indices drop their top bits
+    if (best->ColorIndices[0] & 2)
+    {
+        std::swap(best->Color[0], best->Color[1]);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            best->ColorIndices[i] = (uint8_t)(3 - best->ColorIndices[i]);
+        }
+    }
+    if (best->AlphaIndices[0] & 2)
+    {
+        std::swap(best->Alpha[0], best->Alpha[1]);
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            best->AlphaIndices[i] = (uint8_t)(3 - best->AlphaIndices[i]);
+        }
+    }
+}
+
+static void EncodeBc7(const BlockTexels& block, const uint8_t texels[64], uint8_t* out)
+{
+    uint64_t bits[2] = { 0, 0 };
+    uint32_t offset = 0;
+
+    bool alphaVaries = false;
+    for (uint32_t i = 1; i < 16; ++i)
+    {
+        alphaVaries = alphaVaries || texels[i * 4 + 3] != texels[3];
+    }
+
+    Bc7Mode6Fit mode6;
+    EncodeBc7Mode6(block, !alphaVaries && texels[3] == 255, &mode6);
+    Bc7Mode5Fit mode5;
+    if (alphaVaries && mode6.Error > 0.f)
+    {
+        EncodeBc7Mode5(block, texels, &mode5);
+    }
+
+    if (alphaVaries && mode6.Error > 0.f && mode5.ColorError + mode5.AlphaError < mode6.Error)
+    {
+        WriteBits(bits, &offset, 1u << 5, 6);
+        WriteBits(bits, &offset, 0, 2);                 // No rotation
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            WriteBits(bits, &offset, mode5.Color[0][c], 7);
+            WriteBits(bits, &offset, mode5.Color[1][c], 7);
+        }
+        WriteBits(bits, &offset, mode5.Alpha[0], 8);
+        WriteBits(bits, &offset, mode5.Alpha[1], 8);
+        WriteBits(bits, &offset, mode5.ColorIndices[0], 1);
+        for (uint32_t i = 1; i < 16; ++i)
+        {
+            WriteBits(bits, &offset, mode5.ColorIndices[i], 2);
+        }
+        WriteBits(bits, &offset, mode5.AlphaIndices[0], 1);
+        for (uint32_t i = 1; i < 16; ++i)
+        {
+            WriteBits(bits, &offset, mode5.AlphaIndices[i], 2);
+        }
+    }
+    else
+    {
+        WriteBits(bits, &offset, 1u << 6, 7);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            WriteBits(bits, &offset, mode6.Endpoints[0][c], 7);
+            WriteBits(bits, &offset, mode6.Endpoints[1][c], 7);
+        }
+        WriteBits(bits, &offset, mode6.PBits[0], 1);
+        WriteBits(bits, &offset, mode6.PBits[1], 1);
+        WriteBits(bits, &offset, mode6.Indices[0], 3);
+        for (uint32_t i = 1; i < 16; ++i)
+        {
+            WriteBits(bits, &offset, mode6.Indices[i], 4);
+        }
+    }
+
+    assert(offset == 128);
+    memcpy(out, bits, 16);
+}
+
+static void EncodeBlock(CpuFormat format, const uint8_t texels[64], uint8_t* out)
+{
+    BlockTexels block;
+    switch (format)
+    {
+    case CpuFormat::BC1Unorm:
+        ConvertBlock(texels, true, &block);
+        EncodeBc1Color(block, block.Transparent ? ColorMode::Transparent : ColorMode::Opaque, out);
+        break;
+
+    case CpuFormat::BC3Unorm:
+        ConvertBlock(texels, false, &block);
+        EncodeBc3Alpha(texels, out);
+        EncodeBc1Color(block, ColorMode::Bc3, out + 8);
+        break;
+
+    case CpuFormat::BC7Unorm:
+        ConvertBlock(texels, false, &block);
+        EncodeBc7(block, texels, out);
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool BlockCompress(const CpuTexture& source, CpuTexture* target)
+{
+    if (source.Format != CpuFormat::R8G8B8A8Unorm || !CpuFormatIsBlockCompressed(target->Format) ||
+        source.Width != target->Width || source.Height != target->Height)
+    {
+        assert(false);
+        return false;
+    }
+
+    CpuFormat format = target->Format;
+    uint32_t blockBytes = CpuFormatBytesPerBlock(format);
+    uint32_t blocksWide = (source.Width + 3) / 4;
+    uint32_t blocksHigh = (source.Height + 3) / 4;
+    ParallelFor(blocksHigh, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t by = begin; by < end; ++by)
+        {
+            uint8_t* row = target->Data + (size_t)by * target->RowPitch;
+            for (uint32_t bx = 0; bx < blocksWide; ++bx)
+            {
+                uint8_t texels[64];
+                LoadBlock(source, bx, by, texels);
+                EncodeBlock(format, texels, row + (size_t)bx * blockBytes);
+            }
+        }
+    });
+    return true;
+}
+
+//==============================================================================
+bool BlockDecompress(const CpuTexture& source, CpuTexture* target)
+{
+    if (!CpuFormatIsBlockCompressed(source.Format) || target->Format != CpuFormat::R8G8B8A8Unorm ||
+        source.Width != target->Width || source.Height != target->Height)
+    {
+        assert(false);
+        return false;
+    }
+
+    CpuFormat format = source.Format;
+    uint32_t blockBytes = CpuFormatBytesPerBlock(format);
+    uint32_t blocksWide = (source.Width + 3) / 4;
+    uint32_t blocksHigh = (source.Height + 3) / 4;
+    ParallelFor(blocksHigh, 4, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t by = begin; by < end; ++by)
+        {
+            const uint8_t* row = source.Data + (size_t)by * source.RowPitch;
+            uint32_t rows = std::min(4u, source.Height - by * 4);
+            for (uint32_t bx = 0; bx < blocksWide; ++bx)
+            {
+                uint8_t texels[16][4];
+                DecodeTexels(format, row + (size_t)bx * blockBytes, 0, 16, texels);
+                uint32_t columns = std::min(4u, source.Width - bx * 4);
+                for (uint32_t y = 0; y < rows; ++y)
+                {
+                    uint8_t* out = target->Data + (size_t)(by * 4 + y) * target->RowPitch + (size_t)bx * 16;
+                    memcpy(out, texels[y * 4], columns * 4);
+                }
+            }
+        }
+    });
+    return true;
+}
+
+//==============================================================================
+void BlockDecodeTexel(CpuFormat format, const uint8_t* block, uint32_t index, uint8_t out[4])
+{
+    DecodeTexels(format, block, index, 1, (uint8_t(*)[4])out);
+}
@@ -0,0 +1,36 @@
+//==============================================================================
+// BC1, BC3 and BC7 block compression, which stores a texture in 4 or 8 bits a
+// texel rather than 32, and decoding for the CPU sampler (see CpuFormat).
+//
+// The encoder takes one 4x4 block at a time, four texels to an SSE register,
+// and splits rows of blocks over ParallelFor. Endpoints start at the ends of
+// the block's principal axis, indices go to the nearest palette entry, and two
+// least-squares passes refit the endpoints to those indices.
+//
+// BC1 turns to its 3-color mode with transparent texels when any alpha is
+// under half. BC3 adds an alpha block of 8 values, or 6 plus 0 and 255 when
+// that fits better. BC7 encodes mode 6, a single RGBA line with 4 bit indices,
+// and where alpha varies also tries mode 5, which fits alpha on a line of its
+// own. Both suit smooth images and are weaker on edges between several colors
+// than the partitioned modes. Decoding covers all eight BC7 modes.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Compresses R8G8B8A8Unorm 'source' into 'target', a block-compressed texture
+// of the same size. Blocks past the right and bottom edges repeat the edge
+// texels.
+bool BlockCompress(const CpuTexture& source, CpuTexture* target);
+
+// Decodes a block-compressed 'source' into R8G8B8A8Unorm 'target' of the same
+// size
+bool BlockDecompress(const CpuTexture& source, CpuTexture* target);
+
+// Texel 'index' of a block, 0 to 15 in row order, as R8G8B8A8
+void BlockDecodeTexel(CpuFormat format, const uint8_t* block, uint32_t index, uint8_t out[4]);
@@ -0,0 +1,476 @@
+//==============================================================================
+#include "Compositor.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <math.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Segments of a cylinder's arc for its bounds
+static const uint32_t ArcSegments = 16;
+
+// Points at least this far in front of the eye, in clip space w, project
+// into the bounds. Any nearer and the bounds are the whole viewport.
+static const float MinBoundsW = 1e-3f;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+
+// Per layer state for a pass
+struct LayerSetup
+{
+    bool Visible;
+    CompositorRect Rect;
+    float WorldToLayer[16];
+    float TextureWidth;
+    float TextureHeight;
+};
+
+// Pixel rectangle of the viewport, clipped to the target
+static bool ViewportRect(const CpuViewport& viewport, const CpuTexture& target, float* left, float* top, float* width,
+    float* height, CompositorRect* rect)
+{
+    *left = viewport.TopLeftX;
+    *top = viewport.TopLeftY;
+    *width = (viewport.Width > 0.f) ? viewport.Width : (float)target.Width;
+    *height = (viewport.Width > 0.f) ? viewport.Height : (float)target.Height;
+    rect->Left = (uint32_t)*left;
+    rect->Top = (uint32_t)*top;
+    rect->Right = std::min((uint32_t)(*left + *width), target.Width);
+    rect->Bottom = std::min((uint32_t)(*top + *height), target.Height);
+    return rect->Right > rect->Left && rect->Bottom > rect->Top;
+}
+
+// atan2(y, x), to about 1e-5 radians
+static inline SimdFloat Atan2(SimdFloat y, SimdFloat x)
+{
+    SimdFloat ax = SimdAbs(x);
+    SimdFloat ay = SimdAbs(y);
+    SimdFloat steep = SimdCmpLt(ax, ay);
+    SimdFloat ratio = SimdDiv(SimdMin(ax, ay), SimdMax(SimdMax(ax, ay), SimdSet(1e-30f)));
+    SimdFloat r2 = SimdMul(ratio, ratio);
+    SimdFloat poly = SimdMad(r2, SimdSet(-0.01172120f), SimdSet(0.05265332f));
+    poly = SimdMad(r2, poly, SimdSet(-0.11643287f));
+    poly = SimdMad(r2, poly, SimdSet(0.19354346f));
+    poly = SimdMad(r2, poly, SimdSet(-0.33262347f));
+    poly = SimdMad(r2, poly, SimdSet(0.99997726f));
+    SimdFloat angle = SimdMul(ratio, poly);
+    angle = SimdSelect(steep, SimdSub(SimdSet(1.57079633f), angle), angle);
+    angle = SimdSelect(SimdCmpLt(x, SimdZero()), SimdSub(SimdSet(3.14159265f), angle), angle);
+    return SimdSelect(SimdCmpLt(y, SimdZero()), SimdNeg(angle), angle);
+}
+
+// Row vector 'p' (with w = 'w') through 'm', to xyz
+static inline void Transform(const float m[16], const SimdFloat p[3], float w, SimdFloat out[3])
+{
+    for (uint32_t j = 0; j < 3; ++j)
+    {
+        out[j] = SimdMad(p[0], SimdSet(m[0 * 4 + j]), SimdMad(p[1], SimdSet(m[1 * 4 + j]),
+            SimdMad(p[2], SimdSet(m[2 * 4 + j]), SimdSet(w * m[3 * 4 + j]))));
+    }
+}
+
+// View ray through NDC (x, y): from the near plane toward the far plane
+static inline void NdcRay(const float m[16], SimdFloat x, SimdFloat y, SimdFloat origin[3], SimdFloat direction[3])
+{
+    SimdFloat nearPoint[4];
+    SimdFloat farPoint[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        nearPoint[i] = SimdMad(x, SimdSet(m[0 * 4 + i]), SimdMad(y, SimdSet(m[1 * 4 + i]), SimdSet(m[3 * 4 + i])));
+        farPoint[i] = SimdAdd(nearPoint[i], SimdSet(m[2 * 4 + i]));
+    }
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        origin[i] = SimdDiv(nearPoint[i], nearPoint[3]);
+        direction[i] = SimdSub(SimdDiv(farPoint[i], farPoint[3]), origin[i]);
+    }
+}
+
+static inline SimdFloat InUnitRange(SimdFloat a)
+{
+    return SimdAnd(SimdCmpGe(a, SimdZero()), SimdCmpLe(a, SimdSet(1.f)));
+}
+
+// Texture coordinates where a world space ray meets the layer, and the mask
+// of lanes that hit it. For cylinders '*farRoot' says which of the two
+// intersections each lane took, or if 'chooseRoot' is false, which to take.
+static void Intersect(const CompositorLayer& layer, const LayerSetup& setup, const SimdFloat worldOrigin[3],
+    const SimdFloat worldDirection[3], bool chooseRoot, SimdFloat* farRoot, SimdFloat* u, SimdFloat* v, SimdFloat* hit)
+{
+    SimdFloat p[3];
+    SimdFloat d[3];
+    Transform(setup.WorldToLayer, worldOrigin, 1.f, p);
+    Transform(setup.WorldToLayer, worldDirection, 0.f, d);
+    SimdFloat invHeight = SimdSet(1.f / layer.Height);
+    SimdFloat half = SimdSet(0.5f);
+
+    if (layer.Type == CompositorLayerType::Quad)
+    {
+        SimdFloat t = SimdDiv(SimdNeg(p[2]), d[2]);
+        *u = SimdMad(SimdMad(t, d[0], p[0]), SimdSet(1.f / layer.Width), half);
+        *v = SimdSub(half, SimdMul(SimdMad(t, d[1], p[1]), invHeight));
+        *hit = SimdAnd(SimdCmpLt(SimdZero(), t), SimdAnd(InUnitRange(*u), InUnitRange(*v)));
+        return;
+    }
+
+    // |p + t d| = Radius in xz, with b halved
+    SimdFloat a = SimdMad(d[0], d[0], SimdMul(d[2], d[2]));
+    SimdFloat b = SimdMad(p[0], d[0], SimdMul(p[2], d[2]));
+    SimdFloat c = SimdSub(SimdMad(p[0], p[0], SimdMul(p[2], p[2])), SimdSet(layer.Radius * layer.Radius));
+    SimdFloat discriminant = SimdSub(SimdMul(b, b), SimdMul(a, c));
+    SimdFloat root = SimdSqrt(SimdMax(discriminant, SimdZero()));
+    SimdFloat invA = SimdDiv(SimdSet(1.f), a);
+    SimdFloat invAngle = SimdSet(1.f / layer.CentralAngle);
+
+    SimdFloat roots[2] = { SimdMul(SimdSub(SimdNeg(b), root), invA), SimdMul(SimdSub(root, b), invA) };
+    SimdFloat us[2], vs[2], hits[2];
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        SimdFloat x = SimdMad(roots[i], d[0], p[0]);
+        SimdFloat y = SimdMad(roots[i], d[1], p[1]);
+        SimdFloat z = SimdMad(roots[i], d[2], p[2]);
+        us[i] = SimdMad(Atan2(x, z), invAngle, half);
+        vs[i] = SimdSub(half, SimdMul(y, invHeight));
+        hits[i] = SimdAnd(SimdAnd(SimdCmpGe(discriminant, SimdZero()), SimdCmpLt(SimdZero(), roots[i])),
+            SimdAnd(InUnitRange(us[i]), InUnitRange(vs[i])));
+    }
+    if (chooseRoot)
+    {
+        *farRoot = SimdAndNot(hits[0], hits[1]);
+        *hit = SimdOr(hits[0], hits[1]);
+    }
+    else
+    {
+        *hit = SimdSelect(*farRoot, hits[1], hits[0]);
+    }
+    *u = SimdSelect(*farRoot, us[1], us[0]);
+    *v = SimdSelect(*farRoot, vs[1], vs[0]);
+}
+
+// Layer space point through 'viewProj' into the bounds. False if it's too
+// near the eye plane to project.
+static bool AddBoundsPoint(const float pose[16], const float viewProj[16], float x, float y, float z, float* minX,
+    float* minY, float* maxX, float* maxY)
+{
+    float world[3];
+    for (uint32_t j = 0; j < 3; ++j)
+    {
+        world[j] = x * pose[0 * 4 + j] + y * pose[1 * 4 + j] + z * pose[2 * 4 + j] + pose[3 * 4 + j];
+    }
+    float clip[4];
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        clip[j] = world[0] * viewProj[0 * 4 + j] + world[1] * viewProj[1 * 4 + j] + world[2] * viewProj[2 * 4 + j] +
+            viewProj[3 * 4 + j];
+    }
+    if (clip[3] < MinBoundsW)
+    {
+        return false;
+    }
+    float ndcX = clip[0] / clip[3];
+    float ndcY = clip[1] / clip[3];
+    *minX = std::min(*minX, ndcX);
+    *maxX = std::max(*maxX, ndcX);
+    *minY = std::min(*minY, ndcY);
+    *maxY = std::max(*maxY, ndcY);
+    return true;
+}
+
+//==============================================================================
+bool CompositorLayerBounds(const CompositorLayer& layer, const float viewProj[16], const CpuViewport& viewport,
+    const CpuTexture& target, CompositorRect* rect)
+{
+    float left, top, width, height;
+    CompositorRect full;
+    if (!ViewportRect(viewport, target, &left, &top, &width, &height, &full))
+    {
+        return false;
+    }
+
+    // A cube is everywhere
+    if (layer.Type == CompositorLayerType::Cube)
+    {
+        *rect = full;
+        return true;
+    }
+
+    // The corners of a quad, or for a cylinder the polygon circumscribing each
+    // end of its arc, whose projections take in the whole layer
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    bool projected = true;
+    float halfHeight = layer.Height * 0.5f;
+    if (layer.Type == CompositorLayerType::Quad)
+    {
+        float halfWidth = layer.Width * 0.5f;
+        for (uint32_t corner = 0; corner < 4 && projected; ++corner)
+        {
+            projected = AddBoundsPoint(layer.Pose, viewProj, (corner & 1) ? halfWidth : -halfWidth,
+                (corner & 2) ? halfHeight : -halfHeight, 0.f, &minX, &minY, &maxX, &maxY);
+        }
+    }
+    else
+    {
+        float step = layer.CentralAngle / ArcSegments;
+        float outer = layer.Radius / cosf(step * 0.5f);
+        for (uint32_t i = 0; i <= ArcSegments + 1 && projected; ++i)
+        {
+            // The arc's two ends, then where the tangents at each segment's
+            // ends cross
+            float angle = (i <= ArcSegments) ? -layer.CentralAngle * 0.5f + i * step : layer.CentralAngle * 0.5f;
+            float radius = layer.Radius;
+            if (i > 0 && i <= ArcSegments)
+            {
+                angle -= step * 0.5f;
+                radius = outer;
+            }
+            for (uint32_t end = 0; end < 2 && projected; ++end)
+            {
+                projected = AddBoundsPoint(layer.Pose, viewProj, radius * sinf(angle), end ? halfHeight : -halfHeight,
+                    radius * cosf(angle), &minX, &minY, &maxX, &maxY);
+            }
+        }
+    }
+    if (!projected)
+    {
+        *rect = full;
+        return true;
+    }
+
+    // Pixels whose centers can fall inside, and then a pixel more for the
+    // filtering at the layer's edges
+    float pixelLeft = floorf(left + (minX + 1.f) * 0.5f * width) - 1.f;
+    float pixelRight = ceilf(left + (maxX + 1.f) * 0.5f * width) + 1.f;
+    float pixelTop = floorf(top + (1.f - maxY) * 0.5f * height) - 1.f;
+    float pixelBottom = ceilf(top + (1.f - minY) * 0.5f * height) + 1.f;
+    rect->Left = (pixelLeft > (float)full.Left) ? (uint32_t)pixelLeft : full.Left;
+    rect->Top = (pixelTop > (float)full.Top) ? (uint32_t)pixelTop : full.Top;
+    rect->Right = (pixelRight < (float)full.Right) ? (uint32_t)pixelRight : full.Right;
+    rect->Bottom = (pixelBottom < (float)full.Bottom) ? (uint32_t)pixelBottom : full.Bottom;
+    return rect->Right > rect->Left && rect->Bottom > rect->Top;
+}
+
+//==============================================================================
+void CompositorDraw(const CompositorLayer* layers, uint32_t numLayers, const float viewProj[16],
+    const float invViewProj[16], const CpuViewport& viewport, CpuTexture* target, CompositorStats* stats)
+{
+    assert(numLayers <= CompositorMaxLayers);
+    assert(target->Format == CpuFormat::R8G8B8A8Unorm);
+    float left, top, width, height;
+    CompositorRect full;
+    if (numLayers > CompositorMaxLayers || !ViewportRect(viewport, *target, &left, &top, &width, &height, &full))
+    {
+        return;
+    }
+
+    // Cube layers first, beneath the target
+    uint32_t numCubes = 0;
+    while (numCubes < numLayers && layers[numCubes].Type == CompositorLayerType::Cube)
+    {
+        ++numCubes;
+    }
+    for (uint32_t i = numCubes; i < numLayers; ++i)
+    {
+        if (layers[i].Type == CompositorLayerType::Cube)
+        {
+            assert(false);
+            return;
+        }
+    }
+
+    LayerSetup setups[CompositorMaxLayers];
+    for (uint32_t i = 0; i < numLayers; ++i)
+    {
+        const CompositorLayer& layer = layers[i];
+        LayerSetup& setup = setups[i];
+        bool hasTexture = (i < numCubes) ? layer.Cube != nullptr : layer.NumLevels > 0;
+        setup.Visible = hasTexture && CompositorLayerBounds(layer, viewProj, viewport, *target, &setup.Rect);
+        CompositorInversePose(layer.Pose, setup.WorldToLayer);
+        setup.TextureWidth = layer.NumLevels ? (float)layer.Levels[0].Width : 0.f;
+        setup.TextureHeight = layer.NumLevels ? (float)layer.Levels[0].Height : 0.f;
+    }
+
+    CpuSampler sampler{};
+    sampler.Filter = CpuFilter::Linear;
+    sampler.Address = CpuAddressMode::Clamp;
+
+    std::atomic<uint64_t> totalTraced(0);
+    std::atomic<uint64_t> totalOutOfBounds(0);
+    std::atomic<uint64_t> totalOccluded(0);
+    float pixelX = 2.f / width;
+    float pixelY = 2.f / height;
+
+    ParallelFor(full.Bottom - full.Top, 4, [&](uint32_t begin, uint32_t end)
+    {
+        uint64_t traced = 0;
+        uint64_t outOfBounds = 0;
+        uint64_t occluded = 0;
+        SimdFloat lanes = SimdLaneIndex();
+        SimdFloat one = SimdSet(1.f);
+        for (uint32_t row = begin; row < end; ++row)
+        {
+            uint32_t py = full.Top + row;
+            SimdFloat y = SimdSet(1.f - (py + 0.5f - top) * pixelY);
+            SimdFloat yDown = SimdSub(y, SimdSet(pixelY));
+            for (uint32_t px = full.Left; px < full.Right; px += SimdWidth)
+            {
+                uint32_t count = std::min(SimdWidth, full.Right - px);
+                uint32_t inBounds = 0;
+                for (uint32_t i = 0; i < numLayers; ++i)
+                {
+                    const CompositorRect& rect = setups[i].Rect;
+                    bool overlaps = setups[i].Visible && py >= rect.Top && py < rect.Bottom && px < rect.Right &&
+                        px + count > rect.Left;
+                    inBounds |= (overlaps ? 1u : 0u) << i;
+                }
+                if (!inBounds)
+                {
+                    outOfBounds += numLayers;
+                    continue;
+                }
+
+                // This pixel's ray, and its neighbors' for the level of detail
+                SimdFloat x = SimdSub(SimdMul(SimdAdd(lanes, SimdSet(px + 0.5f - left)), SimdSet(pixelX)), one);
+                SimdFloat origin[3], direction[3], rightOrigin[3], right[3], downOrigin[3], down[3];
+                NdcRay(invViewProj, x, y, origin, direction);
+                NdcRay(invViewProj, SimdAdd(x, SimdSet(pixelX)), y, rightOrigin, right);
+                NdcRay(invViewProj, x, yDown, downOrigin, down);
+
+                // Front to back, under what's in front so far
+                SimdFloat color[4] = { SimdZero(), SimdZero(), SimdZero(), SimdZero() };
+                SimdFloat covered = SimdZero();
+                for (uint32_t n = numLayers; n-- > numCubes;)
+                {
+                    if (!(inBounds & (1u << n)))
+                    {
+                        ++outOfBounds;
+                        continue;
+                    }
+                    if (SimdMoveMask(SimdCmpLt(color[3], one)) == 0)
+                    {
+                        ++occluded;
+                        continue;
+                    }
+                    ++traced;
+
+                    const CompositorLayer& layer = layers[n];
+                    const LayerSetup& setup = setups[n];
+                    SimdFloat farRoot = SimdZero();
+                    SimdFloat u, v, hit, uRight, vRight, uDown, vDown, unused;
+                    Intersect(layer, setup, origin, direction, true, &farRoot, &u, &v, &hit);
+                    if (SimdMoveMask(hit) == 0)
+                    {
+                        continue;
+                    }
+                    Intersect(layer, setup, rightOrigin, right, false, &farRoot, &uRight, &vRight, &unused);
+                    Intersect(layer, setup, downOrigin, down, false, &farRoot, &uDown, &vDown, &unused);
+
+                    SimdFloat textureWidth = SimdSet(setup.TextureWidth);
+                    SimdFloat textureHeight = SimdSet(setup.TextureHeight);
+                    SimdFloat dux = SimdMul(SimdSub(uRight, u), textureWidth);
+                    SimdFloat dvx = SimdMul(SimdSub(vRight, v), textureHeight);
+                    SimdFloat duy = SimdMul(SimdSub(uDown, u), textureWidth);
+                    SimdFloat dvy = SimdMul(SimdSub(vDown, v), textureHeight);
+                    SimdFloat footprint = SimdMax(SimdMad(dux, dux, SimdMul(dvx, dvx)), SimdMad(duy, duy, SimdMul(dvy, dvy)));
+                    SimdFloat lod = SimdPerLane(SimdMax(footprint, one), [](float f) { return 0.5f * log2f(f); });
+
+                    SimdFloat texel[4];
+                    CpuTextureSampleLevel(layer.Levels, layer.NumLevels, sampler, u, v, lod, texel);
+                    SimdFloat alpha = SimdAnd(hit, texel[3]);
+                    SimdFloat weight = SimdMul(SimdSub(one, color[3]), alpha);
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        color[c] = SimdMad(texel[c], weight, color[c]);
+                    }
+                    color[3] = SimdAdd(color[3], weight);
+                    covered = SimdOr(covered, hit);
+                }
+                if (numCubes == 0 && SimdMoveMask(covered) == 0)
+                {
+                    continue;
+                }
+
+                // Then the target, unless the layers hide it
+                if (SimdMoveMask(SimdCmpLt(color[3], one)) != 0)
+                {
+                    SimdFloat under[4];
+                    CpuTextureLoad(*target, SimdIntAdd(SimdFtoi(lanes), SimdIntSet((int32_t)px)), SimdIntSet((int32_t)py),
+                        under);
+                    SimdFloat uncovered = SimdSub(one, color[3]);
+                    for (uint32_t c = 0; c < 4; ++c)
+                    {
+                        color[c] = SimdMad(under[c], uncovered, color[c]);
+                    }
+                }
+
+                // And the cubes beneath it, where anything still shows through
+                for (uint32_t n = numCubes; n-- > 0;)
+                {
+                    if (!(inBounds & (1u << n)))
+                    {
+                        ++outOfBounds;
+                        continue;
+                    }
+                    if (SimdMoveMask(SimdCmpLt(color[3], one)) == 0)
+                    {
+                        ++occluded;
+                        continue;
+                    }
+                    ++traced;
+
+                    const LayerSetup& setup = setups[n];
+                    SimdFloat d[3], dRight[3], dDown[3];
+                    Transform(setup.WorldToLayer, direction, 0.f, d);
+                    Transform(setup.WorldToLayer, right, 0.f, dRight);
+                    Transform(setup.WorldToLayer, down, 0.f, dDown);
+                    SimdFloat texel[4];
+                    CpuCubeMapSampleGrad(*layers[n].Cube, d, dRight, dDown, texel);
+                    SimdFloat uncovered = SimdSub(one, color[3]);
+                    for (uint32_t c = 0; c < 4; ++c)
+                    {
+                        color[c] = SimdMad(texel[c], uncovered, color[c]);
+                    }
+                    covered = SimdTrue();
+                }
+                CpuTextureStoreRow(target, px, py, count, covered, color);
+            }
+        }
+        totalTraced += traced;
+        totalOutOfBounds += outOfBounds;
+        totalOccluded += occluded;
+    });
+
+    if (stats)
+    {
+        uint64_t runs = (uint64_t)(full.Bottom - full.Top) * ((full.Right - full.Left + SimdWidth - 1) / SimdWidth);
+        stats->Tests += runs * numLayers;
+        stats->Traced += totalTraced;
+        stats->OutOfBounds += totalOutOfBounds;
+        stats->Occluded += totalOccluded;
+    }
+}
+
+//==============================================================================
+void CompositorInversePose(const float pose[16], float inverse[16])
+{
+    // Transposed rotation, and the translation taken back through it
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            inverse[i * 4 + j] = pose[j * 4 + i];
+        }
+        inverse[i * 4 + 3] = 0.f;
+    }
+    for (uint32_t j = 0; j < 3; ++j)
+    {
+        inverse[3 * 4 + j] = -(pose[3 * 4 + 0] * pose[j * 4 + 0] + pose[3 * 4 + 1] * pose[j * 4 + 1] +
+            pose[3 * 4 + 2] * pose[j * 4 + 2]);
+    }
+    inverse[15] = 1.f;
+}
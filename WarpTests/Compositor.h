@@ -0,0 +1,101 @@
+//==============================================================================
+// Compositor layers: flat quads and sections of cylinder, each with its own
+// pose and texture, composited over the warped app frame at the display pose,
+// and cube maps at infinity composited beneath it. A layer's texture is
+// sampled once, straight from its mip chain at display resolution, instead of
+// being drawn into the app frame and resampled again by the warp, so text and
+// UI on it keep their sharpness.
+//
+// CompositorDraw is a single pass over the target. Each pixel traces its view
+// ray into the layers front to back, with two early-outs per SimdWidth pixel
+// run: a layer is skipped outside its screen bounds (CompositorLayerBounds),
+// and once the layers in front are opaque nothing behind them is traced, the
+// target and cube layers included, so the environment is only sampled where
+// the warped frame leaves gaps. Without cube layers, pixels no layer covers
+// are left alone.
+//
+// The target is the projection layer: the warped app frame, already drawn by
+// its warp, which stays a pass of its own. The GPU compositor only takes the
+// quads and cylinders, as it blends over the target and can't put a cube
+// beneath it in the same pass; the GPU path draws the environment before it.
+//
+// Layer textures are straight alpha R8G8B8A8Unorm mip chains, premultiplied as
+// they are sampled. Quads show from both sides, and cylinders from inside and
+// out, whichever surface the ray meets first.
+//==============================================================================
+#pragma once
+
+#include "CpuRender.h"
+#include "CpuTexture.h"
+#include "CubeMap.h"
+#include <stdint.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Layers in one pass, as many as the GPU compositor takes
+static const uint32_t CompositorMaxLayers = 4;
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class CompositorLayerType
+{
+    Quad,       // Width x Height in the layer's xy plane, centered on its origin
+    Cylinder,   // Around the layer's y axis, Radius out, CentralAngle wide
+                // centered on +z, and Height high centered on its origin
+    Cube,       // Cube map at infinity, beneath the target, turned by the
+                // layer's rotation
+};
+
+struct CompositorLayer
+{
+    CompositorLayerType Type;
+    float Pose[16];         // Layer to world as row vectors, rotation and translation only
+    float Width;            // Quads only
+    float Height;
+    float Radius;           // Cylinders only
+    float CentralAngle;     // Radians
+    const CpuTexture* Levels;   // Quads and cylinders
+    uint32_t NumLevels;
+    const CpuCubeMap* Cube;     // Cubes only, premultiplied alpha
+};
+
+// Pixels of the target, right and bottom exclusive
+struct CompositorRect
+{
+    uint32_t Left;
+    uint32_t Top;
+    uint32_t Right;
+    uint32_t Bottom;
+};
+
+// Tests of a layer against a SimdWidth pixel run, whether traced or skipped
+struct CompositorStats
+{
+    uint64_t Tests;
+    uint64_t Traced;
+    uint64_t OutOfBounds;
+    uint64_t Occluded;      // Behind opaque layers
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Pixels of 'target' within 'viewport' that 'layer' can cover, seen through
+// 'viewProj'. False if there are none. The whole viewport when part of the
+// layer is behind the eye, and for cubes.
+bool CompositorLayerBounds(const CompositorLayer& layer, const float viewProj[16], const CpuViewport& viewport,
+    const CpuTexture& target, CompositorRect* rect);
+
+// Composites 'layers', in order from back to front, with the R8G8B8A8Unorm
+// 'target' within 'viewport': cube layers, which must come first, beneath
+// it, and the rest over it. 'viewProj' and its inverse are the display pose's,
+// with standard depth, not reversed. Adds to 'stats', which may be null.
+void CompositorDraw(const CompositorLayer* layers, uint32_t numLayers, const float viewProj[16],
+    const float invViewProj[16], const CpuViewport& viewport, CpuTexture* target, CompositorStats* stats);
+
+// Inverse of a rotation and translation, 'layer' to world, as row vectors
+void CompositorInversePose(const float pose[16], float inverse[16]);
@@ -0,0 +1,115 @@
+// Compositor layers (see Compositor.h), traced per pixel over the warped frame
+// in one pass from the full screen triangle of BackgroundVS. Layers go front to
+// back, each skipped outside its screen bounds or once those in front are
+// opaque, and the result blends over the target as premultiplied alpha.
+static const uint MaxLayers = 4;    // CompositorMaxLayers
+static const uint QuadLayer = 0;    // CompositorLayerType
+static const uint CylinderLayer = 1;
+
+Texture2D LayerTextures[MaxLayers];
+SamplerState Sampler;
+
+struct Layer
+{
+    float4x4 WorldToLayer;
+    float4 Bounds;          // Target pixels: left, top, right and bottom
+    uint Type;
+    float Width;
+    float Height;
+    float Radius;
+    float CentralAngle;
+    float3 Padding;
+};
+
+cbuffer Constants
+{
+    float4x4 InvViewProj;   // NDC to world at the display pose
+    uint NumLayers;         // Back to front
+    uint3 Padding;
+    Layer Layers[MaxLayers];
+};
+
+struct VertexIn
+{
+    float4 Position : SV_POSITION;
+    float2 Ndc : TEXCOORD0;
+};
+
+// Texture coordinates where a world space ray meets the layer. Cylinders take
+// the nearer of their two surfaces that the ray hits, or 'farRoot' when told.
+float2 Intersect(Layer layer, float3 origin, float3 direction, bool chooseRoot, inout bool farRoot, out bool hit)
+{
+    float3 p = mul(layer.WorldToLayer, float4(origin, 1)).xyz;
+    float3 d = mul(layer.WorldToLayer, float4(direction, 0)).xyz;
+    if (layer.Type == QuadLayer)
+    {
+        float t = -p.z / d.z;
+        float3 position = p + t * d;
+        float2 uv = float2(position.x / layer.Width + 0.5f, 0.5f - position.y / layer.Height);
+        hit = t > 0 && all(uv == saturate(uv));
+        return uv;
+    }
+
+    float a = dot(d.xz, d.xz);
+    float b = dot(p.xz, d.xz);
+    float c = dot(p.xz, p.xz) - layer.Radius * layer.Radius;
+    float discriminant = b * b - a * c;
+    float root = sqrt(max(discriminant, 0));
+    float2 t = float2(-b - root, -b + root) / a;
+
+    float2 uvs[2];
+    bool hits[2];
+    [unroll]
+    for (uint i = 0; i < 2; ++i)
+    {
+        float3 position = p + t[i] * d;
+        uvs[i] = float2(atan2(position.x, position.z) / layer.CentralAngle + 0.5f, 0.5f - position.y / layer.Height);
+        hits[i] = discriminant >= 0 && t[i] > 0 && all(uvs[i] == saturate(uvs[i]));
+    }
+    if (chooseRoot)
+    {
+        farRoot = !hits[0] && hits[1];
+        hit = hits[0] || hits[1];
+    }
+    else
+    {
+        hit = farRoot ? hits[1] : hits[0];
+    }
+    return farRoot ? uvs[1] : uvs[0];
+}
+
+float4 main(VertexIn input) : SV_TARGET
+{
+    // The rays of this pixel and its neighbors, from their differences while
+    // every pixel of the quad is still running
+    float4 nearPoint = mul(InvViewProj, float4(input.Ndc, 0, 1));
+    float4 farPoint = mul(InvViewProj, float4(input.Ndc, 1, 1));
+    float3 origin = nearPoint.xyz / nearPoint.w;
+    float3 direction = farPoint.xyz / farPoint.w - origin;
+    float3 originDx = ddx_fine(origin);
+    float3 originDy = ddy_fine(origin);
+    float3 directionDx = ddx_fine(direction);
+    float3 directionDy = ddy_fine(direction);
+
+    float4 color = 0;
+    [unroll]
+    for (int n = (int)MaxLayers - 1; n >= 0; --n)
+    {
+        Layer layer = Layers[n];
+        bool inBounds = (uint)n < NumLayers && all(input.Position.xy >= layer.Bounds.xy) &&
+            all(input.Position.xy < layer.Bounds.zw);
+        [branch]
+        if (inBounds && color.a < 1)
+        {
+            bool farRoot = false;
+            bool hit;
+            bool unused;
+            float2 uv = Intersect(layer, origin, direction, true, farRoot, hit);
+            float2 uvDx = Intersect(layer, origin + originDx, direction + directionDx, false, farRoot, unused) - uv;
+            float2 uvDy = Intersect(layer, origin + originDy, direction + directionDy, false, farRoot, unused) - uv;
+            float4 texel = LayerTextures[n].SampleGrad(Sampler, uv, uvDx, uvDy);
+            color += (hit ? (1 - color.a) * texel.a : 0) * float4(texel.rgb, 1);
+        }
+    }
+    return color;
+}
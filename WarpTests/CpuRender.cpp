@@ -0,0 +1,484 @@
+//==============================================================================
+#include "CpuRender.h"
+#include "FrameArena.h"
+#include <assert.h>
+#include <string.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t SystemValuePosition = 1;
+static const uint32_t SystemValueClipDistance = 2;
+static const uint32_t SystemValueInstanceId = 8;
+
+// SV_ClipDistance is at most two registers
+static const uint32_t MaxClipDistances = 8;
+
+// Triangles with a vertex this close to (or behind) the eye are rejected. There
+// is no near plane clipping; none of the geometry drawn here needs it.
+static const float MinClipW = 1e-5f;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// Maps a pixel shader input register to the vertex shader output it reads
+struct VaryingLink
+{
+    uint32_t PSRegister;
+    uint32_t VSRegister;
+};
+
+struct StageLinkage
+{
+    int32_t VSInputRegisters[CpuMaxInputElements];
+    int32_t VSInstanceIdRegister;
+    uint32_t VSPositionRegister;
+    uint32_t VSClipDistances[MaxClipDistances];    // Output register * 4 + component
+    uint32_t NumClipDistances;
+    uint32_t VSNumOutputRegisters;
+    int32_t PSPositionRegister;
+    int32_t PSTargetRegister;
+    VaryingLink Varyings[DxbcMaxRegisters];
+    uint32_t NumVaryings;
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline void ExecuteStage(const DxbcShader* shader, const DxbcProgram* program, const DxbcBindings& bindings,
+    DxbcProgramState* state, DxbcProfile* profile)
+{
+    if (program)
+    {
+        DxbcProgramExecute(*program, state, profile);
+    }
+    else
+    {
+        DxbcExecute(*shader, bindings, &state->Lanes, profile);
+    }
+}
+
+static bool LinkStages(const CpuPipelineState& pipeline, StageLinkage* linkage)
+{
+    const DxbcShader& vs = *pipeline.VertexShader;
+    const DxbcShader& ps = *pipeline.PixelShader;
+
+    memset(linkage, 0, sizeof(*linkage));
+    linkage->VSInstanceIdRegister = -1;
+    linkage->PSPositionRegister = -1;
+    linkage->PSTargetRegister = -1;
+
+    for (uint32_t i = 0; i < pipeline.NumInputElements; ++i)
+    {
+        const auto& element = pipeline.InputElements[i];
+        int32_t index = DxbcFindSignatureElement(vs.InputSignature, element.SemanticName, element.SemanticIndex);
+        linkage->VSInputRegisters[i] = index < 0 ? -1 : (int32_t)vs.InputSignature[index].Register;
+    }
+
+    for (const auto& element : vs.InputSignature)
+    {
+        if (element.SystemValue == SystemValueInstanceId)
+        {
+            linkage->VSInstanceIdRegister = element.Register;
+        }
+    }
+
+    bool foundPosition = false;
+    for (const auto& element : vs.OutputSignature)
+    {
+        if (element.SystemValue == SystemValuePosition)
+        {
+            linkage->VSPositionRegister = element.Register;
+            foundPosition = true;
+        }
+        if (element.SystemValue == SystemValueClipDistance)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                if ((element.Mask & (1 << c)) && linkage->NumClipDistances < MaxClipDistances)
+                {
+                    linkage->VSClipDistances[linkage->NumClipDistances++] = element.Register * 4 + c;
+                }
+            }
+        }
+        if (element.Register + 1 > linkage->VSNumOutputRegisters)
+        {
+            linkage->VSNumOutputRegisters = element.Register + 1;
+        }
+    }
+
+    if (!foundPosition)
+    {
+        return false;
+    }
+
+    for (const auto& element : ps.InputSignature)
+    {
+        if (element.SystemValue == SystemValuePosition)
+        {
+            linkage->PSPositionRegister = element.Register;
+            continue;
+        }
+
+        int32_t index = DxbcFindSignatureElement(vs.OutputSignature, element.SemanticName, element.SemanticIndex);
+        if (index < 0)
+        {
+            return false;
+        }
+
+        auto& varying = linkage->Varyings[linkage->NumVaryings++];
+        varying.PSRegister = element.Register;
+        varying.VSRegister = vs.OutputSignature[index].Register;
+    }
+
+    int32_t target = DxbcFindSignatureElement(ps.OutputSignature, "SV_TARGET", 0);
+    if (target < 0)
+    {
+        return false;
+    }
+    linkage->PSTargetRegister = ps.OutputSignature[target].Register;
+
+    return true;
+}
+
+static void RunVertexShader(const CpuPipelineState& pipeline, const StageLinkage& linkage, uint32_t instance,
+    DxbcProgramState* state, float* outputs, DxbcProfile* profile)
+{
+    uint32_t outputStride = linkage.VSNumOutputRegisters * 4;
+    DxbcLanes& lanes = state->Lanes;
+
+    alignas(32) float values[4][SimdWidth];
+
+    if (linkage.VSInstanceIdRegister >= 0)
+    {
+        SimdFloat* reg = lanes.Inputs[linkage.VSInstanceIdRegister];
+        reg[0] = SimdAsFloat(SimdIntSet((int32_t)instance));
+        reg[1] = reg[2] = reg[3] = SimdZero();
+    }
+
+    for (uint32_t base = 0; base < pipeline.NumVertices; base += SimdWidth)
+    {
+        uint32_t count = pipeline.NumVertices - base < SimdWidth ? pipeline.NumVertices - base : SimdWidth;
+
+        for (uint32_t e = 0; e < pipeline.NumInputElements; ++e)
+        {
+            const auto& element = pipeline.InputElements[e];
+            if (linkage.VSInputRegisters[e] < 0)
+            {
+                continue;
+            }
+
+            memset(values, 0, sizeof(values));
+            for (uint32_t lane = 0; lane < count; ++lane)
+            {
+                const float* src = (const float*)(pipeline.Vertices + (base + lane) * pipeline.Stride + element.AlignedByteOffset);
+                for (uint32_t c = 0; c < element.NumComponents; ++c)
+                {
+                    values[c][lane] = src[c];
+                }
+                // Missing components default to (0, 0, 0, 1) like the input assembler
+                if (element.NumComponents < 4)
+                {
+                    values[3][lane] = 1.f;
+                }
+            }
+
+            for (int c = 0; c < 4; ++c)
+            {
+                lanes.Inputs[linkage.VSInputRegisters[e]][c] = SimdLoad(values[c]);
+            }
+        }
+
+        ExecuteStage(pipeline.VertexShader, pipeline.VertexProgram, pipeline.VSBindings, state, profile);
+
+        for (uint32_t r = 0; r < linkage.VSNumOutputRegisters; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                SimdStore(values[c], lanes.Outputs[r][c]);
+            }
+
+            for (uint32_t lane = 0; lane < count; ++lane)
+            {
+                float* dst = outputs + (base + lane) * outputStride + r * 4;
+                for (int c = 0; c < 4; ++c)
+                {
+                    dst[c] = values[c][lane];
+                }
+            }
+        }
+    }
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool CpuDrawIndexed(const CpuPipelineState& pipeline, CpuTexture* renderTarget, CpuTexture* depth, CpuRenderProfile* profile)
+{
+    StageLinkage linkage;
+    if (!LinkStages(pipeline, &linkage))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Program states and vertex outputs live until the draw returns
+    Arena* scratch = ThreadArena();
+    if (!scratch)
+    {
+        assert(false);
+        return false;
+    }
+    ArenaScope scope(scratch);
+
+    uint32_t numInstances = pipeline.NumInstances ? pipeline.NumInstances : 1;
+    uint32_t outputStride = linkage.VSNumOutputRegisters * 4;
+    DxbcProgramState* vsState = ArenaAllocArray<DxbcProgramState>(scratch, 1);
+    DxbcProgramState* psState = ArenaAllocArray<DxbcProgramState>(scratch, 1);
+    float* vertexOutputs = ArenaAllocArray<float>(scratch, (size_t)pipeline.NumVertices * numInstances * outputStride);
+    if (!vsState || !psState || !vertexOutputs)
+    {
+        assert(false);
+        return false;
+    }
+    memset(vsState, 0, sizeof(*vsState));
+    memset(psState, 0, sizeof(*psState));
+
+    if (pipeline.VertexProgram)
+    {
+        DxbcProgramBind(*pipeline.VertexProgram, pipeline.VSBindings, vsState);
+    }
+    if (pipeline.PixelProgram)
+    {
+        DxbcProgramBind(*pipeline.PixelProgram, pipeline.PSBindings, psState);
+    }
+
+    for (uint32_t instance = 0; instance < numInstances; ++instance)
+    {
+        RunVertexShader(pipeline, linkage, instance, vsState,
+            vertexOutputs + (size_t)instance * pipeline.NumVertices * outputStride,
+            profile ? &profile->VertexShader : nullptr);
+    }
+
+    CpuViewport viewport = pipeline.Viewport;
+    if (viewport.Width == 0.f)
+    {
+        viewport.TopLeftX = 0.f;
+        viewport.TopLeftY = 0.f;
+        viewport.Width = (float)renderTarget->Width;
+        viewport.Height = (float)renderTarget->Height;
+    }
+
+    // Pixels outside the viewport are clipped like D3D11 does
+    const float scissorX0 = viewport.TopLeftX > 0.f ? viewport.TopLeftX : 0.f;
+    const float scissorY0 = viewport.TopLeftY > 0.f ? viewport.TopLeftY : 0.f;
+    const float scissorX1 = viewport.TopLeftX + viewport.Width < renderTarget->Width ?
+        viewport.TopLeftX + viewport.Width : (float)renderTarget->Width;
+    const float scissorY1 = viewport.TopLeftY + viewport.Height < renderTarget->Height ?
+        viewport.TopLeftY + viewport.Height : (float)renderTarget->Height;
+
+    DxbcLanes& lanes = psState->Lanes;
+
+    for (uint32_t drawn = 0; drawn + 2 < pipeline.NumIndices * numInstances; drawn += 3)
+    {
+        uint32_t instance = drawn / pipeline.NumIndices;
+        uint32_t tri = drawn - instance * pipeline.NumIndices;
+        const float* instanceOutputs = vertexOutputs + (size_t)instance * pipeline.NumVertices * outputStride;
+
+        const float* v[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t index = pipeline.Indices[tri + i];
+            if (index >= pipeline.NumVertices)
+            {
+                assert(false);
+                return false;
+            }
+            v[i] = instanceOutputs + (size_t)index * outputStride;
+        }
+
+        // Clip space to screen space
+        float sx[3], sy[3], sz[3], invW[3];
+        bool rejected = false;
+        for (int i = 0; i < 3; ++i)
+        {
+            const float* pos = v[i] + linkage.VSPositionRegister * 4;
+            if (!(pos[3] > MinClipW))
+            {
+                rejected = true;
+                break;
+            }
+            invW[i] = 1.f / pos[3];
+            sx[i] = viewport.TopLeftX + (pos[0] * invW[i] + 1.f) * 0.5f * viewport.Width;
+            sy[i] = viewport.TopLeftY + (1.f - pos[1] * invW[i]) * 0.5f * viewport.Height;
+            sz[i] = pos[2] * invW[i];
+        }
+
+        // Clip distances pre-divided by w like the varyings. Only the sign is
+        // tested per pixel, so they don't need the multiply by w afterwards.
+        float clipDistances[MaxClipDistances][3];
+        for (uint32_t n = 0; n < linkage.NumClipDistances && !rejected; ++n)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                clipDistances[n][i] = v[i][linkage.VSClipDistances[n]] * invW[i];
+            }
+            rejected = clipDistances[n][0] < 0.f && clipDistances[n][1] < 0.f && clipDistances[n][2] < 0.f;
+        }
+
+        // Positive area is clockwise on screen, which D3D11 treats as front facing
+        float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+        if (rejected || area == 0.f || (pipeline.CullBackFaces && area < 0.f))
+        {
+            if (profile)
+            {
+                ++profile->TrianglesCulled;
+            }
+            continue;
+        }
+
+        if (profile)
+        {
+            ++profile->TrianglesDrawn;
+        }
+
+        // Edge equations, oriented so covered pixels are non-negative
+        float sign = area > 0.f ? 1.f : -1.f;
+        float invArea = 1.f / (area * sign);
+        float edgeA[3], edgeB[3], edgeC[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            int j = (i + 1) % 3;
+            int k = (i + 2) % 3;
+            // Edge opposite vertex i, from j to k
+            edgeA[i] = (sy[j] - sy[k]) * sign;
+            edgeB[i] = (sx[k] - sx[j]) * sign;
+            edgeC[i] = (sx[j] * sy[k] - sx[k] * sy[j]) * sign;
+        }
+
+        float minX = sx[0] < sx[1] ? sx[0] : sx[1];
+        minX = minX < sx[2] ? minX : sx[2];
+        float maxX = sx[0] > sx[1] ? sx[0] : sx[1];
+        maxX = maxX > sx[2] ? maxX : sx[2];
+        float minY = sy[0] < sy[1] ? sy[0] : sy[1];
+        minY = minY < sy[2] ? minY : sy[2];
+        float maxY = sy[0] > sy[1] ? sy[0] : sy[1];
+        maxY = maxY > sy[2] ? maxY : sy[2];
+
+        int32_t x0 = minX < scissorX0 ? (int32_t)scissorX0 : (int32_t)minX;
+        int32_t y0 = minY < scissorY0 ? (int32_t)scissorY0 : (int32_t)minY;
+        int32_t x1 = maxX >= scissorX1 ? (int32_t)scissorX1 - 1 : (int32_t)maxX;
+        int32_t y1 = maxY >= scissorY1 ? (int32_t)scissorY1 - 1 : (int32_t)maxY;
+        if (x0 > x1 || y0 > y1)
+        {
+            continue;
+        }
+
+        // Pre-divide varyings by w for perspective correct interpolation
+        float varyings[DxbcMaxRegisters][3][4];
+        for (uint32_t n = 0; n < linkage.NumVaryings; ++n)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                const float* src = v[i] + linkage.Varyings[n].VSRegister * 4;
+                for (int c = 0; c < 4; ++c)
+                {
+                    varyings[n][i][c] = src[c] * invW[i];
+                }
+            }
+        }
+
+        for (int32_t y = y0; y <= y1; ++y)
+        {
+            SimdFloat py = SimdSet(y + 0.5f);
+            float* depthRow = depth ? (float*)(depth->Data + (size_t)y * depth->RowPitch) : nullptr;
+
+            for (int32_t x = x0; x <= x1; x += SimdWidth)
+            {
+                uint32_t count = (uint32_t)(x1 - x + 1) < SimdWidth ? (uint32_t)(x1 - x + 1) : SimdWidth;
+                SimdFloat px = SimdAdd(SimdSet(x + 0.5f), SimdLaneIndex());
+
+                SimdFloat b[3];
+                SimdFloat mask = SimdFirstLanes(count);
+                for (int i = 0; i < 3; ++i)
+                {
+                    SimdFloat e = SimdAdd(SimdMad(SimdSet(edgeA[i]), px, SimdMul(SimdSet(edgeB[i]), py)), SimdSet(edgeC[i]));
+                    mask = SimdAnd(mask, SimdCmpGe(e, SimdZero()));
+                    b[i] = SimdMul(e, SimdSet(invArea));
+                }
+
+                for (uint32_t n = 0; n < linkage.NumClipDistances; ++n)
+                {
+                    SimdFloat distance = SimdMad(b[0], SimdSet(clipDistances[n][0]),
+                        SimdMad(b[1], SimdSet(clipDistances[n][1]), SimdMul(b[2], SimdSet(clipDistances[n][2]))));
+                    mask = SimdAnd(mask, SimdCmpGe(distance, SimdZero()));
+                }
+
+                if (!SimdMoveMask(mask))
+                {
+                    continue;
+                }
+
+                SimdFloat z = SimdMad(b[0], SimdSet(sz[0]), SimdMad(b[1], SimdSet(sz[1]), SimdMul(b[2], SimdSet(sz[2]))));
+                mask = SimdAnd(mask, SimdAnd(SimdCmpGe(z, SimdZero()), SimdCmpLe(z, SimdSet(1.f))));
+
+                alignas(32) float depthValues[SimdWidth];
+                if (depthRow)
+                {
+                    for (uint32_t lane = 0; lane < SimdWidth; ++lane)
+                    {
+                        depthValues[lane] = lane < count ? depthRow[x + lane] : 0.f;
+                    }
+                    SimdFloat stored = SimdLoad(depthValues);
+                    mask = SimdAnd(mask, (pipeline.DepthFunc == CpuDepthFunc::Greater) ? SimdCmpLt(stored, z) : SimdCmpLt(z, stored));
+                }
+
+                if (!SimdMoveMask(mask))
+                {
+                    continue;
+                }
+
+                SimdFloat iw = SimdMad(b[0], SimdSet(invW[0]), SimdMad(b[1], SimdSet(invW[1]), SimdMul(b[2], SimdSet(invW[2]))));
+                SimdFloat w = SimdDiv(SimdSet(1.f), iw);
+
+                for (uint32_t n = 0; n < linkage.NumVaryings; ++n)
+                {
+                    SimdFloat* reg = lanes.Inputs[linkage.Varyings[n].PSRegister];
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        SimdFloat value = SimdMad(b[0], SimdSet(varyings[n][0][c]),
+                            SimdMad(b[1], SimdSet(varyings[n][1][c]), SimdMul(b[2], SimdSet(varyings[n][2][c]))));
+                        reg[c] = SimdMul(value, w);
+                    }
+                }
+
+                if (linkage.PSPositionRegister >= 0)
+                {
+                    SimdFloat* reg = lanes.Inputs[linkage.PSPositionRegister];
+                    reg[0] = px;
+                    reg[1] = py;
+                    reg[2] = z;
+                    reg[3] = iw;
+                }
+
+                ExecuteStage(pipeline.PixelShader, pipeline.PixelProgram, pipeline.PSBindings, psState,
+                    profile ? &profile->PixelShader : nullptr);
+                mask = SimdAndNot(lanes.Discarded, mask);
+
+                if (depthRow)
+                {
+                    SimdStore(depthValues, SimdSelect(mask, z, SimdLoad(depthValues)));
+                    for (uint32_t lane = 0; lane < count; ++lane)
+                    {
+                        depthRow[x + lane] = depthValues[lane];
+                    }
+                }
+
+                CpuTextureStoreRow(renderTarget, x, y, count, mask, lanes.Outputs[linkage.PSTargetRegister]);
+            }
+        }
+    }
+
+    return true;
+}
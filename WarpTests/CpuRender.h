@@ -0,0 +1,90 @@
+//==============================================================================
+// Software rasterizer that executes the project's DXBC shaders through the
+// interpreter in Dxbc.h, or as compiled programs from DxbcCompiler.h. Follows
+// the D3D11 defaults the GPU path relies on: clockwise front faces with back
+// face culling, LESS depth test, pixel centers at +0.5 and perspective correct
+// attribute interpolation. Reversed-Z depth can switch the test to GREATER.
+//==============================================================================
+#pragma once
+
+#include "Dxbc.h"
+#include "DxbcCompiler.h"
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t CpuMaxInputElements = 8;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct CpuInputElement
+{
+    const char* SemanticName;
+    uint32_t SemanticIndex;
+    uint32_t NumComponents;     // 32 bit float components
+    uint32_t AlignedByteOffset;
+};
+
+enum class CpuDepthFunc
+{
+    Less,
+    Greater,
+};
+
+// Same convention as D3D11_VIEWPORT, without the depth range. A zero width
+// covers the whole render target.
+struct CpuViewport
+{
+    float TopLeftX;
+    float TopLeftY;
+    float Width;
+    float Height;
+};
+
+struct CpuPipelineState
+{
+    const DxbcShader* VertexShader;
+    const DxbcShader* PixelShader;
+    // Optional compiled versions of the shaders above. When set they are
+    // executed instead of interpreting the bytecode.
+    const DxbcProgram* VertexProgram;
+    const DxbcProgram* PixelProgram;
+    DxbcBindings VSBindings;
+    DxbcBindings PSBindings;
+    CpuInputElement InputElements[CpuMaxInputElements];
+    uint32_t NumInputElements;
+    const uint8_t* Vertices;
+    uint32_t NumVertices;
+    uint32_t Stride;
+    const uint32_t* Indices;
+    uint32_t NumIndices;
+    uint32_t NumInstances;      // Instances of the index list, 0 draws one
+    CpuViewport Viewport;
+    bool CullBackFaces;
+    CpuDepthFunc DepthFunc;
+};
+
+struct CpuRenderProfile
+{
+    DxbcProfile VertexShader;
+    DxbcProfile PixelShader;
+    uint64_t TrianglesDrawn;
+    uint64_t TrianglesCulled;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Draws an indexed triangle list into 'renderTarget'. 'depth' (R32Float) may
+// be null to disable depth testing. 'profile' may be null.
+//
+// Vertex shaders can read SV_InstanceID and write SV_ClipDistance; pixels
+// where any interpolated clip distance is negative are not shaded.
+//
+// Scratch comes from the calling thread's ThreadArena (see FrameArena.h), so a
+// draw doesn't touch the heap.
+bool CpuDrawIndexed(const CpuPipelineState& pipeline, CpuTexture* renderTarget, CpuTexture* depth, CpuRenderProfile* profile);
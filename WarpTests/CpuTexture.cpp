@@ -0,0 +1,577 @@
+//==============================================================================
+#include "CpuTexture.h"
+#include "BlockCompress.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline void FetchTexel(const CpuTexture& texture, int32_t x, int32_t y, float out[4])
+{
+    if (CpuFormatIsBlockCompressed(texture.Format))
+    {
+        const uint8_t* block = texture.Data + (size_t)(y >> 2) * texture.RowPitch +
+            (size_t)(x >> 2) * CpuFormatBytesPerBlock(texture.Format);
+        uint8_t texel[4];
+        BlockDecodeTexel(texture.Format, block, (uint32_t)((y & 3) * 4 + (x & 3)), texel);
+        out[0] = texel[0] * (1.f / 255.f);
+        out[1] = texel[1] * (1.f / 255.f);
+        out[2] = texel[2] * (1.f / 255.f);
+        out[3] = texel[3] * (1.f / 255.f);
+        return;
+    }
+
+    const uint8_t* row = texture.Data + (size_t)y * texture.RowPitch;
+    switch (texture.Format)
+    {
+    case CpuFormat::R8G8B8A8Unorm:
+    {
+        const uint8_t* p = row + x * 4;
+        out[0] = p[0] * (1.f / 255.f);
+        out[1] = p[1] * (1.f / 255.f);
+        out[2] = p[2] * (1.f / 255.f);
+        out[3] = p[3] * (1.f / 255.f);
+        break;
+    }
+
+    case CpuFormat::R16Unorm:
+        out[0] = ((const uint16_t*)row)[x] * (1.f / 65535.f);
+        out[1] = 0.f;
+        out[2] = 0.f;
+        out[3] = 1.f;
+        break;
+
+    case CpuFormat::R32Float:
+        out[0] = ((const float*)row)[x];
+        out[1] = 0.f;
+        out[2] = 0.f;
+        out[3] = 1.f;
+        break;
+
+    case CpuFormat::R32G32Float:
+        memcpy(out, row + x * 8, 8);
+        out[2] = 0.f;
+        out[3] = 1.f;
+        break;
+
+    case CpuFormat::R32G32B32A32Float:
+        memcpy(out, row + x * 16, 16);
+        break;
+
+    case CpuFormat::BC1Unorm:
+    case CpuFormat::BC3Unorm:
+    case CpuFormat::BC7Unorm:
+        // Decoded with BlockDecodeTexel above
+        assert(false);
+        break;
+    }
+}
+
+// Resolves a texel coordinate against the address mode. Returns false if the
+// border color should be used instead.
+static inline bool AddressTexel(int32_t* coord, int32_t size, CpuAddressMode mode)
+{
+    if (*coord >= 0 && *coord < size)
+    {
+        return true;
+    }
+
+    switch (mode)
+    {
+    case CpuAddressMode::Clamp:
+        *coord = *coord < 0 ? 0 : size - 1;
+        return true;
+
+    case CpuAddressMode::Wrap:
+        *coord %= size;
+        if (*coord < 0)
+        {
+            *coord += size;
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static inline void FetchAddressed(const CpuTexture& texture, const CpuSampler& sampler, int32_t x, int32_t y, float out[4])
+{
+    if (!AddressTexel(&x, (int32_t)texture.Width, sampler.Address) ||
+        !AddressTexel(&y, (int32_t)texture.Height, sampler.Address))
+    {
+        memcpy(out, sampler.BorderColor, sizeof(sampler.BorderColor));
+        return;
+    }
+
+    FetchTexel(texture, x, y, out);
+}
+
+// One lane of CpuTextureSample
+static void SampleTexel(const CpuTexture& texture, const CpuSampler& sampler, float u, float v, float out[4])
+{
+    float tu = u * texture.Width;
+    float tv = v * texture.Height;
+
+    if (sampler.Filter == CpuFilter::Point)
+    {
+        FetchAddressed(texture, sampler, (int32_t)floorf(tu), (int32_t)floorf(tv), out);
+        return;
+    }
+
+    tu -= 0.5f;
+    tv -= 0.5f;
+    float fu = floorf(tu);
+    float fv = floorf(tv);
+    float wu = tu - fu;
+    float wv = tv - fv;
+    int32_t x = (int32_t)fu;
+    int32_t y = (int32_t)fv;
+
+    float t00[4], t10[4], t01[4], t11[4];
+    FetchAddressed(texture, sampler, x, y, t00);
+    FetchAddressed(texture, sampler, x + 1, y, t10);
+    FetchAddressed(texture, sampler, x, y + 1, t01);
+    FetchAddressed(texture, sampler, x + 1, y + 1, t11);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        float top = t00[c] + (t10[c] - t00[c]) * wu;
+        float bottom = t01[c] + (t11[c] - t01[c]) * wu;
+        out[c] = top + (bottom - top) * wv;
+    }
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+uint32_t CpuFormatBytesPerTexel(CpuFormat format)
+{
+    switch (format)
+    {
+    case CpuFormat::R8G8B8A8Unorm: return 4;
+    case CpuFormat::R16Unorm: return 2;
+    case CpuFormat::R32Float: return 4;
+    case CpuFormat::R32G32Float: return 8;
+    case CpuFormat::R32G32B32A32Float: return 16;
+    default: return 0;      // Block compressed
+    }
+}
+
+//==============================================================================
+uint32_t CpuFormatBlockSize(CpuFormat format)
+{
+    return CpuFormatIsBlockCompressed(format) ? 4 : 1;
+}
+
+//==============================================================================
+uint32_t CpuFormatBytesPerBlock(CpuFormat format)
+{
+    switch (format)
+    {
+    case CpuFormat::BC1Unorm: return 8;
+    case CpuFormat::BC3Unorm: return 16;
+    case CpuFormat::BC7Unorm: return 16;
+    default: return CpuFormatBytesPerTexel(format);
+    }
+}
+
+//==============================================================================
+bool CpuFormatIsBlockCompressed(CpuFormat format)
+{
+    return format == CpuFormat::BC1Unorm || format == CpuFormat::BC3Unorm || format == CpuFormat::BC7Unorm;
+}
+
+//==============================================================================
+uint64_t CpuFormatImageBytes(CpuFormat format, uint32_t width, uint32_t height)
+{
+    uint32_t blockSize = CpuFormatBlockSize(format);
+    uint64_t blocksWide = (width + blockSize - 1) / blockSize;
+    uint64_t blocksHigh = (height + blockSize - 1) / blockSize;
+    return blocksWide * blocksHigh * CpuFormatBytesPerBlock(format);
+}
+
+//==============================================================================
+const char* CpuFormatName(CpuFormat format)
+{
+    switch (format)
+    {
+    case CpuFormat::R8G8B8A8Unorm: return "R8G8B8A8";
+    case CpuFormat::R16Unorm: return "R16";
+    case CpuFormat::R32Float: return "R32F";
+    case CpuFormat::R32G32Float: return "R32G32F";
+    case CpuFormat::R32G32B32A32Float: return "R32G32B32A32F";
+    case CpuFormat::BC1Unorm: return "BC1";
+    case CpuFormat::BC3Unorm: return "BC3";
+    case CpuFormat::BC7Unorm: return "BC7";
+    }
+    return "";
+}
+
+//==============================================================================
+bool CpuTextureCreate(uint32_t width, uint32_t height, CpuFormat format, CpuTexture* texture)
+{
+    texture->Width = width;
+    texture->Height = height;
+    texture->Format = format;
+    // Keep rows 64 byte aligned so row loads never straddle cache lines. Rows
+    // of a block-compressed format are rows of blocks.
+    uint32_t blockSize = CpuFormatBlockSize(format);
+    uint32_t blocksHigh = (height + blockSize - 1) / blockSize;
+    texture->RowPitch = ((width + blockSize - 1) / blockSize * CpuFormatBytesPerBlock(format) + 63) & ~63u;
+    texture->Data = (uint8_t*)calloc((size_t)texture->RowPitch * blocksHigh, 1);
+    if (!texture->Data)
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void CpuTextureDestroy(CpuTexture* texture)
+{
+    free(texture->Data);
+    texture->Data = nullptr;
+}
+
+//==============================================================================
+void CpuTextureClear(CpuTexture* texture, const float value[4])
+{
+    if (CpuFormatIsBlockCompressed(texture->Format))
+    {
+        assert(false);
+        return;
+    }
+
+    uint8_t texel[16]{};
+    uint32_t bpp = CpuFormatBytesPerTexel(texture->Format);
+
+    switch (texture->Format)
+    {
+    case CpuFormat::R8G8B8A8Unorm:
+        for (int i = 0; i < 4; ++i)
+        {
+            float c = value[i] < 0.f ? 0.f : (value[i] > 1.f ? 1.f : value[i]);
+            texel[i] = (uint8_t)(c * 255.f + 0.5f);
+        }
+        break;
+
+    case CpuFormat::R16Unorm:
+    {
+        float c = value[0] < 0.f ? 0.f : (value[0] > 1.f ? 1.f : value[0]);
+        uint16_t v = (uint16_t)(c * 65535.f + 0.5f);
+        memcpy(texel, &v, 2);
+        break;
+    }
+
+    case CpuFormat::R32Float:
+        memcpy(texel, value, 4);
+        break;
+
+    case CpuFormat::R32G32Float:
+        memcpy(texel, value, 8);
+        break;
+
+    case CpuFormat::R32G32B32A32Float:
+        memcpy(texel, value, 16);
+        break;
+
+    case CpuFormat::BC1Unorm:
+    case CpuFormat::BC3Unorm:
+    case CpuFormat::BC7Unorm:
+        // Can't be cleared texel by texel, rejected above
+        assert(false);
+        break;
+    }
+
+    for (uint32_t y = 0; y < texture->Height; ++y)
+    {
+        uint8_t* row = texture->Data + (size_t)y * texture->RowPitch;
+        for (uint32_t x = 0; x < texture->Width; ++x)
+        {
+            memcpy(row + x * bpp, texel, bpp);
+        }
+    }
+}
+
+//==============================================================================
+void CpuTextureLoad(const CpuTexture& texture, SimdInt x, SimdInt y, SimdFloat out[4])
+{
+    alignas(32) int32_t vx[SimdWidth], vy[SimdWidth];
+    alignas(32) float result[4][SimdWidth];
+    SimdIntStore(vx, x);
+    SimdIntStore(vy, y);
+
+    for (uint32_t i = 0; i < SimdWidth; ++i)
+    {
+        float texel[4]{};
+        if ((uint32_t)vx[i] < texture.Width && (uint32_t)vy[i] < texture.Height)
+        {
+            FetchTexel(texture, vx[i], vy[i], texel);
+        }
+        result[0][i] = texel[0];
+        result[1][i] = texel[1];
+        result[2][i] = texel[2];
+        result[3][i] = texel[3];
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdLoad(result[c]);
+    }
+}
+
+//==============================================================================
+void CpuTextureSample(const CpuTexture& texture, const CpuSampler& sampler, SimdFloat u, SimdFloat v, SimdFloat out[4])
+{
+    // Texel space, with texel centers at integer + 0.5
+    SimdFloat tu = SimdMul(u, SimdSet((float)texture.Width));
+    SimdFloat tv = SimdMul(v, SimdSet((float)texture.Height));
+
+    alignas(32) float result[4][SimdWidth];
+
+    if (sampler.Filter == CpuFilter::Point)
+    {
+        alignas(32) int32_t vx[SimdWidth], vy[SimdWidth];
+        SimdIntStore(vx, SimdFtoi(SimdFloor(tu)));
+        SimdIntStore(vy, SimdFtoi(SimdFloor(tv)));
+
+        for (uint32_t i = 0; i < SimdWidth; ++i)
+        {
+            float texel[4];
+            FetchAddressed(texture, sampler, vx[i], vy[i], texel);
+            for (int c = 0; c < 4; ++c)
+            {
+                result[c][i] = texel[c];
+            }
+        }
+    }
+    else
+    {
+        tu = SimdSub(tu, SimdSet(0.5f));
+        tv = SimdSub(tv, SimdSet(0.5f));
+        SimdFloat fu = SimdFloor(tu);
+        SimdFloat fv = SimdFloor(tv);
+
+        alignas(32) int32_t vx[SimdWidth], vy[SimdWidth];
+        alignas(32) float wu[SimdWidth], wv[SimdWidth];
+        SimdIntStore(vx, SimdFtoi(fu));
+        SimdIntStore(vy, SimdFtoi(fv));
+        SimdStore(wu, SimdSub(tu, fu));
+        SimdStore(wv, SimdSub(tv, fv));
+
+        for (uint32_t i = 0; i < SimdWidth; ++i)
+        {
+            float t00[4], t10[4], t01[4], t11[4];
+            FetchAddressed(texture, sampler, vx[i], vy[i], t00);
+            FetchAddressed(texture, sampler, vx[i] + 1, vy[i], t10);
+            FetchAddressed(texture, sampler, vx[i], vy[i] + 1, t01);
+            FetchAddressed(texture, sampler, vx[i] + 1, vy[i] + 1, t11);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                float top = t00[c] + (t10[c] - t00[c]) * wu[i];
+                float bottom = t01[c] + (t11[c] - t01[c]) * wu[i];
+                result[c][i] = top + (bottom - top) * wv[i];
+            }
+        }
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdLoad(result[c]);
+    }
+}
+
+//==============================================================================
+void CpuTextureSampleLevel(const CpuTexture* levels, uint32_t numLevels, const CpuSampler& sampler, SimdFloat u, SimdFloat v,
+    SimdFloat lod, SimdFloat out[4])
+{
+    lod = SimdMin(SimdMax(lod, SimdZero()), SimdSet((float)(numLevels - 1)));
+    SimdFloat level = (sampler.Filter == CpuFilter::Point) ? SimdFloor(SimdAdd(lod, SimdSet(0.5f))) : SimdFloor(lod);
+    SimdFloat blend = (sampler.Filter == CpuFilter::Point) ? SimdZero() : SimdSub(lod, level);
+
+    // Usually every lane reads the same levels, so the whole vector samples
+    // them in one go
+    alignas(32) float vlevel[SimdWidth];
+    SimdStore(vlevel, level);
+    if (SimdMoveMask(SimdCmpEq(level, SimdSet(vlevel[0]))) == (1u << SimdWidth) - 1)
+    {
+        uint32_t first = (uint32_t)vlevel[0];
+        CpuTextureSample(levels[first], sampler, u, v, out);
+        if (SimdMoveMask(SimdCmpGe(SimdZero(), blend)) != (1u << SimdWidth) - 1)
+        {
+            SimdFloat next[4];
+            CpuTextureSample(levels[first + 1], sampler, u, v, next);
+            for (int c = 0; c < 4; ++c)
+            {
+                out[c] = SimdLerp(out[c], next[c], blend);
+            }
+        }
+        return;
+    }
+
+    alignas(32) float vu[SimdWidth], vv[SimdWidth], vblend[SimdWidth];
+    alignas(32) float result[4][SimdWidth];
+    SimdStore(vu, u);
+    SimdStore(vv, v);
+    SimdStore(vblend, blend);
+
+    for (uint32_t i = 0; i < SimdWidth; ++i)
+    {
+        float texel[4];
+        uint32_t first = (uint32_t)vlevel[i];
+        SampleTexel(levels[first], sampler, vu[i], vv[i], texel);
+        if (vblend[i] > 0.f)
+        {
+            float next[4];
+            SampleTexel(levels[first + 1], sampler, vu[i], vv[i], next);
+            for (int c = 0; c < 4; ++c)
+            {
+                texel[c] += (next[c] - texel[c]) * vblend[i];
+            }
+        }
+
+        for (int c = 0; c < 4; ++c)
+        {
+            result[c][i] = texel[c];
+        }
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdLoad(result[c]);
+    }
+}
+
+//==============================================================================
+void CpuTextureStoreRow(CpuTexture* texture, uint32_t x, uint32_t y, uint32_t count, SimdFloat mask, const SimdFloat value[4])
+{
+    if (CpuFormatIsBlockCompressed(texture->Format))
+    {
+        assert(false);
+        return;
+    }
+
+    alignas(32) float v[4][SimdWidth];
+    for (int c = 0; c < 4; ++c)
+    {
+        SimdStore(v[c], value[c]);
+    }
+
+    uint32_t bits = SimdMoveMask(mask);
+    uint8_t* row = texture->Data + (size_t)y * texture->RowPitch;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!(bits & (1u << i)))
+        {
+            continue;
+        }
+
+        switch (texture->Format)
+        {
+        case CpuFormat::R8G8B8A8Unorm:
+        {
+            uint8_t* p = row + (x + i) * 4;
+            for (int c = 0; c < 4; ++c)
+            {
+                float f = v[c][i] < 0.f ? 0.f : (v[c][i] > 1.f ? 1.f : v[c][i]);
+                p[c] = (uint8_t)(f * 255.f + 0.5f);
+            }
+            break;
+        }
+
+        case CpuFormat::R16Unorm:
+        {
+            float f = v[0][i] < 0.f ? 0.f : (v[0][i] > 1.f ? 1.f : v[0][i]);
+            ((uint16_t*)row)[x + i] = (uint16_t)(f * 65535.f + 0.5f);
+            break;
+        }
+
+        case CpuFormat::R32Float:
+            ((float*)row)[x + i] = v[0][i];
+            break;
+
+        case CpuFormat::R32G32Float:
+            ((float*)row)[(x + i) * 2 + 0] = v[0][i];
+            ((float*)row)[(x + i) * 2 + 1] = v[1][i];
+            break;
+
+        case CpuFormat::R32G32B32A32Float:
+        {
+            float* p = (float*)(row + (x + i) * 16);
+            for (int c = 0; c < 4; ++c)
+            {
+                p[c] = v[c][i];
+            }
+            break;
+        }
+
+        case CpuFormat::BC1Unorm:
+        case CpuFormat::BC3Unorm:
+        case CpuFormat::BC7Unorm:
+            // Can't be written texel by texel, rejected above
+            assert(false);
+            break;
+        }
+    }
+}
+
+//==============================================================================
+bool CpuTextureCompare(const CpuTexture& a, const CpuTexture& b, CpuTextureDiff* diff)
+{
+    return CpuTextureCompareMasked(a, b, nullptr, nullptr, diff);
+}
+
+//==============================================================================
+bool CpuTextureCompareMasked(const CpuTexture& a, const CpuTexture& b, CpuTextureMask mask, const void* context,
+    CpuTextureDiff* diff)
+{
+    if (a.Width != b.Width || a.Height != b.Height ||
+        a.Format != CpuFormat::R8G8B8A8Unorm || b.Format != CpuFormat::R8G8B8A8Unorm)
+    {
+        return false;
+    }
+
+    uint32_t maxError = 0;
+    uint64_t sumError = 0;
+    uint64_t sumSquaredError = 0;
+    uint64_t numPixels = 0;
+
+    for (uint32_t y = 0; y < a.Height; ++y)
+    {
+        const uint8_t* rowA = a.Data + (size_t)y * a.RowPitch;
+        const uint8_t* rowB = b.Data + (size_t)y * b.RowPitch;
+        for (uint32_t x = 0; x < a.Width; ++x)
+        {
+            if (mask && !mask(context, x, y))
+            {
+                continue;
+            }
+
+            ++numPixels;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                int32_t delta = (int32_t)rowA[x * 4 + c] - (int32_t)rowB[x * 4 + c];
+                uint32_t error = (uint32_t)(delta < 0 ? -delta : delta);
+                maxError = error > maxError ? error : maxError;
+                sumError += error;
+                sumSquaredError += error * error;
+            }
+        }
+    }
+
+    double count = (numPixels > 0) ? (double)numPixels * 3 : 1.0;
+    double mse = sumSquaredError / count / (255.0 * 255.0);
+
+    diff->MaxError = maxError / 255.f;
+    diff->MeanError = (float)(sumError / count / 255.0);
+    diff->Psnr = (mse > 0.0) ? (float)(10.0 * log10(1.0 / mse)) : INFINITY;
+    return true;
+}
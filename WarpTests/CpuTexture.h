@@ -0,0 +1,105 @@
+//==============================================================================
+// CPU-side textures and samplers. These mirror the subset of D3D11 texture
+// and sampler behavior the warp shaders rely on, so the same shaders can be
+// executed on the CPU (see Dxbc.h and CpuRender.h).
+//==============================================================================
+#pragma once
+
+#include "Simd.h"
+#include <stdint.h>
+
+enum class CpuFormat
+{
+    R8G8B8A8Unorm,
+    R16Unorm,
+    R32Float,
+    R32G32Float,
+    R32G32B32A32Float,
+
+    // 4x4 texel blocks, decoded a texel at a time as they're read (see
+    // BlockCompress.h). RowPitch is the bytes from one row of blocks to the
+    // next, and they can't be cleared or stored to.
+    BC1Unorm,
+    BC3Unorm,
+    BC7Unorm,
+};
+
+enum class CpuFilter
+{
+    Point,
+    Linear,
+};
+
+enum class CpuAddressMode
+{
+    Border,
+    Clamp,
+    Wrap,
+};
+
+struct CpuTexture
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t RowPitch;
+    CpuFormat Format;
+    uint8_t* Data;
+};
+
+struct CpuSampler
+{
+    CpuFilter Filter;
+    CpuAddressMode Address;
+    float BorderColor[4];
+};
+
+bool CpuTextureCreate(uint32_t width, uint32_t height, CpuFormat format, CpuTexture* texture);
+void CpuTextureDestroy(CpuTexture* texture);
+void CpuTextureClear(CpuTexture* texture, const float value[4]);
+
+uint32_t CpuFormatBytesPerTexel(CpuFormat format);
+
+// Texels along each side of a block, 1 for the formats that aren't block
+// compressed, whose blocks are single texels
+uint32_t CpuFormatBlockSize(CpuFormat format);
+uint32_t CpuFormatBytesPerBlock(CpuFormat format);
+bool CpuFormatIsBlockCompressed(CpuFormat format);
+
+// Bytes of a 'width' x 'height' image with rows packed tight, as D3D11 and DDS
+// files lay it out
+uint64_t CpuFormatImageBytes(CpuFormat format, uint32_t width, uint32_t height);
+
+const char* CpuFormatName(CpuFormat format);
+
+// Reads SimdWidth texels at integer coordinates. Out of range texels read as 0
+// like D3D11 out-of-bounds Load.
+void CpuTextureLoad(const CpuTexture& texture, SimdInt x, SimdInt y, SimdFloat out[4]);
+
+// Filtered sample at normalized coordinates
+void CpuTextureSample(const CpuTexture& texture, const CpuSampler& sampler, SimdFloat u, SimdFloat v, SimdFloat out[4]);
+
+// Filtered sample from a mip chain at a level of detail, like SampleLevel.
+// Linear blends the two nearest levels, and Point takes the nearest one.
+void CpuTextureSampleLevel(const CpuTexture* levels, uint32_t numLevels, const CpuSampler& sampler, SimdFloat u, SimdFloat v,
+    SimdFloat lod, SimdFloat out[4]);
+
+// Writes the first 'count' lanes starting at (x, y) along a row
+void CpuTextureStoreRow(CpuTexture* texture, uint32_t x, uint32_t y, uint32_t count, SimdFloat mask, const SimdFloat value[4]);
+
+// Color difference over the RGB channels of two R8G8B8A8Unorm textures of the
+// same size, in normalized units
+struct CpuTextureDiff
+{
+    float MaxError;
+    float MeanError;
+    float Psnr;         // dB, infinite for identical textures
+};
+
+bool CpuTextureCompare(const CpuTexture& a, const CpuTexture& b, CpuTextureDiff* diff);
+
+// Whether a masked comparison covers pixel (x, y)
+typedef bool (*CpuTextureMask)(const void* context, uint32_t x, uint32_t y);
+
+// Like CpuTextureCompare, over the pixels 'mask' covers only
+bool CpuTextureCompareMasked(const CpuTexture& a, const CpuTexture& b, CpuTextureMask mask, const void* context,
+    CpuTextureDiff* diff);
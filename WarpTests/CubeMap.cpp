@@ -0,0 +1,442 @@
+//==============================================================================
+#include "CubeMap.h"
+#include "Parallel.h"
+#include "TextureFile.h"
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Per face: the axis it faces, then the directions its texel x and y run in,
+// so a point (s, t) on it in [-1, 1] lies along Major + s * U + t * V
+static const float FaceAxes[CubeMapNumFaces][3][3] = {
+    { { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+    { { -1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+    { { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+    { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+    { { 0, 0, 1 }, { 1, 0, 0 }, { 0, -1, 0 } },
+    { { 0, 0, -1 }, { -1, 0, 0 }, { 0, -1, 0 } },
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+
+// The face each lane's direction points at, by its largest component, with
+// ties going to x then y as D3D11 breaks them
+struct FaceSelect
+{
+    SimdFloat XMajor;
+    SimdFloat YMajor;
+    SimdFloat Negative;
+};
+
+static inline FaceSelect SelectFace(const SimdFloat d[3])
+{
+    SimdFloat ax = SimdAbs(d[0]);
+    SimdFloat ay = SimdAbs(d[1]);
+    SimdFloat az = SimdAbs(d[2]);
+    FaceSelect select;
+    select.XMajor = SimdAnd(SimdCmpGe(ax, ay), SimdCmpGe(ax, az));
+    select.YMajor = SimdAndNot(select.XMajor, SimdCmpGe(ay, az));
+    SimdFloat major = SimdSelect(select.XMajor, d[0], SimdSelect(select.YMajor, d[1], d[2]));
+    select.Negative = SimdCmpLt(major, SimdZero());
+    return select;
+}
+
+static inline SimdInt FaceIndex(const FaceSelect& select)
+{
+    SimdFloat axis = SimdSelect(select.XMajor, SimdZero(), SimdSelect(select.YMajor, SimdSet(2.f), SimdSet(4.f)));
+    return SimdFtoi(SimdAdd(axis, SimdAnd(select.Negative, SimdSet(1.f))));
+}
+
+// Position of 'd' on the plane of the selected face, (s, t) in [-1, 1] on the
+// face itself. Also used for neighboring pixels' directions, which can land
+// just off the face.
+static inline void FaceCoords(const SimdFloat d[3], const FaceSelect& select, SimdFloat* s, SimdFloat* t)
+{
+    SimdFloat major = SimdSelect(select.XMajor, d[0], SimdSelect(select.YMajor, d[1], d[2]));
+    SimdFloat sc = SimdSelect(select.XMajor, SimdSelect(select.Negative, d[2], SimdNeg(d[2])),
+        SimdSelect(select.YMajor, d[0], SimdSelect(select.Negative, SimdNeg(d[0]), d[0])));
+    SimdFloat tc = SimdSelect(select.YMajor, SimdSelect(select.Negative, SimdNeg(d[2]), d[2]), SimdNeg(d[1]));
+    SimdFloat inv = SimdDiv(SimdSet(1.f), SimdMax(SimdAbs(major), SimdSet(1e-20f)));
+    *s = SimdMul(sc, inv);
+    *t = SimdMul(tc, inv);
+}
+
+// Moves a texel hanging off 'face' onto the face it lies on
+static void CrossEdge(int32_t size, int32_t* face, int32_t* x, int32_t* y)
+{
+    const float (&axes)[3][3] = FaceAxes[*face];
+    float s = (*x + 0.5f) / size * 2.f - 1.f;
+    float t = (*y + 0.5f) / size * 2.f - 1.f;
+    float d[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        d[i] = axes[0][i] + s * axes[1][i] + t * axes[2][i];
+    }
+
+    float ax = fabsf(d[0]);
+    float ay = fabsf(d[1]);
+    float az = fabsf(d[2]);
+    uint32_t axis = (ax >= ay && ax >= az) ? 0 : (ay >= az ? 1 : 2);
+    *face = (int32_t)(axis * 2 + (d[axis] < 0.f ? 1 : 0));
+
+    const float (&target)[3][3] = FaceAxes[*face];
+    float major = d[0] * target[0][0] + d[1] * target[0][1] + d[2] * target[0][2];
+    float u = (d[0] * target[1][0] + d[1] * target[1][1] + d[2] * target[1][2]) / major;
+    float v = (d[0] * target[2][0] + d[1] * target[2][1] + d[2] * target[2][2]) / major;
+    *x = std::min(std::max((int32_t)floorf((u * 0.5f + 0.5f) * size), 0), size - 1);
+    *y = std::min(std::max((int32_t)floorf((v * 0.5f + 0.5f) * size), 0), size - 1);
+}
+
+// Row in the stacked level of texel (x, y) on 'face', which may lie past the
+// face's edges
+static inline void ResolveTexel(SimdInt face, int32_t size, SimdInt* x, SimdInt* y)
+{
+    SimdInt last = SimdIntSet(size - 1);
+    SimdInt zero = SimdIntSet(0);
+    SimdFloat outside = SimdOr(
+        SimdOr(SimdAsFloat(SimdIntCmpLt(*x, zero)), SimdAsFloat(SimdIntCmpLt(last, *x))),
+        SimdOr(SimdAsFloat(SimdIntCmpLt(*y, zero)), SimdAsFloat(SimdIntCmpLt(last, *y))));
+    uint32_t crossing = SimdMoveMask(outside);
+    if (crossing != 0)
+    {
+        alignas(32) int32_t vx[SimdWidth], vy[SimdWidth], vface[SimdWidth];
+        SimdIntStore(vx, *x);
+        SimdIntStore(vy, *y);
+        SimdIntStore(vface, face);
+        for (uint32_t i = 0; i < SimdWidth; ++i)
+        {
+            if (crossing & (1u << i))
+            {
+                CrossEdge(size, &vface[i], &vx[i], &vy[i]);
+            }
+        }
+        *x = SimdIntLoad(vx);
+        *y = SimdIntLoad(vy);
+        face = SimdIntLoad(vface);
+    }
+    *y = SimdIntAdd(*y, SimdIntMul(face, SimdIntSet(size)));
+}
+
+// CpuTextureLoad, with the texel reads inlined for 8 bit RGBA, which is most
+// of the cost of a sample. Unlike CpuTextureLoad every texel must be in range.
+static inline void LoadTexels(const CpuTexture& texture, SimdInt x, SimdInt y, SimdFloat out[4])
+{
+    if (texture.Format != CpuFormat::R8G8B8A8Unorm)
+    {
+        CpuTextureLoad(texture, x, y, out);
+        return;
+    }
+
+    alignas(32) int32_t vx[SimdWidth], vy[SimdWidth];
+    alignas(32) float texels[4][SimdWidth];
+    SimdIntStore(vx, x);
+    SimdIntStore(vy, y);
+    for (uint32_t i = 0; i < SimdWidth; ++i)
+    {
+        const uint8_t* texel = texture.Data + (size_t)vy[i] * texture.RowPitch + (size_t)vx[i] * 4;
+        for (int c = 0; c < 4; ++c)
+        {
+            texels[c][i] = texel[c];
+        }
+    }
+    SimdFloat scale = SimdSet(1.f / 255.f);
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdMul(SimdLoad(texels[c]), scale);
+    }
+}
+
+// Bilinear sample of one level, the same for every lane
+static void SampleLevel(const CpuCubeMap& cube, uint32_t level, SimdInt face, SimdFloat u, SimdFloat v, SimdFloat out[4])
+{
+    const CpuTexture& texture = cube.Levels[level];
+    int32_t size = (int32_t)texture.Width;
+    SimdFloat x = SimdSub(SimdMul(u, SimdSet((float)size)), SimdSet(0.5f));
+    SimdFloat y = SimdSub(SimdMul(v, SimdSet((float)size)), SimdSet(0.5f));
+    SimdFloat x0 = SimdFloor(x);
+    SimdFloat y0 = SimdFloor(y);
+    SimdFloat fx = SimdSub(x, x0);
+    SimdFloat fy = SimdSub(y, y0);
+
+    SimdInt ix = SimdFtoi(x0);
+    SimdInt iy = SimdFtoi(y0);
+    SimdInt one = SimdIntSet(1);
+    SimdInt xs[4] = { ix, SimdIntAdd(ix, one), ix, SimdIntAdd(ix, one) };
+    SimdInt ys[4] = { iy, iy, SimdIntAdd(iy, one), SimdIntAdd(iy, one) };
+    SimdFloat texel[4][4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        ResolveTexel(face, size, &xs[i], &ys[i]);
+        LoadTexels(texture, xs[i], ys[i], texel[i]);
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdLerp(SimdLerp(texel[0][c], texel[1][c], fx), SimdLerp(texel[2][c], texel[3][c], fx), fy);
+    }
+}
+
+// Bilinear samples at a level per lane, one pass per distinct level
+static void SampleLevels(const CpuCubeMap& cube, SimdFloat level, SimdInt face, SimdFloat u, SimdFloat v, SimdFloat out[4])
+{
+    alignas(32) float levels[SimdWidth];
+    SimdStore(levels, level);
+    uint32_t pending = (1u << SimdWidth) - 1;
+    uint32_t lane = 0;
+    while (pending != 0)
+    {
+        while (!(pending & (1u << lane)))
+        {
+            ++lane;
+        }
+        SimdFloat mask = SimdCmpEq(level, SimdSet(levels[lane]));
+        SimdFloat texel[4];
+        SampleLevel(cube, (uint32_t)levels[lane], face, u, v, texel);
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c] = SimdSelect(mask, texel[c], out[c]);
+        }
+        pending &= ~SimdMoveMask(mask);
+    }
+}
+
+static void SampleFace(const CpuCubeMap& cube, SimdInt face, SimdFloat s, SimdFloat t, SimdFloat lod, SimdFloat out[4])
+{
+    SimdFloat half = SimdSet(0.5f);
+    SimdFloat u = SimdMad(s, half, half);
+    SimdFloat v = SimdMad(t, half, half);
+    SimdFloat lastLevel = SimdSet((float)(cube.NumLevels - 1));
+    lod = SimdMin(SimdMax(lod, SimdZero()), lastLevel);
+    SimdFloat level = SimdFloor(lod);
+    SimdFloat blend = SimdSub(lod, level);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdZero();
+    }
+    SampleLevels(cube, level, face, u, v, out);
+    if (SimdMoveMask(SimdCmpLt(SimdZero(), blend)) != 0)
+    {
+        SimdFloat next[4] = { SimdZero(), SimdZero(), SimdZero(), SimdZero() };
+        SampleLevels(cube, SimdMin(SimdAdd(level, SimdSet(1.f)), lastLevel), face, u, v, next);
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c] = SimdLerp(out[c], next[c], blend);
+        }
+    }
+}
+
+// World direction through NDC (x, y), from the near plane to the far plane
+static inline void NdcDirection(const float m[16], SimdFloat x, SimdFloat y, SimdFloat direction[3])
+{
+    SimdFloat nearPoint[4];
+    SimdFloat farPoint[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        nearPoint[i] = SimdMad(x, SimdSet(m[0 * 4 + i]), SimdMad(y, SimdSet(m[1 * 4 + i]), SimdSet(m[3 * 4 + i])));
+        farPoint[i] = SimdAdd(nearPoint[i], SimdSet(m[2 * 4 + i]));
+    }
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        direction[i] = SimdSub(SimdDiv(farPoint[i], farPoint[3]), SimdDiv(nearPoint[i], nearPoint[3]));
+    }
+}
+
+//==============================================================================
+bool CpuCubeMapCreate(uint32_t size, uint32_t numLevels, CpuFormat format, CpuCubeMap* cube)
+{
+    *cube = CpuCubeMap{};
+    if (CpuFormatIsBlockCompressed(format) || size == 0 || numLevels == 0 || numLevels > MipLevelCount(size, size))
+    {
+        assert(false);
+        return false;
+    }
+
+    cube->Size = size;
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        uint32_t levelSize = MipLevelSize(size, level);
+        if (!CpuTextureCreate(levelSize, levelSize * CubeMapNumFaces, format, &cube->Levels[level]))
+        {
+            assert(false);
+            CpuCubeMapDestroy(cube);
+            return false;
+        }
+        cube->NumLevels = level + 1;
+    }
+    return true;
+}
+
+//==============================================================================
+void CpuCubeMapDestroy(CpuCubeMap* cube)
+{
+    for (uint32_t level = 0; level < cube->NumLevels; ++level)
+    {
+        CpuTextureDestroy(&cube->Levels[level]);
+    }
+    cube->NumLevels = 0;
+}
+
+//==============================================================================
+bool CpuCubeMapLoad(const char* filename, CpuCubeMap* cube)
+{
+    TextureFile file;
+    if (!TextureFileOpen(filename, &file))
+    {
+        return false;
+    }
+    const TextureFileHeader& header = *file.Header;
+    if (header.ArraySize != CubeMapNumFaces || header.Width != header.Height || CpuFormatIsBlockCompressed(file.Format) ||
+        !CpuCubeMapCreate(header.Width, header.NumLevels, file.Format, cube))
+    {
+        TextureFileClose(&file);
+        return false;
+    }
+
+    for (uint32_t face = 0; face < CubeMapNumFaces; ++face)
+    {
+        for (uint32_t level = 0; level < header.NumLevels; ++level)
+        {
+            CpuTexture source;
+            CpuTexture target;
+            TextureFileGetLevel(file, face, level, &source);
+            CpuCubeMapGetFace(*cube, face, level, &target);
+            size_t rowBytes = (size_t)target.Width * CpuFormatBytesPerTexel(file.Format);
+            for (uint32_t y = 0; y < target.Height; ++y)
+            {
+                memcpy(target.Data + (size_t)y * target.RowPitch, source.Data + (size_t)y * source.RowPitch, rowBytes);
+            }
+        }
+    }
+    TextureFileClose(&file);
+    return true;
+}
+
+//==============================================================================
+void CpuCubeMapGetFace(const CpuCubeMap& cube, uint32_t face, uint32_t level, CpuTexture* texture)
+{
+    const CpuTexture& stacked = cube.Levels[level];
+    *texture = stacked;
+    texture->Height = stacked.Width;
+    texture->Data = stacked.Data + (size_t)face * stacked.Width * stacked.RowPitch;
+}
+
+//==============================================================================
+void CpuCubeMapFaceDirection(uint32_t face, float s, float t, float direction[3])
+{
+    assert(face < CubeMapNumFaces);
+    const float (&axes)[3][3] = FaceAxes[face];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        direction[i] = axes[0][i] + s * axes[1][i] + t * axes[2][i];
+    }
+}
+
+//==============================================================================
+bool CpuCubeMapGenerateMips(MipFilter filter, CpuCubeMap* cube)
+{
+    for (uint32_t face = 0; face < CubeMapNumFaces; ++face)
+    {
+        CpuTexture levels[MipMaxLevels];
+        for (uint32_t level = 0; level < cube->NumLevels; ++level)
+        {
+            CpuCubeMapGetFace(*cube, face, level, &levels[level]);
+        }
+        if (!MipChainGenerate(filter, levels, cube->NumLevels))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+void CpuCubeMapSample(const CpuCubeMap& cube, const SimdFloat direction[3], SimdFloat lod, SimdFloat out[4])
+{
+    FaceSelect select = SelectFace(direction);
+    SimdFloat s, t;
+    FaceCoords(direction, select, &s, &t);
+    SampleFace(cube, FaceIndex(select), s, t, lod, out);
+}
+
+//==============================================================================
+void CpuCubeMapSampleGrad(const CpuCubeMap& cube, const SimdFloat direction[3], const SimdFloat right[3],
+    const SimdFloat down[3], SimdFloat out[4])
+{
+    // Neighbors measured on this pixel's face, so the footprint doesn't jump
+    // at the edges, in texels per unit of face position
+    FaceSelect select = SelectFace(direction);
+    SimdFloat s, t, sRight, tRight, sDown, tDown;
+    FaceCoords(direction, select, &s, &t);
+    FaceCoords(right, select, &sRight, &tRight);
+    FaceCoords(down, select, &sDown, &tDown);
+    SimdFloat dsx = SimdSub(sRight, s);
+    SimdFloat dtx = SimdSub(tRight, t);
+    SimdFloat dsy = SimdSub(sDown, s);
+    SimdFloat dty = SimdSub(tDown, t);
+    SimdFloat footprint = SimdMul(SimdSet(0.5f * cube.Size), SimdSqrt(SimdMax(SimdMad(dsx, dsx, SimdMul(dtx, dtx)),
+        SimdMad(dsy, dsy, SimdMul(dty, dty)))));
+    SimdFloat lod = SimdPerLane(SimdMax(footprint, SimdSet(1.f)), [](float f) { return log2f(f); });
+    SampleFace(cube, FaceIndex(select), s, t, lod, out);
+}
+
+//==============================================================================
+void CpuCubeMapDrawBackground(const CpuCubeMap& cube, const float invViewProj[16], const CpuViewport& viewport,
+    CpuTexture* target)
+{
+    float left = viewport.TopLeftX;
+    float top = viewport.TopLeftY;
+    float width = (viewport.Width > 0.f) ? viewport.Width : (float)target->Width;
+    float height = (viewport.Width > 0.f) ? viewport.Height : (float)target->Height;
+    uint32_t beginX = (uint32_t)left;
+    uint32_t beginY = (uint32_t)top;
+    uint32_t endX = std::min((uint32_t)(left + width), target->Width);
+    uint32_t endY = std::min((uint32_t)(top + height), target->Height);
+    if (endX <= beginX || endY <= beginY)
+    {
+        return;
+    }
+
+    float pixelX = 2.f / width;
+    float pixelY = 2.f / height;
+
+    ParallelFor(endY - beginY, 8, [&](uint32_t begin, uint32_t end)
+    {
+        SimdFloat lanes = SimdLaneIndex();
+        for (uint32_t row = begin; row < end; ++row)
+        {
+            uint32_t py = beginY + row;
+            SimdFloat y = SimdSet(1.f - (py + 0.5f - top) * pixelY);
+            SimdFloat yDown = SimdSub(y, SimdSet(pixelY));
+            for (uint32_t px = beginX; px < endX; px += SimdWidth)
+            {
+                SimdFloat x = SimdSub(SimdMul(SimdAdd(lanes, SimdSet(px + 0.5f - left)), SimdSet(pixelX)), SimdSet(1.f));
+                SimdFloat direction[3], right[3], down[3];
+                NdcDirection(invViewProj, x, y, direction);
+                NdcDirection(invViewProj, SimdAdd(x, SimdSet(pixelX)), y, right);
+                NdcDirection(invViewProj, x, yDown, down);
+                SimdFloat background[4];
+                CpuCubeMapSampleGrad(cube, direction, right, down, background);
+
+                // Premultiplied over: the target's own color, then the
+                // background through what's left
+                uint32_t count = std::min(SimdWidth, endX - px);
+                SimdFloat color[4];
+                SimdInt tx = SimdIntMin(SimdIntAdd(SimdFtoi(lanes), SimdIntSet((int32_t)px)), SimdIntSet((int32_t)endX - 1));
+                LoadTexels(*target, tx, SimdIntSet((int32_t)py), color);
+                SimdFloat uncovered = SimdSub(SimdSet(1.f), color[3]);
+                for (int c = 0; c < 4; ++c)
+                {
+                    color[c] = SimdMad(background[c], uncovered, color[c]);
+                }
+                CpuTextureStoreRow(target, px, py, count, SimdTrue(), color);
+            }
+        }
+    });
+}
@@ -0,0 +1,74 @@
+//==============================================================================
+// Cube maps for the CPU path: an environment at infinity that the display
+// draws beneath the warped app frame, looked up by direction alone.
+//
+// Each level stacks its six faces top to bottom in one CpuTexture, in D3D11
+// face order (+x, -x, +y, -y, +z, -z) and orientation, so a lane's face is a
+// row offset, one gather serves every face, and the levels can go straight to
+// a D3D11 TextureCube.
+//
+// Filtering is seamless like D3D11's: bilinear texels past a face's edge come
+// from the neighboring face, found by turning their position on the face's
+// plane back into a direction. At a corner that direction picks one of the
+// three faces meeting there.
+//==============================================================================
+#pragma once
+
+#include "CpuRender.h"
+#include "CpuTexture.h"
+#include "MipChain.h"
+#include <stdint.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t CubeMapNumFaces = 6;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct CpuCubeMap
+{
+    uint32_t Size;          // Texels along a face's side at level 0
+    uint32_t NumLevels;
+    CpuTexture Levels[MipMaxLevels];    // One face wide, six faces high
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Uncompressed formats only, as faces stack a texel row at a time
+bool CpuCubeMapCreate(uint32_t size, uint32_t numLevels, CpuFormat format, CpuCubeMap* cube);
+void CpuCubeMapDestroy(CpuCubeMap* cube);
+
+// Reads a TextureFile of six square slices in face order, with their mips
+bool CpuCubeMapLoad(const char* filename, CpuCubeMap* cube);
+
+// 'texture' points into the cube's level
+void CpuCubeMapGetFace(const CpuCubeMap& cube, uint32_t face, uint32_t level, CpuTexture* texture);
+
+// Unnormalized direction through (s, t) in [-1, 1] on 'face', with s along its
+// texel x and t along its texel y, for filling faces
+void CpuCubeMapFaceDirection(uint32_t face, float s, float t, float direction[3]);
+
+// Fills levels 1 up from level 0 one face at a time, so like MipChainGenerate
+// it needs R8G8B8A8Unorm. Each face filters on its own, so the coarsest levels
+// show the face edges a little.
+bool CpuCubeMapGenerateMips(MipFilter filter, CpuCubeMap* cube);
+
+// Trilinear sample in 'direction', which needn't be normalized, at a level
+// of detail in level 0 texels
+void CpuCubeMapSample(const CpuCubeMap& cube, const SimdFloat direction[3], SimdFloat lod, SimdFloat out[4]);
+
+// CpuCubeMapSample at the level of detail of a pixel footprint, whose
+// neighbors to the right and below look in 'right' and 'down'
+void CpuCubeMapSampleGrad(const CpuCubeMap& cube, const SimdFloat direction[3], const SimdFloat right[3],
+    const SimdFloat down[3], SimdFloat out[4]);
+
+// Draws the cube beneath the R8G8B8A8Unorm 'target' within 'viewport', as
+// premultiplied alpha over it: what the target covers shows in proportion to
+// its alpha. 'invViewProj' takes NDC to world, and only its rotation matters.
+// The level of detail comes from each pixel's footprint on the cube.
+void CpuCubeMapDrawBackground(const CpuCubeMap& cube, const float invViewProj[16], const CpuViewport& viewport,
+    CpuTexture* target);
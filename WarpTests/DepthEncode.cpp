@@ -0,0 +1,105 @@
+//==============================================================================
+#include "DepthEncode.h"
+#include "Parallel.h"
+#include <assert.h>
+#include <math.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Rows per ParallelFor chunk
+static const uint32_t RowGrain = 16;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline float Saturate(float value)
+{
+    return value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+}
+
+//==============================================================================
+void DepthEncodeGetConstants(const DepthEncodeDesc& desc, DepthEncodeConstants* constants)
+{
+    assert(desc.Near > 0.f && desc.Far > desc.Near);
+
+    // As XMMatrixPerspectiveFovLH, with the planes swapped for reversed-Z
+    float n = desc.ReversedZ ? desc.Far : desc.Near;
+    float f = desc.ReversedZ ? desc.Near : desc.Far;
+    constants->ClipScale = f / (f - n);
+    constants->ClipOffset = -n * f / (f - n);
+
+    // Near maps to 0 and far to 1
+    if (desc.Encoding == DepthEncoding::Log)
+    {
+        constants->EncodeScale = 1.f / log2f(desc.Far / desc.Near);
+        constants->EncodeOffset = -log2f(desc.Near) * constants->EncodeScale;
+    }
+    else
+    {
+        constants->EncodeScale = 1.f / (desc.Far - desc.Near);
+        constants->EncodeOffset = -desc.Near * constants->EncodeScale;
+    }
+}
+
+//==============================================================================
+void DepthEncodeBuild(const CpuTexture& depth, const DepthEncodeDesc& desc, CpuTexture* encoded)
+{
+    assert(depth.Format == CpuFormat::R32Float && encoded->Format == CpuFormat::R16Unorm);
+    assert(depth.Width == encoded->Width && depth.Height == encoded->Height);
+
+    DepthEncodeConstants constants;
+    DepthEncodeGetConstants(desc, &constants);
+    bool log = desc.Encoding == DepthEncoding::Log;
+
+    ParallelFor(depth.Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            const float* source = (const float*)(depth.Data + (size_t)y * depth.RowPitch);
+            uint16_t* target = (uint16_t*)(encoded->Data + (size_t)y * encoded->RowPitch);
+            for (uint32_t x = 0; x < depth.Width; ++x)
+            {
+                // Depth at the clip scale is infinitely far, and saturates
+                float stored = source[x] - constants.ClipScale;
+                float view = (stored != 0.f) ? constants.ClipOffset / stored : desc.Far;
+                view = (view > 0.f) ? view : desc.Far;
+                float value = (log ? log2f(view) : view) * constants.EncodeScale + constants.EncodeOffset;
+                target[x] = (uint16_t)(Saturate(value) * 65535.f + 0.5f);
+            }
+        }
+    });
+}
+
+//==============================================================================
+float DepthEncodeStep(const DepthEncodeDesc& desc, float viewDepth)
+{
+    DepthEncodeConstants constants;
+    DepthEncodeGetConstants(desc, &constants);
+    bool log = desc.Encoding == DepthEncoding::Log;
+
+    float code = floorf(((log ? log2f(viewDepth) : viewDepth) * constants.EncodeScale + constants.EncodeOffset) * 65535.f);
+    float values[2];
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        float value = ((code + i) / 65535.f - constants.EncodeOffset) / constants.EncodeScale;
+        values[i] = log ? exp2f(value) : value;
+    }
+    return values[1] - values[0];
+}
+
+//==============================================================================
+const char* DepthEncodingName(DepthEncoding encoding)
+{
+    switch (encoding)
+    {
+    case DepthEncoding::Linear:
+        return "Linear";
+    case DepthEncoding::Log:
+        return "Log";
+    default:
+        assert(false);
+        return "";
+    }
+}
@@ -0,0 +1,62 @@
+//==============================================================================
+// Compact depth for the positional warp. Post-projection depth crowds almost
+// all of the scene next to 1 (or 0 with reversed-Z), so it needs 24 or 32 bits
+// to stay usable. Encoding view depth instead, linearly or by its log, spreads
+// the 16 bits of an R16Unorm texel over the whole range: half the bytes of
+// float depth to read in the warp, or to ship to another process.
+//
+// Linear keeps a constant absolute error, which suits scenes of bounded
+// depth. Log keeps a constant relative error, which tracks the parallax error
+// of a reprojection at every distance.
+//
+// The warp decodes back to view depth and builds the clip position from it
+// directly (see ENCODED_DEPTH in WarpVS.hlsli). DepthEncodeCS.hlsl encodes on
+// the GPU with the same constants.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class DepthEncoding
+{
+    Linear,
+    Log,
+    Count
+};
+
+struct DepthEncodeDesc
+{
+    float Near;
+    float Far;
+    bool ReversedZ;
+    DepthEncoding Encoding;
+};
+
+// Laid out for the shaders: post-projection depth is ClipScale + ClipOffset /
+// view depth, and the encoding is (Log ? log2(view depth) : view depth) *
+// EncodeScale + EncodeOffset
+struct DepthEncodeConstants
+{
+    float ClipScale;
+    float ClipOffset;
+    float EncodeScale;
+    float EncodeOffset;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+void DepthEncodeGetConstants(const DepthEncodeDesc& desc, DepthEncodeConstants* constants);
+
+// Encodes R32Float post-projection 'depth' into R16Unorm 'encoded' of the same
+// size
+void DepthEncodeBuild(const CpuTexture& depth, const DepthEncodeDesc& desc, CpuTexture* encoded);
+
+// View depth between the 16 bit codes either side of 'viewDepth'
+float DepthEncodeStep(const DepthEncodeDesc& desc, float viewDepth);
+
+const char* DepthEncodingName(DepthEncoding encoding);
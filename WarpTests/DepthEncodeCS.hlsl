@@ -0,0 +1,27 @@
+// Encodes post-projection depth as linear or log view depth in 16 bits for the
+// positional warp (see DepthEncode.h). One thread per texel.
+Texture2D<float> SourceDepth;
+RWTexture2D<unorm float> EncodedDepth;
+
+cbuffer Constants
+{
+    uint2 DepthSize;
+    uint Encoding;      // DepthEncoding: 0 linear, 1 log
+    float Far;
+    float4 Params;      // DepthEncodeConstants
+};
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (any(id.xy >= DepthSize))
+    {
+        return;
+    }
+
+    // Depth at the clip scale is infinitely far, and saturates
+    float stored = SourceDepth.Load(int3(id.xy, 0)) - Params.x;
+    float view = (stored != 0) ? Params.y / stored : Far;
+    view = (view > 0) ? view : Far;
+    EncodedDepth[id.xy] = saturate((Encoding ? log2(view) : view) * Params.z + Params.w);
+}
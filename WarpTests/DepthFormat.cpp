@@ -0,0 +1,245 @@
+//==============================================================================
+#include "DepthFormat.h"
+#include "Parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Rows per ParallelFor chunk
+static const uint32_t RowGrain = 16;
+
+// Sample points per DepthPrecisionMeasure
+static const uint32_t PrecisionSamples = 4096;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline float* Row(CpuTexture* texture, uint32_t y)
+{
+    return (float*)(texture->Data + (size_t)y * texture->RowPitch);
+}
+
+static inline uint32_t UnormMax(DepthFormat format)
+{
+    return (format == DepthFormat::D16) ? 0xFFFFu : 0xFFFFFFu;
+}
+
+// Float to unorm conversion rounds to nearest, as D3D11 does
+static inline float Quantize(DepthFormat format, float depth)
+{
+    if (format == DepthFormat::D32Float)
+    {
+        return depth;
+    }
+
+    double scale = UnormMax(format);
+    double clamped = depth < 0.f ? 0.0 : (depth > 1.f ? 1.0 : (double)depth);
+    return (float)(floor(clamped * scale + 0.5) / scale);
+}
+
+// Row vector convention, 'a' applied first
+static void MatrixMultiply(const double a[16], const double b[16], double out[16])
+{
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            out[i * 4 + j] = a[i * 4 + 0] * b[0 * 4 + j] + a[i * 4 + 1] * b[1 * 4 + j] +
+                a[i * 4 + 2] * b[2 * 4 + j] + a[i * 4 + 3] * b[3 * 4 + j];
+        }
+    }
+}
+
+// Deterministic, so reports compare between runs
+static inline float NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) * (1.f / 16777216.f);
+}
+
+//==============================================================================
+const char* DepthFormatName(DepthFormat format)
+{
+    switch (format)
+    {
+    case DepthFormat::D16:
+        return "D16";
+    case DepthFormat::D24:
+        return "D24";
+    case DepthFormat::D32Float:
+        return "D32F";
+    default:
+        assert(false);
+        return "";
+    }
+}
+
+//==============================================================================
+uint32_t DepthFormatBytesPerTexel(DepthFormat format)
+{
+    return (format == DepthFormat::D16) ? 2 : 4;
+}
+
+//==============================================================================
+void DepthFormatQuantize(DepthFormat format, CpuTexture* depth)
+{
+    assert(depth->Format == CpuFormat::R32Float);
+
+    if (format == DepthFormat::D32Float)
+    {
+        return;
+    }
+
+    ParallelFor(depth->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            float* row = Row(depth, y);
+            for (uint32_t x = 0; x < depth->Width; ++x)
+            {
+                row[x] = Quantize(format, row[x]);
+            }
+        }
+    });
+}
+
+//==============================================================================
+void DepthFormatDecode(DepthFormat format, const uint8_t* data, uint32_t rowPitch, CpuTexture* depth)
+{
+    assert(depth->Format == CpuFormat::R32Float);
+
+    ParallelFor(depth->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            const uint8_t* source = data + (size_t)y * rowPitch;
+            float* row = Row(depth, y);
+            switch (format)
+            {
+            case DepthFormat::D16:
+                for (uint32_t x = 0; x < depth->Width; ++x)
+                {
+                    uint16_t value;
+                    memcpy(&value, source + x * 2, sizeof(value));
+                    row[x] = value * (1.f / 0xFFFF);
+                }
+                break;
+            case DepthFormat::D24:
+                for (uint32_t x = 0; x < depth->Width; ++x)
+                {
+                    uint32_t value;
+                    memcpy(&value, source + x * 4, sizeof(value));
+                    row[x] = (float)((value & 0xFFFFFFu) / (double)0xFFFFFF);
+                }
+                break;
+            default:
+                memcpy(row, source, depth->Width * sizeof(float));
+                break;
+            }
+        }
+    });
+}
+
+//==============================================================================
+void DepthPrecisionMeasure(const DepthPrecisionDesc& desc, DepthFormat format, float minDistance, float maxDistance,
+    DepthPrecision* precision)
+{
+    assert(minDistance > 0.f && maxDistance > minDistance);
+
+    // Left handed perspective as XMMatrixPerspectiveFovLH builds it, with the
+    // planes swapped for reversed-Z: clip z = z * a + b, clip w = z
+    double n = desc.ReversedZ ? desc.Far : desc.Near;
+    double f = desc.ReversedZ ? desc.Near : desc.Far;
+    double ys = 1.0 / tan(desc.FovY * 0.5);
+    double xs = ys * desc.Height / desc.Width;
+    double a = f / (f - n);
+    double b = -n * a;
+
+    double proj[16] = {
+        xs, 0, 0, 0,
+        0, ys, 0, 0,
+        0, 0, a, 1,
+        0, 0, b, 0,
+    };
+    double invProj[16] = {
+        1 / xs, 0, 0, 0,
+        0, 1 / ys, 0, 0,
+        0, 0, 0, 1 / b,
+        0, 0, 1, -a / b,
+    };
+    double targetView[16] = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        -desc.HeadOffset, 0, 0, 1,
+    };
+
+    // The warp matrix goes to the shaders as floats, as does the projection
+    double moved[16];
+    double warp[16];
+    MatrixMultiply(invProj, targetView, moved);
+    MatrixMultiply(moved, proj, warp);
+    float m[16];
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        m[i] = (float)warp[i];
+    }
+    float xsf = (float)xs;
+    float ysf = (float)ys;
+    float af = (float)a;
+    float bf = (float)b;
+
+    double logRange = log((double)maxDistance / minDistance);
+    double errorSum = 0;
+    *precision = DepthPrecision();
+
+    uint32_t random = 1;
+    for (uint32_t i = 0; i < PrecisionSamples; ++i)
+    {
+        // Log uniform in distance, uniform over most of the screen
+        double z = minDistance * exp(logRange * NextRandom(&random));
+        double ndcX = NextRandom(&random) * 1.8 - 0.9;
+        double ndcY = NextRandom(&random) * 1.8 - 0.9;
+        double x = ndcX * z / xs;
+        double y = ndcY * z / ys;
+
+        // Rasterized depth, then as stored
+        float zf = (float)z;
+        float depth = Quantize(format, (zf * af + bf) / zf);
+
+        // Back out the view distance it stands for
+        double stored = (double)depth - a;
+        double distance = (stored != 0) ? b / stored : desc.Far;
+        float depthError = (float)(fabs(distance - z) / z);
+
+        // Through the warp as the vertex shader does it
+        float source[4] = { (float)x * xsf / zf, (float)y * ysf / zf, depth, 1.f };
+        float clip[4];
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            clip[j] = source[0] * m[0 * 4 + j] + source[1] * m[1 * 4 + j] + source[2] * m[2 * 4 + j] + source[3] * m[3 * 4 + j];
+        }
+
+        double exactX = ((x - desc.HeadOffset) * xs / z + 1.0) * desc.Width * 0.5;
+        double exactY = (1.0 - y * ys / z) * desc.Height * 0.5;
+
+        // Behind the eye counts as off by the whole frame
+        double pixelError = desc.Width;
+        if (clip[3] > 0.f)
+        {
+            double warpedX = (clip[0] / clip[3] + 1.0) * desc.Width * 0.5;
+            double warpedY = (1.0 - clip[1] / clip[3]) * desc.Height * 0.5;
+            pixelError = sqrt((warpedX - exactX) * (warpedX - exactX) + (warpedY - exactY) * (warpedY - exactY));
+        }
+
+        errorSum += pixelError;
+        precision->MaxPixelError = (pixelError > precision->MaxPixelError) ? (float)pixelError : precision->MaxPixelError;
+        precision->MaxDepthError = (depthError > precision->MaxDepthError) ? depthError : precision->MaxDepthError;
+    }
+
+    precision->MeanPixelError = (float)(errorSum / PrecisionSamples);
+}
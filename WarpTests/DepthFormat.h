@@ -0,0 +1,67 @@
+//==============================================================================
+// App frame depth buffer formats, and the precision each leaves the positional
+// warp. Standard depth puts the near plane at 0 and the far plane at 1.
+// Reversed-Z swaps them, so float depth spends its exponent range on distant
+// surfaces instead of piling it up next to the near plane where the
+// perspective divide already keeps depth well apart.
+//
+// The CPU path always renders R32Float depth. DepthFormatQuantize rounds that
+// to what a format stores, so the warp reads the same values as on the GPU,
+// and DepthFormatDecode converts GPU readbacks of any format to R32Float.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class DepthFormat
+{
+    D16,        // 16 bit unorm
+    D24,        // 24 bit unorm, in the low bits of 32 with 8 bits of stencil
+    D32Float,
+    Count
+};
+
+struct DepthPrecisionDesc
+{
+    float Near;
+    float Far;
+    float FovY;             // Radians
+    uint32_t Width;         // Of the app frame, in pixels
+    uint32_t Height;
+    float HeadOffset;       // Sideways move of the warp's target view
+    bool ReversedZ;
+};
+
+// Error over samples spread across a range of view distances
+struct DepthPrecision
+{
+    float MaxDepthError;    // Relative to the view distance
+    float MeanPixelError;   // Reprojected position against the exact one
+    float MaxPixelError;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+const char* DepthFormatName(DepthFormat format);
+
+// Bytes each depth texel takes in memory
+uint32_t DepthFormatBytesPerTexel(DepthFormat format);
+
+// Rounds R32Float 'depth' in place to the values 'format' stores
+void DepthFormatQuantize(DepthFormat format, CpuTexture* depth);
+
+// Converts rows of 'format' texels, as mapped from a GPU readback, into
+// R32Float 'depth'
+void DepthFormatDecode(DepthFormat format, const uint8_t* data, uint32_t rowPitch, CpuTexture* depth);
+
+// Projects points at view distances [minDistance, maxDistance) with the
+// perspective 'desc' describes, stores their depth in 'format', and
+// reprojects them through the positional warp matrix in float, like the warp
+// shaders, to a target view moved sideways by desc.HeadOffset
+void DepthPrecisionMeasure(const DepthPrecisionDesc& desc, DepthFormat format, float minDistance, float maxDistance,
+    DepthPrecision* precision);
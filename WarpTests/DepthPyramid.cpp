@@ -0,0 +1,233 @@
+//==============================================================================
+#include "DepthPyramid.h"
+#include <assert.h>
+#include <algorithm>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Texels per axis a query reads at most. Larger reads more texels, but from
+// finer levels that bound the rectangle more tightly.
+static const uint32_t MaxQueryTexels = 4;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline uint32_t NextLevelSize(uint32_t size)
+{
+    return size > 1 ? size / 2 : 1;
+}
+
+static inline const float* Row(const CpuTexture& texture, uint32_t y)
+{
+    return (const float*)(texture.Data + (size_t)y * texture.RowPitch);
+}
+
+// Min and max down the source rows covered by target row 'y', into RowMin and
+// RowMax
+static void ReduceRows(const CpuTexture& source, uint32_t y, uint32_t targetHeight, DepthPyramid* pyramid)
+{
+    uint32_t y0 = y * 2;
+    uint32_t y1 = std::min(y0 + 1, source.Height - 1);
+    uint32_t y2 = (y == targetHeight - 1) ? source.Height - 1 : y1;
+
+    const float* r0 = Row(source, y0);
+    const float* r1 = Row(source, y1);
+    const float* r2 = Row(source, y2);
+    float* rowMin = pyramid->RowMin.data();
+    float* rowMax = pyramid->RowMax.data();
+
+    uint32_t x = 0;
+    if (source.Format == CpuFormat::R32Float)
+    {
+        for (; x + SimdWidth <= source.Width; x += SimdWidth)
+        {
+            SimdFloat a = SimdLoad(r0 + x);
+            SimdFloat b = SimdLoad(r1 + x);
+            SimdFloat c = SimdLoad(r2 + x);
+            SimdStore(rowMin + x, SimdMin(SimdMin(a, b), c));
+            SimdStore(rowMax + x, SimdMax(SimdMax(a, b), c));
+        }
+        for (; x < source.Width; ++x)
+        {
+            rowMin[x] = std::min(std::min(r0[x], r1[x]), r2[x]);
+            rowMax[x] = std::max(std::max(r0[x], r1[x]), r2[x]);
+        }
+    }
+    else
+    {
+        assert(source.Format == CpuFormat::R32G32Float);
+
+        // Texels are min, max pairs. Reduce both and split them apart.
+        for (; x + SimdWidth <= source.Width; x += SimdWidth)
+        {
+            const float* p0 = r0 + x * 2;
+            const float* p1 = r1 + x * 2;
+            const float* p2 = r2 + x * 2;
+            SimdFloat lo0 = SimdLoad(p0), hi0 = SimdLoad(p0 + SimdWidth);
+            SimdFloat lo1 = SimdLoad(p1), hi1 = SimdLoad(p1 + SimdWidth);
+            SimdFloat lo2 = SimdLoad(p2), hi2 = SimdLoad(p2 + SimdWidth);
+
+            SimdFloat minLo = SimdMin(SimdMin(lo0, lo1), lo2);
+            SimdFloat minHi = SimdMin(SimdMin(hi0, hi1), hi2);
+            SimdFloat maxLo = SimdMax(SimdMax(lo0, lo1), lo2);
+            SimdFloat maxHi = SimdMax(SimdMax(hi0, hi1), hi2);
+            SimdStore(rowMin + x, SimdEvenLanes(minLo, minHi));
+            SimdStore(rowMax + x, SimdOddLanes(maxLo, maxHi));
+        }
+        for (; x < source.Width; ++x)
+        {
+            rowMin[x] = std::min(std::min(r0[x * 2], r1[x * 2]), r2[x * 2]);
+            rowMax[x] = std::max(std::max(r0[x * 2 + 1], r1[x * 2 + 1]), r2[x * 2 + 1]);
+        }
+    }
+}
+
+// Min and max across pairs of RowMin and RowMax into target row 'y'
+static void ReduceColumns(uint32_t sourceWidth, CpuTexture* target, uint32_t y, const DepthPyramid& pyramid)
+{
+    const float* rowMin = pyramid.RowMin.data();
+    const float* rowMax = pyramid.RowMax.data();
+    float* out = (float*)(target->Data + (size_t)y * target->RowPitch);
+
+    // The last texel may cover three columns, so it's left to the scalar loop
+    uint32_t x = 0;
+    for (; x + SimdWidth < target->Width; x += SimdWidth)
+    {
+        SimdFloat min0 = SimdLoad(rowMin + x * 2), min1 = SimdLoad(rowMin + x * 2 + SimdWidth);
+        SimdFloat max0 = SimdLoad(rowMax + x * 2), max1 = SimdLoad(rowMax + x * 2 + SimdWidth);
+        SimdFloat minPairs = SimdMin(SimdEvenLanes(min0, min1), SimdOddLanes(min0, min1));
+        SimdFloat maxPairs = SimdMax(SimdEvenLanes(max0, max1), SimdOddLanes(max0, max1));
+        SimdStore(out + x * 2, SimdInterleaveLow(minPairs, maxPairs));
+        SimdStore(out + x * 2 + SimdWidth, SimdInterleaveHigh(minPairs, maxPairs));
+    }
+    for (; x < target->Width; ++x)
+    {
+        uint32_t x0 = x * 2;
+        uint32_t x1 = (x == target->Width - 1) ? sourceWidth - 1 : x0 + 1;
+
+        float minDepth = rowMin[x0];
+        float maxDepth = rowMax[x0];
+        for (uint32_t i = x0 + 1; i <= x1; ++i)
+        {
+            minDepth = std::min(minDepth, rowMin[i]);
+            maxDepth = std::max(maxDepth, rowMax[i]);
+        }
+        out[x * 2 + 0] = minDepth;
+        out[x * 2 + 1] = maxDepth;
+    }
+}
+
+static void ReduceLevel(const CpuTexture& source, CpuTexture* target, DepthPyramid* pyramid)
+{
+    for (uint32_t y = 0; y < target->Height; ++y)
+    {
+        ReduceRows(source, y, target->Height, pyramid);
+        ReduceColumns(source.Width, target, y, *pyramid);
+    }
+}
+
+//==============================================================================
+uint32_t DepthPyramidNumLevels(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    width = NextLevelSize(width);
+    height = NextLevelSize(height);
+    while (width > 1 || height > 1)
+    {
+        width = NextLevelSize(width);
+        height = NextLevelSize(height);
+        ++levels;
+    }
+    return levels;
+}
+
+//==============================================================================
+bool DepthPyramidCreate(uint32_t width, uint32_t height, DepthPyramid* pyramid)
+{
+    DepthPyramidDestroy(pyramid);
+
+    pyramid->Width = width;
+    pyramid->Height = height;
+    pyramid->Levels.resize(DepthPyramidNumLevels(width, height));
+    pyramid->RowMin.resize(width);
+    pyramid->RowMax.resize(width);
+
+    for (CpuTexture& level : pyramid->Levels)
+    {
+        width = NextLevelSize(width);
+        height = NextLevelSize(height);
+        if (!CpuTextureCreate(width, height, CpuFormat::R32G32Float, &level))
+        {
+            assert(false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+void DepthPyramidDestroy(DepthPyramid* pyramid)
+{
+    for (CpuTexture& level : pyramid->Levels)
+    {
+        CpuTextureDestroy(&level);
+    }
+    pyramid->Levels.clear();
+}
+
+//==============================================================================
+void DepthPyramidBuild(const CpuTexture& depth, DepthPyramid* pyramid)
+{
+    assert(depth.Format == CpuFormat::R32Float);
+    assert(depth.Width == pyramid->Width && depth.Height == pyramid->Height);
+
+    const CpuTexture* source = &depth;
+    for (CpuTexture& level : pyramid->Levels)
+    {
+        ReduceLevel(*source, &level, pyramid);
+        source = &level;
+    }
+}
+
+//==============================================================================
+void DepthPyramidQuery(const DepthPyramid& pyramid, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+    float* minDepth, float* maxDepth)
+{
+    assert(x0 < x1 && y0 < y1);
+
+    for (uint32_t i = 0; i < pyramid.Levels.size(); ++i)
+    {
+        // Past the end is covered by the last row or column
+        const CpuTexture& level = pyramid.Levels[i];
+        uint32_t shift = i + 1;
+        uint32_t tx0 = std::min(x0 >> shift, level.Width - 1);
+        uint32_t ty0 = std::min(y0 >> shift, level.Height - 1);
+        uint32_t tx1 = std::min((x1 - 1) >> shift, level.Width - 1);
+        uint32_t ty1 = std::min((y1 - 1) >> shift, level.Height - 1);
+
+        if (tx1 - tx0 >= MaxQueryTexels || ty1 - ty0 >= MaxQueryTexels)
+        {
+            continue;
+        }
+
+        float resultMin = Row(level, ty0)[tx0 * 2];
+        float resultMax = Row(level, ty0)[tx0 * 2 + 1];
+        for (uint32_t y = ty0; y <= ty1; ++y)
+        {
+            for (uint32_t x = tx0; x <= tx1; ++x)
+            {
+                resultMin = std::min(resultMin, Row(level, y)[x * 2]);
+                resultMax = std::max(resultMax, Row(level, y)[x * 2 + 1]);
+            }
+        }
+        *minDepth = resultMin;
+        *maxDepth = resultMax;
+        return;
+    }
+
+    // The last level is a single texel, so this isn't reached
+    assert(false);
+}
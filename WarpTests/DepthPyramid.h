@@ -0,0 +1,48 @@
+//==============================================================================
+// Min/max depth pyramid (hierarchical Z) over an R32Float depth buffer, for
+// the positional warp to make coarse decisions from. Level 0 is half the depth
+// resolution, and each texel of a level holds the min and max of the 2x2
+// texels below it.
+//
+// Level sizes round down like a D3D11 mip chain. On odd sizes the last row or
+// column also covers the odd one out below it, so every level is conservative.
+// DepthPyramidCS.hlsli builds the same pyramid on the GPU.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct DepthPyramid
+{
+    uint32_t Width;                 // Of the depth buffer
+    uint32_t Height;
+    std::vector<CpuTexture> Levels; // R32G32Float: min, max
+
+    // Scratch for one row, reused between builds
+    std::vector<float> RowMin;
+    std::vector<float> RowMax;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Levels in the pyramid of a 'width' x 'height' depth buffer
+uint32_t DepthPyramidNumLevels(uint32_t width, uint32_t height);
+
+// Sizes 'pyramid' for a 'width' x 'height' depth buffer
+bool DepthPyramidCreate(uint32_t width, uint32_t height, DepthPyramid* pyramid);
+void DepthPyramidDestroy(DepthPyramid* pyramid);
+
+// Rebuilds every level from 'depth', which must match the created size
+void DepthPyramidBuild(const CpuTexture& depth, DepthPyramid* pyramid);
+
+// Conservative min and max over depth texels [x0, x1) x [y0, y1), from the
+// finest level where the rectangle covers at most 4x4 texels
+void DepthPyramidQuery(const DepthPyramid& pyramid, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+    float* minDepth, float* maxDepth);
@@ -0,0 +1,53 @@
+// Builds one level of the min/max depth pyramid (see DepthPyramid.h) from the
+// level below it. Permutations are selected with the following defines:
+//   FROM_DEPTH - Source is the R32 depth buffer rather than the previous level
+#ifndef FROM_DEPTH
+#define FROM_DEPTH 0
+#endif
+
+#if FROM_DEPTH
+Texture2D<float> Source;
+#else
+Texture2D<float2> Source;
+#endif
+RWTexture2D<float2> Target;
+
+cbuffer Constants
+{
+    uint2 SourceSize;
+    uint2 TargetSize;
+};
+
+float2 LoadMinMax(uint2 texel)
+{
+#if FROM_DEPTH
+    return Source.Load(int3(texel, 0)).xx;
+#else
+    return Source.Load(int3(texel, 0));
+#endif
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (any(id.xy >= TargetSize))
+    {
+        return;
+    }
+
+    // On odd source sizes the last row and column also cover the odd one out
+    uint2 first = id.xy * 2;
+    uint2 last = (id.xy == TargetSize - 1) ? SourceSize - 1 : min(first + 1, SourceSize - 1);
+
+    float2 result = LoadMinMax(first);
+    for (uint y = first.y; y <= last.y; ++y)
+    {
+        for (uint x = first.x; x <= last.x; ++x)
+        {
+            float2 texel = LoadMinMax(uint2(x, y));
+            result = float2(min(result.x, texel.x), max(result.y, texel.y));
+        }
+    }
+
+    Target[id.xy] = result;
+}
@@ -0,0 +1,3 @@
+// Build-time copy of the depth pyramid permutation reading the depth buffer
+#define FROM_DEPTH 1
+#include "DepthPyramidCS.hlsli"
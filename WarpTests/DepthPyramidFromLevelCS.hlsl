@@ -0,0 +1,2 @@
+// Build-time copy of the depth pyramid permutation reading the previous level
+#include "DepthPyramidCS.hlsli"
@@ -0,0 +1,3 @@
+// Build-time copy of the lens distorted warp permutation
+#define LENS_DISTORTION 1
+#include "WarpPS.hlsli"
@@ -0,0 +1,921 @@
+//==============================================================================
+#include "Dxbc.h"
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t FourCC_DXBC = 'D' | ('X' << 8) | ('B' << 16) | ('C' << 24);
+static const uint32_t FourCC_ISGN = 'I' | ('S' << 8) | ('G' << 16) | ('N' << 24);
+static const uint32_t FourCC_OSGN = 'O' | ('S' << 8) | ('G' << 16) | ('N' << 24);
+static const uint32_t FourCC_SHDR = 'S' | ('H' << 8) | ('D' << 16) | ('R' << 24);
+static const uint32_t FourCC_SHEX = 'S' | ('H' << 8) | ('E' << 16) | ('X' << 24);
+static const uint32_t FourCC_STAT = 'S' | ('T' << 8) | ('A' << 16) | ('T' << 24);
+
+//==============================================================================
+// Parsing
+//==============================================================================
+struct TokenReader
+{
+    const uint32_t* Tokens;
+    uint32_t Position;
+    uint32_t End;
+};
+
+static inline bool ReadToken(TokenReader* reader, uint32_t* token)
+{
+    if (reader->Position >= reader->End)
+    {
+        return false;
+    }
+    *token = reader->Tokens[reader->Position++];
+    return true;
+}
+
+static bool IsSupportedOpcode(uint32_t opcode)
+{
+    switch (opcode)
+    {
+    case DxbcOpAdd: case DxbcOpAnd: case DxbcOpDiscard: case DxbcOpDiv:
+    case DxbcOpDp2: case DxbcOpDp3: case DxbcOpDp4: case DxbcOpEq:
+    case DxbcOpExp: case DxbcOpFrc: case DxbcOpFtoi: case DxbcOpFtou:
+    case DxbcOpGe: case DxbcOpIAdd: case DxbcOpIEq: case DxbcOpIGe:
+    case DxbcOpILt: case DxbcOpIMad: case DxbcOpIMax: case DxbcOpIMin:
+    case DxbcOpINe: case DxbcOpINeg: case DxbcOpIShl: case DxbcOpIShr:
+    case DxbcOpItof: case DxbcOpLd: case DxbcOpLog: case DxbcOpLt:
+    case DxbcOpMad: case DxbcOpMin: case DxbcOpMax: case DxbcOpMov:
+    case DxbcOpMovc: case DxbcOpMul: case DxbcOpNe: case DxbcOpNop:
+    case DxbcOpNot: case DxbcOpOr: case DxbcOpRet: case DxbcOpRoundNe:
+    case DxbcOpRoundNi: case DxbcOpRoundPi: case DxbcOpRoundZ: case DxbcOpRsq:
+    case DxbcOpSample: case DxbcOpSampleL: case DxbcOpSqrt: case DxbcOpUShr:
+    case DxbcOpUtof: case DxbcOpXor:
+        return true;
+    }
+    return false;
+}
+
+// Opcodes whose results are floats, the only ones _sat is valid on. Clamping
+// the bits of an integer or a comparison mask would corrupt them.
+static bool HasFloatResult(uint32_t opcode)
+{
+    switch (opcode)
+    {
+    case DxbcOpAdd: case DxbcOpDiv: case DxbcOpDp2: case DxbcOpDp3:
+    case DxbcOpDp4: case DxbcOpExp: case DxbcOpFrc: case DxbcOpItof:
+    case DxbcOpLd: case DxbcOpLog: case DxbcOpMad: case DxbcOpMin:
+    case DxbcOpMax: case DxbcOpMov: case DxbcOpMovc: case DxbcOpMul:
+    case DxbcOpRoundNe: case DxbcOpRoundNi: case DxbcOpRoundPi: case DxbcOpRoundZ:
+    case DxbcOpRsq: case DxbcOpSample: case DxbcOpSampleL: case DxbcOpSqrt:
+    case DxbcOpUtof:
+        return true;
+    }
+    return false;
+}
+
+static bool IsDeclaration(uint32_t opcode)
+{
+    return (opcode >= DxbcOpDclResource && opcode <= DxbcOpDclGlobalFlags) || opcode == DxbcOpCustomData;
+}
+
+static bool ParseOperand(TokenReader* reader, DxbcOperand* operand)
+{
+    uint32_t token;
+    if (!ReadToken(reader, &token))
+    {
+        return false;
+    }
+
+    memset(operand, 0, sizeof(*operand));
+
+    uint32_t numComponents = token & 3;
+    uint32_t selectionMode = (token >> 2) & 3;
+    operand->Type = (DxbcOperandType)((token >> 12) & 0xFF);
+    operand->Mask = 0xF;
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        operand->Swizzle[i] = i;
+    }
+
+    if (numComponents == 1)
+    {
+        memset(operand->Swizzle, 0, sizeof(operand->Swizzle));
+    }
+    else if (numComponents == 2)
+    {
+        switch (selectionMode)
+        {
+        case 0: // Mask
+            operand->Mask = (token >> 4) & 0xF;
+            break;
+
+        case 1: // Swizzle
+            for (int i = 0; i < 4; ++i)
+            {
+                operand->Swizzle[i] = (token >> (4 + i * 2)) & 3;
+            }
+            break;
+
+        case 2: // Select1
+            memset(operand->Swizzle, (token >> 4) & 3, sizeof(operand->Swizzle));
+            break;
+        }
+    }
+
+    bool extended = (token & 0x80000000) != 0;
+    while (extended)
+    {
+        uint32_t ext;
+        if (!ReadToken(reader, &ext))
+        {
+            return false;
+        }
+        if ((ext & 0x3F) == 1)
+        {
+            operand->Modifier = (DxbcModifier)((ext >> 6) & 0xFF);
+        }
+        extended = (ext & 0x80000000) != 0;
+    }
+
+    if (operand->Type == DxbcOperandType::Immediate32)
+    {
+        uint32_t count = numComponents == 1 ? 1 : 4;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!ReadToken(reader, &operand->Immediate[i]))
+            {
+                return false;
+            }
+        }
+        if (count == 1)
+        {
+            operand->Immediate[1] = operand->Immediate[2] = operand->Immediate[3] = operand->Immediate[0];
+        }
+        return true;
+    }
+
+    if (operand->Type == DxbcOperandType::Immediate64)
+    {
+        return false;
+    }
+
+    uint32_t indexDimension = (token >> 20) & 3;
+    if (indexDimension > 2)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < indexDimension; ++i)
+    {
+        uint32_t representation = (token >> (22 + i * 3)) & 7;
+        if (representation != 0)
+        {
+            // Relative addressing isn't needed by any shader in this project
+            return false;
+        }
+        if (!ReadToken(reader, &operand->Index[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool ParseSignature(const uint8_t* chunk, uint32_t chunkSize, std::vector<DxbcSignatureElement>* signature)
+{
+    if (chunkSize < 8)
+    {
+        return false;
+    }
+
+    uint32_t count = ((const uint32_t*)chunk)[0];
+    if (8 + count * 24 > chunkSize)
+    {
+        return false;
+    }
+
+    signature->resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t* e = (const uint32_t*)(chunk + 8 + i * 24);
+        auto& element = (*signature)[i];
+
+        uint32_t nameOffset = e[0];
+        if (nameOffset >= chunkSize)
+        {
+            return false;
+        }
+        size_t maxLength = chunkSize - nameOffset;
+        if (maxLength > sizeof(element.SemanticName) - 1)
+        {
+            maxLength = sizeof(element.SemanticName) - 1;
+        }
+        memset(element.SemanticName, 0, sizeof(element.SemanticName));
+        const char* name = (const char*)chunk + nameOffset;
+        for (size_t n = 0; n < maxLength && name[n]; ++n)
+        {
+            element.SemanticName[n] = name[n];
+        }
+
+        element.SemanticIndex = e[1];
+        element.SystemValue = e[2];
+        element.Register = e[4];
+        element.Mask = e[5] & 0xFF;
+    }
+
+    return true;
+}
+
+static bool ParseProgram(const uint32_t* tokens, uint32_t numTokens, DxbcShader* shader)
+{
+    if (numTokens < 2)
+    {
+        return false;
+    }
+
+    shader->MinorVersion = tokens[0] & 0xF;
+    shader->MajorVersion = (tokens[0] >> 4) & 0xF;
+    shader->Type = (DxbcProgramType)((tokens[0] >> 16) & 0xFFFF);
+
+    uint32_t length = tokens[1];
+    if (length > numTokens)
+    {
+        return false;
+    }
+
+    uint32_t position = 2;
+    while (position < length)
+    {
+        uint32_t token = tokens[position];
+        uint32_t opcode = token & 0x7FF;
+        uint32_t instructionLength = (token >> 24) & 0x7F;
+
+        if (opcode == DxbcOpCustomData)
+        {
+            if (position + 1 >= length)
+            {
+                return false;
+            }
+            instructionLength = tokens[position + 1];
+        }
+
+        if (instructionLength == 0 || position + instructionLength > length)
+        {
+            return false;
+        }
+
+        if (opcode == DxbcOpDclTemps)
+        {
+            shader->NumTemps = tokens[position + 1];
+            if (shader->NumTemps > DxbcMaxRegisters)
+            {
+                return false;
+            }
+        }
+        else if (!IsDeclaration(opcode))
+        {
+            if (!IsSupportedOpcode(opcode))
+            {
+                return false;
+            }
+
+            DxbcInstruction instruction{};
+            instruction.Opcode = (DxbcOpcode)opcode;
+            instruction.Saturate = (token & (1 << 13)) != 0;
+            instruction.TestNonZero = (token & (1 << 18)) != 0;
+            if (instruction.Saturate && !HasFloatResult(opcode))
+            {
+                return false;
+            }
+
+            TokenReader reader{ tokens, position + 1, position + instructionLength };
+
+            // Skip extended opcode tokens (resource dimension/return type on
+            // the _indexable variants, sample offsets)
+            bool extended = (token & 0x80000000) != 0;
+            while (extended)
+            {
+                uint32_t ext;
+                if (!ReadToken(&reader, &ext))
+                {
+                    return false;
+                }
+                if ((ext & 0x3F) == 1 && (ext & 0x01FFFE00) != 0)
+                {
+                    // Immediate texel offsets aren't supported
+                    return false;
+                }
+                extended = (ext & 0x80000000) != 0;
+            }
+
+            while (reader.Position < reader.End)
+            {
+                if (instruction.NumOperands == DxbcMaxOperands ||
+                    !ParseOperand(&reader, &instruction.Operands[instruction.NumOperands]))
+                {
+                    return false;
+                }
+
+                auto& operand = instruction.Operands[instruction.NumOperands];
+                if ((operand.Type == DxbcOperandType::Temp || operand.Type == DxbcOperandType::Input ||
+                    operand.Type == DxbcOperandType::Output) && operand.Index[0] >= DxbcMaxRegisters)
+                {
+                    return false;
+                }
+                if ((operand.Type == DxbcOperandType::ConstantBuffer && operand.Index[0] >= DxbcMaxConstantBuffers) ||
+                    (operand.Type == DxbcOperandType::Resource && operand.Index[0] >= DxbcMaxResources) ||
+                    (operand.Type == DxbcOperandType::Sampler && operand.Index[0] >= DxbcMaxSamplers))
+                {
+                    return false;
+                }
+                if (operand.Type == DxbcOperandType::IndexableTemp)
+                {
+                    return false;
+                }
+
+                ++instruction.NumOperands;
+            }
+
+            shader->Instructions.push_back(instruction);
+        }
+
+        position += instructionLength;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool DxbcParse(const void* bytecode, size_t size, DxbcShader* shader)
+{
+    const uint8_t* data = (const uint8_t*)bytecode;
+    if (size < 32 || ((const uint32_t*)data)[0] != FourCC_DXBC)
+    {
+        assert(false);
+        return false;
+    }
+
+    shader->NumTemps = 0;
+    shader->StatInstructionCount = 0;
+    shader->Instructions.clear();
+    shader->InputSignature.clear();
+    shader->OutputSignature.clear();
+
+    uint32_t totalSize = ((const uint32_t*)data)[6];
+    uint32_t numChunks = ((const uint32_t*)data)[7];
+    if (totalSize > size || 32 + numChunks * 4 > size)
+    {
+        assert(false);
+        return false;
+    }
+
+    bool foundProgram = false;
+
+    for (uint32_t i = 0; i < numChunks; ++i)
+    {
+        uint32_t offset = ((const uint32_t*)(data + 32))[i];
+        if (offset + 8 > size)
+        {
+            assert(false);
+            return false;
+        }
+
+        uint32_t fourCC = *(const uint32_t*)(data + offset);
+        uint32_t chunkSize = *(const uint32_t*)(data + offset + 4);
+        const uint8_t* chunk = data + offset + 8;
+        if (offset + 8 + chunkSize > size)
+        {
+            assert(false);
+            return false;
+        }
+
+        if (fourCC == FourCC_ISGN)
+        {
+            if (!ParseSignature(chunk, chunkSize, &shader->InputSignature))
+            {
+                assert(false);
+                return false;
+            }
+        }
+        else if (fourCC == FourCC_OSGN)
+        {
+            if (!ParseSignature(chunk, chunkSize, &shader->OutputSignature))
+            {
+                assert(false);
+                return false;
+            }
+        }
+        else if (fourCC == FourCC_SHDR || fourCC == FourCC_SHEX)
+        {
+            // Unsupported instructions are an expected failure, so no assert
+            if (!ParseProgram((const uint32_t*)chunk, chunkSize / 4, shader))
+            {
+                return false;
+            }
+            foundProgram = true;
+        }
+        else if (fourCC == FourCC_STAT && chunkSize >= 4)
+        {
+            shader->StatInstructionCount = *(const uint32_t*)chunk;
+        }
+    }
+
+    return foundProgram;
+}
+
+//==============================================================================
+int32_t DxbcFindSignatureElement(const std::vector<DxbcSignatureElement>& signature, const char* semanticName, uint32_t semanticIndex)
+{
+    for (size_t i = 0; i < signature.size(); ++i)
+    {
+        if (signature[i].SemanticIndex == semanticIndex &&
+#ifdef _WIN32
+            _stricmp(signature[i].SemanticName, semanticName) == 0)
+#else
+            strcasecmp(signature[i].SemanticName, semanticName) == 0)
+#endif
+        {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+//==============================================================================
+const char* DxbcOpcodeName(DxbcOpcode opcode)
+{
+    switch (opcode)
+    {
+    case DxbcOpAdd: return "add";
+    case DxbcOpAnd: return "and";
+    case DxbcOpDiscard: return "discard";
+    case DxbcOpDiv: return "div";
+    case DxbcOpDp2: return "dp2";
+    case DxbcOpDp3: return "dp3";
+    case DxbcOpDp4: return "dp4";
+    case DxbcOpEq: return "eq";
+    case DxbcOpExp: return "exp";
+    case DxbcOpFrc: return "frc";
+    case DxbcOpFtoi: return "ftoi";
+    case DxbcOpFtou: return "ftou";
+    case DxbcOpGe: return "ge";
+    case DxbcOpIAdd: return "iadd";
+    case DxbcOpIEq: return "ieq";
+    case DxbcOpIGe: return "ige";
+    case DxbcOpILt: return "ilt";
+    case DxbcOpIMad: return "imad";
+    case DxbcOpIMax: return "imax";
+    case DxbcOpIMin: return "imin";
+    case DxbcOpINe: return "ine";
+    case DxbcOpINeg: return "ineg";
+    case DxbcOpIShl: return "ishl";
+    case DxbcOpIShr: return "ishr";
+    case DxbcOpItof: return "itof";
+    case DxbcOpLd: return "ld";
+    case DxbcOpLog: return "log";
+    case DxbcOpLt: return "lt";
+    case DxbcOpMad: return "mad";
+    case DxbcOpMin: return "min";
+    case DxbcOpMax: return "max";
+    case DxbcOpMov: return "mov";
+    case DxbcOpMovc: return "movc";
+    case DxbcOpMul: return "mul";
+    case DxbcOpNe: return "ne";
+    case DxbcOpNop: return "nop";
+    case DxbcOpNot: return "not";
+    case DxbcOpOr: return "or";
+    case DxbcOpRet: return "ret";
+    case DxbcOpRoundNe: return "round_ne";
+    case DxbcOpRoundNi: return "round_ni";
+    case DxbcOpRoundPi: return "round_pi";
+    case DxbcOpRoundZ: return "round_z";
+    case DxbcOpRsq: return "rsq";
+    case DxbcOpSample: return "sample";
+    case DxbcOpSampleL: return "sample_l";
+    case DxbcOpSqrt: return "sqrt";
+    case DxbcOpUShr: return "ushr";
+    case DxbcOpUtof: return "utof";
+    case DxbcOpXor: return "xor";
+    default: return "unknown";
+    }
+}
+
+//==============================================================================
+// Execution
+//==============================================================================
+struct ExecState
+{
+    SimdFloat Temps[DxbcMaxRegisters][4];
+    DxbcLanes* Lanes;
+    const DxbcBindings* Bindings;
+};
+
+static inline SimdFloat* RegisterFile(ExecState* state, const DxbcOperand& operand)
+{
+    switch (operand.Type)
+    {
+    case DxbcOperandType::Temp: return state->Temps[operand.Index[0]];
+    case DxbcOperandType::Input: return state->Lanes->Inputs[operand.Index[0]];
+    case DxbcOperandType::Output: return state->Lanes->Outputs[operand.Index[0]];
+    default: return nullptr;
+    }
+}
+
+// Reads a source operand. Float modifiers are applied unless 'integer' is set,
+// in which case neg means two's complement negation.
+static inline void ReadSource(ExecState* state, const DxbcOperand& operand, bool integer, SimdFloat out[4])
+{
+    switch (operand.Type)
+    {
+    case DxbcOperandType::Immediate32:
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c] = SimdAsFloat(SimdIntSet((int32_t)operand.Immediate[operand.Swizzle[c]]));
+        }
+        break;
+
+    case DxbcOperandType::ConstantBuffer:
+    {
+        const float* cb = state->Bindings->ConstantBuffers[operand.Index[0]];
+        const float* element = cb + operand.Index[1] * 4;
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c] = SimdSet(element[operand.Swizzle[c]]);
+        }
+        break;
+    }
+
+    default:
+    {
+        SimdFloat* reg = RegisterFile(state, operand);
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c] = reg[operand.Swizzle[c]];
+        }
+        break;
+    }
+    }
+
+    if (operand.Modifier == DxbcModifierNone)
+    {
+        return;
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        if (integer)
+        {
+            if (operand.Modifier & DxbcModifierNeg)
+            {
+                out[c] = SimdAsFloat(SimdIntSub(SimdIntSet(0), SimdAsInt(out[c])));
+            }
+        }
+        else
+        {
+            if (operand.Modifier & DxbcModifierAbs)
+            {
+                out[c] = SimdAbs(out[c]);
+            }
+            if (operand.Modifier & DxbcModifierNeg)
+            {
+                out[c] = SimdNeg(out[c]);
+            }
+        }
+    }
+}
+
+static inline void WriteDest(ExecState* state, const DxbcInstruction& instruction, const SimdFloat value[4])
+{
+    const DxbcOperand& operand = instruction.Operands[0];
+    SimdFloat* reg = RegisterFile(state, operand);
+    if (!reg)
+    {
+        return;
+    }
+
+    // DxbcParse only accepts _sat on instructions with float results
+    for (int c = 0; c < 4; ++c)
+    {
+        if (operand.Mask & (1 << c))
+        {
+            reg[c] = instruction.Saturate ? SimdSaturate(value[c]) : value[c];
+        }
+    }
+}
+
+static inline SimdFloat BoolToMask(SimdInt b)
+{
+    return SimdAsFloat(b);
+}
+
+static inline SimdFloat Utof(SimdFloat a)
+{
+    SimdInt i = SimdAsInt(a);
+    SimdInt lo = SimdAsInt(SimdAnd(a, SimdAsFloat(SimdIntSet(0xFFFF))));
+    SimdInt hi = SimdUintShr(i, SimdIntSet(16));
+    return SimdMad(SimdItof(hi), SimdSet(65536.f), SimdItof(lo));
+}
+
+static inline SimdFloat Ftou(SimdFloat a)
+{
+    // Values >= 2^31 don't fit the signed conversion, so bias them down first
+    SimdFloat clamped = SimdMax(a, SimdZero());
+    SimdFloat big = SimdCmpGe(clamped, SimdSet(2147483648.f));
+    SimdFloat biased = SimdSelect(big, SimdSub(clamped, SimdSet(2147483648.f)), clamped);
+    SimdInt result = SimdFtoi(biased);
+    return SimdOr(SimdAsFloat(result), SimdAnd(big, SimdAsFloat(SimdIntSet((int32_t)0x80000000))));
+}
+
+static inline const CpuTexture* ResourceOperand(ExecState* state, const DxbcOperand& operand)
+{
+    return state->Bindings->Resources[operand.Index[0]];
+}
+
+// Applies the resource swizzle of ld/sample instructions to the fetched texel
+static inline void SwizzleTexel(const DxbcOperand& resource, const SimdFloat texel[4], SimdFloat out[4])
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = texel[resource.Swizzle[c]];
+    }
+}
+
+//==============================================================================
+void DxbcExecute(const DxbcShader& shader, const DxbcBindings& bindings, DxbcLanes* lanes, DxbcProfile* profile)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    ExecState state;
+    state.Lanes = lanes;
+    state.Bindings = &bindings;
+    for (uint32_t r = 0; r < shader.NumTemps; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            state.Temps[r][c] = SimdZero();
+        }
+    }
+    lanes->Discarded = SimdZero();
+
+    SimdFloat a[4], b[4], c[4], result[4];
+
+    for (const auto& instruction : shader.Instructions)
+    {
+        const DxbcOperand* ops = instruction.Operands;
+
+        if (profile)
+        {
+            ++profile->OpcodeCounts[instruction.Opcode];
+        }
+
+        switch (instruction.Opcode)
+        {
+        case DxbcOpAdd:
+        case DxbcOpMul:
+        case DxbcOpDiv:
+        case DxbcOpMin:
+        case DxbcOpMax:
+        case DxbcOpLt:
+        case DxbcOpGe:
+        case DxbcOpEq:
+        case DxbcOpNe:
+            ReadSource(&state, ops[1], false, a);
+            ReadSource(&state, ops[2], false, b);
+            for (int i = 0; i < 4; ++i)
+            {
+                switch (instruction.Opcode)
+                {
+                case DxbcOpAdd: result[i] = SimdAdd(a[i], b[i]); break;
+                case DxbcOpMul: result[i] = SimdMul(a[i], b[i]); break;
+                case DxbcOpDiv: result[i] = SimdDiv(a[i], b[i]); break;
+                case DxbcOpMin: result[i] = SimdMin(a[i], b[i]); break;
+                case DxbcOpMax: result[i] = SimdMax(a[i], b[i]); break;
+                case DxbcOpLt: result[i] = SimdCmpLt(a[i], b[i]); break;
+                case DxbcOpGe: result[i] = SimdCmpGe(a[i], b[i]); break;
+                case DxbcOpEq: result[i] = SimdCmpEq(a[i], b[i]); break;
+                default: result[i] = SimdCmpNe(a[i], b[i]); break;
+                }
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpMad:
+            ReadSource(&state, ops[1], false, a);
+            ReadSource(&state, ops[2], false, b);
+            ReadSource(&state, ops[3], false, c);
+            for (int i = 0; i < 4; ++i)
+            {
+                result[i] = SimdMad(a[i], b[i], c[i]);
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpDp2:
+        case DxbcOpDp3:
+        case DxbcOpDp4:
+        {
+            int count = instruction.Opcode - DxbcOpDp2 + 2;
+            ReadSource(&state, ops[1], false, a);
+            ReadSource(&state, ops[2], false, b);
+            SimdFloat dot = SimdMul(a[0], b[0]);
+            for (int i = 1; i < count; ++i)
+            {
+                dot = SimdMad(a[i], b[i], dot);
+            }
+            result[0] = result[1] = result[2] = result[3] = dot;
+            WriteDest(&state, instruction, result);
+            break;
+        }
+
+        case DxbcOpMov:
+            ReadSource(&state, ops[1], false, result);
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpMovc:
+            ReadSource(&state, ops[1], true, a);
+            ReadSource(&state, ops[2], false, b);
+            ReadSource(&state, ops[3], false, c);
+            for (int i = 0; i < 4; ++i)
+            {
+                SimdFloat test = SimdAsFloat(SimdIntCmpEq(SimdAsInt(a[i]), SimdIntSet(0)));
+                result[i] = SimdSelect(test, c[i], b[i]);
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpFrc:
+        case DxbcOpRoundNe:
+        case DxbcOpRoundNi:
+        case DxbcOpRoundPi:
+        case DxbcOpRoundZ:
+        case DxbcOpSqrt:
+        case DxbcOpRsq:
+        case DxbcOpExp:
+        case DxbcOpLog:
+        case DxbcOpFtoi:
+        case DxbcOpFtou:
+            ReadSource(&state, ops[1], false, a);
+            for (int i = 0; i < 4; ++i)
+            {
+                switch (instruction.Opcode)
+                {
+                case DxbcOpFrc: result[i] = SimdSub(a[i], SimdFloor(a[i])); break;
+                case DxbcOpRoundNe: result[i] = SimdRoundNe(a[i]); break;
+                case DxbcOpRoundNi: result[i] = SimdFloor(a[i]); break;
+                case DxbcOpRoundPi: result[i] = SimdCeil(a[i]); break;
+                case DxbcOpRoundZ: result[i] = SimdTrunc(a[i]); break;
+                case DxbcOpSqrt: result[i] = SimdSqrt(a[i]); break;
+                case DxbcOpRsq: result[i] = SimdDiv(SimdSet(1.f), SimdSqrt(a[i])); break;
+                case DxbcOpExp: result[i] = SimdPerLane(a[i], [](float f) { return exp2f(f); }); break;
+                case DxbcOpLog: result[i] = SimdPerLane(a[i], [](float f) { return log2f(f); }); break;
+                case DxbcOpFtoi: result[i] = SimdAsFloat(SimdFtoi(a[i])); break;
+                default: result[i] = Ftou(a[i]); break;
+                }
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpItof:
+        case DxbcOpUtof:
+        case DxbcOpINeg:
+        case DxbcOpNot:
+            ReadSource(&state, ops[1], true, a);
+            for (int i = 0; i < 4; ++i)
+            {
+                switch (instruction.Opcode)
+                {
+                case DxbcOpItof: result[i] = SimdItof(SimdAsInt(a[i])); break;
+                case DxbcOpUtof: result[i] = Utof(a[i]); break;
+                case DxbcOpINeg: result[i] = SimdAsFloat(SimdIntSub(SimdIntSet(0), SimdAsInt(a[i]))); break;
+                default: result[i] = SimdXor(a[i], SimdTrue()); break;
+                }
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpIAdd:
+        case DxbcOpIMin:
+        case DxbcOpIMax:
+        case DxbcOpIShl:
+        case DxbcOpIShr:
+        case DxbcOpUShr:
+        case DxbcOpAnd:
+        case DxbcOpOr:
+        case DxbcOpXor:
+        case DxbcOpIEq:
+        case DxbcOpINe:
+        case DxbcOpILt:
+        case DxbcOpIGe:
+            ReadSource(&state, ops[1], true, a);
+            ReadSource(&state, ops[2], true, b);
+            for (int i = 0; i < 4; ++i)
+            {
+                SimdInt ia = SimdAsInt(a[i]);
+                SimdInt ib = SimdAsInt(b[i]);
+                SimdInt shift = SimdAsInt(SimdAnd(b[i], SimdAsFloat(SimdIntSet(31))));
+                switch (instruction.Opcode)
+                {
+                case DxbcOpIAdd: result[i] = SimdAsFloat(SimdIntAdd(ia, ib)); break;
+                case DxbcOpIMin: result[i] = SimdAsFloat(SimdIntMin(ia, ib)); break;
+                case DxbcOpIMax: result[i] = SimdAsFloat(SimdIntMax(ia, ib)); break;
+                case DxbcOpIShl: result[i] = SimdAsFloat(SimdIntShl(ia, shift)); break;
+                case DxbcOpIShr: result[i] = SimdAsFloat(SimdIntShr(ia, shift)); break;
+                case DxbcOpUShr: result[i] = SimdAsFloat(SimdUintShr(ia, shift)); break;
+                case DxbcOpAnd: result[i] = SimdAnd(a[i], b[i]); break;
+                case DxbcOpOr: result[i] = SimdOr(a[i], b[i]); break;
+                case DxbcOpXor: result[i] = SimdXor(a[i], b[i]); break;
+                case DxbcOpIEq: result[i] = BoolToMask(SimdIntCmpEq(ia, ib)); break;
+                case DxbcOpINe: result[i] = SimdXor(BoolToMask(SimdIntCmpEq(ia, ib)), SimdTrue()); break;
+                case DxbcOpILt: result[i] = BoolToMask(SimdIntCmpLt(ia, ib)); break;
+                default: result[i] = SimdXor(BoolToMask(SimdIntCmpLt(ia, ib)), SimdTrue()); break;
+                }
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpIMad:
+            ReadSource(&state, ops[1], true, a);
+            ReadSource(&state, ops[2], true, b);
+            ReadSource(&state, ops[3], true, c);
+            for (int i = 0; i < 4; ++i)
+            {
+                result[i] = SimdAsFloat(SimdIntAdd(SimdIntMul(SimdAsInt(a[i]), SimdAsInt(b[i])), SimdAsInt(c[i])));
+            }
+            WriteDest(&state, instruction, result);
+            break;
+
+        case DxbcOpLd:
+        {
+            ReadSource(&state, ops[1], true, a);
+            SimdFloat texel[4];
+            const CpuTexture* texture = ResourceOperand(&state, ops[2]);
+            if (texture)
+            {
+                CpuTextureLoad(*texture, SimdAsInt(a[0]), SimdAsInt(a[1]), texel);
+            }
+            else
+            {
+                texel[0] = texel[1] = texel[2] = texel[3] = SimdZero();
+            }
+            SwizzleTexel(ops[2], texel, result);
+            WriteDest(&state, instruction, result);
+            break;
+        }
+
+        case DxbcOpSample:
+        case DxbcOpSampleL:
+        {
+            // There are no quad derivatives to pick a level from, so sample
+            // always reads level 0. sample_l reads the level of its LOD operand.
+            ReadSource(&state, ops[1], false, a);
+            SimdFloat texel[4];
+            const CpuTexture* texture = ResourceOperand(&state, ops[2]);
+            const CpuSampler* sampler = bindings.Samplers[ops[3].Index[0]];
+            if (texture && sampler && instruction.Opcode == DxbcOpSampleL)
+            {
+                ReadSource(&state, ops[4], false, b);
+                CpuTextureSampleLevel(texture, DxbcResourceLevels(bindings, ops[2].Index[0]), *sampler, a[0], a[1],
+                    b[0], texel);
+            }
+            else if (texture && sampler)
+            {
+                CpuTextureSample(*texture, *sampler, a[0], a[1], texel);
+            }
+            else
+            {
+                texel[0] = texel[1] = texel[2] = texel[3] = SimdZero();
+            }
+            SwizzleTexel(ops[2], texel, result);
+            WriteDest(&state, instruction, result);
+            break;
+        }
+
+        case DxbcOpDiscard:
+        {
+            ReadSource(&state, ops[0], true, a);
+            SimdFloat zero = SimdAsFloat(SimdIntCmpEq(SimdAsInt(a[0]), SimdIntSet(0)));
+            SimdFloat kill = instruction.TestNonZero ? SimdXor(zero, SimdTrue()) : zero;
+            lanes->Discarded = SimdOr(lanes->Discarded, kill);
+            break;
+        }
+
+        case DxbcOpRet:
+            goto done;
+
+        default:
+            break;
+        }
+    }
+
+done:
+    if (profile)
+    {
+        profile->Invocations += SimdWidth;
+        ++profile->Batches;
+        profile->Nanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
@@ -0,0 +1,219 @@
+//==============================================================================
+// DXBC container parser and SIMD interpreter for shader model 4/5 bytecode.
+//
+// Parses the same compiled blobs handed to the D3D11 device (SceneVS.h,
+// RotationalWarpPS.h, ...) and executes them on the CPU, SimdWidth shader
+// invocations at a time. Only straight-line code is supported (no flow control
+// besides ret/discard), which covers every shader in this project. Shaders
+// using anything else fail to parse rather than executing incorrectly.
+//==============================================================================
+#pragma once
+
+#include "Simd.h"
+#include "CpuTexture.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t DxbcMaxRegisters = 32;
+static const uint32_t DxbcMaxConstantBuffers = 14;
+static const uint32_t DxbcMaxResources = 16;
+static const uint32_t DxbcMaxSamplers = 16;
+static const uint32_t DxbcMaxOperands = 5;
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class DxbcProgramType
+{
+    Pixel = 0,
+    Vertex = 1,
+    Geometry = 2,
+    Hull = 3,
+    Domain = 4,
+    Compute = 5,
+};
+
+enum class DxbcOperandType : uint8_t
+{
+    Temp = 0,
+    Input = 1,
+    Output = 2,
+    IndexableTemp = 3,
+    Immediate32 = 4,
+    Immediate64 = 5,
+    Sampler = 6,
+    Resource = 7,
+    ConstantBuffer = 8,
+    Null = 13,
+};
+
+enum DxbcModifier : uint8_t
+{
+    DxbcModifierNone = 0,
+    DxbcModifierNeg = 1,
+    DxbcModifierAbs = 2,
+    DxbcModifierAbsNeg = 3,
+};
+
+// Subset of D3D10_SB_OPCODE_TYPE / D3D11_SB_OPCODE_TYPE
+enum DxbcOpcode : uint16_t
+{
+    DxbcOpAdd = 0,
+    DxbcOpAnd = 1,
+    DxbcOpDiscard = 13,
+    DxbcOpDiv = 14,
+    DxbcOpDp2 = 15,
+    DxbcOpDp3 = 16,
+    DxbcOpDp4 = 17,
+    DxbcOpEq = 24,
+    DxbcOpExp = 25,
+    DxbcOpFrc = 26,
+    DxbcOpFtoi = 27,
+    DxbcOpFtou = 28,
+    DxbcOpGe = 29,
+    DxbcOpIAdd = 30,
+    DxbcOpIEq = 32,
+    DxbcOpIGe = 33,
+    DxbcOpILt = 34,
+    DxbcOpIMad = 35,
+    DxbcOpIMax = 36,
+    DxbcOpIMin = 37,
+    DxbcOpINe = 39,
+    DxbcOpINeg = 40,
+    DxbcOpIShl = 41,
+    DxbcOpIShr = 42,
+    DxbcOpItof = 43,
+    DxbcOpLd = 45,
+    DxbcOpLog = 47,
+    DxbcOpLt = 49,
+    DxbcOpMad = 50,
+    DxbcOpMin = 51,
+    DxbcOpMax = 52,
+    DxbcOpCustomData = 53,
+    DxbcOpMov = 54,
+    DxbcOpMovc = 55,
+    DxbcOpMul = 56,
+    DxbcOpNe = 57,
+    DxbcOpNop = 58,
+    DxbcOpNot = 59,
+    DxbcOpOr = 60,
+    DxbcOpRet = 62,
+    DxbcOpRoundNe = 64,
+    DxbcOpRoundNi = 65,
+    DxbcOpRoundPi = 66,
+    DxbcOpRoundZ = 67,
+    DxbcOpRsq = 68,
+    DxbcOpSample = 69,
+    DxbcOpSampleL = 72,
+    DxbcOpSqrt = 75,
+    DxbcOpUShr = 85,
+    DxbcOpUtof = 86,
+    DxbcOpXor = 87,
+    DxbcOpDclResource = 88,
+    DxbcOpDclConstantBuffer = 89,
+    DxbcOpDclSampler = 90,
+    DxbcOpDclInput = 95,
+    DxbcOpDclInputSgv = 96,
+    DxbcOpDclInputSiv = 97,
+    DxbcOpDclInputPs = 98,
+    DxbcOpDclInputPsSgv = 99,
+    DxbcOpDclInputPsSiv = 100,
+    DxbcOpDclOutput = 101,
+    DxbcOpDclOutputSgv = 102,
+    DxbcOpDclOutputSiv = 103,
+    DxbcOpDclTemps = 104,
+    DxbcOpDclGlobalFlags = 106,
+    DxbcOpCount = 256,
+};
+
+struct DxbcOperand
+{
+    DxbcOperandType Type;
+    DxbcModifier Modifier;
+    uint8_t Mask;           // Destination write mask
+    uint8_t Swizzle[4];     // Source component selection
+    uint32_t Index[2];
+    uint32_t Immediate[4];
+};
+
+struct DxbcInstruction
+{
+    DxbcOpcode Opcode;
+    bool Saturate;
+    bool TestNonZero;       // discard/movc style conditional tests
+    uint32_t NumOperands;
+    DxbcOperand Operands[DxbcMaxOperands];
+};
+
+struct DxbcSignatureElement
+{
+    char SemanticName[32];
+    uint32_t SemanticIndex;
+    uint32_t SystemValue;
+    uint32_t Register;
+    uint32_t Mask;
+};
+
+struct DxbcShader
+{
+    DxbcProgramType Type;
+    uint32_t MajorVersion;
+    uint32_t MinorVersion;
+    uint32_t NumTemps;
+    uint32_t StatInstructionCount;  // From the STAT chunk, 0 if not present
+    std::vector<DxbcInstruction> Instructions;
+    std::vector<DxbcSignatureElement> InputSignature;
+    std::vector<DxbcSignatureElement> OutputSignature;
+};
+
+struct DxbcBindings
+{
+    const float* ConstantBuffers[DxbcMaxConstantBuffers];
+    const CpuTexture* Resources[DxbcMaxResources];
+    const CpuSampler* Samplers[DxbcMaxSamplers];
+
+    // Number of mip levels stored back to back at each of Resources, which
+    // sample_l picks from. Zero is taken to mean a single level.
+    uint32_t ResourceLevels[DxbcMaxResources];
+};
+
+static inline uint32_t DxbcResourceLevels(const DxbcBindings& bindings, uint32_t resource)
+{
+    return bindings.ResourceLevels[resource] ? bindings.ResourceLevels[resource] : 1;
+}
+
+// Register file for SimdWidth invocations, stored as one SIMD value per
+// register component. Inputs are filled by the caller, outputs are read back
+// after execution.
+struct DxbcLanes
+{
+    SimdFloat Inputs[DxbcMaxRegisters][4];
+    SimdFloat Outputs[DxbcMaxRegisters][4];
+    SimdFloat Discarded;
+};
+
+// Execution statistics, usable as a shader level profiler
+struct DxbcProfile
+{
+    uint64_t Invocations;
+    uint64_t Batches;
+    uint64_t OpcodeCounts[DxbcOpCount];
+    uint64_t Nanoseconds;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool DxbcParse(const void* bytecode, size_t size, DxbcShader* shader);
+
+// Returns the index of the signature element with the given semantic, or -1
+int32_t DxbcFindSignatureElement(const std::vector<DxbcSignatureElement>& signature, const char* semanticName, uint32_t semanticIndex);
+
+const char* DxbcOpcodeName(DxbcOpcode opcode);
+
+// Executes the shader for SimdWidth invocations. 'profile' may be null.
+void DxbcExecute(const DxbcShader& shader, const DxbcBindings& bindings, DxbcLanes* lanes, DxbcProfile* profile);
@@ -0,0 +1,995 @@
+//==============================================================================
+#include "DxbcCompiler.h"
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint16_t InputSlotBase = (uint16_t)(offsetof(DxbcProgramState, Lanes.Inputs) / sizeof(SimdFloat));
+static const uint16_t OutputSlotBase = (uint16_t)(offsetof(DxbcProgramState, Lanes.Outputs) / sizeof(SimdFloat));
+static const uint16_t DiscardedSlot = (uint16_t)(offsetof(DxbcProgramState, Lanes.Discarded) / sizeof(SimdFloat));
+static const uint16_t TempSlotBase = (uint16_t)(offsetof(DxbcProgramState, Temps) / sizeof(SimdFloat));
+static const uint16_t ScratchSlotBase = (uint16_t)(offsetof(DxbcProgramState, Scratch) / sizeof(SimdFloat));
+static const uint16_t ConstantSlotBase = (uint16_t)(offsetof(DxbcProgramState, Constants) / sizeof(SimdFloat));
+static const uint32_t NumSlots = ConstantSlotBase + DxbcMaxConstants;
+
+static const uint16_t LiteralConstantBuffer = 0xFFFF;
+
+//==============================================================================
+// Micro-ops
+//==============================================================================
+#define UNARY_OP(name, expr) \
+    static void name(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings&) \
+    { \
+        SimdFloat a = s[op.Src[0]]; \
+        s[op.Dst[0]] = (expr); \
+    }
+
+#define BINARY_OP(name, expr) \
+    static void name(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings&) \
+    { \
+        SimdFloat a = s[op.Src[0]]; \
+        SimdFloat b = s[op.Src[1]]; \
+        s[op.Dst[0]] = (expr); \
+    }
+
+#define TERNARY_OP(name, expr) \
+    static void name(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings&) \
+    { \
+        SimdFloat a = s[op.Src[0]]; \
+        SimdFloat b = s[op.Src[1]]; \
+        SimdFloat c = s[op.Src[2]]; \
+        s[op.Dst[0]] = (expr); \
+    }
+
+#define AS_INT(x) SimdAsInt(x)
+#define AS_FLOAT(x) SimdAsFloat(x)
+#define SHIFT(x) SimdAsInt(SimdAnd((x), SimdAsFloat(SimdIntSet(31))))
+
+static inline SimdFloat Utof(SimdFloat a)
+{
+    SimdInt lo = SimdAsInt(SimdAnd(a, SimdAsFloat(SimdIntSet(0xFFFF))));
+    SimdInt hi = SimdUintShr(SimdAsInt(a), SimdIntSet(16));
+    return SimdMad(SimdItof(hi), SimdSet(65536.f), SimdItof(lo));
+}
+
+static inline SimdFloat Ftou(SimdFloat a)
+{
+    SimdFloat clamped = SimdMax(a, SimdZero());
+    SimdFloat big = SimdCmpGe(clamped, SimdSet(2147483648.f));
+    SimdFloat biased = SimdSelect(big, SimdSub(clamped, SimdSet(2147483648.f)), clamped);
+    return SimdOr(SimdAsFloat(SimdFtoi(biased)), SimdAnd(big, SimdAsFloat(SimdIntSet((int32_t)0x80000000))));
+}
+
+UNARY_OP(OpMov, a)
+UNARY_OP(OpNeg, SimdNeg(a))
+UNARY_OP(OpAbs, SimdAbs(a))
+UNARY_OP(OpAbsNeg, SimdNeg(SimdAbs(a)))
+UNARY_OP(OpINeg, AS_FLOAT(SimdIntSub(SimdIntSet(0), AS_INT(a))))
+UNARY_OP(OpSat, SimdSaturate(a))
+UNARY_OP(OpFrc, SimdSub(a, SimdFloor(a)))
+UNARY_OP(OpRoundNe, SimdRoundNe(a))
+UNARY_OP(OpRoundNi, SimdFloor(a))
+UNARY_OP(OpRoundPi, SimdCeil(a))
+UNARY_OP(OpRoundZ, SimdTrunc(a))
+UNARY_OP(OpSqrt, SimdSqrt(a))
+UNARY_OP(OpRsq, SimdDiv(SimdSet(1.f), SimdSqrt(a)))
+UNARY_OP(OpExp, SimdPerLane(a, [](float f) { return exp2f(f); }))
+UNARY_OP(OpLog, SimdPerLane(a, [](float f) { return log2f(f); }))
+UNARY_OP(OpFtoi, AS_FLOAT(SimdFtoi(a)))
+UNARY_OP(OpFtou, Ftou(a))
+UNARY_OP(OpItof, SimdItof(AS_INT(a)))
+UNARY_OP(OpUtof, Utof(a))
+UNARY_OP(OpNot, SimdXor(a, SimdTrue()))
+
+BINARY_OP(OpAdd, SimdAdd(a, b))
+BINARY_OP(OpMul, SimdMul(a, b))
+BINARY_OP(OpDiv, SimdDiv(a, b))
+BINARY_OP(OpMin, SimdMin(a, b))
+BINARY_OP(OpMax, SimdMax(a, b))
+BINARY_OP(OpLt, SimdCmpLt(a, b))
+BINARY_OP(OpGe, SimdCmpGe(a, b))
+BINARY_OP(OpEq, SimdCmpEq(a, b))
+BINARY_OP(OpNe, SimdCmpNe(a, b))
+BINARY_OP(OpIAdd, AS_FLOAT(SimdIntAdd(AS_INT(a), AS_INT(b))))
+BINARY_OP(OpIMin, AS_FLOAT(SimdIntMin(AS_INT(a), AS_INT(b))))
+BINARY_OP(OpIMax, AS_FLOAT(SimdIntMax(AS_INT(a), AS_INT(b))))
+BINARY_OP(OpIShl, AS_FLOAT(SimdIntShl(AS_INT(a), SHIFT(b))))
+BINARY_OP(OpIShr, AS_FLOAT(SimdIntShr(AS_INT(a), SHIFT(b))))
+BINARY_OP(OpUShr, AS_FLOAT(SimdUintShr(AS_INT(a), SHIFT(b))))
+BINARY_OP(OpAnd, SimdAnd(a, b))
+BINARY_OP(OpOr, SimdOr(a, b))
+BINARY_OP(OpXor, SimdXor(a, b))
+BINARY_OP(OpIEq, AS_FLOAT(SimdIntCmpEq(AS_INT(a), AS_INT(b))))
+BINARY_OP(OpINe, SimdXor(AS_FLOAT(SimdIntCmpEq(AS_INT(a), AS_INT(b))), SimdTrue()))
+BINARY_OP(OpILt, AS_FLOAT(SimdIntCmpLt(AS_INT(a), AS_INT(b))))
+BINARY_OP(OpIGe, SimdXor(AS_FLOAT(SimdIntCmpLt(AS_INT(a), AS_INT(b))), SimdTrue()))
+
+TERNARY_OP(OpMad, SimdMad(a, b, c))
+TERNARY_OP(OpIMad, AS_FLOAT(SimdIntAdd(SimdIntMul(AS_INT(a), AS_INT(b)), AS_INT(c))))
+TERNARY_OP(OpMovc, SimdSelect(AS_FLOAT(SimdIntCmpEq(AS_INT(a), SimdIntSet(0))), c, b))
+
+static void OpLd(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings& bindings)
+{
+    SimdFloat texel[4];
+    const CpuTexture* texture = bindings.Resources[op.Resource];
+    if (texture)
+    {
+        CpuTextureLoad(*texture, SimdAsInt(s[op.Src[0]]), SimdAsInt(s[op.Src[1]]), texel);
+    }
+    else
+    {
+        texel[0] = texel[1] = texel[2] = texel[3] = SimdZero();
+    }
+
+    for (uint32_t i = 0; i < op.NumDst; ++i)
+    {
+        s[op.Dst[i]] = texel[op.Swizzle[i]];
+    }
+}
+
+static void OpSample(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings& bindings)
+{
+    SimdFloat texel[4];
+    const CpuTexture* texture = bindings.Resources[op.Resource];
+    const CpuSampler* sampler = bindings.Samplers[op.Sampler];
+    if (texture && sampler)
+    {
+        CpuTextureSample(*texture, *sampler, s[op.Src[0]], s[op.Src[1]], texel);
+    }
+    else
+    {
+        texel[0] = texel[1] = texel[2] = texel[3] = SimdZero();
+    }
+
+    for (uint32_t i = 0; i < op.NumDst; ++i)
+    {
+        s[op.Dst[i]] = texel[op.Swizzle[i]];
+    }
+}
+
+static void OpSampleLevel(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings& bindings)
+{
+    SimdFloat texel[4];
+    const CpuTexture* texture = bindings.Resources[op.Resource];
+    const CpuSampler* sampler = bindings.Samplers[op.Sampler];
+    if (texture && sampler)
+    {
+        CpuTextureSampleLevel(texture, DxbcResourceLevels(bindings, op.Resource), *sampler, s[op.Src[0]],
+            s[op.Src[1]], s[op.Src[2]], texel);
+    }
+    else
+    {
+        texel[0] = texel[1] = texel[2] = texel[3] = SimdZero();
+    }
+
+    for (uint32_t i = 0; i < op.NumDst; ++i)
+    {
+        s[op.Dst[i]] = texel[op.Swizzle[i]];
+    }
+}
+
+static void OpDiscardZ(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings&)
+{
+    SimdFloat zero = SimdAsFloat(SimdIntCmpEq(SimdAsInt(s[op.Src[0]]), SimdIntSet(0)));
+    s[op.Dst[0]] = SimdOr(s[op.Dst[0]], zero);
+}
+
+static void OpDiscardNZ(const DxbcMicroOp& op, SimdFloat* s, const DxbcBindings&)
+{
+    SimdFloat zero = SimdAsFloat(SimdIntCmpEq(SimdAsInt(s[op.Src[0]]), SimdIntSet(0)));
+    s[op.Dst[0]] = SimdOr(s[op.Dst[0]], SimdXor(zero, SimdTrue()));
+}
+
+#undef UNARY_OP
+#undef BINARY_OP
+#undef TERNARY_OP
+#undef AS_INT
+#undef AS_FLOAT
+#undef SHIFT
+
+static DxbcMicroOpFn AluFunction(DxbcOpcode opcode)
+{
+    switch (opcode)
+    {
+    case DxbcOpAdd: return OpAdd;
+    case DxbcOpAnd: return OpAnd;
+    case DxbcOpDiv: return OpDiv;
+    case DxbcOpEq: return OpEq;
+    case DxbcOpExp: return OpExp;
+    case DxbcOpFrc: return OpFrc;
+    case DxbcOpFtoi: return OpFtoi;
+    case DxbcOpFtou: return OpFtou;
+    case DxbcOpGe: return OpGe;
+    case DxbcOpIAdd: return OpIAdd;
+    case DxbcOpIEq: return OpIEq;
+    case DxbcOpIGe: return OpIGe;
+    case DxbcOpILt: return OpILt;
+    case DxbcOpIMad: return OpIMad;
+    case DxbcOpIMax: return OpIMax;
+    case DxbcOpIMin: return OpIMin;
+    case DxbcOpINe: return OpINe;
+    case DxbcOpINeg: return OpINeg;
+    case DxbcOpIShl: return OpIShl;
+    case DxbcOpIShr: return OpIShr;
+    case DxbcOpItof: return OpItof;
+    case DxbcOpLog: return OpLog;
+    case DxbcOpLt: return OpLt;
+    case DxbcOpMad: return OpMad;
+    case DxbcOpMin: return OpMin;
+    case DxbcOpMax: return OpMax;
+    case DxbcOpMovc: return OpMovc;
+    case DxbcOpMul: return OpMul;
+    case DxbcOpNe: return OpNe;
+    case DxbcOpNot: return OpNot;
+    case DxbcOpOr: return OpOr;
+    case DxbcOpRoundNe: return OpRoundNe;
+    case DxbcOpRoundNi: return OpRoundNi;
+    case DxbcOpRoundPi: return OpRoundPi;
+    case DxbcOpRoundZ: return OpRoundZ;
+    case DxbcOpRsq: return OpRsq;
+    case DxbcOpSqrt: return OpSqrt;
+    case DxbcOpUShr: return OpUShr;
+    case DxbcOpUtof: return OpUtof;
+    case DxbcOpXor: return OpXor;
+    default: return nullptr;
+    }
+}
+
+static uint32_t SourceCount(DxbcOpcode opcode)
+{
+    switch (opcode)
+    {
+    case DxbcOpMad:
+    case DxbcOpIMad:
+    case DxbcOpMovc:
+        return 3;
+
+    case DxbcOpExp: case DxbcOpFrc: case DxbcOpFtoi: case DxbcOpFtou:
+    case DxbcOpINeg: case DxbcOpItof: case DxbcOpLog: case DxbcOpNot:
+    case DxbcOpRoundNe: case DxbcOpRoundNi: case DxbcOpRoundPi: case DxbcOpRoundZ:
+    case DxbcOpRsq: case DxbcOpSqrt: case DxbcOpUtof:
+        return 1;
+
+    default:
+        return 2;
+    }
+}
+
+// Sources of these instructions are integers, so 'neg' is two's complement
+static bool IsIntegerOpcode(DxbcOpcode opcode)
+{
+    switch (opcode)
+    {
+    case DxbcOpAnd: case DxbcOpIAdd: case DxbcOpIEq: case DxbcOpIGe:
+    case DxbcOpILt: case DxbcOpIMad: case DxbcOpIMax: case DxbcOpIMin:
+    case DxbcOpINe: case DxbcOpINeg: case DxbcOpIShl: case DxbcOpIShr:
+    case DxbcOpItof: case DxbcOpNot: case DxbcOpOr: case DxbcOpUShr:
+    case DxbcOpUtof: case DxbcOpXor: case DxbcOpLd:
+        return true;
+    default:
+        return false;
+    }
+}
+
+//==============================================================================
+// Translation
+//==============================================================================
+struct Compiler
+{
+    DxbcProgram* Program;
+    uint16_t Alias[NumSlots];       // Slot currently holding each slot's value
+    uint32_t NumConstants;
+    uint32_t NumScratch;
+    DxbcOpcode Opcode;
+};
+
+static inline bool IsLiteral(const Compiler& c, uint16_t slot, uint32_t* bits)
+{
+    if (slot < ConstantSlotBase)
+    {
+        return false;
+    }
+
+    const auto& constant = c.Program->Constants[slot - ConstantSlotBase];
+    if (constant.ConstantBuffer != LiteralConstantBuffer)
+    {
+        return false;
+    }
+
+    *bits = constant.Value;
+    return true;
+}
+
+static bool ConstantSlot(Compiler* c, uint16_t constantBuffer, uint32_t value, uint16_t* slot)
+{
+    for (const auto& constant : c->Program->Constants)
+    {
+        if (constant.ConstantBuffer == constantBuffer && constant.Value == value)
+        {
+            *slot = constant.Slot;
+            return true;
+        }
+    }
+
+    if (c->NumConstants == DxbcMaxConstants)
+    {
+        return false;
+    }
+
+    DxbcConstantSlot constant;
+    constant.Slot = (uint16_t)(ConstantSlotBase + c->NumConstants++);
+    constant.ConstantBuffer = constantBuffer;
+    constant.Value = value;
+    c->Program->Constants.push_back(constant);
+
+    *slot = constant.Slot;
+    return true;
+}
+
+static inline void EmitMov(Compiler* c, uint16_t dst, uint16_t src)
+{
+    DxbcMicroOp op{};
+    op.Fn = OpMov;
+    op.Dst[0] = dst;
+    op.NumDst = 1;
+    op.Src[0] = src;
+    op.NumSrc = 1;
+    op.Opcode = DxbcOpMov;
+    c->Program->Ops.push_back(op);
+}
+
+// Called before 'slot' is overwritten. Any slot still sharing its value gets
+// its own copy first.
+static void PrepareWrite(Compiler* c, uint16_t slot)
+{
+    for (uint32_t s = 0; s < NumSlots; ++s)
+    {
+        if (s != slot && c->Alias[s] == slot)
+        {
+            EmitMov(c, (uint16_t)s, slot);
+            c->Alias[s] = (uint16_t)s;
+        }
+    }
+    c->Alias[slot] = slot;
+}
+
+static void Emit(Compiler* c, const DxbcMicroOp& op)
+{
+    for (uint32_t i = 0; i < op.NumDst; ++i)
+    {
+        PrepareWrite(c, op.Dst[i]);
+    }
+    c->Program->Ops.push_back(op);
+}
+
+// Records that 'dst' now holds the value in 'src' without emitting a move
+static void SetAlias(Compiler* c, uint16_t dst, uint16_t src)
+{
+    uint16_t resolved = c->Alias[src];
+    PrepareWrite(c, dst);
+    c->Alias[dst] = resolved == dst ? dst : resolved;
+}
+
+static bool AllocScratch(Compiler* c, uint16_t* slot)
+{
+    if (c->NumScratch == DxbcMaxScratch)
+    {
+        return false;
+    }
+    *slot = (uint16_t)(ScratchSlotBase + c->NumScratch++);
+    return true;
+}
+
+// Emits a single-destination ALU op, folding it to a literal when every source
+// is a literal
+static bool EmitAlu(Compiler* c, DxbcMicroOpFn fn, uint16_t dst, const uint16_t* src, uint32_t numSrc)
+{
+    DxbcMicroOp op{};
+    op.Fn = fn;
+    op.Dst[0] = dst;
+    op.NumDst = 1;
+    op.NumSrc = (uint8_t)numSrc;
+    op.Opcode = c->Opcode;
+
+    bool foldable = true;
+    SimdFloat values[4];
+    for (uint32_t i = 0; i < numSrc; ++i)
+    {
+        op.Src[i] = src[i];
+
+        uint32_t bits;
+        if (!IsLiteral(*c, src[i], &bits))
+        {
+            foldable = false;
+            continue;
+        }
+        values[i] = SimdAsFloat(SimdIntSet((int32_t)bits));
+    }
+
+    if (!foldable)
+    {
+        Emit(c, op);
+        return true;
+    }
+
+    DxbcMicroOp folded = op;
+    DxbcBindings noBindings{};
+    for (uint32_t i = 0; i < numSrc; ++i)
+    {
+        folded.Src[i] = (uint16_t)i;
+    }
+    folded.Dst[0] = 3;
+    fn(folded, values, noBindings);
+
+    alignas(32) int32_t result[SimdWidth];
+    SimdIntStore(result, SimdAsInt(values[3]));
+
+    uint16_t literal;
+    if (!ConstantSlot(c, LiteralConstantBuffer, (uint32_t)result[0], &literal))
+    {
+        return false;
+    }
+
+    SetAlias(c, dst, literal);
+    return true;
+}
+
+static bool SourceSlot(Compiler* c, const DxbcOperand& operand, uint32_t component, bool integer, uint16_t* slot)
+{
+    uint32_t swizzled = operand.Swizzle[component];
+
+    switch (operand.Type)
+    {
+    case DxbcOperandType::Immediate32:
+        if (!ConstantSlot(c, LiteralConstantBuffer, operand.Immediate[swizzled], slot))
+        {
+            return false;
+        }
+        break;
+
+    case DxbcOperandType::ConstantBuffer:
+        if (!ConstantSlot(c, (uint16_t)operand.Index[0], operand.Index[1] * 4 + swizzled, slot))
+        {
+            return false;
+        }
+        break;
+
+    case DxbcOperandType::Temp:
+        *slot = c->Alias[TempSlotBase + operand.Index[0] * 4 + swizzled];
+        break;
+
+    case DxbcOperandType::Input:
+        *slot = c->Alias[InputSlotBase + operand.Index[0] * 4 + swizzled];
+        break;
+
+    case DxbcOperandType::Output:
+        *slot = c->Alias[OutputSlotBase + operand.Index[0] * 4 + swizzled];
+        break;
+
+    default:
+        return false;
+    }
+
+    if (operand.Modifier == DxbcModifierNone)
+    {
+        return true;
+    }
+
+    DxbcMicroOpFn fn = nullptr;
+    if (integer)
+    {
+        fn = (operand.Modifier & DxbcModifierNeg) ? OpINeg : nullptr;
+    }
+    else
+    {
+        switch (operand.Modifier)
+        {
+        case DxbcModifierNeg: fn = OpNeg; break;
+        case DxbcModifierAbs: fn = OpAbs; break;
+        case DxbcModifierAbsNeg: fn = OpAbsNeg; break;
+        default: break;
+        }
+    }
+
+    if (!fn)
+    {
+        return true;
+    }
+
+    uint16_t scratch;
+    if (!AllocScratch(c, &scratch) || !EmitAlu(c, fn, scratch, slot, 1))
+    {
+        return false;
+    }
+    *slot = c->Alias[scratch];
+    return true;
+}
+
+static bool DestSlot(const DxbcOperand& operand, uint32_t component, uint16_t* slot)
+{
+    switch (operand.Type)
+    {
+    case DxbcOperandType::Temp:
+        *slot = (uint16_t)(TempSlotBase + operand.Index[0] * 4 + component);
+        return true;
+
+    case DxbcOperandType::Output:
+        *slot = (uint16_t)(OutputSlotBase + operand.Index[0] * 4 + component);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static bool CompileInstruction(Compiler* c, const DxbcInstruction& instruction)
+{
+    const DxbcOperand* ops = instruction.Operands;
+    const DxbcOperand& dest = ops[0];
+    c->Opcode = instruction.Opcode;
+    c->NumScratch = 0;
+
+    switch (instruction.Opcode)
+    {
+    case DxbcOpNop:
+    case DxbcOpRet:
+        return true;
+
+    case DxbcOpDiscard:
+    {
+        uint16_t cond;
+        if (!SourceSlot(c, ops[0], 0, true, &cond))
+        {
+            return false;
+        }
+
+        DxbcMicroOp op{};
+        op.Fn = instruction.TestNonZero ? OpDiscardNZ : OpDiscardZ;
+        op.Dst[0] = DiscardedSlot;
+        op.NumDst = 1;
+        op.Src[0] = cond;
+        op.Src[1] = DiscardedSlot;
+        op.NumSrc = 2;
+        op.Opcode = instruction.Opcode;
+        Emit(c, op);
+        return true;
+    }
+
+    case DxbcOpLd:
+    case DxbcOpSample:
+    case DxbcOpSampleL:
+    {
+        if (dest.Type == DxbcOperandType::Null)
+        {
+            return true;
+        }
+
+        DxbcMicroOp op{};
+        op.Fn = instruction.Opcode == DxbcOpLd ? OpLd : instruction.Opcode == DxbcOpSampleL ? OpSampleLevel : OpSample;
+        op.Opcode = instruction.Opcode;
+        op.Resource = (uint8_t)ops[2].Index[0];
+        op.Sampler = instruction.Opcode == DxbcOpLd ? 0 : (uint8_t)ops[3].Index[0];
+        op.NumSrc = 2;
+        if (!SourceSlot(c, ops[1], 0, instruction.Opcode == DxbcOpLd, &op.Src[0]) ||
+            !SourceSlot(c, ops[1], 1, instruction.Opcode == DxbcOpLd, &op.Src[1]))
+        {
+            return false;
+        }
+        if (instruction.Opcode == DxbcOpSampleL)
+        {
+            op.NumSrc = 3;
+            if (!SourceSlot(c, ops[4], 0, false, &op.Src[2]))
+            {
+                return false;
+            }
+        }
+
+        for (uint32_t comp = 0; comp < 4; ++comp)
+        {
+            if (!(dest.Mask & (1 << comp)))
+            {
+                continue;
+            }
+            if (!DestSlot(dest, comp, &op.Dst[op.NumDst]))
+            {
+                return false;
+            }
+            op.Swizzle[op.NumDst++] = ops[2].Swizzle[comp];
+        }
+
+        Emit(c, op);
+
+        if (instruction.Saturate)
+        {
+            for (uint32_t i = 0; i < op.NumDst; ++i)
+            {
+                if (!EmitAlu(c, OpSat, op.Dst[i], &op.Dst[i], 1))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    case DxbcOpDp2:
+    case DxbcOpDp3:
+    case DxbcOpDp4:
+    {
+        if (dest.Type == DxbcOperandType::Null)
+        {
+            return true;
+        }
+
+        uint32_t count = instruction.Opcode - DxbcOpDp2 + 2;
+        uint16_t a[4], b[4];
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (!SourceSlot(c, ops[1], i, false, &a[i]) || !SourceSlot(c, ops[2], i, false, &b[i]))
+            {
+                return false;
+            }
+        }
+
+        uint16_t sum;
+        if (!AllocScratch(c, &sum))
+        {
+            return false;
+        }
+
+        uint16_t src[3] = { a[0], b[0], 0 };
+        if (!EmitAlu(c, OpMul, sum, src, 2))
+        {
+            return false;
+        }
+        for (uint32_t i = 1; i < count; ++i)
+        {
+            src[0] = a[i];
+            src[1] = b[i];
+            src[2] = c->Alias[sum];
+            uint16_t next;
+            if (!AllocScratch(c, &next) || !EmitAlu(c, OpMad, next, src, 3))
+            {
+                return false;
+            }
+            sum = next;
+        }
+
+        if (instruction.Saturate)
+        {
+            uint16_t saturated;
+            uint16_t value = c->Alias[sum];
+            if (!AllocScratch(c, &saturated) || !EmitAlu(c, OpSat, saturated, &value, 1))
+            {
+                return false;
+            }
+            sum = saturated;
+        }
+
+        for (uint32_t comp = 0; comp < 4; ++comp)
+        {
+            uint16_t slot;
+            if ((dest.Mask & (1 << comp)) && DestSlot(dest, comp, &slot))
+            {
+                SetAlias(c, slot, sum);
+            }
+        }
+        return true;
+    }
+
+    default:
+        break;
+    }
+
+    // Component-wise instructions
+    if (dest.Type == DxbcOperandType::Null)
+    {
+        return true;
+    }
+
+    bool isMov = instruction.Opcode == DxbcOpMov;
+    DxbcMicroOpFn fn = isMov ? OpMov : AluFunction(instruction.Opcode);
+    if (!fn)
+    {
+        return false;
+    }
+
+    uint32_t numSrc = isMov ? 1 : SourceCount(instruction.Opcode);
+    bool integer = IsIntegerOpcode(instruction.Opcode);
+
+    uint16_t src[4][3];
+    uint16_t dst[4];
+    for (uint32_t comp = 0; comp < 4; ++comp)
+    {
+        if (!(dest.Mask & (1 << comp)))
+        {
+            continue;
+        }
+        if (!DestSlot(dest, comp, &dst[comp]))
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < numSrc; ++i)
+        {
+            // movc's condition is an integer test even though its values aren't
+            bool integerSource = integer || (instruction.Opcode == DxbcOpMovc && i == 0);
+            if (!SourceSlot(c, ops[i + 1], comp, integerSource, &src[comp][i]))
+            {
+                return false;
+            }
+        }
+    }
+
+    // If a later component reads a register an earlier one writes, results go
+    // through scratch slots first
+    bool hazard = false;
+    for (uint32_t comp = 0; comp < 4; ++comp)
+    {
+        for (uint32_t other = 0; other < 4 && (dest.Mask & (1 << comp)); ++other)
+        {
+            if (!(dest.Mask & (1 << other)))
+            {
+                continue;
+            }
+            for (uint32_t i = 0; i < numSrc; ++i)
+            {
+                if (src[other][i] == dst[comp])
+                {
+                    hazard = true;
+                }
+            }
+        }
+    }
+
+    uint16_t result[4];
+    for (uint32_t comp = 0; comp < 4; ++comp)
+    {
+        if (!(dest.Mask & (1 << comp)))
+        {
+            continue;
+        }
+
+        if (hazard || instruction.Saturate)
+        {
+            if (!AllocScratch(c, &result[comp]))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            result[comp] = dst[comp];
+        }
+
+        if (isMov)
+        {
+            SetAlias(c, result[comp], src[comp][0]);
+        }
+        else if (!EmitAlu(c, fn, result[comp], src[comp], numSrc))
+        {
+            return false;
+        }
+
+        if (instruction.Saturate)
+        {
+            uint16_t value = c->Alias[result[comp]];
+            uint16_t saturated;
+            if (!AllocScratch(c, &saturated) || !EmitAlu(c, OpSat, saturated, &value, 1))
+            {
+                return false;
+            }
+            result[comp] = saturated;
+        }
+    }
+
+    if (hazard || instruction.Saturate)
+    {
+        for (uint32_t comp = 0; comp < 4; ++comp)
+        {
+            if (dest.Mask & (1 << comp))
+            {
+                SetAlias(c, dst[comp], result[comp]);
+            }
+        }
+    }
+
+    return true;
+}
+
+// Gives every slot whose value lives in the given range its own copy
+static void Materialize(Compiler* c, uint32_t begin, uint32_t end)
+{
+    for (uint32_t s = 0; s < NumSlots; ++s)
+    {
+        uint16_t alias = c->Alias[s];
+        if (alias != s && alias >= begin && alias < end)
+        {
+            EmitMov(c, (uint16_t)s, alias);
+            c->Alias[s] = (uint16_t)s;
+        }
+    }
+}
+
+static void MaterializeOutputs(Compiler* c)
+{
+    for (uint32_t s = OutputSlotBase; s < OutputSlotBase + DxbcMaxRegisters * 4; ++s)
+    {
+        if (c->Alias[s] != s)
+        {
+            EmitMov(c, (uint16_t)s, c->Alias[s]);
+            c->Alias[s] = (uint16_t)s;
+        }
+    }
+}
+
+static void EliminateDeadCode(DxbcProgram* program)
+{
+    std::vector<bool> live(NumSlots, false);
+    for (uint32_t s = OutputSlotBase; s < OutputSlotBase + DxbcMaxRegisters * 4; ++s)
+    {
+        live[s] = true;
+    }
+    live[DiscardedSlot] = true;
+
+    std::vector<DxbcMicroOp> kept;
+    for (size_t i = program->Ops.size(); i-- > 0;)
+    {
+        const DxbcMicroOp& op = program->Ops[i];
+
+        bool needed = op.Opcode == DxbcOpDiscard;
+        for (uint32_t d = 0; d < op.NumDst && !needed; ++d)
+        {
+            needed = live[op.Dst[d]];
+        }
+        if (!needed)
+        {
+            continue;
+        }
+
+        for (uint32_t d = 0; d < op.NumDst; ++d)
+        {
+            live[op.Dst[d]] = false;
+        }
+        for (uint32_t s = 0; s < op.NumSrc; ++s)
+        {
+            live[op.Src[s]] = true;
+        }
+        kept.push_back(op);
+    }
+
+    program->Ops.assign(kept.rbegin(), kept.rend());
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool DxbcCompile(const DxbcShader& shader, DxbcProgram* program)
+{
+    std::unique_ptr<Compiler> c(new Compiler());
+    c->Program = program;
+    c->NumConstants = 0;
+    for (uint32_t s = 0; s < NumSlots; ++s)
+    {
+        c->Alias[s] = (uint16_t)s;
+    }
+
+    program->Ops.clear();
+    program->Constants.clear();
+    program->SourceInstructionCount = (uint32_t)shader.Instructions.size();
+
+    for (const auto& instruction : shader.Instructions)
+    {
+        if (instruction.Opcode == DxbcOpRet)
+        {
+            break;
+        }
+
+        if (!CompileInstruction(c.get(), instruction))
+        {
+            return false;
+        }
+
+        // Scratch slots are reused by the next instruction
+        Materialize(c.get(), ScratchSlotBase, ScratchSlotBase + DxbcMaxScratch);
+    }
+
+    MaterializeOutputs(c.get());
+    EliminateDeadCode(program);
+    return true;
+}
+
+//==============================================================================
+uint64_t DxbcHashBytecode(const void* bytecode, size_t size)
+{
+    // FNV-1a
+    const uint8_t* p = (const uint8_t*)bytecode;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//==============================================================================
+const DxbcProgram* DxbcCompileCached(const void* bytecode, size_t size)
+{
+    static std::mutex lock;
+    static std::unordered_map<uint64_t, std::unique_ptr<DxbcProgram>> cache;
+
+    uint64_t hash = DxbcHashBytecode(bytecode, size);
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = cache.find(hash);
+    if (it != cache.end())
+    {
+        return it->second.get();
+    }
+
+    DxbcShader shader;
+    std::unique_ptr<DxbcProgram> program(new DxbcProgram());
+    if (!DxbcParse(bytecode, size, &shader) || !DxbcCompile(shader, program.get()))
+    {
+        // Remember the failure so it isn't retried every call
+        cache[hash] = nullptr;
+        return nullptr;
+    }
+
+    program->Hash = hash;
+    const DxbcProgram* result = program.get();
+    cache[hash] = std::move(program);
+    return result;
+}
+
+//==============================================================================
+void DxbcProgramBind(const DxbcProgram& program, const DxbcBindings& bindings, DxbcProgramState* state)
+{
+    state->Bindings = &bindings;
+    for (const auto& constant : program.Constants)
+    {
+        SimdFloat* slot = (SimdFloat*)state + constant.Slot;
+        if (constant.ConstantBuffer == LiteralConstantBuffer)
+        {
+            *slot = SimdAsFloat(SimdIntSet((int32_t)constant.Value));
+        }
+        else
+        {
+            *slot = SimdSet(bindings.ConstantBuffers[constant.ConstantBuffer][constant.Value]);
+        }
+    }
+}
+
+//==============================================================================
+void DxbcProgramExecute(const DxbcProgram& program, DxbcProgramState* state, DxbcProfile* profile)
+{
+    auto start = profile ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+    SimdFloat* slots = (SimdFloat*)state;
+    const DxbcBindings& bindings = *state->Bindings;
+    state->Lanes.Discarded = SimdZero();
+
+    for (const auto& op : program.Ops)
+    {
+        op.Fn(op, slots, bindings);
+    }
+
+    if (profile)
+    {
+        for (const auto& op : program.Ops)
+        {
+            ++profile->OpcodeCounts[op.Opcode];
+        }
+        profile->Invocations += SimdWidth;
+        ++profile->Batches;
+        profile->Nanoseconds += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+}
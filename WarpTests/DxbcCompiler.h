@@ -0,0 +1,85 @@
+//==============================================================================
+// Translates parsed DXBC into a flat stream of SIMD micro-ops with all operand
+// decoding, swizzles and modifiers resolved ahead of time. Constant folding,
+// copy propagation and dead code elimination run during translation, which
+// removes most of the redundant work in skipOptimization shader builds.
+//
+// Compiled programs are cached by a hash of their bytecode, so each embedded
+// blob is only translated once per process.
+//==============================================================================
+#pragma once
+
+#include "Dxbc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t DxbcMaxScratch = 32;
+static const uint32_t DxbcMaxConstants = 256;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct DxbcMicroOp;
+
+// Every value a program touches lives in one flat array of SIMD slots. The
+// lanes come first so the rasterizer can fill inputs and read outputs in place.
+struct DxbcProgramState
+{
+    DxbcLanes Lanes;
+    SimdFloat Temps[DxbcMaxRegisters * 4];
+    SimdFloat Scratch[DxbcMaxScratch];
+    SimdFloat Constants[DxbcMaxConstants];
+    const DxbcBindings* Bindings;
+};
+
+typedef void (*DxbcMicroOpFn)(const DxbcMicroOp& op, SimdFloat* slots, const DxbcBindings& bindings);
+
+struct DxbcMicroOp
+{
+    DxbcMicroOpFn Fn;
+    uint16_t Dst[4];
+    uint16_t Src[3];
+    uint8_t NumDst;
+    uint8_t NumSrc;
+    uint8_t Resource;
+    uint8_t Sampler;
+    uint8_t Swizzle[4];     // Texel component written to each Dst
+    DxbcOpcode Opcode;      // Source instruction, for profiling
+};
+
+// Constant slot initialized from a literal or a constant buffer element
+struct DxbcConstantSlot
+{
+    uint16_t Slot;
+    uint16_t ConstantBuffer;    // 0xFFFF for literals
+    uint32_t Value;             // Literal bits, or float offset into the constant buffer
+};
+
+struct DxbcProgram
+{
+    std::vector<DxbcMicroOp> Ops;
+    std::vector<DxbcConstantSlot> Constants;
+    uint64_t Hash;
+    uint32_t SourceInstructionCount;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool DxbcCompile(const DxbcShader& shader, DxbcProgram* program);
+
+// Parses and compiles the bytecode, or returns the cached program for
+// identical bytecode. Returns null if the shader can't be compiled.
+const DxbcProgram* DxbcCompileCached(const void* bytecode, size_t size);
+
+uint64_t DxbcHashBytecode(const void* bytecode, size_t size);
+
+// Splats literals and constant buffer values into the state. Call once per
+// draw, after which DxbcProgramExecute can be called for any number of batches.
+void DxbcProgramBind(const DxbcProgram& program, const DxbcBindings& bindings, DxbcProgramState* state);
+
+void DxbcProgramExecute(const DxbcProgram& program, DxbcProgramState* state, DxbcProfile* profile);
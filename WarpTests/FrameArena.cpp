@@ -0,0 +1,176 @@
+//==============================================================================
+#include "FrameArena.h"
+#include <assert.h>
+#include <new>
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// Freed as the thread exits
+struct ThreadArenaState
+{
+    ~ThreadArenaState()
+    {
+        ArenaDestroy(&Own);
+    }
+
+    Arena Own{};
+    Arena* Bound = nullptr;
+};
+
+//==============================================================================
+// Globals
+//==============================================================================
+static thread_local ThreadArenaState ThreadState;
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool ArenaCreate(size_t capacity, Arena* arena)
+{
+    *arena = Arena{};
+    uint8_t* allocation = new (std::nothrow) uint8_t[capacity + ArenaMaxAlignment - 1];
+    if (!allocation)
+    {
+        return false;
+    }
+    arena->Allocation = allocation;
+    arena->Memory = (uint8_t*)(((uintptr_t)allocation + ArenaMaxAlignment - 1) & ~(uintptr_t)(ArenaMaxAlignment - 1));
+    arena->Capacity = capacity;
+    return true;
+}
+
+//==============================================================================
+void ArenaDestroy(Arena* arena)
+{
+    delete[] arena->Allocation;
+    *arena = Arena{};
+}
+
+//==============================================================================
+void* ArenaAlloc(Arena* arena, size_t bytes, size_t alignment)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > ArenaMaxAlignment)
+    {
+        assert(false);
+        return nullptr;
+    }
+
+    size_t offset = (arena->Used + alignment - 1) & ~(alignment - 1);
+    if (offset > arena->Capacity || bytes > arena->Capacity - offset)
+    {
+        ++arena->Overflows;
+        return nullptr;
+    }
+
+    arena->Used = offset + bytes;
+    arena->Peak = (arena->Used > arena->Peak) ? arena->Used : arena->Peak;
+    return arena->Memory + offset;
+}
+
+//==============================================================================
+void ArenaRewind(Arena* arena, size_t mark)
+{
+    assert(mark <= arena->Used);
+    arena->Used = mark;
+}
+
+//==============================================================================
+void ArenaReset(Arena* arena)
+{
+    arena->Used = 0;
+    arena->Peak = 0;
+}
+
+//==============================================================================
+ArenaScope::ArenaScope(Arena* arena) : Scoped(arena), Mark(arena->Used)
+{
+}
+
+ArenaScope::~ArenaScope()
+{
+    ArenaRewind(Scoped, Mark);
+}
+
+//==============================================================================
+bool FrameArenaCreate(size_t capacity, uint32_t numFrames, FrameArena* frames)
+{
+    *frames = FrameArena{};
+    if (numFrames == 0 || numFrames > FrameArenaMaxFrames)
+    {
+        assert(false);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numFrames; ++i)
+    {
+        if (!ArenaCreate(capacity, &frames->Frames[i]))
+        {
+            FrameArenaDestroy(frames);
+            return false;
+        }
+    }
+    frames->NumFrames = numFrames;
+    return true;
+}
+
+//==============================================================================
+void FrameArenaDestroy(FrameArena* frames)
+{
+    for (Arena& arena : frames->Frames)
+    {
+        ArenaDestroy(&arena);
+    }
+    *frames = FrameArena{};
+}
+
+//==============================================================================
+Arena* FrameArenaBegin(FrameArena* frames, uint64_t frameIndex)
+{
+    const Arena& finished = frames->Frames[frames->Current];
+    frames->MaxPeak = (finished.Peak > frames->MaxPeak) ? finished.Peak : frames->MaxPeak;
+
+    frames->Current = (uint32_t)(frameIndex % frames->NumFrames);
+    Arena* arena = &frames->Frames[frames->Current];
+    ArenaReset(arena);
+    return arena;
+}
+
+//==============================================================================
+void FrameArenaGetStats(const FrameArena& frames, FrameArenaStats* stats)
+{
+    const Arena& current = frames.Frames[frames.Current];
+    *stats = FrameArenaStats{};
+    stats->Capacity = current.Capacity;
+    stats->Peak = current.Peak;
+    stats->MaxPeak = frames.MaxPeak;
+    for (uint32_t i = 0; i < frames.NumFrames; ++i)
+    {
+        stats->Overflows += frames.Frames[i].Overflows;
+    }
+}
+
+//==============================================================================
+Arena* ThreadArena()
+{
+    ThreadArenaState& state = ThreadState;
+    if (state.Bound)
+    {
+        return state.Bound;
+    }
+    if (!state.Own.Memory && !ArenaCreate(ThreadArenaCapacity, &state.Own))
+    {
+        assert(false);
+        return nullptr;
+    }
+    return &state.Own;
+}
+
+//==============================================================================
+Arena* ThreadArenaBind(Arena* arena)
+{
+    Arena* previous = ThreadState.Bound;
+    ThreadState.Bound = arena;
+    return previous;
+}
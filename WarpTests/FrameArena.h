@@ -0,0 +1,120 @@
+//==============================================================================
+// Linear arenas for transient CPU memory, so steady-state frames make no heap
+// allocations. An Arena is one fixed block handed out front to back, where an
+// allocation is an aligned bump of an offset and nothing is freed on its own:
+// the arena is rewound to an earlier mark (ArenaScope) or reset as a whole.
+//
+// - FrameArena rotates a few arenas by frame index and resets one as its
+//   frame begins, so what a frame allocates stays valid for the frames after
+//   it, up to the number of arenas, for consumers that read it late.
+// - ThreadArena is the calling thread's scratch for work inside a call, such
+//   as a draw or a file write. Each thread gets its own the first time it
+//   asks, or one bound with ThreadArenaBind, such as the render thread's
+//   current frame arena.
+//
+// An allocation that doesn't fit returns null and is counted, never taken
+// from the heap instead, so the peaks say how big an arena has to be.
+//==============================================================================
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Largest alignment an arena hands out, and of its memory
+static const size_t ArenaMaxAlignment = 64;
+
+static const uint32_t FrameArenaMaxFrames = 3;
+
+// Each thread's own ThreadArena
+static const size_t ThreadArenaCapacity = 4 << 20;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct Arena
+{
+    uint8_t* Allocation;    // As allocated, Memory is within it
+    uint8_t* Memory;
+    size_t Capacity;
+    size_t Used;
+    size_t Peak;            // Most Used since created or reset
+    uint32_t Overflows;     // Allocations that didn't fit, since created
+};
+
+// Rewinds 'arena' to where it was when constructed
+struct ArenaScope
+{
+    explicit ArenaScope(Arena* arena);
+    ~ArenaScope();
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    Arena* Scoped;
+    size_t Mark;
+};
+
+struct FrameArena
+{
+    Arena Frames[FrameArenaMaxFrames];
+    uint32_t NumFrames;
+    uint32_t Current;       // Index into Frames
+    size_t MaxPeak;         // Over every frame finished
+};
+
+struct FrameArenaStats
+{
+    size_t Capacity;        // Of each frame
+    size_t Peak;            // Of the current frame so far
+    size_t MaxPeak;         // Of every frame before it
+    uint32_t Overflows;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool ArenaCreate(size_t capacity, Arena* arena);
+void ArenaDestroy(Arena* arena);
+
+// 'bytes' aligned to 'alignment', a power of two up to ArenaMaxAlignment. Null
+// if it doesn't fit.
+void* ArenaAlloc(Arena* arena, size_t bytes, size_t alignment);
+
+// Uninitialized, for trivially constructible types
+template <typename T>
+T* ArenaAllocArray(Arena* arena, size_t count)
+{
+    return (T*)ArenaAlloc(arena, count * sizeof(T), alignof(T));
+}
+
+// Frees everything allocated since 'arena' had 'mark' bytes used
+void ArenaRewind(Arena* arena, size_t mark);
+
+// Frees everything and starts a new peak
+void ArenaReset(Arena* arena);
+
+// 'numFrames' arenas of 'capacity' bytes, up to FrameArenaMaxFrames
+bool FrameArenaCreate(size_t capacity, uint32_t numFrames, FrameArena* frames);
+void FrameArenaDestroy(FrameArena* frames);
+
+// Finishes the current frame and resets the arena of 'frameIndex', whatever
+// was allocated numFrames frames ago, for the frame beginning
+Arena* FrameArenaBegin(FrameArena* frames, uint64_t frameIndex);
+
+inline Arena* FrameArenaCurrent(FrameArena* frames)
+{
+    return &frames->Frames[frames->Current];
+}
+
+void FrameArenaGetStats(const FrameArena& frames, FrameArenaStats* stats);
+
+// The calling thread's bound arena, or its own, created on first use. Null if
+// that fails.
+Arena* ThreadArena();
+
+// Binds 'arena' as the calling thread's ThreadArena, or its own again for
+// null, and returns the one bound before
+Arena* ThreadArenaBind(Arena* arena);
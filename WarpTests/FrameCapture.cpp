@@ -0,0 +1,281 @@
+//==============================================================================
+#include "FrameCapture.h"
+#include "ImageFile.h"
+#include "TextureFile.h"
+#include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class CaptureSlotState
+{
+    Free,
+    Copied,     // Copy started on the GPU
+    Mapped,     // Waiting for the encoder
+    Writing,
+    Written,    // Or failed, waiting to be unmapped
+};
+
+// One frame's readback memory. Only the thread its state names touches it,
+// and handing it on goes through the queue's mutex.
+struct CaptureSlot
+{
+    CaptureSlotState State;
+    uint32_t Frame;         // Update the copy started in
+    uint64_t Sequence;      // Capture order
+    CaptureFileFormat Format;
+    char Filename[FrameCaptureMaxFilename];
+    CpuTexture Image;       // The mapping
+};
+
+struct FrameCaptureQueue
+{
+    FrameReadback Readback;
+    uint32_t Latency;
+    std::thread Encoder;
+
+    std::mutex Mutex;
+    std::condition_variable WorkReady;
+    std::condition_variable WriteDone;
+    bool Exiting = false;
+
+    std::vector<CaptureSlot> Slots;
+    uint32_t Frame = 0;
+    uint64_t NextSequence = 0;
+    FrameCaptureStats Stats{};
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static bool WriteFrame(const CaptureSlot& slot)
+{
+    switch (slot.Format)
+    {
+    case CaptureFileFormat::Png:
+        return ImageFileWritePng(slot.Filename, slot.Image);
+    case CaptureFileFormat::Exr:
+        return ImageFileWriteExr(slot.Filename, slot.Image);
+    case CaptureFileFormat::Raw:
+        return TextureFileWrite(slot.Filename, &slot.Image, 1, 1);
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+// Under the mutex. The mapped slot captured first, or null for none.
+static CaptureSlot* NextMapped(FrameCaptureQueue* queue)
+{
+    CaptureSlot* next = nullptr;
+    for (CaptureSlot& slot : queue->Slots)
+    {
+        if (slot.State == CaptureSlotState::Mapped && (!next || slot.Sequence < next->Sequence))
+        {
+            next = &slot;
+        }
+    }
+    return next;
+}
+
+static void EncoderThread(FrameCaptureQueue* queue)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    std::unique_lock<std::mutex> lock(queue->Mutex);
+    for (;;)
+    {
+        CaptureSlot* slot = nullptr;
+        queue->WorkReady.wait(lock, [&]() { return (slot = NextMapped(queue)) != nullptr || queue->Exiting; });
+        if (!slot)
+        {
+            return;
+        }
+
+        slot->State = CaptureSlotState::Writing;
+        lock.unlock();
+        auto start = Clock::now();
+        bool written = WriteFrame(*slot);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        lock.lock();
+
+        slot->State = CaptureSlotState::Written;
+        --queue->Stats.Pending;
+        if (written)
+        {
+            ++queue->Stats.Written;
+            queue->Stats.BytesWritten += CpuFormatImageBytes(slot->Image.Format, slot->Image.Width, slot->Image.Height);
+            queue->Stats.WriteMs += ms;
+        }
+        else
+        {
+            ++queue->Stats.Failed;
+        }
+        queue->WriteDone.notify_all();
+    }
+}
+
+// Under the mutex. Maps copied slots, those at least 'latency' updates old
+// unless waiting, and unmaps written ones.
+static void UpdateSlots(FrameCaptureQueue* queue, bool wait)
+{
+    const FrameReadback& readback = queue->Readback;
+    bool mapped = false;
+    for (uint32_t i = 0; i < (uint32_t)queue->Slots.size(); ++i)
+    {
+        CaptureSlot& slot = queue->Slots[i];
+        if (slot.State == CaptureSlotState::Written)
+        {
+            readback.Unmap(readback.Context, i);
+            slot.State = CaptureSlotState::Free;
+        }
+        else if (slot.State == CaptureSlotState::Copied && (wait || queue->Frame - slot.Frame >= queue->Latency))
+        {
+            if (readback.Map(readback.Context, i, wait, &slot.Image))
+            {
+                slot.State = CaptureSlotState::Mapped;
+                mapped = true;
+            }
+            else if (wait)
+            {
+                // Waiting, only a failure gets here
+                slot.State = CaptureSlotState::Free;
+                --queue->Stats.Pending;
+                ++queue->Stats.Failed;
+            }
+        }
+    }
+    if (mapped)
+    {
+        queue->WorkReady.notify_one();
+    }
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+bool FrameCaptureCreate(uint32_t numSlots, uint32_t latency, const FrameReadback& readback, FrameCapture* capture)
+{
+    capture->Queue = nullptr;
+    if (numSlots == 0)
+    {
+        assert(false);
+        return false;
+    }
+
+    FrameCaptureQueue* queue = new FrameCaptureQueue;
+    queue->Readback = readback;
+    queue->Latency = latency;
+    queue->Slots.resize(numSlots, CaptureSlot{});
+    queue->Encoder = std::thread(EncoderThread, queue);
+    capture->Queue = queue;
+    return true;
+}
+
+//==============================================================================
+void FrameCaptureDestroy(FrameCapture* capture)
+{
+    FrameCaptureQueue* queue = capture->Queue;
+    if (!queue)
+    {
+        return;
+    }
+
+    FrameCaptureFlush(capture);
+    {
+        std::lock_guard<std::mutex> lock(queue->Mutex);
+        queue->Exiting = true;
+    }
+    queue->WorkReady.notify_all();
+    queue->Encoder.join();
+
+    delete queue;
+    capture->Queue = nullptr;
+}
+
+//==============================================================================
+bool FrameCaptureFrame(FrameCapture* capture, void* source, CaptureFileFormat format, const char* filename)
+{
+    FrameCaptureQueue* queue = capture->Queue;
+    std::lock_guard<std::mutex> lock(queue->Mutex);
+    if (strlen(filename) >= FrameCaptureMaxFilename)
+    {
+        assert(false);
+        ++queue->Stats.Failed;
+        return false;
+    }
+
+    uint32_t index = 0;
+    while (index < queue->Slots.size() && queue->Slots[index].State != CaptureSlotState::Free)
+    {
+        ++index;
+    }
+    if (index == queue->Slots.size())
+    {
+        ++queue->Stats.Dropped;
+        return false;
+    }
+    if (!queue->Readback.Copy(queue->Readback.Context, index, source))
+    {
+        ++queue->Stats.Failed;
+        return false;
+    }
+
+    CaptureSlot& slot = queue->Slots[index];
+    slot.State = CaptureSlotState::Copied;
+    slot.Frame = queue->Frame;
+    slot.Sequence = queue->NextSequence++;
+    slot.Format = format;
+    memcpy(slot.Filename, filename, strlen(filename) + 1);
+    ++queue->Stats.Captured;
+    ++queue->Stats.Pending;
+    return true;
+}
+
+//==============================================================================
+void FrameCaptureUpdate(FrameCapture* capture)
+{
+    FrameCaptureQueue* queue = capture->Queue;
+    std::lock_guard<std::mutex> lock(queue->Mutex);
+    ++queue->Frame;
+    UpdateSlots(queue, false);
+}
+
+//==============================================================================
+void FrameCaptureFlush(FrameCapture* capture)
+{
+    FrameCaptureQueue* queue = capture->Queue;
+    std::unique_lock<std::mutex> lock(queue->Mutex);
+    UpdateSlots(queue, true);
+    queue->WriteDone.wait(lock, [queue]() { return queue->Stats.Pending == 0; });
+    UpdateSlots(queue, true);
+}
+
+//==============================================================================
+void FrameCaptureGetStats(const FrameCapture& capture, FrameCaptureStats* stats)
+{
+    std::lock_guard<std::mutex> lock(capture.Queue->Mutex);
+    *stats = capture.Queue->Stats;
+}
+
+//==============================================================================
+const char* CaptureFileFormatExtension(CaptureFileFormat format)
+{
+    switch (format)
+    {
+    case CaptureFileFormat::Png:
+        return "png";
+    case CaptureFileFormat::Exr:
+        return "exr";
+    case CaptureFileFormat::Raw:
+        return "wtex";
+    default:
+        assert(false);
+        return "";
+    }
+}
@@ -0,0 +1,95 @@
+//==============================================================================
+// Asynchronous frame capture to disk, for offline analysis of the warped
+// output and the app frame. The thread drawing frames never copies pixels or
+// waits on the GPU or the disk:
+//
+// - FrameCaptureFrame has the readback start a GPU copy of the frame into one
+//   of a few slots of readback memory, such as staging textures, and returns.
+//   With every slot busy the frame is dropped and counted, never waited for.
+// - FrameCaptureUpdate, once a frame, maps slots copied 'latency' frames ago
+//   without waiting, trying again next frame if the GPU hasn't got there, and
+//   hands the mapped memory to the encoder thread.
+// - The encoder writes each frame straight from the mapping, in the order they
+//   were captured, and a later FrameCaptureUpdate unmaps its slot for reuse.
+//
+// Frames are written as uncompressed PNG or OpenEXR (see ImageFile.h), or as
+// raw TextureFiles (see TextureFile.h). The readback is only ever called from
+// the thread calling FrameCaptureFrame, FrameCaptureUpdate and
+// FrameCaptureFlush, so it may use a context that isn't thread safe.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t FrameCaptureMaxFilename = 260;
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class CaptureFileFormat
+{
+    Png,    // R8G8B8A8Unorm and R16Unorm
+    Exr,    // Uncompressed formats
+    Raw,    // TextureFile, in any format with a DXGI_FORMAT
+};
+
+struct FrameReadback
+{
+    // Starts copying the readback's own 'source' into 'slot'. False if it
+    // can't be read back.
+    bool (*Copy)(void* context, uint32_t slot, void* source);
+
+    // Maps the copy in 'slot' into 'image'. Unless 'wait' is set, false while
+    // the GPU hasn't finished it.
+    bool (*Map)(void* context, uint32_t slot, bool wait, CpuTexture* image);
+    void (*Unmap)(void* context, uint32_t slot);
+
+    void* Context;
+};
+
+struct FrameCaptureStats
+{
+    uint32_t Captured;      // Copied into a slot, since the capture was created
+    uint32_t Written;
+    uint32_t Dropped;       // With no free slot
+    uint32_t Failed;        // Couldn't be copied or written
+    uint32_t Pending;       // Captured and not yet written or failed
+    uint64_t BytesWritten;
+    double WriteMs;         // Encoder time, summed over written frames
+};
+
+// Slots and the encoder thread, private to FrameCapture.cpp
+struct FrameCaptureQueue;
+
+struct FrameCapture
+{
+    FrameCaptureQueue* Queue;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// 'numSlots' frames can be between FrameCaptureFrame and being written at once
+bool FrameCaptureCreate(uint32_t numSlots, uint32_t latency, const FrameReadback& readback, FrameCapture* capture);
+
+// Flushes, then stops the encoder
+void FrameCaptureDestroy(FrameCapture* capture);
+
+// Captures the readback's 'source' to 'filename'. False if the frame was
+// dropped or couldn't be copied.
+bool FrameCaptureFrame(FrameCapture* capture, void* source, CaptureFileFormat format, const char* filename);
+
+// Once a frame: maps the slots copied long enough ago and unmaps the written
+void FrameCaptureUpdate(FrameCapture* capture);
+
+// Waits until every captured frame is written, and frees their slots
+void FrameCaptureFlush(FrameCapture* capture);
+
+void FrameCaptureGetStats(const FrameCapture& capture, FrameCaptureStats* stats);
+
+const char* CaptureFileFormatExtension(CaptureFileFormat format);
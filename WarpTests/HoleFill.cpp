@@ -0,0 +1,392 @@
+//==============================================================================
+#include "HoleFill.h"
+#include "Parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Rows per ParallelFor chunk
+static const uint32_t RowGrain = 8;
+
+// Pull weights are (1 / (1 - z + DepthEpsilon))^2. With a perspective
+// projection 1 - z is about near / view depth, so this weighs each pixel by its
+// squared view depth, capped for the far plane.
+static const float DepthEpsilon = 0.001f;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline float* PixelRow(const CpuTexture& texture, uint32_t y)
+{
+    return (float*)(texture.Data + (size_t)y * texture.RowPitch);
+}
+
+static inline uint32_t NextLevelSize(uint32_t size)
+{
+    return (size + 1) / 2;
+}
+
+// Nearest depth wins. Non-negative floats order the same as their bits.
+static inline void SplatDepth(std::atomic<uint32_t>& pixel, uint32_t depth)
+{
+    uint32_t current = pixel.load(std::memory_order_relaxed);
+    while (depth < current && !pixel.compare_exchange_weak(current, depth, std::memory_order_relaxed))
+    {
+    }
+}
+
+// With 'skipEmpty', texels at the far plane hold no surface and aren't splatted
+static void SplatRows(const CpuTexture& sourceDepth, const float* m, bool skipEmpty, uint32_t y0, uint32_t y1, HoleFill* fill)
+{
+    alignas(32) float targetX[SimdWidth];
+    alignas(32) float targetY[SimdWidth];
+    alignas(32) float targetZ[SimdWidth];
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const float* depthRow = PixelRow(sourceDepth, y);
+
+        for (uint32_t x = 0; x < sourceDepth.Width; x += SimdWidth)
+        {
+            uint32_t count = HoleFillWarpTexels(sourceDepth, m, x, y, fill->Width, fill->Height, targetX, targetY, targetZ);
+
+            // Each texel covers the 2x2 pixels around where it lands, so
+            // slight magnification doesn't leave cracks
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                int32_t px0, py0;
+                if ((skipEmpty && depthRow[x + i] >= 1.f) || !HoleFillFootprint(*fill, targetX[i], targetY[i], &px0, &py0))
+                {
+                    continue;
+                }
+
+                uint32_t bits;
+                memcpy(&bits, &targetZ[i], sizeof(bits));
+
+                for (int32_t sy = std::max(py0, 0); sy <= std::min(py0 + 1, (int32_t)fill->Height - 1); ++sy)
+                {
+                    for (int32_t sx = std::max(px0, 0); sx <= std::min(px0 + 1, (int32_t)fill->Width - 1); ++sx)
+                    {
+                        SplatDepth(fill->WarpedDepth[(size_t)sy * fill->Width + sx], bits);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Level 0 from the warped colors and splatted depths
+static void InitRows(const CpuTexture& target, uint32_t y0, uint32_t y1, HoleFill* fill)
+{
+    const __m128 scale = _mm_set1_ps(1.f / 255.f);
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const uint8_t* colorRow = target.Data + (size_t)y * target.RowPitch;
+        const std::atomic<uint32_t>* depthRow = &fill->WarpedDepth[(size_t)y * fill->Width];
+        float* out = PixelRow(fill->Levels[0], y);
+
+        for (uint32_t x = 0; x < target.Width; ++x)
+        {
+            uint32_t bits = depthRow[x].load(std::memory_order_relaxed);
+            if (bits == HoleFillEmpty)
+            {
+                _mm_storeu_ps(out + x * 4, _mm_setzero_ps());
+                continue;
+            }
+            bits &= ~HoleFillReused;
+
+            float z;
+            memcpy(&z, &bits, sizeof(z));
+            float weight = 1.f / (1.f - std::min(z, 1.f) + DepthEpsilon);
+            weight *= weight;
+
+            int32_t rgba;
+            memcpy(&rgba, colorRow + x * 4, sizeof(rgba));
+            __m128 color = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(rgba))), scale);
+            color = _mm_mul_ps(color, _mm_set1_ps(weight));
+            _mm_storeu_ps(out + x * 4, _mm_blend_ps(color, _mm_set1_ps(weight), 0x8));
+        }
+    }
+}
+
+// Sums each 2x2 of 'source' into 'target'. Past the edge the last row or
+// column is summed again.
+static void PullRows(const CpuTexture& source, CpuTexture* target, uint32_t y0, uint32_t y1)
+{
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const float* row0 = PixelRow(source, std::min(y * 2, source.Height - 1));
+        const float* row1 = PixelRow(source, std::min(y * 2 + 1, source.Height - 1));
+        float* out = PixelRow(*target, y);
+
+        for (uint32_t x = 0; x < target->Width; ++x)
+        {
+            uint32_t x0 = std::min(x * 2, source.Width - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, source.Width - 1) * 4;
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+            _mm_storeu_ps(out + x * 4, sum);
+        }
+    }
+}
+
+static inline __m128 Normalized(const float* pixel)
+{
+    __m128 value = _mm_loadu_ps(pixel);
+    return _mm_div_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+// Fills the empty texels of 'target' by bilinear upsampling of 'source', the
+// level above, which has no empty texels left
+static void PushRows(const CpuTexture& source, CpuTexture* target, uint32_t y0, uint32_t y1)
+{
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        float* out = PixelRow(*target, y);
+
+        // Texel centers of this level fall a quarter of the way between those
+        // of the level above
+        float sy = (y + 0.5f) * 0.5f - 0.5f;
+        int32_t syi = (int32_t)floorf(sy);
+        float fy = sy - syi;
+        const float* rowA = PixelRow(source, (uint32_t)std::max(syi, 0));
+        const float* rowB = PixelRow(source, std::min((uint32_t)(syi + 1), source.Height - 1));
+
+        for (uint32_t x = 0; x < target->Width; ++x)
+        {
+            if (out[x * 4 + 3] > 0.f)
+            {
+                continue;
+            }
+
+            float sx = (x + 0.5f) * 0.5f - 0.5f;
+            int32_t sxi = (int32_t)floorf(sx);
+            float fx = sx - sxi;
+            uint32_t xa = (uint32_t)std::max(sxi, 0) * 4;
+            uint32_t xb = std::min((uint32_t)(sxi + 1), source.Width - 1) * 4;
+
+            __m128 top = _mm_add_ps(_mm_mul_ps(Normalized(rowA + xa), _mm_set1_ps(1.f - fx)), _mm_mul_ps(Normalized(rowA + xb), _mm_set1_ps(fx)));
+            __m128 bottom = _mm_add_ps(_mm_mul_ps(Normalized(rowB + xa), _mm_set1_ps(1.f - fx)), _mm_mul_ps(Normalized(rowB + xb), _mm_set1_ps(fx)));
+            __m128 color = _mm_add_ps(_mm_mul_ps(top, _mm_set1_ps(1.f - fy)), _mm_mul_ps(bottom, _mm_set1_ps(fy)));
+
+            // Stored with a weight of one, so it normalizes to itself
+            _mm_storeu_ps(out + x * 4, _mm_blend_ps(color, _mm_set1_ps(1.f), 0x8));
+        }
+    }
+}
+
+// Writes the filled level 0 over the holes of 'target'
+static void ResolveRows(const HoleFill& fill, CpuTexture* target, uint32_t y0, uint32_t y1)
+{
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const float* level = PixelRow(fill.Levels[0], y);
+        uint8_t* colorRow = target->Data + (size_t)y * target->RowPitch;
+
+        for (uint32_t x = 0; x < target->Width; ++x)
+        {
+            if (!HoleFillIsHole(fill, x, y))
+            {
+                continue;
+            }
+
+            __m128 color = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(level + x * 4), _mm_setzero_ps()), _mm_set1_ps(1.f));
+            __m128i rgba = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, scale), half));
+            rgba = _mm_packus_epi32(rgba, rgba);
+            int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(rgba, rgba));
+
+            // Opaque, like the rest of the warped frame
+            packed |= (int32_t)0xFF000000;
+            memcpy(colorRow + x * 4, &packed, sizeof(packed));
+        }
+    }
+}
+
+//==============================================================================
+bool HoleFillCreate(uint32_t width, uint32_t height, HoleFill* fill)
+{
+    HoleFillDestroy(fill);
+
+    fill->Width = width;
+    fill->Height = height;
+    fill->NumHoles = 0;
+    fill->WarpedDepth.reset(new std::atomic<uint32_t>[(size_t)width * height]);
+
+    for (;;)
+    {
+        fill->Levels.emplace_back();
+        if (!CpuTextureCreate(width, height, CpuFormat::R32G32B32A32Float, &fill->Levels.back()))
+        {
+            assert(false);
+            return false;
+        }
+
+        if (width == 1 && height == 1)
+        {
+            break;
+        }
+        width = NextLevelSize(width);
+        height = NextLevelSize(height);
+    }
+
+    return true;
+}
+
+//==============================================================================
+void HoleFillDestroy(HoleFill* fill)
+{
+    for (CpuTexture& level : fill->Levels)
+    {
+        CpuTextureDestroy(&level);
+    }
+    fill->Levels.clear();
+    fill->WarpedDepth.reset();
+}
+
+//==============================================================================
+uint32_t HoleFillWarpTexels(const CpuTexture& sourceDepth, const float m[16], uint32_t x, uint32_t y,
+    uint32_t targetWidth, uint32_t targetHeight, float* targetX, float* targetY, float* targetZ)
+{
+    assert(sourceDepth.Format == CpuFormat::R32Float);
+
+    uint32_t count = std::min(SimdWidth, sourceDepth.Width - x);
+    float scaleX = 2.f / sourceDepth.Width;
+    float scaleY = 2.f / sourceDepth.Height;
+
+    // Source NDC and depth through the warp, as in the positional warp
+    // vertex shader
+    alignas(32) float depth[SimdWidth] = {};
+    memcpy(depth, PixelRow(sourceDepth, y) + x, count * sizeof(float));
+    SimdFloat z = SimdLoad(depth);
+    SimdFloat ndcX = SimdSub(SimdMul(SimdAdd(SimdAdd(SimdSet((float)x), SimdLaneIndex()), SimdSet(0.5f)), SimdSet(scaleX)), SimdSet(1.f));
+    SimdFloat ndcY = SimdSet(1.f - (y + 0.5f) * scaleY);
+
+    SimdFloat clip[4];
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        clip[c] = SimdAdd(SimdAdd(SimdMul(ndcX, SimdSet(m[c])), SimdMul(ndcY, SimdSet(m[4 + c]))),
+            SimdAdd(SimdMul(z, SimdSet(m[8 + c])), SimdSet(m[12 + c])));
+    }
+
+    // Behind the eye lands nowhere
+    SimdFloat visible = SimdCmpLt(SimdZero(), clip[3]);
+    SimdFloat invW = SimdDiv(SimdSet(1.f), SimdSelect(visible, clip[3], SimdSet(1.f)));
+    SimdFloat px = SimdMul(SimdAdd(SimdMul(clip[0], invW), SimdSet(1.f)), SimdSet(targetWidth * 0.5f));
+    SimdFloat py = SimdMul(SimdSub(SimdSet(1.f), SimdMul(clip[1], invW)), SimdSet(targetHeight * 0.5f));
+    SimdStore(targetX, SimdSelect(visible, px, SimdSet(-2.f)));
+    SimdStore(targetY, py);
+    SimdStore(targetZ, SimdMax(SimdMul(clip[2], invW), SimdZero()));
+
+    return count;
+}
+
+//==============================================================================
+void HoleFillDetect(const CpuTexture& sourceDepth, const CpuTexture* backLayerDepth, const float twMatrix[16], HoleFill* fill)
+{
+    assert(sourceDepth.Format == CpuFormat::R32Float);
+
+    ParallelFor(fill->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        for (size_t i = (size_t)y0 * fill->Width; i < (size_t)y1 * fill->Width; ++i)
+        {
+            fill->WarpedDepth[i].store(HoleFillEmpty, std::memory_order_relaxed);
+        }
+    });
+
+    ParallelFor(sourceDepth.Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        SplatRows(sourceDepth, twMatrix, false, y0, y1, fill);
+    });
+
+    if (backLayerDepth)
+    {
+        ParallelFor(backLayerDepth->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+        {
+            SplatRows(*backLayerDepth, twMatrix, true, y0, y1, fill);
+        });
+    }
+
+    std::atomic<uint32_t> holes(0);
+    ParallelFor(fill->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        uint32_t count = 0;
+        for (size_t i = (size_t)y0 * fill->Width; i < (size_t)y1 * fill->Width; ++i)
+        {
+            count += fill->WarpedDepth[i].load(std::memory_order_relaxed) == HoleFillEmpty;
+        }
+        holes += count;
+    });
+    fill->NumHoles = holes;
+}
+
+//==============================================================================
+void HoleFillApply(CpuTexture* target, HoleFill* fill)
+{
+    assert(target->Format == CpuFormat::R8G8B8A8Unorm);
+    assert(target->Width == fill->Width && target->Height == fill->Height);
+
+    if (fill->NumHoles == 0)
+    {
+        return;
+    }
+
+    ParallelFor(fill->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        InitRows(*target, y0, y1, fill);
+    });
+
+    for (size_t i = 1; i < fill->Levels.size(); ++i)
+    {
+        CpuTexture& source = fill->Levels[i - 1];
+        CpuTexture& level = fill->Levels[i];
+        ParallelFor(level.Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+        {
+            PullRows(source, &level, y0, y1);
+        });
+    }
+
+    // Every pixel being a hole leaves nothing to fill from
+    if (PixelRow(fill->Levels.back(), 0)[3] <= 0.f)
+    {
+        return;
+    }
+
+    for (size_t i = fill->Levels.size() - 1; i > 0; --i)
+    {
+        CpuTexture& source = fill->Levels[i];
+        CpuTexture& level = fill->Levels[i - 1];
+        ParallelFor(level.Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+        {
+            PushRows(source, &level, y0, y1);
+        });
+    }
+
+    ParallelFor(fill->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        ResolveRows(*fill, target, y0, y1);
+    });
+}
+
+//==============================================================================
+bool HoleFillCompare(const HoleFill& fill, const CpuTexture& a, const CpuTexture& b, CpuTextureDiff* diff)
+{
+    if (a.Width != fill.Width || a.Height != fill.Height)
+    {
+        return false;
+    }
+
+    auto wasHole = [](const void* context, uint32_t x, uint32_t y)
+    {
+        return HoleFillWasHole(*(const HoleFill*)context, x, y);
+    };
+    return CpuTextureCompareMasked(a, b, wasHole, &fill, diff);
+}
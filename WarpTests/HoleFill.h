@@ -0,0 +1,95 @@
+//==============================================================================
+// Disocclusion hole filling for the positional warp. The warp grid stretches
+// across depth edges, so regions the app frame never saw come out as smears of
+// the foreground. This finds them by forward splatting every source texel
+// through the warp: target pixels no texel lands on are holes.
+//
+// Holes are then inpainted with push-pull over a mip chain. The pull pass
+// averages the valid pixels below each texel, weighted towards the farthest
+// depth, since disocclusions reveal background. The push pass fills each
+// level's holes from the level above it.
+//
+// Both passes run on the ParallelFor pool (see Parallel.h).
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+#include <math.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct HoleFill
+{
+    uint32_t Width;
+    uint32_t Height;
+
+    // Per target pixel, nearest splatted depth as bits, or HoleFillEmpty.
+    // Holes filled from elsewhere hold their depth with HoleFillReused set.
+    std::unique_ptr<std::atomic<uint32_t>[]> WarpedDepth;
+
+    // R32G32B32A32Float: color premultiplied by weight, and weight. Level 0
+    // is the target size and each level above is half, rounded up.
+    std::vector<CpuTexture> Levels;
+
+    uint32_t NumHoles;      // From the last HoleFillDetect
+};
+
+static const uint32_t HoleFillEmpty = 0xFFFFFFFFu;
+static const uint32_t HoleFillReused = 0x80000000u;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Sizes 'fill' for a 'width' x 'height' target
+bool HoleFillCreate(uint32_t width, uint32_t height, HoleFill* fill);
+void HoleFillDestroy(HoleFill* fill);
+
+// Splats 'sourceDepth' through 'twMatrix', the positional warp from source
+// NDC and depth to target clip space (row vectors), to find the holes.
+// 'backLayerDepth' may add the second layer of a layered app frame, whose
+// texels at the far plane are empty.
+void HoleFillDetect(const CpuTexture& sourceDepth, const CpuTexture* backLayerDepth, const float twMatrix[16], HoleFill* fill);
+
+// Replaces the holes left in 'target' (R8G8B8A8Unorm) by push-pull inpainting
+void HoleFillApply(CpuTexture* target, HoleFill* fill);
+
+// Warps up to SimdWidth texels of row 'y' of 'sourceDepth', from column 'x',
+// like HoleFillDetect. Returns the texel count. Outputs are target pixel
+// coordinates, negative for texels behind the eye, and target depth.
+uint32_t HoleFillWarpTexels(const CpuTexture& sourceDepth, const float m[16], uint32_t x, uint32_t y,
+    uint32_t targetWidth, uint32_t targetHeight, float* targetX, float* targetY, float* targetZ);
+
+// Top left pixel of the 2x2 a warped texel covers, false if it's all outside
+inline bool HoleFillFootprint(const HoleFill& fill, float targetX, float targetY, int32_t* x, int32_t* y)
+{
+    float fx = floorf(targetX - 0.5f);
+    float fy = floorf(targetY - 0.5f);
+    if (!(fx >= -1.f && fx < (float)fill.Width && fy >= -1.f && fy < (float)fill.Height))
+    {
+        return false;
+    }
+
+    *x = (int32_t)fx;
+    *y = (int32_t)fy;
+    return true;
+}
+
+inline bool HoleFillIsHole(const HoleFill& fill, uint32_t x, uint32_t y)
+{
+    return fill.WarpedDepth[(size_t)y * fill.Width + x].load(std::memory_order_relaxed) == HoleFillEmpty;
+}
+
+// Holes from HoleFillDetect, including those since filled from elsewhere
+inline bool HoleFillWasHole(const HoleFill& fill, uint32_t x, uint32_t y)
+{
+    return (fill.WarpedDepth[(size_t)y * fill.Width + x].load(std::memory_order_relaxed) & HoleFillReused) != 0;
+}
+
+// Like CpuTextureCompare, over the HoleFillWasHole pixels only
+bool HoleFillCompare(const HoleFill& fill, const CpuTexture& a, const CpuTexture& b, CpuTextureDiff* diff);
@@ -0,0 +1,1920 @@
+//==============================================================================
+#include "ImageFile.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Bytes read from the file at a time
+static const size_t ReadBufferSize = 64 * 1024;
+
+// Largest width or height, as D3D11 textures
+static const uint32_t MaxDimension = 16384;
+
+// Inflate (RFC 1951)
+static const uint32_t WindowSize = 32768;
+static const uint32_t MaxCodeBits = 15;
+static const uint32_t FastBits = 10;        // Codes up to this long decode in one lookup
+static const uint32_t MaxLitLenCodes = 288;
+static const uint32_t MaxDistCodes = 32;
+static const uint32_t EndOfBlock = 256;
+
+static const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577 };
+static const uint8_t DistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// PNG
+static const uint8_t PngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+static const uint32_t PngMaxChunkLength = 0x7fffffff;
+
+// First column and row, then column and row step, of each Adam7 pass
+static const uint32_t Adam7Passes[7][4] = {
+    { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+
+// DDS
+static const uint32_t DdsHeaderSize = 124;
+static const uint32_t DdsPixelFormatFourCC = 0x4;
+static const uint32_t DdsPixelFormatAlphaPixels = 0x1;
+static const uint32_t DdsPixelFormatAlpha = 0x2;
+static const uint32_t DdsPixelFormatRgb = 0x40;
+static const uint32_t DdsPixelFormatLuminance = 0x20000;
+static const uint32_t DdsResourceTexture2D = 3;
+static const uint32_t DdsFlagsRequired = 0x1 | 0x2 | 0x4 | 0x1000;  // Caps, height, width, pixel format
+static const uint32_t DdsFlagsPitch = 0x8;
+static const uint32_t DdsFlagsMipMapCount = 0x20000;
+static const uint32_t DdsFlagsLinearSize = 0x80000;
+static const uint32_t DdsCapsTexture = 0x1000;
+static const uint32_t DdsCapsMipMap = 0x400008;                     // With complex
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// Buffered reads of the file
+struct FileStream
+{
+    FILE* File;
+    std::vector<uint8_t> Buffer;
+    size_t Position;
+    size_t End;
+    bool Failed;            // Read past the end, or an I/O error
+};
+
+// Canonical Huffman code
+struct HuffmanCode
+{
+    uint16_t Fast[1 << FastBits];       // Symbol << 4 | length, 0 for longer codes
+    uint16_t Counts[MaxCodeBits + 1];   // Codes of each length
+    uint16_t Symbols[MaxLitLenCodes];   // In code order
+};
+
+enum class InflateBlock
+{
+    Header,
+    Stored,
+    Codes,
+    Done,
+};
+
+struct InflateState
+{
+    uint64_t Bits;
+    uint32_t BitCount;
+    uint32_t PaddingBytes;      // Zeros fed in past the end of the stream
+    InflateBlock Block;
+    bool LastBlock;
+    uint32_t StoredRemaining;
+    uint32_t CopyLength;        // Of the match being copied
+    uint32_t CopyDistance;
+    uint64_t Output;            // Bytes out so far
+    std::vector<uint8_t> Window;
+    HuffmanCode LitLen;
+    HuffmanCode Distance;
+};
+
+struct PngState
+{
+    uint8_t ColorType;
+    uint8_t BitDepth;
+    bool Interlaced;
+    uint32_t Channels;
+    uint32_t PaletteSize;
+    uint8_t Palette[256][4];
+    bool HasColorKey;           // tRNS for gray and true-color
+    uint16_t ColorKey[3];
+    uint32_t IdatRemaining;     // Of the current IDAT chunk
+    bool IdatDone;
+    InflateState Inflate;
+};
+
+struct TgaState
+{
+    uint8_t ImageType;
+    uint8_t PixelBits;
+    uint8_t AttributeBits;
+    bool TopDown;
+    bool RightToLeft;
+    uint8_t Palette[256][4];
+    uint32_t RunCount;          // Pixels left in the current RLE packet
+    bool RunRepeat;
+    uint8_t RunPixel[4];
+};
+
+struct PnmState
+{
+    uint32_t Channels;
+    uint32_t MaxValue;
+};
+
+struct DdsState
+{
+    uint32_t PixelBits;         // 0 for block compressed
+    uint32_t Masks[4];          // RGBA, 0 for absent
+    bool Luminance;
+};
+
+struct ImageDecoder
+{
+    FileStream Stream;
+    PngState Png;
+    TgaState Tga;
+    PnmState Pnm;
+    DdsState Dds;
+    uint32_t LevelsRead;
+
+    // One row of file data, the one above for PNG filters, and converted
+    // pixels for formats that don't land in place
+    std::vector<uint8_t> Row;
+    std::vector<uint8_t> PreviousRow;
+    std::vector<uint8_t> Pixels;
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+// 'filename' is UTF-8, which the narrow Windows functions would read in the
+// ANSI code page
+static FILE* OpenFile(const char* filename, const char* mode)
+{
+#ifdef _WIN32
+    wchar_t wideFilename[MAX_PATH];
+    wchar_t wideMode[8];
+    if (MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, filename, -1, wideFilename, _countof(wideFilename)) == 0 ||
+        MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, mode, -1, wideMode, _countof(wideMode)) == 0)
+    {
+        return nullptr;
+    }
+    FILE* file = nullptr;
+    return (_wfopen_s(&file, wideFilename, wideMode) == 0) ? file : nullptr;
+#else
+    return fopen(filename, mode);
+#endif
+}
+
+static inline uint32_t ReadLe16(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static inline uint32_t ReadLe32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t ReadBe32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void WriteLe32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+// Width or height of mip 'level', as MipLevelSize
+static inline uint32_t LevelSize(uint32_t size, uint32_t level)
+{
+    return std::max(size >> level, 1u);
+}
+
+static inline uint8_t* TargetRow(uint8_t* target, size_t rowPitch, uint32_t y)
+{
+    return target + (size_t)y * rowPitch;
+}
+
+//==============================================================================
+// File stream
+//==============================================================================
+static bool StreamFill(FileStream* stream)
+{
+    if (stream->Failed)
+    {
+        return false;
+    }
+    stream->Position = 0;
+    stream->End = fread(stream->Buffer.data(), 1, stream->Buffer.size(), stream->File);
+    stream->Failed = (stream->End == 0);
+    return !stream->Failed;
+}
+
+// Zero past the end, which sets 'Failed'
+static inline uint8_t StreamByte(FileStream* stream)
+{
+    if (stream->Position == stream->End && !StreamFill(stream))
+    {
+        return 0;
+    }
+    return stream->Buffer[stream->Position++];
+}
+
+static bool StreamRead(FileStream* stream, void* data, size_t size)
+{
+    uint8_t* out = (uint8_t*)data;
+    while (size > 0)
+    {
+        if (stream->Position == stream->End && !StreamFill(stream))
+        {
+            return false;
+        }
+        size_t count = std::min(size, stream->End - stream->Position);
+        memcpy(out, &stream->Buffer[stream->Position], count);
+        stream->Position += count;
+        out += count;
+        size -= count;
+    }
+    return true;
+}
+
+static bool StreamSkip(FileStream* stream, size_t size)
+{
+    while (size > 0)
+    {
+        if (stream->Position == stream->End && !StreamFill(stream))
+        {
+            return false;
+        }
+        size_t count = std::min(size, stream->End - stream->Position);
+        stream->Position += count;
+        size -= count;
+    }
+    return true;
+}
+
+//==============================================================================
+// Inflate, fed from the PNG's IDAT chunks
+//==============================================================================
+
+// The next byte of the zlib stream, crossing IDAT chunks. Zero past the end.
+static uint8_t IdatByte(ImageDecoder* decoder)
+{
+    PngState& png = decoder->Png;
+    while (png.IdatRemaining == 0)
+    {
+        // The last chunk's CRC, then the next chunk's length and type
+        uint8_t header[12];
+        if (png.IdatDone || !StreamRead(&decoder->Stream, header, sizeof(header)) || memcmp(header + 8, "IDAT", 4) != 0 ||
+            ReadBe32(header + 4) > PngMaxChunkLength)
+        {
+            png.IdatDone = true;
+            ++png.Inflate.PaddingBytes;
+            return 0;
+        }
+        png.IdatRemaining = ReadBe32(header + 4);
+    }
+    --png.IdatRemaining;
+    return StreamByte(&decoder->Stream);
+}
+
+static inline uint32_t GetBits(ImageDecoder* decoder, uint32_t count)
+{
+    InflateState& z = decoder->Png.Inflate;
+    if (z.BitCount < count)
+    {
+        while (z.BitCount <= 56)
+        {
+            z.Bits |= (uint64_t)IdatByte(decoder) << z.BitCount;
+            z.BitCount += 8;
+        }
+    }
+    uint32_t value = (uint32_t)(z.Bits & ((1ull << count) - 1));
+    z.Bits >>= count;
+    z.BitCount -= count;
+    return value;
+}
+
+// False if the code is over-subscribed. Incomplete codes are allowed, as a
+// distance code may have a single symbol.
+static bool HuffmanBuild(const uint8_t* lengths, uint32_t numSymbols, HuffmanCode* code)
+{
+    memset(code->Counts, 0, sizeof(code->Counts));
+    memset(code->Fast, 0, sizeof(code->Fast));
+    for (uint32_t i = 0; i < numSymbols; ++i)
+    {
+        ++code->Counts[lengths[i]];
+    }
+    code->Counts[0] = 0;
+
+    int32_t left = 1;
+    uint16_t offsets[MaxCodeBits + 2] = {};
+    uint32_t next[MaxCodeBits + 1] = {};
+    uint32_t first = 0;
+    for (uint32_t length = 1; length <= MaxCodeBits; ++length)
+    {
+        left = left * 2 - code->Counts[length];
+        if (left < 0)
+        {
+            return false;
+        }
+        offsets[length + 1] = (uint16_t)(offsets[length] + code->Counts[length]);
+        next[length] = first;
+        first = (first + code->Counts[length]) << 1;
+    }
+
+    for (uint32_t symbol = 0; symbol < numSymbols; ++symbol)
+    {
+        uint32_t length = lengths[symbol];
+        if (length == 0)
+        {
+            continue;
+        }
+        code->Symbols[offsets[length]++] = (uint16_t)symbol;
+
+        // The stream holds codes most significant bit first, so the table is
+        // indexed by them reversed
+        uint32_t canonical = next[length]++;
+        if (length <= FastBits)
+        {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                reversed |= ((canonical >> i) & 1) << (length - 1 - i);
+            }
+            for (uint32_t i = reversed; i < (1u << FastBits); i += 1u << length)
+            {
+                code->Fast[i] = (uint16_t)((symbol << 4) | length);
+            }
+        }
+    }
+    return true;
+}
+
+// The next symbol, or MaxLitLenCodes for a code not in the table
+static uint32_t HuffmanDecode(ImageDecoder* decoder, const HuffmanCode& code)
+{
+    InflateState& z = decoder->Png.Inflate;
+    if (z.BitCount < MaxCodeBits)
+    {
+        while (z.BitCount <= 56)
+        {
+            z.Bits |= (uint64_t)IdatByte(decoder) << z.BitCount;
+            z.BitCount += 8;
+        }
+    }
+
+    uint32_t entry = code.Fast[z.Bits & ((1u << FastBits) - 1)];
+    if (entry)
+    {
+        uint32_t length = entry & 15;
+        z.Bits >>= length;
+        z.BitCount -= length;
+        return entry >> 4;
+    }
+
+    // Longer codes a bit at a time, canonically
+    int32_t value = 0;
+    int32_t first = 0;
+    int32_t index = 0;
+    for (uint32_t length = 1; length <= MaxCodeBits; ++length)
+    {
+        value |= (int32_t)((z.Bits >> (length - 1)) & 1);
+        int32_t count = code.Counts[length];
+        if (value - count < first)
+        {
+            z.Bits >>= length;
+            z.BitCount -= length;
+            return code.Symbols[index + (value - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        value <<= 1;
+    }
+    return MaxLitLenCodes;
+}
+
+static bool InflateFixedCodes(InflateState* z)
+{
+    uint8_t lengths[MaxLitLenCodes + MaxDistCodes];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    memset(lengths + MaxLitLenCodes, 5, MaxDistCodes);
+    return HuffmanBuild(lengths, MaxLitLenCodes, &z->LitLen) &&
+        HuffmanBuild(lengths + MaxLitLenCodes, MaxDistCodes, &z->Distance);
+}
+
+static bool InflateDynamicCodes(ImageDecoder* decoder)
+{
+    InflateState& z = decoder->Png.Inflate;
+    uint32_t numLitLen = GetBits(decoder, 5) + 257;
+    uint32_t numDistance = GetBits(decoder, 5) + 1;
+    uint32_t numCodeLengths = GetBits(decoder, 4) + 4;
+    if (numLitLen > 286 || numDistance > 30)
+    {
+        return false;
+    }
+
+    // Code lengths are themselves Huffman coded, reusing the distance code
+    uint8_t codeLengths[19] = {};
+    for (uint32_t i = 0; i < numCodeLengths; ++i)
+    {
+        codeLengths[CodeLengthOrder[i]] = (uint8_t)GetBits(decoder, 3);
+    }
+    if (!HuffmanBuild(codeLengths, 19, &z.Distance))
+    {
+        return false;
+    }
+
+    uint8_t lengths[MaxLitLenCodes + MaxDistCodes];
+    uint32_t total = numLitLen + numDistance;
+    uint32_t count = 0;
+    while (count < total)
+    {
+        uint32_t symbol = HuffmanDecode(decoder, z.Distance);
+        if (symbol < 16)
+        {
+            lengths[count++] = (uint8_t)symbol;
+            continue;
+        }
+
+        uint8_t value = 0;
+        uint32_t repeat = 0;
+        if (symbol == 16)
+        {
+            if (count == 0)
+            {
+                return false;
+            }
+            value = lengths[count - 1];
+            repeat = 3 + GetBits(decoder, 2);
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + GetBits(decoder, 3);
+        }
+        else if (symbol == 18)
+        {
+            repeat = 11 + GetBits(decoder, 7);
+        }
+        else
+        {
+            return false;
+        }
+        if (count + repeat > total)
+        {
+            return false;
+        }
+        memset(lengths + count, value, repeat);
+        count += repeat;
+    }
+
+    return lengths[EndOfBlock] != 0 && HuffmanBuild(lengths, numLitLen, &z.LitLen) &&
+        HuffmanBuild(lengths + numLitLen, numDistance, &z.Distance);
+}
+
+static bool InflateHeader(ImageDecoder* decoder)
+{
+    InflateState& z = decoder->Png.Inflate;
+    uint32_t method = GetBits(decoder, 8);
+    uint32_t flags = GetBits(decoder, 8);
+    return (method & 15) == 8 && (method >> 4) <= 7 && ((method << 8) | flags) % 31 == 0 && !(flags & 0x20) &&
+        z.PaddingBytes == 0;
+}
+
+// Decompresses exactly 'count' bytes into 'out'
+static bool InflateRead(ImageDecoder* decoder, uint8_t* out, size_t count)
+{
+    InflateState& z = decoder->Png.Inflate;
+    uint8_t* window = z.Window.data();
+    const uint32_t mask = WindowSize - 1;
+
+    while (count > 0)
+    {
+        if (z.CopyLength > 0)
+        {
+            uint32_t n = (uint32_t)std::min<size_t>(z.CopyLength, count);
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                uint8_t value = window[(z.Output - z.CopyDistance) & mask];
+                window[z.Output++ & mask] = value;
+                *out++ = value;
+            }
+            z.CopyLength -= n;
+            count -= n;
+            continue;
+        }
+
+        switch (z.Block)
+        {
+        case InflateBlock::Header:
+        {
+            z.LastBlock = GetBits(decoder, 1) != 0;
+            uint32_t type = GetBits(decoder, 2);
+            if (type == 0)
+            {
+                GetBits(decoder, z.BitCount & 7);
+                uint32_t length = GetBits(decoder, 16);
+                uint32_t complement = GetBits(decoder, 16);
+                if ((length ^ 0xffff) != complement)
+                {
+                    return false;
+                }
+                z.StoredRemaining = length;
+                z.Block = InflateBlock::Stored;
+            }
+            else if ((type == 1 && InflateFixedCodes(&z)) || (type == 2 && InflateDynamicCodes(decoder)))
+            {
+                z.Block = InflateBlock::Codes;
+            }
+            else
+            {
+                return false;
+            }
+            break;
+        }
+
+        case InflateBlock::Stored:
+            if (z.StoredRemaining == 0)
+            {
+                z.Block = z.LastBlock ? InflateBlock::Done : InflateBlock::Header;
+                break;
+            }
+            while (z.StoredRemaining > 0 && count > 0)
+            {
+                uint8_t value = (uint8_t)GetBits(decoder, 8);
+                window[z.Output++ & mask] = value;
+                *out++ = value;
+                --z.StoredRemaining;
+                --count;
+            }
+            break;
+
+        case InflateBlock::Codes:
+        {
+            uint32_t symbol = HuffmanDecode(decoder, z.LitLen);
+            if (symbol < EndOfBlock)
+            {
+                window[z.Output++ & mask] = (uint8_t)symbol;
+                *out++ = (uint8_t)symbol;
+                --count;
+                break;
+            }
+            if (symbol == EndOfBlock)
+            {
+                z.Block = z.LastBlock ? InflateBlock::Done : InflateBlock::Header;
+                break;
+            }
+
+            symbol -= EndOfBlock + 1;
+            if (symbol >= 29)
+            {
+                return false;
+            }
+            uint32_t length = LengthBase[symbol] + GetBits(decoder, LengthExtra[symbol]);
+            uint32_t distanceSymbol = HuffmanDecode(decoder, z.Distance);
+            if (distanceSymbol >= 30)
+            {
+                return false;
+            }
+            uint32_t distance = DistanceBase[distanceSymbol] + GetBits(decoder, DistanceExtra[distanceSymbol]);
+            if (distance > z.Output)
+            {
+                return false;
+            }
+            z.CopyLength = length;
+            z.CopyDistance = distance;
+            break;
+        }
+
+        default:
+            // The stream ended before the image
+            return false;
+        }
+
+        // Decoding into the zeros past the end means the stream was cut short
+        if (z.PaddingBytes * 8 > z.BitCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+// PNG
+//==============================================================================
+// Checked as soon as a header gives them, before anything is sized from them
+static inline bool ValidDimensions(const ImageFileInfo& info)
+{
+    return info.Width > 0 && info.Height > 0 && info.Width <= MaxDimension && info.Height <= MaxDimension;
+}
+
+static bool PngOpen(ImageDecoder* decoder, ImageFileInfo* info)
+{
+    PngState& png = decoder->Png;
+    FileStream* stream = &decoder->Stream;
+
+    uint8_t header[8 + 8 + 13];
+    if (!StreamRead(stream, header, sizeof(header)) || memcmp(header, PngSignature, 8) != 0 ||
+        ReadBe32(header + 8) != 13 || memcmp(header + 12, "IHDR", 4) != 0)
+    {
+        return false;
+    }
+    const uint8_t* ihdr = header + 16;
+    info->Width = ReadBe32(ihdr);
+    info->Height = ReadBe32(ihdr + 4);
+    png.BitDepth = ihdr[8];
+    png.ColorType = ihdr[9];
+    png.Interlaced = ihdr[12] == 1;
+    if (!ValidDimensions(*info) || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] > 1 || !StreamSkip(stream, 4))
+    {
+        return false;
+    }
+
+    // Bit depths allowed for each color type, as bits
+    static const uint32_t Depths[7] = { 0x10116, 0, 0x10100, 0x116, 0x10100, 0, 0x10100 };
+    static const uint32_t Channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    if (png.ColorType > 6 || png.BitDepth > 16 || !(Depths[png.ColorType] & (1u << png.BitDepth)))
+    {
+        return false;
+    }
+    png.Channels = Channels[png.ColorType];
+
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        png.Palette[i][0] = png.Palette[i][1] = png.Palette[i][2] = 0;
+        png.Palette[i][3] = 255;
+    }
+
+    // Chunks up to the first IDAT
+    for (;;)
+    {
+        uint8_t chunk[8];
+        if (!StreamRead(stream, chunk, sizeof(chunk)))
+        {
+            return false;
+        }
+        uint32_t length = ReadBe32(chunk);
+        if (length > PngMaxChunkLength)
+        {
+            return false;
+        }
+
+        if (memcmp(chunk + 4, "IDAT", 4) == 0)
+        {
+            png.IdatRemaining = length;
+            break;
+        }
+        else if (memcmp(chunk + 4, "PLTE", 4) == 0)
+        {
+            uint8_t entries[256 * 3];
+            if (length % 3 != 0 || length > sizeof(entries) || !StreamRead(stream, entries, length))
+            {
+                return false;
+            }
+            png.PaletteSize = length / 3;
+            for (uint32_t i = 0; i < png.PaletteSize; ++i)
+            {
+                memcpy(png.Palette[i], &entries[i * 3], 3);
+            }
+        }
+        else if (memcmp(chunk + 4, "tRNS", 4) == 0)
+        {
+            uint8_t values[256];
+            if (length > sizeof(values) || !StreamRead(stream, values, length))
+            {
+                return false;
+            }
+            if (png.ColorType == 3)
+            {
+                for (uint32_t i = 0; i < length; ++i)
+                {
+                    png.Palette[i][3] = values[i];
+                }
+            }
+            else if ((png.ColorType == 0 && length == 2) || (png.ColorType == 2 && length == 6))
+            {
+                png.HasColorKey = true;
+                for (uint32_t i = 0; i < length / 2; ++i)
+                {
+                    png.ColorKey[i] = (uint16_t)((values[i * 2] << 8) | values[i * 2 + 1]);
+                }
+            }
+        }
+        else if (memcmp(chunk + 4, "IEND", 4) == 0)
+        {
+            return false;
+        }
+        else if (!StreamSkip(stream, length))
+        {
+            return false;
+        }
+
+        // Every chunk but IDAT has its CRC skipped here
+        if (!StreamSkip(stream, 4))
+        {
+            return false;
+        }
+    }
+
+    if (png.ColorType == 3 && png.PaletteSize == 0)
+    {
+        return false;
+    }
+
+    size_t rowBytes = ((size_t)info->Width * png.Channels * png.BitDepth + 7) / 8;
+    decoder->Row.resize(rowBytes);
+    decoder->PreviousRow.resize(rowBytes);
+    decoder->Pixels.resize((size_t)info->Width * 4);
+    png.Inflate.Window.resize(WindowSize);
+    return true;
+}
+
+// Undoes the filter of one row in place
+static bool PngUnfilter(uint32_t filter, uint8_t* row, const uint8_t* above, size_t rowBytes, size_t pixelBytes)
+{
+    switch (filter)
+    {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = pixelBytes; i < rowBytes; ++i)
+        {
+            row[i] = (uint8_t)(row[i] + row[i - pixelBytes]);
+        }
+        break;
+    case 2:
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            row[i] = (uint8_t)(row[i] + above[i]);
+        }
+        break;
+    case 3:
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            uint32_t left = (i >= pixelBytes) ? row[i - pixelBytes] : 0;
+            row[i] = (uint8_t)(row[i] + ((left + above[i]) >> 1));
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            int32_t a = (i >= pixelBytes) ? row[i - pixelBytes] : 0;
+            int32_t b = above[i];
+            int32_t c = (i >= pixelBytes) ? above[i - pixelBytes] : 0;
+            int32_t p = a + b - c;
+            int32_t pa = abs(p - a);
+            int32_t pb = abs(p - b);
+            int32_t pc = abs(p - c);
+            int32_t predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            row[i] = (uint8_t)(row[i] + predictor);
+        }
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+// Sample 'index' of a row packed at under 8 bits
+static inline uint32_t PackedSample(const uint8_t* row, uint32_t index, uint32_t bits)
+{
+    uint32_t bit = index * bits;
+    return (row[bit >> 3] >> (8 - bits - (bit & 7))) & ((1u << bits) - 1);
+}
+
+// Converts 'count' unfiltered pixels to R8G8B8A8
+static void PngConvert(const PngState& png, const uint8_t* row, uint32_t count, uint8_t* out)
+{
+    uint32_t bits = png.BitDepth;
+    uint32_t step = (bits == 16) ? 2 : 1;
+    for (uint32_t i = 0; i < count; ++i, out += 4)
+    {
+        switch (png.ColorType)
+        {
+        case 0:
+        {
+            // The color key compares whole samples
+            uint32_t sample;
+            uint8_t value;
+            if (bits < 8)
+            {
+                sample = PackedSample(row, i, bits);
+                value = (uint8_t)(sample * 255 / ((1u << bits) - 1));
+            }
+            else
+            {
+                sample = (bits == 16) ? (((uint32_t)row[i * 2] << 8) | row[i * 2 + 1]) : row[i];
+                value = row[i * step];
+            }
+            out[0] = out[1] = out[2] = value;
+            out[3] = (png.HasColorKey && sample == png.ColorKey[0]) ? 0 : 255;
+            break;
+        }
+        case 2:
+        {
+            const uint8_t* p = &row[i * 3 * step];
+            out[0] = p[0];
+            out[1] = p[step];
+            out[2] = p[2 * step];
+            out[3] = 255;
+            if (png.HasColorKey)
+            {
+                bool key = true;
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    uint32_t sample = (bits == 16) ? (((uint32_t)p[c * 2] << 8) | p[c * 2 + 1]) : p[c];
+                    key = key && sample == png.ColorKey[c];
+                }
+                out[3] = key ? 0 : 255;
+            }
+            break;
+        }
+        case 3:
+        {
+            uint32_t index = (bits < 8) ? PackedSample(row, i, bits) : row[i];
+            static const uint8_t Invalid[4] = { 0, 0, 0, 255 };
+            memcpy(out, (index < png.PaletteSize) ? png.Palette[index] : Invalid, 4);
+            break;
+        }
+        case 4:
+        {
+            const uint8_t* p = &row[i * 2 * step];
+            out[0] = out[1] = out[2] = p[0];
+            out[3] = p[step];
+            break;
+        }
+        default:
+        {
+            const uint8_t* p = &row[i * 4 * step];
+            out[0] = p[0];
+            out[1] = p[step];
+            out[2] = p[2 * step];
+            out[3] = p[3 * step];
+            break;
+        }
+        }
+    }
+}
+
+static bool PngRead(ImageDecoder* decoder, const ImageFileInfo& info, uint8_t* target, size_t rowPitch)
+{
+    PngState& png = decoder->Png;
+    if (!InflateHeader(decoder))
+    {
+        return false;
+    }
+
+    uint32_t pixelBits = png.Channels * png.BitDepth;
+    size_t pixelBytes = std::max(pixelBits / 8, 1u);
+    uint32_t numPasses = png.Interlaced ? 7 : 1;
+    for (uint32_t pass = 0; pass < numPasses; ++pass)
+    {
+        static const uint32_t WholeImage[4] = { 0, 0, 1, 1 };
+        const uint32_t* p = png.Interlaced ? Adam7Passes[pass] : WholeImage;
+        uint32_t width = (info.Width > p[0]) ? (info.Width - p[0] + p[2] - 1) / p[2] : 0;
+        uint32_t height = (info.Height > p[1]) ? (info.Height - p[1] + p[3] - 1) / p[3] : 0;
+        if (width == 0 || height == 0)
+        {
+            continue;
+        }
+
+        // Each pass filters against a row of zeros above its first
+        size_t rowBytes = ((size_t)width * pixelBits + 7) / 8;
+        std::fill(decoder->PreviousRow.begin(), decoder->PreviousRow.begin() + rowBytes, (uint8_t)0);
+        for (uint32_t j = 0; j < height; ++j)
+        {
+            uint8_t filter;
+            if (!InflateRead(decoder, &filter, 1) || !InflateRead(decoder, decoder->Row.data(), rowBytes) ||
+                !PngUnfilter(filter, decoder->Row.data(), decoder->PreviousRow.data(), rowBytes, pixelBytes))
+            {
+                return false;
+            }
+
+            // Whole rows convert in place, and Adam7 rows scatter
+            uint8_t* out = TargetRow(target, rowPitch, p[1] + j * p[3]);
+            if (p[2] == 1)
+            {
+                PngConvert(png, decoder->Row.data(), width, out);
+            }
+            else
+            {
+                PngConvert(png, decoder->Row.data(), width, decoder->Pixels.data());
+                for (uint32_t i = 0; i < width; ++i)
+                {
+                    memcpy(out + (size_t)(p[0] + i * p[2]) * 4, &decoder->Pixels[(size_t)i * 4], 4);
+                }
+            }
+            decoder->Row.swap(decoder->PreviousRow);
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+// TGA
+//==============================================================================
+
+// One 15, 16, 24 or 32 bit BGR(A) pixel or color map entry to R8G8B8A8
+static inline void TgaColor(const uint8_t* p, uint32_t bits, bool alpha, uint8_t* out)
+{
+    if (bits <= 16)
+    {
+        uint32_t value = ReadLe16(p);
+        uint32_t r = (value >> 10) & 31;
+        uint32_t g = (value >> 5) & 31;
+        uint32_t b = value & 31;
+        out[0] = (uint8_t)((r << 3) | (r >> 2));
+        out[1] = (uint8_t)((g << 3) | (g >> 2));
+        out[2] = (uint8_t)((b << 3) | (b >> 2));
+        out[3] = (alpha && bits == 16 && !(value & 0x8000)) ? 0 : 255;
+    }
+    else
+    {
+        out[0] = p[2];
+        out[1] = p[1];
+        out[2] = p[0];
+        out[3] = (alpha && bits == 32) ? p[3] : 255;
+    }
+}
+
+static bool TgaOpen(ImageDecoder* decoder, ImageFileInfo* info)
+{
+    TgaState& tga = decoder->Tga;
+    FileStream* stream = &decoder->Stream;
+
+    uint8_t header[18];
+    if (!StreamRead(stream, header, sizeof(header)))
+    {
+        return false;
+    }
+    uint32_t idLength = header[0];
+    uint32_t colorMapType = header[1];
+    tga.ImageType = header[2];
+    uint32_t mapFirst = ReadLe16(header + 3);
+    uint32_t mapLength = ReadLe16(header + 5);
+    uint32_t mapBits = header[7];
+    info->Width = ReadLe16(header + 12);
+    info->Height = ReadLe16(header + 14);
+    tga.PixelBits = header[16];
+    tga.AttributeBits = header[17] & 15;
+    tga.RightToLeft = (header[17] & 0x10) != 0;
+    tga.TopDown = (header[17] & 0x20) != 0;
+
+    // Without a signature the header has to make sense instead
+    uint32_t type = tga.ImageType & ~8u;
+    bool valid = ValidDimensions(*info) && colorMapType <= 1 && (tga.ImageType & ~11u) == 0 && type >= 1;
+    valid = valid && ((type == 1 && colorMapType == 1 && tga.PixelBits == 8) ||
+        (type == 2 && (tga.PixelBits == 15 || tga.PixelBits == 16 || tga.PixelBits == 24 || tga.PixelBits == 32)) ||
+        (type == 3 && tga.PixelBits == 8));
+    valid = valid && (colorMapType == 0 || mapBits == 15 || mapBits == 16 || mapBits == 24 || mapBits == 32);
+    if (!valid || !StreamSkip(stream, idLength))
+    {
+        return false;
+    }
+
+    if (colorMapType == 1)
+    {
+        uint32_t entryBytes = (mapBits + 7) / 8;
+        if (type != 1)
+        {
+            if (!StreamSkip(stream, (size_t)mapLength * entryBytes))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (mapFirst + mapLength > 256)
+            {
+                return false;
+            }
+            memset(tga.Palette, 0, sizeof(tga.Palette));
+            for (uint32_t i = 0; i < mapLength; ++i)
+            {
+                uint8_t entry[4];
+                if (!StreamRead(stream, entry, entryBytes))
+                {
+                    return false;
+                }
+                TgaColor(entry, mapBits, true, tga.Palette[mapFirst + i]);
+            }
+        }
+    }
+
+    decoder->Row.resize((size_t)info->Width * ((tga.PixelBits + 7) / 8));
+    decoder->Pixels.resize((size_t)info->Width * 4);
+    return true;
+}
+
+static bool TgaRead(ImageDecoder* decoder, const ImageFileInfo& info, uint8_t* target, size_t rowPitch)
+{
+    TgaState& tga = decoder->Tga;
+    FileStream* stream = &decoder->Stream;
+    uint32_t pixelBytes = (tga.PixelBits + 7) / 8;
+    uint32_t type = tga.ImageType & ~8u;
+    bool rle = (tga.ImageType & 8) != 0;
+    bool alpha = tga.AttributeBits > 0;
+
+    for (uint32_t row = 0; row < info.Height; ++row)
+    {
+        // Raw rows are read whole. RLE packets may run on into the next row.
+        uint8_t* pixels = decoder->Row.data();
+        if (!rle)
+        {
+            if (!StreamRead(stream, pixels, (size_t)info.Width * pixelBytes))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            for (uint32_t x = 0; x < info.Width;)
+            {
+                if (tga.RunCount == 0)
+                {
+                    uint8_t packet = StreamByte(stream);
+                    tga.RunCount = (packet & 0x7f) + 1u;
+                    tga.RunRepeat = (packet & 0x80) != 0;
+                    if (tga.RunRepeat && !StreamRead(stream, tga.RunPixel, pixelBytes))
+                    {
+                        return false;
+                    }
+                }
+                uint32_t count = std::min(tga.RunCount, info.Width - x);
+                if (tga.RunRepeat)
+                {
+                    for (uint32_t i = 0; i < count; ++i)
+                    {
+                        memcpy(&pixels[(size_t)(x + i) * pixelBytes], tga.RunPixel, pixelBytes);
+                    }
+                }
+                else if (!StreamRead(stream, &pixels[(size_t)x * pixelBytes], (size_t)count * pixelBytes))
+                {
+                    return false;
+                }
+                x += count;
+                tga.RunCount -= count;
+            }
+            if (stream->Failed)
+            {
+                return false;
+            }
+        }
+
+        uint32_t y = tga.TopDown ? row : info.Height - 1 - row;
+        uint8_t* out = TargetRow(target, rowPitch, y);
+        for (uint32_t x = 0; x < info.Width; ++x)
+        {
+            const uint8_t* p = &pixels[(size_t)x * pixelBytes];
+            uint8_t* texel = out + (size_t)(tga.RightToLeft ? info.Width - 1 - x : x) * 4;
+            if (type == 1)
+            {
+                memcpy(texel, tga.Palette[p[0]], 4);
+            }
+            else if (type == 3)
+            {
+                texel[0] = texel[1] = texel[2] = p[0];
+                texel[3] = 255;
+            }
+            else
+            {
+                TgaColor(p, tga.PixelBits, alpha, texel);
+            }
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+// PGM and PPM
+//==============================================================================
+
+// The next decimal number of the header, past whitespace and comments
+static bool PnmNumber(FileStream* stream, uint32_t* value)
+{
+    uint8_t c = StreamByte(stream);
+    for (;;)
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != '\r' && !stream->Failed)
+            {
+                c = StreamByte(stream);
+            }
+        }
+        else if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f')
+        {
+            c = StreamByte(stream);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    uint64_t number = 0;
+    uint32_t digits = 0;
+    while (c >= '0' && c <= '9' && number <= MaxDimension * 4ull)
+    {
+        number = number * 10 + (c - '0');
+        ++digits;
+        c = StreamByte(stream);
+    }
+
+    // A single whitespace byte ends the number, and the last ends the header
+    *value = (uint32_t)number;
+    return digits > 0 && !stream->Failed && (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+static bool PnmOpen(ImageDecoder* decoder, ImageFileInfo* info)
+{
+    PnmState& pnm = decoder->Pnm;
+    FileStream* stream = &decoder->Stream;
+
+    uint8_t magic[2];
+    if (!StreamRead(stream, magic, sizeof(magic)) || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6'))
+    {
+        return false;
+    }
+    pnm.Channels = (magic[1] == '5') ? 1 : 3;
+
+    // The magic's own whitespace comes first, which PnmNumber skips over
+    if (!PnmNumber(stream, &info->Width) || !PnmNumber(stream, &info->Height) || !PnmNumber(stream, &pnm.MaxValue) ||
+        !ValidDimensions(*info) || pnm.MaxValue == 0 || pnm.MaxValue > 65535)
+    {
+        return false;
+    }
+
+    uint32_t sampleBytes = (pnm.MaxValue > 255) ? 2 : 1;
+    decoder->Row.resize((size_t)info->Width * pnm.Channels * sampleBytes);
+    return true;
+}
+
+static bool PnmRead(ImageDecoder* decoder, const ImageFileInfo& info, uint8_t* target, size_t rowPitch)
+{
+    PnmState& pnm = decoder->Pnm;
+    bool wide = pnm.MaxValue > 255;
+    uint32_t samples = info.Width * pnm.Channels;
+    for (uint32_t y = 0; y < info.Height; ++y)
+    {
+        uint8_t* row = decoder->Row.data();
+        if (!StreamRead(&decoder->Stream, row, decoder->Row.size()))
+        {
+            return false;
+        }
+
+        // Samples are big-endian when wide, and scale from the max value
+        uint8_t* out = TargetRow(target, rowPitch, y);
+        for (uint32_t i = 0; i < samples; ++i)
+        {
+            uint32_t sample = wide ? ((uint32_t)row[i * 2] << 8) | row[i * 2 + 1] : row[i];
+            uint8_t value = (pnm.MaxValue == 255) ? (uint8_t)sample :
+                (uint8_t)((std::min(sample, pnm.MaxValue) * 255 + pnm.MaxValue / 2) / pnm.MaxValue);
+            if (pnm.Channels == 1)
+            {
+                out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = value;
+                out[i * 4 + 3] = 255;
+            }
+            else
+            {
+                uint32_t x = i / 3;
+                out[x * 4 + i % 3] = value;
+                out[x * 4 + 3] = 255;
+            }
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+// DDS
+//==============================================================================
+static bool DdsOpen(ImageDecoder* decoder, ImageFileInfo* info)
+{
+    DdsState& dds = decoder->Dds;
+    FileStream* stream = &decoder->Stream;
+
+    uint8_t header[4 + DdsHeaderSize];
+    if (!StreamRead(stream, header, sizeof(header)) || memcmp(header, "DDS ", 4) != 0 ||
+        ReadLe32(header + 4) != DdsHeaderSize)
+    {
+        return false;
+    }
+    const uint8_t* h = header + 4;
+    info->Height = ReadLe32(h + 8);
+    info->Width = ReadLe32(h + 12);
+    info->NumLevels = std::max(ReadLe32(h + 24), 1u);
+    if (!ValidDimensions(*info))
+    {
+        return false;
+    }
+
+    const uint8_t* format = h + 72;
+    uint32_t flags = ReadLe32(format + 4);
+    dds.PixelBits = ReadLe32(format + 12);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        dds.Masks[i] = ReadLe32(format + 16 + i * 4);
+    }
+
+    if ((flags & DdsPixelFormatFourCC) && memcmp(format + 8, "DX10", 4) != 0)
+    {
+        // Legacy block compressed formats
+        if (memcmp(format + 8, "DXT1", 4) == 0)
+        {
+            info->PixelFormat = CpuFormat::BC1Unorm;
+        }
+        else if (memcmp(format + 8, "DXT5", 4) == 0)
+        {
+            info->PixelFormat = CpuFormat::BC3Unorm;
+        }
+        else
+        {
+            return false;
+        }
+        dds.PixelBits = 0;
+    }
+    else if (flags & DdsPixelFormatFourCC)
+    {
+        // The DX10 header's uncompressed 8 bit and BC1, BC3 and BC7 formats
+        uint8_t dx10[20];
+        if (!StreamRead(stream, dx10, sizeof(dx10)) || ReadLe32(dx10 + 4) != DdsResourceTexture2D)
+        {
+            return false;
+        }
+        dds.PixelBits = 32;
+        switch (ReadLe32(dx10))
+        {
+        case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+        case 29: // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+            dds.Masks[0] = 0xff;
+            dds.Masks[1] = 0xff00;
+            dds.Masks[2] = 0xff0000;
+            dds.Masks[3] = 0xff000000;
+            break;
+        case 87: // DXGI_FORMAT_B8G8R8A8_UNORM
+        case 91: // DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+        case 88: // DXGI_FORMAT_B8G8R8X8_UNORM
+        case 93: // DXGI_FORMAT_B8G8R8X8_UNORM_SRGB
+            dds.Masks[0] = 0xff0000;
+            dds.Masks[1] = 0xff00;
+            dds.Masks[2] = 0xff;
+            dds.Masks[3] = (ReadLe32(dx10) == 87 || ReadLe32(dx10) == 91) ? 0xff000000 : 0;
+            break;
+        case 71: // DXGI_FORMAT_BC1_UNORM
+        case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+            info->PixelFormat = CpuFormat::BC1Unorm;
+            dds.PixelBits = 0;
+            break;
+        case 77: // DXGI_FORMAT_BC3_UNORM
+        case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+            info->PixelFormat = CpuFormat::BC3Unorm;
+            dds.PixelBits = 0;
+            break;
+        case 98: // DXGI_FORMAT_BC7_UNORM
+        case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+            info->PixelFormat = CpuFormat::BC7Unorm;
+            dds.PixelBits = 0;
+            break;
+        default:
+            return false;
+        }
+    }
+    else
+    {
+        if (!(flags & DdsPixelFormatAlphaPixels) && !(flags & DdsPixelFormatAlpha))
+        {
+            dds.Masks[3] = 0;
+        }
+        if (!(flags & (DdsPixelFormatRgb | DdsPixelFormatLuminance)))
+        {
+            dds.Masks[0] = dds.Masks[1] = dds.Masks[2] = 0;
+        }
+        dds.Luminance = (flags & DdsPixelFormatLuminance) != 0;
+    }
+
+    // No more levels than a full chain
+    uint32_t fullLevels = 1;
+    while (LevelSize(info->Width, fullLevels - 1) > 1 || LevelSize(info->Height, fullLevels - 1) > 1)
+    {
+        ++fullLevels;
+    }
+    info->NumLevels = std::min(info->NumLevels, fullLevels);
+    if (dds.PixelBits == 0)
+    {
+        return true;
+    }
+
+    // Whole bytes per channel only
+    bool valid = dds.PixelBits == 8 || dds.PixelBits == 16 || dds.PixelBits == 24 || dds.PixelBits == 32;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        uint32_t mask = dds.Masks[i];
+        bool byte = (mask == 0xff || mask == 0xff00 || mask == 0xff0000 || mask == 0xff000000);
+        valid = valid && (mask == 0 || (byte && (dds.PixelBits == 32 || mask < (1u << dds.PixelBits))));
+    }
+    if (!valid)
+    {
+        return false;
+    }
+
+    decoder->Row.resize((size_t)info->Width * (dds.PixelBits / 8));
+    return true;
+}
+
+// Block compressed levels go into 'target' as they are, a row of blocks at a
+// time
+static bool DdsReadBlocks(ImageDecoder* decoder, CpuFormat format, uint32_t width, uint32_t height, uint8_t* target,
+    size_t rowPitch)
+{
+    size_t rowBytes = (size_t)((width + 3) / 4) * CpuFormatBytesPerBlock(format);
+    for (uint32_t y = 0; y < (height + 3) / 4; ++y)
+    {
+        if (!StreamRead(&decoder->Stream, TargetRow(target, rowPitch, y), rowBytes))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A level 'width' x 'height', the levels before it already read
+static bool DdsRead(ImageDecoder* decoder, uint32_t width, uint32_t height, uint8_t* target, size_t rowPitch)
+{
+    DdsState& dds = decoder->Dds;
+    uint32_t pixelBytes = dds.PixelBits / 8;
+    uint32_t shifts[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        shifts[i] = 0;
+        while (dds.Masks[i] && !((dds.Masks[i] >> shifts[i]) & 1))
+        {
+            ++shifts[i];
+        }
+    }
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint8_t* row = decoder->Row.data();
+        if (!StreamRead(&decoder->Stream, row, (size_t)width * pixelBytes))
+        {
+            return false;
+        }
+
+        uint8_t* out = TargetRow(target, rowPitch, y);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t value = 0;
+            memcpy(&value, &row[(size_t)x * pixelBytes], pixelBytes);
+            uint8_t channels[4];
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                channels[i] = dds.Masks[i] ? (uint8_t)((value & dds.Masks[i]) >> shifts[i]) : (i == 3 ? 255 : 0);
+            }
+            if (dds.Luminance)
+            {
+                channels[1] = channels[2] = channels[0];
+            }
+            memcpy(out + (size_t)x * 4, channels, 4);
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+bool ImageFileOpen(const char* filename, ImageFile* image)
+{
+    *image = ImageFile{};
+
+    FILE* file = OpenFile(filename, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    image->Info.PixelFormat = CpuFormat::R8G8B8A8Unorm;
+    image->Info.NumLevels = 1;
+    ImageDecoder* decoder = new ImageDecoder();
+    decoder->Stream.File = file;
+    decoder->Stream.Buffer.resize(ReadBufferSize);
+    image->Decoder = decoder;
+    if (!StreamFill(&decoder->Stream))
+    {
+        ImageFileClose(image);
+        return false;
+    }
+
+    // By signature, with TGA as the fallback
+    const uint8_t* start = decoder->Stream.Buffer.data();
+    size_t size = decoder->Stream.End;
+    bool result = false;
+    if (size >= sizeof(PngSignature) && memcmp(start, PngSignature, sizeof(PngSignature)) == 0)
+    {
+        image->Info.Format = ImageFormat::Png;
+        result = PngOpen(decoder, &image->Info);
+    }
+    else if (size >= 4 && memcmp(start, "DDS ", 4) == 0)
+    {
+        image->Info.Format = ImageFormat::Dds;
+        result = DdsOpen(decoder, &image->Info);
+    }
+    else if (size >= 2 && start[0] == 'P' && (start[1] == '5' || start[1] == '6'))
+    {
+        image->Info.Format = ImageFormat::Pnm;
+        result = PnmOpen(decoder, &image->Info);
+    }
+    else
+    {
+        image->Info.Format = ImageFormat::Tga;
+        result = TgaOpen(decoder, &image->Info);
+    }
+
+    if (!result)
+    {
+        ImageFileClose(image);
+        return false;
+    }
+    return true;
+}
+
+//==============================================================================
+void ImageFileClose(ImageFile* image)
+{
+    if (image->Decoder)
+    {
+        fclose(image->Decoder->Stream.File);
+        delete image->Decoder;
+    }
+    *image = ImageFile{};
+}
+
+//==============================================================================
+bool ImageFileRead(ImageFile* image, uint8_t* target, size_t rowPitch)
+{
+    ImageDecoder* decoder = image->Decoder;
+    const ImageFileInfo& info = image->Info;
+    uint32_t level = decoder ? decoder->LevelsRead : 0;
+    uint32_t width = LevelSize(info.Width, level);
+    uint32_t height = LevelSize(info.Height, level);
+    if (!decoder || level >= info.NumLevels || rowPitch < CpuFormatImageBytes(info.PixelFormat, width, 1))
+    {
+        assert(false);
+        return false;
+    }
+    ++decoder->LevelsRead;
+
+    switch (info.Format)
+    {
+    case ImageFormat::Png:
+        return PngRead(decoder, info, target, rowPitch);
+    case ImageFormat::Tga:
+        return TgaRead(decoder, info, target, rowPitch);
+    case ImageFormat::Pnm:
+        return PnmRead(decoder, info, target, rowPitch);
+    case ImageFormat::Dds:
+        return (decoder->Dds.PixelBits == 0) ? DdsReadBlocks(decoder, info.PixelFormat, width, height, target, rowPitch) :
+            DdsRead(decoder, width, height, target, rowPitch);
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+//==============================================================================
+bool ImageFileLoad(const char* filename, CpuTexture* texture)
+{
+    ImageFile image;
+    if (!ImageFileOpen(filename, &image))
+    {
+        return false;
+    }
+
+    if (!CpuTextureCreate(image.Info.Width, image.Info.Height, image.Info.PixelFormat, texture))
+    {
+        ImageFileClose(&image);
+        return false;
+    }
+
+    bool result = ImageFileRead(&image, texture->Data, texture->RowPitch);
+    ImageFileClose(&image);
+    if (!result)
+    {
+        CpuTextureDestroy(texture);
+    }
+    return result;
+}
+
+//==============================================================================
+bool ImageFileWriteDds(const char* filename, const CpuTexture* levels, uint32_t numLevels)
+{
+    CpuFormat format = levels[0].Format;
+    uint32_t dxgiFormat;
+    switch (format)
+    {
+    case CpuFormat::R8G8B8A8Unorm: dxgiFormat = 28; break;
+    case CpuFormat::BC1Unorm: dxgiFormat = 71; break;
+    case CpuFormat::BC3Unorm: dxgiFormat = 77; break;
+    case CpuFormat::BC7Unorm: dxgiFormat = 98; break;
+    default: dxgiFormat = 0; break;
+    }
+    bool valid = dxgiFormat != 0 && numLevels > 0;
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        valid = valid && levels[level].Format == format && levels[level].Width == LevelSize(levels[0].Width, level) &&
+            levels[level].Height == LevelSize(levels[0].Height, level);
+    }
+    if (!valid)
+    {
+        assert(false);
+        return false;
+    }
+
+    uint8_t header[4 + DdsHeaderSize + 20] = {};
+    memcpy(header, "DDS ", 4);
+    uint8_t* h = header + 4;
+    bool compressed = CpuFormatIsBlockCompressed(format);
+    WriteLe32(h, DdsHeaderSize);
+    WriteLe32(h + 4, DdsFlagsRequired | DdsFlagsMipMapCount | (compressed ? DdsFlagsLinearSize : DdsFlagsPitch));
+    WriteLe32(h + 8, levels[0].Height);
+    WriteLe32(h + 12, levels[0].Width);
+    WriteLe32(h + 16, (uint32_t)(compressed ? CpuFormatImageBytes(format, levels[0].Width, levels[0].Height) :
+        CpuFormatImageBytes(format, levels[0].Width, 1)));
+    WriteLe32(h + 24, numLevels);
+    WriteLe32(h + 72, 32);
+    WriteLe32(h + 76, DdsPixelFormatFourCC);
+    memcpy(h + 80, "DX10", 4);
+    WriteLe32(h + 104, DdsCapsTexture | (numLevels > 1 ? DdsCapsMipMap : 0));
+    uint8_t* dx10 = h + DdsHeaderSize;
+    WriteLe32(dx10, dxgiFormat);
+    WriteLe32(dx10 + 4, DdsResourceTexture2D);
+    WriteLe32(dx10 + 12, 1);    // Array size
+
+    FILE* file = OpenFile(filename, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool result = fwrite(header, sizeof(header), 1, file) == 1;
+    for (uint32_t level = 0; level < numLevels && result; ++level)
+    {
+        const CpuTexture& texture = levels[level];
+        uint32_t blockSize = CpuFormatBlockSize(format);
+        size_t rowBytes = (size_t)CpuFormatImageBytes(format, texture.Width, 1);
+        for (uint32_t y = 0; y < (texture.Height + blockSize - 1) / blockSize && result; ++y)
+        {
+            result = fwrite(texture.Data + (size_t)y * texture.RowPitch, rowBytes, 1, file) == 1;
+        }
+    }
+    result = (fclose(file) == 0) && result;
+    return result;
+}
+
+//==============================================================================
+// CRC-32 as PNG chunks use it
+static uint32_t PngCrc(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static const struct CrcTable
+    {
+        uint32_t Entries[256];
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (uint32_t k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                Entries[i] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table.Entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static inline void WriteBe32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static bool WritePngChunk(FILE* file, const char* type, const uint8_t* data, uint32_t size)
+{
+    uint8_t header[8];
+    uint8_t footer[4];
+    WriteBe32(header, size);
+    memcpy(header + 4, type, 4);
+    WriteBe32(footer, PngCrc(PngCrc(0, header + 4, 4), data, size));
+    return fwrite(header, sizeof(header), 1, file) == 1 && (size == 0 || fwrite(data, size, 1, file) == 1) &&
+        fwrite(footer, sizeof(footer), 1, file) == 1;
+}
+
+//==============================================================================
+bool ImageFileWritePng(const char* filename, const CpuTexture& image)
+{
+    // Stored deflate blocks, each its own IDAT chunk
+    static const uint32_t MaxStored = 65535;
+    uint32_t bytesPerPixel;
+    uint8_t colorType;
+    switch (image.Format)
+    {
+    case CpuFormat::R8G8B8A8Unorm: bytesPerPixel = 4; colorType = 6; break;
+    case CpuFormat::R16Unorm: bytesPerPixel = 2; colorType = 0; break;
+    default: bytesPerPixel = 0; colorType = 0; break;
+    }
+    if (bytesPerPixel == 0 || image.Width == 0 || image.Height == 0)
+    {
+        assert(false);
+        return false;
+    }
+
+    // The block being filled, from the thread's scratch so a frame capture
+    // writes without touching the heap
+    Arena* scratch = ThreadArena();
+    if (!scratch)
+    {
+        assert(false);
+        return false;
+    }
+    ArenaScope scope(scratch);
+    uint8_t* block = ArenaAllocArray<uint8_t>(scratch, 5 + MaxStored + 4);
+    if (!block)
+    {
+        assert(false);
+        return false;
+    }
+
+    FILE* file = OpenFile(filename, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    uint8_t ihdr[13] = {};
+    WriteBe32(ihdr, image.Width);
+    WriteBe32(ihdr + 4, image.Height);
+    ihdr[8] = (uint8_t)(bytesPerPixel == 2 ? 16 : 8);
+    ihdr[9] = colorType;
+    static const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+    bool result = fwrite(signature, sizeof(signature), 1, file) == 1 &&
+        WritePngChunk(file, "IHDR", ihdr, sizeof(ihdr)) &&
+        WritePngChunk(file, "IDAT", zlibHeader, sizeof(zlibHeader));
+
+    // Rows with filter type None. PNG samples are big endian, so 16 bit ones
+    // swap their bytes.
+    uint32_t stored = 0;
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    auto flush = [&](bool final)
+    {
+        block[0] = final ? 1 : 0;
+        block[1] = (uint8_t)stored;
+        block[2] = (uint8_t)(stored >> 8);
+        block[3] = (uint8_t)~stored;
+        block[4] = (uint8_t)(~stored >> 8);
+        for (uint32_t i = 0; i < stored; ++i)
+        {
+            adlerA = (adlerA + block[5 + i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        uint32_t size = 5 + stored;
+        if (final)
+        {
+            WriteBe32(block + size, (adlerB << 16) | adlerA);
+            size += 4;
+        }
+        result = result && WritePngChunk(file, "IDAT", block, size);
+        stored = 0;
+    };
+    size_t rowBytes = (size_t)image.Width * bytesPerPixel;
+    for (uint32_t y = 0; y < image.Height && result; ++y)
+    {
+        const uint8_t* row = image.Data + (size_t)y * image.RowPitch;
+        for (size_t i = 0; i <= rowBytes; ++i)
+        {
+            if (stored == MaxStored)
+            {
+                flush(false);
+            }
+            uint8_t value = 0;
+            if (i > 0)
+            {
+                size_t offset = i - 1;
+                value = row[(bytesPerPixel == 2) ? offset ^ 1 : offset];
+            }
+            block[5 + stored++] = value;
+        }
+    }
+    flush(true);
+    result = result && WritePngChunk(file, "IEND", nullptr, 0);
+    result = (fclose(file) == 0) && result;
+    return result;
+}
+
+//==============================================================================
+bool ImageFileWriteExr(const char* filename, const CpuTexture& image)
+{
+    // Channels in the alphabetical order EXR stores them, each with the texel
+    // component it comes from
+    struct ExrChannel
+    {
+        const char* Name;
+        uint32_t Component;
+    };
+    static const ExrChannel Rgba[] = { { "A", 3 }, { "B", 2 }, { "G", 1 }, { "R", 0 } };
+    static const ExrChannel Rg[] = { { "G", 1 }, { "R", 0 } };
+    static const ExrChannel Z[] = { { "Z", 0 } };
+    const ExrChannel* channels;
+    uint32_t numChannels;
+    switch (image.Format)
+    {
+    case CpuFormat::R8G8B8A8Unorm:
+    case CpuFormat::R32G32B32A32Float: channels = Rgba; numChannels = 4; break;
+    case CpuFormat::R32G32Float: channels = Rg; numChannels = 2; break;
+    case CpuFormat::R16Unorm:
+    case CpuFormat::R32Float: channels = Z; numChannels = 1; break;
+    default: channels = nullptr; numChannels = 0; break;
+    }
+    if (numChannels == 0 || image.Width == 0 || image.Height == 0)
+    {
+        assert(false);
+        return false;
+    }
+
+    // Header attributes: name, type, size and value. Both fit well within
+    // their arrays, whatever the channels.
+    uint8_t header[512] = { 0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0 };
+    size_t headerSize = 8;
+    auto append = [&header, &headerSize](const void* data, size_t size)
+    {
+        assert(headerSize + size <= sizeof(header));
+        memcpy(header + headerSize, data, size);
+        headerSize += size;
+    };
+    auto attribute = [&append](const char* name, const char* type, const void* value, uint32_t size)
+    {
+        append(name, strlen(name) + 1);
+        append(type, strlen(type) + 1);
+        uint8_t sizeBytes[4];
+        WriteLe32(sizeBytes, size);
+        append(sizeBytes, 4);
+        append(value, size);
+    };
+    uint8_t channelList[4 * (2 + 16) + 1];
+    uint32_t channelListSize = 0;
+    for (uint32_t c = 0; c < numChannels; ++c)
+    {
+        // FLOAT samples, not perceptually linear, sampled every pixel
+        uint8_t channel[16] = {};
+        WriteLe32(channel, 2);
+        WriteLe32(channel + 8, 1);
+        WriteLe32(channel + 12, 1);
+        size_t nameSize = strlen(channels[c].Name) + 1;
+        memcpy(channelList + channelListSize, channels[c].Name, nameSize);
+        memcpy(channelList + channelListSize + nameSize, channel, sizeof(channel));
+        channelListSize += (uint32_t)(nameSize + sizeof(channel));
+    }
+    channelList[channelListSize++] = 0;
+    uint8_t window[16] = {};
+    WriteLe32(window + 8, image.Width - 1);
+    WriteLe32(window + 12, image.Height - 1);
+    uint8_t none = 0;
+    uint8_t one[4];
+    float oneFloat = 1.f;
+    memcpy(one, &oneFloat, 4);
+    uint8_t center[8] = {};
+    attribute("channels", "chlist", channelList, channelListSize);
+    attribute("compression", "compression", &none, 1);
+    attribute("dataWindow", "box2i", window, sizeof(window));
+    attribute("displayWindow", "box2i", window, sizeof(window));
+    attribute("lineOrder", "lineOrder", &none, 1);
+    attribute("pixelAspectRatio", "float", one, sizeof(one));
+    attribute("screenWindowCenter", "v2f", center, sizeof(center));
+    attribute("screenWindowWidth", "float", one, sizeof(one));
+    header[headerSize++] = 0;
+
+    // Then a table of where each scanline starts, and the scanlines: y, size
+    // and a row of each channel in turn. The row is the thread's scratch, as
+    // the PNG writer's block.
+    uint32_t rowSize = image.Width * numChannels * 4;
+    uint64_t offset = headerSize + (uint64_t)image.Height * 8;
+    Arena* scratch = ThreadArena();
+    if (!scratch)
+    {
+        assert(false);
+        return false;
+    }
+    ArenaScope scope(scratch);
+    uint8_t* row = ArenaAllocArray<uint8_t>(scratch, 8 + (size_t)rowSize);
+    if (!row)
+    {
+        assert(false);
+        return false;
+    }
+    FILE* file = OpenFile(filename, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool result = fwrite(header, headerSize, 1, file) == 1;
+    for (uint32_t y = 0; y < image.Height && result; ++y)
+    {
+        WriteLe32(row, (uint32_t)offset);
+        WriteLe32(row + 4, (uint32_t)(offset >> 32));
+        result = fwrite(row, 8, 1, file) == 1;
+        offset += 8 + rowSize;
+    }
+    uint32_t bytesPerTexel = CpuFormatBytesPerTexel(image.Format);
+    for (uint32_t y = 0; y < image.Height && result; ++y)
+    {
+        const uint8_t* source = image.Data + (size_t)y * image.RowPitch;
+        WriteLe32(row, y);
+        WriteLe32(row + 4, rowSize);
+        uint8_t* target = row + 8;
+        for (uint32_t c = 0; c < numChannels; ++c)
+        {
+            for (uint32_t x = 0; x < image.Width; ++x, target += 4)
+            {
+                const uint8_t* texel = source + x * bytesPerTexel;
+                float value;
+                switch (image.Format)
+                {
+                case CpuFormat::R8G8B8A8Unorm:
+                    value = texel[channels[c].Component] / 255.f;
+                    break;
+                case CpuFormat::R16Unorm:
+                    value = ReadLe16(texel) / 65535.f;
+                    break;
+                default:
+                    memcpy(&value, texel + channels[c].Component * 4, 4);
+                    break;
+                }
+                memcpy(target, &value, 4);
+            }
+        }
+        result = fwrite(row, 8 + (size_t)rowSize, 1, file) == 1;
+    }
+    result = (fclose(file) == 0) && result;
+    return result;
+}
+
+//==============================================================================
+const char* ImageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::Png:
+        return "PNG";
+    case ImageFormat::Tga:
+        return "TGA";
+    case ImageFormat::Pnm:
+        return "PNM";
+    case ImageFormat::Dds:
+        return "DDS";
+    default:
+        assert(false);
+        return "";
+    }
+}
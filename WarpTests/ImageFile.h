@@ -0,0 +1,86 @@
+//==============================================================================
+// Portable image file loading, for PNG, TGA, binary PGM/PPM and uncompressed
+// DDS. The file is read through a small fixed buffer and decoded a row at a
+// time straight into the caller's memory as R8G8B8A8Unorm, so a texture
+// upload can decode into mapped staging memory with no whole-image copy in
+// between. Only the standard C library is used, so it runs anywhere, bar
+// the Windows call that widens UTF-8 filenames.
+//
+// PNG covers every color type and bit depth, palettes, tRNS and Adam7, with
+// its own inflate. 16 bit samples keep their high byte. CRCs and the zlib
+// Adler-32 aren't checked. TGA covers color-mapped, true-color and grayscale,
+// raw or RLE, in either row order. DDS covers the mips of the first image, for
+// 8 bit per channel RGB(A) and luminance formats, and BC1, BC3 and BC7, which
+// are read as they're stored rather than decoded. DDS files can be written
+// too, with their mips, and so can uncompressed PNG and OpenEXR, for frame
+// captures.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class ImageFormat
+{
+    Png,
+    Tga,
+    Pnm,
+    Dds,
+};
+
+struct ImageFileInfo
+{
+    uint32_t Width;
+    uint32_t Height;
+    ImageFormat Format;
+    CpuFormat PixelFormat;  // What ImageFileRead gives, R8G8B8A8Unorm or block compressed
+    uint32_t NumLevels;     // Mips in the file, from level 0. 1 but for DDS.
+};
+
+// Per-format decoding state, private to ImageFile.cpp
+struct ImageDecoder;
+
+struct ImageFile
+{
+    ImageFileInfo Info;
+    ImageDecoder* Decoder;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Opens 'filename', in UTF-8, and reads its header into 'image->Info'. The
+// format comes from the file's signature, and files without one are tried as
+// TGA. Images wider or taller than 16384 pixels are refused.
+bool ImageFileOpen(const char* filename, ImageFile* image);
+void ImageFileClose(ImageFile* image);
+
+// Decodes the next mip level into 'target' in 'Info.PixelFormat', rows (of
+// blocks, for block compressed formats) 'rowPitch' bytes apart, top row
+// first. Call once per level, level 0 first, for up to 'Info.NumLevels'.
+bool ImageFileRead(ImageFile* image, uint8_t* target, size_t rowPitch);
+
+// Opens, creates 'texture' in 'Info.PixelFormat' to fit and reads level 0
+bool ImageFileLoad(const char* filename, CpuTexture* texture);
+
+// Writes 'numLevels' mips, from level 0 down and sized like MipLevelSize, to a
+// DDS file. The levels share a format, R8G8B8A8Unorm or block compressed.
+bool ImageFileWriteDds(const char* filename, const CpuTexture* levels, uint32_t numLevels);
+
+// Writes 'image' as a PNG of stored deflate blocks, so writing costs little
+// more than the disk: R8G8B8A8Unorm as 8 bit RGBA, and R16Unorm as 16 bit
+// grayscale.
+bool ImageFileWritePng(const char* filename, const CpuTexture& image);
+
+// Writes 'image' as an uncompressed scanline OpenEXR file of 32 bit float
+// channels: R, G, B and A from four component formats, R and G from two, and
+// Z from one, taken as depth. Unorm formats are scaled to [0, 1], and 8 bit
+// color stays in sRGB.
+bool ImageFileWriteExr(const char* filename, const CpuTexture& image);
+
+const char* ImageFormatName(ImageFormat format);
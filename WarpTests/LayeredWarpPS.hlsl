@@ -0,0 +1,3 @@
+// Build-time copy of the layered warp permutation
+#define LAYERED 1
+#include "WarpPS.hlsli"
@@ -0,0 +1,146 @@
+//==============================================================================
+#include "LensDistortion.h"
+#include <assert.h>
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline void NdcToTexCoord(float x, float y, float* u, float* v)
+{
+    *u = x * 0.5f + 0.5f;
+    *v = 0.5f - y * 0.5f;
+}
+
+// Matches Load(int3(texCoord * TextureSize, 0)) in the warp shaders
+static inline float LoadDepth(const CpuTexture& depth, float u, float v)
+{
+    assert(depth.Format == CpuFormat::R32Float);
+
+    int32_t x = (int32_t)(u * depth.Width);
+    int32_t y = (int32_t)(v * depth.Height);
+    if (x < 0 || y < 0 || x >= (int32_t)depth.Width || y >= (int32_t)depth.Height)
+    {
+        return 0.f;
+    }
+    return ((const float*)(depth.Data + (size_t)y * depth.RowPitch))[x];
+}
+
+//==============================================================================
+void LensDistortionMap(const LensDistortion& lens, float x, float y, float out[3][2])
+{
+    float ry = y / lens.AspectRatio;
+    float r2 = x * x + ry * ry;
+    float scale = (1.f + r2 * (lens.K1 + r2 * lens.K2)) * lens.FillScale;
+
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        float chroma = 1.f + lens.Chroma[c][0] + lens.Chroma[c][1] * r2;
+        out[c][0] = x * scale * chroma;
+        out[c][1] = y * scale * chroma;
+    }
+}
+
+//==============================================================================
+void LensDistortionCreateMesh(const LensDistortion& lens, uint32_t vertsWidth, uint32_t vertsHeight,
+    DistortionWarpVertex* vertices)
+{
+    assert(vertsWidth > 1 && vertsHeight > 1);
+
+    for (uint32_t y = 0; y < vertsHeight; ++y)
+    {
+        for (uint32_t x = 0; x < vertsWidth; ++x)
+        {
+            DistortionWarpVertex& vertex = vertices[y * vertsWidth + x];
+            vertex.Position[0] = x / (float)(vertsWidth - 1) * 2.f - 1.f;
+            vertex.Position[1] = 1.f - y / (float)(vertsHeight - 1) * 2.f;
+
+            float undistorted[3][2];
+            LensDistortionMap(lens, vertex.Position[0], vertex.Position[1], undistorted);
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                NdcToTexCoord(undistorted[c][0], undistorted[c][1], &vertex.TexCoord[c][0], &vertex.TexCoord[c][1]);
+            }
+        }
+    }
+}
+
+//==============================================================================
+bool WarpUnproject(const float twMatrix[16], float z, float x, float y, float* outX, float* outY)
+{
+    // Row vectors: (x, y, z, 1) * M. With z fixed only the x, y and w columns
+    // matter, giving a 3x3 homography with these rows.
+    const float* m = twMatrix;
+    float r0[3] = { m[0], m[1], m[3] };
+    float r1[3] = { m[4], m[5], m[7] };
+    float r2[3] = { z * m[8] + m[12], z * m[9] + m[13], z * m[11] + m[15] };
+
+    // Columns of the adjugate are cross products of the rows
+    float c0[3] = { r1[1] * r2[2] - r1[2] * r2[1], r1[2] * r2[0] - r1[0] * r2[2], r1[0] * r2[1] - r1[1] * r2[0] };
+    float c1[3] = { r2[1] * r0[2] - r2[2] * r0[1], r2[2] * r0[0] - r2[0] * r0[2], r2[0] * r0[1] - r2[1] * r0[0] };
+    float c2[3] = { r0[1] * r1[2] - r0[2] * r1[1], r0[2] * r1[0] - r0[0] * r1[2], r0[0] * r1[1] - r0[1] * r1[0] };
+
+    float w = x * c2[0] + y * c2[1] + c2[2];
+    if (w == 0.f)
+    {
+        return false;
+    }
+
+    *outX = (x * c0[0] + y * c0[1] + c0[2]) / w;
+    *outY = (x * c1[0] + y * c1[1] + c1[2]) / w;
+    return true;
+}
+
+//==============================================================================
+void LensDistortionReferenceWarp(const float twMatrix[16], const LensDistortion& lens, const CpuTexture& source,
+    const CpuTexture* sourceDepth, const CpuSampler& sampler, CpuTexture* target)
+{
+    alignas(32) float u[3][SimdWidth];
+    alignas(32) float v[3][SimdWidth];
+
+    for (uint32_t py = 0; py < target->Height; ++py)
+    {
+        float y = 1.f - (py + 0.5f) / target->Height * 2.f;
+
+        for (uint32_t px = 0; px < target->Width; px += SimdWidth)
+        {
+            uint32_t count = target->Width - px < SimdWidth ? target->Width - px : SimdWidth;
+
+            for (uint32_t lane = 0; lane < SimdWidth; ++lane)
+            {
+                float x = (px + lane + 0.5f) / target->Width * 2.f - 1.f;
+
+                float undistorted[3][2];
+                LensDistortionMap(lens, x, y, undistorted);
+
+                float z = 0.5f;
+                if (sourceDepth)
+                {
+                    // Same depth selection as the positional distorted warp shader
+                    float gu, gv;
+                    NdcToTexCoord(undistorted[1][0], undistorted[1][1], &gu, &gv);
+                    z = LoadDepth(*sourceDepth, gu, gv);
+                }
+
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    float sx = -2.f;
+                    float sy = -2.f;
+                    WarpUnproject(twMatrix, z, undistorted[c][0], undistorted[c][1], &sx, &sy);
+                    NdcToTexCoord(sx, sy, &u[c][lane], &v[c][lane]);
+                }
+            }
+
+            SimdFloat color[4];
+            SimdFloat sample[4];
+            CpuTextureSample(source, sampler, SimdLoad(u[0]), SimdLoad(v[0]), sample);
+            color[0] = sample[0];
+            CpuTextureSample(source, sampler, SimdLoad(u[2]), SimdLoad(v[2]), sample);
+            color[2] = sample[2];
+            CpuTextureSample(source, sampler, SimdLoad(u[1]), SimdLoad(v[1]), sample);
+            color[1] = sample[1];
+            color[3] = sample[3];
+
+            CpuTextureStoreRow(target, px, py, count, SimdFirstLanes(count), color);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+//==============================================================================
+// Barrel distortion and chromatic aberration for the warp grid. The grid is
+// laid out regularly in display space, and each vertex stores where each color
+// channel samples the undistorted image. The warp shaders then only need to
+// undo the timewarp on those texcoords, so warp and distortion happen in one
+// pass.
+//
+// The reference warp evaluates the same mapping exactly at every pixel, for
+// validating the mesh and shaders against.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct LensDistortion
+{
+    // Radial scale of the undistorted image: 1 + K1 * r^2 + K2 * r^4, with r
+    // measured from the display center in units of half the display width
+    float K1;
+    float K2;
+    // Additional per-channel (R, G, B) radial scale: 1 + Chroma[c][0] + Chroma[c][1] * r^2
+    float Chroma[3][2];
+    float AspectRatio;  // Display width / height
+    float FillScale;    // Scale applied after distortion, < 1 to show more of the image
+};
+
+struct DistortionWarpVertex
+{
+    float Position[2];      // Display position in NDC
+    float TexCoord[3][2];   // Undistorted texcoords for R, G and B
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Maps a display position to the undistorted position of each channel, both in NDC
+void LensDistortionMap(const LensDistortion& lens, float x, float y, float out[3][2]);
+
+// Fills a vertsWidth x vertsHeight grid, rows from the top of the display.
+// The vertex order matches the undistorted warp grid, so its index buffer can
+// be shared.
+void LensDistortionCreateMesh(const LensDistortion& lens, uint32_t vertsWidth, uint32_t vertsHeight,
+    DistortionWarpVertex* vertices);
+
+// Inverts the warp on the plane at depth 'z': returns the NDC position that
+// 'twMatrix' (row-major, as stored in the warp constant buffer) moves onto
+// (x, y). Returns false if the plane is degenerate under the warp.
+bool WarpUnproject(const float twMatrix[16], float z, float x, float y, float* outX, float* outY);
+
+// Renders the distorted warp of 'source' into 'target', evaluating the full
+// mapping at every pixel center. 'sourceDepth' enables the positional warp,
+// and is null for the rotational warp.
+void LensDistortionReferenceWarp(const float twMatrix[16], const LensDistortion& lens, const CpuTexture& source,
+    const CpuTexture* sourceDepth, const CpuSampler& sampler, CpuTexture* target);
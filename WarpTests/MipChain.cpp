@@ -0,0 +1,392 @@
+//==============================================================================
+#include "MipChain.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Kaiser window half width in target texels, and its shape
+static const float KaiserRadius = 2.f;
+static const float KaiserBeta = 4.f;
+
+// Most source texels one target texel reads along an axis. Levels halve, so a
+// target texel covers at most 3 source texels (3 down to 1).
+static const uint32_t MaxTaps = 13;
+
+// The sRGB encode table covers linear values from 2^-13 up, in steps of 2^-11
+// of each power of two. Anything smaller encodes to 0.
+static const uint32_t EncodeMinBits = 0x39000000;   // 2^-13
+static const uint32_t EncodeShift = 12;
+static const uint32_t EncodeSize = ((0x3F800000 - EncodeMinBits) >> EncodeShift) + 1;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// Source texels and weights for one target texel along one axis
+struct MipTaps
+{
+    uint32_t Count;
+    int32_t Index[MaxTaps];
+    float Weight[MaxTaps];
+};
+
+struct SrgbTables
+{
+    float Decode[256];
+    uint8_t Encode[EncodeSize];
+
+    SrgbTables();
+};
+
+// Linear rows of the level being read, converted as the filter reaches them.
+// Rows sit in slot 'row % MaxTaps', which the rows one target row reads never
+// share.
+struct SourceRows
+{
+    const CpuTexture* Level;
+    std::vector<float> Rows;
+    int32_t Cached[MaxTaps];
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static float SrgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+}
+
+SrgbTables::SrgbTables()
+{
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        Decode[i] = SrgbToLinear(i / 255.f);
+    }
+
+    // Each entry encodes the middle of its step
+    for (uint32_t i = 0; i < EncodeSize; ++i)
+    {
+        uint32_t bits = EncodeMinBits + (i << EncodeShift) + (1u << (EncodeShift - 1));
+        float c;
+        memcpy(&c, &bits, sizeof(c));
+        float encoded = LinearToSrgb(std::min(c, 1.f)) * 255.f + 0.5f;
+        Encode[i] = (uint8_t)std::min(encoded, 255.f);
+    }
+}
+
+static const SrgbTables& GetSrgbTables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+// Zeroth order modified Bessel function of the first kind
+static double BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (uint32_t k = 1; k < 32; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+// 'x' in target texels
+static double KaiserWeight(double x)
+{
+    const double pi = 3.14159265358979323846;
+    double t = x / KaiserRadius;
+    if (t <= -1.0 || t >= 1.0)
+    {
+        return 0.0;
+    }
+    double sinc = (x == 0.0) ? 1.0 : sin(pi * x) / (pi * x);
+    return sinc * BesselI0(KaiserBeta * sqrt(1.0 - t * t)) / BesselI0(KaiserBeta);
+}
+
+// Taps for each of 'target' texels along an axis of 'source' texels. Texels
+// past the edge read the edge texel.
+static void BuildTaps(MipFilter filter, uint32_t source, uint32_t target, std::vector<MipTaps>* taps)
+{
+    taps->resize(target);
+    double scale = (double)source / target;
+
+    for (uint32_t d = 0; d < target; ++d)
+    {
+        MipTaps& tap = (*taps)[d];
+        tap.Count = 0;
+
+        if (source == target)
+        {
+            tap.Count = 1;
+            tap.Index[0] = (int32_t)d;
+            tap.Weight[0] = 1.f;
+            continue;
+        }
+
+        double weights[MaxTaps];
+        double sum = 0.0;
+        if (filter == MipFilter::Box)
+        {
+            // Overlap of each source texel with the footprint
+            double begin = d * scale;
+            double end = std::min((d + 1) * scale, (double)source);
+            for (int32_t i = (int32_t)floor(begin); i < (int32_t)ceil(end); ++i)
+            {
+                weights[tap.Count] = std::min(end, i + 1.0) - std::max(begin, (double)i);
+                tap.Index[tap.Count++] = i;
+            }
+        }
+        else
+        {
+            // Source texel centers within the window around the target's
+            double center = (d + 0.5) * scale;
+            double radius = KaiserRadius * scale;
+            int32_t first = (int32_t)ceil(center - 0.5 - radius);
+            int32_t last = (int32_t)floor(center - 0.5 + radius);
+            for (int32_t i = first; i <= last; ++i)
+            {
+                double weight = KaiserWeight((i + 0.5 - center) / scale);
+                if (weight == 0.0)
+                {
+                    continue;
+                }
+                weights[tap.Count] = weight;
+                tap.Index[tap.Count++] = std::min(std::max(i, 0), (int32_t)source - 1);
+            }
+        }
+        assert(tap.Count <= MaxTaps);
+
+        for (uint32_t k = 0; k < tap.Count; ++k)
+        {
+            sum += weights[k];
+        }
+        for (uint32_t k = 0; k < tap.Count; ++k)
+        {
+            tap.Weight[k] = (float)(weights[k] / sum);
+        }
+    }
+}
+
+static inline float* FloatRow(std::vector<float>& rows, uint32_t slot, uint32_t width)
+{
+    return rows.data() + (size_t)slot * width * 4;
+}
+
+// Row 'y' of the source level as linear color times alpha, and alpha
+static const float* GetSourceRow(SourceRows* source, int32_t y)
+{
+    const CpuTexture& level = *source->Level;
+    uint32_t slot = (uint32_t)y % MaxTaps;
+    float* out = FloatRow(source->Rows, slot, level.Width);
+    if (source->Cached[slot] == y)
+    {
+        return out;
+    }
+
+    const float* decode = GetSrgbTables().Decode;
+    const __m128 alphaScale = _mm_set1_ps(1.f / 255.f);
+    const uint8_t* row = level.Data + (size_t)y * level.RowPitch;
+    for (uint32_t x = 0; x < level.Width; ++x)
+    {
+        const uint8_t* p = row + x * 4;
+        __m128 alpha = _mm_mul_ps(_mm_set1_ps((float)p[3]), alphaScale);
+        __m128 color = _mm_setr_ps(decode[p[0]], decode[p[1]], decode[p[2]], 1.f);
+        _mm_storeu_ps(out + x * 4, _mm_mul_ps(color, alpha));
+    }
+
+    source->Cached[slot] = y;
+    return out;
+}
+
+// Back to straight alpha and sRGB
+static inline void EncodeTexel(__m128 color, uint8_t* out)
+{
+    const uint8_t* encode = GetSrgbTables().Encode;
+
+    color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    float alpha = _mm_cvtss_f32(_mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3)));
+    if (alpha > 0.f)
+    {
+        color = _mm_min_ps(_mm_div_ps(color, _mm_set1_ps(alpha)), _mm_set1_ps(1.f));
+    }
+
+    // Table index from the float bits, with small values clamped up to the
+    // first entry
+    __m128i bits = _mm_castps_si128(_mm_max_ps(color, _mm_castsi128_ps(_mm_set1_epi32((int32_t)EncodeMinBits))));
+    __m128i index = _mm_srli_epi32(_mm_sub_epi32(bits, _mm_set1_epi32((int32_t)EncodeMinBits)), EncodeShift);
+    uint32_t smallMask = (uint32_t)_mm_movemask_ps(_mm_cmplt_ps(color, _mm_castsi128_ps(_mm_set1_epi32((int32_t)EncodeMinBits))));
+
+    out[0] = (smallMask & 1) ? 0 : encode[_mm_extract_epi32(index, 0)];
+    out[1] = (smallMask & 2) ? 0 : encode[_mm_extract_epi32(index, 1)];
+    out[2] = (smallMask & 4) ? 0 : encode[_mm_extract_epi32(index, 2)];
+    out[3] = (uint8_t)(alpha * 255.f + 0.5f);
+}
+
+// Filters 'source' into 'target' one target row at a time
+static void FilterLevel(MipFilter filter, const CpuTexture& source, CpuTexture* target)
+{
+    std::vector<MipTaps> tapsX;
+    std::vector<MipTaps> tapsY;
+    BuildTaps(filter, source.Width, target->Width, &tapsX);
+    BuildTaps(filter, source.Height, target->Height, &tapsY);
+
+    SourceRows rows;
+    rows.Level = &source;
+    rows.Rows.resize((size_t)MaxTaps * source.Width * 4);
+    std::fill(rows.Cached, rows.Cached + MaxTaps, -1);
+
+    std::vector<float> column((size_t)source.Width * 4);
+
+    for (uint32_t y = 0; y < target->Height; ++y)
+    {
+        // Vertically, across every source column
+        const MipTaps& tapY = tapsY[y];
+        const float* first = GetSourceRow(&rows, tapY.Index[0]);
+        __m128 weight = _mm_set1_ps(tapY.Weight[0]);
+        for (uint32_t x = 0; x < source.Width; ++x)
+        {
+            _mm_storeu_ps(&column[x * 4], _mm_mul_ps(_mm_loadu_ps(first + x * 4), weight));
+        }
+        for (uint32_t k = 1; k < tapY.Count; ++k)
+        {
+            const float* row = GetSourceRow(&rows, tapY.Index[k]);
+            weight = _mm_set1_ps(tapY.Weight[k]);
+            for (uint32_t x = 0; x < source.Width; ++x)
+            {
+                __m128 sum = _mm_loadu_ps(&column[x * 4]);
+                _mm_storeu_ps(&column[x * 4], _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + x * 4), weight)));
+            }
+        }
+
+        // Then horizontally
+        uint8_t* out = target->Data + (size_t)y * target->RowPitch;
+        for (uint32_t x = 0; x < target->Width; ++x)
+        {
+            const MipTaps& tapX = tapsX[x];
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t k = 0; k < tapX.Count; ++k)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&column[tapX.Index[k] * 4]), _mm_set1_ps(tapX.Weight[k])));
+            }
+            EncodeTexel(sum, out + x * 4);
+        }
+    }
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+uint32_t MipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t size = std::max(width, height);
+    uint32_t count = 1;
+    while (size > 1)
+    {
+        size /= 2;
+        ++count;
+    }
+    return count;
+}
+
+//==============================================================================
+uint32_t MipLevelSize(uint32_t size, uint32_t level)
+{
+    return std::max(size >> level, 1u);
+}
+
+//==============================================================================
+bool MipChainGenerate(MipFilter filter, CpuTexture* levels, uint32_t numLevels)
+{
+    if (numLevels == 0 || numLevels > MipLevelCount(levels[0].Width, levels[0].Height))
+    {
+        assert(false);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numLevels; ++i)
+    {
+        if (levels[i].Format != CpuFormat::R8G8B8A8Unorm ||
+            levels[i].Width != MipLevelSize(levels[0].Width, i) ||
+            levels[i].Height != MipLevelSize(levels[0].Height, i))
+        {
+            assert(false);
+            return false;
+        }
+    }
+
+    if (filter == MipFilter::None)
+    {
+        return true;
+    }
+
+    for (uint32_t i = 1; i < numLevels; ++i)
+    {
+        FilterLevel(filter, levels[i - 1], &levels[i]);
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool CpuMipChainCreate(uint32_t width, uint32_t height, uint32_t numLevels, CpuFormat format, CpuMipChain* chain)
+{
+    *chain = CpuMipChain{};
+    if (numLevels == 0 || numLevels > MipLevelCount(width, height))
+    {
+        assert(false);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numLevels; ++i)
+    {
+        if (!CpuTextureCreate(MipLevelSize(width, i), MipLevelSize(height, i), format, &chain->Levels[i]))
+        {
+            assert(false);
+            CpuMipChainDestroy(chain);
+            return false;
+        }
+        chain->NumLevels = i + 1;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void CpuMipChainDestroy(CpuMipChain* chain)
+{
+    for (uint32_t i = 0; i < chain->NumLevels; ++i)
+    {
+        CpuTextureDestroy(&chain->Levels[i]);
+    }
+    chain->NumLevels = 0;
+}
+
+//==============================================================================
+const char* MipFilterName(MipFilter filter)
+{
+    switch (filter)
+    {
+    case MipFilter::None: return "None";
+    case MipFilter::Box: return "Box";
+    case MipFilter::Kaiser: return "Kaiser";
+    }
+    return "";
+}
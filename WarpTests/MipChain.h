@@ -0,0 +1,56 @@
+//==============================================================================
+// Mip chain generation for R8G8B8A8Unorm images, so minified textures don't
+// alias. Level sizes round down like a D3D11 mip chain, to 1x1.
+//
+// Color is taken as sRGB and filtered as linear light, weighted by alpha so
+// transparent texels don't bleed into their neighbors. Each level is filtered
+// from the one above it, a row at a time with SSE, so the scratch memory is a
+// few rows wide however big the image is. On odd sizes the filter footprint
+// stretches to cover every source texel.
+//
+// Box averages the footprint. Kaiser is a Kaiser-windowed sinc two target
+// texels wide, which keeps more detail for a little ringing.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class MipFilter
+{
+    None,       // Level 0 only
+    Box,
+    Kaiser,
+};
+
+// Enough for 16384 x 16384, the largest ImageFile opens
+static const uint32_t MipMaxLevels = 15;
+
+// A whole chain of levels in one format, R8G8B8A8Unorm for MipChainGenerate
+struct CpuMipChain
+{
+    uint32_t NumLevels;
+    CpuTexture Levels[MipMaxLevels];
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Levels in a full chain down to 1x1
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// Width or height of 'level' for a level 0 of 'size'
+uint32_t MipLevelSize(uint32_t size, uint32_t level);
+
+// Fills levels 1 up from level 0. Each level must be R8G8B8A8Unorm and sized
+// by MipLevelSize.
+bool MipChainGenerate(MipFilter filter, CpuTexture* levels, uint32_t numLevels);
+
+bool CpuMipChainCreate(uint32_t width, uint32_t height, uint32_t numLevels, CpuFormat format, CpuMipChain* chain);
+void CpuMipChainDestroy(CpuMipChain* chain);
+
+const char* MipFilterName(MipFilter filter);
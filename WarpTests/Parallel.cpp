@@ -0,0 +1,151 @@
+//==============================================================================
+#include "Parallel.h"
+#include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+// Globals
+//==============================================================================
+static std::vector<std::thread> Workers;
+static std::thread::id Owner;         // The thread jobs are started from
+static std::mutex Mutex;
+static std::condition_variable WorkReady;
+static std::condition_variable WorkDone;
+static bool Exiting = false;
+
+// The current job. Generation changes once per ParallelFor so sleeping workers
+// can tell a new job from a spurious wakeup.
+static uint64_t Generation = 0;
+static ParallelBody JobBody = nullptr;
+static void* JobContext = nullptr;
+static uint32_t JobCount = 0;
+static uint32_t JobGrain = 0;
+static std::atomic<uint32_t> JobNext;
+static uint32_t WorkersBusy = 0;
+
+// Set on threads running a body, so nested calls run serially
+static thread_local bool InsideJob = false;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static void RunChunks()
+{
+    InsideJob = true;
+    for (;;)
+    {
+        uint32_t begin = JobNext.fetch_add(JobGrain);
+        if (begin >= JobCount)
+        {
+            break;
+        }
+        uint32_t end = (JobCount - begin < JobGrain) ? JobCount : begin + JobGrain;
+        JobBody(begin, end, JobContext);
+    }
+    InsideJob = false;
+}
+
+static void WorkerMain()
+{
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            WorkReady.wait(lock, [&]() { return Exiting || Generation != seen; });
+            if (Exiting)
+            {
+                return;
+            }
+            seen = Generation;
+        }
+
+        RunChunks();
+
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (--WorkersBusy == 0)
+        {
+            WorkDone.notify_one();
+        }
+    }
+}
+
+//==============================================================================
+bool ParallelInit(uint32_t numThreads)
+{
+    ParallelShutdown();
+
+    if (numThreads == 0)
+    {
+        numThreads = std::thread::hardware_concurrency();
+    }
+
+    Exiting = false;
+    Owner = std::this_thread::get_id();
+    for (uint32_t i = 1; i < numThreads; ++i)
+    {
+        Workers.emplace_back(WorkerMain);
+    }
+
+    return true;
+}
+
+//==============================================================================
+void ParallelShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Exiting = true;
+    }
+    WorkReady.notify_all();
+
+    for (std::thread& worker : Workers)
+    {
+        worker.join();
+    }
+    Workers.clear();
+}
+
+//==============================================================================
+uint32_t ParallelThreadCount()
+{
+    return (uint32_t)Workers.size() + 1;
+}
+
+//==============================================================================
+void ParallelFor(uint32_t count, uint32_t grain, ParallelBody body, void* context)
+{
+    assert(grain > 0);
+
+    // Not worth waking anyone for a single chunk
+    if (InsideJob || std::this_thread::get_id() != Owner || Workers.empty() || count <= grain)
+    {
+        for (uint32_t begin = 0; begin < count; begin += grain)
+        {
+            body(begin, (count - begin < grain) ? count : begin + grain, context);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        JobBody = body;
+        JobContext = context;
+        JobCount = count;
+        JobGrain = grain;
+        JobNext = 0;
+        WorkersBusy = (uint32_t)Workers.size();
+        ++Generation;
+    }
+    WorkReady.notify_all();
+
+    RunChunks();
+
+    // Workers still read the job until they've all checked out
+    std::unique_lock<std::mutex> lock(Mutex);
+    WorkDone.wait(lock, []() { return WorkersBusy == 0; });
+}
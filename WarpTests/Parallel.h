@@ -0,0 +1,37 @@
+//==============================================================================
+// Minimal fork-join parallelism for the CPU passes. A fixed pool of workers is
+// started by ParallelInit, and ParallelFor splits a range into chunks that the
+// workers and the calling thread take in turn. Without ParallelInit, when
+// called from inside a ParallelFor body, or from any thread but the one that
+// called ParallelInit, ParallelFor runs serially. So code that uses it can run
+// on other threads of its own, such as the image loader's.
+//==============================================================================
+#pragma once
+
+#include <stdint.h>
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Starts 'numThreads' - 1 workers, 0 for one per hardware thread
+bool ParallelInit(uint32_t numThreads);
+void ParallelShutdown();
+
+// Threads taking part in ParallelFor, the caller included
+uint32_t ParallelThreadCount();
+
+typedef void (*ParallelBody)(uint32_t begin, uint32_t end, void* context);
+
+// Calls 'body' over [0, count) in chunks of at most 'grain', and returns when
+// every chunk is done. Chunks may run in any order on any thread.
+void ParallelFor(uint32_t count, uint32_t grain, ParallelBody body, void* context);
+
+template <typename Body>
+void ParallelFor(uint32_t count, uint32_t grain, const Body& body)
+{
+    ParallelFor(count, grain, [](uint32_t begin, uint32_t end, void* context)
+    {
+        (*(const Body*)context)(begin, end);
+    }, (void*)&body);
+}
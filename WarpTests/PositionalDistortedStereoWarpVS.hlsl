@@ -0,0 +1,5 @@
+// Build-time copy of the stereo lens distorted positional warp permutation
+#define POSITIONAL_WARP 1
+#define LENS_DISTORTION 1
+#define STEREO 1
+#include "WarpVS.hlsli"
@@ -0,0 +1,4 @@
+// Build-time copy of the lens distorted positional warp permutation
+#define POSITIONAL_WARP 1
+#define LENS_DISTORTION 1
+#include "WarpVS.hlsli"
@@ -0,0 +1,4 @@
+// Build-time copy of the positional encoded depth warp permutation
+#define POSITIONAL_WARP 1
+#define ENCODED_DEPTH 1
+#include "WarpVS.hlsli"
@@ -0,0 +1,4 @@
+// Build-time copy of the positional layered warp permutation
+#define POSITIONAL_WARP 1
+#define LAYERED 1
+#include "WarpVS.hlsli"
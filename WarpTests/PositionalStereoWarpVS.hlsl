@@ -0,0 +1,4 @@
+// Build-time copy of the stereo positional warp permutation
+#define POSITIONAL_WARP 1
+#define STEREO 1
+#include "WarpVS.hlsli"
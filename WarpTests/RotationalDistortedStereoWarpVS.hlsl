@@ -0,0 +1,4 @@
+// Build-time copy of the stereo lens distorted rotational warp permutation
+#define LENS_DISTORTION 1
+#define STEREO 1
+#include "WarpVS.hlsli"
@@ -0,0 +1,3 @@
+// Build-time copy of the stereo rotational warp permutation
+#define STEREO 1
+#include "WarpVS.hlsli"
@@ -0,0 +1,21 @@
+// Scene pixel shader for the app frame's second layer. Keeps only what lies
+// behind the first layer, so with the usual depth test each pixel ends up with
+// the nearest surface the first layer hides.
+Texture2D<float> FirstLayerDepth;
+
+struct VertexIn
+{
+    float4 Position : SV_POSITION;
+    float3 Color : COLOR;
+};
+
+float4 main(VertexIn input) : SV_TARGET
+{
+    // Drawn by the same vertex shader as the first layer, so that layer's own
+    // surface compares equal here
+    if (input.Position.z <= FirstLayerDepth.Load(int3(input.Position.xy, 0)))
+    {
+        discard;
+    }
+    return float4(input.Color, 1);
+}
@@ -0,0 +1,267 @@
+#include <Windows.h>
+#include <d3dcompiler.h>
+#include <d3d11shader.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <wrl.h>
+
+#include "ShaderCache.h"
+#include "Dxbc.h"
+#include "DxbcCompiler.h"
+
+using namespace Microsoft::WRL;
+
+//==============================================================================
+// Global variables
+//==============================================================================
+static std::string CacheDirectory;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    // FNV-1a, continued from 'hash'
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t CompileFlags(ShaderVariant variant)
+{
+    if (variant == ShaderVariant::Debug)
+    {
+        return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    }
+    return D3DCOMPILE_OPTIMIZATION_LEVEL3;
+}
+
+static const char* VariantName(ShaderVariant variant)
+{
+    return (variant == ShaderVariant::Debug) ? "Debug" : "Optimized";
+}
+
+static bool LoadFileData(const std::string& filename, std::vector<uint8_t>* data)
+{
+    FILE* file = nullptr;
+    if (fopen_s(&file, filename.c_str(), "rb") != 0 || !file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bool result = (size >= 0);
+    if (result)
+    {
+        data->resize((size_t)size);
+        result = (fread(data->data(), 1, data->size(), file) == data->size());
+    }
+
+    fclose(file);
+    return result;
+}
+
+static bool SaveFileData(const std::string& filename, const void* data, size_t size)
+{
+    FILE* file = nullptr;
+    if (fopen_s(&file, filename.c_str(), "wb") != 0 || !file)
+    {
+        return false;
+    }
+
+    bool result = (fwrite(data, 1, size, file) == size);
+    fclose(file);
+    return result;
+}
+
+static void PrintErrors(ID3DBlob* errors)
+{
+    if (errors)
+    {
+        OutputDebugStringA((const char*)errors->GetBufferPointer());
+    }
+}
+
+static std::string DefinesString(const D3D_SHADER_MACRO* defines)
+{
+    std::string result;
+    for (const D3D_SHADER_MACRO* define = defines; define && define->Name; ++define)
+    {
+        if (!result.empty())
+        {
+            result += ' ';
+        }
+        result += define->Name;
+        result += '=';
+        result += define->Definition ? define->Definition : "";
+    }
+    return result.empty() ? "-" : result;
+}
+
+//==============================================================================
+bool ShaderCacheInit(const char* directory)
+{
+    CacheDirectory = directory;
+
+    if (!CreateDirectoryA(directory, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+ShaderVariant ShaderCacheDefaultVariant()
+{
+#ifdef _DEBUG
+    return ShaderVariant::Debug;
+#else
+    return ShaderVariant::Optimized;
+#endif
+}
+
+//==============================================================================
+bool ShaderCacheLoad(const ShaderPermutation& permutation, ShaderVariant variant,
+    std::vector<uint8_t>* bytecode, ShaderSource* source)
+{
+    std::vector<uint8_t> text;
+    if (!LoadFileData(permutation.SourceFile, &text))
+    {
+        if (!permutation.Embedded)
+        {
+            return false;
+        }
+
+        const uint8_t* embedded = (const uint8_t*)permutation.Embedded;
+        bytecode->assign(embedded, embedded + permutation.EmbeddedSize);
+        if (source)
+        {
+            *source = ShaderSource::Embedded;
+        }
+        return true;
+    }
+
+    // Key on the preprocessed source so edits to included files and the
+    // permutation's defines are both picked up
+    ComPtr<ID3DBlob> preprocessed;
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DPreprocess(text.data(), text.size(), permutation.SourceFile, permutation.Defines,
+        D3D_COMPILE_STANDARD_FILE_INCLUDE, &preprocessed, &errors);
+    if (FAILED(hr))
+    {
+        PrintErrors(errors.Get());
+        return false;
+    }
+
+    uint32_t flags = CompileFlags(variant);
+    uint32_t compilerVersion = D3D_COMPILER_VERSION;
+
+    uint64_t hash = HashBytes(14695981039346656037ull, preprocessed->GetBufferPointer(), preprocessed->GetBufferSize());
+    hash = HashBytes(hash, permutation.Target, strlen(permutation.Target));
+    hash = HashBytes(hash, &flags, sizeof(flags));
+    hash = HashBytes(hash, &compilerVersion, sizeof(compilerVersion));
+
+    char filename[64];
+    sprintf_s(filename, "\\%s-%016llx.cso", permutation.Name, (unsigned long long)hash);
+    std::string cacheFile = CacheDirectory + filename;
+
+    if (LoadFileData(cacheFile, bytecode) && !bytecode->empty())
+    {
+        if (source)
+        {
+            *source = ShaderSource::Cache;
+        }
+        return true;
+    }
+
+    ComPtr<ID3DBlob> code;
+    hr = D3DCompile(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), permutation.SourceFile,
+        nullptr, nullptr, "main", permutation.Target, flags, 0, &code, errors.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        PrintErrors(errors.Get());
+        return false;
+    }
+
+    const uint8_t* p = (const uint8_t*)code->GetBufferPointer();
+    bytecode->assign(p, p + code->GetBufferSize());
+
+    // A failed write only costs a recompile next time
+    SaveFileData(cacheFile, bytecode->data(), bytecode->size());
+
+    if (source)
+    {
+        *source = ShaderSource::Compiled;
+    }
+    return true;
+}
+
+//==============================================================================
+bool ShaderCacheWriteReport(const ShaderPermutation* permutations, uint32_t count, const char* filename)
+{
+    std::string report;
+    char line[256];
+
+    sprintf_s(line, "%-20s %-20s %-10s %6s %6s %6s %6s %6s\n",
+        "Permutation", "Defines", "Variant", "Instr", "Temps", "ALU", "Tex", "CPU ops");
+    report += line;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const ShaderPermutation& permutation = permutations[i];
+        std::string defines = DefinesString(permutation.Defines);
+
+        for (ShaderVariant variant : { ShaderVariant::Debug, ShaderVariant::Optimized })
+        {
+            std::vector<uint8_t> bytecode;
+            ShaderSource source = ShaderSource::Embedded;
+            if (!ShaderCacheLoad(permutation, variant, &bytecode, &source) || source == ShaderSource::Embedded)
+            {
+                sprintf_s(line, "%-20s %-20s %-10s source not available\n",
+                    permutation.Name, defines.c_str(), VariantName(variant));
+                report += line;
+                continue;
+            }
+
+            ComPtr<ID3D11ShaderReflection> reflection;
+            D3D11_SHADER_DESC desc{};
+            if (FAILED(D3DReflect(bytecode.data(), bytecode.size(), IID_PPV_ARGS(&reflection))) ||
+                FAILED(reflection->GetDesc(&desc)))
+            {
+                assert(false);
+                return false;
+            }
+
+            // Micro-op count of the CPU path, if it supports the bytecode
+            char cpuOps[16] = "-";
+            DxbcShader shader;
+            DxbcProgram program;
+            if (DxbcParse(bytecode.data(), bytecode.size(), &shader) && DxbcCompile(shader, &program))
+            {
+                sprintf_s(cpuOps, "%u", (uint32_t)program.Ops.size());
+            }
+
+            sprintf_s(line, "%-20s %-20s %-10s %6u %6u %6u %6u %6s\n",
+                permutation.Name, defines.c_str(), VariantName(variant),
+                desc.InstructionCount, desc.TempRegisterCount,
+                desc.FloatInstructionCount + desc.IntInstructionCount + desc.UintInstructionCount,
+                desc.TextureNormalInstructions + desc.TextureLoadInstructions,
+                cpuOps);
+            report += line;
+        }
+    }
+
+    OutputDebugStringA(report.c_str());
+
+    return SaveFileData(filename, report.data(), report.size());
+}
@@ -0,0 +1,59 @@
+//==============================================================================
+// Runtime shader build for permutations of the project's HLSL sources. Each
+// permutation is preprocessed, hashed together with its target and compile
+// flags, and looked up in an on-disk cache before invoking the compiler, so
+// editing a shader only recompiles the permutations it affects.
+//
+// When the sources aren't available (the executable was copied elsewhere) the
+// bytecode embedded at build time is used instead.
+//==============================================================================
+#pragma once
+
+#include <d3dcommon.h>
+#include <stdint.h>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct ShaderPermutation
+{
+    const char* Name;               // Unique, used for the cache file name
+    const char* SourceFile;
+    const char* Target;
+    const D3D_SHADER_MACRO* Defines; // Null terminated, may be null
+    const void* Embedded;           // Build-time bytecode of the same permutation
+    size_t EmbeddedSize;
+};
+
+enum class ShaderVariant
+{
+    Debug,      // Skip optimization, with debug info. Matches the Debug FxCompile settings
+    Optimized,  // Optimization level 3
+};
+
+enum class ShaderSource
+{
+    Cache,
+    Compiled,
+    Embedded,
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// 'directory' is created if it doesn't exist
+bool ShaderCacheInit(const char* directory);
+
+// Variant matching the configuration the executable was built with
+ShaderVariant ShaderCacheDefaultVariant();
+
+// Returns the bytecode of the permutation, compiling it on a cache miss.
+// 'source' may be null.
+bool ShaderCacheLoad(const ShaderPermutation& permutation, ShaderVariant variant,
+    std::vector<uint8_t>* bytecode, ShaderSource* source);
+
+// Writes the static instruction counts of every permutation in both variants
+// to 'filename', and to the debugger output.
+bool ShaderCacheWriteReport(const ShaderPermutation* permutations, uint32_t count, const char* filename);
@@ -0,0 +1,186 @@
+//==============================================================================
+// Thin wrappers over SSE4.1 / AVX2 so CPU code can be written once and run
+// SimdWidth lanes wide. AVX2 is used when the compiler targets it (/arch:AVX2).
+//==============================================================================
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <smmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+
+static const uint32_t SimdWidth = 8;
+
+typedef __m256 SimdFloat;
+typedef __m256i SimdInt;
+
+static inline SimdFloat SimdZero() { return _mm256_setzero_ps(); }
+static inline SimdFloat SimdSet(float f) { return _mm256_set1_ps(f); }
+static inline SimdFloat SimdLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void SimdStore(float* p, SimdFloat a) { _mm256_storeu_ps(p, a); }
+static inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+static inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+static inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+static inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a, b); }
+static inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a, b); }
+static inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a, b); }
+static inline SimdFloat SimdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a); }
+static inline SimdFloat SimdFloor(SimdFloat a) { return _mm256_floor_ps(a); }
+static inline SimdFloat SimdCeil(SimdFloat a) { return _mm256_ceil_ps(a); }
+static inline SimdFloat SimdRoundNe(SimdFloat a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static inline SimdFloat SimdTrunc(SimdFloat a) { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+static inline SimdFloat SimdCmpLt(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline SimdFloat SimdCmpLe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline SimdFloat SimdCmpGe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline SimdFloat SimdCmpEq(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline SimdFloat SimdCmpNe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+static inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a, b); }
+static inline SimdFloat SimdAndNot(SimdFloat a, SimdFloat b) { return _mm256_andnot_ps(a, b); }
+static inline SimdFloat SimdOr(SimdFloat a, SimdFloat b) { return _mm256_or_ps(a, b); }
+static inline SimdFloat SimdXor(SimdFloat a, SimdFloat b) { return _mm256_xor_ps(a, b); }
+static inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b, a, mask); }
+static inline uint32_t SimdMoveMask(SimdFloat a) { return (uint32_t)_mm256_movemask_ps(a); }
+static inline SimdFloat SimdLaneIndex() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+// Even or odd lanes of a followed by those of b
+static inline SimdFloat SimdEvenLanes(SimdFloat a, SimdFloat b) { return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0))); }
+static inline SimdFloat SimdOddLanes(SimdFloat a, SimdFloat b) { return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0))); }
+// Lanes of the first or second half of a and b, alternating
+static inline SimdFloat SimdInterleaveLow(SimdFloat a, SimdFloat b) { return _mm256_permute2f128_ps(_mm256_unpacklo_ps(a, b), _mm256_unpackhi_ps(a, b), 0x20); }
+static inline SimdFloat SimdInterleaveHigh(SimdFloat a, SimdFloat b) { return _mm256_permute2f128_ps(_mm256_unpacklo_ps(a, b), _mm256_unpackhi_ps(a, b), 0x31); }
+
+static inline SimdInt SimdIntSet(int32_t i) { return _mm256_set1_epi32(i); }
+static inline SimdInt SimdIntAdd(SimdInt a, SimdInt b) { return _mm256_add_epi32(a, b); }
+static inline SimdInt SimdIntSub(SimdInt a, SimdInt b) { return _mm256_sub_epi32(a, b); }
+static inline SimdInt SimdIntMul(SimdInt a, SimdInt b) { return _mm256_mullo_epi32(a, b); }
+static inline SimdInt SimdIntMin(SimdInt a, SimdInt b) { return _mm256_min_epi32(a, b); }
+static inline SimdInt SimdIntMax(SimdInt a, SimdInt b) { return _mm256_max_epi32(a, b); }
+static inline SimdInt SimdIntShl(SimdInt a, SimdInt b) { return _mm256_sllv_epi32(a, b); }
+static inline SimdInt SimdIntShr(SimdInt a, SimdInt b) { return _mm256_srav_epi32(a, b); }
+static inline SimdInt SimdUintShr(SimdInt a, SimdInt b) { return _mm256_srlv_epi32(a, b); }
+static inline SimdInt SimdIntCmpEq(SimdInt a, SimdInt b) { return _mm256_cmpeq_epi32(a, b); }
+static inline SimdInt SimdIntCmpLt(SimdInt a, SimdInt b) { return _mm256_cmpgt_epi32(b, a); }
+static inline SimdInt SimdFtoi(SimdFloat a) { return _mm256_cvttps_epi32(a); }
+static inline SimdFloat SimdItof(SimdInt a) { return _mm256_cvtepi32_ps(a); }
+static inline SimdInt SimdAsInt(SimdFloat a) { return _mm256_castps_si256(a); }
+static inline SimdFloat SimdAsFloat(SimdInt a) { return _mm256_castsi256_ps(a); }
+static inline void SimdIntStore(int32_t* p, SimdInt a) { _mm256_storeu_si256((__m256i*)p, a); }
+static inline SimdInt SimdIntLoad(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+
+#else
+
+static const uint32_t SimdWidth = 4;
+
+typedef __m128 SimdFloat;
+typedef __m128i SimdInt;
+
+static inline SimdFloat SimdZero() { return _mm_setzero_ps(); }
+static inline SimdFloat SimdSet(float f) { return _mm_set1_ps(f); }
+static inline SimdFloat SimdLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void SimdStore(float* p, SimdFloat a) { _mm_storeu_ps(p, a); }
+static inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+static inline SimdFloat SimdSub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+static inline SimdFloat SimdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+static inline SimdFloat SimdDiv(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+static inline SimdFloat SimdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a, b); }
+static inline SimdFloat SimdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a, b); }
+static inline SimdFloat SimdSqrt(SimdFloat a) { return _mm_sqrt_ps(a); }
+static inline SimdFloat SimdFloor(SimdFloat a) { return _mm_floor_ps(a); }
+static inline SimdFloat SimdCeil(SimdFloat a) { return _mm_ceil_ps(a); }
+static inline SimdFloat SimdRoundNe(SimdFloat a) { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static inline SimdFloat SimdTrunc(SimdFloat a) { return _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+static inline SimdFloat SimdCmpLt(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a, b); }
+static inline SimdFloat SimdCmpLe(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a, b); }
+static inline SimdFloat SimdCmpGe(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a, b); }
+static inline SimdFloat SimdCmpEq(SimdFloat a, SimdFloat b) { return _mm_cmpeq_ps(a, b); }
+static inline SimdFloat SimdCmpNe(SimdFloat a, SimdFloat b) { return _mm_cmpneq_ps(a, b); }
+static inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b) { return _mm_and_ps(a, b); }
+static inline SimdFloat SimdAndNot(SimdFloat a, SimdFloat b) { return _mm_andnot_ps(a, b); }
+static inline SimdFloat SimdOr(SimdFloat a, SimdFloat b) { return _mm_or_ps(a, b); }
+static inline SimdFloat SimdXor(SimdFloat a, SimdFloat b) { return _mm_xor_ps(a, b); }
+static inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm_blendv_ps(b, a, mask); }
+static inline uint32_t SimdMoveMask(SimdFloat a) { return (uint32_t)_mm_movemask_ps(a); }
+static inline SimdFloat SimdLaneIndex() { return _mm_setr_ps(0, 1, 2, 3); }
+// Even or odd lanes of a followed by those of b
+static inline SimdFloat SimdEvenLanes(SimdFloat a, SimdFloat b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)); }
+static inline SimdFloat SimdOddLanes(SimdFloat a, SimdFloat b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)); }
+// Lanes of the first or second half of a and b, alternating
+static inline SimdFloat SimdInterleaveLow(SimdFloat a, SimdFloat b) { return _mm_unpacklo_ps(a, b); }
+static inline SimdFloat SimdInterleaveHigh(SimdFloat a, SimdFloat b) { return _mm_unpackhi_ps(a, b); }
+
+static inline SimdInt SimdIntSet(int32_t i) { return _mm_set1_epi32(i); }
+static inline SimdInt SimdIntAdd(SimdInt a, SimdInt b) { return _mm_add_epi32(a, b); }
+static inline SimdInt SimdIntSub(SimdInt a, SimdInt b) { return _mm_sub_epi32(a, b); }
+static inline SimdInt SimdIntMul(SimdInt a, SimdInt b) { return _mm_mullo_epi32(a, b); }
+static inline SimdInt SimdIntMin(SimdInt a, SimdInt b) { return _mm_min_epi32(a, b); }
+static inline SimdInt SimdIntMax(SimdInt a, SimdInt b) { return _mm_max_epi32(a, b); }
+static inline SimdInt SimdIntCmpEq(SimdInt a, SimdInt b) { return _mm_cmpeq_epi32(a, b); }
+static inline SimdInt SimdIntCmpLt(SimdInt a, SimdInt b) { return _mm_cmplt_epi32(a, b); }
+static inline SimdInt SimdFtoi(SimdFloat a) { return _mm_cvttps_epi32(a); }
+static inline SimdFloat SimdItof(SimdInt a) { return _mm_cvtepi32_ps(a); }
+static inline SimdInt SimdAsInt(SimdFloat a) { return _mm_castps_si128(a); }
+static inline SimdFloat SimdAsFloat(SimdInt a) { return _mm_castsi128_ps(a); }
+static inline void SimdIntStore(int32_t* p, SimdInt a) { _mm_storeu_si128((__m128i*)p, a); }
+static inline SimdInt SimdIntLoad(const int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+
+// SSE has no per-lane variable shifts, so fall back to scalar
+static inline SimdInt SimdIntShl(SimdInt a, SimdInt b)
+{
+    alignas(16) int32_t va[4], vb[4];
+    _mm_store_si128((__m128i*)va, a);
+    _mm_store_si128((__m128i*)vb, b);
+    for (int i = 0; i < 4; ++i) va[i] = (int32_t)((uint32_t)va[i] << (vb[i] & 31));
+    return _mm_load_si128((const __m128i*)va);
+}
+
+static inline SimdInt SimdIntShr(SimdInt a, SimdInt b)
+{
+    alignas(16) int32_t va[4], vb[4];
+    _mm_store_si128((__m128i*)va, a);
+    _mm_store_si128((__m128i*)vb, b);
+    for (int i = 0; i < 4; ++i) va[i] = va[i] >> (vb[i] & 31);
+    return _mm_load_si128((const __m128i*)va);
+}
+
+static inline SimdInt SimdUintShr(SimdInt a, SimdInt b)
+{
+    alignas(16) int32_t va[4], vb[4];
+    _mm_store_si128((__m128i*)va, a);
+    _mm_store_si128((__m128i*)vb, b);
+    for (int i = 0; i < 4; ++i) va[i] = (int32_t)((uint32_t)va[i] >> (vb[i] & 31));
+    return _mm_load_si128((const __m128i*)va);
+}
+
+#endif
+
+static inline SimdFloat SimdAbs(SimdFloat a) { return SimdAndNot(SimdSet(-0.f), a); }
+static inline SimdFloat SimdNeg(SimdFloat a) { return SimdXor(SimdSet(-0.f), a); }
+static inline SimdFloat SimdSaturate(SimdFloat a) { return SimdMin(SimdMax(a, SimdZero()), SimdSet(1.f)); }
+static inline SimdFloat SimdMad(SimdFloat a, SimdFloat b, SimdFloat c) { return SimdAdd(SimdMul(a, b), c); }
+static inline SimdFloat SimdLerp(SimdFloat a, SimdFloat b, SimdFloat t) { return SimdMad(SimdSub(b, a), t, a); }
+static inline SimdFloat SimdTrue() { return SimdCmpEq(SimdZero(), SimdZero()); }
+
+// Mask with the first 'count' lanes set
+static inline SimdFloat SimdFirstLanes(uint32_t count)
+{
+    return SimdCmpLt(SimdLaneIndex(), SimdSet((float)count));
+}
+
+// Applies a scalar function to every lane. Used for rarely executed operations
+// (exp/log) where a vectorized approximation isn't worth the precision loss.
+template <typename Fn>
+static inline SimdFloat SimdPerLane(SimdFloat a, Fn fn)
+{
+    alignas(32) float v[SimdWidth];
+    SimdStore(v, a);
+    for (uint32_t i = 0; i < SimdWidth; ++i)
+    {
+        v[i] = fn(v[i]);
+    }
+    return SimdLoad(v);
+}
@@ -0,0 +1,255 @@
+//==============================================================================
+#include "TemporalHistory.h"
+#include "Parallel.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Rows per ParallelFor chunk
+static const uint32_t RowGrain = 8;
+
+static const uint64_t NoSplat = ~0ull;
+
+//==============================================================================
+// Helpers
+//==============================================================================
+
+// Row vector convention, 'a' applied first
+static void MatrixMultiply(const float a[16], const float b[16], float out[16])
+{
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            out[i * 4 + j] = a[i * 4 + 0] * b[0 * 4 + j] + a[i * 4 + 1] * b[1 * 4 + j] +
+                a[i * 4 + 2] * b[2 * 4 + j] + a[i * 4 + 3] * b[3 * 4 + j];
+        }
+    }
+}
+
+// Nearest depth wins, then the lowest age. Depth is the top half, and
+// non-negative floats order the same as their bits.
+static inline void SplatNearest(std::atomic<uint64_t>& pixel, uint64_t splat)
+{
+    uint64_t current = pixel.load(std::memory_order_relaxed);
+    while (splat < current && !pixel.compare_exchange_weak(current, splat, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void SplatRows(const TemporalFrame& frame, const float* m, uint32_t age, const HoleFill& fill,
+    uint32_t y0, uint32_t y1, TemporalHistory* history)
+{
+    alignas(32) float targetX[SimdWidth];
+    alignas(32) float targetY[SimdWidth];
+    alignas(32) float targetZ[SimdWidth];
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const uint8_t* colorRow = frame.Color.Data + (size_t)y * frame.Color.RowPitch;
+
+        for (uint32_t x = 0; x < frame.Depth.Width; x += SimdWidth)
+        {
+            uint32_t count = HoleFillWarpTexels(frame.Depth, m, x, y, history->Width, history->Height, targetX, targetY, targetZ);
+
+            // Same 2x2 footprint as hole detection, but only holes take it
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                int32_t px0, py0;
+                if (!HoleFillFootprint(fill, targetX[i], targetY[i], &px0, &py0))
+                {
+                    continue;
+                }
+
+                uint32_t bits;
+                uint32_t rgba;
+                memcpy(&bits, &targetZ[i], sizeof(bits));
+                memcpy(&rgba, colorRow + (x + i) * 4, sizeof(rgba));
+                uint64_t splat = ((uint64_t)bits << 32) | ((uint64_t)age << 24) | (rgba & 0x00FFFFFFu);
+
+                for (int32_t sy = std::max(py0, 0); sy <= std::min(py0 + 1, (int32_t)history->Height - 1); ++sy)
+                {
+                    for (int32_t sx = std::max(px0, 0); sx <= std::min(px0 + 1, (int32_t)history->Width - 1); ++sx)
+                    {
+                        if (HoleFillIsHole(fill, (uint32_t)sx, (uint32_t)sy))
+                        {
+                            SplatNearest(history->Splats[(size_t)sy * history->Width + sx], splat);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void CopyRows(const CpuTexture& source, CpuTexture* target, uint32_t y0, uint32_t y1)
+{
+    assert(source.Width == target->Width && source.Height == target->Height && source.Format == target->Format);
+
+    size_t rowSize = std::min(source.RowPitch, target->RowPitch);
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        memcpy(target->Data + (size_t)y * target->RowPitch, source.Data + (size_t)y * source.RowPitch, rowSize);
+    }
+}
+
+//==============================================================================
+bool TemporalHistoryCreate(uint32_t width, uint32_t height, uint32_t numFrames, TemporalHistory* history)
+{
+    TemporalHistoryDestroy(history);
+
+    if (numFrames == 0 || numFrames > TemporalHistoryMaxFrames)
+    {
+        assert(false);
+        return false;
+    }
+
+    history->Width = width;
+    history->Height = height;
+    history->Newest = 0;
+    history->Count = 0;
+    history->NumHoles = 0;
+    history->NumReused = 0;
+    memset(history->NumReusedByAge, 0, sizeof(history->NumReusedByAge));
+    history->Splats.reset(new std::atomic<uint64_t>[(size_t)width * height]);
+
+    history->Frames.resize(numFrames);
+    for (TemporalFrame& frame : history->Frames)
+    {
+        if (!CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &frame.Color) ||
+            !CpuTextureCreate(width, height, CpuFormat::R32Float, &frame.Depth))
+        {
+            assert(false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+void TemporalHistoryDestroy(TemporalHistory* history)
+{
+    for (TemporalFrame& frame : history->Frames)
+    {
+        CpuTextureDestroy(&frame.Depth);
+        CpuTextureDestroy(&frame.Color);
+    }
+    history->Frames.clear();
+    history->Splats.reset();
+    history->Count = 0;
+}
+
+//==============================================================================
+void TemporalHistoryPush(const CpuTexture& color, const CpuTexture& depth, const float invViewProj[16],
+    TemporalHistory* history)
+{
+    assert(!history->Frames.empty());
+
+    uint32_t numFrames = (uint32_t)history->Frames.size();
+    history->Newest = (history->Newest + 1) % numFrames;
+    history->Count = std::min(history->Count + 1, numFrames);
+
+    TemporalFrame& frame = history->Frames[history->Newest];
+    memcpy(frame.InvViewProj, invViewProj, sizeof(frame.InvViewProj));
+    ParallelFor(history->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        CopyRows(color, &frame.Color, y0, y1);
+        CopyRows(depth, &frame.Depth, y0, y1);
+    });
+}
+
+//==============================================================================
+void TemporalHistoryFill(const float targetViewProj[16], HoleFill* fill, CpuTexture* target, TemporalHistory* history)
+{
+    assert(target->Format == CpuFormat::R8G8B8A8Unorm);
+    assert(target->Width == history->Width && target->Height == history->Height);
+    assert(fill->Width == history->Width && fill->Height == history->Height);
+
+    history->NumHoles = fill->NumHoles;
+    history->NumReused = 0;
+    memset(history->NumReusedByAge, 0, sizeof(history->NumReusedByAge));
+
+    if (fill->NumHoles == 0 || history->Count == 0)
+    {
+        return;
+    }
+
+    ParallelFor(history->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        for (size_t i = (size_t)y0 * history->Width; i < (size_t)y1 * history->Width; ++i)
+        {
+            history->Splats[i].store(NoSplat, std::memory_order_relaxed);
+        }
+    });
+
+    uint32_t numFrames = (uint32_t)history->Frames.size();
+    for (uint32_t age = 1; age <= history->Count; ++age)
+    {
+        const TemporalFrame& frame = history->Frames[(history->Newest + numFrames - (age - 1)) % numFrames];
+
+        float m[16];
+        MatrixMultiply(frame.InvViewProj, targetViewProj, m);
+        ParallelFor(frame.Depth.Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+        {
+            SplatRows(frame, m, age, *fill, y0, y1, history);
+        });
+    }
+
+    // Resolve into the target, and out of the holes left to inpaint
+    std::atomic<uint32_t> reusedByAge[TemporalHistoryMaxFrames + 1];
+    for (std::atomic<uint32_t>& count : reusedByAge)
+    {
+        count = 0;
+    }
+    ParallelFor(history->Height, RowGrain, [&](uint32_t y0, uint32_t y1)
+    {
+        uint32_t counts[TemporalHistoryMaxFrames + 1] = {};
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            uint8_t* colorRow = target->Data + (size_t)y * target->RowPitch;
+            for (uint32_t x = 0; x < history->Width; ++x)
+            {
+                size_t i = (size_t)y * history->Width + x;
+                uint64_t splat = history->Splats[i].load(std::memory_order_relaxed);
+                if (splat == NoSplat)
+                {
+                    continue;
+                }
+
+                // Opaque, like the rest of the warped frame
+                uint32_t rgba = (uint32_t)splat | 0xFF000000u;
+                memcpy(colorRow + x * 4, &rgba, sizeof(rgba));
+                fill->WarpedDepth[i].store((uint32_t)(splat >> 32) | HoleFillReused, std::memory_order_relaxed);
+                ++counts[(splat >> 24) & 0xFF];
+            }
+        }
+
+        for (uint32_t age = 1; age <= TemporalHistoryMaxFrames; ++age)
+        {
+            reusedByAge[age] += counts[age];
+        }
+    });
+
+    for (uint32_t age = 1; age <= TemporalHistoryMaxFrames; ++age)
+    {
+        history->NumReusedByAge[age] = reusedByAge[age];
+        history->NumReused += history->NumReusedByAge[age];
+    }
+}
+
+//==============================================================================
+size_t TemporalHistoryMemory(const TemporalHistory& history)
+{
+    size_t bytes = (size_t)history.Width * history.Height * sizeof(uint64_t);
+    for (const TemporalFrame& frame : history.Frames)
+    {
+        bytes += (size_t)frame.Color.RowPitch * frame.Color.Height;
+        bytes += (size_t)frame.Depth.RowPitch * frame.Depth.Height;
+    }
+    return bytes;
+}
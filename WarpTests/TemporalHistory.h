@@ -0,0 +1,69 @@
+//==============================================================================
+// History of the last few app frames, to fill positional warp disocclusions
+// from earlier views before falling back to inpainting (see HoleFill.h). Each
+// frame keeps its color, depth and pose in a fixed ring, so memory is bounded
+// by the frame count given at creation.
+//
+// Filling forward splats every history frame into the current holes only. Per
+// pixel the nearest surface across all frames wins, ties going to the newest,
+// so a background seen by any earlier frame shows through.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include "HoleFill.h"
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+static const uint32_t TemporalHistoryMaxFrames = 8;
+
+struct TemporalFrame
+{
+    CpuTexture Color;           // R8G8B8A8Unorm
+    CpuTexture Depth;           // R32Float
+    float InvViewProj[16];      // From the frame's NDC and depth to world
+};
+
+struct TemporalHistory
+{
+    uint32_t Width;
+    uint32_t Height;
+
+    // Ring of frames, Newest being the last pushed
+    std::vector<TemporalFrame> Frames;
+    uint32_t Newest;
+    uint32_t Count;
+
+    // Per target pixel, the nearest splat: depth bits, then age, then RGB
+    std::unique_ptr<std::atomic<uint64_t>[]> Splats;
+
+    // From the last TemporalHistoryFill. Age 1 is the newest frame.
+    uint32_t NumHoles;
+    uint32_t NumReused;
+    uint32_t NumReusedByAge[TemporalHistoryMaxFrames + 1];
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Holds up to 'numFrames' (at most TemporalHistoryMaxFrames) frames of
+// 'width' x 'height'
+bool TemporalHistoryCreate(uint32_t width, uint32_t height, uint32_t numFrames, TemporalHistory* history);
+void TemporalHistoryDestroy(TemporalHistory* history);
+
+// Copies a frame in, dropping the oldest once full
+void TemporalHistoryPush(const CpuTexture& color, const CpuTexture& depth, const float invViewProj[16],
+    TemporalHistory* history);
+
+// Fills the holes found by HoleFillDetect in 'target' (R8G8B8A8Unorm) from the
+// history as seen from 'targetViewProj', and marks them HoleFillReused
+void TemporalHistoryFill(const float targetViewProj[16], HoleFill* fill, CpuTexture* target, TemporalHistory* history);
+
+// Bytes allocated for frames and splats
+size_t TemporalHistoryMemory(const TemporalHistory& history);
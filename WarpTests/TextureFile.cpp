@@ -0,0 +1,301 @@
+//==============================================================================
+#include "TextureFile.h"
+#include "MipChain.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// As D3D11 texture arrays
+static const uint32_t MaxArraySize = 2048;
+
+static const struct
+{
+    CpuFormat Format;
+    uint32_t DxgiFormat;
+} DxgiFormats[] = {
+    { CpuFormat::R8G8B8A8Unorm, 28 },       // DXGI_FORMAT_R8G8B8A8_UNORM
+    { CpuFormat::R16Unorm, 56 },            // DXGI_FORMAT_R16_UNORM
+    { CpuFormat::R32Float, 41 },            // DXGI_FORMAT_R32_FLOAT
+    { CpuFormat::R32G32Float, 16 },         // DXGI_FORMAT_R32G32_FLOAT
+    { CpuFormat::R32G32B32A32Float, 2 },    // DXGI_FORMAT_R32G32B32A32_FLOAT
+    { CpuFormat::BC1Unorm, 71 },            // DXGI_FORMAT_BC1_UNORM
+    { CpuFormat::BC3Unorm, 77 },            // DXGI_FORMAT_BC3_UNORM
+    { CpuFormat::BC7Unorm, 98 },            // DXGI_FORMAT_BC7_UNORM
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline uint32_t BlockRows(CpuFormat format, uint32_t height)
+{
+    uint32_t blockSize = CpuFormatBlockSize(format);
+    return (height + blockSize - 1) / blockSize;
+}
+
+static bool MapFile(const char* filename, const uint8_t** data, size_t* size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize{};
+    HANDLE mapping = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 ?
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!mapping)
+    {
+        return false;
+    }
+
+    // The view keeps the mapping alive on its own
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view)
+    {
+        return false;
+    }
+    *data = (const uint8_t*)view;
+    *size = (size_t)fileSize.QuadPart;
+    return true;
+#else
+    int file = open(filename, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    void* view = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    close(file);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+    *data = (const uint8_t*)view;
+    *size = (size_t)status.st_size;
+    return true;
+#endif
+}
+
+static void UnmapFile(const uint8_t* data, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+// The header and table describe a texture that fits in 'size' bytes
+static bool Validate(const uint8_t* data, size_t size, CpuFormat* format)
+{
+    if (size < sizeof(TextureFileHeader))
+    {
+        return false;
+    }
+    const TextureFileHeader& header = *(const TextureFileHeader*)data;
+    bool known = false;
+    for (const auto& entry : DxgiFormats)
+    {
+        if (entry.DxgiFormat == header.DxgiFormat)
+        {
+            *format = entry.Format;
+            known = true;
+        }
+    }
+    if (header.Magic != TextureFileMagic || header.Version != TextureFileVersion || !known ||
+        header.Width == 0 || header.Height == 0 || header.Width > 16384 || header.Height > 16384 ||
+        header.NumLevels == 0 || header.NumLevels > MipLevelCount(header.Width, header.Height) ||
+        header.ArraySize == 0 || header.ArraySize > MaxArraySize)
+    {
+        return false;
+    }
+
+    uint64_t numSubresources = (uint64_t)header.NumLevels * header.ArraySize;
+    if (sizeof(TextureFileHeader) + numSubresources * sizeof(TextureFileSubresource) > size)
+    {
+        return false;
+    }
+    const TextureFileSubresource* subresources = (const TextureFileSubresource*)(data + sizeof(TextureFileHeader));
+    for (uint32_t i = 0; i < numSubresources; ++i)
+    {
+        const TextureFileSubresource& sub = subresources[i];
+        uint32_t level = i % header.NumLevels;
+        uint64_t rowBytes = CpuFormatImageBytes(*format, MipLevelSize(header.Width, level), 1);
+        if (sub.Offset % TextureFileRowAlignment != 0 || sub.RowPitch % TextureFileRowAlignment != 0 ||
+            sub.RowPitch < rowBytes || sub.NumRows != BlockRows(*format, MipLevelSize(header.Height, level)) ||
+            sub.Offset > size || (uint64_t)sub.RowPitch * sub.NumRows > size - sub.Offset)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//==============================================================================
+bool TextureFileOpen(const char* filename, TextureFile* file)
+{
+    *file = TextureFile{};
+
+    const uint8_t* data;
+    size_t size;
+    if (!MapFile(filename, &data, &size))
+    {
+        return false;
+    }
+    CpuFormat format = CpuFormat::R8G8B8A8Unorm;
+    if (!Validate(data, size, &format))
+    {
+        UnmapFile(data, size);
+        return false;
+    }
+
+    file->Header = (const TextureFileHeader*)data;
+    file->Subresources = (const TextureFileSubresource*)(data + sizeof(TextureFileHeader));
+    file->Format = format;
+    file->Data = data;
+    file->Size = size;
+    return true;
+}
+
+//==============================================================================
+void TextureFileClose(TextureFile* file)
+{
+    if (file->Data)
+    {
+        UnmapFile(file->Data, file->Size);
+    }
+    *file = TextureFile{};
+}
+
+//==============================================================================
+bool TextureFileGetLevel(const TextureFile& file, uint32_t slice, uint32_t level, CpuTexture* texture)
+{
+    const TextureFileHeader& header = *file.Header;
+    if (slice >= header.ArraySize || level >= header.NumLevels)
+    {
+        assert(false);
+        return false;
+    }
+
+    const TextureFileSubresource& sub = file.Subresources[level + slice * header.NumLevels];
+    texture->Width = MipLevelSize(header.Width, level);
+    texture->Height = MipLevelSize(header.Height, level);
+    texture->RowPitch = sub.RowPitch;
+    texture->Format = file.Format;
+    texture->Data = (uint8_t*)(file.Data + sub.Offset);
+    return true;
+}
+
+//==============================================================================
+bool TextureFileWrite(const char* filename, const CpuTexture* subresources, uint32_t numLevels, uint32_t arraySize)
+{
+    CpuFormat format = subresources[0].Format;
+    uint32_t width = subresources[0].Width;
+    uint32_t height = subresources[0].Height;
+    uint32_t numSubresources = numLevels * arraySize;
+    bool valid = TextureFileDxgiFormat(format) != 0 && numLevels > 0 && numLevels <= MipLevelCount(width, height) &&
+        arraySize > 0 && arraySize <= MaxArraySize;
+    for (uint32_t i = 0; i < numSubresources && valid; ++i)
+    {
+        uint32_t level = i % numLevels;
+        valid = subresources[i].Format == format && subresources[i].Width == MipLevelSize(width, level) &&
+            subresources[i].Height == MipLevelSize(height, level);
+    }
+    if (!valid)
+    {
+        assert(false);
+        return false;
+    }
+
+    // The table, then every subresource laid out as CpuTextureCreate would
+    TextureFileHeader header{};
+    header.Magic = TextureFileMagic;
+    header.Version = TextureFileVersion;
+    header.DxgiFormat = TextureFileDxgiFormat(format);
+    header.Width = width;
+    header.Height = height;
+    header.NumLevels = numLevels;
+    header.ArraySize = arraySize;
+
+    std::vector<TextureFileSubresource> table(numSubresources);
+    uint64_t offset = AlignUp(sizeof(header) + table.size() * sizeof(TextureFileSubresource), TextureFilePayloadAlignment);
+    for (uint32_t i = 0; i < numSubresources; ++i)
+    {
+        const CpuTexture& texture = subresources[i];
+        table[i].Offset = offset;
+        table[i].RowPitch = (uint32_t)AlignUp(CpuFormatImageBytes(format, texture.Width, 1), TextureFileRowAlignment);
+        table[i].NumRows = BlockRows(format, texture.Height);
+        offset += (uint64_t)table[i].RowPitch * table[i].NumRows;
+    }
+
+#ifdef _WIN32
+    FILE* file = nullptr;
+    if (fopen_s(&file, filename, "wb") != 0 || !file)
+#else
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+#endif
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> padding(TextureFilePayloadAlignment, 0);
+    size_t tableBytes = table.size() * sizeof(TextureFileSubresource);
+    size_t headerPadding = (size_t)table[0].Offset - sizeof(header) - tableBytes;
+    bool result = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(table.data(), tableBytes, 1, file) == 1 &&
+        (headerPadding == 0 || fwrite(padding.data(), headerPadding, 1, file) == 1);
+    for (uint32_t i = 0; i < numSubresources && result; ++i)
+    {
+        const CpuTexture& texture = subresources[i];
+        size_t rowBytes = (size_t)CpuFormatImageBytes(format, texture.Width, 1);
+        for (uint32_t y = 0; y < table[i].NumRows && result; ++y)
+        {
+            result = fwrite(texture.Data + (size_t)y * texture.RowPitch, rowBytes, 1, file) == 1 &&
+                (rowBytes == table[i].RowPitch || fwrite(padding.data(), table[i].RowPitch - rowBytes, 1, file) == 1);
+        }
+    }
+    result = (fclose(file) == 0) && result;
+    return result;
+}
+
+//==============================================================================
+uint32_t TextureFileDxgiFormat(CpuFormat format)
+{
+    for (const auto& entry : DxgiFormats)
+    {
+        if (entry.Format == format)
+        {
+            return entry.DxgiFormat;
+        }
+    }
+    return 0;
+}
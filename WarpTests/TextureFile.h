@@ -0,0 +1,84 @@
+//==============================================================================
+// A texture container laid out to be memory mapped and used in place. The
+// payload is already in the GPU's format, mips and array slices included, so
+// opening one maps the file and hands out pointers into the mapping: a D3D11
+// texture takes them as its initial data, and a CpuTexture can point at them
+// for the CPU sampler. Nothing is read, decoded or copied in between, and the
+// pages come in from the file cache as they're first touched.
+//
+// Layout, little endian:
+//
+//   TextureFileHeader
+//   TextureFileSubresource[ArraySize * NumLevels], in D3D11 subresource order
+//   (level + slice * NumLevels)
+//   Payload, from TextureFilePayloadAlignment. Each subresource starts on a
+//   multiple of TextureFileRowAlignment and so does each row (of blocks), the
+//   same as CpuTextureCreate lays rows out.
+//
+// TextureFileWrite makes them from CpuTextures, and TextureBaker converts
+// image files.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t TextureFileMagic = 0x58455457;   // "WTEX"
+static const uint32_t TextureFileVersion = 1;
+static const uint32_t TextureFilePayloadAlignment = 4096;
+static const uint32_t TextureFileRowAlignment = 64;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct TextureFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t DxgiFormat;    // A DXGI_FORMAT, so it goes straight to D3D11
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t NumLevels;
+    uint32_t ArraySize;
+    uint32_t Reserved;
+};
+
+struct TextureFileSubresource
+{
+    uint64_t Offset;        // From the start of the file
+    uint32_t RowPitch;      // Bytes from one row, or row of blocks, to the next
+    uint32_t NumRows;
+};
+
+// An open, mapped file. Header and Subresources point into the mapping.
+struct TextureFile
+{
+    const TextureFileHeader* Header;
+    const TextureFileSubresource* Subresources;
+    CpuFormat Format;
+    const uint8_t* Data;
+    size_t Size;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Maps 'filename' read-only and checks its header and table against its size
+bool TextureFileOpen(const char* filename, TextureFile* file);
+void TextureFileClose(TextureFile* file);
+
+// 'texture' points into the mapping, so it's only good until TextureFileClose
+// and mustn't be written to or destroyed
+bool TextureFileGetLevel(const TextureFile& file, uint32_t slice, uint32_t level, CpuTexture* texture);
+
+// Writes 'arraySize' slices of 'numLevels' mips each, in subresource order
+// and sized like MipLevelSize, all in one of the formats with a DXGI_FORMAT
+bool TextureFileWrite(const char* filename, const CpuTexture* subresources, uint32_t numLevels, uint32_t arraySize);
+
+// The DXGI_FORMAT value for 'format', or 0 for none
+uint32_t TextureFileDxgiFormat(CpuFormat format);
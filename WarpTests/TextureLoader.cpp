@@ -0,0 +1,474 @@
+//==============================================================================
+#include "TextureLoader.h"
+#include "BlockCompress.h"
+#include "ImageFile.h"
+#include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// One request. Only the stage its state names touches it, and handing it on
+// goes through the queue's mutex.
+struct TextureLoadJob
+{
+    std::string Filename;
+    TextureLoadCallback Callback;
+    void* Context;
+    TextureLoadState State;
+    ImageFile Image;
+    TextureLoadTarget Target;   // Data is null until the uploader's Begin
+    CpuFormat Format;           // Of the target
+    uint32_t NumLevels;
+    uint64_t Bytes;
+    bool Decoded;
+    double DecodeMs;
+    double MipMs;
+    double CompressMs;
+};
+
+struct TextureLoadQueue
+{
+    TextureUploader Uploader;
+    uint64_t MaxBytesOutstanding;
+    MipFilter Mips;
+    CpuFormat Format;
+    std::vector<std::thread> Workers;
+
+    std::mutex Mutex;
+    std::condition_variable WorkReady;
+    std::condition_variable UploadReady;
+    bool Exiting = false;
+
+    std::vector<std::unique_ptr<TextureLoadJob>> Jobs;  // By handle - 1
+    std::deque<TextureLoadHandle> Work;                 // To open or decode
+    std::deque<TextureLoadHandle> Waiting;              // For memory, in request order
+    std::vector<TextureLoadHandle> Finished;            // For the upload stage
+    TextureLoadStats Stats{};
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline TextureLoadJob* GetJob(TextureLoadQueue* queue, TextureLoadHandle handle)
+{
+    return queue->Jobs[handle - 1].get();
+}
+
+// Under the mutex. Whether the next waiting image fits the budget.
+static bool CanHandOut(const TextureLoadQueue* queue)
+{
+    if (queue->Waiting.empty())
+    {
+        return false;
+    }
+    uint64_t bytes = queue->Jobs[queue->Waiting.front() - 1]->Bytes;
+    return queue->Stats.BytesOutstanding == 0 || queue->Stats.BytesOutstanding + bytes <= queue->MaxBytesOutstanding;
+}
+
+// The target's format and levels for an opened image
+static void ChooseTarget(const TextureLoadQueue* queue, TextureLoadJob* job)
+{
+    const ImageFileInfo& info = job->Image.Info;
+    if (CpuFormatIsBlockCompressed(info.PixelFormat))
+    {
+        job->Format = info.PixelFormat;
+        job->NumLevels = (queue->Mips == MipFilter::None) ? 1 : info.NumLevels;
+    }
+    else
+    {
+        // D3D11 wants block compressed textures a whole number of blocks
+        bool wholeBlocks = info.Width % 4 == 0 && info.Height % 4 == 0;
+        job->Format = (CpuFormatIsBlockCompressed(queue->Format) && wholeBlocks) ? queue->Format : CpuFormat::R8G8B8A8Unorm;
+        job->NumLevels = (queue->Mips == MipFilter::None) ? 1 : MipLevelCount(info.Width, info.Height);
+    }
+
+    job->Bytes = 0;
+    for (uint32_t level = 0; level < job->NumLevels; ++level)
+    {
+        job->Bytes += CpuFormatImageBytes(job->Format, MipLevelSize(info.Width, level), MipLevelSize(info.Height, level));
+    }
+}
+
+// Fills the target's levels: read as they are from a block compressed file,
+// or decoded and filtered in scratch memory, then compressed or copied into
+// the target. The target may be write-only, such as a staging texture mapped
+// for writing, so only a lone level 0 is decoded straight into it.
+static bool DecodeJob(const TextureLoadQueue* queue, TextureLoadJob* job)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    auto start = Clock::now();
+    ImageFileInfo info = job->Image.Info;
+    TextureLoadTarget& target = job->Target;
+
+    CpuTexture levels[MipMaxLevels];
+    for (uint32_t level = 0; level < job->NumLevels; ++level)
+    {
+        levels[level].Width = MipLevelSize(info.Width, level);
+        levels[level].Height = MipLevelSize(info.Height, level);
+        levels[level].RowPitch = (uint32_t)target.RowPitch[level];
+        levels[level].Format = job->Format;
+        levels[level].Data = target.Data[level];
+    }
+
+    if (CpuFormatIsBlockCompressed(info.PixelFormat))
+    {
+        bool decoded = true;
+        for (uint32_t level = 0; level < job->NumLevels && decoded; ++level)
+        {
+            decoded = ImageFileRead(&job->Image, target.Data[level], target.RowPitch[level]);
+        }
+        job->DecodeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        return decoded;
+    }
+
+    CpuMipChain scratch{};
+    bool compress = CpuFormatIsBlockCompressed(job->Format);
+    bool useScratch = compress || job->NumLevels > 1;
+    if (useScratch && !CpuMipChainCreate(info.Width, info.Height, job->NumLevels, CpuFormat::R8G8B8A8Unorm, &scratch))
+    {
+        return false;
+    }
+    CpuTexture* decodeLevels = useScratch ? scratch.Levels : levels;
+
+    bool decoded = ImageFileRead(&job->Image, decodeLevels[0].Data, decodeLevels[0].RowPitch);
+    auto decodeEnd = Clock::now();
+    if (decoded && job->NumLevels > 1)
+    {
+        decoded = MipChainGenerate(queue->Mips, decodeLevels, job->NumLevels);
+    }
+    auto mipEnd = Clock::now();
+    for (uint32_t level = 0; level < job->NumLevels && decoded && useScratch; ++level)
+    {
+        if (compress)
+        {
+            decoded = BlockCompress(scratch.Levels[level], &levels[level]);
+            continue;
+        }
+        const CpuTexture& source = scratch.Levels[level];
+        size_t rowBytes = (size_t)source.Width * 4;
+        for (uint32_t y = 0; y < source.Height; ++y)
+        {
+            memcpy(levels[level].Data + (size_t)y * levels[level].RowPitch, source.Data + (size_t)y * source.RowPitch,
+                rowBytes);
+        }
+    }
+    auto end = Clock::now();
+    CpuMipChainDestroy(&scratch);
+
+    job->DecodeMs = std::chrono::duration<double, std::milli>(decodeEnd - start).count();
+    job->MipMs = std::chrono::duration<double, std::milli>(mipEnd - decodeEnd).count();
+    job->CompressMs = std::chrono::duration<double, std::milli>(end - mipEnd).count();
+    return decoded;
+}
+
+static void WorkerMain(TextureLoadQueue* queue)
+{
+    for (;;)
+    {
+        TextureLoadHandle handle;
+        TextureLoadJob* job;
+        {
+            std::unique_lock<std::mutex> lock(queue->Mutex);
+            queue->WorkReady.wait(lock, [&]() { return queue->Exiting || !queue->Work.empty(); });
+            if (queue->Exiting)
+            {
+                return;
+            }
+            handle = queue->Work.front();
+            queue->Work.pop_front();
+            job = GetJob(queue, handle);
+        }
+
+        if (job->State == TextureLoadState::Opening)
+        {
+            bool opened = ImageFileOpen(job->Filename.c_str(), &job->Image);
+
+            std::lock_guard<std::mutex> lock(queue->Mutex);
+            if (opened)
+            {
+                ChooseTarget(queue, job);
+                job->State = TextureLoadState::Waiting;
+                queue->Waiting.push_back(handle);
+            }
+            else
+            {
+                job->State = TextureLoadState::Finishing;
+                queue->Finished.push_back(handle);
+            }
+        }
+        else
+        {
+            assert(job->State == TextureLoadState::Decoding);
+            bool decoded = DecodeJob(queue, job);
+            ImageFileClose(&job->Image);
+
+            std::lock_guard<std::mutex> lock(queue->Mutex);
+            job->Decoded = decoded;
+            job->State = TextureLoadState::Finishing;
+            queue->Finished.push_back(handle);
+        }
+        queue->UploadReady.notify_all();
+    }
+}
+
+static bool CpuUploadBegin(void*, uint32_t width, uint32_t height, uint32_t numLevels, CpuFormat format,
+    TextureLoadTarget* target)
+{
+    CpuMipChain* chain = new CpuMipChain();
+    if (!CpuMipChainCreate(width, height, numLevels, format, chain))
+    {
+        delete chain;
+        return false;
+    }
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        target->Data[level] = chain->Levels[level].Data;
+        target->RowPitch[level] = chain->Levels[level].RowPitch;
+    }
+    target->Resource = chain;
+    return true;
+}
+
+static void* CpuUploadEnd(void*, const TextureLoadTarget& target, bool decoded)
+{
+    CpuMipChain* chain = (CpuMipChain*)target.Resource;
+    if (!decoded)
+    {
+        CpuMipChainDestroy(chain);
+        delete chain;
+        return nullptr;
+    }
+    return chain;
+}
+
+const TextureUploader CpuTextureUploader = { CpuUploadBegin, CpuUploadEnd, nullptr };
+
+//==============================================================================
+bool TextureLoaderCreate(uint32_t numWorkers, uint64_t maxBytesOutstanding, MipFilter mips, CpuFormat format,
+    const TextureUploader& uploader, TextureLoader* loader)
+{
+    bool validFormat = format == CpuFormat::R8G8B8A8Unorm || CpuFormatIsBlockCompressed(format);
+    if (numWorkers == 0 || !validFormat || !uploader.Begin || !uploader.End)
+    {
+        assert(false);
+        return false;
+    }
+
+    TextureLoadQueue* queue = new TextureLoadQueue();
+    queue->Uploader = uploader;
+    queue->MaxBytesOutstanding = maxBytesOutstanding;
+    queue->Mips = mips;
+    queue->Format = format;
+    for (uint32_t i = 0; i < numWorkers; ++i)
+    {
+        queue->Workers.emplace_back(WorkerMain, queue);
+    }
+
+    loader->Queue = queue;
+    return true;
+}
+
+//==============================================================================
+void TextureLoaderDestroy(TextureLoader* loader)
+{
+    TextureLoadQueue* queue = loader->Queue;
+    if (!queue)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue->Mutex);
+        queue->Exiting = true;
+    }
+    queue->WorkReady.notify_all();
+    for (std::thread& worker : queue->Workers)
+    {
+        worker.join();
+    }
+
+    // Nothing else runs now, so whatever is left can go
+    for (auto& job : queue->Jobs)
+    {
+        if (job->Target.Data[0])
+        {
+            queue->Uploader.End(queue->Uploader.Context, job->Target, false);
+        }
+        ImageFileClose(&job->Image);
+    }
+
+    delete queue;
+    loader->Queue = nullptr;
+}
+
+//==============================================================================
+TextureLoadHandle TextureLoaderRequest(TextureLoader* loader, const char* filename, TextureLoadCallback callback,
+    void* context)
+{
+    TextureLoadQueue* queue = loader->Queue;
+
+    std::unique_ptr<TextureLoadJob> job(new TextureLoadJob());
+    job->Filename = filename;
+    job->Callback = callback;
+    job->Context = context;
+    job->State = TextureLoadState::Opening;
+
+    TextureLoadHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(queue->Mutex);
+        queue->Jobs.push_back(std::move(job));
+        handle = (TextureLoadHandle)queue->Jobs.size();
+        queue->Work.push_back(handle);
+        ++queue->Stats.Pending;
+    }
+    queue->WorkReady.notify_one();
+    return handle;
+}
+
+//==============================================================================
+TextureLoadState TextureLoaderGetState(const TextureLoader& loader, TextureLoadHandle handle)
+{
+    TextureLoadQueue* queue = loader.Queue;
+    std::lock_guard<std::mutex> lock(queue->Mutex);
+    if (handle == 0 || handle > queue->Jobs.size())
+    {
+        assert(false);
+        return TextureLoadState::Failed;
+    }
+    return GetJob(queue, handle)->State;
+}
+
+//==============================================================================
+void TextureLoaderGetStats(const TextureLoader& loader, TextureLoadStats* stats)
+{
+    TextureLoadQueue* queue = loader.Queue;
+    std::lock_guard<std::mutex> lock(queue->Mutex);
+    *stats = queue->Stats;
+}
+
+//==============================================================================
+void TextureLoaderUpdate(TextureLoader* loader)
+{
+    TextureLoadQueue* queue = loader->Queue;
+    const TextureUploader& uploader = queue->Uploader;
+
+    // Finish everything decoded, outside the lock so workers carry on
+    std::vector<TextureLoadHandle> finished;
+    {
+        std::lock_guard<std::mutex> lock(queue->Mutex);
+        finished.swap(queue->Finished);
+    }
+    for (TextureLoadHandle handle : finished)
+    {
+        TextureLoadJob* job = GetJob(queue, handle);
+        void* resource = nullptr;
+        bool allocated = job->Target.Data[0] != nullptr;
+        if (allocated)
+        {
+            resource = uploader.End(uploader.Context, job->Target, job->Decoded);
+            job->Target = TextureLoadTarget{};
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue->Mutex);
+            TextureLoadStats& stats = queue->Stats;
+            stats.BytesOutstanding -= allocated ? job->Bytes : 0;
+            job->State = resource ? TextureLoadState::Ready : TextureLoadState::Failed;
+            --stats.Pending;
+            if (resource)
+            {
+                ++stats.Loaded;
+                stats.BytesLoaded += job->Bytes;
+                stats.DecodeMs += job->DecodeMs;
+                stats.MipMs += job->MipMs;
+                stats.CompressMs += job->CompressMs;
+            }
+            else
+            {
+                ++stats.Failed;
+            }
+        }
+
+        if (job->Callback)
+        {
+            job->Callback(handle, resource, job->Context);
+        }
+    }
+
+    // Memory for opened images, in request order, as the budget allows
+    for (;;)
+    {
+        TextureLoadHandle handle;
+        TextureLoadJob* job;
+        {
+            std::lock_guard<std::mutex> lock(queue->Mutex);
+            if (!CanHandOut(queue))
+            {
+                break;
+            }
+            handle = queue->Waiting.front();
+            queue->Waiting.pop_front();
+            job = GetJob(queue, handle);
+            queue->Stats.BytesOutstanding += job->Bytes;
+        }
+
+        bool allocated = uploader.Begin(uploader.Context, job->Image.Info.Width, job->Image.Info.Height, job->NumLevels,
+            job->Format, &job->Target);
+        if (!allocated)
+        {
+            job->Target = TextureLoadTarget{};
+            ImageFileClose(&job->Image);
+        }
+
+        // A failed allocation reports on the next update
+        {
+            std::lock_guard<std::mutex> lock(queue->Mutex);
+            if (allocated)
+            {
+                job->Decoded = false;
+                job->State = TextureLoadState::Decoding;
+                queue->Work.push_back(handle);
+            }
+            else
+            {
+                queue->Stats.BytesOutstanding -= job->Bytes;
+                job->State = TextureLoadState::Finishing;
+                queue->Finished.push_back(handle);
+            }
+        }
+        if (allocated)
+        {
+            queue->WorkReady.notify_one();
+        }
+    }
+}
+
+//==============================================================================
+void TextureLoaderFlush(TextureLoader* loader, TextureLoadHandle handle)
+{
+    TextureLoadQueue* queue = loader->Queue;
+    for (;;)
+    {
+        TextureLoaderUpdate(loader);
+
+        // Sleeps until a worker gives the upload stage something to do
+        std::unique_lock<std::mutex> lock(queue->Mutex);
+        bool done = handle ? (GetJob(queue, handle)->State == TextureLoadState::Ready ||
+            GetJob(queue, handle)->State == TextureLoadState::Failed) : queue->Stats.Pending == 0;
+        if (done)
+        {
+            return;
+        }
+        queue->UploadReady.wait(lock, [&]() { return !queue->Finished.empty() || CanHandOut(queue); });
+    }
+}
@@ -0,0 +1,128 @@
+//==============================================================================
+// Asynchronous image loading. A pool of workers opens and decodes image files
+// (see ImageFile.h), so the thread drawing frames never waits on the disk or
+// the decoder. That thread runs the upload stage once per frame instead:
+//
+// - An opened image's header gives its size, and the upload stage asks the
+//   uploader for memory to decode into, such as a mapped staging texture.
+//   Memory handed out and not yet finished stays under a byte budget, so a
+//   burst of requests queues rather than allocating everything at once.
+// - A worker decodes an image without mips into that memory a row at a time.
+//   With mips it decodes into scratch memory outside the budget and filters
+//   the rest of the chain there (see MipChain.h), as the filter reads back
+//   what it writes and the uploader's memory may be write-only, then copies
+//   each level into the target, or compresses it for a block compressed
+//   target (see BlockCompress.h). Block compressed DDS files skip all of that
+//   and read their levels as stored.
+// - The upload stage hands decoded images back to the uploader, which turns
+//   them into resources, all in the same pass, then calls the callbacks.
+//
+// The uploader is only ever called from TextureLoaderUpdate, so it may use a
+// context that isn't thread safe. CpuTextureUploader makes CpuTextures.
+//==============================================================================
+#pragma once
+
+#include "MipChain.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// Names one request, from 1 up. Handles aren't reused.
+typedef uint32_t TextureLoadHandle;
+
+enum class TextureLoadState
+{
+    Opening,        // Queued, or reading the header
+    Waiting,        // For memory within the budget
+    Decoding,
+    Finishing,      // Decoded or failed, waiting for the upload stage
+    Ready,
+    Failed,
+};
+
+// Memory for one image and its mip levels, from the uploader
+struct TextureLoadTarget
+{
+    uint8_t* Data[MipMaxLevels];
+    size_t RowPitch[MipMaxLevels];
+    void* Resource;         // The uploader's own, for when the decode is done
+};
+
+struct TextureUploader
+{
+    // Memory for a 'width' x 'height' image in 'format' with 'numLevels'
+    // levels, sized by MipLevelSize. Row pitches of block compressed formats
+    // are per row of blocks. The loader only writes it, never reads it back.
+    bool (*Begin)(void* context, uint32_t width, uint32_t height, uint32_t numLevels, CpuFormat format,
+        TextureLoadTarget* target);
+
+    // Turns a 'decoded' target into the resource passed to the callback.
+    // Otherwise releases it and returns null.
+    void* (*End)(void* context, const TextureLoadTarget& target, bool decoded);
+
+    void* Context;
+};
+
+// 'resource' is the uploader's result, owned by the callee, or null if the
+// load failed
+typedef void (*TextureLoadCallback)(TextureLoadHandle handle, void* resource, void* context);
+
+struct TextureLoadStats
+{
+    uint32_t Pending;           // Requested and not yet Ready or Failed
+    uint32_t Loaded;            // Since the loader was created
+    uint32_t Failed;
+    uint64_t BytesLoaded;
+    uint64_t BytesOutstanding;  // Handed out by the uploader, not yet finished
+    double DecodeMs;            // Worker time, summed over loaded images
+    double MipMs;
+    double CompressMs;          // Or copying uncompressed levels into the target
+};
+
+// Requests and workers, private to TextureLoader.cpp
+struct TextureLoadQueue;
+
+struct TextureLoader
+{
+    TextureLoadQueue* Queue;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Starts 'numWorkers' decode threads, and keeps memory handed out by
+// 'uploader' under 'maxBytesOutstanding', apart from one image at a time that
+// is bigger on its own. Images get full mip chains filtered with 'mips', or
+// only level 0 for MipFilter::None. Block compressed files keep the levels
+// they have. Other images are block compressed to 'format' if it's a block
+// compressed format and they're a whole number of blocks, and otherwise stay
+// R8G8B8A8Unorm.
+bool TextureLoaderCreate(uint32_t numWorkers, uint64_t maxBytesOutstanding, MipFilter mips, CpuFormat format,
+    const TextureUploader& uploader, TextureLoader* loader);
+
+// Stops the workers once they finish their current image. Requests that
+// aren't done are dropped, their targets released, and callbacks not called.
+void TextureLoaderDestroy(TextureLoader* loader);
+
+// Queues 'filename' to load. 'callback' may be null, to poll the state.
+TextureLoadHandle TextureLoaderRequest(TextureLoader* loader, const char* filename, TextureLoadCallback callback,
+    void* context);
+
+TextureLoadState TextureLoaderGetState(const TextureLoader& loader, TextureLoadHandle handle);
+void TextureLoaderGetStats(const TextureLoader& loader, TextureLoadStats* stats);
+
+// Runs the upload stage: gives memory to opened images as the budget allows,
+// and finishes every decoded one. Calls back from here, on this thread.
+void TextureLoaderUpdate(TextureLoader* loader);
+
+// Runs the upload stage until 'handle' is Ready or Failed, or with 0 until
+// every request is
+void TextureLoaderFlush(TextureLoader* loader, TextureLoadHandle handle);
+
+// Makes heap allocated CpuMipChains, which callees free with
+// CpuMipChainDestroy and delete
+extern const TextureUploader CpuTextureUploader;
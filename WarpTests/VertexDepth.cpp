@@ -0,0 +1,237 @@
+//==============================================================================
+#include "VertexDepth.h"
+#include <assert.h>
+#include <algorithm>
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline const float* Row(const CpuTexture& texture, uint32_t y)
+{
+    return (const float*)(texture.Data + (size_t)y * texture.RowPitch);
+}
+
+// Min and max down rows [y0, y1) of every column
+static void ReduceColumns(const CpuTexture& depth, uint32_t y0, uint32_t y1, VertexDepth* vertexDepth)
+{
+    float* columnMin = vertexDepth->ColumnMin.data();
+    float* columnMax = vertexDepth->ColumnMax.data();
+
+    const float* first = Row(depth, y0);
+    std::copy(first, first + depth.Width, columnMin);
+    std::copy(first, first + depth.Width, columnMax);
+
+    for (uint32_t y = y0 + 1; y < y1; ++y)
+    {
+        const float* row = Row(depth, y);
+
+        uint32_t x = 0;
+        for (; x + SimdWidth <= depth.Width; x += SimdWidth)
+        {
+            SimdFloat d = SimdLoad(row + x);
+            SimdStore(columnMin + x, SimdMin(SimdLoad(columnMin + x), d));
+            SimdStore(columnMax + x, SimdMax(SimdLoad(columnMax + x), d));
+        }
+        for (; x < depth.Width; ++x)
+        {
+            columnMin[x] = std::min(columnMin[x], row[x]);
+            columnMax[x] = std::max(columnMax[x], row[x]);
+        }
+    }
+}
+
+// Splits the texels of rows [y0, y1) of every column into those nearer than
+// the column's split depth and the rest, and sums each side
+static void ClassifyColumns(const CpuTexture& depth, uint32_t y0, uint32_t y1, VertexDepth* vertexDepth)
+{
+    const float* split = vertexDepth->ColumnSplit.data();
+    float* nearCount = vertexDepth->ColumnNearCount.data();
+    float* nearSum = vertexDepth->ColumnNearSum.data();
+    float* farSum = vertexDepth->ColumnFarSum.data();
+
+    std::fill(nearCount, nearCount + depth.Width, 0.f);
+    std::fill(nearSum, nearSum + depth.Width, 0.f);
+    std::fill(farSum, farSum + depth.Width, 0.f);
+
+    SimdFloat one = SimdSet(1.f);
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const float* row = Row(depth, y);
+
+        uint32_t x = 0;
+        for (; x + SimdWidth <= depth.Width; x += SimdWidth)
+        {
+            SimdFloat d = SimdLoad(row + x);
+            SimdFloat isNear = SimdCmpLt(d, SimdLoad(split + x));
+            SimdStore(nearCount + x, SimdAdd(SimdLoad(nearCount + x), SimdAnd(isNear, one)));
+            SimdStore(nearSum + x, SimdAdd(SimdLoad(nearSum + x), SimdAnd(isNear, d)));
+            SimdStore(farSum + x, SimdAdd(SimdLoad(farSum + x), SimdAndNot(isNear, d)));
+        }
+        for (; x < depth.Width; ++x)
+        {
+            if (row[x] < split[x])
+            {
+                nearCount[x] += 1.f;
+                nearSum[x] += row[x];
+            }
+            else
+            {
+                farSum[x] += row[x];
+            }
+        }
+    }
+}
+
+//==============================================================================
+uint32_t VertexDepthCellStart(uint32_t i, uint32_t verts, uint32_t size)
+{
+    // Halfway between vertex i - 1 and vertex i, which sits at i * size / (verts - 1)
+    if (i == 0)
+    {
+        return 0;
+    }
+    if (i >= verts)
+    {
+        return size;
+    }
+    return (uint32_t)(((2ull * i - 1) * size) / (2ull * (verts - 1)));
+}
+
+//==============================================================================
+bool VertexDepthCreate(uint32_t width, uint32_t height, uint32_t vertsWidth, uint32_t vertsHeight, VertexDepth* vertexDepth)
+{
+    // Every cell must cover at least one texel
+    if (vertsWidth < 2 || vertsHeight < 2 || width < 2 * (vertsWidth - 1) || height < 2 * (vertsHeight - 1))
+    {
+        assert(false);
+        return false;
+    }
+
+    VertexDepthDestroy(vertexDepth);
+
+    if (!CpuTextureCreate(vertsWidth, vertsHeight, CpuFormat::R32Float, &vertexDepth->Depths))
+    {
+        assert(false);
+        return false;
+    }
+
+    vertexDepth->CellX.resize(vertsWidth + 1);
+    for (uint32_t i = 0; i <= vertsWidth; ++i)
+    {
+        vertexDepth->CellX[i] = VertexDepthCellStart(i, vertsWidth, width);
+    }
+    vertexDepth->CellY.resize(vertsHeight + 1);
+    for (uint32_t i = 0; i <= vertsHeight; ++i)
+    {
+        vertexDepth->CellY[i] = VertexDepthCellStart(i, vertsHeight, height);
+    }
+
+    vertexDepth->ColumnMin.resize(width);
+    vertexDepth->ColumnMax.resize(width);
+    vertexDepth->ColumnSplit.resize(width);
+    vertexDepth->ColumnNearCount.resize(width);
+    vertexDepth->ColumnNearSum.resize(width);
+    vertexDepth->ColumnFarSum.resize(width);
+
+    return true;
+}
+
+//==============================================================================
+void VertexDepthDestroy(VertexDepth* vertexDepth)
+{
+    CpuTextureDestroy(&vertexDepth->Depths);
+}
+
+//==============================================================================
+void VertexDepthBuild(const CpuTexture& depth, VertexDepthMode mode, VertexDepth* vertexDepth)
+{
+    assert(depth.Format == CpuFormat::R32Float);
+    assert(depth.Width == vertexDepth->ColumnMin.size() && depth.Height == vertexDepth->CellY.back());
+
+    const std::vector<uint32_t>& cellX = vertexDepth->CellX;
+    const std::vector<uint32_t>& cellY = vertexDepth->CellY;
+    uint32_t vertsWidth = vertexDepth->Depths.Width;
+
+    for (uint32_t vy = 0; vy < vertexDepth->Depths.Height; ++vy)
+    {
+        uint32_t y0 = cellY[vy];
+        uint32_t y1 = cellY[vy + 1];
+        float* out = (float*)(vertexDepth->Depths.Data + (size_t)vy * vertexDepth->Depths.RowPitch);
+
+        // The vertical reduction runs across whole rows, then each cell
+        // reduces its own columns
+        ReduceColumns(depth, y0, y1, vertexDepth);
+
+        for (uint32_t vx = 0; vx < vertsWidth; ++vx)
+        {
+            uint32_t x0 = cellX[vx];
+            uint32_t x1 = cellX[vx + 1];
+
+            const float* columnMin = vertexDepth->ColumnMin.data();
+            const float* columnMax = vertexDepth->ColumnMax.data();
+            float minDepth = *std::min_element(columnMin + x0, columnMin + x1);
+            float maxDepth = *std::max_element(columnMax + x0, columnMax + x1);
+
+            switch (mode)
+            {
+            case VertexDepthMode::Nearest:
+                out[vx] = minDepth;
+                break;
+
+            case VertexDepthMode::Farthest:
+                out[vx] = maxDepth;
+                break;
+
+            default:
+                // Split halfway between the two, resolved below
+                std::fill(vertexDepth->ColumnSplit.data() + x0, vertexDepth->ColumnSplit.data() + x1, (minDepth + maxDepth) * 0.5f);
+                break;
+            }
+        }
+
+        if (mode != VertexDepthMode::Coverage)
+        {
+            continue;
+        }
+
+        ClassifyColumns(depth, y0, y1, vertexDepth);
+
+        for (uint32_t vx = 0; vx < vertsWidth; ++vx)
+        {
+            uint32_t x0 = cellX[vx];
+            uint32_t x1 = cellX[vx + 1];
+
+            float nearCount = 0;
+            float nearSum = 0;
+            float farSum = 0;
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                nearCount += vertexDepth->ColumnNearCount[x];
+                nearSum += vertexDepth->ColumnNearSum[x];
+                farSum += vertexDepth->ColumnFarSum[x];
+            }
+
+            // Ties go to the near layer. A flat cell has no near texels and
+            // resolves to its single depth.
+            float farCount = (float)((x1 - x0) * (y1 - y0)) - nearCount;
+            out[vx] = (nearCount >= farCount) ? nearSum / nearCount : farSum / farCount;
+        }
+    }
+}
+
+//==============================================================================
+const char* VertexDepthModeName(VertexDepthMode mode)
+{
+    switch (mode)
+    {
+    case VertexDepthMode::Nearest:
+        return "Nearest";
+    case VertexDepthMode::Farthest:
+        return "Farthest";
+    case VertexDepthMode::Coverage:
+        return "Coverage";
+    default:
+        assert(false);
+        return "";
+    }
+}
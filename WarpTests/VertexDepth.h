@@ -0,0 +1,63 @@
+//==============================================================================
+// Per-vertex depth for the fixed positional warp grid. Loading the single depth
+// texel under each grid vertex aliases: a thin object either lands on a vertex
+// and pulls a whole ring of cells with it, or falls between vertices and is
+// lost. This reduces the depth texels around each vertex, out to halfway to
+// its neighbors, to one representative depth per vertex.
+//
+// The result is a texture with one texel per grid vertex. Vertex texcoords are
+// i / (verts - 1), so the warp shaders read it unchanged with TextureSize set
+// to (verts - 1). VertexDepthCS.hlsli computes the same thing on the GPU.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include <stdint.h>
+#include <vector>
+
+//==============================================================================
+// Structures
+//==============================================================================
+enum class VertexDepthMode
+{
+    Nearest,    // Min depth, keeps thin foreground objects from being dropped
+    Farthest,   // Max depth, keeps foreground edges from being stretched outwards
+    Coverage,   // Mean depth of whichever of the near and far layers covers more texels
+    Count
+};
+
+struct VertexDepth
+{
+    CpuTexture Depths;              // R32Float, one texel per grid vertex
+
+    // Depth texel bounds of each vertex's cell, VertsWidth + 1 and
+    // VertsHeight + 1 entries
+    std::vector<uint32_t> CellX;
+    std::vector<uint32_t> CellY;
+
+    // Per depth column scratch, reused between builds
+    std::vector<float> ColumnMin;
+    std::vector<float> ColumnMax;
+    std::vector<float> ColumnSplit;
+    std::vector<float> ColumnNearCount;
+    std::vector<float> ColumnNearSum;
+    std::vector<float> ColumnFarSum;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Sizes 'vertexDepth' for a 'vertsWidth' x 'vertsHeight' grid over a
+// 'width' x 'height' depth buffer
+bool VertexDepthCreate(uint32_t width, uint32_t height, uint32_t vertsWidth, uint32_t vertsHeight, VertexDepth* vertexDepth);
+void VertexDepthDestroy(VertexDepth* vertexDepth);
+
+// First depth texel of the cell around vertex 'i' of 'verts', along an axis of
+// 'size' texels. Vertex i covers [VertexDepthCellStart(i), VertexDepthCellStart(i + 1)).
+uint32_t VertexDepthCellStart(uint32_t i, uint32_t verts, uint32_t size);
+
+// Rebuilds every vertex depth from 'depth', which must match the created size
+void VertexDepthBuild(const CpuTexture& depth, VertexDepthMode mode, VertexDepth* vertexDepth);
+
+const char* VertexDepthModeName(VertexDepthMode mode);
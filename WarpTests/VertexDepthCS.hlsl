@@ -0,0 +1,82 @@
+// Reduces the depth texels around each positional warp grid vertex to one
+// representative depth (see VertexDepth.h). One thread per vertex.
+Texture2D<float> SourceDepth;
+RWTexture2D<float> VertexDepth;
+
+cbuffer Constants
+{
+    uint2 DepthSize;
+    uint2 VertexCount;
+    uint Mode;          // VertexDepthMode: 0 nearest, 1 farthest, 2 coverage
+};
+
+// First depth texel of the cell around vertex 'i', halfway to vertex i - 1
+uint CellStart(uint i, uint verts, uint size)
+{
+    if (i == 0)
+    {
+        return 0;
+    }
+    if (i >= verts)
+    {
+        return size;
+    }
+    return ((2 * i - 1) * size) / (2 * (verts - 1));
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (any(id.xy >= VertexCount))
+    {
+        return;
+    }
+
+    uint2 first = uint2(CellStart(id.x, VertexCount.x, DepthSize.x), CellStart(id.y, VertexCount.y, DepthSize.y));
+    uint2 end = uint2(CellStart(id.x + 1, VertexCount.x, DepthSize.x), CellStart(id.y + 1, VertexCount.y, DepthSize.y));
+
+    float minDepth = 1;
+    float maxDepth = 0;
+    for (uint y = first.y; y < end.y; ++y)
+    {
+        for (uint x = first.x; x < end.x; ++x)
+        {
+            float depth = SourceDepth.Load(int3(x, y, 0));
+            minDepth = min(minDepth, depth);
+            maxDepth = max(maxDepth, depth);
+        }
+    }
+
+    float result = (Mode == 0) ? minDepth : maxDepth;
+    [branch]
+    if (Mode == 2)
+    {
+        // Mean of whichever side of the halfway split covers more texels,
+        // ties going to the near side
+        float split = (minDepth + maxDepth) * 0.5f;
+        float nearCount = 0;
+        float nearSum = 0;
+        float farSum = 0;
+        for (uint y = first.y; y < end.y; ++y)
+        {
+            for (uint x = first.x; x < end.x; ++x)
+            {
+                float depth = SourceDepth.Load(int3(x, y, 0));
+                if (depth < split)
+                {
+                    nearCount += 1;
+                    nearSum += depth;
+                }
+                else
+                {
+                    farSum += depth;
+                }
+            }
+        }
+
+        float farCount = (end.x - first.x) * (end.y - first.y) - nearCount;
+        result = (nearCount >= farCount) ? nearSum / nearCount : farSum / farCount;
+    }
+
+    VertexDepth[id.xy] = result;
+}
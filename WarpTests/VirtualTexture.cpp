@@ -0,0 +1,611 @@
+//==============================================================================
+#include "VirtualTexture.h"
+#include <algorithm>
+#include <assert.h>
+#include <condition_variable>
+#include <deque>
+#include <math.h>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+//==============================================================================
+// Constants
+//==============================================================================
+static const uint32_t NoSlot = 0xffffffff;
+static const uint32_t NoPage = 0xffffffff;
+static const uint32_t SlotMask = 0xffffff;
+static const uint32_t LevelShift = 24;
+static const float Pi = 3.14159265f;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+// A tile streaming into one of the buffers
+struct VirtualTextureTile
+{
+    uint32_t Page;
+    uint32_t Buffer;
+};
+
+struct VirtualTextureStream
+{
+    // What the thread reads, which doesn't change after creation
+    TextureFile File;
+    CpuFormat Format;
+    VirtualTextureLevel Levels[MipMaxLevels];
+    uint32_t TailLevel;
+
+    std::thread Thread;
+    std::mutex Mutex;
+    std::condition_variable WorkReady;
+    std::condition_variable WorkDone;
+    bool Exiting = false;
+    std::deque<VirtualTextureTile> Queued;
+    std::vector<VirtualTextureTile> Finished;
+    uint32_t Busy = 0;
+
+    // VirtualTextureMaxPending tiles laid out like atlas slots, and the ones
+    // not holding a tile
+    std::vector<uint8_t> Buffers;
+    size_t BufferPitch;
+    size_t BufferBytes;
+    std::vector<uint32_t> FreeBuffers;
+
+    // Feedback's scratch, kept to save allocating every pass
+    std::vector<uint32_t> Requests;
+    std::vector<VirtualTextureTile> Installing;
+};
+
+//==============================================================================
+// Helpers
+//==============================================================================
+static inline uint32_t PageLevel(const VirtualTextureLevel* levels, uint32_t tailLevel, uint32_t page)
+{
+    uint32_t level = tailLevel;
+    while (level > 0 && page < levels[level].FirstPage)
+    {
+        --level;
+    }
+    return level;
+}
+
+// Copies a page's tile and its border into a slot laid out at 'target', a
+// row of blocks at a time. Longitude wraps and latitude clamps.
+static void CopyTile(const TextureFile& file, CpuFormat format, const VirtualTextureLevel& level, uint32_t levelIndex,
+    uint32_t page, uint8_t* target, size_t targetPitch)
+{
+    CpuTexture source;
+    TextureFileGetLevel(file, 0, levelIndex, &source);
+
+    uint32_t blockSize = CpuFormatBlockSize(format);
+    uint32_t blockBytes = CpuFormatBytesPerBlock(format);
+    uint32_t blocksWide = (level.Width + blockSize - 1) / blockSize;
+    uint32_t blocksHigh = (level.Height + blockSize - 1) / blockSize;
+    uint32_t slotBlocks = VirtualTextureSlotSize / blockSize;
+    uint32_t tileBlocks = VirtualTextureTileSize / blockSize;
+    uint32_t borderBlocks = VirtualTextureTileBorder / blockSize;
+
+    uint32_t tile = page - level.FirstPage;
+    int32_t left = (int32_t)((tile % level.TilesX) * tileBlocks) - (int32_t)borderBlocks;
+    int32_t top = (int32_t)((tile / level.TilesX) * tileBlocks) - (int32_t)borderBlocks;
+    uint32_t startX = (uint32_t)((left % (int32_t)blocksWide + (int32_t)blocksWide) % (int32_t)blocksWide);
+
+    for (uint32_t row = 0; row < slotBlocks; ++row)
+    {
+        int32_t y = std::min(std::max(top + (int32_t)row, 0), (int32_t)blocksHigh - 1);
+        const uint8_t* sourceRow = source.Data + (size_t)y * source.RowPitch;
+        uint8_t* out = target + row * targetPitch;
+
+        // In runs up to the right edge, then round again from the left
+        uint32_t x = startX;
+        for (uint32_t remaining = slotBlocks; remaining > 0;)
+        {
+            uint32_t count = std::min(remaining, blocksWide - x);
+            memcpy(out, sourceRow + (size_t)x * blockBytes, (size_t)count * blockBytes);
+            out += (size_t)count * blockBytes;
+            remaining -= count;
+            x = 0;
+        }
+    }
+}
+
+static inline uint8_t* SlotData(const VirtualTexture& vt, uint32_t slot)
+{
+    uint32_t slotBlocks = VirtualTextureSlotSize / CpuFormatBlockSize(vt.Format);
+    return vt.Atlas.Data + (size_t)(slot / vt.SlotsX) * slotBlocks * vt.Atlas.RowPitch +
+        (size_t)(slot % vt.SlotsX) * slotBlocks * CpuFormatBytesPerBlock(vt.Format);
+}
+
+static void LruUnlink(VirtualTexture* vt, uint32_t slot)
+{
+    uint32_t prev = vt->LruPrev[slot];
+    uint32_t next = vt->LruNext[slot];
+    (prev != NoSlot ? vt->LruNext[prev] : vt->LruHead) = next;
+    (next != NoSlot ? vt->LruPrev[next] : vt->LruTail) = prev;
+}
+
+static void LruPushHead(VirtualTexture* vt, uint32_t slot)
+{
+    vt->LruPrev[slot] = NoSlot;
+    vt->LruNext[slot] = vt->LruHead;
+    (vt->LruHead != NoSlot ? vt->LruPrev[vt->LruHead] : vt->LruTail) = slot;
+    vt->LruHead = slot;
+}
+
+// Marks a slot just used. The tail levels' slots aren't in the list.
+static inline void LruTouch(VirtualTexture* vt, uint32_t slot)
+{
+    if (slot >= vt->NumPinnedSlots && vt->LruHead != slot)
+    {
+        LruUnlink(vt, slot);
+        LruPushHead(vt, slot);
+    }
+}
+
+// Each page gets its own slot or its parent's entry, from the tail level,
+// which is always resident, down to level 0
+static void RebuildPageTable(VirtualTexture* vt)
+{
+    for (int32_t level = (int32_t)vt->TailLevel; level >= 0; --level)
+    {
+        const VirtualTextureLevel& lv = vt->Levels[level];
+        for (uint32_t ty = 0; ty < lv.TilesY; ++ty)
+        {
+            for (uint32_t tx = 0; tx < lv.TilesX; ++tx)
+            {
+                uint32_t page = lv.FirstPage + ty * lv.TilesX + tx;
+                uint32_t slot = vt->PageSlot[page];
+                if (slot != NoSlot)
+                {
+                    vt->PageTable[page] = slot | ((uint32_t)level << LevelShift);
+                }
+                else
+                {
+                    const VirtualTextureLevel& parent = vt->Levels[level + 1];
+                    uint32_t px = std::min(tx / 2, parent.TilesX - 1);
+                    uint32_t py = std::min(ty / 2, parent.TilesY - 1);
+                    vt->PageTable[page] = vt->PageTable[parent.FirstPage + py * parent.TilesX + px];
+                }
+            }
+        }
+    }
+}
+
+static void StreamMain(VirtualTextureStream* stream)
+{
+    for (;;)
+    {
+        VirtualTextureTile tile;
+        {
+            std::unique_lock<std::mutex> lock(stream->Mutex);
+            stream->WorkReady.wait(lock, [&]() { return stream->Exiting || !stream->Queued.empty(); });
+            if (stream->Exiting)
+            {
+                return;
+            }
+            tile = stream->Queued.front();
+            stream->Queued.pop_front();
+            ++stream->Busy;
+        }
+
+        uint32_t level = PageLevel(stream->Levels, stream->TailLevel, tile.Page);
+        CopyTile(stream->File, stream->Format, stream->Levels[level], level, tile.Page,
+            &stream->Buffers[tile.Buffer * stream->BufferBytes], stream->BufferPitch);
+
+        {
+            std::lock_guard<std::mutex> lock(stream->Mutex);
+            stream->Finished.push_back(tile);
+            --stream->Busy;
+        }
+        stream->WorkDone.notify_all();
+    }
+}
+
+// Panorama coordinates of the direction through NDC (x, y)
+static inline void NdcToUv(const float m[16], float x, float y, float* u, float* v)
+{
+    float nearPoint[4], farPoint[4];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        nearPoint[i] = x * m[0 * 4 + i] + y * m[1 * 4 + i] + m[3 * 4 + i];
+        farPoint[i] = nearPoint[i] + m[2 * 4 + i];
+    }
+    float direction[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        direction[i] = farPoint[i] / farPoint[3] - nearPoint[i] / nearPoint[3];
+    }
+    VirtualTextureDirectionToUv(direction, u, v);
+}
+
+// Atlas texel of the top left of a bilinear footprint at 'level', or the
+// nearest resident level coarser than it, and the blend weights
+static inline void Lookup(const VirtualTexture& vt, float u, float v, uint32_t level, int32_t* x, int32_t* y, float* fx,
+    float* fy)
+{
+    u -= floorf(u);
+    for (;;)
+    {
+        const VirtualTextureLevel& lv = vt.Levels[level];
+        float tx = u * lv.Width - 0.5f;
+        float ty = v * lv.Height - 0.5f;
+        float x0 = floorf(tx);
+        float y0 = floorf(ty);
+        *fx = tx - x0;
+        *fy = ty - y0;
+        int32_t ix = (x0 < 0.f) ? (int32_t)lv.Width - 1 : std::min((int32_t)x0, (int32_t)lv.Width - 1);
+        int32_t iy = (int32_t)y0;
+        if (iy < 0 || iy >= (int32_t)lv.Height - 1)
+        {
+            iy = std::min(std::max(iy, 0), (int32_t)lv.Height - 1);
+            *fy = 0.f;
+        }
+
+        uint32_t page = lv.FirstPage + (iy / VirtualTextureTileSize) * lv.TilesX + ix / VirtualTextureTileSize;
+        uint32_t entry = vt.PageTable[page];
+        uint32_t entryLevel = entry >> LevelShift;
+        if (entryLevel == level)
+        {
+            uint32_t slot = entry & SlotMask;
+            *x = (int32_t)((slot % vt.SlotsX) * VirtualTextureSlotSize + VirtualTextureTileBorder + ix % VirtualTextureTileSize);
+            *y = (int32_t)((slot / vt.SlotsX) * VirtualTextureSlotSize + VirtualTextureTileBorder + iy % VirtualTextureTileSize);
+            return;
+        }
+        level = entryLevel;
+    }
+}
+
+// Bilinear samples at one level per lane
+static void SampleLevels(const VirtualTexture& vt, const float* u, const float* v, const uint32_t* level, SimdFloat out[4])
+{
+    alignas(32) int32_t x[SimdWidth], y[SimdWidth];
+    alignas(32) float fx[SimdWidth], fy[SimdWidth];
+    for (uint32_t i = 0; i < SimdWidth; ++i)
+    {
+        Lookup(vt, u[i], v[i], level[i], &x[i], &y[i], &fx[i], &fy[i]);
+    }
+
+    SimdInt x0 = SimdIntLoad(x);
+    SimdInt y0 = SimdIntLoad(y);
+    SimdInt x1 = SimdIntAdd(x0, SimdIntSet(1));
+    SimdInt y1 = SimdIntAdd(y0, SimdIntSet(1));
+    SimdFloat t00[4], t10[4], t01[4], t11[4];
+    CpuTextureLoad(vt.Atlas, x0, y0, t00);
+    CpuTextureLoad(vt.Atlas, x1, y0, t10);
+    CpuTextureLoad(vt.Atlas, x0, y1, t01);
+    CpuTextureLoad(vt.Atlas, x1, y1, t11);
+
+    SimdFloat wx = SimdLoad(fx);
+    SimdFloat wy = SimdLoad(fy);
+    for (int c = 0; c < 4; ++c)
+    {
+        out[c] = SimdLerp(SimdLerp(t00[c], t10[c], wx), SimdLerp(t01[c], t11[c], wx), wy);
+    }
+}
+
+//==============================================================================
+bool VirtualTextureCreate(const char* filename, uint32_t numSlots, VirtualTexture* vt)
+{
+    if (!TextureFileOpen(filename, &vt->File))
+    {
+        return false;
+    }
+    const TextureFileHeader& header = *vt->File.Header;
+    if (header.ArraySize != 1)
+    {
+        TextureFileClose(&vt->File);
+        return false;
+    }
+
+    vt->Format = vt->File.Format;
+    vt->NumLevels = header.NumLevels;
+    vt->TailLevel = header.NumLevels - 1;
+    vt->NumPages = 0;
+    for (uint32_t level = 0; level < vt->NumLevels; ++level)
+    {
+        VirtualTextureLevel& lv = vt->Levels[level];
+        lv.Width = MipLevelSize(header.Width, level);
+        lv.Height = MipLevelSize(header.Height, level);
+        lv.TilesX = (lv.Width + VirtualTextureTileSize - 1) / VirtualTextureTileSize;
+        lv.TilesY = (lv.Height + VirtualTextureTileSize - 1) / VirtualTextureTileSize;
+        lv.FirstPage = vt->NumPages;
+        vt->NumPages += lv.TilesX * lv.TilesY;
+        if (lv.TilesX * lv.TilesY == 1)
+        {
+            vt->TailLevel = level;
+            break;
+        }
+    }
+
+    // The tail level's tiles go first and stay
+    const VirtualTextureLevel& tail = vt->Levels[vt->TailLevel];
+    vt->NumPinnedSlots = tail.TilesX * tail.TilesY;
+    vt->NumSlots = numSlots;
+    vt->SlotsX = (uint32_t)ceilf(sqrtf((float)numSlots));
+    uint32_t slotsY = (numSlots + vt->SlotsX - 1) / vt->SlotsX;
+    if (numSlots <= vt->NumPinnedSlots || numSlots > SlotMask ||
+        !CpuTextureCreate(vt->SlotsX * VirtualTextureSlotSize, slotsY * VirtualTextureSlotSize, vt->Format, &vt->Atlas))
+    {
+        assert(false);
+        TextureFileClose(&vt->File);
+        return false;
+    }
+
+    vt->PageTable.assign(vt->NumPages, 0);
+    vt->PageSlot.assign(vt->NumPages, NoSlot);
+    vt->PagePass.assign(vt->NumPages, 0);
+    vt->PagePending.assign(vt->NumPages, 0);
+    vt->SlotPage.assign(numSlots, NoPage);
+    vt->LruPrev.assign(numSlots, NoSlot);
+    vt->LruNext.assign(numSlots, NoSlot);
+    vt->LruHead = NoSlot;
+    vt->LruTail = NoSlot;
+    vt->Installed.clear();
+    vt->Pass = 0;
+    vt->Stats = VirtualTextureStats{};
+
+    for (uint32_t slot = 0; slot < vt->NumPinnedSlots; ++slot)
+    {
+        uint32_t page = tail.FirstPage + slot;
+        CopyTile(vt->File, vt->Format, tail, vt->TailLevel, page, SlotData(*vt, slot), vt->Atlas.RowPitch);
+        vt->SlotPage[slot] = page;
+        vt->PageSlot[page] = slot;
+    }
+    for (uint32_t slot = vt->NumPinnedSlots; slot < numSlots; ++slot)
+    {
+        LruPushHead(vt, slot);
+    }
+    RebuildPageTable(vt);
+
+    VirtualTextureStream* stream = new VirtualTextureStream();
+    stream->File = vt->File;
+    stream->Format = vt->Format;
+    memcpy(stream->Levels, vt->Levels, sizeof(stream->Levels));
+    stream->TailLevel = vt->TailLevel;
+    uint32_t slotBlocks = VirtualTextureSlotSize / CpuFormatBlockSize(vt->Format);
+    stream->BufferPitch = (size_t)slotBlocks * CpuFormatBytesPerBlock(vt->Format);
+    stream->BufferBytes = stream->BufferPitch * slotBlocks;
+    stream->Buffers.resize(stream->BufferBytes * VirtualTextureMaxPending);
+    for (uint32_t i = 0; i < VirtualTextureMaxPending; ++i)
+    {
+        stream->FreeBuffers.push_back(VirtualTextureMaxPending - 1 - i);
+    }
+    stream->Requests.reserve(vt->NumPages);
+    stream->Installing.reserve(VirtualTextureMaxPending);
+    stream->Thread = std::thread(StreamMain, stream);
+    vt->Stream = stream;
+
+    vt->Stats.ResidentTiles = vt->NumPinnedSlots;
+    vt->Stats.ResidentBytes = (uint64_t)vt->Atlas.RowPitch * (vt->Atlas.Height / CpuFormatBlockSize(vt->Format)) +
+        (uint64_t)vt->NumPages * (3 * sizeof(uint32_t) + sizeof(uint8_t)) + (uint64_t)numSlots * 3 * sizeof(uint32_t) +
+        stream->Buffers.size();
+    return true;
+}
+
+//==============================================================================
+void VirtualTextureDestroy(VirtualTexture* vt)
+{
+    VirtualTextureStream* stream = vt->Stream;
+    if (stream)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stream->Mutex);
+            stream->Exiting = true;
+        }
+        stream->WorkReady.notify_all();
+        stream->Thread.join();
+        delete stream;
+        vt->Stream = nullptr;
+    }
+    CpuTextureDestroy(&vt->Atlas);
+    TextureFileClose(&vt->File);
+}
+
+//==============================================================================
+void VirtualTextureFeedback(VirtualTexture* vt, const float invViewProj[16], uint32_t width, uint32_t height)
+{
+    VirtualTextureStream* stream = vt->Stream;
+    std::vector<uint32_t>& requests = stream->Requests;
+    requests.clear();
+    ++vt->Pass;
+    ++vt->Stats.FeedbackPasses;
+
+    const VirtualTextureLevel& top = vt->Levels[0];
+    float pixelX = 2.f / width;
+    float pixelY = 2.f / height;
+    for (uint32_t py = VirtualTextureFeedbackStride / 2; py < height; py += VirtualTextureFeedbackStride)
+    {
+        for (uint32_t px = VirtualTextureFeedbackStride / 2; px < width; px += VirtualTextureFeedbackStride)
+        {
+            // The footprint from the neighboring pixels' coordinates, as
+            // hardware takes derivatives
+            float x = (px + 0.5f) * pixelX - 1.f;
+            float y = 1.f - (py + 0.5f) * pixelY;
+            float u, v, uRight, vRight, uDown, vDown;
+            NdcToUv(invViewProj, x, y, &u, &v);
+            NdcToUv(invViewProj, x + pixelX, y, &uRight, &vRight);
+            NdcToUv(invViewProj, x, y - pixelY, &uDown, &vDown);
+            float du[2] = { uRight - u, uDown - u };
+            float dv[2] = { vRight - v, vDown - v };
+            float footprint = 0.f;
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                du[i] -= floorf(du[i] + 0.5f);
+                footprint = std::max(footprint, sqrtf(du[i] * du[i] * top.Width * top.Width + dv[i] * dv[i] * top.Height * top.Height));
+            }
+            float lod = (footprint > 1.f) ? log2f(footprint) : 0.f;
+            uint32_t finest = std::min((uint32_t)lod, vt->TailLevel);
+
+            // Trilinear reads this level and the next
+            u -= floorf(u);
+            for (uint32_t level = finest; level <= std::min(finest + 1, vt->TailLevel); ++level)
+            {
+                const VirtualTextureLevel& lv = vt->Levels[level];
+                uint32_t tx = std::min((uint32_t)(u * lv.Width) / VirtualTextureTileSize, lv.TilesX - 1);
+                uint32_t ty = std::min((uint32_t)(v * lv.Height) / VirtualTextureTileSize, lv.TilesY - 1);
+                uint32_t page = lv.FirstPage + ty * lv.TilesX + tx;
+                if (vt->PagePass[page] == vt->Pass)
+                {
+                    continue;
+                }
+                vt->PagePass[page] = vt->Pass;
+                ++vt->Stats.PagesNeeded;
+
+                // A missing page samples its resident ancestor meanwhile
+                uint32_t slot = vt->PageSlot[page];
+                if (slot == NoSlot)
+                {
+                    ++vt->Stats.PagesMissed;
+                    slot = vt->PageTable[page] & SlotMask;
+                    if (!vt->PagePending[page])
+                    {
+                        requests.push_back(page);
+                    }
+                }
+                LruTouch(vt, slot);
+            }
+        }
+    }
+
+    // Coarse levels first, as each of their tiles covers more of the view.
+    // Pages are numbered from level 0 up.
+    std::sort(requests.begin(), requests.end(), [](uint32_t a, uint32_t b) { return a > b; });
+    {
+        std::lock_guard<std::mutex> lock(stream->Mutex);
+        for (uint32_t i = 0; i < requests.size() && !stream->FreeBuffers.empty(); ++i)
+        {
+            VirtualTextureTile tile;
+            tile.Page = requests[i];
+            tile.Buffer = stream->FreeBuffers.back();
+            stream->FreeBuffers.pop_back();
+            stream->Queued.push_back(tile);
+            vt->PagePending[tile.Page] = 1;
+            ++vt->Stats.PendingTiles;
+        }
+    }
+    stream->WorkReady.notify_all();
+}
+
+//==============================================================================
+uint32_t VirtualTextureUpdate(VirtualTexture* vt, uint32_t maxTiles)
+{
+    VirtualTextureStream* stream = vt->Stream;
+    std::vector<VirtualTextureTile>& installing = stream->Installing;
+    installing.clear();
+    vt->Installed.clear();
+    {
+        std::lock_guard<std::mutex> lock(stream->Mutex);
+        uint32_t count = std::min((uint32_t)stream->Finished.size(), maxTiles);
+        installing.assign(stream->Finished.begin(), stream->Finished.begin() + count);
+        stream->Finished.erase(stream->Finished.begin(), stream->Finished.begin() + count);
+    }
+
+    uint32_t slotBlocks = VirtualTextureSlotSize / CpuFormatBlockSize(vt->Format);
+    bool changed = false;
+    for (const VirtualTextureTile& tile : installing)
+    {
+        vt->PagePending[tile.Page] = 0;
+        --vt->Stats.PendingTiles;
+
+        // Empty slots sit at the tail of the LRU list. One needed by the last
+        // feedback pass stays, and the tile waits to be asked for again.
+        uint32_t slot = vt->LruTail;
+        uint32_t evicted = vt->SlotPage[slot];
+        if (evicted != NoPage && vt->PagePass[evicted] == vt->Pass)
+        {
+            continue;
+        }
+        if (evicted != NoPage)
+        {
+            vt->PageSlot[evicted] = NoSlot;
+            ++vt->Stats.TilesEvicted;
+            --vt->Stats.ResidentTiles;
+        }
+
+        const uint8_t* buffer = &stream->Buffers[tile.Buffer * stream->BufferBytes];
+        uint8_t* target = SlotData(*vt, slot);
+        for (uint32_t row = 0; row < slotBlocks; ++row)
+        {
+            memcpy(target + (size_t)row * vt->Atlas.RowPitch, buffer + row * stream->BufferPitch, stream->BufferPitch);
+        }
+        vt->SlotPage[slot] = tile.Page;
+        vt->PageSlot[tile.Page] = slot;
+        LruTouch(vt, slot);
+        vt->Installed.push_back(slot);
+        ++vt->Stats.TilesStreamed;
+        ++vt->Stats.ResidentTiles;
+        changed = true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stream->Mutex);
+        for (const VirtualTextureTile& tile : installing)
+        {
+            stream->FreeBuffers.push_back(tile.Buffer);
+        }
+    }
+
+    if (changed)
+    {
+        RebuildPageTable(vt);
+    }
+    return (uint32_t)vt->Installed.size();
+}
+
+//==============================================================================
+void VirtualTextureFlush(VirtualTexture* vt)
+{
+    VirtualTextureStream* stream = vt->Stream;
+    {
+        std::unique_lock<std::mutex> lock(stream->Mutex);
+        stream->WorkDone.wait(lock, [&]() { return stream->Queued.empty() && stream->Busy == 0; });
+    }
+    VirtualTextureUpdate(vt, VirtualTextureMaxPending);
+}
+
+//==============================================================================
+void VirtualTextureSample(const VirtualTexture& vt, SimdFloat u, SimdFloat v, SimdFloat lod, SimdFloat out[4])
+{
+    lod = SimdMin(SimdMax(lod, SimdZero()), SimdSet((float)vt.TailLevel));
+    SimdFloat level = SimdFloor(lod);
+    SimdFloat blend = SimdSub(lod, level);
+
+    alignas(32) float vu[SimdWidth], vv[SimdWidth], vlevel[SimdWidth];
+    alignas(32) uint32_t levels[SimdWidth], nextLevels[SimdWidth];
+    SimdStore(vu, u);
+    SimdStore(vv, v);
+    SimdStore(vlevel, level);
+    for (uint32_t i = 0; i < SimdWidth; ++i)
+    {
+        levels[i] = (uint32_t)vlevel[i];
+        nextLevels[i] = std::min(levels[i] + 1, vt.TailLevel);
+    }
+
+    SampleLevels(vt, vu, vv, levels, out);
+    if (SimdMoveMask(SimdCmpGe(SimdZero(), blend)) != (1u << SimdWidth) - 1)
+    {
+        SimdFloat next[4];
+        SampleLevels(vt, vu, vv, nextLevels, next);
+        for (int c = 0; c < 4; ++c)
+        {
+            out[c] = SimdLerp(out[c], next[c], blend);
+        }
+    }
+}
+
+//==============================================================================
+void VirtualTextureGetStats(const VirtualTexture& vt, VirtualTextureStats* stats)
+{
+    *stats = vt.Stats;
+}
+
+//==============================================================================
+void VirtualTextureDirectionToUv(const float direction[3], float* u, float* v)
+{
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    float y = (length > 0.f) ? direction[1] / length : 0.f;
+    *u = 0.5f + atan2f(direction[0], direction[2]) / (2.f * Pi);
+    *v = acosf(std::min(std::max(y, -1.f), 1.f)) / Pi;
+}
@@ -0,0 +1,139 @@
+//==============================================================================
+// Virtual texturing for panoramas too big to keep resident, such as 360 degree
+// equirectangular backgrounds. The image stays in a memory mapped container
+// (see TextureFile.h), split into square tiles at every mip level, and only
+// the tiles the view needs live in a fixed physical atlas:
+//
+// - A feedback pass over a coarse grid of the view works out which tile each
+//   point samples, at the level its footprint needs. Resident ones are marked
+//   used and missing ones are queued to the streaming thread, coarse first.
+// - The streaming thread copies queued tiles out of the mapping, with a border
+//   from their neighbors so bilinear filtering never crosses a tile edge.
+// - VirtualTextureUpdate installs finished tiles into free atlas slots or the
+//   least recently used ones, and rebuilds the page table. Every page there
+//   points at its own tile or its nearest resident ancestor, so sampling never
+//   waits: a missing tile shows blurrier until it arrives.
+//
+// The levels from the first single-tile one down stay resident, and sampling
+// goes no coarser than it. Longitude wraps and latitude clamps. Directions map
+// to the image with +z in the middle, +x a quarter to the right and +y up.
+//==============================================================================
+#pragma once
+
+#include "CpuTexture.h"
+#include "MipChain.h"
+#include "TextureFile.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Texels along a tile's side, and the border each side of it in the atlas. The
+// border is a whole BC block.
+static const uint32_t VirtualTextureTileSize = 128;
+static const uint32_t VirtualTextureTileBorder = 4;
+static const uint32_t VirtualTextureSlotSize = VirtualTextureTileSize + 2 * VirtualTextureTileBorder;
+
+// Pixels between feedback samples along each axis of the view
+static const uint32_t VirtualTextureFeedbackStride = 8;
+
+// Tiles queued to or held by the streaming thread at once. Feedback asks
+// again next pass for any it couldn't queue.
+static const uint32_t VirtualTextureMaxPending = 64;
+
+//==============================================================================
+// Structures
+//==============================================================================
+struct VirtualTextureLevel
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t TilesX;
+    uint32_t TilesY;
+    uint32_t FirstPage;     // Index of tile (0, 0) among all pages
+};
+
+struct VirtualTextureStats
+{
+    uint64_t FeedbackPasses;
+    uint64_t PagesNeeded;       // Distinct pages per pass, summed over passes
+    uint64_t PagesMissed;       // Of those, not resident, so sampled coarser
+    uint64_t TilesStreamed;
+    uint64_t TilesEvicted;
+    uint32_t ResidentTiles;
+    uint32_t PendingTiles;
+    uint64_t ResidentBytes;     // Atlas, page tables and streaming buffers
+};
+
+// The streaming thread and its queues, private to VirtualTexture.cpp
+struct VirtualTextureStream;
+
+struct VirtualTexture
+{
+    TextureFile File;
+    CpuFormat Format;
+    uint32_t NumLevels;
+    uint32_t TailLevel;         // The first single-tile level
+    VirtualTextureLevel Levels[MipMaxLevels];
+
+    // Per page: what sampling reads, the slot and level of the page or its
+    // nearest resident ancestor (Slot | Level << 24); its own slot or NoSlot;
+    // the last feedback pass that needed it; whether it's streaming
+    uint32_t NumPages;
+    std::vector<uint32_t> PageTable;
+    std::vector<uint32_t> PageSlot;
+    std::vector<uint32_t> PagePass;
+    std::vector<uint8_t> PagePending;
+
+    // Slots of VirtualTextureSlotSize texels on a side, in the file's format,
+    // and the page each holds or NoPage. The LRU list runs from the most
+    // recently used slot at LruHead, and leaves out the tail levels' slots.
+    CpuTexture Atlas;
+    uint32_t SlotsX;
+    uint32_t NumSlots;
+    uint32_t NumPinnedSlots;
+    std::vector<uint32_t> SlotPage;
+    std::vector<uint32_t> LruPrev;
+    std::vector<uint32_t> LruNext;
+    uint32_t LruHead;
+    uint32_t LruTail;
+
+    // Slots written by the last VirtualTextureUpdate, for a GPU copy of the
+    // atlas to follow
+    std::vector<uint32_t> Installed;
+
+    uint32_t Pass;
+    VirtualTextureStats Stats;
+    VirtualTextureStream* Stream;
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+// Maps 'filename', a TextureFile with one slice, and sets up an atlas of
+// 'numSlots' slots. The tail levels are read in now, and the rest stream.
+bool VirtualTextureCreate(const char* filename, uint32_t numSlots, VirtualTexture* vt);
+void VirtualTextureDestroy(VirtualTexture* vt);
+
+// Feedback for a view 'width' x 'height' pixels, whose 'invViewProj' takes
+// NDC to world. Only the rotation matters, as the panorama is at infinity.
+void VirtualTextureFeedback(VirtualTexture* vt, const float invViewProj[16], uint32_t width, uint32_t height);
+
+// Installs up to 'maxTiles' streamed tiles and rebuilds the page table. Call
+// between feedback and sampling, from the thread that does both.
+uint32_t VirtualTextureUpdate(VirtualTexture* vt, uint32_t maxTiles);
+
+// Waits for the streaming thread to finish what's queued, and installs it all
+void VirtualTextureFlush(VirtualTexture* vt);
+
+// Trilinear sample at a level of detail, from the best resident tiles
+void VirtualTextureSample(const VirtualTexture& vt, SimdFloat u, SimdFloat v, SimdFloat lod, SimdFloat out[4]);
+
+void VirtualTextureGetStats(const VirtualTexture& vt, VirtualTextureStats* stats);
+
+// Panorama coordinates of a world direction
+void VirtualTextureDirectionToUv(const float direction[3], float* u, float* v);
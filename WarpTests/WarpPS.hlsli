@@ -0,0 +1,93 @@
+// Warp pixel shader shared by every warp permutation. See WarpVS.hlsli for
+// the permutation defines.
+#ifndef LENS_DISTORTION
+#define LENS_DISTORTION 0
+#endif
+
+#ifndef STEREO
+#define STEREO 0
+#endif
+
+#ifndef LAYERED
+#define LAYERED 0
+#endif
+
+Texture2D SourceImage;
+SamplerState Sampler;
+
+#if LENS_DISTORTION
+
+struct VertexIn
+{
+    float4 Position : SV_POSITION;
+    float2 TexCoordR : TEXCOORD0;
+    float2 TexCoordG : TEXCOORD1;
+    float2 TexCoordB : TEXCOORD2;
+#if STEREO
+    nointerpolation float Eye : EYE;
+#endif
+};
+
+float4 SampleEye(float2 texCoord, float eye)
+{
+#if STEREO
+    // The other eye is next to this one in the source, so border addressing
+    // has to be done here. Masked rather than branched on.
+    float inside = all(texCoord == saturate(texCoord));
+    return inside * SourceImage.Sample(Sampler, float2((texCoord.x + eye) * 0.5f, texCoord.y));
+#else
+    return SourceImage.Sample(Sampler, texCoord);
+#endif
+}
+
+float4 main(VertexIn input) : SV_TARGET
+{
+#if STEREO
+    float eye = input.Eye;
+#else
+    float eye = 0;
+#endif
+    float4 g = SampleEye(input.TexCoordG, eye);
+    float r = SampleEye(input.TexCoordR, eye).r;
+    float b = SampleEye(input.TexCoordB, eye).b;
+    return float4(r, g.g, b, g.a);
+}
+
+#else
+
+struct VertexIn
+{
+    float4 Position : SV_POSITION;
+    float2 TexCoord : TEXCOORD;
+#if LAYERED
+    float Depth : TEXCOORD1;
+#endif
+};
+
+#if LAYERED
+Texture2D<float> SourceLayerDepth;
+
+// Largest ratio between the source depth under a pixel and the depth
+// interpolated from its triangle's vertices, in 1 - z (about near / view
+// depth), before the triangle counts as stretched across a depth edge
+static const float StretchRatio = 1.05f;
+#endif
+
+float4 main(VertexIn input) : SV_TARGET
+{
+#if LAYERED
+    // Over a surface the interpolated depth follows the source depth. A
+    // triangle spanning a depth edge blends the two sides instead, and is left
+    // to the layer drawn below, as are texels the layer doesn't cover.
+    float depth = SourceLayerDepth.Sample(Sampler, input.TexCoord);
+    float a = 1 - depth;
+    float b = 1 - input.Depth;
+    if (depth >= 1 || max(a, b) > StretchRatio * min(a, b))
+    {
+        discard;
+    }
+#endif
+    return SourceImage.Sample(Sampler, input.TexCoord);
+}
+
+#endif
@@ -0,0 +1,200 @@
+// Warp grid vertex shader shared by every warp permutation. Permutations are
+// selected with the following defines:
+//   POSITIONAL_WARP - Reprojects each grid vertex using the source depth
+//   LENS_DISTORTION - Grid is laid out in display space with the lens
+//                     distortion and chromatic aberration baked into one
+//                     texcoord per color channel (see LensDistortion.h)
+//   STEREO          - Source holds both eyes side by side. The grid is drawn
+//                     with one instance per eye, each warped into its own half
+//                     of the target with its own matrix.
+//   LAYERED         - With POSITIONAL_WARP, also passes each vertex's source
+//                     depth on, for WarpPS.hlsli to find stretched triangles
+//   ENCODED_DEPTH   - With POSITIONAL_WARP, the source depth is linear or log
+//                     view depth in 16 bits (see DepthEncode.h) instead of
+//                     post-projection depth
+#ifndef POSITIONAL_WARP
+#define POSITIONAL_WARP 0
+#endif
+
+#ifndef LENS_DISTORTION
+#define LENS_DISTORTION 0
+#endif
+
+#ifndef STEREO
+#define STEREO 0
+#endif
+
+#ifndef LAYERED
+#define LAYERED 0
+#endif
+
+#ifndef ENCODED_DEPTH
+#define ENCODED_DEPTH 0
+#endif
+
+#if POSITIONAL_WARP
+Texture2D SourceDepth;
+#endif
+
+cbuffer Constants
+{
+#if STEREO
+    float4x4 EyeTWMatrix[2];
+#else
+    float4x4 TWMatrix;
+#endif
+#if POSITIONAL_WARP
+    float2 TextureSize;
+#endif
+#if ENCODED_DEPTH
+    float4 DepthDecode;     // DepthEncodeConstants
+    uint DepthEncoding;     // 0 linear, 1 log
+#endif
+};
+
+float4x4 EyeWarp(uint eye)
+{
+#if STEREO
+    // Select rather than index, so the constants are read with static offsets
+    return eye ? EyeTWMatrix[1] : EyeTWMatrix[0];
+#else
+    return TWMatrix;
+#endif
+}
+
+// Texcoord within an eye to texcoord within the source
+float2 EyeToSource(float2 texCoord, uint eye)
+{
+#if STEREO
+    return float2((texCoord.x + eye) * 0.5f, texCoord.y);
+#else
+    return texCoord;
+#endif
+}
+
+#if LENS_DISTORTION
+
+struct VertexIn
+{
+    float2 Position : POSITION;     // Display position, already distorted
+    float2 TexCoordR : TEXCOORD0;   // Undistorted texcoord of each channel
+    float2 TexCoordG : TEXCOORD1;
+    float2 TexCoordB : TEXCOORD2;
+#if STEREO
+    uint Eye : SV_InstanceID;
+#endif
+};
+
+struct VertexOut
+{
+    float4 Position : SV_POSITION;
+    float2 TexCoordR : TEXCOORD0;   // Within the eye
+    float2 TexCoordG : TEXCOORD1;
+    float2 TexCoordB : TEXCOORD2;
+#if STEREO
+    nointerpolation float Eye : EYE;
+#endif
+};
+
+// Finds the source texcoord that 'tw' moves onto 'texCoord', on the plane at
+// depth 'z'. On that plane the warp is a 2D homography, so this inverts it
+// with the adjugate; the determinant cancels in the projective divide.
+float2 Unwarp(float4x4 tw, float2 texCoord, float z)
+{
+    float3 p = float3(texCoord.x * 2 - 1, (1 - texCoord.y) * 2 - 1, 1);
+    float3 r0 = float3(tw._m00, tw._m10, tw._m30);
+    float3 r1 = float3(tw._m01, tw._m11, tw._m31);
+    float3 r2 = z * float3(tw._m02, tw._m12, tw._m32) + float3(tw._m03, tw._m13, tw._m33);
+    float3 s = float3(dot(p, cross(r1, r2)), dot(p, cross(r2, r0)), dot(p, cross(r0, r1)));
+    float2 ndc = s.xy / s.z;
+    return float2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+}
+
+VertexOut main(VertexIn input)
+{
+#if STEREO
+    uint eye = input.Eye;
+#else
+    uint eye = 0;
+#endif
+    float4x4 tw = EyeWarp(eye);
+
+#if POSITIONAL_WARP
+    // Depth at the unwarped green texcoord, shared by all three channels. Like
+    // the undistorted grid's single fetch per vertex, this assumes depth varies
+    // slowly across the distance the warp moves the vertex.
+    float z = SourceDepth.Load(int3(EyeToSource(input.TexCoordG, eye) * TextureSize, 0)).x;
+#else
+    float z = 0.5f;
+#endif
+
+    VertexOut output;
+    output.Position = float4(input.Position, 0.5f, 1);
+#if STEREO
+    output.Position.x = (output.Position.x + eye * 2.f - 1) * 0.5f;
+    output.Eye = eye;
+#endif
+    output.TexCoordR = Unwarp(tw, input.TexCoordR, z);
+    output.TexCoordG = Unwarp(tw, input.TexCoordG, z);
+    output.TexCoordB = Unwarp(tw, input.TexCoordB, z);
+    return output;
+}
+
+#else
+
+struct VertexOut
+{
+    float4 Position : SV_POSITION;
+    float2 TexCoord : TEXCOORD;
+#if LAYERED
+    float Depth : TEXCOORD1;
+#endif
+#if STEREO
+    float2 ClipDistance : SV_ClipDistance;
+#endif
+};
+
+VertexOut main(float2 TexCoord : TEXCOORD
+#if STEREO
+    , uint Eye : SV_InstanceID
+#endif
+    )
+{
+#if STEREO
+    uint eye = Eye;
+#else
+    uint eye = 0;
+#endif
+    float2 sourceTexCoord = EyeToSource(TexCoord, eye);
+
+    VertexOut output;
+    output.Position.x = TexCoord.x * 2 - 1;
+    output.Position.y = (1 - TexCoord.y) * 2 - 1;
+#if POSITIONAL_WARP && ENCODED_DEPTH
+    // Back to view depth. Scaling the clip position by it projects to the same
+    // point as post-projection depth at w = 1, without dividing to get there.
+    float encoded = (SourceDepth.Load(int3(sourceTexCoord * TextureSize, 0)).x - DepthDecode.w) / DepthDecode.z;
+    float viewDepth = DepthEncoding ? exp2(encoded) : encoded;
+    output.Position.xy *= viewDepth;
+    output.Position.z = viewDepth * DepthDecode.x + DepthDecode.y;
+    output.Position.w = viewDepth;
+#elif POSITIONAL_WARP
+    output.Position.z = SourceDepth.Load(int3(sourceTexCoord * TextureSize, 0)).x;
+    output.Position.w = 1;
+#if LAYERED
+    output.Depth = output.Position.z;
+#endif
+#else
+    output.Position.zw = float2(0.5f, 1);
+#endif
+    output.Position = mul(EyeWarp(eye), output.Position);
+#if STEREO
+    // Clip to the eye's own viewport before moving it into its half
+    output.ClipDistance = float2(output.Position.w + output.Position.x, output.Position.w - output.Position.x);
+    output.Position.x = output.Position.x * 0.5f + (eye - 0.5f) * output.Position.w;
+#endif
+    output.TexCoord = sourceTexCoord;
+    return output;
+}
+
+#endif
@@ -4,7 +4,38 @@
 #include <d3d11.h>
 #include <stdint.h>
 #include <assert.h>
-#include <wincodec.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <new>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include "Dxbc.h"
+#include "CpuRender.h"
+#include "ShaderCache.h"
+#include "LensDistortion.h"
+#include "AdaptiveWarpMesh.h"
+#include "DepthPyramid.h"
+#include "VertexDepth.h"
+#include "HoleFill.h"
+#include "TemporalHistory.h"
+#include "Parallel.h"
+#include "DepthFormat.h"
+#include "DepthEncode.h"
+#include "BackwardWarp.h"
+#include "ImageFile.h"
+#include "MipChain.h"
+#include "TextureLoader.h"
+#include "BlockCompress.h"
+#include "TextureFile.h"
+#include "VirtualTexture.h"
+#include "CubeMap.h"
+#include "Compositor.h"
+#include "FrameCapture.h"
+#include "FrameArena.h"
 
 #include "SceneVS.h"
 #include "ScenePS.h"
@@ -12,6 +43,26 @@
 #include "RotationalWarpPS.h"
 #include "PositionalWarpVS.h"
 #include "PositionalWarpPS.h"
+#include "RotationalDistortedWarpVS.h"
+#include "PositionalDistortedWarpVS.h"
+#include "DistortedWarpPS.h"
+#include "RotationalStereoWarpVS.h"
+#include "PositionalStereoWarpVS.h"
+#include "RotationalDistortedStereoWarpVS.h"
+#include "PositionalDistortedStereoWarpVS.h"
+#include "DistortedStereoWarpPS.h"
+#include "DepthPyramidFromDepthCS.h"
+#include "DepthPyramidFromLevelCS.h"
+#include "VertexDepthCS.h"
+#include "ScenePeelPS.h"
+#include "PositionalLayeredWarpVS.h"
+#include "LayeredWarpPS.h"
+#include "DepthEncodeCS.h"
+#include "PositionalEncodedWarpVS.h"
+#include "BackwardWarpCS.h"
+#include "BackgroundVS.h"
+#include "BackgroundPS.h"
+#include "CompositorPS.h"
 
 #include <DirectXMath.h>
 using namespace DirectX;
@@ -19,17 +70,113 @@ using namespace DirectX;
 #include <wrl.h>
 using namespace Microsoft::WRL;
 
-#define ROTATION_WARP
-
 //==============================================================================
 // Constants
 //==============================================================================
 static const uint32_t NumVertsWidth = 65;
 static const uint32_t NumVertsHeight = 65;
 
+// The fixed grid reads per-vertex depth through the same texcoord * TextureSize
+// Load as full resolution depth, which only lands exactly on each texel when
+// the texcoords i / (verts - 1) are exact
+static_assert(((NumVertsWidth - 1) & (NumVertsWidth - 2)) == 0 && ((NumVertsHeight - 1) & (NumVertsHeight - 2)) == 0,
+    "Grid cells per side must be a power of two");
+
+// Roughly DK1-like lens, R and B scaled apart by the chromatic aberration
+static const LensDistortion Lens = {
+    0.22f, 0.24f,
+    { { -0.006f, 0.f }, { 0.f, 0.f }, { 0.014f, 0.f } },
+    1280.f / 720.f,
+    1.f / (1.f + 0.22f + 0.24f),
+};
+
+// Same lens over one half of the display
+static const LensDistortion StereoLens = {
+    0.22f, 0.24f,
+    { { -0.006f, 0.f }, { 0.f, 0.f }, { 0.014f, 0.f } },
+    640.f / 720.f,
+    1.f / (1.f + 0.22f + 0.24f),
+};
+
+// Distance between the eyes, in scene units
+static const float EyeSeparation = 0.064f;
+
+// Adaptive positional warp grid. Post-projection depth is linear in 1 / view
+// depth, as is the parallax of a translation, so the threshold bounds the
+// parallax difference within a cell.
+static const uint32_t AdaptiveMeshMinLevel = 3;
+static const uint32_t AdaptiveMeshMaxLevel = 8;
+static const uint32_t FixedMeshLevel = 6;   // NumVertsWidth - 1 cells
+static const float AdaptiveMeshDepthThreshold = 0.001f;
+
+// Copies of the GPU depth pyramid in flight for the adaptive grid, read back
+// as the GPU finishes them instead of waiting
+static const uint32_t PyramidReadbackSlots = 3;
+
+// With temporal hole filling the app frame trails the target pose by this many
+// frames, like a renderer running behind the display. Otherwise every app
+// frame has the same pose and history adds nothing.
+static const uint32_t AppFrameLatency = 8;
+
+// Scene perspective. Reversed-Z swaps the planes in the projection, which the
+// warp matrices carry through unchanged.
+static const float SceneFovY = 60.f;        // Degrees
+static const float SceneNear = 0.1f;
+static const float SceneFar = 1000.f;
+
+// Sideways head move the depth precision report reprojects to, in scene units
+static const float PrecisionHeadOffset = 0.1f;
+
+// Hybrid warp tiles with less parallax than this, in pixels, take the
+// rotational sample without searching (see BackwardWarp.h)
+static const float HybridParallaxThreshold = 0.5f;
+
+// Image decode threads, the staging memory their images may hold at once, and
+// how they filter mip chains for the trilinear Sampler
+static const uint32_t ImageLoadWorkers = 2;
+static const uint64_t ImageLoadBudget = 64ull * 1024 * 1024;
+static const MipFilter ImageLoadMips = MipFilter::Kaiser;
+
+// What loaded images are block compressed to at runtime, or R8G8B8A8Unorm to
+// keep them as decoded. Block compressed DDS files load as they are whatever
+// this is (see TextureLoader.h).
+static const CpuFormat ImageLoadFormat = CpuFormat::R8G8B8A8Unorm;
+
+// Cube map drawn beneath the warp: six slices of this file when it's there,
+// or else a generated sky with faces this many texels across
+static const char* EnvironmentFilename = "Environment.wtex";
+static const uint32_t EnvironmentSize = 512;
+
+// Compositor layers over the warp: a UI panel quad, and a strip of cards on a
+// cylinder around the starting eye position
+static const uint32_t PanelWidth = 512;
+static const uint32_t PanelHeight = 256;
+static const uint32_t StripWidth = 1024;
+static const uint32_t StripHeight = 128;
+static const uint32_t StripCards = 8;
+
+// Frame capture: readback slots, frames between a copy and its map, and where
+// the files go
+static const uint32_t CaptureSlots = 4;
+static const uint32_t CaptureLatency = 2;
+static const char* CaptureDirectory = "Captures";
+
+// Transient CPU memory of a frame, sized for the CPU draw of the finest
+// adaptive mesh, and the frames it stays valid for
+static const size_t FrameArenaCapacity = 16 << 20;
+static const uint32_t FrameArenaFrames = 2;
+
 //==============================================================================
 // Structures
 //==============================================================================
+// Texture and view formats for each DepthFormat
+struct GpuDepthFormat
+{
+    DXGI_FORMAT Texture;
+    DXGI_FORMAT DepthStencil;
+    DXGI_FORMAT ShaderResource;
+};
+
 struct SceneVertex
 {
     XMFLOAT3 Position;
@@ -63,6 +210,129 @@ struct PositionWarpVSConstants
     XMFLOAT2 Padding;
 };
 
+// Stereo constants hold one warp per eye, indexed by SV_InstanceID
+struct StereoRotationWarpVSConstants
+{
+    XMFLOAT4X4 TWMatrix[2];
+};
+
+struct StereoPositionWarpVSConstants
+{
+    XMFLOAT4X4 TWMatrix[2];
+    XMFLOAT2 TextureSize;
+    XMFLOAT2 Padding;
+};
+
+// Positional constants for reading encoded depth
+struct EncodedPositionWarpVSConstants
+{
+    XMFLOAT4X4 TWMatrix;
+    XMFLOAT2 TextureSize;
+    XMFLOAT2 Padding;
+    DepthEncodeConstants DepthDecode;
+    uint32_t DepthEncoding;
+    uint32_t Padding2[3];
+};
+
+struct DepthPyramidConstants
+{
+    XMUINT2 SourceSize;
+    XMUINT2 TargetSize;
+};
+
+// GPU copy of a DepthPyramid, one mip per level
+struct GpuDepthPyramid
+{
+    ComPtr<ID3D11Texture2D> Texture;
+    ComPtr<ID3D11ShaderResourceView> SRV;  // All levels
+    std::vector<ComPtr<ID3D11ShaderResourceView>> LevelSRVs;
+    std::vector<ComPtr<ID3D11UnorderedAccessView>> LevelUAVs;
+    uint32_t Width;     // Of the depth buffer
+    uint32_t Height;
+};
+
+// Color and depth of one app frame layer, with views for drawing and warping
+struct GpuFrameLayer
+{
+    ComPtr<ID3D11Texture2D> Color;
+    ComPtr<ID3D11Texture2D> Depth;
+    ComPtr<ID3D11RenderTargetView> RTV;
+    ComPtr<ID3D11DepthStencilView> DSV;
+    ComPtr<ID3D11ShaderResourceView> SRV;
+    ComPtr<ID3D11ShaderResourceView> DepthSRV;
+};
+
+struct VertexDepthConstants
+{
+    XMUINT2 DepthSize;
+    XMUINT2 VertexCount;
+    uint32_t Mode;
+    uint32_t Padding[3];
+};
+
+struct DepthEncodeCSConstants
+{
+    XMUINT2 DepthSize;
+    uint32_t Encoding;
+    float Far;
+    DepthEncodeConstants Params;
+};
+
+struct BackwardWarpCSConstants
+{
+    XMFLOAT4X4 InverseWarp;
+    XMUINT2 Size;
+    uint32_t NumLevels;
+    uint32_t MaxIterations;
+    uint32_t StartLevel;
+    float Threshold;
+    uint32_t Padding[2];
+};
+
+struct BackgroundVertex
+{
+    XMFLOAT2 Position;
+};
+
+struct BackgroundPSConstants
+{
+    XMFLOAT4X4 InvViewProj;
+};
+
+struct CompositorLayerConstants
+{
+    XMFLOAT4X4 WorldToLayer;
+    XMFLOAT4 Bounds;        // Target pixels: left, top, right and bottom
+    uint32_t Type;
+    float Width;
+    float Height;
+    float Radius;
+    float CentralAngle;
+    float Padding[3];
+};
+
+struct CompositorPSConstants
+{
+    XMFLOAT4X4 InvViewProj;
+    uint32_t NumLayers;
+    uint32_t Padding[3];
+    CompositorLayerConstants Layers[CompositorMaxLayers];
+};
+
+enum class CaptureSource
+{
+    BackBuffer,
+    AppFrame,
+    AppFrameDepth,      // D16 and D32 only, as R16Unorm and R32Float
+};
+
+struct CaptureMode
+{
+    const char* Name;
+    CaptureSource Source;
+    CaptureFileFormat Format;
+};
+
 struct PipelineState
 {
     ComPtr<ID3D11Buffer> VertexBuffer;
@@ -75,6 +345,38 @@ struct PipelineState
     uint32_t Stride;
     uint32_t Offset;
     uint32_t NumIndices;
+    uint32_t NumInstances;  // Instanced draw when more than one
+};
+
+enum class ShaderIndex
+{
+    SceneVS,
+    ScenePS,
+    RotationalWarpVS,
+    RotationalWarpPS,
+    PositionalWarpVS,
+    PositionalWarpPS,
+    RotationalDistortedWarpVS,
+    PositionalDistortedWarpVS,
+    DistortedWarpPS,
+    RotationalStereoWarpVS,
+    PositionalStereoWarpVS,
+    RotationalDistortedStereoWarpVS,
+    PositionalDistortedStereoWarpVS,
+    DistortedStereoWarpPS,
+    DepthPyramidFromDepthCS,
+    DepthPyramidFromLevelCS,
+    VertexDepthCS,
+    ScenePeelPS,
+    PositionalLayeredWarpVS,
+    LayeredWarpPS,
+    DepthEncodeCS,
+    PositionalEncodedWarpVS,
+    BackwardWarpCS,
+    BackgroundVS,
+    BackgroundPS,
+    CompositorPS,
+    Count
 };
 
 enum class PipelineStateIndex
@@ -82,9 +384,148 @@ enum class PipelineStateIndex
     SceneRender,
     RotationalTimewarp,
     PositionalTimewarp,
+    RotationalDistortedTimewarp,
+    PositionalDistortedTimewarp,
+    RotationalStereoTimewarp,
+    PositionalStereoTimewarp,
+    RotationalDistortedStereoTimewarp,
+    PositionalDistortedStereoTimewarp,
+    PositionalAdaptiveTimewarp,
+    PositionalRefinedTimewarp,  // Uniform grid at the finest adaptive level
+    ScenePeelRender,            // Second app frame layer
+    PositionalLayeredTimewarp,  // Fixed grid, without stretched triangles
+    PositionalEncodedTimewarp,  // Fixed grid reading encoded depth
+    Background,                 // Cube map beneath the warp, GPU only
+    Compositor,                 // Layers over the warp, GPU only
     Count
 };
 
+// CPU copy of a pipeline, executed by the DXBC interpreter or as compiled
+// micro-op programs
+struct CpuPipeline
+{
+    DxbcShader VertexShader;
+    DxbcShader PixelShader;
+    const DxbcProgram* VertexProgram;   // Owned by the compile cache
+    const DxbcProgram* PixelProgram;
+    std::vector<uint8_t> Vertices;
+    std::vector<uint32_t> Indices;
+    CpuPipelineState State;
+};
+
+//==============================================================================
+// Shader permutations
+//==============================================================================
+static const D3D_SHADER_MACRO PositionalWarpDefines[] = {
+    { "POSITIONAL_WARP", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO DistortedWarpDefines[] = {
+    { "LENS_DISTORTION", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO PositionalDistortedWarpDefines[] = {
+    { "POSITIONAL_WARP", "1" },
+    { "LENS_DISTORTION", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO StereoWarpDefines[] = {
+    { "STEREO", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO PositionalStereoWarpDefines[] = {
+    { "POSITIONAL_WARP", "1" },
+    { "STEREO", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO DistortedStereoWarpDefines[] = {
+    { "LENS_DISTORTION", "1" },
+    { "STEREO", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO PositionalDistortedStereoWarpDefines[] = {
+    { "POSITIONAL_WARP", "1" },
+    { "LENS_DISTORTION", "1" },
+    { "STEREO", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO PositionalLayeredWarpDefines[] = {
+    { "POSITIONAL_WARP", "1" },
+    { "LAYERED", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO LayeredWarpDefines[] = {
+    { "LAYERED", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO PositionalEncodedWarpDefines[] = {
+    { "POSITIONAL_WARP", "1" },
+    { "ENCODED_DEPTH", "1" },
+    { nullptr, nullptr },
+};
+
+static const D3D_SHADER_MACRO DepthPyramidFromDepthDefines[] = {
+    { "FROM_DEPTH", "1" },
+    { nullptr, nullptr },
+};
+
+// Indexed by ShaderIndex. The embedded bytecode is the same permutation built
+// by FxCompile, through the wrapper .hlsl files.
+static const ShaderPermutation ShaderPermutations[] = {
+    { "SceneVS", "SceneVS.hlsl", "vs_5_0", nullptr, SceneVS, sizeof(SceneVS) },
+    { "ScenePS", "ScenePS.hlsl", "ps_5_0", nullptr, ScenePS, sizeof(ScenePS) },
+    { "RotationalWarpVS", "WarpVS.hlsli", "vs_5_0", nullptr, RotationalWarpVS, sizeof(RotationalWarpVS) },
+    { "RotationalWarpPS", "WarpPS.hlsli", "ps_5_0", nullptr, RotationalWarpPS, sizeof(RotationalWarpPS) },
+    { "PositionalWarpVS", "WarpVS.hlsli", "vs_5_0", PositionalWarpDefines, PositionalWarpVS, sizeof(PositionalWarpVS) },
+    { "PositionalWarpPS", "WarpPS.hlsli", "ps_5_0", nullptr, PositionalWarpPS, sizeof(PositionalWarpPS) },
+    { "RotationalDistortedWarpVS", "WarpVS.hlsli", "vs_5_0", DistortedWarpDefines, RotationalDistortedWarpVS, sizeof(RotationalDistortedWarpVS) },
+    { "PositionalDistortedWarpVS", "WarpVS.hlsli", "vs_5_0", PositionalDistortedWarpDefines, PositionalDistortedWarpVS, sizeof(PositionalDistortedWarpVS) },
+    { "DistortedWarpPS", "WarpPS.hlsli", "ps_5_0", DistortedWarpDefines, DistortedWarpPS, sizeof(DistortedWarpPS) },
+    { "RotationalStereoWarpVS", "WarpVS.hlsli", "vs_5_0", StereoWarpDefines, RotationalStereoWarpVS, sizeof(RotationalStereoWarpVS) },
+    { "PositionalStereoWarpVS", "WarpVS.hlsli", "vs_5_0", PositionalStereoWarpDefines, PositionalStereoWarpVS, sizeof(PositionalStereoWarpVS) },
+    { "RotationalDistortedStereoWarpVS", "WarpVS.hlsli", "vs_5_0", DistortedStereoWarpDefines, RotationalDistortedStereoWarpVS, sizeof(RotationalDistortedStereoWarpVS) },
+    { "PositionalDistortedStereoWarpVS", "WarpVS.hlsli", "vs_5_0", PositionalDistortedStereoWarpDefines, PositionalDistortedStereoWarpVS, sizeof(PositionalDistortedStereoWarpVS) },
+    { "DistortedStereoWarpPS", "WarpPS.hlsli", "ps_5_0", DistortedStereoWarpDefines, DistortedStereoWarpPS, sizeof(DistortedStereoWarpPS) },
+    { "DepthPyramidFromDepthCS", "DepthPyramidCS.hlsli", "cs_5_0", DepthPyramidFromDepthDefines, DepthPyramidFromDepthCS, sizeof(DepthPyramidFromDepthCS) },
+    { "DepthPyramidFromLevelCS", "DepthPyramidCS.hlsli", "cs_5_0", nullptr, DepthPyramidFromLevelCS, sizeof(DepthPyramidFromLevelCS) },
+    { "VertexDepthCS", "VertexDepthCS.hlsl", "cs_5_0", nullptr, VertexDepthCS, sizeof(VertexDepthCS) },
+    { "ScenePeelPS", "ScenePeelPS.hlsl", "ps_5_0", nullptr, ScenePeelPS, sizeof(ScenePeelPS) },
+    { "PositionalLayeredWarpVS", "WarpVS.hlsli", "vs_5_0", PositionalLayeredWarpDefines, PositionalLayeredWarpVS, sizeof(PositionalLayeredWarpVS) },
+    { "LayeredWarpPS", "WarpPS.hlsli", "ps_5_0", LayeredWarpDefines, LayeredWarpPS, sizeof(LayeredWarpPS) },
+    { "DepthEncodeCS", "DepthEncodeCS.hlsl", "cs_5_0", nullptr, DepthEncodeCS, sizeof(DepthEncodeCS) },
+    { "PositionalEncodedWarpVS", "WarpVS.hlsli", "vs_5_0", PositionalEncodedWarpDefines, PositionalEncodedWarpVS, sizeof(PositionalEncodedWarpVS) },
+    { "BackwardWarpCS", "BackwardWarpCS.hlsl", "cs_5_0", nullptr, BackwardWarpCS, sizeof(BackwardWarpCS) },
+    { "BackgroundVS", "BackgroundVS.hlsl", "vs_5_0", nullptr, BackgroundVS, sizeof(BackgroundVS) },
+    { "BackgroundPS", "BackgroundPS.hlsl", "ps_5_0", nullptr, BackgroundPS, sizeof(BackgroundPS) },
+    { "CompositorPS", "CompositorPS.hlsl", "ps_5_0", nullptr, CompositorPS, sizeof(CompositorPS) },
+};
+static_assert(_countof(ShaderPermutations) == (uint32_t)ShaderIndex::Count, "Missing shader permutation");
+
+// Indexed by DepthFormat. The typeless texture is also the staging format.
+static const GpuDepthFormat GpuDepthFormats[] = {
+    { DXGI_FORMAT_R16_TYPELESS, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM },
+    { DXGI_FORMAT_R24G8_TYPELESS, DXGI_FORMAT_D24_UNORM_S8_UINT, DXGI_FORMAT_R24_UNORM_X8_TYPELESS },
+    { DXGI_FORMAT_R32_TYPELESS, DXGI_FORMAT_D32_FLOAT, DXGI_FORMAT_R32_FLOAT },
+};
+static_assert(_countof(GpuDepthFormats) == (uint32_t)DepthFormat::Count, "Missing depth format");
+
+// What frame capture writes, cycled with 'Y'
+static const CaptureMode CaptureModes[] = {
+    { "BackBuffer", CaptureSource::BackBuffer, CaptureFileFormat::Png },
+    { "AppFrame", CaptureSource::AppFrame, CaptureFileFormat::Png },
+    { "AppFrameDepth", CaptureSource::AppFrameDepth, CaptureFileFormat::Exr },
+    { "BackBuffer", CaptureSource::BackBuffer, CaptureFileFormat::Raw },
+};
+
 //==============================================================================
 // Global variables
 //==============================================================================
@@ -96,13 +537,118 @@ static ComPtr<ID3D11RenderTargetView> AppFrameRTV;
 static ComPtr<ID3D11DepthStencilView> AppFrameDSV;
 static ComPtr<ID3D11ShaderResourceView> AppFrameSRV;
 static ComPtr<ID3D11ShaderResourceView> AppFrameDepthSRV;
+static ComPtr<ID3D11Texture2D> AppFrameDepth;
+static ComPtr<ID3D11Texture2D> AppFrameDepthStaging;
+static ComPtr<ID3D11DepthStencilState> ReversedDepthState;
+static GpuFrameLayer AppFrameBackLayer;
+static GpuDepthPyramid AppFramePyramid;
+static ComPtr<ID3D11Texture2D> AppFramePyramidStaging[PyramidReadbackSlots];
+static uint64_t AppFramePyramidCopies = 0;     // Into the staging, since created
+static uint64_t AppFramePyramidReads = 0;      // Of those copies read back or dropped
+static ComPtr<ID3D11ComputeShader> DepthPyramidFromDepthShader;
+static ComPtr<ID3D11ComputeShader> DepthPyramidFromLevelShader;
+static ComPtr<ID3D11Buffer> DepthPyramidConstantBuffer;
+static ComPtr<ID3D11Texture2D> VertexDepthTexture;
+static ComPtr<ID3D11ShaderResourceView> VertexDepthSRV;
+static ComPtr<ID3D11UnorderedAccessView> VertexDepthUAV;
+static ComPtr<ID3D11ComputeShader> VertexDepthShader;
+static ComPtr<ID3D11Buffer> VertexDepthConstantBuffer;
+static ComPtr<ID3D11Texture2D> EncodedDepthTexture;
+static ComPtr<ID3D11ShaderResourceView> EncodedDepthSRV;
+static ComPtr<ID3D11UnorderedAccessView> EncodedDepthUAV;
+static ComPtr<ID3D11ComputeShader> DepthEncodeShader;
+static ComPtr<ID3D11Buffer> DepthEncodeConstantBuffer;
+static ComPtr<ID3D11Texture2D> BackwardWarpTexture;
+static ComPtr<ID3D11UnorderedAccessView> BackwardWarpUAV;
+static ComPtr<ID3D11ComputeShader> BackwardWarpShader;
+static ComPtr<ID3D11Buffer> BackwardWarpConstantBuffer;
+static ComPtr<ID3D11ShaderResourceView> EnvironmentSRV;
+static ComPtr<ID3D11SamplerState> TrilinearSampler;
+static ComPtr<ID3D11BlendState> BackgroundBlendState;
+static ComPtr<ID3D11ShaderResourceView> LayerSRVs[CompositorMaxLayers];
+static ComPtr<ID3D11BlendState> CompositorBlendState;
+static ComPtr<ID3D11Texture2D> CaptureStaging[CaptureSlots];
+static CpuFormat CaptureFormats[CaptureSlots];
 static ComPtr<ID3D11SamplerState> Sampler;
+static std::vector<uint8_t> Shaders[(uint32_t)ShaderIndex::Count];
 static PipelineState Pipelines[(uint32_t)PipelineStateIndex::Count];
+static ComPtr<ID3D11Texture2D> BackBuffer;
+static CpuPipeline CpuPipelines[(uint32_t)PipelineStateIndex::Count];
+static CpuTexture CpuAppFrame;
+static CpuTexture CpuAppFrameDepth;
+static CpuTexture CpuAppFrameBackLayer;
+static CpuTexture CpuAppFrameBackLayerDepth;
+static DepthPyramid CpuAppFramePyramid;
+static VertexDepth CpuVertexDepth;
+static double CpuVertexDepthMs = 0;
+static CpuTexture CpuEncodedDepth;
+static double CpuDepthEncodeMs = 0;
+static BackwardWarpStats CpuBackwardStats;
+static double CpuBackwardWarpMs = 0;
+static BackwardWarpTiles CpuBackwardTiles;
+static double CpuClassifyMs = 0;
+static CpuTexture CpuBackBuffer;
+static CpuTexture CpuReference;
+static CpuTextureDiff CpuReferenceDiff;
+static CpuTexture CpuFixedWarp;
+static CpuTextureDiff CpuAdaptiveDiff;
+static CpuTextureDiff CpuFixedDiff;
+static CpuTexture CpuGroundTruth;
+static CpuTexture CpuGroundTruthDepth;
+static HoleFill CpuHoleFill;
+static CpuTextureDiff CpuHoleDiffBefore;
+static CpuTextureDiff CpuHoleDiffAfter;
+static CpuTextureDiff CpuFrameDiffBefore;
+static CpuTextureDiff CpuFrameDiffAfter;
+static double CpuHoleFillMs = 0;
+static TemporalHistory CpuHistory;
+static XMMATRIX LaggedViews[AppFrameLatency];
+static uint32_t NumLaggedViews = 0;
+static AdaptiveWarpMesh AdaptiveMesh;
+static uint32_t AdaptiveMeshBudget = 1u << (2 * FixedMeshLevel);
+static CpuSampler CpuLinearSampler;
+static CpuCubeMap CpuEnvironment;
+static CpuMipChain CpuLayerTextures[2];
+static CompositorLayer CompositorLayers[CompositorMaxLayers];
+static uint32_t NumCompositorLayers = 0;
+static CompositorStats CpuCompositorStats;
+static double CpuCompositorMs = 0;
+static CpuRenderProfile CpuProfile;
 static float RotationX = 0.f;
 static float RotationY = 0.f;
 static float PositionX = 0.f;
 static float PositionY = 0.f;
 static bool DrawNative = false;
+static bool DrawRotational = true;      // Or the positional warp and all that goes with it
+static bool DrawCpu = false;
+static bool DrawDistorted = false;
+static bool DrawStereo = false;
+static bool DrawAdaptive = false;
+static bool DrawVertexDepth = false;
+static VertexDepthMode VertexDepthSelection = VertexDepthMode::Nearest;
+static bool DrawHoleFill = false;
+static bool DrawLayered = false;
+static uint32_t TemporalFrames = 0;     // History frames for hole filling, 0 for none
+static DepthFormat AppFrameDepthFormat = DepthFormat::D32Float;
+static bool ReversedZ = false;
+static bool DrawEncodedDepth = false;
+static DepthEncoding DepthEncodingSelection = DepthEncoding::Linear;
+static bool DrawBackward = false;
+static bool DrawHybrid = false;         // Backward warp searching only tiles with parallax
+static bool DrawBackground = false;
+static bool DrawCompositorLayers = false;
+static FrameCapture Capture;
+static bool Capturing = false;
+static uint32_t CaptureModeIndex = 0;
+static uint32_t CaptureFrameIndex = 0;     // Numbers the files
+static double CaptureMs = 0;                // This thread's time, last frame
+static FrameArena CpuFrameArena;            // Bound as the render thread's ThreadArena
+static uint64_t FrameIndex = 0;
+static uint64_t HeapAllocations = 0;        // By operator new, on the render thread
+static thread_local bool CountHeapAllocations = false;
+static uint32_t FrameHeapAllocations = 0;   // During the last frame
+static TextureLoader ImageLoader;
+static bool CpuCompiled = true;
 
 //==============================================================================
 // Functions
@@ -113,46 +659,281 @@ static LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 static bool GraphicsInit(HWND hwnd);
 static void GraphicsDestroy();
 
+static bool GraphicsLoadShaders();
+static bool GraphicsCreatePipelines();
 static bool GraphicsCreateScene();
 static bool GraphicsCreateRotationalTimewarp();
 static bool GraphicsCreatePositionalTimewarp();
-
-static bool GraphicsLoadImage(const wchar_t* filename, ID3D11ShaderResourceView** srv);
+static bool GraphicsCreateStereoTimewarp(PipelineStateIndex index, ShaderIndex vs, ShaderIndex ps, uint32_t constantsSize);
+static bool GraphicsCreateDistortedTimewarp(PipelineStateIndex index, ShaderIndex vs, ShaderIndex ps, uint32_t constantsSize,
+    const LensDistortion& lens, uint32_t numInstances);
+static bool GraphicsCreateGridTimewarp(PipelineStateIndex index, ShaderIndex vs, ShaderIndex ps, uint32_t constantsSize);
+static bool GraphicsCreateAdaptiveTimewarp(PipelineStateIndex index, const AdaptiveWarpMesh& mesh);
+static bool GraphicsUpdateAdaptiveTimewarp(PipelineStateIndex index, const AdaptiveWarpMesh& mesh);
+
+static bool GraphicsCreateDepthPyramidShaders();
+static bool GraphicsCreateDepthPyramid(uint32_t width, uint32_t height, GpuDepthPyramid* pyramid);
+static void GraphicsBuildDepthPyramid(ID3D11ShaderResourceView* depth, const GpuDepthPyramid& pyramid);
+static bool GraphicsReadBackDepthPyramid(DepthPyramid* pyramid);
+static bool GraphicsBenchmarkDepthPyramid(const char* filename);
+
+static bool GraphicsCreateVertexDepth();
+static void GraphicsBuildVertexDepth(VertexDepthMode mode);
+static bool GraphicsBenchmarkVertexDepth(const char* filename);
+
+static bool GraphicsCreateDepthEncode();
+static void GraphicsEncodeDepth(const DepthEncodeDesc& desc);
+static bool GraphicsBenchmarkDepthEncode(const char* filename);
+
+static bool GraphicsCreateBackwardWarp();
+static void GraphicsBackwardWarp(const XMFLOAT4X4& inverseWarp, float threshold);
+static bool GraphicsBenchmarkBackwardWarp(const char* filename);
+static bool GraphicsBenchmarkHybridWarp(const char* filename);
+
+static bool GraphicsCreateFrameDepth(uint32_t width, uint32_t height, DepthFormat format);
+static bool GraphicsReadBackDepth(CpuTexture* depth);
+static bool ReportDepthPrecision(const char* filename);
+
+static bool GraphicsCreateFrameLayer(const D3D11_TEXTURE2D_DESC& colorDesc, GpuFrameLayer* layer);
+static bool GraphicsBenchmarkLayers(const char* filename);
+
+static bool GraphicsBeginImageUpload(void* context, uint32_t width, uint32_t height, uint32_t numLevels,
+    CpuFormat format, TextureLoadTarget* target);
+static void* GraphicsEndImageUpload(void* context, const TextureLoadTarget& target, bool decoded);
+static bool GraphicsLoadImage(const char* filename, ID3D11ShaderResourceView** srv);
+static bool GraphicsCreateTextureFromFile(const TextureFile& file, ID3D11ShaderResourceView** srv);
+static bool GraphicsCreateTextureFromLevels(const CpuTexture* levels, uint32_t numLevels,
+    ID3D11ShaderResourceView** srv);
+static bool GraphicsLoadTextureFile(const char* filename, ID3D11ShaderResourceView** srv);
+static bool GraphicsBenchmarkTextureFile(const char* filename);
+
+static bool GraphicsCreateBackground();
+static void GraphicsDrawBackground(const XMFLOAT4X4& invViewProj);
+static bool GraphicsBenchmarkCubeMap(const char* filename);
+
+static bool GraphicsCreateCompositor();
+static void GraphicsDrawCompositor(const XMFLOAT4X4& viewProj, const XMFLOAT4X4& invViewProj,
+    const D3D11_VIEWPORT& viewport, bool cullBounds);
+static bool GraphicsBenchmarkCompositor(const char* filename);
+
+static bool GraphicsCaptureCopy(void* context, uint32_t slot, void* source);
+static bool GraphicsCaptureMap(void* context, uint32_t slot, bool wait, CpuTexture* image);
+static void GraphicsCaptureUnmap(void* context, uint32_t slot);
+static bool GraphicsCaptureFrame(FrameCapture* capture, const CaptureMode& mode, const char* prefix, uint32_t index);
+static bool GraphicsBenchmarkCapture(const char* filename);
 
 static void GraphicsDoFrame();
 
 static void GraphicsDrawPipeline(const PipelineState& pipeline);
+static void GraphicsDrawBackLayer();
+static void GraphicsDrawLayers(const PositionWarpVSConstants& constants);
+
+static bool CpuInit(uint32_t width, uint32_t height);
+static void CpuDestroy();
+static bool CpuCreatePipeline(PipelineStateIndex index, const void* vs, size_t vsSize, const void* ps, size_t psSize,
+    const void* vertices, uint32_t verticesSize, uint32_t stride, const uint32_t* indices, uint32_t numIndices,
+    const CpuInputElement* elems, uint32_t numElems);
+static void CpuDrawPipeline(PipelineStateIndex index, const void* vsConstants, const CpuTexture* vsResource,
+    const CpuTexture* psResource, CpuTexture* renderTarget, CpuTexture* depth, const CpuViewport* viewport = nullptr);
+static void CpuDrawBackLayer(const SceneVSConstants& constants, const CpuViewport* viewport);
+static void CpuDrawLayers(const PositionWarpVSConstants& constants, CpuTexture* renderTarget);
+static bool CpuBenchmarkMipChain(const char* filename);
+static bool CpuBenchmarkBlockCompress(const char* filename);
+static bool CpuBenchmarkVirtualTexture(const char* filename);
+static bool CpuBenchmarkFrameArena(const char* filename);
+static bool GraphicsCheckFrameAllocations(const char* filename);
+static bool CpuGenerateEnvironment(uint32_t size, CpuCubeMap* cube);
+static bool CpuGenerateCards(uint32_t width, uint32_t height, uint32_t numCards, CpuMipChain* chain);
+static bool CpuCreateCompositorLayers();
+static uint32_t CpuGatherCompositorLayers(bool background, bool layers, CompositorLayer* out);
+
+static inline const std::vector<uint8_t>& GetShader(ShaderIndex index)
+{
+    return Shaders[(uint32_t)index];
+}
 
 static inline PipelineState& GetPipeline(PipelineStateIndex index)
 {
     return Pipelines[(uint32_t)index];
 }
 
-//==============================================================================
-int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int)
+static inline XMMATRIX SceneProjection(float aspect)
 {
-    // Needed for WIC (to load images)
-    HRESULT hr = CoInitialize(nullptr);
-    if (FAILED(hr))
+    return ReversedZ ?
+        XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), aspect, SceneFar, SceneNear) :
+        XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), aspect, SceneNear, SceneFar);
+}
+
+// Depth buffers clear to this
+static inline float SceneFarDepth()
+{
+    return ReversedZ ? 0.f : 1.f;
+}
+
+// Nearest and farthest are min and max depth, which reversed-Z swaps
+static inline VertexDepthMode SceneVertexDepthMode(VertexDepthMode mode)
+{
+    if (ReversedZ && mode != VertexDepthMode::Coverage)
+    {
+        return (mode == VertexDepthMode::Nearest) ? VertexDepthMode::Farthest : VertexDepthMode::Nearest;
+    }
+    return mode;
+}
+
+static inline CpuPipeline& GetCpuPipeline(PipelineStateIndex index)
+{
+    return CpuPipelines[(uint32_t)index];
+}
+
+// Counts the render thread's allocations, so frames can check they made none.
+// Other threads', such as the image loader's workers, aren't counted, and
+// neither are the CRT's own mallocs or the D3D runtime's.
+void* operator new(size_t size)
+{
+    if (CountHeapAllocations)
+    {
+        ++HeapAllocations;
+    }
+    void* memory = malloc(size ? size : 1);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+// Appends to the text in 'text', cut short rather than failing if it doesn't fit
+template <size_t Size>
+static void AppendText(wchar_t (&text)[Size], const wchar_t* format, ...)
+{
+    size_t length = wcslen(text);
+    va_list args;
+    va_start(args, format);
+    _vsnwprintf_s(text + length, Size - length, _TRUNCATE, format, args);
+    va_end(args);
+}
+
+// Average milliseconds per call of 'work' on the CPU
+template <typename Work>
+static double CpuTimeMs(uint32_t iterations, Work work)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        work();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// Average milliseconds per call of 'work' on the GPU, after one call to warm
+// up. Negative if the timestamps were disjoint.
+template <typename Work>
+static double GraphicsTimeGpuMs(uint32_t iterations, Work work)
+{
+    D3D11_QUERY_DESC qd{};
+    ComPtr<ID3D11Query> disjoint, begin, finish;
+    qd.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+    HRESULT hr = Device->CreateQuery(&qd, &disjoint);
+    qd.Query = D3D11_QUERY_TIMESTAMP;
+    if (FAILED(hr) || FAILED(Device->CreateQuery(&qd, &begin)) || FAILED(Device->CreateQuery(&qd, &finish)))
     {
         assert(false);
         return -1;
     }
 
+    work();
+    Context->Begin(disjoint.Get());
+    Context->End(begin.Get());
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        work();
+    }
+    Context->End(finish.Get());
+    Context->End(disjoint.Get());
+
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT frequency{};
+    UINT64 beginTicks = 0;
+    UINT64 finishTicks = 0;
+    while (Context->GetData(disjoint.Get(), &frequency, sizeof(frequency), 0) == S_FALSE)
+    {
+        Sleep(0);
+    }
+    while (Context->GetData(begin.Get(), &beginTicks, sizeof(beginTicks), 0) == S_FALSE ||
+        Context->GetData(finish.Get(), &finishTicks, sizeof(finishTicks), 0) == S_FALSE)
+    {
+        Sleep(0);
+    }
+
+    if (frequency.Disjoint)
+    {
+        return -1;
+    }
+    return (finishTicks - beginTicks) * 1000.0 / frequency.Frequency / iterations;
+}
+
+// Benchmark report column, "-" for timings that weren't taken
+static inline void FormatMs(double ms, char (&text)[16])
+{
+    if (ms < 0)
+    {
+        strcpy_s(text, "-");
+    }
+    else
+    {
+        sprintf_s(text, "%.3f", ms);
+    }
+}
+
+// Writes 'report' to the debugger output and 'filename'
+static bool WriteReport(const std::string& report, const char* filename)
+{
+    OutputDebugStringA(report.c_str());
+
+    FILE* file = nullptr;
+    if (fopen_s(&file, filename, "wb") != 0 || !file)
+    {
+        assert(false);
+        return false;
+    }
+    fwrite(report.data(), 1, report.size(), file);
+    fclose(file);
+
+    return true;
+}
+
+//==============================================================================
+int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR commandLine, int)
+{
+    CountHeapAllocations = true;
+
     HWND window = WindowInit(instance, L"WarpTests", 1280, 720);
     if (!window)
     {
-        CoUninitialize();
         return -2;
     }
 
     if (!GraphicsInit(window))
     {
         DestroyWindow(window);
-        CoUninitialize();
         return -3;
     }
 
+    // Runs frames without showing the window and exits, failing if they
+    // allocate
+    if (strstr(commandLine, "-checkallocations"))
+    {
+        bool passed = GraphicsCheckFrameAllocations("FrameAllocations.txt");
+        GraphicsDestroy();
+        DestroyWindow(window);
+        return passed ? 0 : -4;
+    }
+
     ShowWindow(window, SW_SHOW);
     UpdateWindow(window);
 
@@ -166,15 +947,171 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE, LPSTR, int)
         }
         else
         {
+            uint64_t allocations = HeapAllocations;
             GraphicsDoFrame();
-            SetWindowText(window, DrawNative ? L"No Warp" : L"Warped");
+            FrameHeapAllocations = (uint32_t)(HeapAllocations - allocations);
+
+            wchar_t title[1280];
+            wchar_t mode[1024];
+            swprintf_s(mode, L"%s%s%s%s", DrawNative ? L"No Warp" : L"Warped",
+                DrawRotational ? L" + Rotational" : L" + Positional", DrawDistorted ? L" + Distorted" : L"",
+                DrawStereo ? L" + Stereo" : L"");
+
+            // What follows goes with the positional warp. The backward warp
+            // replaces the grid and what goes with it.
+            bool positional = !DrawRotational;
+            bool backward = positional && DrawBackward && !DrawDistorted && !DrawStereo && !ReversedZ;
+            if (backward)
+            {
+                AppendText(mode, DrawHybrid ? L" + Hybrid" : L" + Backward");
+                if (DrawCpu)
+                {
+                    uint64_t pixels = (uint64_t)CpuBackBuffer.Width * CpuBackBuffer.Height;
+                    AppendText(mode, L" [%.2f ms, %.1f steps per pixel, %u missed]",
+                        CpuBackwardWarpMs, (double)CpuBackwardStats.Iterations / pixels, CpuBackwardStats.Misses);
+                    if (DrawHybrid)
+                    {
+                        AppendText(mode, L" [%u of %u tiles searched, %.2f ms classify]",
+                            CpuBackwardTiles.NumPositional, CpuBackwardTiles.TilesX * CpuBackwardTiles.TilesY, CpuClassifyMs);
+                    }
+                }
+            }
+            if (positional && DrawAdaptive && !DrawDistorted && !DrawStereo && !backward)
+            {
+                // Compared with the fixed grid, and in CPU mode the error of
+                // both against the fully refined grid
+                AppendText(mode, L" + Adaptive [budget %u: %u cells, %u verts, %u tris; fixed %u verts, %u tris]",
+                    AdaptiveMeshBudget, AdaptiveMesh.NumCells, (uint32_t)AdaptiveMesh.Vertices.size(),
+                    (uint32_t)AdaptiveMesh.Indices.size() / 3, NumVertsWidth * NumVertsHeight,
+                    (NumVertsWidth - 1) * (NumVertsHeight - 1) * 2);
+                if (DrawCpu)
+                {
+                    AppendText(mode, L" PSNR adaptive %.1f dB, fixed %.1f dB",
+                        CpuAdaptiveDiff.Psnr, CpuFixedDiff.Psnr);
+                }
+            }
+            if (positional && DrawVertexDepth && !DrawAdaptive && !DrawDistorted && !DrawStereo && !backward)
+            {
+                AppendText(mode, L" + %S vertex depth", VertexDepthModeName(VertexDepthSelection));
+                if (DrawCpu)
+                {
+                    AppendText(mode, L" (%.2f ms)", CpuVertexDepthMs);
+                }
+            }
+            if (positional && DrawEncodedDepth && !DrawVertexDepth && !DrawAdaptive && !DrawDistorted && !DrawStereo &&
+                !backward)
+            {
+                AppendText(mode, L" + %S encoded depth", DepthEncodingName(DepthEncodingSelection));
+                if (DrawCpu)
+                {
+                    AppendText(mode, L" (%.2f ms)", CpuDepthEncodeMs);
+                }
+            }
+            if (ReversedZ || AppFrameDepthFormat != DepthFormat::D32Float)
+            {
+                AppendText(mode, L" + %S%s depth",
+                    DepthFormatName(AppFrameDepthFormat), ReversedZ ? L" reversed-Z" : L"");
+            }
+            if (positional && DrawLayered && !DrawAdaptive && !DrawDistorted && !DrawStereo && !ReversedZ && AppFrameDepthFormat == DepthFormat::D32Float &&
+                !backward)
+            {
+                AppendText(mode, L" + Two layers");
+            }
+            if (positional && DrawHoleFill && DrawCpu && !DrawDistorted && !DrawStereo && !ReversedZ && !backward)
+            {
+                // Error against the natively drawn frame, in the holes and
+                // over the whole frame, before and after filling
+                AppendText(mode,
+                    L" + Hole fill [%u holes, %u threads, %.2f ms; PSNR holes %.1f -> %.1f dB, frame %.1f -> %.1f dB]",
+                    CpuHoleFill.NumHoles, ParallelThreadCount(), CpuHoleFillMs,
+                    CpuHoleDiffBefore.Psnr, CpuHoleDiffAfter.Psnr, CpuFrameDiffBefore.Psnr, CpuFrameDiffAfter.Psnr);
+                if (TemporalFrames > 0)
+                {
+                    // Share of the holes filled from history, and their mean age
+                    double meanAge = 0;
+                    double holes = CpuHistory.NumHoles ? (double)CpuHistory.NumHoles : 1.0;
+                    double reused = CpuHistory.NumReused ? (double)CpuHistory.NumReused : 1.0;
+                    for (uint32_t age = 1; age <= TemporalHistoryMaxFrames; ++age)
+                    {
+                        meanAge += (double)age * CpuHistory.NumReusedByAge[age];
+                    }
+                    AppendText(mode, L" + History [%u frames, %.1f MB; reused %.1f%% of holes, mean age %.1f]",
+                        TemporalFrames, TemporalHistoryMemory(CpuHistory) / (1024.0 * 1024.0),
+                        100.0 * CpuHistory.NumReused / holes, meanAge / reused);
+                }
+            }
+            if (DrawBackground && !DrawDistorted)
+            {
+                AppendText(mode, L" + Background");
+            }
+            if (DrawCompositorLayers && !DrawDistorted)
+            {
+                AppendText(mode, L" + Layers");
+            }
+            if ((DrawBackground || DrawCompositorLayers) && !DrawDistorted && DrawCpu)
+            {
+                // One compositor pass draws both on the CPU
+                double tests = CpuCompositorStats.Tests ? (double)CpuCompositorStats.Tests : 1.0;
+                AppendText(mode, L" (%.2f ms, traced %.0f%% of tests)",
+                    CpuCompositorMs, 100.0 * CpuCompositorStats.Traced / tests);
+            }
+            TextureLoadStats loads;
+            TextureLoaderGetStats(ImageLoader, &loads);
+            if (loads.Pending > 0)
+            {
+                AppendText(mode, L" + Loading %u images", loads.Pending);
+            }
+            FrameCaptureStats captures;
+            FrameCaptureGetStats(Capture, &captures);
+            if (Capturing || captures.Pending > 0)
+            {
+                const CaptureMode& captureMode = CaptureModes[CaptureModeIndex];
+                AppendText(mode,
+                    L" + Capture %S %S [%u written, %u dropped, %u failed, %u pending, %.3f ms]", captureMode.Name,
+                    CaptureFileFormatExtension(captureMode.Format), captures.Written, captures.Dropped, captures.Failed,
+                    captures.Pending, CaptureMs);
+            }
+            if (FrameHeapAllocations > 0 || DrawCpu)
+            {
+                // Steady frames should make no heap allocations, and the CPU
+                // frame's scratch should fit its arena
+                FrameArenaStats arena;
+                FrameArenaGetStats(CpuFrameArena, &arena);
+                AppendText(mode, L" + %u allocations, %.0f KB arena (%.0f max)",
+                    FrameHeapAllocations, arena.Peak / 1024.0, arena.MaxPeak / 1024.0);
+            }
+            if (DrawCpu && DrawDistorted && !DrawStereo)
+            {
+                // The reference difference only comes from interpolating the
+                // mapping across the grid
+                _snwprintf_s(title, _TRUNCATE, L"%s (CPU %s: VS %.2f ms, PS %.2f ms, %llu pixels shaded, reference max %.3f mean %.4f PSNR %.1f dB)",
+                    mode,
+                    CpuCompiled ? L"compiled" : L"interpreted",
+                    CpuProfile.VertexShader.Nanoseconds / 1000000.0,
+                    CpuProfile.PixelShader.Nanoseconds / 1000000.0,
+                    CpuProfile.PixelShader.Invocations,
+                    CpuReferenceDiff.MaxError, CpuReferenceDiff.MeanError, CpuReferenceDiff.Psnr);
+            }
+            else if (DrawCpu)
+            {
+                _snwprintf_s(title, _TRUNCATE, L"%s (CPU %s: VS %.2f ms, PS %.2f ms, %llu pixels shaded)",
+                    mode,
+                    CpuCompiled ? L"compiled" : L"interpreted",
+                    CpuProfile.VertexShader.Nanoseconds / 1000000.0,
+                    CpuProfile.PixelShader.Nanoseconds / 1000000.0,
+                    CpuProfile.PixelShader.Invocations);
+            }
+            else
+            {
+                _snwprintf_s(title, _TRUNCATE, L"%s", mode);
+            }
+            SetWindowText(window, title);
         }
     }
 
     GraphicsDestroy();
     DestroyWindow(window);
 
-    CoUninitialize();
     return 0;
 }
 
@@ -269,6 +1206,7 @@ bool GraphicsInit(HWND hwnd)
         assert(false);
         return false;
     }
+    BackBuffer = texture;
 
     hr = Device->CreateRenderTargetView(texture.Get(), nullptr, &BackBufferRTV);
     if (FAILED(hr))
@@ -309,31 +1247,50 @@ bool GraphicsInit(HWND hwnd)
         return false;
     }
 
-    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
-    td.Format = DXGI_FORMAT_R32_TYPELESS;
+    if (!GraphicsCreateFrameDepth(td.Width, td.Height, AppFrameDepthFormat))
+    {
+        assert(false);
+        return false;
+    }
 
-    hr = Device->CreateTexture2D(&td, nullptr, texture.ReleaseAndGetAddressOf());
-    if (FAILED(hr))
+    if (!GraphicsCreateDepthPyramid(td.Width, td.Height, &AppFramePyramid))
     {
         assert(false);
         return false;
     }
 
-    D3D11_DEPTH_STENCIL_VIEW_DESC dsvd{};
-    dsvd.Format = DXGI_FORMAT_D32_FLOAT;
-    dsvd.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-    hr = Device->CreateDepthStencilView(texture.Get(), &dsvd, &AppFrameDSV);
-    if (FAILED(hr))
+    // Read back for building the adaptive warp grid on the GPU path
+    D3D11_TEXTURE2D_DESC pyramidDesc{};
+    AppFramePyramid.Texture->GetDesc(&pyramidDesc);
+    pyramidDesc.BindFlags = 0;
+    pyramidDesc.Usage = D3D11_USAGE_STAGING;
+    pyramidDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    for (uint32_t i = 0; i < PyramidReadbackSlots; ++i)
+    {
+        hr = Device->CreateTexture2D(&pyramidDesc, nullptr, AppFramePyramidStaging[i].ReleaseAndGetAddressOf());
+        if (FAILED(hr))
+        {
+            assert(false);
+            return false;
+        }
+    }
+    AppFramePyramidCopies = 0;
+    AppFramePyramidReads = 0;
+
+    // Second layer for the layered positional warp
+    BackBuffer->GetDesc(&td);
+    if (!GraphicsCreateFrameLayer(td, &AppFrameBackLayer))
     {
         assert(false);
         return false;
     }
 
-    D3D11_SHADER_RESOURCE_VIEW_DESC srvd{};
-    srvd.Format = DXGI_FORMAT_R32_FLOAT;
-    srvd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvd.Texture2D.MipLevels = 1;
-    hr = Device->CreateShaderResourceView(texture.Get(), &srvd, &AppFrameDepthSRV);
+    // Reversed-Z keeps the nearest surface by its greater depth
+    D3D11_DEPTH_STENCIL_DESC dsd{};
+    dsd.DepthEnable = TRUE;
+    dsd.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    dsd.DepthFunc = D3D11_COMPARISON_GREATER;
+    hr = Device->CreateDepthStencilState(&dsd, &ReversedDepthState);
     if (FAILED(hr))
     {
         assert(false);
@@ -354,19 +1311,47 @@ bool GraphicsInit(HWND hwnd)
 
     Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    if (!GraphicsCreateScene())
+    if (!CpuInit(scd.BufferDesc.Width, scd.BufferDesc.Height))
     {
         assert(false);
         return false;
     }
 
-    if (!GraphicsCreateRotationalTimewarp())
+    if (!ShaderCacheInit("ShaderCache"))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsLoadShaders())
+    {
+        assert(false);
+        return false;
+    }
+
+    // Not fatal, the report is only for tracking instruction count regressions
+    ShaderCacheWriteReport(ShaderPermutations, _countof(ShaderPermutations), "ShaderCache\\InstructionCounts.txt");
+
+    // Images decode off this thread, and upload in GraphicsDoFrame. Created
+    // here once, as reloading shaders recreates the pipelines and not this.
+    TextureUploader uploader = { GraphicsBeginImageUpload, GraphicsEndImageUpload, nullptr };
+    if (!TextureLoaderCreate(ImageLoadWorkers, ImageLoadBudget, ImageLoadMips, ImageLoadFormat, uploader, &ImageLoader))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Captured frames copy to staging here, and write out on the encoder
+    // thread a few frames later. Created once like the loader, as a queue
+    // owns the staging textures it has mapped.
+    FrameReadback readback = { GraphicsCaptureCopy, GraphicsCaptureMap, GraphicsCaptureUnmap, nullptr };
+    if (!FrameCaptureCreate(CaptureSlots, CaptureLatency, readback, &Capture))
     {
         assert(false);
         return false;
     }
 
-    if (!GraphicsCreatePositionalTimewarp())
+    if (!GraphicsCreatePipelines())
     {
         assert(false);
         return false;
@@ -376,52 +1361,218 @@ bool GraphicsInit(HWND hwnd)
 }
 
 //==============================================================================
-void GraphicsDestroy()
+bool GraphicsLoadShaders()
 {
-    for (uint32_t i = 0; i < _countof(Pipelines); ++i)
+    ShaderVariant variant = ShaderCacheDefaultVariant();
+
+    for (uint32_t i = 0; i < _countof(ShaderPermutations); ++i)
     {
-        Pipelines[i].InputLayout = nullptr;
-        Pipelines[i].PixelShader = nullptr;
-        Pipelines[i].PSConstantBuffer = nullptr;
-        Pipelines[i].VertexShader = nullptr;
-        Pipelines[i].VSConstantBuffer = nullptr;
-        Pipelines[i].IndexBuffer = nullptr;
-        Pipelines[i].VertexBuffer = nullptr;
+        // Compile errors go to the debugger output
+        if (!ShaderCacheLoad(ShaderPermutations[i], variant, &Shaders[i], nullptr))
+        {
+            return false;
+        }
     }
 
-    AppFrameDepthSRV = nullptr;
-    AppFrameSRV = nullptr;
-    AppFrameDSV = nullptr;
-    AppFrameRTV = nullptr;
-    BackBufferRTV = nullptr;
-    SwapChain = nullptr;
-    Context = nullptr;
-    Device = nullptr;
+    return true;
 }
 
 //==============================================================================
-bool GraphicsCreateScene()
+bool GraphicsCreatePipelines()
 {
-    auto& pipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    if (!GraphicsCreateScene())
+    {
+        assert(false);
+        return false;
+    }
 
-    SceneVertex vertices[] = {
-        { { -1.f, -1.f, -1.f },{ 1.f, 0.f, 0.f } },
-        { { -1.f, 1.f, -1.f },{ 0.f, 1.f, 0.f } },
-        { { 1.f, 1.f, -1.f },{ 0.f, 0.f, 1.f } },
-        { { 1.f, -1.f, -1.f },{ 0.f, 1.f, 1.f } },
-        { { 1.f, -1.f, 1.f },{ 1.f, 0.f, 0.f } },
-        { { 1.f, 1.f, 1.f },{ 0.f, 1.f, 0.f } },
-        { { -1.f, 1.f, 1.f },{ 0.f, 0.f, 1.f } },
-        { { -1.f, -1.f, 1.f },{ 1.f, 1.f, 0.f } },
-    };
+    if (!GraphicsCreateRotationalTimewarp())
+    {
+        assert(false);
+        return false;
+    }
 
-    uint32_t indices[] = {
-        0, 1, 2, 0, 2, 3, // front
-        4, 5, 6, 4, 6, 7, // back
-        7, 6, 1, 7, 1, 0, // left
+    if (!GraphicsCreatePositionalTimewarp() ||
+        !GraphicsCreateGridTimewarp(PipelineStateIndex::PositionalLayeredTimewarp,
+            ShaderIndex::PositionalLayeredWarpVS, ShaderIndex::LayeredWarpPS, sizeof(PositionWarpVSConstants)) ||
+        !GraphicsCreateGridTimewarp(PipelineStateIndex::PositionalEncodedTimewarp,
+            ShaderIndex::PositionalEncodedWarpVS, ShaderIndex::PositionalWarpPS, sizeof(EncodedPositionWarpVSConstants)))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsCreateDistortedTimewarp(PipelineStateIndex::RotationalDistortedTimewarp,
+        ShaderIndex::RotationalDistortedWarpVS, ShaderIndex::DistortedWarpPS, sizeof(RotationWarpVSConstants), Lens, 1))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsCreateDistortedTimewarp(PipelineStateIndex::PositionalDistortedTimewarp,
+        ShaderIndex::PositionalDistortedWarpVS, ShaderIndex::DistortedWarpPS, sizeof(PositionWarpVSConstants), Lens, 1))
+    {
+        assert(false);
+        return false;
+    }
+
+    // The undistorted stereo warps share the mono pixel shaders
+    if (!GraphicsCreateStereoTimewarp(PipelineStateIndex::RotationalStereoTimewarp,
+        ShaderIndex::RotationalStereoWarpVS, ShaderIndex::RotationalWarpPS, sizeof(StereoRotationWarpVSConstants)))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsCreateStereoTimewarp(PipelineStateIndex::PositionalStereoTimewarp,
+        ShaderIndex::PositionalStereoWarpVS, ShaderIndex::PositionalWarpPS, sizeof(StereoPositionWarpVSConstants)))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsCreateDistortedTimewarp(PipelineStateIndex::RotationalDistortedStereoTimewarp,
+        ShaderIndex::RotationalDistortedStereoWarpVS, ShaderIndex::DistortedStereoWarpPS, sizeof(StereoRotationWarpVSConstants),
+        StereoLens, 2))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsCreateDistortedTimewarp(PipelineStateIndex::PositionalDistortedStereoTimewarp,
+        ShaderIndex::PositionalDistortedStereoWarpVS, ShaderIndex::DistortedStereoWarpPS, sizeof(StereoPositionWarpVSConstants),
+        StereoLens, 2))
+    {
+        assert(false);
+        return false;
+    }
+
+    // The adaptive grid starts out as the fixed grid until the first rebuild
+    AdaptiveWarpMesh refined;
+    AdaptiveWarpMeshBuildUniform(AdaptiveMeshMaxLevel, &refined);
+    AdaptiveWarpMeshBuildUniform(FixedMeshLevel, &AdaptiveMesh);
+
+    if (!GraphicsCreateAdaptiveTimewarp(PipelineStateIndex::PositionalAdaptiveTimewarp, AdaptiveMesh) ||
+        !GraphicsCreateAdaptiveTimewarp(PipelineStateIndex::PositionalRefinedTimewarp, refined))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!GraphicsCreateDepthPyramidShaders() ||
+        !GraphicsCreateVertexDepth() ||
+        !GraphicsCreateDepthEncode() ||
+        !GraphicsCreateBackwardWarp() ||
+        !GraphicsCreateBackground() ||
+        !GraphicsCreateCompositor())
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsDestroy()
+{
+    FrameCaptureDestroy(&Capture);
+    TextureLoaderDestroy(&ImageLoader);
+
+    for (uint32_t i = 0; i < _countof(Pipelines); ++i)
+    {
+        Pipelines[i].InputLayout = nullptr;
+        Pipelines[i].PixelShader = nullptr;
+        Pipelines[i].PSConstantBuffer = nullptr;
+        Pipelines[i].VertexShader = nullptr;
+        Pipelines[i].VSConstantBuffer = nullptr;
+        Pipelines[i].IndexBuffer = nullptr;
+        Pipelines[i].VertexBuffer = nullptr;
+    }
+
+    CpuDestroy();
+
+    for (uint32_t i = 0; i < _countof(CaptureStaging); ++i)
+    {
+        CaptureStaging[i] = nullptr;
+    }
+    CompositorBlendState = nullptr;
+    for (uint32_t i = 0; i < _countof(LayerSRVs); ++i)
+    {
+        LayerSRVs[i] = nullptr;
+    }
+    BackgroundBlendState = nullptr;
+    TrilinearSampler = nullptr;
+    EnvironmentSRV = nullptr;
+    BackwardWarpConstantBuffer = nullptr;
+    BackwardWarpShader = nullptr;
+    BackwardWarpUAV = nullptr;
+    BackwardWarpTexture = nullptr;
+    DepthEncodeConstantBuffer = nullptr;
+    DepthEncodeShader = nullptr;
+    EncodedDepthUAV = nullptr;
+    EncodedDepthSRV = nullptr;
+    EncodedDepthTexture = nullptr;
+    VertexDepthConstantBuffer = nullptr;
+    VertexDepthShader = nullptr;
+    VertexDepthUAV = nullptr;
+    VertexDepthSRV = nullptr;
+    VertexDepthTexture = nullptr;
+    DepthPyramidConstantBuffer = nullptr;
+    DepthPyramidFromLevelShader = nullptr;
+    DepthPyramidFromDepthShader = nullptr;
+    for (uint32_t i = 0; i < PyramidReadbackSlots; ++i)
+    {
+        AppFramePyramidStaging[i] = nullptr;
+    }
+    AppFramePyramid = GpuDepthPyramid();
+    AppFrameBackLayer = GpuFrameLayer();
+    AppFrameDepthSRV = nullptr;
+    ReversedDepthState = nullptr;
+    AppFrameDepthStaging = nullptr;
+    AppFrameDepth = nullptr;
+    AppFrameSRV = nullptr;
+    AppFrameDSV = nullptr;
+    AppFrameRTV = nullptr;
+    BackBufferRTV = nullptr;
+    BackBuffer = nullptr;
+    SwapChain = nullptr;
+    Context = nullptr;
+    Device = nullptr;
+}
+
+//==============================================================================
+bool GraphicsCreateScene()
+{
+    auto& pipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    auto& sceneVS = GetShader(ShaderIndex::SceneVS);
+    auto& scenePS = GetShader(ShaderIndex::ScenePS);
+
+    SceneVertex vertices[] = {
+        { { -1.f, -1.f, -1.f },{ 1.f, 0.f, 0.f } },
+        { { -1.f, 1.f, -1.f },{ 0.f, 1.f, 0.f } },
+        { { 1.f, 1.f, -1.f },{ 0.f, 0.f, 1.f } },
+        { { 1.f, -1.f, -1.f },{ 0.f, 1.f, 1.f } },
+        { { 1.f, -1.f, 1.f },{ 1.f, 0.f, 0.f } },
+        { { 1.f, 1.f, 1.f },{ 0.f, 1.f, 0.f } },
+        { { -1.f, 1.f, 1.f },{ 0.f, 0.f, 1.f } },
+        { { -1.f, -1.f, 1.f },{ 1.f, 1.f, 0.f } },
+
+        // Backdrop, so the warp has something to reveal behind the cube
+        { { -16.f, -8.f, 6.f },{ 0.2f, 0.3f, 0.8f } },
+        { { -16.f, 10.f, 6.f },{ 0.9f, 0.8f, 0.2f } },
+        { { 16.f, 10.f, 6.f },{ 0.3f, 0.9f, 0.4f } },
+        { { 16.f, -8.f, 6.f },{ 0.8f, 0.2f, 0.6f } },
+    };
+
+    uint32_t indices[] = {
+        0, 1, 2, 0, 2, 3, // front
+        4, 5, 6, 4, 6, 7, // back
+        7, 6, 1, 7, 1, 0, // left
         3, 2, 5, 3, 5, 4, // right
         1, 6, 5, 1, 5, 2, // top
         7, 0, 3, 7, 3, 4, // bottom
+        8, 9, 10, 8, 10, 11, // backdrop
     };
 
     D3D11_BUFFER_DESC bd{};
@@ -461,14 +1612,14 @@ bool GraphicsCreateScene()
 
     pipeline.NumIndices = _countof(indices);
 
-    hr = Device->CreateVertexShader(SceneVS, sizeof(SceneVS), nullptr, &pipeline.VertexShader);
+    hr = Device->CreateVertexShader(sceneVS.data(), sceneVS.size(), nullptr, &pipeline.VertexShader);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    hr = Device->CreatePixelShader(ScenePS, sizeof(ScenePS), nullptr, &pipeline.PixelShader);
+    hr = Device->CreatePixelShader(scenePS.data(), scenePS.size(), nullptr, &pipeline.PixelShader);
     if (FAILED(hr))
     {
         assert(false);
@@ -482,13 +1633,25 @@ bool GraphicsCreateScene()
     elems[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
     elems[1].SemanticName = "COLOR";
 
-    hr = Device->CreateInputLayout(elems, _countof(elems), SceneVS, sizeof(SceneVS), &pipeline.InputLayout);
+    hr = Device->CreateInputLayout(elems, _countof(elems), sceneVS.data(), sceneVS.size(), &pipeline.InputLayout);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
+    CpuInputElement cpuElems[] = {
+        { "POSITION", 0, 3, 0 },
+        { "COLOR", 0, 3, sizeof(XMFLOAT3) },
+    };
+
+    if (!CpuCreatePipeline(PipelineStateIndex::SceneRender, sceneVS.data(), sceneVS.size(), scenePS.data(), scenePS.size(),
+        vertices, sizeof(vertices), sizeof(SceneVertex), indices, _countof(indices), cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+
     bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     bd.ByteWidth = sizeof(SceneVSConstants);
     bd.StructureByteStride = bd.ByteWidth;
@@ -499,6 +1662,27 @@ bool GraphicsCreateScene()
         return false;
     }
 
+    // The second layer draws the same scene, and constants, with the peeling
+    // pixel shader
+    auto& peelPipeline = GetPipeline(PipelineStateIndex::ScenePeelRender);
+    auto& scenePeelPS = GetShader(ShaderIndex::ScenePeelPS);
+    peelPipeline = pipeline;
+    peelPipeline.PixelShader = nullptr;
+
+    hr = Device->CreatePixelShader(scenePeelPS.data(), scenePeelPS.size(), nullptr, &peelPipeline.PixelShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!CpuCreatePipeline(PipelineStateIndex::ScenePeelRender, sceneVS.data(), sceneVS.size(), scenePeelPS.data(), scenePeelPS.size(),
+        vertices, sizeof(vertices), sizeof(SceneVertex), indices, _countof(indices), cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+
     return true;
 }
 
@@ -506,6 +1690,8 @@ bool GraphicsCreateScene()
 bool GraphicsCreateRotationalTimewarp()
 {
     auto& pipeline = GetPipeline(PipelineStateIndex::RotationalTimewarp);
+    auto& rotationalWarpVS = GetShader(ShaderIndex::RotationalWarpVS);
+    auto& rotationalWarpPS = GetShader(ShaderIndex::RotationalWarpPS);
 
     RotationWarpVertex vertices[NumVertsWidth * NumVertsHeight]{};
 
@@ -569,14 +1755,14 @@ bool GraphicsCreateRotationalTimewarp()
 
     pipeline.NumIndices = _countof(indices);
 
-    hr = Device->CreateVertexShader(RotationalWarpVS, sizeof(RotationalWarpVS), nullptr, &pipeline.VertexShader);
+    hr = Device->CreateVertexShader(rotationalWarpVS.data(), rotationalWarpVS.size(), nullptr, &pipeline.VertexShader);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    hr = Device->CreatePixelShader(RotationalWarpPS, sizeof(RotationalWarpPS), nullptr, &pipeline.PixelShader);
+    hr = Device->CreatePixelShader(rotationalWarpPS.data(), rotationalWarpPS.size(), nullptr, &pipeline.PixelShader);
     if (FAILED(hr))
     {
         assert(false);
@@ -586,13 +1772,24 @@ bool GraphicsCreateRotationalTimewarp()
     D3D11_INPUT_ELEMENT_DESC elems[1]{};
     elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
     elems[0].SemanticName = "TEXCOORD";
-    hr = Device->CreateInputLayout(elems, _countof(elems), RotationalWarpVS, sizeof(RotationalWarpVS), &pipeline.InputLayout);
+    hr = Device->CreateInputLayout(elems, _countof(elems), rotationalWarpVS.data(), rotationalWarpVS.size(), &pipeline.InputLayout);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
+    CpuInputElement cpuElems[] = {
+        { "TEXCOORD", 0, 2, 0 },
+    };
+
+    if (!CpuCreatePipeline(PipelineStateIndex::RotationalTimewarp, rotationalWarpVS.data(), rotationalWarpVS.size(), rotationalWarpPS.data(), rotationalWarpPS.size(),
+        vertices, sizeof(vertices), sizeof(RotationWarpVertex), indices, _countof(indices), cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+
     bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     bd.ByteWidth = sizeof(RotationWarpVSConstants);
     bd.StructureByteStride = bd.ByteWidth;
@@ -610,6 +1807,8 @@ bool GraphicsCreateRotationalTimewarp()
 bool GraphicsCreatePositionalTimewarp()
 {
     auto& pipeline = GetPipeline(PipelineStateIndex::PositionalTimewarp);
+    auto& positionalWarpVS = GetShader(ShaderIndex::PositionalWarpVS);
+    auto& positionalWarpPS = GetShader(ShaderIndex::PositionalWarpPS);
 
     PositionWarpVertex vertices[NumVertsWidth * NumVertsHeight]{};
 
@@ -673,14 +1872,14 @@ bool GraphicsCreatePositionalTimewarp()
 
     pipeline.NumIndices = _countof(indices);
 
-    hr = Device->CreateVertexShader(PositionalWarpVS, sizeof(PositionalWarpVS), nullptr, &pipeline.VertexShader);
+    hr = Device->CreateVertexShader(positionalWarpVS.data(), positionalWarpVS.size(), nullptr, &pipeline.VertexShader);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    hr = Device->CreatePixelShader(PositionalWarpPS, sizeof(PositionalWarpPS), nullptr, &pipeline.PixelShader);
+    hr = Device->CreatePixelShader(positionalWarpPS.data(), positionalWarpPS.size(), nullptr, &pipeline.PixelShader);
     if (FAILED(hr))
     {
         assert(false);
@@ -690,13 +1889,24 @@ bool GraphicsCreatePositionalTimewarp()
     D3D11_INPUT_ELEMENT_DESC elems[1]{};
     elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
     elems[0].SemanticName = "TEXCOORD";
-    hr = Device->CreateInputLayout(elems, _countof(elems), PositionalWarpVS, sizeof(PositionalWarpVS), &pipeline.InputLayout);
+    hr = Device->CreateInputLayout(elems, _countof(elems), positionalWarpVS.data(), positionalWarpVS.size(), &pipeline.InputLayout);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
+    CpuInputElement cpuElems[] = {
+        { "TEXCOORD", 0, 2, 0 },
+    };
+
+    if (!CpuCreatePipeline(PipelineStateIndex::PositionalTimewarp, positionalWarpVS.data(), positionalWarpVS.size(), positionalWarpPS.data(), positionalWarpPS.size(),
+        vertices, sizeof(vertices), sizeof(PositionWarpVertex), indices, _countof(indices), cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+
     bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     bd.ByteWidth = sizeof(PositionWarpVSConstants);
     bd.StructureByteStride = bd.ByteWidth;
@@ -711,90 +1921,118 @@ bool GraphicsCreatePositionalTimewarp()
 }
 
 //==============================================================================
-bool GraphicsLoadImage(const wchar_t* filename, ID3D11ShaderResourceView** srv)
+bool GraphicsCreateStereoTimewarp(PipelineStateIndex index, ShaderIndex vs, ShaderIndex ps, uint32_t constantsSize)
 {
-    ComPtr<IWICImagingFactory> factory;
-    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
-    if (FAILED(hr))
+    auto& pipeline = GetPipeline(index);
+    auto& stereoWarpVS = GetShader(vs);
+    auto& stereoWarpPS = GetShader(ps);
+
+    // One grid over an eye, drawn once per eye. The VS moves each instance
+    // into its half of the back buffer and clips it there.
+    std::vector<RotationWarpVertex> vertices(NumVertsWidth * NumVertsHeight);
+    for (uint32_t y = 0; y < NumVertsHeight; ++y)
     {
-        assert(false);
-        return false;
+        for (uint32_t x = 0; x < NumVertsWidth; ++x)
+        {
+            vertices[y * NumVertsWidth + x].TexCoord =
+                XMFLOAT2(x / (float)(NumVertsWidth - 1), y / (float)(NumVertsHeight - 1));
+        }
     }
+    uint32_t verticesSize = (uint32_t)(vertices.size() * sizeof(RotationWarpVertex));
 
-    ComPtr<IWICBitmapDecoder> decoder;
-    hr = factory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ, WICDecodeOptions::WICDecodeMetadataCacheOnLoad, &decoder);
-    if (FAILED(hr))
+    std::vector<uint32_t> indices((NumVertsWidth - 1) * (NumVertsHeight - 1) * 6);
+    for (uint32_t y = 0; y < NumVertsHeight - 1; ++y)
     {
-        assert(false);
-        return false;
+        for (uint32_t x = 0; x < NumVertsWidth - 1; ++x)
+        {
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 0] = y * NumVertsWidth + x;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 1] = y * NumVertsWidth + x + 1;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 2] = (y + 1) * NumVertsWidth + x;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 3] = (y + 1) * NumVertsWidth + x;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 4] = y * NumVertsWidth + x + 1;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 5] = (y + 1) * NumVertsWidth + x + 1;
+        }
     }
 
-    ComPtr<IWICBitmapFrameDecode> frame;
-    hr = decoder->GetFrame(0, &frame);
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.ByteWidth = verticesSize;
+    bd.StructureByteStride = sizeof(RotationWarpVertex);
+
+    D3D11_SUBRESOURCE_DATA init{};
+    init.pSysMem = vertices.data();
+    init.SysMemPitch = bd.ByteWidth;
+    init.SysMemSlicePitch = init.SysMemPitch;
+
+    HRESULT hr = Device->CreateBuffer(&bd, &init, &pipeline.VertexBuffer);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    ComPtr<IWICFormatConverter> converter;
-    hr = factory->CreateFormatConverter(&converter);
+    pipeline.Stride = bd.StructureByteStride;
+    pipeline.Offset = 0;
+
+    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd.ByteWidth = (uint32_t)(indices.size() * sizeof(uint32_t));
+    bd.StructureByteStride = sizeof(uint32_t);
+
+    init.pSysMem = indices.data();
+    init.SysMemPitch = bd.ByteWidth;
+    init.SysMemSlicePitch = init.SysMemPitch;
+
+    hr = Device->CreateBuffer(&bd, &init, &pipeline.IndexBuffer);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    hr = converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherType::WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteType::WICBitmapPaletteTypeCustom);
+    pipeline.NumIndices = (uint32_t)indices.size();
+    pipeline.NumInstances = 2;
+
+    hr = Device->CreateVertexShader(stereoWarpVS.data(), stereoWarpVS.size(), nullptr, &pipeline.VertexShader);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    uint32_t width = 0, height = 0;
-    hr = frame->GetSize(&width, &height);
+    hr = Device->CreatePixelShader(stereoWarpPS.data(), stereoWarpPS.size(), nullptr, &pipeline.PixelShader);
     if (FAILED(hr))
     {
         assert(false);
         return false;
     }
 
-    D3D11_TEXTURE2D_DESC td{};
-    td.ArraySize = 1;
-    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    td.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    td.Width = width;
-    td.Height = height;
-    td.MipLevels = 1;
-    td.SampleDesc.Count = 1;
-
-    uint32_t* pixels = new uint32_t[width * height];
-    hr = converter->CopyPixels(nullptr, sizeof(uint32_t) * width, width * height * sizeof(uint32_t), (BYTE*)pixels);
+    D3D11_INPUT_ELEMENT_DESC elems[1]{};
+    elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
+    elems[0].SemanticName = "TEXCOORD";
+    hr = Device->CreateInputLayout(elems, _countof(elems), stereoWarpVS.data(), stereoWarpVS.size(), &pipeline.InputLayout);
     if (FAILED(hr))
     {
         assert(false);
-        delete[] pixels;
         return false;
     }
 
-    D3D11_SUBRESOURCE_DATA init{};
-    init.pSysMem = pixels;
-    init.SysMemPitch = sizeof(uint32_t) * width;
-    init.SysMemSlicePitch = init.SysMemPitch * height;
+    CpuInputElement cpuElems[] = {
+        { "TEXCOORD", 0, 2, 0 },
+    };
 
-    ComPtr<ID3D11Texture2D> texture;
-    hr = Device->CreateTexture2D(&td, &init, &texture);
-    if (FAILED(hr))
+    if (!CpuCreatePipeline(index, stereoWarpVS.data(), stereoWarpVS.size(), stereoWarpPS.data(), stereoWarpPS.size(),
+        vertices.data(), verticesSize, sizeof(RotationWarpVertex), indices.data(), (uint32_t)indices.size(),
+        cpuElems, _countof(cpuElems)))
     {
         assert(false);
-        delete[] pixels;
         return false;
     }
+    GetCpuPipeline(index).State.NumInstances = 2;
 
-    delete[] pixels;
-
-    hr = Device->CreateShaderResourceView(texture.Get(), nullptr, srv);
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = constantsSize;
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, &pipeline.VSConstantBuffer);
     if (FAILED(hr))
     {
         assert(false);
@@ -805,45 +2043,4417 @@ bool GraphicsLoadImage(const wchar_t* filename, ID3D11ShaderResourceView** srv)
 }
 
 //==============================================================================
-void GraphicsDrawPipeline(const PipelineState& pipeline)
+bool GraphicsCreateDistortedTimewarp(PipelineStateIndex index, ShaderIndex vs, ShaderIndex ps, uint32_t constantsSize,
+    const LensDistortion& lens, uint32_t numInstances)
 {
-    Context->IASetVertexBuffers(0, 1, pipeline.VertexBuffer.GetAddressOf(), &pipeline.Stride, &pipeline.Offset);
-    Context->IASetIndexBuffer(pipeline.IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-    Context->IASetInputLayout(pipeline.InputLayout.Get());
-    Context->VSSetShader(pipeline.VertexShader.Get(), nullptr, 0);
-    Context->VSSetConstantBuffers(0, 1, pipeline.VSConstantBuffer.GetAddressOf());
-    Context->PSSetShader(pipeline.PixelShader.Get(), nullptr, 0);
-    Context->PSSetConstantBuffers(0, 1, pipeline.PSConstantBuffer.GetAddressOf());
-    Context->DrawIndexed(pipeline.NumIndices, 0, 0);
-}
+    auto& pipeline = GetPipeline(index);
+    auto& distortedWarpVS = GetShader(vs);
+    auto& distortedWarpPS = GetShader(ps);
+
+    // Same layout and triangle order as the undistorted grid, but regular in
+    // display space
+    std::vector<DistortionWarpVertex> vertices(NumVertsWidth * NumVertsHeight);
+    LensDistortionCreateMesh(lens, NumVertsWidth, NumVertsHeight, vertices.data());
+    uint32_t verticesSize = (uint32_t)(vertices.size() * sizeof(DistortionWarpVertex));
+
+    std::vector<uint32_t> indices((NumVertsWidth - 1) * (NumVertsHeight - 1) * 6);
+    for (uint32_t y = 0; y < NumVertsHeight - 1; ++y)
+    {
+        for (uint32_t x = 0; x < NumVertsWidth - 1; ++x)
+        {
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 0] = y * NumVertsWidth + x;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 1] = y * NumVertsWidth + x + 1;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 2] = (y + 1) * NumVertsWidth + x;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 3] = (y + 1) * NumVertsWidth + x;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 4] = y * NumVertsWidth + x + 1;
+            indices[(y * (NumVertsWidth - 1) + x) * 6 + 5] = (y + 1) * NumVertsWidth + x + 1;
+        }
+    }
 
-//==============================================================================
-void GraphicsDoFrame()
-{
-    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
-    Context->ClearRenderTargetView(AppFrameRTV.Get(), clearColor);
-    Context->ClearDepthStencilView(AppFrameDSV.Get(), D3D11_CLEAR_DEPTH, 1.f, 0);
-    Context->ClearRenderTargetView(BackBufferRTV.Get(), clearColor);
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.ByteWidth = verticesSize;
+    bd.StructureByteStride = sizeof(DistortionWarpVertex);
 
-    static bool lastSpaceDown = false;
+    D3D11_SUBRESOURCE_DATA init{};
+    init.pSysMem = vertices.data();
+    init.SysMemPitch = bd.ByteWidth;
+    init.SysMemSlicePitch = init.SysMemPitch;
 
-    bool spacePressed = false;
-    if (GetAsyncKeyState(VK_SPACE) & 0x8000)
+    HRESULT hr = Device->CreateBuffer(&bd, &init, &pipeline.VertexBuffer);
+    if (FAILED(hr))
     {
-        spacePressed = !lastSpaceDown;
-        lastSpaceDown = true;
+        assert(false);
+        return false;
     }
-    else
+
+    pipeline.Stride = bd.StructureByteStride;
+    pipeline.Offset = 0;
+
+    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd.ByteWidth = (uint32_t)(indices.size() * sizeof(uint32_t));
+    bd.StructureByteStride = sizeof(uint32_t);
+
+    init.pSysMem = indices.data();
+    init.SysMemPitch = bd.ByteWidth;
+    init.SysMemSlicePitch = init.SysMemPitch;
+
+    hr = Device->CreateBuffer(&bd, &init, &pipeline.IndexBuffer);
+    if (FAILED(hr))
     {
-        lastSpaceDown = false;
+        assert(false);
+        return false;
     }
 
-    if (spacePressed)
+    pipeline.NumIndices = (uint32_t)indices.size();
+    pipeline.NumInstances = numInstances;
+
+    hr = Device->CreateVertexShader(distortedWarpVS.data(), distortedWarpVS.size(), nullptr, &pipeline.VertexShader);
+    if (FAILED(hr))
     {
-        DrawNative = !DrawNative;
+        assert(false);
+        return false;
     }
 
-    // Update rotational warp params
+    hr = Device->CreatePixelShader(distortedWarpPS.data(), distortedWarpPS.size(), nullptr, &pipeline.PixelShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_INPUT_ELEMENT_DESC elems[4]{};
+    elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
+    elems[0].SemanticName = "POSITION";
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        elems[1 + c].AlignedByteOffset = sizeof(XMFLOAT2) * (1 + c);
+        elems[1 + c].Format = DXGI_FORMAT_R32G32_FLOAT;
+        elems[1 + c].SemanticName = "TEXCOORD";
+        elems[1 + c].SemanticIndex = c;
+    }
+    hr = Device->CreateInputLayout(elems, _countof(elems), distortedWarpVS.data(), distortedWarpVS.size(), &pipeline.InputLayout);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    CpuInputElement cpuElems[] = {
+        { "POSITION", 0, 2, 0 },
+        { "TEXCOORD", 0, 2, sizeof(XMFLOAT2) },
+        { "TEXCOORD", 1, 2, sizeof(XMFLOAT2) * 2 },
+        { "TEXCOORD", 2, 2, sizeof(XMFLOAT2) * 3 },
+    };
+
+    if (!CpuCreatePipeline(index, distortedWarpVS.data(), distortedWarpVS.size(), distortedWarpPS.data(), distortedWarpPS.size(),
+        vertices.data(), verticesSize, sizeof(DistortionWarpVertex), indices.data(), (uint32_t)indices.size(),
+        cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+    GetCpuPipeline(index).State.NumInstances = numInstances;
+
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = constantsSize;
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, &pipeline.VSConstantBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateGridTimewarp(PipelineStateIndex index, ShaderIndex vs, ShaderIndex ps, uint32_t constantsSize)
+{
+    // The fixed positional grid with other shaders, and its own constants
+    // since the fixed grid's may be set up for per-vertex depth
+    auto& grid = GetPipeline(PipelineStateIndex::PositionalTimewarp);
+    auto& cpuGrid = GetCpuPipeline(PipelineStateIndex::PositionalTimewarp);
+    auto& pipeline = GetPipeline(index);
+    auto& gridWarpVS = GetShader(vs);
+    auto& gridWarpPS = GetShader(ps);
+
+    pipeline = PipelineState();
+    pipeline.VertexBuffer = grid.VertexBuffer;
+    pipeline.IndexBuffer = grid.IndexBuffer;
+    pipeline.Stride = grid.Stride;
+    pipeline.Offset = grid.Offset;
+    pipeline.NumIndices = grid.NumIndices;
+
+    HRESULT hr = Device->CreateVertexShader(gridWarpVS.data(), gridWarpVS.size(), nullptr, &pipeline.VertexShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreatePixelShader(gridWarpPS.data(), gridWarpPS.size(), nullptr, &pipeline.PixelShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_INPUT_ELEMENT_DESC elems[1]{};
+    elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
+    elems[0].SemanticName = "TEXCOORD";
+    hr = Device->CreateInputLayout(elems, _countof(elems), gridWarpVS.data(), gridWarpVS.size(), &pipeline.InputLayout);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    CpuInputElement cpuElems[] = {
+        { "TEXCOORD", 0, 2, 0 },
+    };
+
+    if (!CpuCreatePipeline(index, gridWarpVS.data(), gridWarpVS.size(), gridWarpPS.data(), gridWarpPS.size(),
+        cpuGrid.Vertices.data(), (uint32_t)cpuGrid.Vertices.size(), sizeof(PositionWarpVertex), cpuGrid.Indices.data(), (uint32_t)cpuGrid.Indices.size(),
+        cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = constantsSize;
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, &pipeline.VSConstantBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateAdaptiveTimewarp(PipelineStateIndex index, const AdaptiveWarpMesh& mesh)
+{
+    static_assert(sizeof(AdaptiveWarpVertex) == sizeof(PositionWarpVertex), "Adaptive grid must match the fixed grid layout");
+
+    auto& pipeline = GetPipeline(index);
+    auto& positionalWarpVS = GetShader(ShaderIndex::PositionalWarpVS);
+    auto& positionalWarpPS = GetShader(ShaderIndex::PositionalWarpPS);
+
+    // Sized for any grid up to the finest level, so rebuilds only map and write
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.ByteWidth = AdaptiveWarpMeshMaxVertices(AdaptiveMeshMaxLevel) * sizeof(AdaptiveWarpVertex);
+    bd.StructureByteStride = sizeof(AdaptiveWarpVertex);
+    bd.Usage = D3D11_USAGE_DYNAMIC;
+    bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HRESULT hr = Device->CreateBuffer(&bd, nullptr, &pipeline.VertexBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    pipeline.Stride = bd.StructureByteStride;
+    pipeline.Offset = 0;
+
+    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd.ByteWidth = AdaptiveWarpMeshMaxIndices(AdaptiveMeshMaxLevel) * sizeof(uint32_t);
+    bd.StructureByteStride = sizeof(uint32_t);
+
+    hr = Device->CreateBuffer(&bd, nullptr, &pipeline.IndexBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateVertexShader(positionalWarpVS.data(), positionalWarpVS.size(), nullptr, &pipeline.VertexShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreatePixelShader(positionalWarpPS.data(), positionalWarpPS.size(), nullptr, &pipeline.PixelShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_INPUT_ELEMENT_DESC elems[1]{};
+    elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
+    elems[0].SemanticName = "TEXCOORD";
+    hr = Device->CreateInputLayout(elems, _countof(elems), positionalWarpVS.data(), positionalWarpVS.size(), &pipeline.InputLayout);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    CpuInputElement cpuElems[] = {
+        { "TEXCOORD", 0, 2, 0 },
+    };
+
+    if (!CpuCreatePipeline(index, positionalWarpVS.data(), positionalWarpVS.size(), positionalWarpPS.data(), positionalWarpPS.size(),
+        mesh.Vertices.data(), (uint32_t)(mesh.Vertices.size() * sizeof(AdaptiveWarpVertex)), sizeof(AdaptiveWarpVertex),
+        mesh.Indices.data(), (uint32_t)mesh.Indices.size(), cpuElems, _countof(cpuElems)))
+    {
+        assert(false);
+        return false;
+    }
+
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = sizeof(PositionWarpVSConstants);
+    bd.StructureByteStride = bd.ByteWidth;
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.CPUAccessFlags = 0;
+    hr = Device->CreateBuffer(&bd, nullptr, &pipeline.VSConstantBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return GraphicsUpdateAdaptiveTimewarp(index, mesh);
+}
+
+//==============================================================================
+bool GraphicsUpdateAdaptiveTimewarp(PipelineStateIndex index, const AdaptiveWarpMesh& mesh)
+{
+    auto& pipeline = GetPipeline(index);
+
+    if (mesh.Vertices.size() > AdaptiveWarpMeshMaxVertices(AdaptiveMeshMaxLevel) ||
+        mesh.Indices.size() > AdaptiveWarpMeshMaxIndices(AdaptiveMeshMaxLevel))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    HRESULT hr = Context->Map(pipeline.VertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+    memcpy(mapped.pData, mesh.Vertices.data(), mesh.Vertices.size() * sizeof(AdaptiveWarpVertex));
+    Context->Unmap(pipeline.VertexBuffer.Get(), 0);
+
+    hr = Context->Map(pipeline.IndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+    memcpy(mapped.pData, mesh.Indices.data(), mesh.Indices.size() * sizeof(uint32_t));
+    Context->Unmap(pipeline.IndexBuffer.Get(), 0);
+
+    pipeline.NumIndices = (uint32_t)mesh.Indices.size();
+
+    auto& cpuPipeline = GetCpuPipeline(index);
+    cpuPipeline.Vertices.assign((const uint8_t*)mesh.Vertices.data(), (const uint8_t*)(mesh.Vertices.data() + mesh.Vertices.size()));
+    cpuPipeline.Indices.assign(mesh.Indices.begin(), mesh.Indices.end());
+    cpuPipeline.State.Vertices = cpuPipeline.Vertices.data();
+    cpuPipeline.State.NumVertices = (uint32_t)mesh.Vertices.size();
+    cpuPipeline.State.Indices = cpuPipeline.Indices.data();
+    cpuPipeline.State.NumIndices = (uint32_t)mesh.Indices.size();
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateDepthPyramidShaders()
+{
+    auto& fromDepthCS = GetShader(ShaderIndex::DepthPyramidFromDepthCS);
+    auto& fromLevelCS = GetShader(ShaderIndex::DepthPyramidFromLevelCS);
+
+    HRESULT hr = Device->CreateComputeShader(fromDepthCS.data(), fromDepthCS.size(), nullptr,
+        DepthPyramidFromDepthShader.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateComputeShader(fromLevelCS.data(), fromLevelCS.size(), nullptr,
+        DepthPyramidFromLevelShader.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = sizeof(DepthPyramidConstants);
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, DepthPyramidConstantBuffer.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateDepthPyramid(uint32_t width, uint32_t height, GpuDepthPyramid* pyramid)
+{
+    *pyramid = GpuDepthPyramid();
+    pyramid->Width = width;
+    pyramid->Height = height;
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = width > 1 ? width / 2 : 1;
+    td.Height = height > 1 ? height / 2 : 1;
+    td.MipLevels = DepthPyramidNumLevels(width, height);
+    td.ArraySize = 1;
+    td.Format = DXGI_FORMAT_R32G32_FLOAT;
+    td.SampleDesc.Count = 1;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+    HRESULT hr = Device->CreateTexture2D(&td, nullptr, &pyramid->Texture);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateShaderResourceView(pyramid->Texture.Get(), nullptr, &pyramid->SRV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Each level reads the one below it, so levels get their own views
+    pyramid->LevelSRVs.resize(td.MipLevels);
+    pyramid->LevelUAVs.resize(td.MipLevels);
+    for (uint32_t i = 0; i < td.MipLevels; ++i)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvd{};
+        srvd.Format = td.Format;
+        srvd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvd.Texture2D.MostDetailedMip = i;
+        srvd.Texture2D.MipLevels = 1;
+        hr = Device->CreateShaderResourceView(pyramid->Texture.Get(), &srvd, &pyramid->LevelSRVs[i]);
+        if (FAILED(hr))
+        {
+            assert(false);
+            return false;
+        }
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC uavd{};
+        uavd.Format = td.Format;
+        uavd.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+        uavd.Texture2D.MipSlice = i;
+        hr = Device->CreateUnorderedAccessView(pyramid->Texture.Get(), &uavd, &pyramid->LevelUAVs[i]);
+        if (FAILED(hr))
+        {
+            assert(false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsBuildDepthPyramid(ID3D11ShaderResourceView* depth, const GpuDepthPyramid& pyramid)
+{
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    ID3D11UnorderedAccessView* nullUAV = nullptr;
+
+    Context->CSSetConstantBuffers(0, 1, DepthPyramidConstantBuffer.GetAddressOf());
+
+    uint32_t sourceWidth = pyramid.Width;
+    uint32_t sourceHeight = pyramid.Height;
+    for (uint32_t i = 0; i < pyramid.LevelUAVs.size(); ++i)
+    {
+        DepthPyramidConstants constants{};
+        constants.SourceSize = XMUINT2(sourceWidth, sourceHeight);
+        constants.TargetSize = XMUINT2(sourceWidth > 1 ? sourceWidth / 2 : 1, sourceHeight > 1 ? sourceHeight / 2 : 1);
+        Context->UpdateSubresource(DepthPyramidConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+        // The previous level's UAV must be unbound before it's read
+        Context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+        if (i == 0)
+        {
+            Context->CSSetShader(DepthPyramidFromDepthShader.Get(), nullptr, 0);
+            Context->CSSetShaderResources(0, 1, &depth);
+        }
+        else
+        {
+            Context->CSSetShader(DepthPyramidFromLevelShader.Get(), nullptr, 0);
+            Context->CSSetShaderResources(0, 1, pyramid.LevelSRVs[i - 1].GetAddressOf());
+        }
+        Context->CSSetUnorderedAccessViews(0, 1, pyramid.LevelUAVs[i].GetAddressOf(), nullptr);
+
+        Context->Dispatch((constants.TargetSize.x + 7) / 8, (constants.TargetSize.y + 7) / 8, 1);
+
+        sourceWidth = constants.TargetSize.x;
+        sourceHeight = constants.TargetSize.y;
+    }
+
+    Context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+    Context->CSSetShaderResources(0, 1, &nullSRV);
+    Context->CSSetShader(nullptr, nullptr, 0);
+}
+
+//==============================================================================
+bool GraphicsReadBackDepthPyramid(DepthPyramid* pyramid)
+{
+    // Copies this frame's pyramid, then reads the copies the GPU has finished,
+    // oldest first, without waiting on the rest. When the GPU falls behind by
+    // every slot the oldest copy is dropped for this one.
+    if (AppFramePyramidCopies - AppFramePyramidReads == PyramidReadbackSlots)
+    {
+        ++AppFramePyramidReads;
+    }
+    ID3D11Texture2D* copy = AppFramePyramidStaging[AppFramePyramidCopies % PyramidReadbackSlots].Get();
+    Context->CopyResource(copy, AppFramePyramid.Texture.Get());
+    ++AppFramePyramidCopies;
+
+    bool read = false;
+    while (AppFramePyramidReads < AppFramePyramidCopies)
+    {
+        ID3D11Texture2D* staging = AppFramePyramidStaging[AppFramePyramidReads % PyramidReadbackSlots].Get();
+        for (uint32_t level = 0; level < pyramid->Levels.size(); ++level)
+        {
+            D3D11_MAPPED_SUBRESOURCE mapped{};
+            HRESULT hr = Context->Map(staging, level, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+            if (hr == DXGI_ERROR_WAS_STILL_DRAWING && level == 0)
+            {
+                return read;
+            }
+            if (FAILED(hr))
+            {
+                assert(false);
+                return false;
+            }
+
+            CpuTexture& target = pyramid->Levels[level];
+            for (uint32_t y = 0; y < target.Height; ++y)
+            {
+                const uint8_t* row = (const uint8_t*)mapped.pData + (size_t)y * mapped.RowPitch;
+                memcpy(target.Data + (size_t)y * target.RowPitch, row, (size_t)target.Width * 2 * sizeof(float));
+            }
+            Context->Unmap(staging, level);
+        }
+        ++AppFramePyramidReads;
+        read = true;
+    }
+    return read;
+}
+
+//==============================================================================
+bool GraphicsBenchmarkDepthPyramid(const char* filename)
+{
+    static const uint32_t Sizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    static const uint32_t Iterations = 20;
+
+    std::string report;
+    char line[256];
+
+    sprintf_s(line, "%-12s %6s %10s %10s\n", "Depth", "Levels", "CPU ms", "GPU ms");
+    report += line;
+
+    for (auto& size : Sizes)
+    {
+        uint32_t width = size[0];
+        uint32_t height = size[1];
+
+        // Stand in depth with edges in it, the content doesn't change the cost
+        CpuTexture cpuDepth{};
+        DepthPyramid cpuPyramid{};
+        if (!CpuTextureCreate(width, height, CpuFormat::R32Float, &cpuDepth) ||
+            !DepthPyramidCreate(width, height, &cpuPyramid))
+        {
+            assert(false);
+            return false;
+        }
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            float* row = (float*)(cpuDepth.Data + (size_t)y * cpuDepth.RowPitch);
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                row[x] = ((x / 64 + y / 64) & 1) ? 0.99f : 0.5f + x / (4.f * width);
+            }
+        }
+
+        double cpuMs = CpuTimeMs(Iterations, [&]() { DepthPyramidBuild(cpuDepth, &cpuPyramid); });
+
+        D3D11_TEXTURE2D_DESC td{};
+        td.Width = width;
+        td.Height = height;
+        td.MipLevels = 1;
+        td.ArraySize = 1;
+        td.Format = DXGI_FORMAT_R32_FLOAT;
+        td.SampleDesc.Count = 1;
+        td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        D3D11_SUBRESOURCE_DATA initial{};
+        initial.pSysMem = cpuDepth.Data;
+        initial.SysMemPitch = cpuDepth.RowPitch;
+
+        ComPtr<ID3D11Texture2D> gpuDepth;
+        ComPtr<ID3D11ShaderResourceView> gpuDepthSRV;
+        GpuDepthPyramid gpuPyramid;
+        HRESULT hr = Device->CreateTexture2D(&td, &initial, &gpuDepth);
+        if (FAILED(hr) ||
+            FAILED(Device->CreateShaderResourceView(gpuDepth.Get(), nullptr, &gpuDepthSRV)) ||
+            !GraphicsCreateDepthPyramid(width, height, &gpuPyramid))
+        {
+            assert(false);
+            return false;
+        }
+
+        double gpuMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsBuildDepthPyramid(gpuDepthSRV.Get(), gpuPyramid); });
+
+        char depthSize[16];
+        char gpuText[16];
+        sprintf_s(depthSize, "%ux%u", width, height);
+        FormatMs(gpuMs, gpuText);
+        sprintf_s(line, "%-12s %6u %10.3f %10s\n", depthSize, DepthPyramidNumLevels(width, height), cpuMs, gpuText);
+        report += line;
+
+        DepthPyramidDestroy(&cpuPyramid);
+        CpuTextureDestroy(&cpuDepth);
+    }
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool GraphicsCreateVertexDepth()
+{
+    auto& vertexDepthCS = GetShader(ShaderIndex::VertexDepthCS);
+
+    HRESULT hr = Device->CreateComputeShader(vertexDepthCS.data(), vertexDepthCS.size(), nullptr,
+        VertexDepthShader.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = sizeof(VertexDepthConstants);
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, VertexDepthConstantBuffer.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = NumVertsWidth;
+    td.Height = NumVertsHeight;
+    td.MipLevels = 1;
+    td.ArraySize = 1;
+    td.Format = DXGI_FORMAT_R32_FLOAT;
+    td.SampleDesc.Count = 1;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+    hr = Device->CreateTexture2D(&td, nullptr, VertexDepthTexture.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateShaderResourceView(VertexDepthTexture.Get(), nullptr, VertexDepthSRV.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateUnorderedAccessView(VertexDepthTexture.Get(), nullptr, VertexDepthUAV.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsBuildVertexDepth(VertexDepthMode mode)
+{
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    ID3D11UnorderedAccessView* nullUAV = nullptr;
+
+    D3D11_TEXTURE2D_DESC td{};
+    AppFrameDepth->GetDesc(&td);
+
+    VertexDepthConstants constants{};
+    constants.DepthSize = XMUINT2(td.Width, td.Height);
+    constants.VertexCount = XMUINT2(NumVertsWidth, NumVertsHeight);
+    constants.Mode = (uint32_t)mode;
+    Context->UpdateSubresource(VertexDepthConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+    // The warp reads the result in its vertex shader
+    Context->VSSetShaderResources(0, 1, &nullSRV);
+
+    Context->CSSetShader(VertexDepthShader.Get(), nullptr, 0);
+    Context->CSSetConstantBuffers(0, 1, VertexDepthConstantBuffer.GetAddressOf());
+    Context->CSSetShaderResources(0, 1, AppFrameDepthSRV.GetAddressOf());
+    Context->CSSetUnorderedAccessViews(0, 1, VertexDepthUAV.GetAddressOf(), nullptr);
+
+    Context->Dispatch((NumVertsWidth + 7) / 8, (NumVertsHeight + 7) / 8, 1);
+
+    Context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+    Context->CSSetShaderResources(0, 1, &nullSRV);
+    Context->CSSetShader(nullptr, nullptr, 0);
+}
+
+//==============================================================================
+bool GraphicsBenchmarkVertexDepth(const char* filename)
+{
+    static const uint32_t Iterations = 20;
+
+    // The fixed positional grid on the current frame, read back on the GPU
+    // path so both sides reduce the same depth
+    if (!DrawCpu && !GraphicsReadBackDepth(&CpuAppFrameDepth))
+    {
+        assert(false);
+        return false;
+    }
+    const CpuTexture& depth = CpuAppFrameDepth;
+
+    auto& pipeline = GetPipeline(PipelineStateIndex::PositionalTimewarp);
+    PositionWarpVSConstants constants{};
+    XMStoreFloat4x4(&constants.TWMatrix, XMMatrixIdentity());
+
+    std::string report;
+    char line[256];
+
+    sprintf_s(line, "Fixed %ux%u grid over %ux%u depth, ms per frame\n", NumVertsWidth, NumVertsHeight, depth.Width, depth.Height);
+    report += line;
+    sprintf_s(line, "%-10s %10s %10s %10s %10s\n", "Depth", "CPU pass", "CPU warp", "GPU pass", "GPU warp");
+    report += line;
+
+    // Raw texel loads first, then each mode
+    for (int32_t i = -1; i < (int32_t)VertexDepthMode::Count; ++i)
+    {
+        VertexDepthMode mode = (VertexDepthMode)i;
+        bool raw = i < 0;
+
+        double cpuPassMs = -1;
+        double gpuPassMs = -1;
+        const CpuTexture* cpuVertexDepth = &depth;
+        ID3D11ShaderResourceView* vertexDepthSRV = AppFrameDepthSRV.Get();
+        constants.TextureSize = XMFLOAT2((float)depth.Width, (float)depth.Height);
+        if (!raw)
+        {
+            cpuPassMs = CpuTimeMs(Iterations, [&]() { VertexDepthBuild(depth, mode, &CpuVertexDepth); });
+            gpuPassMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsBuildVertexDepth(mode); });
+            cpuVertexDepth = &CpuVertexDepth.Depths;
+            vertexDepthSRV = VertexDepthSRV.Get();
+            constants.TextureSize = XMFLOAT2((float)(NumVertsWidth - 1), (float)(NumVertsHeight - 1));
+        }
+
+        // Into the scratch target, the profile is left to the frame
+        CpuRenderProfile profile = CpuProfile;
+        double cpuWarpMs = CpuTimeMs(Iterations, [&]()
+        {
+            CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &constants, cpuVertexDepth, &CpuAppFrame, &CpuFixedWarp, nullptr);
+        });
+        CpuProfile = profile;
+
+        Context->UpdateSubresource(pipeline.VSConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        Context->VSSetShaderResources(0, 1, &vertexDepthSRV);
+        Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
+        double gpuWarpMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsDrawPipeline(pipeline); });
+
+        char text[4][16];
+        FormatMs(cpuPassMs, text[0]);
+        FormatMs(cpuWarpMs, text[1]);
+        FormatMs(gpuPassMs, text[2]);
+        FormatMs(gpuWarpMs, text[3]);
+        sprintf_s(line, "%-10s %10s %10s %10s %10s\n", raw ? "Texel" : VertexDepthModeName(mode), text[0], text[1], text[2], text[3]);
+        report += line;
+    }
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool GraphicsCreateDepthEncode()
+{
+    auto& depthEncodeCS = GetShader(ShaderIndex::DepthEncodeCS);
+
+    HRESULT hr = Device->CreateComputeShader(depthEncodeCS.data(), depthEncodeCS.size(), nullptr,
+        DepthEncodeShader.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = sizeof(DepthEncodeCSConstants);
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, DepthEncodeConstantBuffer.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Same size as the app frame depth, at 16 bits
+    D3D11_TEXTURE2D_DESC depthDesc{};
+    AppFrameDepth->GetDesc(&depthDesc);
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = depthDesc.Width;
+    td.Height = depthDesc.Height;
+    td.MipLevels = 1;
+    td.ArraySize = 1;
+    td.Format = DXGI_FORMAT_R16_UNORM;
+    td.SampleDesc.Count = 1;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+    hr = Device->CreateTexture2D(&td, nullptr, EncodedDepthTexture.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateShaderResourceView(EncodedDepthTexture.Get(), nullptr, EncodedDepthSRV.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateUnorderedAccessView(EncodedDepthTexture.Get(), nullptr, EncodedDepthUAV.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsEncodeDepth(const DepthEncodeDesc& desc)
+{
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    ID3D11UnorderedAccessView* nullUAV = nullptr;
+
+    D3D11_TEXTURE2D_DESC td{};
+    AppFrameDepth->GetDesc(&td);
+
+    DepthEncodeCSConstants constants{};
+    constants.DepthSize = XMUINT2(td.Width, td.Height);
+    constants.Encoding = (uint32_t)desc.Encoding;
+    constants.Far = desc.Far;
+    DepthEncodeGetConstants(desc, &constants.Params);
+    Context->UpdateSubresource(DepthEncodeConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+    // The warp reads the result in its vertex shader
+    Context->VSSetShaderResources(0, 1, &nullSRV);
+
+    Context->CSSetShader(DepthEncodeShader.Get(), nullptr, 0);
+    Context->CSSetConstantBuffers(0, 1, DepthEncodeConstantBuffer.GetAddressOf());
+    Context->CSSetShaderResources(0, 1, AppFrameDepthSRV.GetAddressOf());
+    Context->CSSetUnorderedAccessViews(0, 1, EncodedDepthUAV.GetAddressOf(), nullptr);
+
+    Context->Dispatch((td.Width + 7) / 8, (td.Height + 7) / 8, 1);
+
+    Context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+    Context->CSSetShaderResources(0, 1, &nullSRV);
+    Context->CSSetShader(nullptr, nullptr, 0);
+}
+
+//==============================================================================
+bool GraphicsBenchmarkDepthEncode(const char* filename)
+{
+    static const uint32_t Iterations = 20;
+    static const float Distances[] = { 1.f, 10.f, 100.f };
+
+    // The current frame, read back on the GPU path so both sides encode the
+    // same depth
+    if (!DrawCpu && !GraphicsReadBackDepth(&CpuAppFrameDepth))
+    {
+        assert(false);
+        return false;
+    }
+    const CpuTexture& depth = CpuAppFrameDepth;
+    double toMB = 1.0 / (1024.0 * 1024.0);
+
+    // Warped from the default app pose to one moved sideways, with full
+    // resolution depth so every texel's encoding can show
+    XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+    XMMATRIX targetView = view * XMMatrixTranslation(-PrecisionHeadOffset, 0, 0);
+    XMMATRIX proj = SceneProjection(depth.Width / (float)depth.Height);
+    XMVECTOR det;
+    PositionWarpVSConstants rawConstants{};
+    XMStoreFloat4x4(&rawConstants.TWMatrix, XMMatrixMultiply(XMMatrixInverse(&det, view * proj), targetView * proj));
+    rawConstants.TextureSize = XMFLOAT2((float)depth.Width, (float)depth.Height);
+
+    std::string report;
+    char line[256];
+
+    sprintf_s(line, "Depth encoding of %ux%u, near %.2f far %.0f\n\n", depth.Width, depth.Height, SceneNear, SceneFar);
+    report += line;
+    sprintf_s(line, "%-8s %8s %10s %12s %12s %12s\n", "Depth", "Bytes", "Frame MB", "Step at 1", "Step at 10", "Step at 100");
+    report += line;
+    sprintf_s(line, "%-8s %8u %10.2f\n", DepthFormatName(AppFrameDepthFormat), DepthFormatBytesPerTexel(AppFrameDepthFormat),
+        (double)depth.Width * depth.Height * DepthFormatBytesPerTexel(AppFrameDepthFormat) * toMB);
+    report += line;
+    for (uint32_t e = 0; e < (uint32_t)DepthEncoding::Count; ++e)
+    {
+        DepthEncodeDesc desc = { SceneNear, SceneFar, ReversedZ, (DepthEncoding)e };
+        sprintf_s(line, "%-8s %8u %10.2f %12.6f %12.6f %12.6f\n", DepthEncodingName(desc.Encoding), 2,
+            (double)depth.Width * depth.Height * 2 * toMB, DepthEncodeStep(desc, Distances[0]),
+            DepthEncodeStep(desc, Distances[1]), DepthEncodeStep(desc, Distances[2]));
+        report += line;
+    }
+
+    sprintf_s(line, "\nms per frame, and the encoded warp against the raw one\n%-8s %10s %10s %10s %10s %10s\n",
+        "Depth", "CPU pass", "CPU warp", "GPU pass", "GPU warp", "PSNR dB");
+    report += line;
+
+    // Raw depth first, then each encoding. The warps go into scratch
+    // targets, and the profile is left to the frame.
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+    CpuRenderProfile profile = CpuProfile;
+    CpuTextureClear(&CpuFixedWarp, clearColor);
+    CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &rawConstants, &depth, &CpuAppFrame, &CpuFixedWarp, nullptr);
+
+    for (int32_t e = -1; e < (int32_t)DepthEncoding::Count; ++e)
+    {
+        bool raw = e < 0;
+        DepthEncodeDesc desc = { SceneNear, SceneFar, ReversedZ, raw ? DepthEncoding::Linear : (DepthEncoding)e };
+
+        double cpuPassMs = -1;
+        double gpuPassMs = -1;
+        PipelineStateIndex index = PipelineStateIndex::PositionalTimewarp;
+        const void* constants = &rawConstants;
+        const CpuTexture* cpuDepth = &depth;
+        ID3D11ShaderResourceView* depthSRV = AppFrameDepthSRV.Get();
+
+        EncodedPositionWarpVSConstants encodedConstants{};
+        if (!raw)
+        {
+            cpuPassMs = CpuTimeMs(Iterations, [&]() { DepthEncodeBuild(depth, desc, &CpuEncodedDepth); });
+            gpuPassMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsEncodeDepth(desc); });
+
+            encodedConstants.TWMatrix = rawConstants.TWMatrix;
+            encodedConstants.TextureSize = rawConstants.TextureSize;
+            DepthEncodeGetConstants(desc, &encodedConstants.DepthDecode);
+            encodedConstants.DepthEncoding = (uint32_t)desc.Encoding;
+            index = PipelineStateIndex::PositionalEncodedTimewarp;
+            constants = &encodedConstants;
+            cpuDepth = &CpuEncodedDepth;
+            depthSRV = EncodedDepthSRV.Get();
+        }
+
+        double cpuWarpMs = CpuTimeMs(Iterations, [&]()
+        {
+            CpuDrawPipeline(index, constants, cpuDepth, &CpuAppFrame, &CpuReference, nullptr);
+        });
+
+        CpuTextureDiff diff{};
+        CpuTextureClear(&CpuReference, clearColor);
+        CpuDrawPipeline(index, constants, cpuDepth, &CpuAppFrame, &CpuReference, nullptr);
+        CpuTextureCompare(CpuReference, CpuFixedWarp, &diff);
+
+        auto& pipeline = GetPipeline(index);
+        Context->UpdateSubresource(pipeline.VSConstantBuffer.Get(), 0, nullptr, constants, 0, 0);
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        Context->VSSetShaderResources(0, 1, &depthSRV);
+        Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
+        double gpuWarpMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsDrawPipeline(pipeline); });
+
+        char text[5][16];
+        FormatMs(cpuPassMs, text[0]);
+        FormatMs(cpuWarpMs, text[1]);
+        FormatMs(gpuPassMs, text[2]);
+        FormatMs(gpuWarpMs, text[3]);
+        strcpy_s(text[4], "-");
+        if (!raw)
+        {
+            sprintf_s(text[4], "%.1f", diff.Psnr);
+        }
+        sprintf_s(line, "%-8s %10s %10s %10s %10s %10s\n", raw ? "Raw" : DepthEncodingName(desc.Encoding),
+            text[0], text[1], text[2], text[3], text[4]);
+        report += line;
+    }
+    CpuProfile = profile;
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool GraphicsCreateBackwardWarp()
+{
+    auto& backwardWarpCS = GetShader(ShaderIndex::BackwardWarpCS);
+
+    HRESULT hr = Device->CreateComputeShader(backwardWarpCS.data(), backwardWarpCS.size(), nullptr,
+        BackwardWarpShader.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = sizeof(BackwardWarpCSConstants);
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, BackwardWarpConstantBuffer.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // The swap chain's buffers can't be written from a compute shader, so the
+    // warp lands here and is copied over
+    D3D11_TEXTURE2D_DESC td{};
+    BackBuffer->GetDesc(&td);
+    td.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    td.MiscFlags = 0;
+    hr = Device->CreateTexture2D(&td, nullptr, BackwardWarpTexture.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateUnorderedAccessView(BackwardWarpTexture.Get(), nullptr, BackwardWarpUAV.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsBackwardWarp(const XMFLOAT4X4& inverseWarp, float threshold)
+{
+    ID3D11ShaderResourceView* nullSRV[] = { nullptr, nullptr, nullptr };
+    ID3D11UnorderedAccessView* nullUAV = nullptr;
+
+    BackwardWarpCSConstants constants{};
+    constants.InverseWarp = inverseWarp;
+    constants.Size = XMUINT2(AppFramePyramid.Width, AppFramePyramid.Height);
+    constants.NumLevels = (uint32_t)AppFramePyramid.LevelUAVs.size();
+    constants.MaxIterations = BackwardWarpMaxIterations;
+    constants.StartLevel = BackwardWarpStartLevel;
+    constants.Threshold = threshold;
+    Context->UpdateSubresource(BackwardWarpConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+    // The app frame's depth is read, so it can't stay bound for writing
+    ID3D11ShaderResourceView* sources[] = { AppFrameSRV.Get(), AppFrameDepthSRV.Get(), AppFramePyramid.SRV.Get() };
+    Context->OMSetRenderTargets(0, nullptr, nullptr);
+    Context->CSSetShader(BackwardWarpShader.Get(), nullptr, 0);
+    Context->CSSetConstantBuffers(0, 1, BackwardWarpConstantBuffer.GetAddressOf());
+    Context->CSSetShaderResources(0, _countof(sources), sources);
+    Context->CSSetSamplers(0, 1, Sampler.GetAddressOf());
+    Context->CSSetUnorderedAccessViews(0, 1, BackwardWarpUAV.GetAddressOf(), nullptr);
+
+    // A thread group per hybrid mode tile
+    Context->Dispatch((constants.Size.x + BackwardWarpTileSize - 1) / BackwardWarpTileSize,
+        (constants.Size.y + BackwardWarpTileSize - 1) / BackwardWarpTileSize, 1);
+
+    Context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+    Context->CSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->CSSetShader(nullptr, nullptr, 0);
+
+    Context->CopyResource(BackBuffer.Get(), BackwardWarpTexture.Get());
+}
+
+//==============================================================================
+bool GraphicsBenchmarkBackwardWarp(const char* filename)
+{
+    static const uint32_t Iterations = 20;
+    static const float Offsets[] = { 0.02f, 0.1f, 0.3f };
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+
+    std::string report;
+    char line[256];
+
+    // The search walks standard depth
+    if (ReversedZ)
+    {
+        report = "Backward warp needs standard depth, turn reversed-Z off\n";
+        return WriteReport(report, filename);
+    }
+
+    uint32_t width = CpuAppFrame.Width;
+    uint32_t height = CpuAppFrame.Height;
+    double pixels = (double)width * height;
+    const float clearDepth[] = { 1.f, 1.f, 1.f, 1.f };
+
+    // Both app frames drawn at the default pose, each with its pyramid
+    XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+    XMMATRIX proj = SceneProjection(width / (float)height);
+    CpuViewport cpuViewport = { 0, 0, (float)width, (float)height };
+    SceneVSConstants sceneConstants{};
+    XMStoreFloat4x4(&sceneConstants.WorldViewProj, XMMatrixMultiply(view, proj));
+
+    CpuRenderProfile profile = CpuProfile;
+    CpuTextureClear(&CpuAppFrame, clearColor);
+    CpuTextureClear(&CpuAppFrameDepth, clearDepth);
+    CpuDrawPipeline(PipelineStateIndex::SceneRender, &sceneConstants, nullptr, nullptr, &CpuAppFrame, &CpuAppFrameDepth, &cpuViewport);
+    DepthFormatQuantize(AppFrameDepthFormat, &CpuAppFrameDepth);
+    DepthPyramidBuild(CpuAppFrameDepth, &CpuAppFramePyramid);
+
+    auto& scenePipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    ID3D11ShaderResourceView* nullSRV[] = { nullptr, nullptr };
+    Context->VSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->PSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->UpdateSubresource(scenePipeline.VSConstantBuffer.Get(), 0, nullptr, &sceneConstants, 0, 0);
+    Context->OMSetRenderTargets(1, AppFrameRTV.GetAddressOf(), AppFrameDSV.Get());
+    Context->ClearRenderTargetView(AppFrameRTV.Get(), clearColor);
+    Context->ClearDepthStencilView(AppFrameDSV.Get(), D3D11_CLEAR_DEPTH, 1.f, 0);
+    GraphicsDrawPipeline(scenePipeline);
+    Context->OMSetRenderTargets(0, nullptr, nullptr);
+    GraphicsBuildDepthPyramid(AppFrameDepthSRV.Get(), AppFramePyramid);
+
+    sprintf_s(line, "Backward warp of %ux%u against the fixed %ux%u grid, target moved sideways\n", width, height,
+        NumVertsWidth, NumVertsHeight);
+    report += line;
+    sprintf_s(line, "CPU on %u threads, ms per frame and Mpixels per second, PSNR against the scene drawn at the target\n\n",
+        ParallelThreadCount());
+    report += line;
+    sprintf_s(line, "%-8s %10s %8s %8s %10s %8s %10s %10s %10s %10s\n", "Offset", "CPU ms", "CPU Mpx", "Steps",
+        "GPU ms", "GPU Mpx", "Grid CPU", "Grid GPU", "PSNR", "Grid PSNR");
+    report += line;
+
+    auto& gridPipeline = GetPipeline(PipelineStateIndex::PositionalTimewarp);
+    for (float offset : Offsets)
+    {
+        XMMATRIX targetView = view * XMMatrixTranslation(-offset, 0, 0);
+        XMVECTOR det;
+        XMMATRIX warp = XMMatrixMultiply(XMMatrixInverse(&det, view * proj), targetView * proj);
+        XMFLOAT4X4 inverseWarp;
+        XMStoreFloat4x4(&inverseWarp, XMMatrixInverse(&det, warp));
+        PositionWarpVSConstants gridConstants{};
+        XMStoreFloat4x4(&gridConstants.TWMatrix, warp);
+        gridConstants.TextureSize = XMFLOAT2((float)width, (float)height);
+
+        // CPU, into scratch targets
+        BackwardWarpStats stats{};
+        double cpuMs = CpuTimeMs(Iterations, [&]()
+        {
+            BackwardWarp(CpuAppFrame, CpuAppFrameDepth, CpuAppFramePyramid, &inverseWarp.m[0][0], CpuLinearSampler,
+                nullptr, &CpuReference, &stats);
+        });
+        CpuTextureClear(&CpuFixedWarp, clearColor);
+        double cpuGridMs = CpuTimeMs(Iterations, [&]()
+        {
+            CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &gridConstants, &CpuAppFrameDepth, &CpuAppFrame, &CpuFixedWarp, nullptr);
+        });
+
+        SceneVSConstants truthConstants{};
+        XMStoreFloat4x4(&truthConstants.WorldViewProj, XMMatrixMultiply(targetView, proj));
+        CpuTextureClear(&CpuGroundTruth, clearColor);
+        CpuTextureClear(&CpuGroundTruthDepth, clearDepth);
+        CpuDrawPipeline(PipelineStateIndex::SceneRender, &truthConstants, nullptr, nullptr, &CpuGroundTruth, &CpuGroundTruthDepth, &cpuViewport);
+        CpuTextureDiff backwardDiff{};
+        CpuTextureDiff gridDiff{};
+        CpuTextureCompare(CpuReference, CpuGroundTruth, &backwardDiff);
+        CpuTextureCompare(CpuFixedWarp, CpuGroundTruth, &gridDiff);
+
+        // GPU, the backward warp including its copy to the back buffer
+        double gpuMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsBackwardWarp(inverseWarp, 0.f); });
+        Context->UpdateSubresource(gridPipeline.VSConstantBuffer.Get(), 0, nullptr, &gridConstants, 0, 0);
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        Context->VSSetShaderResources(0, 1, AppFrameDepthSRV.GetAddressOf());
+        Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
+        double gpuGridMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsDrawPipeline(gridPipeline); });
+
+        char text[4][16];
+        FormatMs(cpuMs, text[0]);
+        FormatMs(gpuMs, text[1]);
+        FormatMs(cpuGridMs, text[2]);
+        FormatMs(gpuGridMs, text[3]);
+        sprintf_s(line, "%-8.2f %10s %8.1f %8.2f %10s %8.1f %10s %10s %10.1f %10.1f\n", offset, text[0],
+            pixels / (cpuMs * 1000.0), stats.Iterations / pixels, text[1], pixels / (gpuMs * 1000.0),
+            text[2], text[3], backwardDiff.Psnr, gridDiff.Psnr);
+        report += line;
+    }
+    CpuProfile = profile;
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool GraphicsBenchmarkHybridWarp(const char* filename)
+{
+    static const uint32_t Iterations = 20;
+    static const float Offsets[] = { 0.005f, 0.02f, 0.1f };
+    static const float Thresholds[] = { 0.f, 0.25f, 0.5f, 1.f, 2.f };
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+
+    std::string report;
+    char line[256];
+
+    // The search walks standard depth
+    if (ReversedZ)
+    {
+        report = "Hybrid warp needs standard depth, turn reversed-Z off\n";
+        return WriteReport(report, filename);
+    }
+
+    uint32_t width = CpuAppFrame.Width;
+    uint32_t height = CpuAppFrame.Height;
+    double pixels = (double)width * height;
+    double tiles = (double)CpuBackwardTiles.TilesX * CpuBackwardTiles.TilesY;
+    const float clearDepth[] = { 1.f, 1.f, 1.f, 1.f };
+
+    // Both app frames drawn at the default pose, each with its pyramid
+    XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+    XMMATRIX proj = SceneProjection(width / (float)height);
+    CpuViewport cpuViewport = { 0, 0, (float)width, (float)height };
+    SceneVSConstants sceneConstants{};
+    XMStoreFloat4x4(&sceneConstants.WorldViewProj, XMMatrixMultiply(view, proj));
+
+    CpuRenderProfile profile = CpuProfile;
+    CpuTextureClear(&CpuAppFrame, clearColor);
+    CpuTextureClear(&CpuAppFrameDepth, clearDepth);
+    CpuDrawPipeline(PipelineStateIndex::SceneRender, &sceneConstants, nullptr, nullptr, &CpuAppFrame, &CpuAppFrameDepth, &cpuViewport);
+    DepthFormatQuantize(AppFrameDepthFormat, &CpuAppFrameDepth);
+    DepthPyramidBuild(CpuAppFrameDepth, &CpuAppFramePyramid);
+
+    auto& scenePipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    ID3D11ShaderResourceView* nullSRV[] = { nullptr, nullptr };
+    Context->VSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->PSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->UpdateSubresource(scenePipeline.VSConstantBuffer.Get(), 0, nullptr, &sceneConstants, 0, 0);
+    Context->OMSetRenderTargets(1, AppFrameRTV.GetAddressOf(), AppFrameDSV.Get());
+    Context->ClearRenderTargetView(AppFrameRTV.Get(), clearColor);
+    Context->ClearDepthStencilView(AppFrameDSV.Get(), D3D11_CLEAR_DEPTH, 1.f, 0);
+    GraphicsDrawPipeline(scenePipeline);
+    Context->OMSetRenderTargets(0, nullptr, nullptr);
+    GraphicsBuildDepthPyramid(AppFrameDepthSRV.Get(), AppFramePyramid);
+
+    sprintf_s(line, "Hybrid warp of %ux%u in %ux%u tiles, target moved sideways\n", width, height,
+        BackwardWarpTileSize, BackwardWarpTileSize);
+    report += line;
+    sprintf_s(line, "Threshold in pixels of parallax, \"all\" searches every tile. CPU on %u threads, warp ms excludes classify.\n",
+        ParallelThreadCount());
+    report += line;
+    report += "PSNR against the scene drawn at the target\n\n";
+    sprintf_s(line, "%-8s %10s %10s %10s %8s %10s %10s %10s %8s\n", "Offset", "Threshold", "Searched", "Pixels",
+        "Steps", "Classify", "CPU ms", "GPU ms", "PSNR");
+    report += line;
+
+    XMFLOAT4X4 mapWarp{};
+    for (float offset : Offsets)
+    {
+        XMMATRIX targetView = view * XMMatrixTranslation(-offset, 0, 0);
+        XMVECTOR det;
+        XMMATRIX warp = XMMatrixMultiply(XMMatrixInverse(&det, view * proj), targetView * proj);
+        XMFLOAT4X4 inverseWarp;
+        XMStoreFloat4x4(&inverseWarp, XMMatrixInverse(&det, warp));
+        if (offset == Offsets[1])
+        {
+            mapWarp = inverseWarp;
+        }
+
+        SceneVSConstants truthConstants{};
+        XMStoreFloat4x4(&truthConstants.WorldViewProj, XMMatrixMultiply(targetView, proj));
+        CpuTextureClear(&CpuGroundTruth, clearColor);
+        CpuTextureClear(&CpuGroundTruthDepth, clearDepth);
+        CpuDrawPipeline(PipelineStateIndex::SceneRender, &truthConstants, nullptr, nullptr, &CpuGroundTruth, &CpuGroundTruthDepth, &cpuViewport);
+
+        for (float threshold : Thresholds)
+        {
+            // CPU, into a scratch target
+            bool hybrid = threshold > 0.f;
+            double classifyMs = hybrid ? CpuTimeMs(Iterations, [&]()
+            {
+                BackwardWarpClassify(CpuAppFramePyramid, &inverseWarp.m[0][0], threshold, &CpuBackwardTiles);
+            }) : -1.0;
+            BackwardWarpStats stats{};
+            double cpuMs = CpuTimeMs(Iterations, [&]()
+            {
+                BackwardWarp(CpuAppFrame, CpuAppFrameDepth, CpuAppFramePyramid, &inverseWarp.m[0][0], CpuLinearSampler,
+                    hybrid ? &CpuBackwardTiles : nullptr, &CpuReference, &stats);
+            });
+            CpuTextureDiff diff{};
+            CpuTextureCompare(CpuReference, CpuGroundTruth, &diff);
+
+            // GPU, classifying in the same dispatch, and including the copy
+            double gpuMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsBackwardWarp(inverseWarp, threshold); });
+
+            char thresholdText[16];
+            if (hybrid)
+            {
+                sprintf_s(thresholdText, "%.2f", threshold);
+            }
+            else
+            {
+                strcpy_s(thresholdText, "all");
+            }
+            char text[3][16];
+            FormatMs(classifyMs, text[0]);
+            FormatMs(cpuMs, text[1]);
+            FormatMs(gpuMs, text[2]);
+            double searchedTiles = hybrid ? CpuBackwardTiles.NumPositional / tiles : 1.0;
+            double searchedPixels = (pixels - stats.Rotational) / pixels;
+            sprintf_s(line, "%-8.3f %10s %9.1f%% %9.1f%% %8.2f %10s %10s %10s %8.1f\n", offset, thresholdText,
+                searchedTiles * 100.0, searchedPixels * 100.0, stats.Iterations / pixels, text[0], text[1], text[2], diff.Psnr);
+            report += line;
+        }
+    }
+    CpuProfile = profile;
+
+    // Where the classifier sends the search, a character per tile
+    BackwardWarpClassify(CpuAppFramePyramid, &mapWarp.m[0][0], HybridParallaxThreshold, &CpuBackwardTiles);
+    sprintf_s(line, "\nTiles at offset %.3f and threshold %.2f, # searched, . rotational\n", Offsets[1], HybridParallaxThreshold);
+    report += line;
+    for (uint32_t ty = 0; ty < CpuBackwardTiles.TilesY; ++ty)
+    {
+        for (uint32_t tx = 0; tx < CpuBackwardTiles.TilesX; ++tx)
+        {
+            report += (CpuBackwardTiles.Parallax[ty * CpuBackwardTiles.TilesX + tx] > HybridParallaxThreshold) ? '#' : '.';
+        }
+        report += '\n';
+    }
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool GraphicsCreateFrameDepth(uint32_t width, uint32_t height, DepthFormat format)
+{
+    AppFrameDepthSRV = nullptr;
+    AppFrameDSV = nullptr;
+    AppFrameDepthStaging = nullptr;
+    AppFrameDepth = nullptr;
+
+    const GpuDepthFormat& formats = GpuDepthFormats[(uint32_t)format];
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = width;
+    td.Height = height;
+    td.MipLevels = 1;
+    td.ArraySize = 1;
+    td.Format = formats.Texture;
+    td.SampleDesc.Count = 1;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
+
+    HRESULT hr = Device->CreateTexture2D(&td, nullptr, &AppFrameDepth);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_DEPTH_STENCIL_VIEW_DESC dsvd{};
+    dsvd.Format = formats.DepthStencil;
+    dsvd.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+    hr = Device->CreateDepthStencilView(AppFrameDepth.Get(), &dsvd, &AppFrameDSV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd{};
+    srvd.Format = formats.ShaderResource;
+    srvd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srvd.Texture2D.MipLevels = 1;
+    hr = Device->CreateShaderResourceView(AppFrameDepth.Get(), &srvd, &AppFrameDepthSRV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Read back for the benchmarks, which compare the CPU path on the same depth
+    td.BindFlags = 0;
+    td.Usage = D3D11_USAGE_STAGING;
+    td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    hr = Device->CreateTexture2D(&td, nullptr, &AppFrameDepthStaging);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsReadBackDepth(CpuTexture* depth)
+{
+    // Waits for the GPU to finish writing the depth
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    Context->CopyResource(AppFrameDepthStaging.Get(), AppFrameDepth.Get());
+    HRESULT hr = Context->Map(AppFrameDepthStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    DepthFormatDecode(AppFrameDepthFormat, (const uint8_t*)mapped.pData, mapped.RowPitch, depth);
+    Context->Unmap(AppFrameDepthStaging.Get(), 0);
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateFrameLayer(const D3D11_TEXTURE2D_DESC& colorDesc, GpuFrameLayer* layer)
+{
+    *layer = GpuFrameLayer();
+
+    D3D11_TEXTURE2D_DESC td = colorDesc;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+
+    HRESULT hr = Device->CreateTexture2D(&td, nullptr, &layer->Color);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateRenderTargetView(layer->Color.Get(), nullptr, &layer->RTV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateShaderResourceView(layer->Color.Get(), nullptr, &layer->SRV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Float depth, which the layered warp also requires of the first layer
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
+    td.Format = DXGI_FORMAT_R32_TYPELESS;
+
+    hr = Device->CreateTexture2D(&td, nullptr, &layer->Depth);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_DEPTH_STENCIL_VIEW_DESC dsvd{};
+    dsvd.Format = DXGI_FORMAT_D32_FLOAT;
+    dsvd.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+    hr = Device->CreateDepthStencilView(layer->Depth.Get(), &dsvd, &layer->DSV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd{};
+    srvd.Format = DXGI_FORMAT_R32_FLOAT;
+    srvd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srvd.Texture2D.MipLevels = 1;
+    hr = Device->CreateShaderResourceView(layer->Depth.Get(), &srvd, &layer->DepthSRV);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsBenchmarkLayers(const char* filename)
+{
+    static const uint32_t Iterations = 20;
+    static const double RefreshRate = 90;
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+    float farDepth = SceneFarDepth();
+    const float clearDepth[] = { farDepth, farDepth, farDepth, farDepth };
+
+    uint32_t width = CpuAppFrame.Width;
+    uint32_t height = CpuAppFrame.Height;
+    double pixels = (double)width * height;
+    double toMB = 1.0 / (1024.0 * 1024.0);
+
+    // RGBA8 color and 32 bit depth per layer
+    double layerMB = pixels * (4 + 4) * toMB;
+
+    // Estimated traffic, touching each texture once per pixel per pass, with
+    // no overdraw or compression. The scene writes color and depth, and the
+    // warp samples color. The peel also reads the first layer's depth, and
+    // the layered warp draws both layers again reading color and depth.
+    double sceneMB = pixels * (4 + 4) * toMB;
+    double peelMB = pixels * (4 + 4 + 4) * toMB;
+    double warpMB = pixels * 4 * toMB;
+    double layeredWarpMB = warpMB + 2 * pixels * (4 + 4) * toMB;
+    double singleMB = sceneMB + warpMB;
+    double layeredMB = sceneMB + peelMB + layeredWarpMB;
+
+    // Timed at the default app pose, with no warp
+    XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+    XMMATRIX proj = SceneProjection(width / (float)height);
+    SceneVSConstants sceneConstants{};
+    XMStoreFloat4x4(&sceneConstants.WorldViewProj, XMMatrixMultiply(view, proj));
+    PositionWarpVSConstants warpConstants{};
+    XMStoreFloat4x4(&warpConstants.TWMatrix, XMMatrixIdentity());
+    warpConstants.TextureSize = XMFLOAT2((float)width, (float)height);
+
+    // CPU, into the frame's own targets before they're cleared, leaving the
+    // profile to the frame
+    CpuRenderProfile profile = CpuProfile;
+    double cpuSceneMs = CpuTimeMs(Iterations, [&]()
+    {
+        CpuTextureClear(&CpuAppFrame, clearColor);
+        CpuTextureClear(&CpuAppFrameDepth, clearDepth);
+        CpuDrawPipeline(PipelineStateIndex::SceneRender, &sceneConstants, nullptr, nullptr, &CpuAppFrame, &CpuAppFrameDepth);
+    });
+    double cpuPeelMs = CpuTimeMs(Iterations, [&]() { CpuDrawBackLayer(sceneConstants, nullptr); });
+    double cpuWarpMs = CpuTimeMs(Iterations, [&]()
+    {
+        CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &warpConstants, &CpuAppFrameDepth, &CpuAppFrame, &CpuFixedWarp, nullptr);
+    });
+    double cpuLayeredWarpMs = CpuTimeMs(Iterations, [&]()
+    {
+        CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &warpConstants, &CpuAppFrameDepth, &CpuAppFrame, &CpuFixedWarp, nullptr);
+        CpuDrawLayers(warpConstants, &CpuFixedWarp);
+    });
+    CpuProfile = profile;
+
+    // GPU
+    auto& scenePipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    auto& warpPipeline = GetPipeline(PipelineStateIndex::PositionalTimewarp);
+    ID3D11ShaderResourceView* nullSRV[] = { nullptr, nullptr };
+    Context->VSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->PSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->UpdateSubresource(scenePipeline.VSConstantBuffer.Get(), 0, nullptr, &sceneConstants, 0, 0);
+    Context->OMSetRenderTargets(1, AppFrameRTV.GetAddressOf(), AppFrameDSV.Get());
+    double gpuSceneMs = GraphicsTimeGpuMs(Iterations, [&]()
+    {
+        Context->ClearRenderTargetView(AppFrameRTV.Get(), clearColor);
+        Context->ClearDepthStencilView(AppFrameDSV.Get(), D3D11_CLEAR_DEPTH, farDepth, 0);
+        GraphicsDrawPipeline(scenePipeline);
+    });
+    double gpuPeelMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsDrawBackLayer(); });
+
+    auto drawWarp = [&]()
+    {
+        Context->VSSetShaderResources(0, 1, AppFrameDepthSRV.GetAddressOf());
+        Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
+        GraphicsDrawPipeline(warpPipeline);
+    };
+    Context->UpdateSubresource(warpPipeline.VSConstantBuffer.Get(), 0, nullptr, &warpConstants, 0, 0);
+    Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+    double gpuWarpMs = GraphicsTimeGpuMs(Iterations, drawWarp);
+    double gpuLayeredWarpMs = GraphicsTimeGpuMs(Iterations, [&]()
+    {
+        drawWarp();
+        GraphicsDrawLayers(warpConstants);
+    });
+    Context->VSSetShaderResources(0, _countof(nullSRV), nullSRV);
+    Context->PSSetShaderResources(0, _countof(nullSRV), nullSRV);
+
+    std::string report;
+    char line[256];
+    char text[2][16];
+
+    sprintf_s(line, "Two-layer app frame at %ux%u\n\n", width, height);
+    report += line;
+    sprintf_s(line, "%-28s %12s %12s\n", "", "1 layer", "2 layers");
+    report += line;
+    sprintf_s(line, "%-28s %12.1f %12.1f\n", "Storage, MB", layerMB, 2 * layerMB);
+    report += line;
+    sprintf_s(line, "%-28s %12.1f %12.1f\n", "Traffic per frame, MB", singleMB, layeredMB);
+    report += line;
+    sprintf_s(line, "%-28s %12.2f %12.2f\n", "Traffic at 90 Hz, GB/s", singleMB * RefreshRate / 1024.0, layeredMB * RefreshRate / 1024.0);
+    report += line;
+
+    sprintf_s(line, "\nTraffic per pass, MB: scene %.1f, peel %.1f, warp %.1f, layered warp %.1f\n\n",
+        sceneMB, peelMB, warpMB, layeredWarpMB);
+    report += line;
+
+    sprintf_s(line, "%-28s %12s %12s\n", "ms per frame", "CPU", "GPU");
+    report += line;
+    const char* names[] = { "Scene", "Peel", "Warp, 1 layer", "Warp, 2 layers" };
+    double cpuMs[] = { cpuSceneMs, cpuPeelMs, cpuWarpMs, cpuLayeredWarpMs };
+    double gpuMs[] = { gpuSceneMs, gpuPeelMs, gpuWarpMs, gpuLayeredWarpMs };
+    for (uint32_t i = 0; i < _countof(names); ++i)
+    {
+        FormatMs(cpuMs[i], text[0]);
+        FormatMs(gpuMs[i], text[1]);
+        sprintf_s(line, "%-28s %12s %12s\n", names[i], text[0], text[1]);
+        report += line;
+    }
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool GraphicsBeginImageUpload(void*, uint32_t width, uint32_t height, uint32_t numLevels, CpuFormat format,
+    TextureLoadTarget* target)
+{
+    // A worker decodes a row at a time straight into the mapped staging
+    // texture and filters its mips there, or writes blocks there. Every level
+    // stays mapped until GraphicsEndImageUpload.
+    DXGI_FORMAT dxgiFormat;
+    switch (format)
+    {
+    case CpuFormat::R8G8B8A8Unorm: dxgiFormat = DXGI_FORMAT_R8G8B8A8_UNORM; break;
+    case CpuFormat::BC1Unorm: dxgiFormat = DXGI_FORMAT_BC1_UNORM; break;
+    case CpuFormat::BC3Unorm: dxgiFormat = DXGI_FORMAT_BC3_UNORM; break;
+    case CpuFormat::BC7Unorm: dxgiFormat = DXGI_FORMAT_BC7_UNORM; break;
+    default:
+        assert(false);
+        return false;
+    }
+
+    // Block compressed textures must be a whole number of blocks
+    if (CpuFormatIsBlockCompressed(format) && (width % 4 != 0 || height % 4 != 0))
+    {
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC sd{};
+    sd.ArraySize = 1;
+    sd.Format = dxgiFormat;
+    sd.Width = width;
+    sd.Height = height;
+    sd.MipLevels = numLevels;
+    sd.SampleDesc.Count = 1;
+    sd.Usage = D3D11_USAGE_STAGING;
+    sd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ComPtr<ID3D11Texture2D> staging;
+    HRESULT hr = Device->CreateTexture2D(&sd, nullptr, &staging);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped{};
+        hr = Context->Map(staging.Get(), level, D3D11_MAP_WRITE, 0, &mapped);
+        if (FAILED(hr))
+        {
+            assert(false);
+            for (uint32_t mappedLevel = 0; mappedLevel < level; ++mappedLevel)
+            {
+                Context->Unmap(staging.Get(), mappedLevel);
+            }
+            return false;
+        }
+
+        target->Data[level] = (uint8_t*)mapped.pData;
+        target->RowPitch[level] = mapped.RowPitch;
+    }
+    target->Resource = staging.Detach();
+    return true;
+}
+
+//==============================================================================
+void* GraphicsEndImageUpload(void*, const TextureLoadTarget& target, bool decoded)
+{
+    ComPtr<ID3D11Texture2D> staging;
+    staging.Attach((ID3D11Texture2D*)target.Resource);
+
+    D3D11_TEXTURE2D_DESC td;
+    staging->GetDesc(&td);
+    for (uint32_t level = 0; level < td.MipLevels; ++level)
+    {
+        Context->Unmap(staging.Get(), level);
+    }
+    if (!decoded)
+    {
+        return nullptr;
+    }
+
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    td.Usage = D3D11_USAGE_DEFAULT;
+    td.CPUAccessFlags = 0;
+
+    ComPtr<ID3D11Texture2D> texture;
+    HRESULT hr = Device->CreateTexture2D(&td, nullptr, &texture);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return nullptr;
+    }
+
+    Context->CopyResource(texture.Get(), staging.Get());
+
+    // The view holds the texture, and its reference goes to the callback
+    ID3D11ShaderResourceView* srv = nullptr;
+    hr = Device->CreateShaderResourceView(texture.Get(), nullptr, &srv);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return nullptr;
+    }
+
+    return srv;
+}
+
+//==============================================================================
+bool GraphicsLoadImage(const char* filename, ID3D11ShaderResourceView** srv)
+{
+    // Waits for this one image. Anything that can carry on without it calls
+    // TextureLoaderRequest with a callback instead.
+    auto loaded = [](TextureLoadHandle, void* resource, void* context)
+    {
+        *(ID3D11ShaderResourceView**)context = (ID3D11ShaderResourceView*)resource;
+    };
+
+    *srv = nullptr;
+    TextureLoadHandle handle = TextureLoaderRequest(&ImageLoader, filename, loaded, srv);
+    TextureLoaderFlush(&ImageLoader, handle);
+    if (!*srv)
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateTextureFromFile(const TextureFile& file, ID3D11ShaderResourceView** srv)
+{
+    // The runtime copies the initial data out of the mapping itself, so that
+    // is the only copy
+    const TextureFileHeader& header = *file.Header;
+    uint32_t numSubresources = header.NumLevels * header.ArraySize;
+    std::vector<D3D11_SUBRESOURCE_DATA> initialData(numSubresources);
+    for (uint32_t i = 0; i < numSubresources; ++i)
+    {
+        const TextureFileSubresource& sub = file.Subresources[i];
+        initialData[i].pSysMem = file.Data + sub.Offset;
+        initialData[i].SysMemPitch = sub.RowPitch;
+        initialData[i].SysMemSlicePitch = sub.RowPitch * sub.NumRows;
+    }
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = header.Width;
+    td.Height = header.Height;
+    td.MipLevels = header.NumLevels;
+    td.ArraySize = header.ArraySize;
+    td.Format = (DXGI_FORMAT)header.DxgiFormat;
+    td.SampleDesc.Count = 1;
+    td.Usage = D3D11_USAGE_IMMUTABLE;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    ComPtr<ID3D11Texture2D> texture;
+    HRESULT hr = Device->CreateTexture2D(&td, initialData.data(), &texture);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateShaderResourceView(texture.Get(), nullptr, srv);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateTextureFromLevels(const CpuTexture* levels, uint32_t numLevels, ID3D11ShaderResourceView** srv)
+{
+    D3D11_SUBRESOURCE_DATA initialData[MipMaxLevels]{};
+    for (uint32_t level = 0; level < numLevels; ++level)
+    {
+        initialData[level].pSysMem = levels[level].Data;
+        initialData[level].SysMemPitch = levels[level].RowPitch;
+        initialData[level].SysMemSlicePitch = levels[level].RowPitch * levels[level].Height;
+    }
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = levels[0].Width;
+    td.Height = levels[0].Height;
+    td.MipLevels = numLevels;
+    td.ArraySize = 1;
+    td.Format = (DXGI_FORMAT)TextureFileDxgiFormat(levels[0].Format);
+    td.SampleDesc.Count = 1;
+    td.Usage = D3D11_USAGE_IMMUTABLE;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    ComPtr<ID3D11Texture2D> texture;
+    HRESULT hr = Device->CreateTexture2D(&td, initialData, &texture);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreateShaderResourceView(texture.Get(), nullptr, srv);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool GraphicsLoadTextureFile(const char* filename, ID3D11ShaderResourceView** srv)
+{
+    TextureFile file;
+    if (!TextureFileOpen(filename, &file))
+    {
+        return false;
+    }
+
+    bool result = GraphicsCreateTextureFromFile(file, srv);
+    TextureFileClose(&file);
+    return result;
+}
+
+//==============================================================================
+// Drops a file's pages from the system file cache, so the next read comes
+// from the disk. Opening it unbuffered makes the cache manager flush and purge
+// it, as long as nothing else has it open or mapped.
+static void EvictFileCache(const char* filename)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING,
+        nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+    }
+}
+
+//==============================================================================
+bool GraphicsBenchmarkTextureFile(const char* filename)
+{
+    static const uint32_t TextureSize = 2048;
+    static const uint32_t ColdIterations = 3;
+    static const uint32_t WarmIterations = 10;
+    static const CpuFormat Formats[] = { CpuFormat::R8G8B8A8Unorm, CpuFormat::BC7Unorm };
+    static const char* DdsFilename = "TextureFileBenchmark.dds";
+    static const char* ContainerFilename = "TextureFileBenchmark.wtex";
+
+    // A full chain of something to compress, in both files
+    CpuMipChain chain;
+    uint32_t numLevels = MipLevelCount(TextureSize, TextureSize);
+    if (!CpuMipChainCreate(TextureSize, TextureSize, numLevels, CpuFormat::R8G8B8A8Unorm, &chain))
+    {
+        assert(false);
+        return false;
+    }
+    CpuTexture& top = chain.Levels[0];
+    ParallelFor(TextureSize, 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            uint8_t* row = top.Data + (size_t)y * top.RowPitch;
+            for (uint32_t x = 0; x < TextureSize; ++x)
+            {
+                row[x * 4 + 0] = (uint8_t)(x / 8);
+                row[x * 4 + 1] = (uint8_t)(y / 8);
+                row[x * 4 + 2] = (uint8_t)((x ^ y) & 0xc0);
+                row[x * 4 + 3] = 255;
+            }
+        }
+    });
+    MipChainGenerate(MipFilter::Box, chain.Levels, numLevels);
+
+    std::string report;
+    char line[256];
+    char text[4][16];
+    sprintf_s(line, "Loading a %ux%u texture with %u mips\n", TextureSize, TextureSize, numLevels);
+    report += line;
+    report += "CPU is until the CPU sampler can read every texel, D3D until an immutable texture holds them.\n"
+        "Cold first purges the file from the system file cache.\n\n";
+    sprintf_s(line, "%-10s %-14s %8s %12s %12s %12s %12s\n", "Format", "Path", "MB", "Cold CPU ms", "Warm CPU ms",
+        "Cold D3D ms", "Warm D3D ms");
+    report += line;
+
+    bool result = true;
+    for (CpuFormat format : Formats)
+    {
+        CpuMipChain compressed{};
+        const CpuTexture* levels = chain.Levels;
+        if (CpuFormatIsBlockCompressed(format))
+        {
+            result = CpuMipChainCreate(TextureSize, TextureSize, numLevels, format, &compressed);
+            for (uint32_t level = 0; level < numLevels && result; ++level)
+            {
+                result = BlockCompress(chain.Levels[level], &compressed.Levels[level]);
+            }
+            levels = compressed.Levels;
+        }
+        result = result && ImageFileWriteDds(DdsFilename, levels, numLevels) &&
+            TextureFileWrite(ContainerFilename, levels, numLevels, 1);
+        CpuMipChainDestroy(&compressed);
+        if (!result)
+        {
+            assert(false);
+            break;
+        }
+        uint64_t bytes = 0;
+        for (uint32_t level = 0; level < numLevels; ++level)
+        {
+            bytes += CpuFormatImageBytes(format, MipLevelSize(TextureSize, level), MipLevelSize(TextureSize, level));
+        }
+
+        // Streams the DDS through ImageFile into textures of its own, then
+        // hands those to D3D11
+        auto loadDds = [&](bool gpu)
+        {
+            ImageFile image;
+            CpuMipChain loaded;
+            if (!ImageFileOpen(DdsFilename, &image) ||
+                !CpuMipChainCreate(TextureSize, TextureSize, image.Info.NumLevels, image.Info.PixelFormat, &loaded))
+            {
+                assert(false);
+                ImageFileClose(&image);
+                return;
+            }
+            for (uint32_t level = 0; level < loaded.NumLevels; ++level)
+            {
+                ImageFileRead(&image, loaded.Levels[level].Data, loaded.Levels[level].RowPitch);
+            }
+            ImageFileClose(&image);
+
+            if (gpu)
+            {
+                D3D11_SUBRESOURCE_DATA initialData[MipMaxLevels] = {};
+                for (uint32_t level = 0; level < loaded.NumLevels; ++level)
+                {
+                    initialData[level].pSysMem = loaded.Levels[level].Data;
+                    initialData[level].SysMemPitch = loaded.Levels[level].RowPitch;
+                }
+                D3D11_TEXTURE2D_DESC td{};
+                td.Width = TextureSize;
+                td.Height = TextureSize;
+                td.MipLevels = loaded.NumLevels;
+                td.ArraySize = 1;
+                td.Format = (DXGI_FORMAT)TextureFileDxgiFormat(format);
+                td.SampleDesc.Count = 1;
+                td.Usage = D3D11_USAGE_IMMUTABLE;
+                td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+                ComPtr<ID3D11Texture2D> texture;
+                HRESULT hr = Device->CreateTexture2D(&td, initialData, &texture);
+                assert(SUCCEEDED(hr));
+                (void)hr;
+            }
+            CpuMipChainDestroy(&loaded);
+        };
+
+        // Maps the container. For the CPU the pages still have to come in,
+        // so it touches one byte of each.
+        auto loadContainer = [&](bool gpu)
+        {
+            TextureFile file;
+            if (!TextureFileOpen(ContainerFilename, &file))
+            {
+                assert(false);
+                return;
+            }
+            if (gpu)
+            {
+                ComPtr<ID3D11ShaderResourceView> srv;
+                GraphicsCreateTextureFromFile(file, &srv);
+            }
+            else
+            {
+                volatile uint8_t sum = 0;
+                for (size_t offset = 0; offset < file.Size; offset += 4096)
+                {
+                    sum += file.Data[offset];
+                }
+            }
+            TextureFileClose(&file);
+        };
+
+        const char* paths[] = { "DDS read", "Mapped WTEX" };
+        const char* files[] = { DdsFilename, ContainerFilename };
+        for (uint32_t path = 0; path < _countof(paths); ++path)
+        {
+            auto load = [&](bool gpu)
+            {
+                if (path == 0)
+                {
+                    loadDds(gpu);
+                }
+                else
+                {
+                    loadContainer(gpu);
+                }
+            };
+            for (uint32_t gpu = 0; gpu < 2; ++gpu)
+            {
+                double coldMs = 0;
+                for (uint32_t i = 0; i < ColdIterations; ++i)
+                {
+                    EvictFileCache(files[path]);
+                    coldMs += CpuTimeMs(1, [&]() { load(gpu != 0); }) / ColdIterations;
+                }
+                double warmMs = CpuTimeMs(WarmIterations, [&]() { load(gpu != 0); });
+                FormatMs(coldMs, text[gpu * 2]);
+                FormatMs(warmMs, text[gpu * 2 + 1]);
+            }
+            sprintf_s(line, "%-10s %-14s %8.1f %12s %12s %12s %12s\n", CpuFormatName(format), paths[path], bytes / (1024.0 * 1024.0),
+                text[0], text[1], text[2], text[3]);
+            report += line;
+        }
+    }
+
+    CpuMipChainDestroy(&chain);
+    DeleteFileA(DdsFilename);
+    DeleteFileA(ContainerFilename);
+    return result && WriteReport(report, filename);
+}
+
+//==============================================================================
+bool ReportDepthPrecision(const char* filename)
+{
+    // View distance ranges, each 4x the last, up to the far plane
+    static const float FirstDistance = 0.25f;
+    static const float RangeScale = 4.f;
+
+    uint32_t width = CpuAppFrame.Width;
+    uint32_t height = CpuAppFrame.Height;
+    double toMB = 1.0 / (1024.0 * 1024.0);
+
+    std::string report;
+    char line[256];
+
+    sprintf_s(line, "Depth precision, near %.2f far %.0f, %ux%u at %.0f degrees vertical\n",
+        SceneNear, SceneFar, width, height, SceneFovY);
+    report += line;
+    sprintf_s(line, "Reprojected to a view moved %.3f sideways, through the float warp matrix\n\n", PrecisionHeadOffset);
+    report += line;
+
+    // What each format costs every pass that reads the whole depth buffer
+    sprintf_s(line, "%-8s %8s %12s\n", "Format", "Bytes", "Frame MB");
+    report += line;
+    for (uint32_t f = 0; f < (uint32_t)DepthFormat::Count; ++f)
+    {
+        DepthFormat format = (DepthFormat)f;
+        sprintf_s(line, "%-8s %8u %12.2f\n", DepthFormatName(format), DepthFormatBytesPerTexel(format),
+            (double)width * height * DepthFormatBytesPerTexel(format) * toMB);
+        report += line;
+    }
+
+    for (uint32_t reversed = 0; reversed < 2; ++reversed)
+    {
+        DepthPrecisionDesc desc{};
+        desc.Near = SceneNear;
+        desc.Far = SceneFar;
+        desc.FovY = XMConvertToRadians(SceneFovY);
+        desc.Width = width;
+        desc.Height = height;
+        desc.HeadOffset = PrecisionHeadOffset;
+        desc.ReversedZ = reversed != 0;
+
+        for (uint32_t f = 0; f < (uint32_t)DepthFormat::Count; ++f)
+        {
+            DepthFormat format = (DepthFormat)f;
+            sprintf_s(line, "\n%s %s\n", DepthFormatName(format), reversed ? "reversed-Z" : "standard");
+            report += line;
+            sprintf_s(line, "%-18s %14s %14s %14s\n", "Distance", "Depth error %", "Mean pixels", "Max pixels");
+            report += line;
+
+            for (float distance = FirstDistance; distance < SceneFar; distance *= RangeScale)
+            {
+                float end = (distance * RangeScale < SceneFar) ? distance * RangeScale : SceneFar;
+                DepthPrecision precision;
+                DepthPrecisionMeasure(desc, format, distance, end, &precision);
+
+                char range[32];
+                sprintf_s(range, "%.2f - %.2f", distance, end);
+                sprintf_s(line, "%-18s %14.5f %14.6f %14.6f\n", range, precision.MaxDepthError * 100.0,
+                    precision.MeanPixelError, precision.MaxPixelError);
+                report += line;
+            }
+        }
+    }
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+void GraphicsDrawPipeline(const PipelineState& pipeline)
+{
+    Context->IASetVertexBuffers(0, 1, pipeline.VertexBuffer.GetAddressOf(), &pipeline.Stride, &pipeline.Offset);
+    Context->IASetIndexBuffer(pipeline.IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+    Context->IASetInputLayout(pipeline.InputLayout.Get());
+    Context->VSSetShader(pipeline.VertexShader.Get(), nullptr, 0);
+    Context->VSSetConstantBuffers(0, 1, pipeline.VSConstantBuffer.GetAddressOf());
+    Context->PSSetShader(pipeline.PixelShader.Get(), nullptr, 0);
+    Context->PSSetConstantBuffers(0, 1, pipeline.PSConstantBuffer.GetAddressOf());
+    if (pipeline.NumInstances > 1)
+    {
+        Context->DrawIndexedInstanced(pipeline.NumIndices, pipeline.NumInstances, 0, 0, 0);
+    }
+    else
+    {
+        Context->DrawIndexed(pipeline.NumIndices, 0, 0);
+    }
+}
+
+//==============================================================================
+void GraphicsDrawBackLayer()
+{
+    // Peeled from behind the first layer, with the scene constants already set
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+    Context->ClearRenderTargetView(AppFrameBackLayer.RTV.Get(), clearColor);
+    Context->ClearDepthStencilView(AppFrameBackLayer.DSV.Get(), D3D11_CLEAR_DEPTH, SceneFarDepth(), 0);
+    Context->OMSetRenderTargets(1, AppFrameBackLayer.RTV.GetAddressOf(), AppFrameBackLayer.DSV.Get());
+    Context->PSSetShaderResources(0, 1, AppFrameDepthSRV.GetAddressOf());
+    GraphicsDrawPipeline(GetPipeline(PipelineStateIndex::ScenePeelRender));
+
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    Context->PSSetShaderResources(0, 1, &nullSRV);
+}
+
+//==============================================================================
+void GraphicsDrawLayers(const PositionWarpVSConstants& constants)
+{
+    // Back layer, then the front layer again, each without its stretched
+    // triangles. Whatever both leave out keeps the plain warp drawn before.
+    auto& pipeline = GetPipeline(PipelineStateIndex::PositionalLayeredTimewarp);
+    Context->UpdateSubresource(pipeline.VSConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+    ID3D11ShaderResourceView* layers[2][2] = {
+        { AppFrameBackLayer.SRV.Get(), AppFrameBackLayer.DepthSRV.Get() },
+        { AppFrameSRV.Get(), AppFrameDepthSRV.Get() },
+    };
+    for (auto& layer : layers)
+    {
+        Context->VSSetShaderResources(0, 1, &layer[1]);
+        Context->PSSetShaderResources(0, _countof(layer), layer);
+        GraphicsDrawPipeline(pipeline);
+    }
+}
+
+//==============================================================================
+bool CpuBenchmarkMipChain(const char* filename)
+{
+    static const uint32_t TextureSize = 4096;
+    static const uint32_t ViewSize = 512;
+    static const uint32_t GenerateIterations = 3;
+    static const uint32_t SampleIterations = 10;
+    static const uint32_t Scales[] = { 1, 2, 4, 8 };
+    static const MipFilter Filters[] = { MipFilter::Box, MipFilter::Kaiser };
+
+    // A zone plate, whose frequency climbs to 0.35 cycles per texel at the
+    // corners, so any undersampling shows as moire. Texels hold it in sRGB.
+    auto zonePlate = [](float x, float y)
+    {
+        float dx = x - TextureSize * 0.5f;
+        float dy = y - TextureSize * 0.5f;
+        return 0.5f + 0.5f * cosf(3.14159265f * (dx * dx + dy * dy) / (2.f * TextureSize));
+    };
+    auto toSrgb = [](float c)
+    {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+    };
+
+    CpuMipChain chain;
+    CpuTexture view;
+    CpuTexture reference;
+    uint32_t numLevels = MipLevelCount(TextureSize, TextureSize);
+    if (!CpuMipChainCreate(TextureSize, TextureSize, numLevels, CpuFormat::R8G8B8A8Unorm, &chain))
+    {
+        assert(false);
+        return false;
+    }
+    if (!CpuTextureCreate(ViewSize, ViewSize, CpuFormat::R8G8B8A8Unorm, &view) ||
+        !CpuTextureCreate(ViewSize, ViewSize, CpuFormat::R8G8B8A8Unorm, &reference))
+    {
+        assert(false);
+        CpuMipChainDestroy(&chain);
+        CpuTextureDestroy(&view);
+        return false;
+    }
+
+    CpuTexture& top = chain.Levels[0];
+    ParallelFor(TextureSize, 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            uint8_t* row = top.Data + (size_t)y * top.RowPitch;
+            for (uint32_t x = 0; x < TextureSize; ++x)
+            {
+                uint8_t value = (uint8_t)(toSrgb(zonePlate(x + 0.5f, y + 0.5f)) * 255.f + 0.5f);
+                row[x * 4 + 0] = row[x * 4 + 1] = row[x * 4 + 2] = value;
+                row[x * 4 + 3] = 255;
+            }
+        }
+    });
+
+    std::string report;
+    char line[256];
+    char text[6][16];
+    double toMpx = (double)TextureSize * TextureSize / 1000.0;
+
+    sprintf_s(line, "Mip chain generation for %ux%u, %u levels, on one thread\n%-8s %10s %10s\n",
+        TextureSize, TextureSize, numLevels, "Filter", "ms", "Mpx/s");
+    report += line;
+    for (MipFilter filter : Filters)
+    {
+        double ms = CpuTimeMs(GenerateIterations, [&]() { MipChainGenerate(filter, chain.Levels, numLevels); });
+        sprintf_s(line, "%-8s %10.2f %10.1f\n", MipFilterName(filter), ms, toMpx / ms);
+        report += line;
+    }
+
+    // A view of the middle of the zone plate, 'scale' texels to a pixel, from
+    // level 0 alone and from each chain. The reference averages the zone plate
+    // over each pixel's footprint in linear light, which is what Box aims at,
+    // so Kaiser gives up some PSNR for its sharpness. Level 0 alone aliases.
+    sprintf_s(line, "\n%ux%u view of the zone plate, ms per frame and PSNR against its average over each pixel\n"
+        "%-10s %10s %10s %10s %10s %10s %10s\n", ViewSize, ViewSize,
+        "Texels/px", "Level 0", "PSNR dB", "Box", "PSNR dB", "Kaiser", "PSNR dB");
+    report += line;
+
+    CpuSampler sampler{};
+    sampler.Filter = CpuFilter::Linear;
+    sampler.Address = CpuAddressMode::Clamp;
+
+    for (uint32_t scale : Scales)
+    {
+        float origin = (TextureSize - (float)ViewSize * scale) * 0.5f;
+        uint32_t supersample = (scale * 2 < 16) ? scale * 2 : 16;
+        ParallelFor(ViewSize, 8, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                uint8_t* row = reference.Data + (size_t)y * reference.RowPitch;
+                for (uint32_t x = 0; x < ViewSize; ++x)
+                {
+                    float sum = 0.f;
+                    for (uint32_t sy = 0; sy < supersample; ++sy)
+                    {
+                        for (uint32_t sx = 0; sx < supersample; ++sx)
+                        {
+                            sum += zonePlate(origin + (x + (sx + 0.5f) / supersample) * scale,
+                                origin + (y + (sy + 0.5f) / supersample) * scale);
+                        }
+                    }
+                    uint8_t value = (uint8_t)(toSrgb(sum / (supersample * supersample)) * 255.f + 0.5f);
+                    row[x * 4 + 0] = row[x * 4 + 1] = row[x * 4 + 2] = value;
+                    row[x * 4 + 3] = 255;
+                }
+            }
+        });
+
+        SimdFloat lod = SimdSet(log2f((float)scale));
+        auto drawView = [&](bool mips)
+        {
+            SimdFloat lanes = SimdLaneIndex();
+            for (uint32_t y = 0; y < ViewSize; ++y)
+            {
+                SimdFloat v = SimdSet((origin + (y + 0.5f) * scale) / TextureSize);
+                for (uint32_t x = 0; x < ViewSize; x += SimdWidth)
+                {
+                    SimdFloat u = SimdMul(SimdMad(SimdAdd(lanes, SimdSet(x + 0.5f)), SimdSet((float)scale), SimdSet(origin)),
+                        SimdSet(1.f / TextureSize));
+                    SimdFloat texel[4];
+                    if (mips)
+                    {
+                        CpuTextureSampleLevel(chain.Levels, numLevels, sampler, u, v, lod, texel);
+                    }
+                    else
+                    {
+                        CpuTextureSample(top, sampler, u, v, texel);
+                    }
+                    CpuTextureStoreRow(&view, x, y, SimdWidth, SimdTrue(), texel);
+                }
+            }
+        };
+
+        CpuTextureDiff diff{};
+        double level0Ms = CpuTimeMs(SampleIterations, [&]() { drawView(false); });
+        CpuTextureCompare(view, reference, &diff);
+        FormatMs(level0Ms, text[0]);
+        sprintf_s(text[1], "%.1f", diff.Psnr);
+
+        for (uint32_t f = 0; f < _countof(Filters); ++f)
+        {
+            MipChainGenerate(Filters[f], chain.Levels, numLevels);
+            double ms = CpuTimeMs(SampleIterations, [&]() { drawView(true); });
+            CpuTextureCompare(view, reference, &diff);
+            FormatMs(ms, text[2 + f * 2]);
+            sprintf_s(text[3 + f * 2], "%.1f", diff.Psnr);
+        }
+
+        sprintf_s(line, "%-10u %10s %10s %10s %10s %10s %10s\n", scale, text[0], text[1], text[2], text[3], text[4], text[5]);
+        report += line;
+    }
+
+    CpuTextureDestroy(&reference);
+    CpuTextureDestroy(&view);
+    CpuMipChainDestroy(&chain);
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool CpuBenchmarkBlockCompress(const char* filename)
+{
+    static const uint32_t TextureSize = 2048;
+    static const uint32_t ViewSize = 512;
+    static const uint32_t CompressIterations = 1;
+    static const uint32_t DecompressIterations = 3;
+    static const uint32_t SampleIterations = 10;
+    static const CpuFormat Formats[] = { CpuFormat::BC1Unorm, CpuFormat::BC3Unorm, CpuFormat::BC7Unorm };
+
+    // Smooth color ramps under a zone plate for edges at every angle. It's
+    // opaque, as BC1 only keeps one bit of alpha, so the PSNRs compare color.
+    CpuTexture source;
+    CpuTexture decoded;
+    CpuTexture view;
+    if (!CpuTextureCreate(TextureSize, TextureSize, CpuFormat::R8G8B8A8Unorm, &source) ||
+        !CpuTextureCreate(TextureSize, TextureSize, CpuFormat::R8G8B8A8Unorm, &decoded) ||
+        !CpuTextureCreate(ViewSize, ViewSize, CpuFormat::R8G8B8A8Unorm, &view))
+    {
+        assert(false);
+        CpuTextureDestroy(&source);
+        CpuTextureDestroy(&decoded);
+        return false;
+    }
+
+    ParallelFor(TextureSize, 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            uint8_t* row = source.Data + (size_t)y * source.RowPitch;
+            for (uint32_t x = 0; x < TextureSize; ++x)
+            {
+                float dx = (x + 0.5f) / TextureSize - 0.5f;
+                float dy = (y + 0.5f) / TextureSize - 0.5f;
+                float ring = 0.5f + 0.5f * cosf(3.14159265f * TextureSize * 0.25f * (dx * dx + dy * dy));
+                float radius = sqrtf(dx * dx + dy * dy) * 1.41421356f;
+                row[x * 4 + 0] = (uint8_t)(255.f * (0.25f + 0.75f * (dx + 0.5f)) * ring + 0.5f);
+                row[x * 4 + 1] = (uint8_t)(255.f * (0.25f + 0.75f * (dy + 0.5f)) * ring + 0.5f);
+                row[x * 4 + 2] = (uint8_t)(255.f * (0.5f + 0.5f * ring * (1.f - radius)) + 0.5f);
+                row[x * 4 + 3] = 255;
+            }
+        }
+    });
+
+    std::string report;
+    char line[256];
+    char text[4][16];
+    double toMpx = (double)TextureSize * TextureSize / 1000.0;
+    double sourceMb = CpuFormatImageBytes(CpuFormat::R8G8B8A8Unorm, TextureSize, TextureSize) / (1024.0 * 1024.0);
+
+    // Sampling a 1:1 view with bilinear filtering, the uncompressed texture
+    // first for comparison
+    CpuSampler sampler{};
+    sampler.Filter = CpuFilter::Linear;
+    sampler.Address = CpuAddressMode::Clamp;
+    auto drawView = [&](const CpuTexture& texture)
+    {
+        SimdFloat lanes = SimdLaneIndex();
+        float origin = (TextureSize - ViewSize) * 0.5f;
+        for (uint32_t y = 0; y < ViewSize; ++y)
+        {
+            SimdFloat v = SimdSet((origin + y + 0.5f) / TextureSize);
+            for (uint32_t x = 0; x < ViewSize; x += SimdWidth)
+            {
+                SimdFloat u = SimdMul(SimdAdd(lanes, SimdSet(origin + x + 0.5f)), SimdSet(1.f / TextureSize));
+                SimdFloat texel[4];
+                CpuTextureSample(texture, sampler, u, v, texel);
+                CpuTextureStoreRow(&view, x, y, SimdWidth, SimdTrue(), texel);
+            }
+        }
+    };
+    double sourceSampleMs = CpuTimeMs(SampleIterations, [&]() { drawView(source); });
+    FormatMs(sourceSampleMs, text[0]);
+
+    sprintf_s(line, "Block compression of a %ux%u RGBA image, %.1f MB uncompressed, with %u threads\n"
+        "%ux%u bilinear view of the uncompressed image on one thread: %s ms\n\n"
+        "%-6s %10s %10s %10s %10s %10s %10s %10s\n", TextureSize, TextureSize, sourceMb, ParallelThreadCount(),
+        ViewSize, ViewSize, text[0], "Format", "Encode ms", "Mpx/s", "PSNR dB", "MB", "MB saved", "Decode ms",
+        "View ms");
+    report += line;
+
+    bool result = true;
+    for (CpuFormat format : Formats)
+    {
+        CpuTexture compressed;
+        if (!CpuTextureCreate(TextureSize, TextureSize, format, &compressed))
+        {
+            assert(false);
+            result = false;
+            break;
+        }
+
+        double encodeMs = CpuTimeMs(CompressIterations, [&]() { BlockCompress(source, &compressed); });
+        double decodeMs = CpuTimeMs(DecompressIterations, [&]() { BlockDecompress(compressed, &decoded); });
+        double sampleMs = CpuTimeMs(SampleIterations, [&]() { drawView(compressed); });
+        CpuTextureDiff diff{};
+        CpuTextureCompare(source, decoded, &diff);
+        double mb = CpuFormatImageBytes(format, TextureSize, TextureSize) / (1024.0 * 1024.0);
+
+        FormatMs(encodeMs, text[0]);
+        FormatMs(decodeMs, text[1]);
+        FormatMs(sampleMs, text[2]);
+        sprintf_s(line, "%-6s %10s %10.1f %10.1f %10.1f %10.1f %10s %10s\n", CpuFormatName(format), text[0],
+            toMpx / encodeMs, diff.Psnr, mb, sourceMb - mb, text[1], text[2]);
+        report += line;
+        CpuTextureDestroy(&compressed);
+    }
+
+    CpuTextureDestroy(&view);
+    CpuTextureDestroy(&decoded);
+    CpuTextureDestroy(&source);
+    return result && WriteReport(report, filename);
+}
+
+//==============================================================================
+bool CpuBenchmarkVirtualTexture(const char* filename)
+{
+    static const char* PanoramaFilename = "Panorama.wtex";
+    static const char* GeneratedFilename = "VirtualTextureBenchmark.wtex";
+    static const char* TraceFilename = "HeadTrace.txt";
+    static const uint32_t GeneratedWidth = 8192;
+    static const uint32_t GeneratedHeight = 4096;
+    static const uint32_t NumSlots = 256;
+    static const uint32_t MaxTilesPerFrame = 16;
+    static const uint32_t ViewSize = 512;
+    static const float ViewFovY = 90.f;
+    static const float TraceRate = 90.f;
+    static const uint32_t TraceFrames = 360;
+    static const uint32_t CompareInterval = 8;
+
+    // A panorama from disk, or else a BC1 one made up here: ramps in latitude
+    // and longitude, with a fine checker and a coarse grid for detail
+    const char* panorama = PanoramaFilename;
+    TextureFile file;
+    if (!TextureFileOpen(panorama, &file))
+    {
+        panorama = GeneratedFilename;
+        uint32_t numLevels = MipLevelCount(GeneratedWidth, GeneratedHeight);
+        CpuMipChain chain;
+        CpuMipChain compressed;
+        if (!CpuMipChainCreate(GeneratedWidth, GeneratedHeight, numLevels, CpuFormat::R8G8B8A8Unorm, &chain) ||
+            !CpuMipChainCreate(GeneratedWidth, GeneratedHeight, numLevels, CpuFormat::BC1Unorm, &compressed))
+        {
+            assert(false);
+            CpuMipChainDestroy(&chain);
+            return false;
+        }
+        CpuTexture& top = chain.Levels[0];
+        ParallelFor(GeneratedHeight, 64, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                uint8_t* row = top.Data + (size_t)y * top.RowPitch;
+                for (uint32_t x = 0; x < GeneratedWidth; ++x)
+                {
+                    bool grid = (x % 512) < 4 || (y % 512) < 4;
+                    bool check = ((x / 16) ^ (y / 16)) & 1;
+                    row[x * 4 + 0] = grid ? 255 : (uint8_t)(x * 255 / GeneratedWidth);
+                    row[x * 4 + 1] = grid ? 255 : (uint8_t)(y * 255 / GeneratedHeight);
+                    row[x * 4 + 2] = grid ? 255 : (check ? 192 : 64);
+                    row[x * 4 + 3] = 255;
+                }
+            }
+        });
+        MipChainGenerate(MipFilter::Box, chain.Levels, numLevels);
+        bool written = true;
+        for (uint32_t level = 0; level < numLevels && written; ++level)
+        {
+            written = BlockCompress(chain.Levels[level], &compressed.Levels[level]);
+        }
+        written = written && TextureFileWrite(GeneratedFilename, compressed.Levels, numLevels, 1);
+        CpuMipChainDestroy(&compressed);
+        CpuMipChainDestroy(&chain);
+        if (!written || !TextureFileOpen(GeneratedFilename, &file))
+        {
+            assert(false);
+            DeleteFileA(GeneratedFilename);
+            return false;
+        }
+    }
+
+    // The whole chain, mapped, for the reference views
+    const TextureFileHeader& header = *file.Header;
+    CpuTexture levels[MipMaxLevels];
+    for (uint32_t level = 0; level < header.NumLevels; ++level)
+    {
+        TextureFileGetLevel(file, 0, level, &levels[level]);
+    }
+
+    // Yaw, pitch and roll in degrees at TraceRate, from a recording of a head
+    // if there's one, and made up otherwise
+    struct Trace
+    {
+        const char* Name;
+        std::vector<XMFLOAT3> Angles;
+    };
+    std::vector<Trace> traces;
+    FILE* traceFile = nullptr;
+    if (fopen_s(&traceFile, TraceFilename, "rb") == 0 && traceFile)
+    {
+        Trace trace{ TraceFilename };
+        XMFLOAT3 angles;
+        while (fscanf_s(traceFile, "%f %f %f", &angles.x, &angles.y, &angles.z) == 3)
+        {
+            trace.Angles.push_back(angles);
+        }
+        fclose(traceFile);
+        if (!trace.Angles.empty())
+        {
+            traces.push_back(trace);
+        }
+    }
+    if (traces.empty())
+    {
+        traces.push_back({ "Slow pan" });
+        traces.push_back({ "Look around" });
+        traces.push_back({ "Fast turns" });
+        for (uint32_t i = 0; i < TraceFrames; ++i)
+        {
+            float t = i / TraceRate;
+            float turn = fmodf(t, 1.f) / 0.3f;
+            float snap = floorf(t) + (turn < 1.f ? turn * turn * (3.f - 2.f * turn) : 1.f);
+            traces[0].Angles.push_back(XMFLOAT3(20.f * t, 5.f * sinf(t), 0.f));
+            traces[1].Angles.push_back(XMFLOAT3(70.f * sinf(1.3f * t), 35.f * sinf(0.9f * t), 5.f * sinf(2.f * t)));
+            traces[2].Angles.push_back(XMFLOAT3(90.f * snap, 10.f * sinf(3.f * t), 0.f));
+        }
+    }
+
+    std::string report;
+    char line[256];
+    char text[4][16];
+    double fullMb = file.Size / (1024.0 * 1024.0);
+    sprintf_s(line, "Virtual texture of %s, %ux%u %s with %u levels, %.1f MB in full\n"
+        "%u slots of %ux%u tiles, %u tiles streamed a frame, %ux%u view at %.0f degrees\n", panorama, header.Width,
+        header.Height, CpuFormatName(file.Format), header.NumLevels, fullMb, NumSlots, VirtualTextureTileSize,
+        VirtualTextureTileSize, MaxTilesPerFrame, ViewSize, ViewSize, ViewFovY);
+    report += line;
+    report += "Error and PSNR compare every 8th frame's view against sampling the whole chain\n\n";
+    sprintf_s(line, "%-16s %7s %11s %8s %9s %9s %12s %11s %10s %12s %11s %10s\n", "Trace", "Frames", "Needed/fr",
+        "Miss %", "Streamed", "Evicted", "Resident MB", "Feedback ms", "Update ms", "View ms", "Mean error", "Worst dB");
+    report += line;
+
+    CpuTexture view;
+    CpuTexture reference;
+    if (!CpuTextureCreate(ViewSize, ViewSize, CpuFormat::R8G8B8A8Unorm, &view) ||
+        !CpuTextureCreate(ViewSize, ViewSize, CpuFormat::R8G8B8A8Unorm, &reference))
+    {
+        assert(false);
+        CpuTextureDestroy(&view);
+        TextureFileClose(&file);
+        DeleteFileA(GeneratedFilename);
+        return false;
+    }
+
+    CpuSampler sampler{};
+    sampler.Filter = CpuFilter::Linear;
+    sampler.Address = CpuAddressMode::Wrap;
+    XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(ViewFovY), 1.f, 0.1f, 100.f);
+    std::vector<float> us((ViewSize + 1) * (ViewSize + 1));
+    std::vector<float> vs(us.size());
+
+    bool result = true;
+    for (const Trace& trace : traces)
+    {
+        VirtualTexture vt;
+        if (!VirtualTextureCreate(panorama, NumSlots, &vt))
+        {
+            assert(false);
+            result = false;
+            break;
+        }
+
+        double feedbackMs = 0;
+        double updateMs = 0;
+        double viewMs = 0;
+        double meanError = 0;
+        float worstPsnr = 0.f;
+        uint32_t numCompared = 0;
+        for (uint32_t frame = 0; frame < trace.Angles.size(); ++frame)
+        {
+            const XMFLOAT3& angles = trace.Angles[frame];
+            XMMATRIX rotation = XMMatrixRotationRollPitchYaw(XMConvertToRadians(-angles.y),
+                XMConvertToRadians(angles.x), XMConvertToRadians(angles.z));
+            XMVECTOR det;
+            XMMATRIX inverse = XMMatrixInverse(&det, XMMatrixTranspose(rotation) * proj);
+            XMFLOAT4X4 invViewProj;
+            XMStoreFloat4x4(&invViewProj, inverse);
+            const float* m = &invViewProj.m[0][0];
+
+            feedbackMs += CpuTimeMs(1, [&]() { VirtualTextureFeedback(&vt, m, ViewSize, ViewSize); });
+            updateMs += CpuTimeMs(1, [&]() { VirtualTextureUpdate(&vt, MaxTilesPerFrame); });
+            if (frame % CompareInterval != 0)
+            {
+                continue;
+            }
+
+            // Coordinates at pixel corners, so the level of detail comes from
+            // their differences across each pixel. With no translation, points
+            // on the far plane are directions.
+            for (uint32_t y = 0; y <= ViewSize; ++y)
+            {
+                for (uint32_t x = 0; x <= ViewSize; ++x)
+                {
+                    XMVECTOR ndc = XMVectorSet(x * 2.f / ViewSize - 1.f, 1.f - y * 2.f / ViewSize, 1.f, 1.f);
+                    XMFLOAT3 direction;
+                    XMStoreFloat3(&direction, XMVector3TransformCoord(ndc, inverse));
+                    VirtualTextureDirectionToUv(&direction.x, &us[y * (ViewSize + 1) + x], &vs[y * (ViewSize + 1) + x]);
+                }
+            }
+            auto draw = [&](CpuTexture* target, bool virtualTexture)
+            {
+                for (uint32_t y = 0; y < ViewSize; ++y)
+                {
+                    for (uint32_t x = 0; x < ViewSize; x += SimdWidth)
+                    {
+                        alignas(32) float u[SimdWidth], v[SimdWidth], lod[SimdWidth];
+                        for (uint32_t i = 0; i < SimdWidth; ++i)
+                        {
+                            uint32_t corner = y * (ViewSize + 1) + x + i;
+                            float du[2] = { us[corner + 1] - us[corner], us[corner + ViewSize + 1] - us[corner] };
+                            float dv[2] = { vs[corner + 1] - vs[corner], vs[corner + ViewSize + 1] - vs[corner] };
+                            float footprint = 0.f;
+                            for (uint32_t axis = 0; axis < 2; ++axis)
+                            {
+                                du[axis] -= floorf(du[axis] + 0.5f);
+                                float dx = du[axis] * header.Width;
+                                float dy = dv[axis] * header.Height;
+                                footprint = (footprint > dx * dx + dy * dy) ? footprint : dx * dx + dy * dy;
+                            }
+                            u[i] = us[corner];
+                            v[i] = vs[corner];
+                            lod[i] = (footprint > 1.f) ? 0.5f * log2f(footprint) : 0.f;
+                            lod[i] = (lod[i] < (float)vt.TailLevel) ? lod[i] : (float)vt.TailLevel;
+                        }
+                        SimdFloat texel[4];
+                        if (virtualTexture)
+                        {
+                            VirtualTextureSample(vt, SimdLoad(u), SimdLoad(v), SimdLoad(lod), texel);
+                        }
+                        else
+                        {
+                            CpuTextureSampleLevel(levels, header.NumLevels, sampler, SimdLoad(u), SimdLoad(v),
+                                SimdLoad(lod), texel);
+                        }
+                        CpuTextureStoreRow(target, x, y, SimdWidth, SimdTrue(), texel);
+                    }
+                }
+            };
+            viewMs += CpuTimeMs(1, [&]() { draw(&view, true); });
+            draw(&reference, false);
+
+            CpuTextureDiff diff{};
+            CpuTextureCompare(view, reference, &diff);
+            meanError += diff.MeanError;
+            worstPsnr = (numCompared == 0 || diff.Psnr < worstPsnr) ? diff.Psnr : worstPsnr;
+            ++numCompared;
+        }
+
+        VirtualTextureStats stats;
+        VirtualTextureGetStats(vt, &stats);
+        uint32_t numFrames = (uint32_t)trace.Angles.size();
+        FormatMs(feedbackMs / numFrames, text[0]);
+        FormatMs(updateMs / numFrames, text[1]);
+        FormatMs(viewMs / numCompared, text[2]);
+        sprintf_s(text[3], "%.1f", worstPsnr);
+        sprintf_s(line, "%-16.16s %7u %11.1f %8.2f %9llu %9llu %12.2f %11s %10s %12s %11.5f %10s\n", trace.Name,
+            numFrames, (double)stats.PagesNeeded / numFrames, 100.0 * stats.PagesMissed / stats.PagesNeeded,
+            (unsigned long long)stats.TilesStreamed, (unsigned long long)stats.TilesEvicted,
+            stats.ResidentBytes / (1024.0 * 1024.0), text[0], text[1], text[2], meanError / numCompared, text[3]);
+        report += line;
+        VirtualTextureDestroy(&vt);
+    }
+
+    CpuTextureDestroy(&reference);
+    CpuTextureDestroy(&view);
+    TextureFileClose(&file);
+    DeleteFileA(GeneratedFilename);
+    return result && WriteReport(report, filename);
+}
+
+//==============================================================================
+// The generated environment: sky graded up from the horizon and ground down
+// from it, with soft bands across latitude and longitude so every face edge
+// has detail to line up. The bands fade out toward the poles, where longitude
+// runs together.
+static void EnvironmentColor(const float direction[3], float color[3])
+{
+    static const float Horizon[3] = { 0.80f, 0.84f, 0.90f };
+    static const float Zenith[3] = { 0.20f, 0.38f, 0.78f };
+    static const float Ground[3] = { 0.36f, 0.31f, 0.25f };
+
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    float up = direction[1] / length;
+    float across = sqrtf(1.f - up * up);
+    float latitude = asinf(up);
+    float longitude = atan2f(direction[0], direction[2]);
+    float bands = 0.85f + 0.15f * cosf(latitude * 12.f) * cosf(longitude * 8.f) * across;
+    const float* end = (up >= 0.f) ? Zenith : Ground;
+    float weight = fabsf(up);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        color[c] = (Horizon[c] + (end[c] - Horizon[c]) * weight) * bands;
+    }
+}
+
+//==============================================================================
+bool CpuGenerateEnvironment(uint32_t size, CpuCubeMap* cube)
+{
+    if (!CpuCubeMapCreate(size, MipLevelCount(size, size), CpuFormat::R8G8B8A8Unorm, cube))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Texel centers of every face, a row of the stacked level at a time
+    CpuTexture& top = cube->Levels[0];
+    ParallelFor(top.Height, 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            uint8_t* row = top.Data + (size_t)y * top.RowPitch;
+            float t = ((y % size) + 0.5f) * 2.f / size - 1.f;
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                float direction[3];
+                float color[3];
+                CpuCubeMapFaceDirection(y / size, (x + 0.5f) * 2.f / size - 1.f, t, direction);
+                EnvironmentColor(direction, color);
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    row[x * 4 + c] = (uint8_t)(color[c] * 255.f + 0.5f);
+                }
+                row[x * 4 + 3] = 255;
+            }
+        }
+    });
+
+    if (!CpuCubeMapGenerateMips(MipFilter::Box, cube))
+    {
+        assert(false);
+        CpuCubeMapDestroy(cube);
+        return false;
+    }
+    return true;
+}
+
+//==============================================================================
+bool GraphicsCreateBackground()
+{
+    auto& pipeline = GetPipeline(PipelineStateIndex::Background);
+    auto& backgroundVS = GetShader(ShaderIndex::BackgroundVS);
+    auto& backgroundPS = GetShader(ShaderIndex::BackgroundPS);
+
+    // One triangle over the whole viewport, clipped to it
+    BackgroundVertex vertices[] = {
+        { { -1.f, -1.f } },
+        { { -1.f, 3.f } },
+        { { 3.f, -1.f } },
+    };
+
+    uint32_t indices[] = { 0, 1, 2 };
+
+    D3D11_BUFFER_DESC bd{};
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.ByteWidth = sizeof(vertices);
+    bd.StructureByteStride = sizeof(BackgroundVertex);
+
+    D3D11_SUBRESOURCE_DATA init{};
+    init.pSysMem = vertices;
+    init.SysMemPitch = bd.ByteWidth;
+    init.SysMemSlicePitch = init.SysMemPitch;
+
+    HRESULT hr = Device->CreateBuffer(&bd, &init, &pipeline.VertexBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    pipeline.Stride = bd.StructureByteStride;
+    pipeline.Offset = 0;
+
+    bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd.ByteWidth = sizeof(indices);
+    bd.StructureByteStride = sizeof(uint32_t);
+
+    init.pSysMem = indices;
+    init.SysMemPitch = bd.ByteWidth;
+    init.SysMemSlicePitch = init.SysMemPitch;
+
+    hr = Device->CreateBuffer(&bd, &init, &pipeline.IndexBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    pipeline.NumIndices = _countof(indices);
+
+    hr = Device->CreateVertexShader(backgroundVS.data(), backgroundVS.size(), nullptr, &pipeline.VertexShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    hr = Device->CreatePixelShader(backgroundPS.data(), backgroundPS.size(), nullptr, &pipeline.PixelShader);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_INPUT_ELEMENT_DESC elems[1]{};
+    elems[0].Format = DXGI_FORMAT_R32G32_FLOAT;
+    elems[0].SemanticName = "POSITION";
+
+    hr = Device->CreateInputLayout(elems, _countof(elems), backgroundVS.data(), backgroundVS.size(), &pipeline.InputLayout);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bd.ByteWidth = sizeof(BackgroundPSConstants);
+    bd.StructureByteStride = bd.ByteWidth;
+    hr = Device->CreateBuffer(&bd, nullptr, &pipeline.PSConstantBuffer);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // The CPU environment's levels, a face at a time. Subresources run through
+    // every level of one face before the next face.
+    const CpuCubeMap& cube = CpuEnvironment;
+    D3D11_SUBRESOURCE_DATA initialData[CubeMapNumFaces * MipMaxLevels]{};
+    for (uint32_t face = 0; face < CubeMapNumFaces; ++face)
+    {
+        for (uint32_t level = 0; level < cube.NumLevels; ++level)
+        {
+            CpuTexture faceTexture;
+            CpuCubeMapGetFace(cube, face, level, &faceTexture);
+            D3D11_SUBRESOURCE_DATA& data = initialData[level + face * cube.NumLevels];
+            data.pSysMem = faceTexture.Data;
+            data.SysMemPitch = faceTexture.RowPitch;
+            data.SysMemSlicePitch = faceTexture.RowPitch * faceTexture.Height;
+        }
+    }
+
+    D3D11_TEXTURE2D_DESC td{};
+    td.Width = cube.Size;
+    td.Height = cube.Size;
+    td.MipLevels = cube.NumLevels;
+    td.ArraySize = CubeMapNumFaces;
+    td.Format = (DXGI_FORMAT)TextureFileDxgiFormat(cube.Levels[0].Format);
+    td.SampleDesc.Count = 1;
+    td.Usage = D3D11_USAGE_IMMUTABLE;
+    td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    td.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    ComPtr<ID3D11Texture2D> texture;
+    hr = Device->CreateTexture2D(&td, initialData, &texture);
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvd{};
+    srvd.Format = td.Format;
+    srvd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+    srvd.TextureCube.MipLevels = td.MipLevels;
+    hr = Device->CreateShaderResourceView(texture.Get(), &srvd, EnvironmentSRV.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Trilinear, unlike Sampler, and clamped, for the background and the
+    // compositor layers. The hardware filters across cube faces whatever the
+    // addressing.
+    D3D11_SAMPLER_DESC sd{};
+    sd.AddressU = sd.AddressV = sd.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    sd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    sd.MaxLOD = D3D11_FLOAT32_MAX;
+    hr = Device->CreateSamplerState(&sd, TrilinearSampler.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Destination over: the background fills in what the target leaves
+    // uncovered, as CpuCubeMapDrawBackground composites
+    D3D11_BLEND_DESC bld{};
+    D3D11_RENDER_TARGET_BLEND_DESC& blend = bld.RenderTarget[0];
+    blend.BlendEnable = TRUE;
+    blend.SrcBlend = blend.SrcBlendAlpha = D3D11_BLEND_INV_DEST_ALPHA;
+    blend.DestBlend = blend.DestBlendAlpha = D3D11_BLEND_ONE;
+    blend.BlendOp = blend.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blend.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    hr = Device->CreateBlendState(&bld, BackgroundBlendState.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsDrawBackground(const XMFLOAT4X4& invViewProj)
+{
+    // Into the bound render target and viewport
+    auto& pipeline = GetPipeline(PipelineStateIndex::Background);
+    BackgroundPSConstants constants{ invViewProj };
+    Context->UpdateSubresource(pipeline.PSConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+    Context->OMSetBlendState(BackgroundBlendState.Get(), nullptr, 0xffffffff);
+    Context->PSSetShaderResources(0, 1, EnvironmentSRV.GetAddressOf());
+    Context->PSSetSamplers(0, 1, TrilinearSampler.GetAddressOf());
+    GraphicsDrawPipeline(pipeline);
+
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    Context->PSSetShaderResources(0, 1, &nullSRV);
+    Context->PSSetSamplers(0, 1, Sampler.GetAddressOf());
+    Context->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+}
+
+//==============================================================================
+bool GraphicsBenchmarkCubeMap(const char* filename)
+{
+    static const uint32_t Iterations = 10;
+    static const uint32_t NumSamples = 1u << 20;
+    static const struct
+    {
+        const char* Name;
+        float Yaw;      // Degrees
+        float Pitch;
+    } Views[] = {
+        { "Face center", 0.f, 0.f },
+        { "Face edge", 45.f, 0.f },
+        { "Cube corner", 45.f, 35.26f },
+        { "Straight up", 0.f, 89.f },
+    };
+
+    // Seams: the generated sky sampled at level 0 against the function it was
+    // made from, in random directions. Those within a texel of a face edge
+    // filter texels from the next face, and should do as well as the rest.
+    CpuCubeMap cube;
+    if (!CpuGenerateEnvironment(EnvironmentSize, &cube))
+    {
+        assert(false);
+        return false;
+    }
+
+    double sumError[2] = {};
+    float maxError[2] = {};
+    uint32_t numSamples[2] = {};
+    uint32_t random = 12345;
+    auto next = [&random]()
+    {
+        random = random * 1664525u + 1013904223u;
+        return (random >> 8) * (2.f / 16777216.f) - 1.f;
+    };
+    for (uint32_t i = 0; i < NumSamples; i += SimdWidth)
+    {
+        alignas(32) float d[3][SimdWidth];
+        for (uint32_t lane = 0; lane < SimdWidth; ++lane)
+        {
+            do
+            {
+                d[0][lane] = next();
+                d[1][lane] = next();
+                d[2][lane] = next();
+            } while (fabsf(d[0][lane]) + fabsf(d[1][lane]) + fabsf(d[2][lane]) < 0.01f);
+        }
+
+        SimdFloat direction[3] = { SimdLoad(d[0]), SimdLoad(d[1]), SimdLoad(d[2]) };
+        SimdFloat sampled[4];
+        alignas(32) float color[3][SimdWidth];
+        CpuCubeMapSample(cube, direction, SimdZero(), sampled);
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            SimdStore(color[c], sampled[c]);
+        }
+
+        for (uint32_t lane = 0; lane < SimdWidth; ++lane)
+        {
+            float a[3] = { fabsf(d[0][lane]), fabsf(d[1][lane]), fabsf(d[2][lane]) };
+            uint32_t axis = (a[0] >= a[1] && a[0] >= a[2]) ? 0 : (a[1] >= a[2] ? 1 : 2);
+            float minor = (a[(axis + 1) % 3] > a[(axis + 2) % 3]) ? a[(axis + 1) % 3] : a[(axis + 2) % 3];
+            uint32_t edge = (minor / a[axis] > 1.f - 2.f / EnvironmentSize) ? 1 : 0;
+
+            float laneDirection[3] = { d[0][lane], d[1][lane], d[2][lane] };
+            float expected[3];
+            EnvironmentColor(laneDirection, expected);
+            float error = 0.f;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                float e = fabsf(color[c][lane] - expected[c]);
+                error = (e > error) ? e : error;
+            }
+            sumError[edge] += error;
+            maxError[edge] = (error > maxError[edge]) ? error : maxError[edge];
+            ++numSamples[edge];
+        }
+    }
+    CpuCubeMapDestroy(&cube);
+
+    std::string report;
+    char line[256];
+    char text[2][16];
+    sprintf_s(line, "Seamless filtering of a generated %u texel cube at level 0, error against its function, "
+        "%u random directions\n%-22s %10s %10s %10s\n", EnvironmentSize, NumSamples, "Samples", "Count", "Mean", "Max");
+    report += line;
+    const char* edgeNames[2] = { "Interior", "Within a texel of edge" };
+    for (uint32_t edge = 0; edge < 2; ++edge)
+    {
+        sprintf_s(line, "%-22s %10u %10.5f %10.5f\n", edgeNames[edge], numSamples[edge],
+            numSamples[edge] ? sumError[edge] / numSamples[edge] : 0.0, maxError[edge]);
+        report += line;
+    }
+
+    // The background over a frame the size of the back buffer, from the loaded
+    // environment on the CPU and its copy on the GPU
+    uint32_t width = CpuBackBuffer.Width;
+    uint32_t height = CpuBackBuffer.Height;
+    XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), width / (float)height, SceneNear, SceneFar);
+    CpuTexture target;
+    if (!CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &target))
+    {
+        assert(false);
+        return false;
+    }
+
+    static const float transparentColor[] = { 0.f, 0.f, 0.f, 0.f };
+    double toMpx = (double)width * height / 1000.0;
+    sprintf_s(line, "\n%ux%u background of a %u texel, %u level cube, CPU on %u threads\n%-12s %10s %10s %10s %10s\n",
+        width, height, CpuEnvironment.Size, CpuEnvironment.NumLevels, ParallelThreadCount(),
+        "View", "CPU ms", "Mpx/s", "GPU ms", "Mpx/s");
+    report += line;
+    for (const auto& view : Views)
+    {
+        XMMATRIX rotation = XMMatrixRotationRollPitchYaw(XMConvertToRadians(-view.Pitch), XMConvertToRadians(view.Yaw), 0.f);
+        XMVECTOR det;
+        XMFLOAT4X4 invViewProj;
+        XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, XMMatrixTranspose(rotation) * proj));
+
+        CpuTextureClear(&target, transparentColor);
+        CpuViewport cpuViewport = {};
+        double cpuMs = CpuTimeMs(Iterations, [&]()
+        {
+            CpuCubeMapDrawBackground(CpuEnvironment, &invViewProj.m[0][0], cpuViewport, &target);
+        });
+
+        Context->ClearRenderTargetView(BackBufferRTV.Get(), transparentColor);
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        double gpuMs = GraphicsTimeGpuMs(Iterations, [&]() { GraphicsDrawBackground(invViewProj); });
+
+        FormatMs(gpuMs, text[0]);
+        if (gpuMs > 0)
+        {
+            sprintf_s(text[1], "%.1f", toMpx / gpuMs);
+        }
+        else
+        {
+            strcpy_s(text[1], "-");
+        }
+        sprintf_s(line, "%-12s %10.2f %10.1f %10s %10s\n", view.Name, cpuMs, toMpx / cpuMs, text[0], text[1]);
+        report += line;
+    }
+    CpuTextureDestroy(&target);
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+// Cheap integer hash for the generated card texture
+static inline uint32_t CardHash(uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t h = (a * 0x9e3779b1u) ^ (b * 0x85ebca77u) ^ (c * 0xc2b2ae3du);
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+//==============================================================================
+bool CpuGenerateCards(uint32_t width, uint32_t height, uint32_t numCards, CpuMipChain* chain)
+{
+    static const float Gap = 8.f;           // Transparent texels between cards
+    static const float Corner = 16.f;       // Radius of the rounded corners
+    static const float Border = 3.f;
+    static const uint32_t Margin = 16;      // Card edge to text
+    static const uint32_t GlyphWidth = 6;   // 5 x 7 glyphs with a texel between
+    static const uint32_t LineHeight = 12;
+    static const float Text[3] = { 0.92f, 0.92f, 0.95f };
+
+    if (!CpuMipChainCreate(width, height, MipLevelCount(width, height), CpuFormat::R8G8B8A8Unorm, chain))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Translucent rounded cards with a border in their tint and rows of glyphs
+    // drawn in 1 texel strokes, the detail a second resampling blurs
+    uint32_t cardWidth = width / numCards;
+    uint32_t textColumns = (cardWidth - 2 * Margin) / GlyphWidth;
+    uint32_t textLines = (height - 2 * Margin) / LineHeight;
+    CpuTexture& top = chain->Levels[0];
+    ParallelFor(height, 16, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; ++y)
+        {
+            uint8_t* row = top.Data + (size_t)y * top.RowPitch;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                uint32_t card = (x / cardWidth < numCards) ? x / cardWidth : numCards - 1;
+                uint32_t cardX = x - card * cardWidth;
+                float tint[3];
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    tint[c] = 0.55f + 0.45f * cosf(6.2831853f * ((float)card / numCards + c / 3.f));
+                }
+
+                // Distance outside the rounded rectangle, negative inside
+                float qx = fabsf(cardX + 0.5f - cardWidth * 0.5f) - (cardWidth - Gap) * 0.5f + Corner;
+                float qy = fabsf(y + 0.5f - height * 0.5f) - (height - Gap) * 0.5f + Corner;
+                float ox = (qx > 0.f) ? qx : 0.f;
+                float oy = (qy > 0.f) ? qy : 0.f;
+                float inside = (qx > qy) ? qx : qy;
+                float outside = sqrtf(ox * ox + oy * oy) + ((inside < 0.f) ? inside : 0.f) - Corner;
+                float coverage = 0.5f - outside;
+                coverage = (coverage < 0.f) ? 0.f : ((coverage > 1.f) ? 1.f : coverage);
+
+                float color[3];
+                float alpha = 0.85f;
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    color[c] = 0.08f + 0.12f * tint[c];
+                }
+                if (outside > -Border)
+                {
+                    alpha = 1.f;
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        color[c] = tint[c];
+                    }
+                }
+                else if (cardX >= Margin && y >= Margin)
+                {
+                    // Lines of random length, with the odd space between words
+                    uint32_t column = (cardX - Margin) / GlyphWidth;
+                    uint32_t line = (y - Margin) / LineHeight;
+                    uint32_t glyphX = (cardX - Margin) % GlyphWidth;
+                    uint32_t glyphY = (y - Margin) % LineHeight;
+                    uint32_t length = textColumns * (40 + CardHash(card, line, 0) % 61) / 100;
+                    bool glyph = column < length && line < textLines && glyphX < 5 && glyphY < 7 &&
+                        CardHash(card, line, column + 1) % 6 != 0;
+                    if (glyph && CardHash(card * 4096 + line, column, glyphY * 5 + glyphX) % 8 < 3)
+                    {
+                        alpha = 1.f;
+                        for (uint32_t c = 0; c < 3; ++c)
+                        {
+                            color[c] = (line == 0) ? tint[c] : Text[c];
+                        }
+                    }
+                }
+
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    row[x * 4 + c] = (uint8_t)(color[c] * 255.f + 0.5f);
+                }
+                row[x * 4 + 3] = (uint8_t)(alpha * coverage * 255.f + 0.5f);
+            }
+        }
+    });
+
+    if (!MipChainGenerate(MipFilter::Kaiser, chain->Levels, chain->NumLevels))
+    {
+        assert(false);
+        CpuMipChainDestroy(chain);
+        return false;
+    }
+    return true;
+}
+
+//==============================================================================
+bool CpuCreateCompositorLayers()
+{
+    // A panel up and to the left of the scene, turned to face the starting eye
+    // position, and a strip of cards curving around it below eye level
+    if (!CpuGenerateCards(PanelWidth, PanelHeight, 1, &CpuLayerTextures[0]) ||
+        !CpuGenerateCards(StripWidth, StripHeight, StripCards, &CpuLayerTextures[1]))
+    {
+        assert(false);
+        return false;
+    }
+
+    XMFLOAT4X4 pose;
+    CompositorLayer& panel = CompositorLayers[0];
+    panel = CompositorLayer{};
+    panel.Type = CompositorLayerType::Quad;
+    XMStoreFloat4x4(&pose, XMMatrixRotationY(atan2f(-2.2f, 3.5f)) * XMMatrixTranslation(-2.2f, 2.f, -4.5f));
+    memcpy(panel.Pose, &pose, sizeof(panel.Pose));
+    panel.Width = 1.6f;
+    panel.Height = panel.Width * PanelHeight / PanelWidth;
+    panel.Levels = CpuLayerTextures[0].Levels;
+    panel.NumLevels = CpuLayerTextures[0].NumLevels;
+
+    CompositorLayer& strip = CompositorLayers[1];
+    strip = CompositorLayer{};
+    strip.Type = CompositorLayerType::Cylinder;
+    XMStoreFloat4x4(&pose, XMMatrixTranslation(0.f, 0.3f, -8.f));
+    memcpy(strip.Pose, &pose, sizeof(strip.Pose));
+    strip.Radius = 3.f;
+    strip.CentralAngle = XMConvertToRadians(100.f);
+    strip.Height = strip.Radius * strip.CentralAngle * StripHeight / StripWidth;
+    strip.Levels = CpuLayerTextures[1].Levels;
+    strip.NumLevels = CpuLayerTextures[1].NumLevels;
+
+    NumCompositorLayers = 2;
+    return true;
+}
+
+//==============================================================================
+uint32_t CpuGatherCompositorLayers(bool background, bool layers, CompositorLayer* out)
+{
+    // Into CompositorMaxLayers, back to front: the environment as a cube layer
+    // beneath the warped frame, then the layers over it
+    assert(NumCompositorLayers < CompositorMaxLayers);
+    uint32_t count = 0;
+    if (background)
+    {
+        CompositorLayer& environment = out[count++];
+        environment = CompositorLayer{};
+        environment.Type = CompositorLayerType::Cube;
+        XMFLOAT4X4 pose;
+        XMStoreFloat4x4(&pose, XMMatrixIdentity());
+        memcpy(environment.Pose, &pose, sizeof(environment.Pose));
+        environment.Cube = &CpuEnvironment;
+    }
+    for (uint32_t i = 0; layers && i < NumCompositorLayers; ++i)
+    {
+        out[count++] = CompositorLayers[i];
+    }
+    return count;
+}
+
+//==============================================================================
+bool GraphicsCreateCompositor()
+{
+    // The background's full screen triangle with the compositor's pixel shader
+    auto& pipeline = GetPipeline(PipelineStateIndex::Compositor);
+    auto& backgroundPipeline = GetPipeline(PipelineStateIndex::Background);
+    auto& compositorPS = GetShader(ShaderIndex::CompositorPS);
+    pipeline = backgroundPipeline;
+    pipeline.PSConstantBuffer = nullptr;
+    HRESULT hr = Device->CreatePixelShader(compositorPS.data(), compositorPS.size(), nullptr,
+        pipeline.PixelShader.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd{};
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.ByteWidth = sizeof(CompositorPSConstants);
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    hr = Device->CreateBuffer(&bd, nullptr, pipeline.PSConstantBuffer.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < NumCompositorLayers; ++i)
+    {
+        const CompositorLayer& layer = CompositorLayers[i];
+        if (!GraphicsCreateTextureFromLevels(layer.Levels, layer.NumLevels, LayerSRVs[i].ReleaseAndGetAddressOf()))
+        {
+            assert(false);
+            return false;
+        }
+    }
+
+    // Premultiplied over, as CompositorDraw composites
+    D3D11_BLEND_DESC bld{};
+    D3D11_RENDER_TARGET_BLEND_DESC& blend = bld.RenderTarget[0];
+    blend.BlendEnable = TRUE;
+    blend.SrcBlend = blend.SrcBlendAlpha = D3D11_BLEND_ONE;
+    blend.DestBlend = blend.DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    blend.BlendOp = blend.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blend.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    hr = Device->CreateBlendState(&bld, CompositorBlendState.ReleaseAndGetAddressOf());
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void GraphicsDrawCompositor(const XMFLOAT4X4& viewProj, const XMFLOAT4X4& invViewProj,
+    const D3D11_VIEWPORT& viewport, bool cullBounds)
+{
+    // Into the bound render target, over it, so only the quads and cylinders.
+    // Layers outside their bounds skip the tracing, unless 'cullBounds' is off
+    // and every layer covers the viewport.
+    auto& pipeline = GetPipeline(PipelineStateIndex::Compositor);
+    CpuViewport cpuViewport = { viewport.TopLeftX, viewport.TopLeftY, viewport.Width, viewport.Height };
+    CompositorPSConstants constants{};
+    constants.InvViewProj = invViewProj;
+    constants.NumLayers = NumCompositorLayers;
+    for (uint32_t i = 0; i < NumCompositorLayers; ++i)
+    {
+        const CompositorLayer& layer = CompositorLayers[i];
+        assert(layer.Type != CompositorLayerType::Cube);
+        CompositorLayerConstants& layerConstants = constants.Layers[i];
+        CompositorInversePose(layer.Pose, &layerConstants.WorldToLayer.m[0][0]);
+        CompositorRect rect = { (uint32_t)viewport.TopLeftX, (uint32_t)viewport.TopLeftY,
+            (uint32_t)(viewport.TopLeftX + viewport.Width), (uint32_t)(viewport.TopLeftY + viewport.Height) };
+        if (cullBounds && !CompositorLayerBounds(layer, &viewProj.m[0][0], cpuViewport, CpuBackBuffer, &rect))
+        {
+            rect = CompositorRect{};
+        }
+        layerConstants.Bounds = XMFLOAT4((float)rect.Left, (float)rect.Top, (float)rect.Right, (float)rect.Bottom);
+        layerConstants.Type = (uint32_t)layer.Type;
+        layerConstants.Width = layer.Width;
+        layerConstants.Height = layer.Height;
+        layerConstants.Radius = layer.Radius;
+        layerConstants.CentralAngle = layer.CentralAngle;
+    }
+    Context->UpdateSubresource(pipeline.PSConstantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+    ID3D11ShaderResourceView* srvs[CompositorMaxLayers] = {};
+    for (uint32_t i = 0; i < NumCompositorLayers; ++i)
+    {
+        srvs[i] = LayerSRVs[i].Get();
+    }
+    Context->RSSetViewports(1, &viewport);
+    Context->OMSetBlendState(CompositorBlendState.Get(), nullptr, 0xffffffff);
+    Context->PSSetShaderResources(0, CompositorMaxLayers, srvs);
+    Context->PSSetSamplers(0, 1, TrilinearSampler.GetAddressOf());
+    GraphicsDrawPipeline(pipeline);
+
+    ID3D11ShaderResourceView* nullSRVs[CompositorMaxLayers] = {};
+    Context->PSSetShaderResources(0, CompositorMaxLayers, nullSRVs);
+    Context->PSSetSamplers(0, 1, Sampler.GetAddressOf());
+    Context->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+}
+
+//==============================================================================
+bool GraphicsBenchmarkCompositor(const char* filename)
+{
+    static const uint32_t Iterations = 10;
+    static const uint32_t Supersample = 4;
+    static const float HeadTurns[] = { 0.f, 0.1f, 0.5f, 2.f };     // Degrees of yaw, app pose to display pose
+
+    uint32_t width = CpuBackBuffer.Width;
+    uint32_t height = CpuBackBuffer.Height;
+    XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), width / (float)height, SceneNear, SceneFar);
+    CpuTexture reference;
+    CpuTexture direct;
+    CpuTexture appFrame;
+    CpuTexture warped;
+    if (!CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &reference) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &direct) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &appFrame) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &warped))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Sharpness: the panel straight on at close to a texel per pixel, a little
+    // under so texel and pixel centers drift in and out of line, composited as
+    // a layer, and drawn into an app frame at a lagging pose then warped to the
+    // display pose the way the projection layer is. Both against the panel's
+    // texels as squares, point sampled Supersample x Supersample times a pixel,
+    // within the panel's bounds.
+    static const float transparentColor[] = { 0.f, 0.f, 0.f, 0.f };
+    const CompositorLayer& panel = CompositorLayers[0];
+    float pixelsPerRadian = height * 0.5f / tanf(XMConvertToRadians(SceneFovY) * 0.5f);
+    float distance = 1.07f * panel.Width * pixelsPerRadian / PanelWidth;
+    XMVECTOR center = XMVectorSet(panel.Pose[12], panel.Pose[13], panel.Pose[14], 1.f);
+    XMVECTOR normal = XMVectorSet(panel.Pose[8], panel.Pose[9], panel.Pose[10], 0.f);
+    XMMATRIX view = XMMatrixLookToLH(center - normal * distance, normal, XMVectorSet(0.f, 1.f, 0.f, 0.f));
+    XMMATRIX displayViewProj = view * proj;
+    XMVECTOR det;
+    XMFLOAT4X4 viewProj;
+    XMFLOAT4X4 invViewProj;
+    XMFLOAT4X4 worldToLayer;
+    XMFLOAT4X4 ndcToLayer;
+    XMStoreFloat4x4(&viewProj, displayViewProj);
+    XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, displayViewProj));
+    CompositorInversePose(panel.Pose, &worldToLayer.m[0][0]);
+    XMStoreFloat4x4(&ndcToLayer, XMMatrixInverse(&det, displayViewProj) * XMLoadFloat4x4(&worldToLayer));
+    CpuViewport wholeTarget = {};
+
+    CompositorRect rect;
+    if (!CompositorLayerBounds(panel, &viewProj.m[0][0], wholeTarget, reference, &rect))
+    {
+        assert(false);
+        return false;
+    }
+
+    const CpuTexture& texels = panel.Levels[0];
+    CpuTextureClear(&reference, transparentColor);
+    ParallelFor(rect.Bottom - rect.Top, 4, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = rect.Top + begin; y < rect.Top + end; ++y)
+        {
+            uint8_t* row = reference.Data + (size_t)y * reference.RowPitch;
+            for (uint32_t x = rect.Left; x < rect.Right; ++x)
+            {
+                // Each point's ray from the near plane to the far plane, in the
+                // panel's space, meets its plane at z = 0
+                float sum[4] = {};
+                for (uint32_t i = 0; i < Supersample * Supersample; ++i)
+                {
+                    float ndc[2] = { (x + (i % Supersample + 0.5f) / Supersample) * 2.f / width - 1.f,
+                        1.f - (y + (i / Supersample + 0.5f) / Supersample) * 2.f / height };
+                    float ends[2][3];
+                    for (uint32_t z = 0; z < 2; ++z)
+                    {
+                        float p[4];
+                        for (uint32_t j = 0; j < 4; ++j)
+                        {
+                            p[j] = ndc[0] * ndcToLayer.m[0][j] + ndc[1] * ndcToLayer.m[1][j] + z * ndcToLayer.m[2][j] +
+                                ndcToLayer.m[3][j];
+                        }
+                        for (uint32_t j = 0; j < 3; ++j)
+                        {
+                            ends[z][j] = p[j] / p[3];
+                        }
+                    }
+                    float t = ends[0][2] / (ends[0][2] - ends[1][2]);
+                    float u = (ends[0][0] + t * (ends[1][0] - ends[0][0])) / panel.Width + 0.5f;
+                    float v = 0.5f - (ends[0][1] + t * (ends[1][1] - ends[0][1])) / panel.Height;
+                    if (u >= 0.f && u < 1.f && v >= 0.f && v < 1.f)
+                    {
+                        const uint8_t* texel = texels.Data + (size_t)(v * texels.Height) * texels.RowPitch +
+                            (uint32_t)(u * texels.Width) * 4;
+                        for (uint32_t c = 0; c < 3; ++c)
+                        {
+                            sum[c] += texel[c] * (texel[3] / 255.f);
+                        }
+                        sum[3] += texel[3];
+                    }
+                }
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    row[x * 4 + c] = (uint8_t)(sum[c] / (Supersample * Supersample) + 0.5f);
+                }
+            }
+        }
+    });
+
+    auto crop = [&rect](const CpuTexture& texture)
+    {
+        CpuTexture cropped = texture;
+        cropped.Data += (size_t)rect.Top * texture.RowPitch + rect.Left * 4;
+        cropped.Width = rect.Right - rect.Left;
+        cropped.Height = rect.Bottom - rect.Top;
+        return cropped;
+    };
+
+    std::string report;
+    char line[256];
+    char text[2][16];
+    sprintf_s(line, "Panel sharpness, %ux%u texels at %.2f m on a %ux%u frame, within its %ux%u pixel bounds, "
+        "against its texels point sampled %ux%u per pixel\n%-26s %10s %10s %10s\n", PanelWidth, PanelHeight, distance,
+        width, height, rect.Right - rect.Left, rect.Bottom - rect.Top, Supersample, Supersample, "Path", "Turn deg",
+        "Mean", "PSNR dB");
+    report += line;
+
+    CpuTextureDiff diff;
+    CpuTextureClear(&direct, transparentColor);
+    CompositorDraw(&panel, 1, &viewProj.m[0][0], &invViewProj.m[0][0], wholeTarget, &direct, nullptr);
+    CpuTextureCompare(crop(direct), crop(reference), &diff);
+    sprintf_s(line, "%-26s %10s %10.5f %10.2f\n", "Compositor layer", "-", diff.MeanError, diff.Psnr);
+    report += line;
+
+    CpuSampler sampler = CpuLinearSampler;
+    for (float turn : HeadTurns)
+    {
+        // The app frame at the lagging pose, then each display pixel's ray
+        // through it
+        XMMATRIX appViewProj = view * XMMatrixRotationY(XMConvertToRadians(turn)) * proj;
+        XMFLOAT4X4 appViewProjF;
+        XMFLOAT4X4 appInvViewProj;
+        XMFLOAT4X4 warp;
+        XMStoreFloat4x4(&appViewProjF, appViewProj);
+        XMStoreFloat4x4(&appInvViewProj, XMMatrixInverse(&det, appViewProj));
+        XMStoreFloat4x4(&warp, XMMatrixInverse(&det, displayViewProj) * appViewProj);
+        CpuTextureClear(&appFrame, transparentColor);
+        CompositorDraw(&panel, 1, &appViewProjF.m[0][0], &appInvViewProj.m[0][0], wholeTarget, &appFrame, nullptr);
+
+        ParallelFor(height, 16, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                SimdFloat ndcY = SimdSet(1.f - (y + 0.5f) * 2.f / height);
+                for (uint32_t x = 0; x < width; x += SimdWidth)
+                {
+                    SimdFloat ndcX = SimdSub(SimdMul(SimdAdd(SimdLaneIndex(), SimdSet(x + 0.5f)), SimdSet(2.f / width)),
+                        SimdSet(1.f));
+                    SimdFloat p[4];
+                    for (uint32_t j = 0; j < 4; ++j)
+                    {
+                        p[j] = SimdMad(ndcX, SimdSet(warp.m[0][j]), SimdMad(ndcY, SimdSet(warp.m[1][j]),
+                            SimdSet(warp.m[3][j])));
+                    }
+                    SimdFloat invW = SimdDiv(SimdSet(1.f), p[3]);
+                    SimdFloat u = SimdMad(SimdMul(p[0], invW), SimdSet(0.5f), SimdSet(0.5f));
+                    SimdFloat v = SimdSub(SimdSet(0.5f), SimdMul(SimdMul(p[1], invW), SimdSet(0.5f)));
+                    SimdFloat color[4];
+                    CpuTextureSample(appFrame, sampler, u, v, color);
+                    uint32_t count = (width - x < SimdWidth) ? width - x : SimdWidth;
+                    CpuTextureStoreRow(&warped, x, y, count, SimdTrue(), color);
+                }
+            }
+        });
+
+        CpuTextureCompare(crop(warped), crop(reference), &diff);
+        sprintf_s(line, "%-26s %10.1f %10.5f %10.2f\n", "App frame, then warped", turn, diff.MeanError, diff.Psnr);
+        report += line;
+    }
+    CpuTextureDestroy(&warped);
+    CpuTextureDestroy(&appFrame);
+    CpuTextureDestroy(&direct);
+    CpuTextureDestroy(&reference);
+
+    // Cost: the demo layers from the starting pose over a frame the size of
+    // the back buffer. On the GPU, with the bounds early-out and without.
+    XMMATRIX startViewProj = XMMatrixTranslation(0.f, -1.f, 8.f) * proj;
+    XMStoreFloat4x4(&viewProj, startViewProj);
+    XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, startViewProj));
+    CpuTexture target;
+    if (!CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &target))
+    {
+        assert(false);
+        return false;
+    }
+    CompositorStats stats{};
+    CpuTextureClear(&target, transparentColor);
+    double cpuMs = CpuTimeMs(Iterations, [&]()
+    {
+        CompositorDraw(CompositorLayers, NumCompositorLayers, &viewProj.m[0][0], &invViewProj.m[0][0], wholeTarget,
+            &target, &stats);
+    });
+    CpuTextureDestroy(&target);
+
+    D3D11_VIEWPORT viewport = { 0.f, 0.f, (float)width, (float)height, 0.f, 1.f };
+    Context->ClearRenderTargetView(BackBufferRTV.Get(), transparentColor);
+    Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+    double gpuMs = GraphicsTimeGpuMs(Iterations, [&]()
+    {
+        GraphicsDrawCompositor(viewProj, invViewProj, viewport, true);
+    });
+    double gpuUnculledMs = GraphicsTimeGpuMs(Iterations, [&]()
+    {
+        GraphicsDrawCompositor(viewProj, invViewProj, viewport, false);
+    });
+
+    double tests = stats.Tests ? (double)stats.Tests : 1.0;
+    FormatMs(gpuMs, text[0]);
+    FormatMs(gpuUnculledMs, text[1]);
+    sprintf_s(line, "\n%u layers over %ux%u from the starting pose, CPU on %u threads\n"
+        "CPU ms %.2f, layer tests %.1f%% traced, %.1f%% out of bounds, %.1f%% occluded\n"
+        "GPU ms %s, %s without the bounds early-out\n",
+        NumCompositorLayers, width, height, ParallelThreadCount(), cpuMs, 100.0 * stats.Traced / tests,
+        100.0 * stats.OutOfBounds / tests, 100.0 * stats.Occluded / tests, text[0], text[1]);
+    report += line;
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+static bool GraphicsCaptureCopy(void* context, uint32_t slot, void* source)
+{
+    (void)context;
+
+    // Staging to match the source, made again only when that changes
+    ID3D11Texture2D* texture = (ID3D11Texture2D*)source;
+    D3D11_TEXTURE2D_DESC td{};
+    texture->GetDesc(&td);
+    CpuFormat format;
+    switch (td.Format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM: format = CpuFormat::R8G8B8A8Unorm; break;
+    case DXGI_FORMAT_R16_TYPELESS: format = CpuFormat::R16Unorm; break;
+    case DXGI_FORMAT_R32_TYPELESS: format = CpuFormat::R32Float; break;
+    default: return false;
+    }
+
+    D3D11_TEXTURE2D_DESC current{};
+    if (CaptureStaging[slot])
+    {
+        CaptureStaging[slot]->GetDesc(&current);
+    }
+    if (!CaptureStaging[slot] || current.Width != td.Width || current.Height != td.Height ||
+        current.Format != td.Format)
+    {
+        td.BindFlags = 0;
+        td.Usage = D3D11_USAGE_STAGING;
+        td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        td.MiscFlags = 0;
+        HRESULT hr = Device->CreateTexture2D(&td, nullptr, CaptureStaging[slot].ReleaseAndGetAddressOf());
+        if (FAILED(hr))
+        {
+            assert(false);
+            return false;
+        }
+    }
+
+    CaptureFormats[slot] = format;
+    Context->CopyResource(CaptureStaging[slot].Get(), texture);
+    return true;
+}
+
+//==============================================================================
+static bool GraphicsCaptureMap(void* context, uint32_t slot, bool wait, CpuTexture* image)
+{
+    (void)context;
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    HRESULT hr = Context->Map(CaptureStaging[slot].Get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT,
+        &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+    {
+        return false;
+    }
+    if (FAILED(hr))
+    {
+        assert(false);
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC td{};
+    CaptureStaging[slot]->GetDesc(&td);
+    image->Width = td.Width;
+    image->Height = td.Height;
+    image->RowPitch = mapped.RowPitch;
+    image->Format = CaptureFormats[slot];
+    image->Data = (uint8_t*)mapped.pData;
+    return true;
+}
+
+//==============================================================================
+static void GraphicsCaptureUnmap(void* context, uint32_t slot)
+{
+    (void)context;
+    Context->Unmap(CaptureStaging[slot].Get(), 0);
+}
+
+//==============================================================================
+// Where 'capture' writes frame 'index' of 'mode', with 'prefix' before the
+// mode's name
+static void CaptureFilename(const CaptureMode& mode, const char* prefix, uint32_t index,
+    char (&filename)[FrameCaptureMaxFilename])
+{
+    sprintf_s(filename, "%s/%s%s_%06u.%s", CaptureDirectory, prefix, mode.Name, index,
+        CaptureFileFormatExtension(mode.Format));
+}
+
+//==============================================================================
+static bool GraphicsCaptureFrame(FrameCapture* capture, const CaptureMode& mode, const char* prefix, uint32_t index)
+{
+    ComPtr<ID3D11Texture2D> source;
+    switch (mode.Source)
+    {
+    case CaptureSource::BackBuffer:
+        source = BackBuffer;
+        break;
+    case CaptureSource::AppFrame:
+    {
+        ComPtr<ID3D11Resource> resource;
+        AppFrameRTV->GetResource(&resource);
+        resource.As(&source);
+        break;
+    }
+    case CaptureSource::AppFrameDepth:
+        source = AppFrameDepth;
+        break;
+    }
+
+    char filename[FrameCaptureMaxFilename];
+    CaptureFilename(mode, prefix, index, filename);
+    return FrameCaptureFrame(capture, source.Get(), mode.Format, filename);
+}
+
+//==============================================================================
+static bool GraphicsBenchmarkCapture(const char* filename)
+{
+    static const uint32_t NumFrames = 30;
+    static const double FrameMs = 1000.0 / 90.0;
+    static const char* Prefix = "Benchmark";
+
+    if (!CreateDirectoryA(CaptureDirectory, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+    {
+        assert(false);
+        return false;
+    }
+
+    // Each mode on a capture of its own, once the app's is done with the
+    // staging. Frames are paced at 90 Hz and their GPU work flushed, as
+    // Present would, and this thread's time is what capturing adds to a frame.
+    FrameCaptureFlush(&Capture);
+    FrameReadback readback = { GraphicsCaptureCopy, GraphicsCaptureMap, GraphicsCaptureUnmap, nullptr };
+    std::string report;
+    char line[256];
+    sprintf_s(line, "%ux%u frames, %u captured at 90 Hz per mode, %u slots, %u frames before mapping\n"
+        "%-22s %10s %10s %8s %8s %8s %10s %10s\n", CpuBackBuffer.Width, CpuBackBuffer.Height, NumFrames,
+        CaptureSlots, CaptureLatency, "Mode", "Mean ms", "Max ms", "Written", "Dropped", "Failed", "Write ms", "MB/s");
+    report += line;
+    for (const CaptureMode& mode : CaptureModes)
+    {
+        FrameCapture capture;
+        if (!FrameCaptureCreate(CaptureSlots, CaptureLatency, readback, &capture))
+        {
+            assert(false);
+            return false;
+        }
+
+        double sumMs = 0;
+        double maxMs = 0;
+        for (uint32_t frame = 0; frame < NumFrames; ++frame)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            double ms = CpuTimeMs(1, [&]()
+            {
+                FrameCaptureUpdate(&capture);
+                GraphicsCaptureFrame(&capture, mode, Prefix, frame);
+            });
+            sumMs += ms;
+            maxMs = (ms > maxMs) ? ms : maxMs;
+
+            Context->Flush();
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() -
+                start).count();
+            if (elapsed < FrameMs)
+            {
+                Sleep((DWORD)(FrameMs - elapsed));
+            }
+        }
+        FrameCaptureFlush(&capture);
+        FrameCaptureStats stats;
+        FrameCaptureGetStats(capture, &stats);
+        FrameCaptureDestroy(&capture);
+
+        for (uint32_t frame = 0; frame < NumFrames; ++frame)
+        {
+            char captureFilename[FrameCaptureMaxFilename];
+            CaptureFilename(mode, Prefix, frame, captureFilename);
+            remove(captureFilename);
+        }
+
+        char name[32];
+        sprintf_s(name, "%s %s", mode.Name, CaptureFileFormatExtension(mode.Format));
+        sprintf_s(line, "%-22s %10.3f %10.3f %8u %8u %8u %10.2f %10.1f\n", name, sumMs / NumFrames, maxMs,
+            stats.Written, stats.Dropped, stats.Failed, stats.Written ? stats.WriteMs / stats.Written : 0.0,
+            (stats.WriteMs > 0) ? (double)stats.BytesWritten / (stats.WriteMs * 1000.0) : 0.0);
+        report += line;
+    }
+
+    return WriteReport(report, filename);
+}
+
+//==============================================================================
+bool CpuBenchmarkFrameArena(const char* filename)
+{
+    // The CPU frame on a frame arena of its own, at a pose turning a little
+    // each frame: the app frame and its depth passes, the grid warp, then the
+    // background and the layers over it. Only the first frame may allocate.
+    static const uint32_t NumFrames = 16;
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+
+    // With nothing else allocating meanwhile
+    FrameCaptureFlush(&Capture);
+    TextureLoaderFlush(&ImageLoader, 0);
+
+    FrameArena frames;
+    if (!FrameArenaCreate(FrameArenaCapacity, FrameArenaFrames, &frames))
+    {
+        assert(false);
+        return false;
+    }
+
+    uint32_t width = CpuAppFrame.Width;
+    uint32_t height = CpuAppFrame.Height;
+    float farDepth = SceneFarDepth();
+    const float clearDepth[] = { farDepth, farDepth, farDepth, farDepth };
+    XMMATRIX proj = SceneProjection(width / (float)height);
+    XMMATRIX displayProj = XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), width / (float)height, SceneNear,
+        SceneFar);
+    CpuViewport cpuViewport = { 0, 0, (float)width, (float)height };
+
+    std::string report;
+    char line[256];
+    sprintf_s(line, "%ux%u CPU frame on a %u x %.0f MB frame arena, %u frames\n\n", width, height, FrameArenaFrames,
+        FrameArenaCapacity / (1024.0 * 1024.0), NumFrames);
+    report += line;
+    sprintf_s(line, "%-8s %12s %12s %10s\n", "Frame", "Allocations", "Arena KB", "CPU ms");
+    report += line;
+
+    CpuRenderProfile profile = CpuProfile;
+    Arena* previous = ThreadArenaBind(nullptr);
+    uint64_t steadyAllocations = 0;
+    size_t maxPeak = 0;
+    for (uint32_t frame = 0; frame < NumFrames; ++frame)
+    {
+        Arena* arena = FrameArenaBegin(&frames, frame);
+        ThreadArenaBind(arena);
+        float angle = 0.02f * frame;
+        XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(sinf(angle), 0, cosf(angle), 0),
+            XMVectorSet(0, 1, 0, 0));
+        XMMATRIX targetView = view * XMMatrixRotationY(-0.01f);
+
+        uint64_t allocations = HeapAllocations;
+        double ms = CpuTimeMs(1, [&]()
+        {
+            SceneVSConstants sceneConstants{};
+            XMStoreFloat4x4(&sceneConstants.WorldViewProj, XMMatrixMultiply(view, proj));
+            CpuTextureClear(&CpuAppFrame, clearColor);
+            CpuTextureClear(&CpuAppFrameDepth, clearDepth);
+            CpuDrawPipeline(PipelineStateIndex::SceneRender, &sceneConstants, nullptr, nullptr, &CpuAppFrame,
+                &CpuAppFrameDepth, &cpuViewport);
+            DepthPyramidBuild(CpuAppFrameDepth, &CpuAppFramePyramid);
+            VertexDepthBuild(CpuAppFrameDepth, SceneVertexDepthMode(VertexDepthSelection), &CpuVertexDepth);
+
+            XMVECTOR det;
+            PositionWarpVSConstants gridConstants{};
+            XMStoreFloat4x4(&gridConstants.TWMatrix,
+                XMMatrixMultiply(XMMatrixInverse(&det, view * proj), targetView * proj));
+            gridConstants.TextureSize = XMFLOAT2((float)width, (float)height);
+            CpuTextureClear(&CpuFixedWarp, clearColor);
+            CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &gridConstants, &CpuAppFrameDepth, &CpuAppFrame,
+                &CpuFixedWarp, nullptr);
+
+            XMMATRIX displayViewProj = XMMatrixMultiply(targetView, displayProj);
+            XMFLOAT4X4 viewProj;
+            XMFLOAT4X4 invViewProj;
+            XMStoreFloat4x4(&viewProj, displayViewProj);
+            XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, displayViewProj));
+            CompositorLayer layers[CompositorMaxLayers];
+            uint32_t numLayers = CpuGatherCompositorLayers(true, true, layers);
+            CompositorDraw(layers, numLayers, &viewProj.m[0][0], &invViewProj.m[0][0], cpuViewport, &CpuFixedWarp,
+                nullptr);
+        });
+        uint64_t frameAllocations = HeapAllocations - allocations;
+        steadyAllocations += (frame > 0) ? frameAllocations : 0;
+        maxPeak = (arena->Peak > maxPeak) ? arena->Peak : maxPeak;
+
+        sprintf_s(line, "%-8u %12llu %12.1f %10.2f%s\n", frame, frameAllocations, arena->Peak / 1024.0, ms,
+            (frame == 0) ? "  (first)" : "");
+        report += line;
+    }
+    ThreadArenaBind(previous);
+    CpuProfile = profile;
+
+    FrameArenaStats stats;
+    FrameArenaGetStats(frames, &stats);
+    FrameArenaDestroy(&frames);
+
+    bool steady = steadyAllocations == 0 && stats.Overflows == 0;
+    sprintf_s(line, "\nAfter the first frame: %llu allocations, %u arena overflows, peak %.1f KB: %s\n",
+        steadyAllocations, stats.Overflows, maxPeak / 1024.0, steady ? "passed" : "FAILED");
+    report += line;
+
+    return WriteReport(report, filename) && steady;
+}
+
+//==============================================================================
+bool GraphicsCheckFrameAllocations(const char* filename)
+{
+    // Whole frames from GraphicsDoFrame on the CPU path, as the title shows
+    // them, in each warp that path draws. A few frames into each warp, once
+    // anything it creates on first use exists, no frame may allocate. Only this
+    // thread's operator new is counted (see HeapAllocations), so this covers
+    // the CPU path's allocations and not what the D3D runtime and driver make
+    // for the GPU path.
+    struct CheckMode
+    {
+        const char* Name;
+        bool Rotational;
+        bool Backward;
+        bool Hybrid;
+    };
+    static const CheckMode Modes[] =
+    {
+        { "Rotational", true, false, false },
+        { "Grid", false, false, false },
+        { "Backward", false, true, false },
+        { "Hybrid", false, true, true },
+    };
+    static const uint32_t WarmUpFrames = 4;
+    static const uint32_t NumFrames = 64;
+
+    // Images requested at startup finish first
+    TextureLoaderFlush(&ImageLoader, 0);
+
+    bool drawCpu = DrawCpu;
+    bool drawRotational = DrawRotational;
+    bool drawBackward = DrawBackward;
+    bool drawHybrid = DrawHybrid;
+    DrawCpu = true;
+
+    std::string report;
+    char line[256];
+    sprintf_s(line, "%ux%u CPU frames, %u counted after %u to warm up. Only the CPU path's allocations on the "
+        "render thread are counted.\n\n",
+        CpuAppFrame.Width, CpuAppFrame.Height, NumFrames, WarmUpFrames);
+    report += line;
+    sprintf_s(line, "%-10s %12s %12s %12s\n", "Warp", "Allocations", "Worst frame", "Arena KB");
+    report += line;
+
+    uint64_t totalAllocations = 0;
+    for (const CheckMode& mode : Modes)
+    {
+        DrawRotational = mode.Rotational;
+        DrawBackward = mode.Backward;
+        DrawHybrid = mode.Hybrid;
+        for (uint32_t frame = 0; frame < WarmUpFrames; ++frame)
+        {
+            GraphicsDoFrame();
+        }
+
+        uint64_t allocations = 0;
+        uint64_t worstFrame = 0;
+        for (uint32_t frame = 0; frame < NumFrames; ++frame)
+        {
+            uint64_t before = HeapAllocations;
+            GraphicsDoFrame();
+            uint64_t frameAllocations = HeapAllocations - before;
+            allocations += frameAllocations;
+            worstFrame = (frameAllocations > worstFrame) ? frameAllocations : worstFrame;
+        }
+        totalAllocations += allocations;
+
+        FrameArenaStats arena;
+        FrameArenaGetStats(CpuFrameArena, &arena);
+        sprintf_s(line, "%-10s %12llu %12llu %12.1f\n", mode.Name, allocations, worstFrame, arena.MaxPeak / 1024.0);
+        report += line;
+    }
+
+    DrawCpu = drawCpu;
+    DrawRotational = drawRotational;
+    DrawBackward = drawBackward;
+    DrawHybrid = drawHybrid;
+
+    FrameArenaStats stats;
+    FrameArenaGetStats(CpuFrameArena, &stats);
+    bool passed = totalAllocations == 0 && stats.Overflows == 0;
+    sprintf_s(line, "\n%llu allocations, %u arena overflows: %s\n", totalAllocations, stats.Overflows,
+        passed ? "passed" : "FAILED");
+    report += line;
+
+    return WriteReport(report, filename) && passed;
+}
+
+//==============================================================================
+bool CpuInit(uint32_t width, uint32_t height)
+{
+    if (!CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &CpuAppFrame) ||
+        !CpuTextureCreate(width, height, CpuFormat::R32Float, &CpuAppFrameDepth) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &CpuAppFrameBackLayer) ||
+        !CpuTextureCreate(width, height, CpuFormat::R32Float, &CpuAppFrameBackLayerDepth) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &CpuBackBuffer) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &CpuReference) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &CpuFixedWarp) ||
+        !CpuTextureCreate(width, height, CpuFormat::R8G8B8A8Unorm, &CpuGroundTruth) ||
+        !CpuTextureCreate(width, height, CpuFormat::R32Float, &CpuGroundTruthDepth) ||
+        !CpuTextureCreate(width, height, CpuFormat::R16Unorm, &CpuEncodedDepth) ||
+        !DepthPyramidCreate(width, height, &CpuAppFramePyramid) ||
+        !BackwardWarpTilesCreate(width, height, &CpuBackwardTiles) ||
+        !VertexDepthCreate(width, height, NumVertsWidth, NumVertsHeight, &CpuVertexDepth) ||
+        !HoleFillCreate(width, height, &CpuHoleFill) ||
+        !FrameArenaCreate(FrameArenaCapacity, FrameArenaFrames, &CpuFrameArena) ||
+        !ParallelInit(0))
+    {
+        assert(false);
+        return false;
+    }
+    ThreadArenaBind(FrameArenaCurrent(&CpuFrameArena));
+
+    // Matches the D3D11 Sampler created in GraphicsInit
+    CpuLinearSampler.Filter = CpuFilter::Linear;
+    CpuLinearSampler.Address = CpuAddressMode::Border;
+
+    // The environment from disk, or else the generated sky
+    if (!CpuCubeMapLoad(EnvironmentFilename, &CpuEnvironment) &&
+        !CpuGenerateEnvironment(EnvironmentSize, &CpuEnvironment))
+    {
+        assert(false);
+        return false;
+    }
+
+    if (!CpuCreateCompositorLayers())
+    {
+        assert(false);
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+void CpuDestroy()
+{
+    for (uint32_t i = 0; i < _countof(CpuPipelines); ++i)
+    {
+        CpuPipelines[i] = CpuPipeline();
+    }
+
+    ParallelShutdown();
+    ThreadArenaBind(nullptr);
+    FrameArenaDestroy(&CpuFrameArena);
+    NumCompositorLayers = 0;
+    for (uint32_t i = 0; i < _countof(CpuLayerTextures); ++i)
+    {
+        CpuMipChainDestroy(&CpuLayerTextures[i]);
+    }
+    CpuCubeMapDestroy(&CpuEnvironment);
+    TemporalHistoryDestroy(&CpuHistory);
+    HoleFillDestroy(&CpuHoleFill);
+    CpuTextureDestroy(&CpuEncodedDepth);
+    VertexDepthDestroy(&CpuVertexDepth);
+    BackwardWarpTilesDestroy(&CpuBackwardTiles);
+    DepthPyramidDestroy(&CpuAppFramePyramid);
+    CpuTextureDestroy(&CpuGroundTruthDepth);
+    CpuTextureDestroy(&CpuGroundTruth);
+    CpuTextureDestroy(&CpuFixedWarp);
+    CpuTextureDestroy(&CpuReference);
+    CpuTextureDestroy(&CpuBackBuffer);
+    CpuTextureDestroy(&CpuAppFrameBackLayerDepth);
+    CpuTextureDestroy(&CpuAppFrameBackLayer);
+    CpuTextureDestroy(&CpuAppFrameDepth);
+    CpuTextureDestroy(&CpuAppFrame);
+}
+
+//==============================================================================
+bool CpuCreatePipeline(PipelineStateIndex index, const void* vs, size_t vsSize, const void* ps, size_t psSize,
+    const void* vertices, uint32_t verticesSize, uint32_t stride, const uint32_t* indices, uint32_t numIndices,
+    const CpuInputElement* elems, uint32_t numElems)
+{
+    auto& pipeline = GetCpuPipeline(index);
+
+    if (!DxbcParse(vs, vsSize, &pipeline.VertexShader) || !DxbcParse(ps, psSize, &pipeline.PixelShader))
+    {
+        assert(false);
+        return false;
+    }
+
+    // Falls back to the interpreter if either shader can't be compiled
+    pipeline.VertexProgram = DxbcCompileCached(vs, vsSize);
+    pipeline.PixelProgram = DxbcCompileCached(ps, psSize);
+
+    if (numElems > CpuMaxInputElements)
+    {
+        assert(false);
+        return false;
+    }
+
+    pipeline.Vertices.assign((const uint8_t*)vertices, (const uint8_t*)vertices + verticesSize);
+    pipeline.Indices.assign(indices, indices + numIndices);
+
+    CpuPipelineState& state = pipeline.State;
+    state = CpuPipelineState();
+    state.VertexShader = &pipeline.VertexShader;
+    state.PixelShader = &pipeline.PixelShader;
+    for (uint32_t i = 0; i < numElems; ++i)
+    {
+        state.InputElements[i] = elems[i];
+    }
+    state.NumInputElements = numElems;
+    state.Vertices = pipeline.Vertices.data();
+    state.NumVertices = verticesSize / stride;
+    state.Stride = stride;
+    state.Indices = pipeline.Indices.data();
+    state.NumIndices = numIndices;
+    state.CullBackFaces = true;
+    state.PSBindings.Samplers[0] = &CpuLinearSampler;
+
+    return true;
+}
+
+//==============================================================================
+void CpuDrawPipeline(PipelineStateIndex index, const void* vsConstants, const CpuTexture* vsResource,
+    const CpuTexture* psResource, CpuTexture* renderTarget, CpuTexture* depth, const CpuViewport* viewport)
+{
+    auto& pipeline = GetCpuPipeline(index);
+    CpuPipelineState& state = pipeline.State;
+    state.VertexProgram = CpuCompiled ? pipeline.VertexProgram : nullptr;
+    state.PixelProgram = CpuCompiled ? pipeline.PixelProgram : nullptr;
+    state.VSBindings.ConstantBuffers[0] = (const float*)vsConstants;
+    state.VSBindings.Resources[0] = vsResource;
+    state.PSBindings.Resources[0] = psResource;
+    state.Viewport = viewport ? *viewport : CpuViewport();
+    state.DepthFunc = ReversedZ ? CpuDepthFunc::Greater : CpuDepthFunc::Less;
+
+    bool result = CpuDrawIndexed(state, renderTarget, depth, &CpuProfile);
+    assert(result);
+    (void)result;
+}
+
+//==============================================================================
+void CpuDrawBackLayer(const SceneVSConstants& constants, const CpuViewport* viewport)
+{
+    static const float clearColor[] = { 0.f, 0.f, 0.f, 1 };
+    float farDepth = SceneFarDepth();
+    const float clearDepth[] = { farDepth, farDepth, farDepth, farDepth };
+    CpuTextureClear(&CpuAppFrameBackLayer, clearColor);
+    CpuTextureClear(&CpuAppFrameBackLayerDepth, clearDepth);
+    CpuDrawPipeline(PipelineStateIndex::ScenePeelRender, &constants, nullptr, &CpuAppFrameDepth,
+        &CpuAppFrameBackLayer, &CpuAppFrameBackLayerDepth, viewport);
+}
+
+//==============================================================================
+void CpuDrawLayers(const PositionWarpVSConstants& constants, CpuTexture* renderTarget)
+{
+    // As GraphicsDrawLayers. CpuDrawPipeline only binds the first pixel shader
+    // resource, so the layer's depth is bound here.
+    CpuPipelineState& state = GetCpuPipeline(PipelineStateIndex::PositionalLayeredTimewarp).State;
+    const CpuTexture* layers[2][2] = {
+        { &CpuAppFrameBackLayer, &CpuAppFrameBackLayerDepth },
+        { &CpuAppFrame, &CpuAppFrameDepth },
+    };
+    for (auto& layer : layers)
+    {
+        state.PSBindings.Resources[1] = layer[1];
+        CpuDrawPipeline(PipelineStateIndex::PositionalLayeredTimewarp, &constants, layer[1], layer[0], renderTarget, nullptr);
+    }
+}
+
+//==============================================================================
+void GraphicsDoFrame()
+{
+    // Scratch for this frame's CPU work, such as CpuDrawIndexed's
+    ThreadArenaBind(FrameArenaBegin(&CpuFrameArena, FrameIndex++));
+
+    // Finishes images decoded since the last frame, and starts more
+    TextureLoaderUpdate(&ImageLoader);
+
+    // Transparent under the background, so it shows wherever nothing is drawn
+    static const float opaqueColor[] = { 0.f, 0.f, 0.f, 1 };
+    static const float transparentColor[] = { 0.f, 0.f, 0.f, 0 };
+    const float* clearColor = DrawBackground ? transparentColor : opaqueColor;
+    Context->ClearRenderTargetView(AppFrameRTV.Get(), clearColor);
+    Context->ClearRenderTargetView(BackBufferRTV.Get(), clearColor);
+
+    static bool lastCDown = false;
+
+    bool cPressed = false;
+    if (GetAsyncKeyState('C') & 0x8000)
+    {
+        cPressed = !lastCDown;
+        lastCDown = true;
+    }
+    else
+    {
+        lastCDown = false;
+    }
+
+    if (cPressed)
+    {
+        DrawCpu = !DrawCpu;
+    }
+
+    static bool lastJDown = false;
+
+    bool jPressed = false;
+    if (GetAsyncKeyState('J') & 0x8000)
+    {
+        jPressed = !lastJDown;
+        lastJDown = true;
+    }
+    else
+    {
+        lastJDown = false;
+    }
+
+    if (jPressed)
+    {
+        CpuCompiled = !CpuCompiled;
+    }
+
+    static bool lastLDown = false;
+
+    bool lPressed = false;
+    if (GetAsyncKeyState('L') & 0x8000)
+    {
+        lPressed = !lastLDown;
+        lastLDown = true;
+    }
+    else
+    {
+        lastLDown = false;
+    }
+
+    if (lPressed)
+    {
+        DrawDistorted = !DrawDistorted;
+    }
+
+    static bool lastEDown = false;
+
+    bool ePressed = false;
+    if (GetAsyncKeyState('E') & 0x8000)
+    {
+        ePressed = !lastEDown;
+        lastEDown = true;
+    }
+    else
+    {
+        lastEDown = false;
+    }
+
+    if (ePressed)
+    {
+        DrawStereo = !DrawStereo;
+    }
+
+    static bool lastBDown = false;
+
+    bool bPressed = false;
+    if (GetAsyncKeyState('B') & 0x8000)
+    {
+        bPressed = !lastBDown;
+        lastBDown = true;
+    }
+    else
+    {
+        lastBDown = false;
+    }
+
+    if (bPressed)
+    {
+        bool result = GraphicsBenchmarkDepthPyramid("DepthPyramidBenchmark.txt") &&
+            GraphicsBenchmarkVertexDepth("VertexDepthBenchmark.txt") &&
+            GraphicsBenchmarkLayers("LayerBudget.txt") &&
+            ReportDepthPrecision("DepthPrecision.txt") &&
+            GraphicsBenchmarkDepthEncode("DepthEncodeBenchmark.txt") &&
+            GraphicsBenchmarkBackwardWarp("BackwardWarpBenchmark.txt") &&
+            GraphicsBenchmarkHybridWarp("HybridWarpBenchmark.txt") &&
+            CpuBenchmarkMipChain("MipChainBenchmark.txt") &&
+            CpuBenchmarkBlockCompress("BlockCompressBenchmark.txt") &&
+            GraphicsBenchmarkTextureFile("TextureFileBenchmark.txt") &&
+            CpuBenchmarkVirtualTexture("VirtualTextureBenchmark.txt") &&
+            GraphicsBenchmarkCubeMap("CubeMapBenchmark.txt") &&
+            GraphicsBenchmarkCompositor("CompositorBenchmark.txt") &&
+            GraphicsBenchmarkCapture("CaptureBenchmark.txt") &&
+            CpuBenchmarkFrameArena("FrameArenaBenchmark.txt");
+        assert(result);
+        (void)result;
+    }
+
+    static bool lastZDown = false;
+
+    bool zPressed = false;
+    if (GetAsyncKeyState('Z') & 0x8000)
+    {
+        zPressed = !lastZDown;
+        lastZDown = true;
+    }
+    else
+    {
+        lastZDown = false;
+    }
+
+    if (zPressed)
+    {
+        ReversedZ = !ReversedZ;
+    }
+
+    static bool lastFDown = false;
+
+    bool fPressed = false;
+    if (GetAsyncKeyState('F') & 0x8000)
+    {
+        fPressed = !lastFDown;
+        lastFDown = true;
+    }
+    else
+    {
+        lastFDown = false;
+    }
+
+    // Cycle the app frame depth format
+    if (fPressed)
+    {
+        AppFrameDepthFormat = (DepthFormat)(((uint32_t)AppFrameDepthFormat + 1) % (uint32_t)DepthFormat::Count);
+        bool result = GraphicsCreateFrameDepth(CpuAppFrameDepth.Width, CpuAppFrameDepth.Height, AppFrameDepthFormat);
+        assert(result);
+        (void)result;
+    }
+
+    float farDepth = SceneFarDepth();
+    const float clearDepth[] = { farDepth, farDepth, farDepth, farDepth };
+    Context->ClearDepthStencilView(AppFrameDSV.Get(), D3D11_CLEAR_DEPTH, farDepth, 0);
+
+    static bool lastRDown = false;
+
+    bool rPressed = false;
+    if (GetAsyncKeyState('R') & 0x8000)
+    {
+        rPressed = !lastRDown;
+        lastRDown = true;
+    }
+    else
+    {
+        lastRDown = false;
+    }
+
+    // Rebuild shaders from source. Only edited permutations miss the cache.
+    if (rPressed)
+    {
+        if (GraphicsLoadShaders())
+        {
+            bool result = GraphicsCreatePipelines();
+            assert(result);
+            (void)result;
+        }
+    }
+
+    if (DrawCpu)
+    {
+        CpuProfile = CpuRenderProfile();
+        CpuTextureClear(&CpuAppFrame, clearColor);
+        CpuTextureClear(&CpuAppFrameDepth, clearDepth);
+        CpuTextureClear(&CpuBackBuffer, clearColor);
+    }
+
+    static bool lastSpaceDown = false;
+
+    bool spacePressed = false;
+    if (GetAsyncKeyState(VK_SPACE) & 0x8000)
+    {
+        spacePressed = !lastSpaceDown;
+        lastSpaceDown = true;
+    }
+    else
+    {
+        lastSpaceDown = false;
+    }
+
+    if (spacePressed)
+    {
+        DrawNative = !DrawNative;
+    }
+
+    static bool lastKDown = false;
+
+    bool kPressed = false;
+    if (GetAsyncKeyState('K') & 0x8000)
+    {
+        kPressed = !lastKDown;
+        lastKDown = true;
+    }
+    else
+    {
+        lastKDown = false;
+    }
+
+    if (kPressed)
+    {
+        DrawBackground = !DrawBackground;
+    }
+
+    static bool lastODown = false;
+
+    bool oPressed = false;
+    if (GetAsyncKeyState('O') & 0x8000)
+    {
+        oPressed = !lastODown;
+        lastODown = true;
+    }
+    else
+    {
+        lastODown = false;
+    }
+
+    if (oPressed)
+    {
+        DrawCompositorLayers = !DrawCompositorLayers;
+    }
+
+    static bool lastUDown = false;
+
+    bool uPressed = false;
+    if (GetAsyncKeyState('U') & 0x8000)
+    {
+        uPressed = !lastUDown;
+        lastUDown = true;
+    }
+    else
+    {
+        lastUDown = false;
+    }
+
+    if (uPressed)
+    {
+        Capturing = !Capturing;
+        if (Capturing && !CreateDirectoryA(CaptureDirectory, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        {
+            assert(false);
+            Capturing = false;
+        }
+    }
+
+    static bool lastYDown = false;
+
+    bool yPressed = false;
+    if (GetAsyncKeyState('Y') & 0x8000)
+    {
+        yPressed = !lastYDown;
+        lastYDown = true;
+    }
+    else
+    {
+        lastYDown = false;
+    }
+
+    if (yPressed)
+    {
+        CaptureModeIndex = (CaptureModeIndex + 1) % _countof(CaptureModes);
+    }
+
+    // Update rotational warp params
     static POINT lastMouse{};
     POINT newMouse{};
 
@@ -855,105 +6465,686 @@ void GraphicsDoFrame()
     }
     lastMouse = newMouse;
 
-#ifndef ROTATION_WARP
-    // Update positional warp params
-    if (GetAsyncKeyState('A') & 0x8000)
+    static bool lastQDown = false;
+
+    bool qPressed = false;
+    if (GetAsyncKeyState('Q') & 0x8000)
     {
-        PositionX -= 0.005f;
+        qPressed = !lastQDown;
+        lastQDown = true;
     }
-    if (GetAsyncKeyState('D') & 0x8000)
+    else
     {
-        PositionX += 0.005f;
+        lastQDown = false;
     }
-    if (GetAsyncKeyState('W') & 0x8000)
+
+    if (qPressed)
     {
-        PositionY += 0.005f;
+        // The rotational warp can't follow a change in position, so it starts
+        // from none
+        DrawRotational = !DrawRotational;
+        PositionX = 0.f;
+        PositionY = 0.f;
     }
-    if (GetAsyncKeyState('S') & 0x8000)
+
+    // Update positional warp params. The keys below only change what the
+    // positional warp draws.
+    if (!DrawRotational)
     {
-        PositionY -= 0.005f;
+        if (GetAsyncKeyState('A') & 0x8000)
+        {
+            PositionX -= 0.005f;
+        }
+        if (GetAsyncKeyState('D') & 0x8000)
+        {
+            PositionX += 0.005f;
+        }
+        if (GetAsyncKeyState('W') & 0x8000)
+        {
+            PositionY += 0.005f;
+        }
+        if (GetAsyncKeyState('S') & 0x8000)
+        {
+            PositionY -= 0.005f;
+        }
     }
-#endif
 
-    const float zNear = 0.1f;
-    const float zFar = 1000.f;
+    static bool lastMDown = false;
 
-    XMMATRIX rot = XMMatrixMultiply(XMMatrixRotationY(RotationX), XMMatrixRotationX(RotationY));
-    XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.f), 1280.f / 720.f, zNear, zFar);
+    bool mPressed = false;
+    if (GetAsyncKeyState('M') & 0x8000)
+    {
+        mPressed = !lastMDown;
+        lastMDown = true;
+    }
+    else
+    {
+        lastMDown = false;
+    }
 
-    XMMATRIX view = XMMatrixIdentity();
-    XMMATRIX view2 = XMMatrixIdentity();
-    XMMATRIX warp = XMMatrixIdentity();
+    if (mPressed)
+    {
+        DrawAdaptive = !DrawAdaptive;
+    }
 
-    if (DrawNative)
+    // Halve or double the adaptive grid's cell budget
+    static bool lastBracketDown = false;
+
+    int32_t budgetStep = 0;
+    if (GetAsyncKeyState(VK_OEM_4) & 0x8000)
+    {
+        budgetStep = lastBracketDown ? 0 : -1;
+        lastBracketDown = true;
+    }
+    else if (GetAsyncKeyState(VK_OEM_6) & 0x8000)
     {
-        view = XMMatrixLookToLH(XMVectorSet(PositionX, PositionY + 1, -8, 1), XMVector3Transform(XMVectorSet(0, 0, 1, 0), rot), XMVectorSet(0, 1, 0, 0));
-        view2 = view;
+        budgetStep = lastBracketDown ? 0 : 1;
+        lastBracketDown = true;
     }
     else
     {
-        view = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
-        view2 = XMMatrixLookToLH(XMVectorSet(PositionX, PositionY + 1, -8, 1), XMVector3Transform(XMVectorSet(0, 0, 1, 0), rot), XMVectorSet(0, 1, 0, 0));
+        lastBracketDown = false;
+    }
 
-        XMVECTOR det;
-        warp = XMMatrixMultiply(XMMatrixInverse(&det, view * proj), view2 * proj);
+    if (budgetStep < 0 && AdaptiveMeshBudget > (1u << (2 * AdaptiveMeshMinLevel)))
+    {
+        AdaptiveMeshBudget /= 2;
+    }
+    else if (budgetStep > 0 && AdaptiveMeshBudget < (1u << (2 * AdaptiveMeshMaxLevel)))
+    {
+        AdaptiveMeshBudget *= 2;
     }
 
-    // Draw scene
-    auto& scenePipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    // Cycle the fixed grid's vertex depth: raw texel, then each mode
+    static bool lastVDown = false;
+
+    bool vPressed = false;
+    if (GetAsyncKeyState('V') & 0x8000)
+    {
+        vPressed = !lastVDown;
+        lastVDown = true;
+    }
+    else
+    {
+        lastVDown = false;
+    }
+
+    if (vPressed)
+    {
+        if (!DrawVertexDepth)
+        {
+            DrawVertexDepth = true;
+            VertexDepthSelection = VertexDepthMode::Nearest;
+        }
+        else if (VertexDepthSelection == VertexDepthMode::Coverage)
+        {
+            DrawVertexDepth = false;
+        }
+        else
+        {
+            VertexDepthSelection = (VertexDepthMode)((uint32_t)VertexDepthSelection + 1);
+        }
+    }
+
+    static bool lastHDown = false;
+
+    bool hPressed = false;
+    if (GetAsyncKeyState('H') & 0x8000)
+    {
+        hPressed = !lastHDown;
+        lastHDown = true;
+    }
+    else
+    {
+        lastHDown = false;
+    }
+
+    if (hPressed)
+    {
+        DrawHoleFill = !DrawHoleFill;
+    }
+
+    // Cycle the fixed grid's depth between raw and each 16 bit encoding
+    static bool lastXDown = false;
+
+    bool xPressed = false;
+    if (GetAsyncKeyState('X') & 0x8000)
+    {
+        xPressed = !lastXDown;
+        lastXDown = true;
+    }
+    else
+    {
+        lastXDown = false;
+    }
+
+    if (xPressed)
+    {
+        if (!DrawEncodedDepth)
+        {
+            DrawEncodedDepth = true;
+            DepthEncodingSelection = DepthEncoding::Linear;
+        }
+        else if (DepthEncodingSelection == DepthEncoding::Log)
+        {
+            DrawEncodedDepth = false;
+        }
+        else
+        {
+            DepthEncodingSelection = (DepthEncoding)((uint32_t)DepthEncodingSelection + 1);
+        }
+    }
+
+    static bool lastGDown = false;
+
+    bool gPressed = false;
+    if (GetAsyncKeyState('G') & 0x8000)
+    {
+        gPressed = !lastGDown;
+        lastGDown = true;
+    }
+    else
+    {
+        lastGDown = false;
+    }
+
+    // Grid, then the backward warp searching everywhere, then only where it must
+    if (gPressed)
+    {
+        DrawHybrid = DrawBackward && !DrawHybrid;
+        DrawBackward = DrawHybrid || !DrawBackward;
+    }
+
+    static bool lastPDown = false;
+
+    bool pPressed = false;
+    if (GetAsyncKeyState('P') & 0x8000)
+    {
+        pPressed = !lastPDown;
+        lastPDown = true;
+    }
+    else
+    {
+        lastPDown = false;
+    }
+
+    if (pPressed)
+    {
+        DrawLayered = !DrawLayered;
+    }
+
+    // Cycle the history used by hole filling: none, then 1, 2, 4 and 8 frames
+    static bool lastTDown = false;
+
+    bool tPressed = false;
+    if (GetAsyncKeyState('T') & 0x8000)
+    {
+        tPressed = !lastTDown;
+        lastTDown = true;
+    }
+    else
+    {
+        lastTDown = false;
+    }
+
+    if (tPressed)
+    {
+        TemporalFrames = (TemporalFrames == 0) ? 1 : TemporalFrames * 2;
+        if (TemporalFrames > TemporalHistoryMaxFrames)
+        {
+            TemporalFrames = 0;
+        }
+
+        TemporalHistoryDestroy(&CpuHistory);
+        if (TemporalFrames > 0)
+        {
+            bool result = TemporalHistoryCreate(CpuBackBuffer.Width, CpuBackBuffer.Height, TemporalFrames, &CpuHistory);
+            assert(result);
+            (void)result;
+        }
+    }
+
+    // In stereo each eye gets half of the app frame and back buffer
+    D3D11_VIEWPORT fullViewport{};
+    uint32_t numViewports = 1;
+    Context->RSGetViewports(&numViewports, &fullViewport);
+
+    uint32_t numEyes = DrawStereo ? 2 : 1;
+    float eyeWidth = fullViewport.Width / numEyes;
+
+    XMMATRIX rot = XMMatrixMultiply(XMMatrixRotationY(RotationX), XMMatrixRotationX(RotationY));
+    XMMATRIX proj = SceneProjection(eyeWidth / fullViewport.Height);
+
+    XMMATRIX view[2] = { XMMatrixIdentity(), XMMatrixIdentity() };
+    XMMATRIX warp[2] = { XMMatrixIdentity(), XMMatrixIdentity() };
+    XMMATRIX targetView[2] = { XMMatrixIdentity(), XMMatrixIdentity() };
+
+    // The second layer goes with the fixed positional grid. Peeling and the
+    // layered warp, like hole filling, expect standard float depth.
+    bool standardDepth = !ReversedZ && AppFrameDepthFormat == DepthFormat::D32Float;
+
+    // The backward warp searches mono standard depth per pixel in place of
+    // the grid, and resolves disocclusions as it goes
+    bool backward = !DrawRotational && DrawBackward && !DrawStereo && !DrawDistorted && !ReversedZ;
+    bool layered = !DrawRotational && DrawLayered && !DrawStereo && !DrawDistorted && !DrawAdaptive && standardDepth && !backward;
+
+    bool holeFill = !DrawRotational && DrawCpu && DrawHoleFill && !DrawStereo && !DrawDistorted && !ReversedZ && !backward;
+    bool temporal = holeFill && TemporalFrames > 0 && !DrawNative;
+    if (!temporal)
+    {
+        NumLaggedViews = 0;
+    }
+
+    for (uint32_t eye = 0; eye < numEyes; ++eye)
+    {
+        // Eyes are offset along the view's x axis
+        XMMATRIX eyeOffset = XMMatrixIdentity();
+        if (DrawStereo)
+        {
+            eyeOffset = XMMatrixTranslation(eye ? -EyeSeparation * 0.5f : EyeSeparation * 0.5f, 0, 0);
+        }
+
+        // The pose the warp targets, drawn directly when not warping
+        targetView[eye] = XMMatrixLookToLH(XMVectorSet(PositionX, PositionY + 1, -8, 1), XMVector3Transform(XMVectorSet(0, 0, 1, 0), rot), XMVectorSet(0, 1, 0, 0)) * eyeOffset;
+
+        if (DrawNative)
+        {
+            view[eye] = targetView[eye];
+        }
+        else
+        {
+            view[eye] = XMMatrixLookToLH(XMVectorSet(0, 1, -8, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)) * eyeOffset;
+            if (temporal)
+            {
+                // The slot about to be replaced holds the target pose from
+                // AppFrameLatency frames ago
+                uint32_t slot = NumLaggedViews % AppFrameLatency;
+                if (NumLaggedViews >= AppFrameLatency)
+                {
+                    view[eye] = LaggedViews[slot];
+                }
+                LaggedViews[slot] = targetView[eye];
+                ++NumLaggedViews;
+            }
+
+            XMVECTOR det;
+            warp[eye] = XMMatrixMultiply(XMMatrixInverse(&det, view[eye] * proj), targetView[eye] * proj);
+        }
+    }
 
-    SceneVSConstants sceneVSConst{};
-    XMStoreFloat4x4(&sceneVSConst.WorldViewProj, XMMatrixMultiply(view, proj));
-    Context->UpdateSubresource(scenePipeline.VSConstantBuffer.Get(), 0, nullptr, &sceneVSConst, sizeof(sceneVSConst), 0);
+    // Draw scene, once per eye
+    auto& scenePipeline = GetPipeline(PipelineStateIndex::SceneRender);
+    Context->OMSetDepthStencilState(ReversedZ ? ReversedDepthState.Get() : nullptr, 0);
 
     ID3D11ShaderResourceView* nullSRV[] = { nullptr, nullptr };
     Context->VSSetShaderResources(0, _countof(nullSRV), nullSRV);
     Context->PSSetShaderResources(0, _countof(nullSRV), nullSRV);
     Context->OMSetRenderTargets(1, AppFrameRTV.GetAddressOf(), AppFrameDSV.Get());
-    GraphicsDrawPipeline(scenePipeline);
 
-#ifdef ROTATION_WARP
-    // Rotational warp
-    auto& rotationalPipeline = GetPipeline(PipelineStateIndex::RotationalTimewarp);
+    for (uint32_t eye = 0; eye < numEyes; ++eye)
+    {
+        SceneVSConstants sceneVSConst{};
+        XMStoreFloat4x4(&sceneVSConst.WorldViewProj, XMMatrixMultiply(view[eye], proj));
+        Context->UpdateSubresource(scenePipeline.VSConstantBuffer.Get(), 0, nullptr, &sceneVSConst, sizeof(sceneVSConst), 0);
+
+        D3D11_VIEWPORT eyeViewport = fullViewport;
+        eyeViewport.TopLeftX = fullViewport.TopLeftX + eye * eyeWidth;
+        eyeViewport.Width = eyeWidth;
+        Context->RSSetViewports(1, &eyeViewport);
+
+        if (DrawCpu)
+        {
+            CpuViewport cpuViewport = { eyeViewport.TopLeftX, eyeViewport.TopLeftY, eyeViewport.Width, eyeViewport.Height };
+            CpuDrawPipeline(PipelineStateIndex::SceneRender, &sceneVSConst, nullptr, nullptr, &CpuAppFrame, &CpuAppFrameDepth, &cpuViewport);
+        }
+        else
+        {
+            GraphicsDrawPipeline(scenePipeline);
+        }
+    }
 
-    RotationWarpVSConstants rotationVSConst{};
-    if (DrawNative)
+    Context->RSSetViewports(1, &fullViewport);
+
+    // The CPU renders float depth, kept as precise as the GPU stores it
+    if (DrawCpu)
     {
-        XMStoreFloat4x4(&rotationVSConst.TWMatrix, XMMatrixIdentity());
+        DepthFormatQuantize(AppFrameDepthFormat, &CpuAppFrameDepth);
     }
-    else
+
+    // Second layer, peeled from behind the first
+    if (layered)
     {
-        XMStoreFloat4x4(&rotationVSConst.TWMatrix, warp);
+        if (DrawCpu)
+        {
+            SceneVSConstants sceneVSConst{};
+            XMStoreFloat4x4(&sceneVSConst.WorldViewProj, XMMatrixMultiply(view[0], proj));
+            CpuDrawBackLayer(sceneVSConst, nullptr);
+        }
+        else
+        {
+            GraphicsDrawBackLayer();
+        }
     }
 
-    Context->UpdateSubresource(rotationalPipeline.VSConstantBuffer.Get(), 0, nullptr, &rotationVSConst, sizeof(rotationVSConst), 0);
+    // Depth pyramid of the app frame, only for the warps that read it: the
+    // backward and hybrid warps search it, and the adaptive grid refines by
+    // it. The app frame is only read from here on, so it's unbound either way.
+    bool adaptive = !DrawRotational && DrawAdaptive && !DrawStereo && !DrawDistorted && !backward;
+    Context->OMSetRenderTargets(0, nullptr, nullptr);
+    if (backward || adaptive)
+    {
+        if (DrawCpu)
+        {
+            DepthPyramidBuild(CpuAppFrameDepth, &CpuAppFramePyramid);
+        }
+        else
+        {
+            GraphicsBuildDepthPyramid(AppFrameDepthSRV.Get(), AppFramePyramid);
+        }
+    }
 
-    Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
-    Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
-    GraphicsDrawPipeline(rotationalPipeline);
+    if (DrawRotational)
+    {
+        // Rotational warp. Stereo draws both eyes as two instances of one draw.
+        PipelineStateIndex rotationalIndex = DrawStereo ?
+            (DrawDistorted ? PipelineStateIndex::RotationalDistortedStereoTimewarp : PipelineStateIndex::RotationalStereoTimewarp) :
+            (DrawDistorted ? PipelineStateIndex::RotationalDistortedTimewarp : PipelineStateIndex::RotationalTimewarp);
+        auto& rotationalPipeline = GetPipeline(rotationalIndex);
+
+        RotationWarpVSConstants rotationVSConst{};
+        StereoRotationWarpVSConstants stereoRotationVSConst{};
+        XMStoreFloat4x4(&rotationVSConst.TWMatrix, warp[0]);
+        for (uint32_t eye = 0; eye < numEyes; ++eye)
+        {
+            XMStoreFloat4x4(&stereoRotationVSConst.TWMatrix[eye], warp[eye]);
+        }
+        const void* rotationConstants = DrawStereo ? (const void*)&stereoRotationVSConst : &rotationVSConst;
 
-#else
-    // Positional warp
-    auto& positionalPipeline = GetPipeline(PipelineStateIndex::PositionalTimewarp);
+        Context->UpdateSubresource(rotationalPipeline.VSConstantBuffer.Get(), 0, nullptr, rotationConstants, 0, 0);
 
-    PositionWarpVSConstants positionVSConst{};
-    if (DrawNative)
-    {
-        XMStoreFloat4x4(&positionVSConst.TWMatrix, XMMatrixIdentity());
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
+        if (DrawCpu)
+        {
+            CpuDrawPipeline(rotationalIndex, rotationConstants, nullptr, &CpuAppFrame, &CpuBackBuffer, nullptr);
+            if (DrawDistorted && !DrawStereo)
+            {
+                LensDistortionReferenceWarp(&rotationVSConst.TWMatrix.m[0][0], Lens, CpuAppFrame, nullptr, CpuLinearSampler, &CpuReference);
+                CpuTextureCompare(CpuBackBuffer, CpuReference, &CpuReferenceDiff);
+            }
+        }
+        else
+        {
+            GraphicsDrawPipeline(rotationalPipeline);
+        }
     }
     else
     {
-        XMStoreFloat4x4(&positionVSConst.TWMatrix, warp);
+        // Positional warp. Stereo draws both eyes as two instances of one draw.
+        PipelineStateIndex positionalIndex = DrawStereo ?
+            (DrawDistorted ? PipelineStateIndex::PositionalDistortedStereoTimewarp : PipelineStateIndex::PositionalStereoTimewarp) :
+            (DrawDistorted ? PipelineStateIndex::PositionalDistortedTimewarp :
+            (adaptive ? PipelineStateIndex::PositionalAdaptiveTimewarp : PipelineStateIndex::PositionalTimewarp));
+
+        // Per vertex depth takes precedence over the encoded texel depth
+        bool encoded = DrawEncodedDepth && positionalIndex == PipelineStateIndex::PositionalTimewarp && !DrawVertexDepth && !backward;
+        if (encoded)
+        {
+            positionalIndex = PipelineStateIndex::PositionalEncodedTimewarp;
+        }
+        auto& positionalPipeline = GetPipeline(positionalIndex);
+
+        // Rebuilt from this frame's depth pyramid on the CPU path. The GPU path
+        // doesn't wait for its pyramid, and rebuilds from the newest one read
+        // back, a frame or two late, keeping the grid it has until then. The
+        // grid only places the vertices, which still read this frame's depth.
+        if (adaptive && (DrawCpu || GraphicsReadBackDepthPyramid(&CpuAppFramePyramid)))
+        {
+            AdaptiveWarpMeshDesc desc = { AdaptiveMeshMinLevel, AdaptiveMeshMaxLevel, AdaptiveMeshDepthThreshold, AdaptiveMeshBudget };
+            AdaptiveWarpMeshBuild(CpuAppFramePyramid, desc, &AdaptiveMesh);
+
+            bool result = GraphicsUpdateAdaptiveTimewarp(PipelineStateIndex::PositionalAdaptiveTimewarp, AdaptiveMesh);
+            assert(result);
+            (void)result;
+        }
+
+        PositionWarpVSConstants positionVSConst{};
+        StereoPositionWarpVSConstants stereoPositionVSConst{};
+        XMStoreFloat4x4(&positionVSConst.TWMatrix, warp[0]);
+        for (uint32_t eye = 0; eye < numEyes; ++eye)
+        {
+            XMStoreFloat4x4(&stereoPositionVSConst.TWMatrix[eye], warp[eye]);
+        }
+        positionVSConst.TextureSize = XMFLOAT2(1280, 720);
+        stereoPositionVSConst.TextureSize = positionVSConst.TextureSize;
+        const void* positionConstants = DrawStereo ? (const void*)&stereoPositionVSConst : &positionVSConst;
+
+        // The fixed grid can read one preprocessed depth per vertex instead
+        ID3D11ShaderResourceView* vertexDepthSRV = AppFrameDepthSRV.Get();
+        const CpuTexture* cpuVertexDepth = &CpuAppFrameDepth;
+        if (DrawVertexDepth && positionalIndex == PipelineStateIndex::PositionalTimewarp && !backward)
+        {
+            positionVSConst.TextureSize = XMFLOAT2((float)(NumVertsWidth - 1), (float)(NumVertsHeight - 1));
+            if (DrawCpu)
+            {
+                CpuVertexDepthMs = CpuTimeMs(1, [&]() { VertexDepthBuild(CpuAppFrameDepth, SceneVertexDepthMode(VertexDepthSelection), &CpuVertexDepth); });
+                cpuVertexDepth = &CpuVertexDepth.Depths;
+            }
+            else
+            {
+                GraphicsBuildVertexDepth(SceneVertexDepthMode(VertexDepthSelection));
+                vertexDepthSRV = VertexDepthSRV.Get();
+            }
+        }
+
+        // Or 16 bit view depth, encoded from this frame's
+        EncodedPositionWarpVSConstants encodedVSConst{};
+        if (encoded)
+        {
+            DepthEncodeDesc encodeDesc = { SceneNear, SceneFar, ReversedZ, DepthEncodingSelection };
+            encodedVSConst.TWMatrix = positionVSConst.TWMatrix;
+            encodedVSConst.TextureSize = positionVSConst.TextureSize;
+            DepthEncodeGetConstants(encodeDesc, &encodedVSConst.DepthDecode);
+            encodedVSConst.DepthEncoding = (uint32_t)DepthEncodingSelection;
+            positionConstants = &encodedVSConst;
+            if (DrawCpu)
+            {
+                CpuDepthEncodeMs = CpuTimeMs(1, [&]() { DepthEncodeBuild(CpuAppFrameDepth, encodeDesc, &CpuEncodedDepth); });
+                cpuVertexDepth = &CpuEncodedDepth;
+            }
+            else
+            {
+                GraphicsEncodeDepth(encodeDesc);
+                vertexDepthSRV = EncodedDepthSRV.Get();
+            }
+        }
+
+        Context->UpdateSubresource(positionalPipeline.VSConstantBuffer.Get(), 0, nullptr, positionConstants, 0, 0);
+
+        // The layers are always warped with their full resolution depth
+        PositionWarpVSConstants layeredVSConst = positionVSConst;
+        layeredVSConst.TextureSize = XMFLOAT2(1280, 720);
+
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        Context->VSSetShaderResources(0, 1, &vertexDepthSRV);
+        Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
+        if (backward)
+        {
+            XMVECTOR det;
+            XMFLOAT4X4 inverseWarp;
+            XMStoreFloat4x4(&inverseWarp, XMMatrixInverse(&det, warp[0]));
+            if (DrawCpu)
+            {
+                CpuClassifyMs = DrawHybrid ? CpuTimeMs(1, [&]()
+                {
+                    BackwardWarpClassify(CpuAppFramePyramid, &inverseWarp.m[0][0], HybridParallaxThreshold, &CpuBackwardTiles);
+                }) : 0;
+                CpuBackwardWarpMs = CpuTimeMs(1, [&]()
+                {
+                    BackwardWarp(CpuAppFrame, CpuAppFrameDepth, CpuAppFramePyramid, &inverseWarp.m[0][0], CpuLinearSampler,
+                        DrawHybrid ? &CpuBackwardTiles : nullptr, &CpuBackBuffer, &CpuBackwardStats);
+                });
+            }
+            else
+            {
+                GraphicsBackwardWarp(inverseWarp, DrawHybrid ? HybridParallaxThreshold : 0.f);
+            }
+        }
+        else if (DrawCpu)
+        {
+            CpuDrawPipeline(positionalIndex, positionConstants, cpuVertexDepth, &CpuAppFrame, &CpuBackBuffer, nullptr);
+            if (layered)
+            {
+                CpuDrawLayers(layeredVSConst, &CpuBackBuffer);
+            }
+            if (DrawDistorted && !DrawStereo)
+            {
+                LensDistortionReferenceWarp(&positionVSConst.TWMatrix.m[0][0], Lens, CpuAppFrame, &CpuAppFrameDepth, CpuLinearSampler, &CpuReference);
+                CpuTextureCompare(CpuBackBuffer, CpuReference, &CpuReferenceDiff);
+            }
+            if (adaptive)
+            {
+                // Warp error of the adaptive and fixed grids against the grid
+                // refined everywhere, kept out of the profile
+                CpuRenderProfile profile = CpuProfile;
+                CpuTextureClear(&CpuFixedWarp, clearColor);
+                CpuTextureClear(&CpuReference, clearColor);
+                CpuDrawPipeline(PipelineStateIndex::PositionalTimewarp, &positionVSConst, &CpuAppFrameDepth, &CpuAppFrame, &CpuFixedWarp, nullptr);
+                CpuDrawPipeline(PipelineStateIndex::PositionalRefinedTimewarp, &positionVSConst, &CpuAppFrameDepth, &CpuAppFrame, &CpuReference, nullptr);
+                CpuTextureCompare(CpuBackBuffer, CpuReference, &CpuAdaptiveDiff);
+                CpuTextureCompare(CpuFixedWarp, CpuReference, &CpuFixedDiff);
+                CpuProfile = profile;
+            }
+            if (holeFill)
+            {
+                // Ground truth is the scene drawn natively from the warp's target
+                // pose, also kept out of the profile
+                CpuRenderProfile profile = CpuProfile;
+                SceneVSConstants truthVSConst{};
+                XMStoreFloat4x4(&truthVSConst.WorldViewProj, XMMatrixMultiply(targetView[0], proj));
+                CpuViewport cpuViewport = { fullViewport.TopLeftX, fullViewport.TopLeftY, fullViewport.Width, fullViewport.Height };
+                CpuTextureClear(&CpuGroundTruth, clearColor);
+                CpuTextureClear(&CpuGroundTruthDepth, clearDepth);
+                CpuDrawPipeline(PipelineStateIndex::SceneRender, &truthVSConst, nullptr, nullptr, &CpuGroundTruth, &CpuGroundTruthDepth, &cpuViewport);
+                CpuProfile = profile;
+
+                double detectMs = CpuTimeMs(1, [&]() { HoleFillDetect(CpuAppFrameDepth, layered ? &CpuAppFrameBackLayerDepth : nullptr, &positionVSConst.TWMatrix.m[0][0], &CpuHoleFill); });
+                HoleFillCompare(CpuHoleFill, CpuBackBuffer, CpuGroundTruth, &CpuHoleDiffBefore);
+                CpuTextureCompare(CpuBackBuffer, CpuGroundTruth, &CpuFrameDiffBefore);
+
+                // Earlier app frames fill what they can before inpainting
+                XMFLOAT4X4 targetViewProj;
+                XMStoreFloat4x4(&targetViewProj, XMMatrixMultiply(targetView[0], proj));
+                CpuHoleFillMs = detectMs + CpuTimeMs(1, [&]()
+                {
+                    if (temporal)
+                    {
+                        TemporalHistoryFill(&targetViewProj.m[0][0], &CpuHoleFill, &CpuBackBuffer, &CpuHistory);
+                    }
+                    HoleFillApply(&CpuBackBuffer, &CpuHoleFill);
+                });
+                HoleFillCompare(CpuHoleFill, CpuBackBuffer, CpuGroundTruth, &CpuHoleDiffAfter);
+                CpuTextureCompare(CpuBackBuffer, CpuGroundTruth, &CpuFrameDiffAfter);
+
+                if (temporal)
+                {
+                    XMVECTOR det;
+                    XMFLOAT4X4 invViewProj;
+                    XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, XMMatrixMultiply(view[0], proj)));
+                    TemporalHistoryPush(CpuAppFrame, CpuAppFrameDepth, &invViewProj.m[0][0], &CpuHistory);
+                }
+            }
+        }
+        else
+        {
+            GraphicsDrawPipeline(positionalPipeline);
+            if (layered)
+            {
+                GraphicsDrawLayers(layeredVSConst);
+            }
+        }
+    }
+
+    // The environment beneath whatever the warp drew, looked up at the display
+    // pose. Not under the distorted warps, whose back buffer is in lens space.
+    // The CPU path draws it in the compositor pass below instead.
+    if (DrawBackground && !DrawDistorted && !DrawCpu)
+    {
+        XMMATRIX backgroundProj = XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), eyeWidth / fullViewport.Height,
+            SceneNear, SceneFar);
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        for (uint32_t eye = 0; eye < numEyes; ++eye)
+        {
+            XMVECTOR det;
+            XMFLOAT4X4 invViewProj;
+            XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, XMMatrixMultiply(targetView[eye], backgroundProj)));
+
+            D3D11_VIEWPORT eyeViewport = fullViewport;
+            eyeViewport.TopLeftX = fullViewport.TopLeftX + eye * eyeWidth;
+            eyeViewport.Width = eyeWidth;
+            Context->RSSetViewports(1, &eyeViewport);
+            GraphicsDrawBackground(invViewProj);
+        }
+        Context->RSSetViewports(1, &fullViewport);
+    }
+
+    // Compositor layers over all of it, sampled straight from their textures
+    // at the display pose, and on the CPU the environment beneath the warped
+    // frame in the same pass, sampled only where the frame leaves gaps. Not
+    // over the distorted warps either.
+    bool cpuBackground = DrawBackground && DrawCpu;
+    if ((DrawCompositorLayers || cpuBackground) && !DrawDistorted)
+    {
+        XMMATRIX layerProj = XMMatrixPerspectiveFovLH(XMConvertToRadians(SceneFovY), eyeWidth / fullViewport.Height,
+            SceneNear, SceneFar);
+        CompositorLayer cpuLayers[CompositorMaxLayers];
+        uint32_t numCpuLayers = CpuGatherCompositorLayers(cpuBackground, DrawCompositorLayers, cpuLayers);
+        Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
+        CpuCompositorMs = 0;
+        CpuCompositorStats = CompositorStats{};
+        for (uint32_t eye = 0; eye < numEyes; ++eye)
+        {
+            XMMATRIX eyeViewProj = XMMatrixMultiply(targetView[eye], layerProj);
+            XMVECTOR det;
+            XMFLOAT4X4 viewProj;
+            XMFLOAT4X4 invViewProj;
+            XMStoreFloat4x4(&viewProj, eyeViewProj);
+            XMStoreFloat4x4(&invViewProj, XMMatrixInverse(&det, eyeViewProj));
+
+            D3D11_VIEWPORT eyeViewport = fullViewport;
+            eyeViewport.TopLeftX = fullViewport.TopLeftX + eye * eyeWidth;
+            eyeViewport.Width = eyeWidth;
+            if (DrawCpu)
+            {
+                CpuViewport cpuViewport = { eyeViewport.TopLeftX, eyeViewport.TopLeftY, eyeViewport.Width, eyeViewport.Height };
+                CpuCompositorMs += CpuTimeMs(1, [&]()
+                {
+                    CompositorDraw(cpuLayers, numCpuLayers, &viewProj.m[0][0], &invViewProj.m[0][0], cpuViewport,
+                        &CpuBackBuffer, &CpuCompositorStats);
+                });
+            }
+            else if (DrawCompositorLayers)
+            {
+                GraphicsDrawCompositor(viewProj, invViewProj, eyeViewport, true);
+            }
+        }
+        Context->RSSetViewports(1, &fullViewport);
     }
-    positionVSConst.TextureSize = XMFLOAT2(1280, 720);
 
-    Context->UpdateSubresource(positionalPipeline.VSConstantBuffer.Get(), 0, nullptr, &positionVSConst, sizeof(positionVSConst), 0);
+    if (DrawCpu)
+    {
+        Context->UpdateSubresource(BackBuffer.Get(), 0, nullptr, CpuBackBuffer.Data, CpuBackBuffer.RowPitch, 0);
+    }
 
-    Context->OMSetRenderTargets(1, BackBufferRTV.GetAddressOf(), nullptr);
-    Context->VSSetShaderResources(0, 1, AppFrameDepthSRV.GetAddressOf());
-    Context->PSSetShaderResources(0, 1, AppFrameSRV.GetAddressOf());
-    GraphicsDrawPipeline(positionalPipeline);
-#endif
+    // Hands earlier copies on to the encoder, and copies this frame
+    CaptureMs = CpuTimeMs(1, []()
+    {
+        FrameCaptureUpdate(&Capture);
+        if (Capturing)
+        {
+            GraphicsCaptureFrame(&Capture, CaptureModes[CaptureModeIndex], "", CaptureFrameIndex++);
+        }
+    });
 
     SwapChain->Present(1, 0);
 }